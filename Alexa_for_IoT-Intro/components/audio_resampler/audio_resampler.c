@@ -0,0 +1,386 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2019 <ESPRESSIF SYSTEMS (SHANGHAI) CO., LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <string.h>
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include "esp_audio_mem.h"
+#include "audio_resampler.h"
+
+static const char *TAG = "[audio_resampler]";
+
+/* Input frames taken per pass. The line buffers hold this many frames plus the filter history. */
+#define RESAMPLER_BLOCK_FRAMES 128
+
+/* 11025 Hz to 48 kHz needs 640 phases, the most of any rate pair in use */
+#define RESAMPLER_MAX_PHASES 640
+
+struct audio_resampler {
+    int in_rate;
+    int out_rate;
+    int in_channels;
+    int out_channels;
+    audio_resampler_quality_t quality;
+    int up;                 /* L, output rate / gcd */
+    int down;               /* M, input rate / gcd */
+    int taps;               /* Taps per phase, a multiple of 8. 0 when the rates are the same */
+    int line_channels;      /* Channels that are filtered, 2 only for stereo to stereo */
+    int16_t *coefs;         /* up * taps Q15 coefficients, phase by phase, each phase reversed */
+    int16_t *line[2];       /* Planar input history and block, taps - 1 + RESAMPLER_BLOCK_FRAMES frames each */
+    int filled;             /* Frames in the line buffers */
+    int pos;                /* Start in the line buffers of the window of the next output */
+    int phase;              /* Phase of the next output */
+};
+
+typedef struct {
+    int taps;
+    float cutoff;           /* -6 dB point as a fraction of the lower Nyquist frequency */
+    float beta;             /* Kaiser window shape */
+} resampler_tier_t;
+
+static const resampler_tier_t resampler_tiers[] = {
+    [AUDIO_RESAMPLER_QUALITY_LOW]    = { .taps = 8,  .cutoff = 0.80f, .beta = 5.0f },
+    [AUDIO_RESAMPLER_QUALITY_MEDIUM] = { .taps = 16, .cutoff = 0.86f, .beta = 7.0f },
+    [AUDIO_RESAMPLER_QUALITY_HIGH]   = { .taps = 32, .cutoff = 0.91f, .beta = 9.0f },
+};
+
+static int resampler_gcd(int a, int b)
+{
+    while (b) {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/* Zeroth order modified Bessel function of the first kind, for the Kaiser window */
+static float resampler_bessel_i0(float x)
+{
+    float sum = 1.0f;
+    float term = 1.0f;
+    float half_x = x / 2.0f;
+    for (int k = 1; k < 32; k++) {
+        term *= (half_x / k) * (half_x / k);
+        sum += term;
+        if (term < sum * 1e-9f) {
+            break;
+        }
+    }
+    return sum;
+}
+
+/**
+ * Kaiser windowed sinc, designed at the upsampled rate and split into phases.
+ * Phase p holds h[p], h[p + L], h[p + 2L]... reversed, so that output frames are a forward dot product
+ * with the oldest input first. Every phase is scaled to a DC gain of 1.
+ */
+static void resampler_design(audio_resampler_t *rs, const resampler_tier_t *tier)
+{
+    int n = rs->taps * rs->up;
+    int lower_rate = rs->in_rate < rs->out_rate ? rs->in_rate : rs->out_rate;
+    /* Cutoff in cycles per sample at the upsampled rate */
+    float fc = tier->cutoff * lower_rate / 2.0f / ((float) rs->in_rate * rs->up);
+    float center = (n - 1) / 2.0f;
+    float i0_beta = resampler_bessel_i0(tier->beta);
+    float phase_coefs[rs->taps];
+
+    for (int p = 0; p < rs->up; p++) {
+        float sum = 0.0f;
+        for (int k = 0; k < rs->taps; k++) {
+            float m = p + k * rs->up - center;
+            float r = m / center;
+            float h = (m == 0.0f) ? 2.0f * fc : sinf(2.0f * (float) M_PI * fc * m) / ((float) M_PI * m);
+            h *= resampler_bessel_i0(tier->beta * sqrtf(fmaxf(0.0f, 1.0f - r * r))) / i0_beta;
+            phase_coefs[k] = h;
+            sum += h;
+        }
+        int16_t *c = rs->coefs + p * rs->taps;
+        int32_t q_sum = 0;
+        int peak = 0;
+        for (int k = 0; k < rs->taps; k++) {
+            long q = lroundf(phase_coefs[k] / sum * 32768.0f);
+            c[rs->taps - 1 - k] = q > INT16_MAX ? INT16_MAX : (q < INT16_MIN ? INT16_MIN : q);
+            q_sum += c[rs->taps - 1 - k];
+            if (c[rs->taps - 1 - k] > c[peak]) {
+                peak = rs->taps - 1 - k;
+            }
+        }
+        /* Put the rounding error on the largest tap, so all phases have exactly the same gain */
+        c[peak] += 32768 - q_sum;
+    }
+}
+
+static void *resampler_alloc_internal(size_t size)
+{
+    /* The coefficients are read for every output frame, keep them out of PSRAM if there is room */
+    void *ptr = heap_caps_malloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!ptr) {
+        ptr = esp_audio_mem_malloc(size);
+    }
+    return ptr;
+}
+
+audio_resampler_t *audio_resampler_create(int in_rate, int out_rate, int in_channels, int out_channels,
+                                          audio_resampler_quality_t quality)
+{
+    if (in_rate <= 0 || out_rate <= 0 || in_channels < 1 || in_channels > 2 ||
+            out_channels < 1 || out_channels > 2 || quality > AUDIO_RESAMPLER_QUALITY_HIGH) {
+        ESP_LOGE(TAG, "Invalid format %d Hz %d ch -> %d Hz %d ch", in_rate, in_channels, out_rate, out_channels);
+        return NULL;
+    }
+    int gcd = resampler_gcd(in_rate, out_rate);
+    if (out_rate / gcd > RESAMPLER_MAX_PHASES) {
+        ESP_LOGE(TAG, "Ratio %d/%d needs too many phases", out_rate / gcd, in_rate / gcd);
+        return NULL;
+    }
+
+    audio_resampler_t *rs = esp_audio_mem_calloc(1, sizeof(audio_resampler_t));
+    if (!rs) {
+        ESP_LOGE(TAG, "Failed to allocate resampler");
+        return NULL;
+    }
+    rs->in_rate = in_rate;
+    rs->out_rate = out_rate;
+    rs->in_channels = in_channels;
+    rs->out_channels = out_channels;
+    rs->quality = quality;
+    rs->up = out_rate / gcd;
+    rs->down = in_rate / gcd;
+    rs->line_channels = (in_channels == 2 && out_channels == 2) ? 2 : 1;
+    if (rs->up == rs->down) {
+        /* Only the channels are converted */
+        return rs;
+    }
+
+    const resampler_tier_t *tier = &resampler_tiers[quality];
+    /* When downsampling the filter spans the same time at the input rate, so it is as long in input frames */
+    rs->taps = tier->taps * ((rs->down + rs->up - 1) / rs->up);
+    rs->coefs = resampler_alloc_internal(rs->up * rs->taps * sizeof(int16_t));
+    for (int ch = 0; ch < rs->line_channels; ch++) {
+        rs->line[ch] = esp_audio_mem_calloc(rs->taps - 1 + RESAMPLER_BLOCK_FRAMES, sizeof(int16_t));
+    }
+    if (!rs->coefs || !rs->line[0] || (rs->line_channels == 2 && !rs->line[1])) {
+        ESP_LOGE(TAG, "Failed to allocate %d taps x %d phases", rs->taps, rs->up);
+        audio_resampler_destroy(rs);
+        return NULL;
+    }
+    resampler_design(rs, tier);
+    audio_resampler_reset(rs);
+    return rs;
+}
+
+audio_resampler_t *audio_resampler_update(audio_resampler_t *rs, int in_rate, int out_rate, int in_channels,
+                                          int out_channels, audio_resampler_quality_t quality)
+{
+    if (rs && rs->in_rate == in_rate && rs->out_rate == out_rate && rs->in_channels == in_channels &&
+            rs->out_channels == out_channels && rs->quality == quality) {
+        return rs;
+    }
+    if (rs) {
+        ESP_LOGI(TAG, "Format changed to %d Hz %d ch -> %d Hz %d ch", in_rate, in_channels, out_rate, out_channels);
+    }
+    audio_resampler_destroy(rs);
+    return audio_resampler_create(in_rate, out_rate, in_channels, out_channels, quality);
+}
+
+int audio_resampler_get_max_output(audio_resampler_t *rs, int in_frames)
+{
+    if (!rs->taps) {
+        return in_frames;
+    }
+    /* Outputs are due at multiples of M in the upsampled input, up to the newest frame */
+    int pending = (rs->filled - rs->taps + 1 + in_frames) * rs->up - (rs->pos * rs->up + rs->phase);
+    return pending <= 0 ? 0 : (pending + rs->down - 1) / rs->down;
+}
+
+static inline int16_t resampler_saturate(int32_t acc)
+{
+    acc = (acc + (1 << 14)) >> 15;
+    return acc > INT16_MAX ? INT16_MAX : (acc < INT16_MIN ? INT16_MIN : acc);
+}
+
+/* Independent accumulators so the multiplies of neighbouring taps do not wait on each other */
+static inline int32_t resampler_dot(const int16_t *c, const int16_t *x, int taps)
+{
+    int32_t acc0 = 0, acc1 = 0, acc2 = 0, acc3 = 0;
+    for (int k = 0; k < taps; k += 4) {
+        acc0 += c[k] * x[k];
+        acc1 += c[k + 1] * x[k + 1];
+        acc2 += c[k + 2] * x[k + 2];
+        acc3 += c[k + 3] * x[k + 3];
+    }
+    return (acc0 + acc1) + (acc2 + acc3);
+}
+
+/* Both channels in one pass, each coefficient is loaded once */
+static inline void resampler_dot2(const int16_t *c, const int16_t *x0, const int16_t *x1, int taps,
+                                  int32_t *y0, int32_t *y1)
+{
+    int32_t a0 = 0, a1 = 0, b0 = 0, b1 = 0;
+    for (int k = 0; k < taps; k += 2) {
+        a0 += c[k] * x0[k];
+        b0 += c[k] * x1[k];
+        a1 += c[k + 1] * x0[k + 1];
+        b1 += c[k + 1] * x1[k + 1];
+    }
+    *y0 = a0 + a1;
+    *y1 = b0 + b1;
+}
+
+/* Deinterleave n frames into the line buffers, stereo is averaged if the output is mono */
+static void resampler_load(audio_resampler_t *rs, const int16_t *in, int n, int16_t *l0, int16_t *l1)
+{
+    if (rs->in_channels == 1) {
+        memcpy(l0, in, n * sizeof(int16_t));
+    } else if (rs->line_channels == 2) {
+        for (int i = 0; i < n; i++) {
+            l0[i] = in[2 * i];
+            l1[i] = in[2 * i + 1];
+        }
+    } else {
+        for (int i = 0; i < n; i++) {
+            l0[i] = (in[2 * i] + in[2 * i + 1]) >> 1;
+        }
+    }
+}
+
+static int resampler_convert_channels(audio_resampler_t *rs, const int16_t *in, int in_frames, int16_t *out)
+{
+    if (rs->in_channels == rs->out_channels) {
+        memcpy(out, in, in_frames * rs->in_channels * sizeof(int16_t));
+    } else if (rs->in_channels == 1) {
+        for (int i = 0; i < in_frames; i++) {
+            out[2 * i] = out[2 * i + 1] = in[i];
+        }
+    } else {
+        resampler_load(rs, in, in_frames, out, NULL);
+    }
+    return in_frames;
+}
+
+int audio_resampler_process(audio_resampler_t *rs, const int16_t *in, int in_frames, int16_t *out, int out_frames)
+{
+    if (out_frames < audio_resampler_get_max_output(rs, in_frames)) {
+        ESP_LOGE(TAG, "Output too small: %d frames for %d input frames", out_frames, in_frames);
+        return -1;
+    }
+    if (!rs->taps) {
+        return resampler_convert_channels(rs, in, in_frames, out);
+    }
+
+    const int taps = rs->taps;
+    const int up = rs->up;
+    const int down = rs->down;
+    const bool dup = rs->line_channels == 1 && rs->out_channels == 2;
+    int16_t *l0 = rs->line[0];
+    int16_t *l1 = rs->line[1];
+    int16_t *o = out;
+
+    while (in_frames > 0) {
+        int n = in_frames > RESAMPLER_BLOCK_FRAMES ? RESAMPLER_BLOCK_FRAMES : in_frames;
+        resampler_load(rs, in, n, l0 + rs->filled, l1 ? l1 + rs->filled : NULL);
+        rs->filled += n;
+        in += n * rs->in_channels;
+        in_frames -= n;
+
+        int pos = rs->pos;
+        int phase = rs->phase;
+        int last = rs->filled - taps;
+        while (pos <= last) {
+            const int16_t *c = rs->coefs + phase * taps;
+            if (l1) {
+                int32_t y0, y1;
+                resampler_dot2(c, l0 + pos, l1 + pos, taps, &y0, &y1);
+                o[0] = resampler_saturate(y0);
+                o[1] = resampler_saturate(y1);
+                o += 2;
+            } else {
+                int16_t y = resampler_saturate(resampler_dot(c, l0 + pos, taps));
+                o[0] = y;
+                if (dup) {
+                    o[1] = y;
+                }
+                o += rs->out_channels;
+            }
+            phase += down;
+            while (phase >= up) {
+                phase -= up;
+                pos++;
+            }
+        }
+        rs->phase = phase;
+
+        /* Keep what the next outputs still need at the front. Downsampling can step past the end. */
+        if (pos >= rs->filled) {
+            rs->pos = pos - rs->filled;
+            rs->filled = 0;
+        } else {
+            int keep = rs->filled - pos;
+            memmove(l0, l0 + pos, keep * sizeof(int16_t));
+            if (l1) {
+                memmove(l1, l1 + pos, keep * sizeof(int16_t));
+            }
+            rs->pos = 0;
+            rs->filled = keep;
+        }
+    }
+    return (o - out) / rs->out_channels;
+}
+
+int audio_resampler_get_delay(audio_resampler_t *rs)
+{
+    if (!rs->taps) {
+        return 0;
+    }
+    return (rs->taps * rs->up - 1 + rs->down) / (2 * rs->down);
+}
+
+void audio_resampler_reset(audio_resampler_t *rs)
+{
+    if (!rs->taps) {
+        return;
+    }
+    /* Start with a window of silence so the first input frame is the newest of the first output */
+    for (int ch = 0; ch < rs->line_channels; ch++) {
+        memset(rs->line[ch], 0, (rs->taps - 1) * sizeof(int16_t));
+    }
+    rs->filled = rs->taps - 1;
+    rs->pos = 0;
+    rs->phase = 0;
+}
+
+void audio_resampler_destroy(audio_resampler_t *rs)
+{
+    if (!rs) {
+        return;
+    }
+    /* heap_caps_malloc memory is released with free() as well */
+    esp_audio_mem_free(rs->coefs);
+    esp_audio_mem_free(rs->line[0]);
+    esp_audio_mem_free(rs->line[1]);
+    esp_audio_mem_free(rs);
+}
@@ -0,0 +1,149 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2019 <ESPRESSIF SYSTEMS (SHANGHAI) CO., LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef _AUDIO_RESAMPLER_H_
+#define _AUDIO_RESAMPLER_H_
+
+#include <stdint.h>
+#include <sdkconfig.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Polyphase FIR sample rate converter for 16 bit PCM.
+ *
+ * The ratio between the rates is reduced to L/M and the filter is designed when the resampler is
+ * created, so processing is a plain dot product per output frame with no table lookups or divisions.
+ * Mono to stereo and stereo to mono conversion is done in the same pass.
+ */
+
+typedef enum {
+    AUDIO_RESAMPLER_QUALITY_LOW = 0,    /* 8 taps per phase */
+    AUDIO_RESAMPLER_QUALITY_MEDIUM,     /* 16 taps per phase */
+    AUDIO_RESAMPLER_QUALITY_HIGH,       /* 32 taps per phase */
+} audio_resampler_quality_t;
+
+#if defined(CONFIG_AUDIO_RESAMPLER_QUALITY_LOW)
+#define AUDIO_RESAMPLER_QUALITY_DEFAULT AUDIO_RESAMPLER_QUALITY_LOW
+#elif defined(CONFIG_AUDIO_RESAMPLER_QUALITY_HIGH)
+#define AUDIO_RESAMPLER_QUALITY_DEFAULT AUDIO_RESAMPLER_QUALITY_HIGH
+#else
+#define AUDIO_RESAMPLER_QUALITY_DEFAULT AUDIO_RESAMPLER_QUALITY_MEDIUM
+#endif
+
+typedef struct audio_resampler audio_resampler_t;
+
+/**
+ * @brief   Create a resampler
+ *
+ * @param[in]  in_rate        sample rate of the input in Hz
+ * @param[in]  out_rate       sample rate of the output in Hz
+ * @param[in]  in_channels    channels of the input (1 or 2)
+ * @param[in]  out_channels   channels of the output (1 or 2)
+ * @param[in]  quality        filter length, see audio_resampler_quality_t
+ *
+ * @return
+ *     - resampler on success
+ *     - NULL on invalid arguments or when out of memory
+ */
+audio_resampler_t *audio_resampler_create(int in_rate, int out_rate, int in_channels, int out_channels,
+                                          audio_resampler_quality_t quality);
+
+/**
+ * @brief   Get a resampler for the given format, reusing rs if it already has it
+ *
+ * rs is destroyed and a new resampler is created when the format changed. Can be called for every buffer.
+ *
+ * @param[in]  rs             current resampler or NULL
+ * @param[in]  in_rate        sample rate of the input in Hz
+ * @param[in]  out_rate       sample rate of the output in Hz
+ * @param[in]  in_channels    channels of the input (1 or 2)
+ * @param[in]  out_channels   channels of the output (1 or 2)
+ * @param[in]  quality        filter length, see audio_resampler_quality_t
+ *
+ * @return
+ *     - resampler for the format
+ *     - NULL on invalid arguments or when out of memory, rs is destroyed in that case
+ */
+audio_resampler_t *audio_resampler_update(audio_resampler_t *rs, int in_rate, int out_rate, int in_channels,
+                                          int out_channels, audio_resampler_quality_t quality);
+
+/**
+ * @brief   Largest number of frames audio_resampler_process can write for in_frames input frames
+ *
+ * @param[in]  rs             resampler
+ * @param[in]  in_frames      number of input frames
+ *
+ * @return  number of output frames
+ */
+int audio_resampler_get_max_output(audio_resampler_t *rs, int in_frames);
+
+/**
+ * @brief   Resample interleaved 16 bit PCM
+ *
+ * All the input is consumed, the samples that are still needed for later output are kept in the resampler.
+ * in and out must not overlap.
+ *
+ * @param[in]   rs             resampler
+ * @param[in]   in             input frames
+ * @param[in]   in_frames      number of input frames
+ * @param[out]  out            output frames
+ * @param[in]   out_frames     room in out in frames, at least audio_resampler_get_max_output(rs, in_frames)
+ *
+ * @return
+ *     - number of frames written to out
+ *     - -1 when out is too small, nothing is consumed in that case
+ */
+int audio_resampler_process(audio_resampler_t *rs, const int16_t *in, int in_frames, int16_t *out, int out_frames);
+
+/**
+ * @brief   Delay of the filter in output frames
+ *
+ * @param[in]  rs             resampler
+ *
+ * @return  group delay, rounded to the nearest frame
+ */
+int audio_resampler_get_delay(audio_resampler_t *rs);
+
+/**
+ * @brief   Drop the kept samples, e.g. when the stream is restarted
+ *
+ * @param[in]  rs             resampler
+ */
+void audio_resampler_reset(audio_resampler_t *rs);
+
+/**
+ * @brief   Free a resampler
+ *
+ * @param[in]  rs             resampler or NULL
+ */
+void audio_resampler_destroy(audio_resampler_t *rs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _AUDIO_RESAMPLER_H_ */
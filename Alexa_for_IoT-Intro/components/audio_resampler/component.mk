@@ -0,0 +1,7 @@
+#
+# Component Makefile
+#
+
+COMPONENT_ADD_INCLUDEDIRS := .
+
+COMPONENT_SRCDIRS := .
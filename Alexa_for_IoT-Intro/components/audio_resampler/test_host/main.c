@@ -0,0 +1,292 @@
+// Copyright 2019 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Throughput, THD+N and latency of the resampler quality tiers for the formats the playback converts.
+ * The input is fed in random 128 to 512 byte chunks, like media_hal and sys_playback do.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <audio_resampler.h>
+#ifdef WITH_LIBCODECS
+#include <resampling.h>
+#endif
+
+#define TONE_HZ         997
+/* Close to the band edge, where the tiers differ: 0.3 of the lower sample rate */
+#define HF_TONE_RATIO   0.3
+#define TONE_AMPLITUDE  16384
+#define BENCH_SECONDS   20
+#define MAX_CHUNK_BYTES 512
+
+typedef struct {
+    int in_rate;
+    int out_rate;
+    int in_channels;
+    int out_channels;
+} format_t;
+
+static const format_t formats[] = {
+    { 16000, 48000, 1, 2 },
+    { 22050, 48000, 2, 2 },
+    { 24000, 48000, 2, 2 },
+    { 44100, 48000, 2, 2 },
+    { 48000, 48000, 2, 2 },
+    { 48000, 16000, 2, 1 },
+};
+
+/* One converter under test, either a tier of audio_resampler or the codecs library */
+typedef struct {
+    const char *name;
+    int (*process)(void *ctx, const format_t *f, int16_t *in, int in_frames, int16_t *out, int out_frames);
+    void *(*create)(const format_t *f, int tier);
+    void (*destroy)(void *ctx);
+    int tier;
+} engine_t;
+
+static void *rs_create(const format_t *f, int tier)
+{
+    return audio_resampler_create(f->in_rate, f->out_rate, f->in_channels, f->out_channels, tier);
+}
+
+static int rs_process(void *ctx, const format_t *f, int16_t *in, int in_frames, int16_t *out, int out_frames)
+{
+    return audio_resampler_process(ctx, in, in_frames, out, out_frames);
+}
+
+static void rs_destroy(void *ctx)
+{
+    audio_resampler_destroy(ctx);
+}
+
+#ifdef WITH_LIBCODECS
+static void *codecs_create(const format_t *f, int tier)
+{
+    return calloc(1, sizeof(audio_resample_config_t));
+}
+
+/* Same calls as media_hal_playback_play made */
+static int codecs_process(void *ctx, const format_t *f, int16_t *in, int in_frames, int16_t *out, int out_frames)
+{
+    int samples = in_frames * f->in_channels;
+    int out_size = out_frames * f->out_channels * sizeof(int16_t);
+    int len;
+    if (f->in_channels == f->out_channels) {
+        len = audio_resample(in, out, f->in_rate, f->out_rate, samples, out_size, f->in_channels, ctx);
+    } else if (f->in_channels == 1) {
+        len = audio_resample_up_channel(in, out, f->in_rate, f->out_rate, samples, out_size, ctx);
+    } else {
+        len = audio_resample_down_channel(in, out, f->in_rate, f->out_rate, samples, out_size, 0, ctx);
+    }
+    return len / f->out_channels;
+}
+#endif
+
+static const engine_t engines[] = {
+    { "low",    rs_process, rs_create, rs_destroy, AUDIO_RESAMPLER_QUALITY_LOW },
+    { "medium", rs_process, rs_create, rs_destroy, AUDIO_RESAMPLER_QUALITY_MEDIUM },
+    { "high",   rs_process, rs_create, rs_destroy, AUDIO_RESAMPLER_QUALITY_HIGH },
+#ifdef WITH_LIBCODECS
+    { "libcodecs", codecs_process, codecs_create, free, 0 },
+#endif
+};
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int random_chunk_frames(const format_t *f)
+{
+    int bytes = 128 + rand() % (MAX_CHUNK_BYTES - 128 + 1);
+    return bytes / (int) (f->in_channels * sizeof(int16_t));
+}
+
+/* Run in_frames of in through a new converter in random chunks. Returns the output frames. */
+static int run(const engine_t *e, const format_t *f, int16_t *in, int in_frames, int16_t *out, int out_room)
+{
+    void *ctx = e->create(f, e->tier);
+    if (!ctx) {
+        return -1;
+    }
+    int done = 0;
+    int produced = 0;
+    while (done < in_frames) {
+        int n = random_chunk_frames(f);
+        if (n > in_frames - done) {
+            n = in_frames - done;
+        }
+        int len = e->process(ctx, f, in + done * f->in_channels, n, out + produced * f->out_channels,
+                             out_room - produced);
+        if (len < 0) {
+            e->destroy(ctx);
+            return -1;
+        }
+        done += n;
+        produced += len;
+    }
+    e->destroy(ctx);
+    return produced;
+}
+
+static void fill_tone(const format_t *f, double hz, int16_t *in, int frames)
+{
+    for (int i = 0; i < frames; i++) {
+        int16_t s = lrint(TONE_AMPLITUDE * sin(2 * M_PI * hz * i / f->in_rate));
+        for (int ch = 0; ch < f->in_channels; ch++) {
+            in[i * f->in_channels + ch] = s;
+        }
+    }
+}
+
+/* Fit a tone of hz with a DC offset to the first channel and return the rest relative to it in dB */
+static double thd_n_db(const format_t *f, double hz, const int16_t *out, int start, int frames)
+{
+    double w = 2 * M_PI * hz / f->out_rate;
+    double ss = 0, cc = 0, sc = 0, s1 = 0, c1 = 0, ys = 0, yc = 0, y1 = 0;
+    int n = frames;
+    for (int i = 0; i < n; i++) {
+        double s = sin(w * (start + i)), c = cos(w * (start + i));
+        double y = out[(start + i) * f->out_channels];
+        ss += s * s; cc += c * c; sc += s * c; s1 += s; c1 += c;
+        ys += y * s; yc += y * c; y1 += y;
+    }
+    /* Solve the 3x3 normal equations for y = a sin + b cos + d */
+    double m[3][4] = { { ss, sc, s1, ys }, { sc, cc, c1, yc }, { s1, c1, n, y1 } };
+    for (int i = 0; i < 3; i++) {
+        for (int j = i + 1; j < 3; j++) {
+            double k = m[j][i] / m[i][i];
+            for (int l = i; l < 4; l++) {
+                m[j][l] -= k * m[i][l];
+            }
+        }
+    }
+    double x[3];
+    for (int i = 2; i >= 0; i--) {
+        x[i] = m[i][3];
+        for (int j = i + 1; j < 3; j++) {
+            x[i] -= m[i][j] * x[j];
+        }
+        x[i] /= m[i][i];
+    }
+    double signal = 0, noise = 0;
+    for (int i = 0; i < n; i++) {
+        double fit = x[0] * sin(w * (start + i)) + x[1] * cos(w * (start + i));
+        double r = out[(start + i) * f->out_channels] - fit - x[2];
+        signal += fit * fit;
+        noise += r * r;
+    }
+    return 10 * log10(noise / signal);
+}
+
+/* Output frame of the peak of a unit impulse, in the first channel */
+static int impulse_peak(const engine_t *e, const format_t *f, int16_t *in, int16_t *out, int out_room)
+{
+    int frames = f->in_rate / 10;
+    memset(in, 0, frames * f->in_channels * sizeof(int16_t));
+    for (int ch = 0; ch < f->in_channels; ch++) {
+        in[ch] = TONE_AMPLITUDE;
+    }
+    int len = run(e, f, in, frames, out, out_room);
+    int peak = 0;
+    for (int i = 1; i < len; i++) {
+        if (abs(out[i * f->out_channels]) > abs(out[peak * f->out_channels])) {
+            peak = i;
+        }
+    }
+    return peak;
+}
+
+/* Output of the whole input in one call has to match the chunked output */
+static int check_chunking(const format_t *f, int tier, int16_t *in, int in_frames, int16_t *out, int out_room)
+{
+    audio_resampler_t *rs = audio_resampler_create(f->in_rate, f->out_rate, f->in_channels, f->out_channels, tier);
+    int16_t *whole = malloc(out_room * f->out_channels * sizeof(int16_t));
+    int whole_len = audio_resampler_process(rs, in, in_frames, whole, out_room);
+    int expected = audio_resampler_get_max_output(rs, 0) == 0 ? whole_len : -1;
+    audio_resampler_destroy(rs);
+
+    engine_t e = { "chunked", rs_process, rs_create, rs_destroy, tier };
+    int len = run(&e, f, in, in_frames, out, out_room);
+    int ok = len == expected && memcmp(whole, out, len * f->out_channels * sizeof(int16_t)) == 0;
+    free(whole);
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    int failed = 0;
+    srand(1);
+
+    printf("%-22s %-9s %8s %8s %10s %10s %10s\n", "format", "tier", "Msps", "x rt", "THD+N dB", "HF THD+N", "delay ms");
+    for (int i = 0; i < (int) (sizeof(formats) / sizeof(formats[0])); i++) {
+        const format_t *f = &formats[i];
+        int in_frames = f->in_rate * BENCH_SECONDS;
+        int out_room = (int) ((long long) in_frames * f->out_rate / f->in_rate) + 1024;
+        int16_t *in = malloc(in_frames * f->in_channels * sizeof(int16_t));
+        int16_t *out = malloc(out_room * f->out_channels * sizeof(int16_t));
+        char name[32];
+        snprintf(name, sizeof(name), "%d/%d -> %d/%d", f->in_rate, f->in_channels, f->out_rate, f->out_channels);
+
+        for (int j = 0; j < (int) (sizeof(engines) / sizeof(engines[0])); j++) {
+            const engine_t *e = &engines[j];
+            fill_tone(f, TONE_HZ, in, in_frames);
+            double start = now_sec();
+            int len = run(e, f, in, in_frames, out, out_room);
+            double elapsed = now_sec() - start;
+            if (len < 0) {
+                printf("%-22s %-9s failed\n", name, e->name);
+                failed++;
+                continue;
+            }
+            /* Skip the first 100 ms, the filter is still filling up there */
+            int skip = f->out_rate / 10;
+            double thd_n = thd_n_db(f, TONE_HZ, out, skip, len - skip);
+            double msps = (double) len * f->out_channels / elapsed / 1e6;
+            double hf_hz = HF_TONE_RATIO * (f->in_rate < f->out_rate ? f->in_rate : f->out_rate);
+            fill_tone(f, hf_hz, in, f->in_rate);
+            len = run(e, f, in, f->in_rate, out, out_room);
+            double hf_thd_n = thd_n_db(f, hf_hz, out, skip, len - skip);
+            int peak = impulse_peak(e, f, in, out, out_room);
+            printf("%-22s %-9s %8.1f %8.0f %10.1f %10.1f %10.2f\n", name, e->name, msps, BENCH_SECONDS / elapsed,
+                   thd_n, hf_thd_n, peak * 1000.0 / f->out_rate);
+
+            if (e->process == rs_process) {
+                fill_tone(f, TONE_HZ, in, in_frames);
+                if (!check_chunking(f, e->tier, in, f->in_rate, out, out_room)) {
+                    printf("%-22s %-9s chunked output differs\n", name, e->name);
+                    failed++;
+                }
+                audio_resampler_t *rs = rs_create(f, e->tier);
+                int delay = audio_resampler_get_delay(rs);
+                audio_resampler_destroy(rs);
+                if (abs(delay - peak) > 1) {
+                    printf("%-22s %-9s delay %d frames, impulse peak at %d\n", name, e->name, delay, peak);
+                    failed++;
+                }
+            }
+        }
+        free(in);
+        free(out);
+    }
+    printf(failed ? "%d checks failed\n" : "All checks passed\n", failed);
+    return failed ? 1 : 0;
+}
@@ -479,6 +479,32 @@ static int basic_player_i2s_read_cb(void *arg, void *data, int len, unsigned int
     return ret;
 }
 
+static int basic_player_i2s_acquire_read_cb(void *arg, void **data, int len, unsigned int wait)
+{
+    int ret;
+    rb_region_t region;
+    struct basic_player *b = (struct basic_player *)arg;
+    ret = arb_acquire_read(b->codec_output_rb, &region, len, wait);
+    if (ret > 0) {
+        /* Hand out only the contiguous part. The wrapped part is picked up on the next call. */
+        *data = region.ptr;
+        return region.len;
+    }
+    /* Same handling as `basic_player_i2s_read_cb` */
+    if (ret == RB_FETCH_ANCHOR) {
+        b->player_event_cb(b->player_event_cb_data, PLAYER_EVENT_FETCH_ANCHOR);
+    } else if (ret < 0 && ret != RB_READER_UNBLOCK) {
+        basic_player_wait_for_stop_and_reset(arg);
+    }
+    return ret;
+}
+
+static void basic_player_i2s_release_read_cb(void *arg, int len)
+{
+    struct basic_player *b = (struct basic_player *)arg;
+    arb_release_read(b->codec_output_rb, len);
+}
+
 static void basic_player_i2s_wakeup_reader_cb(void *arg)
 {
     struct basic_player *b = (struct basic_player *)arg;
@@ -546,6 +572,11 @@ basic_player_handle_t basic_player_create(basic_player_cfg_t *basic_player_cfg)
     b->requester.read_cb = basic_player_i2s_read_cb;
     b->requester.wakeup_reader_cb = basic_player_i2s_wakeup_reader_cb;
     b->requester.cb_data = (void *)b;
+    if (basic_player_cfg->rb_cfg.func.acquire_read && basic_player_cfg->rb_cfg.func.release_read) {
+        /* Let sys_playback resample/play straight out of codec_output_rb */
+        b->requester.acquire_read_cb = basic_player_i2s_acquire_read_cb;
+        b->requester.release_read_cb = basic_player_i2s_release_read_cb;
+    }
 
     if (basic_player_cfg->codec_output_rb_size == 0) {
         ESP_LOGW(TAG, "No codec output rb size provided. Setting default to %d KB.", DEFAULT_CODEC_OUTPUT_RB_SIZE / 1024);
@@ -566,7 +597,10 @@ basic_player_handle_t basic_player_create(basic_player_cfg_t *basic_player_cfg)
             basic_player_cfg->http_output_rb_size = DEFAULT_HTTP_OUTPUT_RB_SIZE;
         }
 
-        b->http_output_rb = arb_init("http_output_rb", basic_player_cfg->http_output_rb_size, basic_player_cfg->rb_cfg);
+        /* The SPSC type allocates the next power of two of `http_output_rb_size`, e.g. 128 KB for
+         * 100 KB. The default size is one already, other sizes may cost up to twice their memory */
+        abstract_rb_cfg_t http_rb_cfg = basic_player_cfg->http_rb_cfg.func.init ? basic_player_cfg->http_rb_cfg : basic_player_cfg->rb_cfg;
+        b->http_output_rb = arb_init("http_output_rb", basic_player_cfg->http_output_rb_size, http_rb_cfg);
         if (!b->http_output_rb) {
             ESP_LOGE(TAG, "arb_init failed for http_output of size: %d", basic_player_cfg->http_output_rb_size);
             goto error;
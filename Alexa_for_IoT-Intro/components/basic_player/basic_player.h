@@ -10,13 +10,15 @@
 #include "sys_playback.h"
 
 #define DEFAULT_CODEC_OUTPUT_RB_SIZE (40 * 1024)
-#define DEFAULT_HTTP_OUTPUT_RB_SIZE (100 * 1024)
+/* A power of two, as the SPSC type of `http_rb_cfg` would round it up to one */
+#define DEFAULT_HTTP_OUTPUT_RB_SIZE (128 * 1024)
 
 #define DEFAULT_BASIC_PLAYER_CONFIG() {                     \
     .http_support = false,                                  \
     .codec_output_rb_size = DEFAULT_CODEC_OUTPUT_RB_SIZE,   \
     .http_output_rb_size = 0,                               \
-    .rb_cfg = DEFAULT_RB_TYPE_BASIC_FUNC()                  \
+    .rb_cfg = DEFAULT_RB_TYPE_BASIC_FUNC(),                 \
+    .http_rb_cfg = DEFAULT_RB_TYPE_SPSC_FUNC()              \
 }
 
 /**
@@ -49,6 +51,10 @@ typedef struct basic_player_config {
     uint32_t codec_output_rb_size;
     uint32_t http_output_rb_size;
     abstract_rb_cfg_t rb_cfg;
+    /* Type of `http_output_rb`, `rb_cfg` is used when not set. The http stream task is its only
+     * writer and the codec task its only reader, so the lock-free SPSC type fits. The SPSC type
+     * rounds the size up to a power of two. */
+    abstract_rb_cfg_t http_rb_cfg;
 } basic_player_cfg_t;
 
 enum basic_player_play_method {
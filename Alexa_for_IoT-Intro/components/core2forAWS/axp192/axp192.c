@@ -3,13 +3,70 @@
 #include "stdio.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 
 #define VALUE_LIMIT(x, min, max) (((x) < min) ? min : (((x) > max) ? max : (x))) 
 
+/* ADC registers read in one burst for the telemetry, from ACIN voltage to battery discharge current */
+#define AXP192_TELEMETRY_FIRST_REG  AXP192_ACIN_ADC_VOLTAGE_REG
+#define AXP192_TELEMETRY_LAST_REG   (AXP192_BAT_ADC_CURRENT_OUT_REG + 1)
+#define AXP192_TELEMETRY_AT(buf, reg) (&(buf)[(reg) - AXP192_TELEMETRY_FIRST_REG])
+
+static Axp192_Telemetry_t telemetry;
+static TickType_t telemetry_tick;
+static bool telemetry_valid;
+static SemaphoreHandle_t telemetry_mutex;
+
 void Axp192_Init() {
+    if (telemetry_mutex == NULL) {
+        telemetry_mutex = xSemaphoreCreateMutex();
+    }
     Axp192_I2CInit();
 }
 
+void Axp192_BeginUpdate() {
+    Axp192_I2CBeginBatch();
+}
+
+void Axp192_EndUpdate() {
+    Axp192_I2CEndBatch();
+}
+
+void Axp192_GetI2CStats(uint32_t *reads, uint32_t *writes) {
+    Axp192_I2CGetStats(reads, writes);
+}
+
+static uint16_t Axp192_Decode12Bit(const uint8_t *buf) {
+    return (buf[0] << 4) | (buf[1] & 0x0F);
+}
+
+static uint16_t Axp192_Decode13Bit(const uint8_t *buf) {
+    return (buf[0] << 5) | (buf[1] & 0x1F);
+}
+
+void Axp192_GetTelemetry(Axp192_Telemetry_t *out, uint32_t max_age_ms) {
+    uint8_t buf[AXP192_TELEMETRY_LAST_REG - AXP192_TELEMETRY_FIRST_REG + 1];
+
+    xSemaphoreTake(telemetry_mutex, portMAX_DELAY);
+    if (!telemetry_valid || (xTaskGetTickCount() - telemetry_tick) > pdMS_TO_TICKS(max_age_ms)) {
+        if (Axp192_ReadBytes(AXP192_TELEMETRY_FIRST_REG, buf, sizeof(buf))) {
+            telemetry.acin_volt = 1.7 / 1000.0 * Axp192_Decode12Bit(AXP192_TELEMETRY_AT(buf, AXP192_ACIN_ADC_VOLTAGE_REG));
+            telemetry.acin_current = 0.625 * Axp192_Decode12Bit(AXP192_TELEMETRY_AT(buf, AXP192_ACIN_ADC_CURRENT_REG));
+            telemetry.vbus_volt = 1.7 / 1000.0 * Axp192_Decode12Bit(AXP192_TELEMETRY_AT(buf, AXP192_VBUS_ADC_VOLTAGE_REG));
+            telemetry.vbus_current = 0.375 * Axp192_Decode12Bit(AXP192_TELEMETRY_AT(buf, AXP192_VBUS_ADC_CURRENT_REG));
+            telemetry.temp = -144.7 + 0.1 * Axp192_Decode12Bit(AXP192_TELEMETRY_AT(buf, AXP192_INTERNAL_TEMP_REG));
+            telemetry.bat_volt = 1.1 / 1000.0 * Axp192_Decode12Bit(AXP192_TELEMETRY_AT(buf, AXP192_BAT_ADC_VOLTAGE_REG));
+            uint16_t current_in = Axp192_Decode13Bit(AXP192_TELEMETRY_AT(buf, AXP192_BAT_ADC_CURRENT_IN_REG));
+            uint16_t current_out = Axp192_Decode13Bit(AXP192_TELEMETRY_AT(buf, AXP192_BAT_ADC_CURRENT_OUT_REG));
+            telemetry.bat_current = 0.5 * (current_in - current_out);
+            telemetry_tick = xTaskGetTickCount();
+            telemetry_valid = true;
+        }
+    }
+    *out = telemetry;
+    xSemaphoreGive(telemetry_mutex);
+}
+
 void Axp192_EnableLDODCExt(uint8_t value) {
     uint8_t data = Axp192_Read8Bit(AXP192_LDO23_DC123_EXT_CTL_REG);
     data &= 0xa0;
@@ -104,35 +161,39 @@ void Axp192_EnablePWRONShortWake() {
 }
 
 float Axp192_GetVbusVolt() {
-    float ADCLSB = 1.7 / 1000.0;
-    return ADCLSB * Axp192_Read12Bit(AXP192_VBUS_ADC_VOLTAGE_REG);
+    Axp192_Telemetry_t t;
+    Axp192_GetTelemetry(&t, AXP192_ADC_PERIOD_MS);
+    return t.vbus_volt;
 }
  
 float Axp192_GetAcinVolt() {
-    float ADCLSB = 1.7 / 1000.0;
-    return ADCLSB * Axp192_Read12Bit(AXP192_ACIN_ADC_VOLTAGE_REG);
+    Axp192_Telemetry_t t;
+    Axp192_GetTelemetry(&t, AXP192_ADC_PERIOD_MS);
+    return t.acin_volt;
 }
  
 float Axp192_GetBatVolt() {
-    float ADCLSB = 1.1 / 1000.0;
-    return ADCLSB * Axp192_Read12Bit(AXP192_BAT_ADC_VOLTAGE_REG);
+    Axp192_Telemetry_t t;
+    Axp192_GetTelemetry(&t, AXP192_ADC_PERIOD_MS);
+    return t.bat_volt;
 }
  
 float Axp192_GetVbusCurrent() {
-    float ADCLSB = 0.375;
-    return ADCLSB * Axp192_Read12Bit(AXP192_VBUS_ADC_CURRENT_REG);
+    Axp192_Telemetry_t t;
+    Axp192_GetTelemetry(&t, AXP192_ADC_PERIOD_MS);
+    return t.vbus_current;
 }
  
 float Axp192_GetAcinCurrent() {
-    float ADCLSB = 0.625;
-    return ADCLSB * Axp192_Read12Bit(AXP192_ACIN_ADC_CURRENT_REG);
+    Axp192_Telemetry_t t;
+    Axp192_GetTelemetry(&t, AXP192_ADC_PERIOD_MS);
+    return t.acin_current;
 }
  
 float Axp192_GetBatCurrent() {
-    float ADCLSB = 0.5;
-    uint16_t current_in = Axp192_Read13Bit(AXP192_BAT_ADC_CURRENT_IN_REG);
-    uint16_t current_out = Axp192_Read13Bit(AXP192_BAT_ADC_CURRENT_OUT_REG);
-    return ADCLSB * (current_in - current_out);
+    Axp192_Telemetry_t t;
+    Axp192_GetTelemetry(&t, AXP192_ADC_PERIOD_MS);
+    return t.bat_current;
 }
  
 void Axp192_EnableCharge(uint16_t state) {
@@ -238,8 +299,10 @@ void Axp192_SetGPIO2Level(uint8_t level) {
 }
 
 void Axp192_SetGPIO4Mode(uint8_t mode) {
+    Axp192_I2CBeginBatch();
     Axp192_WriteBits(AXP192_GPIO34_CTL_REG, 0x01, 2, 2);
     Axp192_WriteBits(AXP192_GPIO34_CTL_REG, 0x01, 7, 1);
+    Axp192_I2CEndBatch();
 }
 
 void Axp192_SetGPIO4Level(uint8_t level) {
@@ -45,6 +45,10 @@ typedef struct _Button_t  {
  * 
  * @note The Core2ForAWS_Init() calls this function
  * when the hardware feature is enabled.
+ *
+ * The buttons subscribe to the FT6336U touch events. There is no
+ * task, the events queued since the last call are applied to the
+ * buttons by each of the functions checking a button.
  */
 /* @[declare_button_init] */
 void Button_Init();
@@ -20,6 +20,7 @@
 
 SemaphoreHandle_t spi_mutex;
 
+static void IRAM_ATTR spi_pre (spi_transaction_t *trans);
 static void IRAM_ATTR spi_ready (spi_transaction_t *trans);
 
 static spi_host_device_t spi_host;
@@ -50,6 +51,9 @@ void disp_spi_add_device_config(spi_host_device_t host, spi_device_interface_con
     spi_host=host;
     chained_post_cb=devcfg->post_cb;
     devcfg->post_cb=spi_ready;
+    if (devcfg->pre_cb == NULL) {
+        devcfg->pre_cb=spi_pre;
+    }
     esp_err_t ret=spi_bus_add_device(host, devcfg, &spi);
     assert(ret==ESP_OK);
 }
@@ -65,7 +69,7 @@ void disp_spi_add_device(spi_host_device_t host) {
         .mode = 0,
         .spics_io_num=CONFIG_LV_DISP_SPI_CS,              // CS pin
         .input_delay_ns=0,
-        .queue_size=1,
+        .queue_size=DISP_SPI_QUEUE_SIZE,
         .pre_cb=NULL,
         .post_cb=NULL,
         .flags = SPI_DEVICE_NO_DUMMY,
@@ -144,6 +148,25 @@ void disp_spi_transaction(const uint8_t *data, size_t length,
     }
 }
 
+void disp_spi_queue_batch(spi_transaction_t *trans, size_t count) {
+    assert(count <= DISP_SPI_QUEUE_SIZE);
+    assert(((disp_spi_send_flag_t) trans[count - 1].user) & DISP_SPI_SIGNAL_FLUSH);
+
+    /* Wait for previous pending transaction results */
+    disp_wait_for_pending_transactions();
+
+    xSemaphoreTake(spi_mutex, portMAX_DELAY);
+    spi_device_acquire_bus(spi, portMAX_DELAY);
+    gpio_set_level(CONFIG_LV_DISP_SPI_CS, 0);
+
+    for (size_t i = 0; i < count; i++) {
+        spi_pending_trans++;
+        if (spi_device_queue_trans(spi, &trans[i], portMAX_DELAY) != ESP_OK) {
+            spi_pending_trans--; /* Clear wait state */
+        }
+    }
+}
+
 void disp_wait_for_pending_transactions(void) {
     spi_transaction_t *presult;
 
@@ -154,6 +177,16 @@ void disp_wait_for_pending_transactions(void) {
     }
 }
 
+static void IRAM_ATTR spi_pre(spi_transaction_t *trans) {
+    disp_spi_send_flag_t flags = (disp_spi_send_flag_t) trans->user;
+
+    if (flags & DISP_SPI_DC_COMMAND) {
+        gpio_set_level(ILI9341_DC, 0);
+    } else if (flags & DISP_SPI_DC_DATA) {
+        gpio_set_level(ILI9341_DC, 1);
+    }
+}
+
 static void IRAM_ATTR spi_ready(spi_transaction_t *trans) {
     disp_spi_send_flag_t flags = (disp_spi_send_flag_t) trans->user;
     int higher_priority_task_awoken = pdFALSE;
@@ -161,7 +194,7 @@ static void IRAM_ATTR spi_ready(spi_transaction_t *trans) {
     if (flags & DISP_SPI_SIGNAL_FLUSH) {
         lv_disp_t * disp = NULL;
         disp = _lv_refr_get_disp_refreshing();
-        lv_disp_flush_ready(&disp->driver);
+        disp_driver_flush_ready(&disp->driver);
 
     }
 
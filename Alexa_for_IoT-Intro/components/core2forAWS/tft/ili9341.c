@@ -9,6 +9,7 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
+#include <string.h>
 #include "ili9341.h"
 #include "disp_spi.h"
 #include "driver/gpio.h"
@@ -35,15 +36,27 @@ typedef struct {
  *  STATIC PROTOTYPES
  **********************/
 static void ili9341_set_orientation(uint8_t orientation);
+static void ili9341_prepare_flush(void);
 
 static void ili9341_send_cmd(uint8_t cmd);
 static void ili9341_send_data(void * data, uint16_t length);
-static void ili9341_send_color(void * data, uint16_t length);
 
 /**********************
  *  STATIC VARIABLES
  **********************/
 
+/* CASET, PASET and RAMWR with their data, queued together on every flush */
+enum {
+	FLUSH_CASET_CMD,
+	FLUSH_CASET_DATA,
+	FLUSH_PASET_CMD,
+	FLUSH_PASET_DATA,
+	FLUSH_RAMWR_CMD,
+	FLUSH_COLORS,
+	FLUSH_TRANS_NUM,
+};
+static spi_transaction_t flush_trans[FLUSH_TRANS_NUM];
+
 /**********************
  *      MACROS
  **********************/
@@ -106,35 +119,34 @@ void ili9341_init(void)
 	}
 	ili9341_set_orientation(2);
 	ili9341_send_cmd(0x21);
+
+	ili9341_prepare_flush();
 }
 
 void ili9341_flush(lv_disp_drv_t * drv, const lv_area_t * area, lv_color_t * color_map)
 {
-	uint8_t data[4];
+	/*The transactions of the previous flush are owned by the SPI driver until they are done*/
+	disp_wait_for_pending_transactions();
 
 	/*Column addresses*/
-	ili9341_send_cmd(0x2A);
-	data[0] = (area->x1 >> 8) & 0xFF;
-	data[1] = area->x1 & 0xFF;
-	data[2] = (area->x2 >> 8) & 0xFF;
-	data[3] = area->x2 & 0xFF;
-	ili9341_send_data(data, 4);
+	flush_trans[FLUSH_CASET_DATA].tx_data[0] = (area->x1 >> 8) & 0xFF;
+	flush_trans[FLUSH_CASET_DATA].tx_data[1] = area->x1 & 0xFF;
+	flush_trans[FLUSH_CASET_DATA].tx_data[2] = (area->x2 >> 8) & 0xFF;
+	flush_trans[FLUSH_CASET_DATA].tx_data[3] = area->x2 & 0xFF;
 
 	/*Page addresses*/
-	ili9341_send_cmd(0x2B);
-	data[0] = (area->y1 >> 8) & 0xFF;
-	data[1] = area->y1 & 0xFF;
-	data[2] = (area->y2 >> 8) & 0xFF;
-	data[3] = area->y2 & 0xFF;
-	ili9341_send_data(data, 4);
-
-	/*Memory write*/
-	ili9341_send_cmd(0x2C);
-
+	flush_trans[FLUSH_PASET_DATA].tx_data[0] = (area->y1 >> 8) & 0xFF;
+	flush_trans[FLUSH_PASET_DATA].tx_data[1] = area->y1 & 0xFF;
+	flush_trans[FLUSH_PASET_DATA].tx_data[2] = (area->y2 >> 8) & 0xFF;
+	flush_trans[FLUSH_PASET_DATA].tx_data[3] = area->y2 & 0xFF;
 
+	/*Memory write, DMA'd while LVGL renders into the other buffer*/
 	uint32_t size = lv_area_get_width(area) * lv_area_get_height(area);
 
-	ili9341_send_color((void*)color_map, size * 2);
+	flush_trans[FLUSH_COLORS].tx_buffer = color_map;
+	flush_trans[FLUSH_COLORS].length = size * 2 * 8;
+
+	disp_spi_queue_batch(flush_trans, FLUSH_TRANS_NUM);
 }
 
 void ili9341_sleep_in()
@@ -170,11 +182,21 @@ static void ili9341_send_data(void * data, uint16_t length)
     disp_spi_send_data(data, length);
 }
 
-static void ili9341_send_color(void * data, uint16_t length)
+static void ili9341_prepare_flush(void)
 {
-    disp_wait_for_pending_transactions();
-    gpio_set_level(ILI9341_DC, 1);   /*Data mode*/
-    disp_spi_send_colors(data, length);
+    memset(flush_trans, 0, sizeof(flush_trans));
+
+    flush_trans[FLUSH_CASET_CMD].tx_data[0] = 0x2A;
+    flush_trans[FLUSH_PASET_CMD].tx_data[0] = 0x2B;
+    flush_trans[FLUSH_RAMWR_CMD].tx_data[0] = 0x2C;
+    for (int i = FLUSH_CASET_CMD; i <= FLUSH_RAMWR_CMD; i++) {
+        /*Commands are one byte, addresses four*/
+        bool is_cmd = (i == FLUSH_CASET_CMD || i == FLUSH_PASET_CMD || i == FLUSH_RAMWR_CMD);
+        flush_trans[i].flags = SPI_TRANS_USE_TXDATA;
+        flush_trans[i].length = (is_cmd ? 1 : 4) * 8;
+        flush_trans[i].user = (void *) (is_cmd ? DISP_SPI_DC_COMMAND : DISP_SPI_DC_DATA);
+    }
+    flush_trans[FLUSH_COLORS].user = (void *) (DISP_SPI_DC_DATA | DISP_SPI_SIGNAL_FLUSH);
 }
 
 static void ili9341_set_orientation(uint8_t orientation)
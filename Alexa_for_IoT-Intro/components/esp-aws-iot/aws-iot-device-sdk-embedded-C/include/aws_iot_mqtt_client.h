@@ -91,6 +91,8 @@ typedef struct {
 	uint16_t id;		///< Message sequence identifier.  Handled automatically by the MQTT client.
 	void *payload;		///< Pointer to MQTT message payload (bytes).
 	size_t payloadLen;	///< Length of MQTT payload.
+	size_t payloadOffset;	///< Incoming messages only. Where payload starts within the whole payload when the message is delivered in fragments, 0 otherwise.
+	size_t totalPayloadLen;	///< Incoming messages only. Length of the whole payload, more than payloadLen when the message is delivered in fragments.
 } IoT_Publish_Message_Params;
 
 /**
@@ -241,8 +243,129 @@ typedef struct _MessageHandlers {
 	QoS qos; ///< QoS of subscription
 	pApplicationHandler_t pApplicationHandler; ///< Application function to invoke
 	void *pApplicationHandlerData; ///< Context to pass to application handler
+	bool acceptsFragments; ///< Whether messages too large for the read buffer are delivered in fragments rather than dropped
 } MessageHandlers;   /* Message handlers are indexed by subscription topic */
 
+/**
+ * @brief Publish Completion Callback Handler Type
+ *
+ * Defining a TYPE for definition of the callbacks of QoS 1 messages sent with
+ * aws_iot_mqtt_publish_async. Called from the MQTT API that reads the PUBACK,
+ * normally aws_iot_mqtt_yield, with SUCCESS, or with the error that ended the
+ * message's delivery.
+ *
+ */
+typedef void (*pPublishCompletionHandler_t)(AWS_IoT_Client *pClient, uint16_t packetId, IoT_Error_t result,
+											void *pCompletionHandlerData);
+
+/** Number of QoS 1 messages aws_iot_mqtt_publish_async can keep waiting for their PUBACK */
+#ifndef AWS_IOT_MQTT_MAX_INFLIGHT_PUBLISH
+#define AWS_IOT_MQTT_MAX_INFLIGHT_PUBLISH 16
+#endif
+
+/** Time an in-flight message waits for its PUBACK before it is sent again with the DUP flag */
+#ifndef AWS_IOT_MQTT_PUBLISH_RETRANSMIT_MS
+#define AWS_IOT_MQTT_PUBLISH_RETRANSMIT_MS 5000
+#endif
+
+/** Number of times an in-flight message is sent again before it completes with MQTT_REQUEST_TIMEOUT_ERROR */
+#ifndef AWS_IOT_MQTT_PUBLISH_MAX_RETRANSMITS
+#define AWS_IOT_MQTT_PUBLISH_MAX_RETRANSMITS 3
+#endif
+
+/** Smallest payload sent from the application's buffer instead of being copied into the TX buffer.
+ *  Only used when the network layer has a writev function. */
+#ifndef AWS_IOT_MQTT_PUBLISH_GATHER_MIN_PAYLOAD
+#define AWS_IOT_MQTT_PUBLISH_GATHER_MIN_PAYLOAD 256
+#endif
+
+/**
+ * @brief In-flight QoS 1 Message
+ *
+ * A message sent with aws_iot_mqtt_publish_async whose PUBACK has not arrived
+ * yet. Topic and payload are not copied, they belong to the application until
+ * the completion handler is called.
+ *
+ */
+typedef struct _PublishInFlight {
+	uint16_t packetId; ///< Packet identifier of the message, 0 if the entry is free
+	const char *pTopicName; ///< Topic the message is published to
+	uint16_t topicNameLen; ///< Length of the topic
+	const void *pPayload; ///< Payload of the message
+	size_t payloadLen; ///< Length of the payload
+	uint8_t isRetained; ///< Retained flag of the message
+	uint8_t retransmitCount; ///< How many times the message was sent again
+	Timer retransmitTimer; ///< Time left until the message is sent again
+	pPublishCompletionHandler_t pCompletionHandler; ///< Application function to invoke on completion
+	void *pCompletionHandlerData; ///< Context to pass to the completion handler
+} PublishInFlight;
+
+/** Number of buckets in the hash table of exact (wildcard free) topic filters */
+#ifndef AWS_IOT_MQTT_SUBSCRIPTION_HASH_BUCKETS
+#define AWS_IOT_MQTT_SUBSCRIPTION_HASH_BUCKETS ((2 * AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS) + 1)
+#endif
+
+/** Number of nodes available to the trie of wildcard topic filters, including the root */
+#ifndef AWS_IOT_MQTT_SUBSCRIPTION_TRIE_NODES
+#define AWS_IOT_MQTT_SUBSCRIPTION_TRIE_NODES ((4 * AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS) + 1)
+#endif
+
+/**
+ * @brief Topic Filter Trie Node
+ *
+ * One topic level of a wildcard subscription. Levels are kept as a hash so the
+ * trie never points into application owned topic strings. A hash collision only
+ * yields an extra candidate, every candidate is confirmed against its filter.
+ *
+ */
+typedef struct _SubscriptionTrieNode {
+	uint32_t labelHash; ///< Hash of the topic level this node matches
+	uint16_t labelLen; ///< Length of the topic level this node matches
+	uint16_t parent; ///< Index of the parent node
+	uint16_t firstChild; ///< First literal child, 0 if none
+	uint16_t nextSibling; ///< Next literal child of the parent, or next free node
+	uint16_t plusChild; ///< Child for a '+' level, 0 if none
+	uint16_t refCount; ///< Number of filters going through this node
+	uint16_t exactHead; ///< 1 based index of the first handler whose filter ends here, 0 if none
+	uint16_t hashHead; ///< 1 based index of the first handler whose filter ends here with "/#", 0 if none
+} SubscriptionTrieNode;
+
+/**
+ * @brief Per Handler Subscription Index Entry
+ *
+ * Book keeping for one entry of the indexed MessageHandlers table.
+ *
+ */
+typedef struct _SubscriptionIndexEntry {
+	uint32_t hash; ///< Hash of the topic filter, for exact filters
+	uint16_t node; ///< Trie node the filter ends at, for wildcard filters
+	uint16_t next; ///< 1 based index of the next handler in the same list, 0 if none
+	uint8_t kind; ///< How the handler is indexed
+} SubscriptionIndexEntry;
+
+/**
+ * @brief MQTT Subscription Index
+ *
+ * Lookup structure over a MessageHandlers table so an incoming PUBLISH does not
+ * have to be compared against every subscription. Exact topic filters live in an
+ * open addressed hash table, filters with whole level '+' and trailing '#'
+ * wildcards in a level by level trie. Anything else is matched by a linear scan
+ * of the (normally empty) fallback list. All storage is provided by the caller.
+ *
+ */
+typedef struct _SubscriptionIndex {
+	MessageHandlers *pHandlers; ///< Handler table being indexed
+	SubscriptionIndexEntry *pEntries; ///< One entry per handler
+	uint16_t handlerCount; ///< Number of handlers in pHandlers
+	uint16_t *pBuckets; ///< Hash table of 1 based handler indexes, 0 if empty
+	uint16_t bucketCount; ///< Number of buckets, must be larger than handlerCount
+	SubscriptionTrieNode *pNodes; ///< Trie node pool, node 0 is the root
+	uint16_t nodeCount; ///< Number of nodes in pNodes
+	uint16_t freeNodeHead; ///< First free node, 0 if none
+	uint16_t freeNodeCount; ///< Number of free nodes
+	uint16_t fallbackHead; ///< 1 based index of the first handler matched linearly, 0 if none
+} SubscriptionIndex;
+
 /**
  * @brief MQTT Client Status
  *
@@ -254,6 +377,7 @@ typedef struct _ClientStatus {
 	ClientState clientState; ///< The current state of the client's state machine
 	bool isPingOutstanding; ///< Whether this client is waiting for a ping response
 	bool isAutoReconnectEnabled; ///< Whether auto-reconnect is enabled for this client
+	volatile bool isYieldWakeupPending; ///< Whether aws_iot_mqtt_yield_wakeup was called since the last yield returned
 } ClientStatus;
 
 /**
@@ -292,6 +416,13 @@ typedef struct _ClientData {
 	IoT_Client_Connect_Params options; ///< Options passed when the client was initialized
 
 	MessageHandlers messageHandlers[AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS]; ///< Callbacks for incoming messages
+	SubscriptionIndex subscriptionIndex; ///< Lookup structure over messageHandlers
+	SubscriptionIndexEntry subscriptionEntries[AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS]; ///< Storage for subscriptionIndex
+	uint16_t subscriptionBuckets[AWS_IOT_MQTT_SUBSCRIPTION_HASH_BUCKETS]; ///< Storage for subscriptionIndex
+	SubscriptionTrieNode subscriptionNodes[AWS_IOT_MQTT_SUBSCRIPTION_TRIE_NODES]; ///< Storage for subscriptionIndex
+	PublishInFlight publishInFlight[AWS_IOT_MQTT_MAX_INFLIGHT_PUBLISH]; ///< QoS 1 messages waiting for their PUBACK
+	uint16_t publishInFlightCount; ///< Number of used entries in publishInFlight
+	uint16_t publishWindow; ///< Number of messages that may be in flight at the same time
 	iot_disconnect_handler disconnectHandler; ///< Callback when a disconnection is detected
 	void *disconnectHandlerData; ///< Context for disconnect handler
 } ClientData;
@@ -319,6 +450,7 @@ struct _Client {
  * @functionpage{aws_iot_mqtt_get_client_state,mqtt,get_client_state}
  * @functionpage{aws_iot_is_autoreconnect_enabled,mqtt,is_autoreconnect_enabled}
  * @functionpage{aws_iot_mqtt_set_disconnect_handler,mqtt,set_disconnect_handler}
+ * @functionpage{aws_iot_mqtt_set_publish_window,mqtt,set_publish_window}
  * @functionpage{aws_iot_mqtt_autoreconnect_set_status,mqtt,autoreconnect_set_status}
  * @functionpage{aws_iot_mqtt_get_network_disconnected_count,mqtt,get_network_disconnected_count}
  * @functionpage{aws_iot_mqtt_reset_network_disconnected_count,mqtt,reset_network_disconnected_count}
@@ -437,6 +569,25 @@ IoT_Error_t aws_iot_mqtt_set_disconnect_handler(AWS_IoT_Client *pClient, iot_dis
 												void *pDisconnectHandlerData);
 /* @[declare_mqtt_set_disconnect_handler] */
 
+/**
+ * @brief Set how many QoS 1 messages of an MQTT client context may wait for their PUBACK.
+ *
+ * Limits the number of messages sent with @ref mqtt_function_publish_async that are
+ * in flight at the same time. A full window makes @ref mqtt_function_publish_async
+ * wait for a PUBACK first. Lowering the window below the number of messages in flight
+ * only holds back new messages. The window is `AWS_IOT_MQTT_MAX_INFLIGHT_PUBLISH` after
+ * @ref mqtt_function_init.
+ *
+ * @param[in] pClient MQTT client context
+ * @param[in] window Number of messages in flight, from 1 to `AWS_IOT_MQTT_MAX_INFLIGHT_PUBLISH`
+ *
+ * @return Returns NULL_VALUE_ERROR if provided a bad parameter, MAX_SIZE_ERROR if the
+ * window is out of range; otherwise, returns SUCCESS.
+ */
+/* @[declare_mqtt_set_publish_window] */
+IoT_Error_t aws_iot_mqtt_set_publish_window(AWS_IoT_Client *pClient, uint16_t window);
+/* @[declare_mqtt_set_publish_window] */
+
 /**
  * @brief Enable or disable auto-reconnect for an initialized MQTT client context.
  *
@@ -105,7 +105,10 @@ void aws_iot_mqtt_internal_write_utf8_string(unsigned char **pptr, const char *s
 
 IoT_Error_t aws_iot_mqtt_internal_flushBuffers( AWS_IoT_Client *pClient );
 IoT_Error_t aws_iot_mqtt_internal_send_packet(AWS_IoT_Client *pClient, size_t length, Timer *pTimer);
+IoT_Error_t aws_iot_mqtt_internal_send_packet_vector(AWS_IoT_Client *pClient, NetworkIoVec *pVector, size_t count,
+													 Timer *pTimer);
 IoT_Error_t aws_iot_mqtt_internal_cycle_read(AWS_IoT_Client *pClient, Timer *pTimer, uint8_t *pPacketType);
+IoT_Error_t aws_iot_mqtt_internal_wait_for_data(AWS_IoT_Client *pClient, Timer *pTimer);
 IoT_Error_t aws_iot_mqtt_internal_wait_for_read(AWS_IoT_Client *pClient, uint8_t packetType, Timer *pTimer);
 IoT_Error_t aws_iot_mqtt_internal_serialize_zero(unsigned char *pTxBuf, size_t txBufLen,
 												 MessageTypes packetType, size_t *pSerializedLength);
@@ -118,6 +121,25 @@ IoT_Error_t aws_iot_mqtt_internal_deserialize_publish(uint8_t *dup, QoS *qos,
 IoT_Error_t aws_iot_mqtt_set_client_state(AWS_IoT_Client *pClient, ClientState expectedCurrentState,
 										  ClientState newState);
 
+bool aws_iot_mqtt_internal_is_topic_matched(const char *pTopicFilter, const char *pTopicName, uint16_t topicNameLen);
+bool aws_iot_mqtt_internal_is_handler_matched(const MessageHandlers *pHandler, const char *pTopicName,
+											  uint16_t topicNameLen);
+
+IoT_Error_t aws_iot_mqtt_internal_subscription_index_init(SubscriptionIndex *pIndex, MessageHandlers *pHandlers,
+														  SubscriptionIndexEntry *pEntries, uint16_t handlerCount,
+														  uint16_t *pBuckets, uint16_t bucketCount,
+														  SubscriptionTrieNode *pNodes, uint16_t nodeCount);
+void aws_iot_mqtt_internal_subscription_index_add(SubscriptionIndex *pIndex, uint16_t handlerIndex);
+void aws_iot_mqtt_internal_subscription_index_remove(SubscriptionIndex *pIndex, uint16_t handlerIndex);
+void aws_iot_mqtt_internal_subscription_index_match(const SubscriptionIndex *pIndex, const char *pTopicName,
+													uint16_t topicNameLen, uint32_t *pMatched);
+
+PublishInFlight *aws_iot_mqtt_internal_find_publish_in_flight(AWS_IoT_Client *pClient, uint16_t packetId);
+bool aws_iot_mqtt_internal_handle_puback(AWS_IoT_Client *pClient);
+IoT_Error_t aws_iot_mqtt_internal_retransmit_publish(AWS_IoT_Client *pClient, bool resendAll);
+void aws_iot_mqtt_internal_fail_publish(AWS_IoT_Client *pClient, IoT_Error_t result);
+IoT_Error_t aws_iot_mqtt_internal_disconnect(AWS_IoT_Client *pClient);
+
 #ifdef _ENABLE_THREAD_SUPPORT_
 
 IoT_Error_t aws_iot_mqtt_client_lock_mutex(AWS_IoT_Client *pClient, IoT_Mutex_t *pMutex);
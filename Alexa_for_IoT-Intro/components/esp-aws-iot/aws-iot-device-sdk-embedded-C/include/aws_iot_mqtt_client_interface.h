@@ -66,11 +66,14 @@ extern "C" {
  * - @functionname{mqtt_function_free}
  * - @functionname{mqtt_function_connect}
  * - @functionname{mqtt_function_publish}
+ * - @functionname{mqtt_function_publish_async}
  * - @functionname{mqtt_function_subscribe}
+ * - @functionname{mqtt_function_subscribe_fragmented}
  * - @functionname{mqtt_function_resubscribe}
  * - @functionname{mqtt_function_unsubscribe}
  * - @functionname{mqtt_function_disconnect}
  * - @functionname{mqtt_function_yield}
+ * - @functionname{mqtt_function_yield_wakeup}
  * - @functionname{mqtt_function_attempt_reconnect}
  * - @functionname{mqtt_function_get_next_packet_id}
  * - @functionname{mqtt_function_set_connect_params}
@@ -88,11 +91,14 @@ extern "C" {
  * @functionpage{aws_iot_mqtt_free,mqtt,free}
  * @functionpage{aws_iot_mqtt_connect,mqtt,connect}
  * @functionpage{aws_iot_mqtt_publish,mqtt,publish}
+ * @functionpage{aws_iot_mqtt_publish_async,mqtt,publish_async}
  * @functionpage{aws_iot_mqtt_subscribe,mqtt,subscribe}
+ * @functionpage{aws_iot_mqtt_subscribe_fragmented,mqtt,subscribe_fragmented}
  * @functionpage{aws_iot_mqtt_resubscribe,mqtt,resubscribe}
  * @functionpage{aws_iot_mqtt_unsubscribe,mqtt,unsubscribe}
  * @functionpage{aws_iot_mqtt_disconnect,mqtt,disconnect}
  * @functionpage{aws_iot_mqtt_yield,mqtt,yield}
+ * @functionpage{aws_iot_mqtt_yield_wakeup,mqtt,yield_wakeup}
  * @functionpage{aws_iot_mqtt_attempt_reconnect,mqtt,attempt_reconnect}
  */
 
@@ -154,6 +160,11 @@ IoT_Error_t aws_iot_mqtt_connect(AWS_IoT_Client *pClient, const IoT_Client_Conne
  * passed to the TLS layer. For a QoS 1 message, this function returns after the
  * receipt of the PUBACK for the transmitted message.
  *
+ * A payload of `AWS_IOT_MQTT_PUBLISH_GATHER_MIN_PAYLOAD` bytes or more is handed to
+ * the network layer from `pParams->payload` when the layer has a `writev` function,
+ * so it may be larger than `AWS_IOT_MQTT_TX_BUF_LEN`. Otherwise the whole message
+ * must fit in the TX buffer.
+ *
  * @param pClient MQTT client context
  * @param pTopicName Topic name to publish to
  * @param topicNameLen Length of the topic name
@@ -166,6 +177,43 @@ IoT_Error_t aws_iot_mqtt_publish(AWS_IoT_Client *pClient, const char *pTopicName
 								 IoT_Publish_Message_Params *pParams);
 /* @[declare_mqtt_publish] */
 
+/**
+ * @brief Publish a QoS 1 MQTT message without waiting for its PUBACK.
+ *
+ * This function sends the message and returns, so several QoS 1 messages can wait
+ * for their PUBACK at the same time instead of one per round trip. The PUBACKs are
+ * read by @ref mqtt_function_yield, which then calls the completion handler of the
+ * message with `SUCCESS`. A message without a PUBACK after `AWS_IOT_MQTT_PUBLISH_RETRANSMIT_MS`
+ * is sent again with the DUP flag, up to `AWS_IOT_MQTT_PUBLISH_MAX_RETRANSMITS` times,
+ * and then completes with `MQTT_REQUEST_TIMEOUT_ERROR`. After an auto-reconnect all
+ * messages in flight are sent again. If the connection is lost for good, they complete
+ * with the error @ref mqtt_function_yield returns. @ref mqtt_function_disconnect, and a
+ * connect other than the auto-reconnect, complete them with `NETWORK_MANUALLY_DISCONNECTED`.
+ *
+ * The number of messages in flight is limited by @ref mqtt_function_set_publish_window.
+ * When the window is full, this function reads incoming packets until a PUBACK frees
+ * an entry, for at most the command timeout.
+ *
+ * A QoS 0 message is sent as by @ref mqtt_function_publish and has no completion.
+ *
+ * @param[in] pClient MQTT client context
+ * @param[in] pTopicName Topic name to publish to
+ * @param[in] topicNameLen Length of the topic name
+ * @param[in,out] pParams Publish message parameters, `id` is set to the packet identifier of the message
+ * @param[in] pCompletionHandler Callback invoked when the message completes, may be NULL
+ * @param[in] pCompletionHandlerData Data passed to the callback
+ *
+ * @return `IoT_Error_t`: See `aws_iot_error.h`
+ *
+ * @attention The topic and payload are not copied. They must remain valid until the
+ * completion handler is called.
+ */
+/* @[declare_mqtt_publish_async] */
+IoT_Error_t aws_iot_mqtt_publish_async(AWS_IoT_Client *pClient, const char *pTopicName, uint16_t topicNameLen,
+									   IoT_Publish_Message_Params *pParams,
+									   pPublishCompletionHandler_t pCompletionHandler, void *pCompletionHandlerData);
+/* @[declare_mqtt_publish_async] */
+
 /**
  * @brief Subscribe to an MQTT topic.
  *
@@ -195,6 +243,37 @@ IoT_Error_t aws_iot_mqtt_subscribe(AWS_IoT_Client *pClient, const char *pTopicNa
 								   QoS qos, pApplicationHandler_t pApplicationHandler, void *pApplicationHandlerData);
 /* @[declare_mqtt_subscribe] */
 
+/**
+ * @brief Subscribe to an MQTT topic, receiving large messages in fragments.
+ *
+ * Same as @ref mqtt_function_subscribe, except that messages too large for the
+ * read buffer (`AWS_IOT_MQTT_RX_BUF_LEN`) are not dropped. Their payload is read
+ * into the part of the read buffer left after the topic name and the callback is
+ * invoked once for every piece, with `payloadOffset` and `totalPayloadLen` of the
+ * `IoT_Publish_Message_Params` telling where it belongs. Messages that fit are
+ * delivered whole, with `payloadOffset` 0 and `totalPayloadLen` equal to `payloadLen`.
+ *
+ * @note The fragments are delivered while the message is still being read from the
+ * network, so the callback cannot call other MQTT client functions for them. They
+ * return `MQTT_CLIENT_NOT_IDLE_ERROR` until the last fragment has been delivered.
+ * A QoS 1 message is acknowledged after its last fragment.
+ *
+ * @param[in] pClient MQTT client context
+ * @param[in] pTopicName Topic for subscription
+ * @param[in] topicNameLen Length of topic
+ * @param[in] qos Quality of service for subscription
+ * @param[in] pApplicationHandler Callback function for incoming messages and fragments
+ * that arrive on this subscription
+ * @param[in] pApplicationHandlerData Data passed to the callback
+ *
+ * @return `IoT_Error_t`: See `aws_iot_error.h`
+ */
+/* @[declare_mqtt_subscribe_fragmented] */
+IoT_Error_t aws_iot_mqtt_subscribe_fragmented(AWS_IoT_Client *pClient, const char *pTopicName, uint16_t topicNameLen,
+											  QoS qos, pApplicationHandler_t pApplicationHandler,
+											  void *pApplicationHandlerData);
+/* @[declare_mqtt_subscribe_fragmented] */
+
 /**
  * @brief Resubscribe to topic filter subscriptions in a previous MQTT session.
  *
@@ -277,6 +356,23 @@ IoT_Error_t aws_iot_mqtt_disconnect(AWS_IoT_Client *pClient);
 IoT_Error_t aws_iot_mqtt_yield(AWS_IoT_Client *pClient, uint32_t timeout_ms);
 /* @[declare_mqtt_yield] */
 
+/**
+ * @brief Make a running or the next call to @ref mqtt_function_yield return early.
+ *
+ * When the network layer provides `waitForData`, @ref mqtt_function_yield sleeps
+ * until data arrives or the next keep-alive or retransmit is due, instead of
+ * polling the socket. This function wakes it from another thread, for example
+ * to publish without waiting for the yield timeout. The interrupted call returns
+ * `SUCCESS` after handling the packets already received.
+ *
+ * @param[in] pClient MQTT client context
+ *
+ * @return `IoT_Error_t`: See `aws_iot_error.h`
+ */
+/* @[declare_mqtt_yield_wakeup] */
+IoT_Error_t aws_iot_mqtt_yield_wakeup(AWS_IoT_Client *pClient);
+/* @[declare_mqtt_yield_wakeup] */
+
 /**
  * @brief Attempt to reconnect with the MQTT server.
  *
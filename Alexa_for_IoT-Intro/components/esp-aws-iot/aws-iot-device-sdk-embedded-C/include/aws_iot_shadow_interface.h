@@ -73,6 +73,7 @@ typedef struct {
 	const char *pMqttClientId; ///< Currently the Shadow uses MQTT to connect and it is important to ensure we have unique client id
 	uint16_t mqttClientIdLen; ///< Currently the Shadow uses MQTT to connect and it is important to ensure we have unique client id
 	pApplicationHandler_t deleteActionHandler;	///< Callback to be invoked when Thing shadow for this device is deleted
+	bool isAckSubscriptionPersistent; ///< Keep the accepted/rejected subscriptions of an action once made, instead of subscribing and unsubscribing around every request
 } ShadowConnectParameters_t;
 
 /*!
@@ -249,6 +250,12 @@ IoT_Error_t aws_iot_shadow_delete(AWS_IoT_Client *pClient, const char *pThingNam
  *
  * Any time a delta is published the Json document will be delivered to the pStruct->cb. If you don't want the parsing done by the SDK then use the jsonStruct_t key set to "state". A good example of this is displayed in the sample_apps/shadow_console_echo.c
  *
+ * Delta documents that do not fit SHADOW_MAX_SIZE_OF_RX_BUFFER, including those larger than the MQTT receive buffer, are tokenized as they arrive instead of being dropped.
+ * The values of the registered keys are kept in the Shadow receive buffer, so together they must fit SHADOW_MAX_SIZE_OF_RX_BUFFER, and the callbacks run in registration
+ * order once the whole document is in and its version was checked. They still run while the last fragment of the message is being delivered, so they must not call
+ * the MQTT or Shadow APIs. Values that straddle two fragments of the message are only reported up to JSON_STREAM_MAX_VALUE_LENGTH characters and objects only when
+ * they lie within one fragment.
+ *
  * @param pClient MQTT Client used as the protocol layer
  * @param pStruct The struct used to parse JSON value
  * @return An IoT Error Type defining successful/failed delta registering
@@ -25,6 +25,12 @@ extern "C" {
 #include "aws_iot_shadow_interface.h"
 #include "aws_iot_config.h"
 
+/* Number of things whose topic names are formatted once and kept, the own thing included.
+ * Accepted/rejected subscriptions are only kept for these things. */
+#ifndef SHADOW_MAX_CACHED_THING_TOPICS
+#define SHADOW_MAX_CACHED_THING_TOPICS 2
+#endif
+
 
 extern uint32_t shadowJsonVersionNum;
 extern bool shadowDiscardOldDeltaFlag;
@@ -34,19 +40,23 @@ extern uint16_t myThingNameLen;
 extern char mqttClientID[MAX_SIZE_OF_UNIQUE_CLIENT_ID_BYTES];
 extern uint16_t mqttClientIDLen;
 
-void initializeRecords(AWS_IoT_Client *pClient);
+void initThingTopics(void);
+void initializeRecords(AWS_IoT_Client *pClient, bool persistentAckSubscriptions);
 bool isSubscriptionPresent(const char *pThingName, ShadowActions_t action);
 IoT_Error_t subscribeToShadowActionAcks(const char *pThingName, ShadowActions_t action, bool isSticky);
 void incrementSubscriptionCnt(const char *pThingName, ShadowActions_t action, bool isSticky);
+bool canKeepShadowActionAcks(const char *pThingName);
+IoT_Error_t subscribeToShadowActionAcksOnce(const char *pThingName, ShadowActions_t action);
 
 IoT_Error_t publishToShadowAction(const char *pThingName, ShadowActions_t action, const char *pJsonDocumentToBeSent);
 void addToAckWaitList(uint8_t indexAckWaitList, const char *pThingName, ShadowActions_t action,
 					  const char *pExtractedClientToken, fpActionCallback_t callback, void *pCallbackContext,
-					  uint32_t timeout_seconds);
+					  uint32_t timeout_seconds, bool isAckSubscriptionKept);
 bool getNextFreeIndexOfAckWaitList(uint8_t *pIndex);
 void HandleExpiredResponseCallbacks(void);
 void initDeltaTokens(void);
 IoT_Error_t registerJsonTokenOnDelta(jsonStruct_t *pStruct);
+void dispatchDeltaJsonTokens(const char *pJsonDocument, void *pJsonHandler, int32_t tokenCount);
 
 #ifdef __cplusplus
 }
@@ -57,6 +57,16 @@ typedef struct {
 	bool ServerVerificationFlag;        ///< Boolean.  True = perform server certificate hostname validation.  False = skip validation \b NOT recommended.
 } TLSConnectParams;
 
+/**
+ * @brief Network Write Vector
+ *
+ * One buffer of a list handed to the gather write of the network layer.
+ */
+typedef struct {
+	const unsigned char *pBuffer;        ///< Pointer to the bytes to write
+	size_t len;                            ///< Number of bytes to write from pBuffer
+} NetworkIoVec;
+
 /**
  * @brief Network Structure
  *
@@ -67,9 +77,12 @@ struct Network {
 
 	IoT_Error_t (*read)(Network *, unsigned char *, size_t, Timer *, size_t *);    ///< Function pointer pointing to the network function to read from the network
 	IoT_Error_t (*write)(Network *, unsigned char *, size_t, Timer *, size_t *);    ///< Function pointer pointing to the network function to write to the network
+	IoT_Error_t (*writev)(Network *, const NetworkIoVec *, size_t, Timer *, size_t *);    ///< Function pointer pointing to the network function to write a list of buffers in order. NULL if the layer has no gather write
 	IoT_Error_t (*disconnect)(Network *);    ///< Function pointer pointing to the network function to disconnect from the network
 	IoT_Error_t (*isConnected)(Network *);    ///< Function pointer pointing to the network function to check if TLS is connected
 	IoT_Error_t (*destroy)(Network *);        ///< Function pointer pointing to the network function to destroy the network object
+	IoT_Error_t (*waitForData)(Network *, Timer *);    ///< Function pointer pointing to the network function to block until data can be read. NULL if the layer can only poll
+	IoT_Error_t (*wakeup)(Network *);        ///< Function pointer pointing to the network function to interrupt waitForData from another thread. Can be NULL
 
 	TLSConnectParams tlsConnectParams;        ///< TLSConnect params structure containing the common connection parameters
 	TLSDataParams tlsDataParams;            ///< TLSData params structure containing the connection data parameters that are specific to the library being used
@@ -120,6 +133,21 @@ IoT_Error_t iot_tls_connect(Network *pNetwork, TLSConnectParams *TLSParams);
  */
 IoT_Error_t iot_tls_write(Network *, unsigned char *, size_t, Timer *, size_t *);
 
+/**
+ * @brief Write a list of buffers to the network socket
+ *
+ * The buffers are sent in order as one stream, without first copying them
+ * into a single buffer.
+ *
+ * @param Network - Pointer to a Network struct defining the network interface.
+ * @param NetworkIoVec pointer - list of buffers to write to socket
+ * @param size_t - number of buffers in the list
+ * @param Timer * - operation timer
+ * @param size_t - pointer to store number of bytes written over all buffers
+ * @return IoT_Error_t - successful write or TLS error code
+ */
+IoT_Error_t iot_tls_writev(Network *, const NetworkIoVec *, size_t, Timer *, size_t *);
+
 /**
  * @brief Read bytes from the network socket
  *
@@ -132,6 +160,28 @@ IoT_Error_t iot_tls_write(Network *, unsigned char *, size_t, Timer *, size_t *)
  */
 IoT_Error_t iot_tls_read(Network *, unsigned char *, size_t, Timer *, size_t *);
 
+/**
+ * @brief Wait until the network socket has data to read
+ *
+ * Blocks until data can be read, the timer expires or iot_tls_wakeup is called.
+ * Data already decrypted by the TLS layer counts as readable.
+ *
+ * @param Network - Pointer to a Network struct defining the network interface.
+ * @param Timer * - time to wait at most
+ * @return IoT_Error_t - SUCCESS if data can be read, NETWORK_SSL_NOTHING_TO_READ on timeout or wakeup, or TLS error code
+ */
+IoT_Error_t iot_tls_wait_for_data(Network *pNetwork, Timer *timer);
+
+/**
+ * @brief Interrupt a call to iot_tls_wait_for_data
+ *
+ * Can be called from any thread while another thread waits.
+ *
+ * @param Network - Pointer to a Network struct defining the network interface.
+ * @return IoT_Error_t - successful wakeup or TLS error code
+ */
+IoT_Error_t iot_tls_wakeup(Network *pNetwork);
+
 /**
  * @brief Disconnect from network socket
  *
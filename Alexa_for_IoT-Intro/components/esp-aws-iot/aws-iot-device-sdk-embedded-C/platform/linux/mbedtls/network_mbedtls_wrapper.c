@@ -17,8 +17,13 @@
 extern "C" {
 #endif
 
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
 #include <stdbool.h>
 #include <string.h>
+#include <errno.h>
+#include <unistd.h>
 #include "aws_iot_config.h"
 
 #include <timer_platform.h>
@@ -78,6 +83,31 @@ static int _iot_tls_verify_cert(void *data, mbedtls_x509_crt *crt, int depth, ui
 	return 0;
 }
 
+/* Opens a UDP socket connected to itself, a datagram sent on it makes select() return */
+static int _iot_tls_open_wakeup_socket(void) {
+	struct sockaddr_in addr;
+	socklen_t addrLen = sizeof(addr);
+	int fd = socket(AF_INET, SOCK_DGRAM, 0);
+
+	if(fd < 0) {
+		return -1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+	if(bind(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0 ||
+	   getsockname(fd, (struct sockaddr *) &addr, &addrLen) != 0 ||
+	   connect(fd, (struct sockaddr *) &addr, addrLen) != 0) {
+		IOT_WARN("Wakeup socket not available, errno %d\n", errno);
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
 void _iot_tls_set_connect_params(Network *pNetwork, char *pRootCALocation, char *pDeviceCertLocation,
 								 char *pDevicePrivateKeyLocation, char *pDestinationURL,
 								 uint16_t destinationPort, uint32_t timeout_ms, bool ServerVerificationFlag) {
@@ -99,11 +129,16 @@ IoT_Error_t iot_tls_init(Network *pNetwork, char *pRootCALocation, char *pDevice
 	pNetwork->connect = iot_tls_connect;
 	pNetwork->read = iot_tls_read;
 	pNetwork->write = iot_tls_write;
+	pNetwork->writev = iot_tls_writev;
 	pNetwork->disconnect = iot_tls_disconnect;
 	pNetwork->isConnected = iot_tls_is_connected;
 	pNetwork->destroy = iot_tls_destroy;
+	pNetwork->waitForData = iot_tls_wait_for_data;
+	pNetwork->wakeup = iot_tls_wakeup;
 
 	pNetwork->tlsDataParams.flags = 0;
+	pNetwork->tlsDataParams.server_fd.fd = -1;
+	pNetwork->tlsDataParams.wakeup_fd = _iot_tls_open_wakeup_socket();
 
 	return SUCCESS;
 }
@@ -137,6 +172,11 @@ IoT_Error_t iot_tls_connect(Network *pNetwork, TLSConnectParams *params) {
 
 	tlsDataParams = &(pNetwork->tlsDataParams);
 
+	/* Closed by iot_tls_destroy on the previous disconnect */
+	if(tlsDataParams->wakeup_fd < 0) {
+		tlsDataParams->wakeup_fd = _iot_tls_open_wakeup_socket();
+	}
+
 	mbedtls_net_init(&(tlsDataParams->server_fd));
 	mbedtls_ssl_init(&(tlsDataParams->ssl));
 	mbedtls_ssl_config_init(&(tlsDataParams->conf));
@@ -352,6 +392,29 @@ IoT_Error_t iot_tls_write(Network *pNetwork, unsigned char *pMsg, size_t len, Ti
 	return SUCCESS;
 }
 
+IoT_Error_t iot_tls_writev(Network *pNetwork, const NetworkIoVec *pVector, size_t count, Timer *timer,
+						  size_t *written_len) {
+	size_t i;
+	size_t txLen;
+	IoT_Error_t rc = SUCCESS;
+
+	*written_len = 0U;
+
+	/* mbedtls has no gather write, so each buffer is passed to mbedtls_ssl_write in turn.
+	 * It encrypts straight from the caller's buffer into its own record buffer, no
+	 * intermediate copy is made. A short buffer ends up in a TLS record of its own. */
+	for(i = 0U; i < count; i++) {
+		txLen = 0U;
+		rc = iot_tls_write(pNetwork, (unsigned char *) pVector[i].pBuffer, pVector[i].len, timer, &txLen);
+		*written_len += txLen;
+		if(SUCCESS != rc) {
+			break;
+		}
+	}
+
+	return rc;
+}
+
 IoT_Error_t iot_tls_read(Network *pNetwork, unsigned char *pMsg, size_t len, Timer *timer, size_t *read_len) {
 	mbedtls_ssl_context *pSsl = &(pNetwork->tlsDataParams.ssl);
 	size_t rxLen = 0U;
@@ -406,6 +469,69 @@ IoT_Error_t iot_tls_read(Network *pNetwork, unsigned char *pMsg, size_t len, Tim
 	return SUCCESS;
 }
 
+IoT_Error_t iot_tls_wait_for_data(Network *pNetwork, Timer *timer) {
+	TLSDataParams *tlsDataParams = &(pNetwork->tlsDataParams);
+	int fd = tlsDataParams->server_fd.fd;
+	int wakeupFd = tlsDataParams->wakeup_fd;
+	uint32_t waitMs;
+	struct timeval tv;
+	fd_set readFds;
+	char drain[16];
+	int ret;
+
+	/* A record already decrypted by mbedtls is no longer visible on the socket */
+	if(mbedtls_ssl_get_bytes_avail(&(tlsDataParams->ssl)) > 0) {
+		return SUCCESS;
+	}
+
+	if(fd < 0) {
+		return NETWORK_SSL_READ_ERROR;
+	}
+
+	FD_ZERO(&readFds);
+	FD_SET(fd, &readFds);
+	if(wakeupFd >= 0) {
+		FD_SET(wakeupFd, &readFds);
+	}
+
+	waitMs = left_ms(timer);
+	tv.tv_sec = waitMs / 1000;
+	tv.tv_usec = (waitMs % 1000) * 1000;
+
+	ret = select((fd > wakeupFd ? fd : wakeupFd) + 1, &readFds, NULL, NULL, &tv);
+	if(ret < 0) {
+		if(errno == EINTR) {
+			return NETWORK_SSL_NOTHING_TO_READ;
+		}
+		IOT_ERROR("select returned errno %d\n", errno);
+		return NETWORK_SSL_READ_ERROR;
+	}
+
+	if(wakeupFd >= 0 && FD_ISSET(wakeupFd, &readFds)) {
+		while(recv(wakeupFd, drain, sizeof(drain), MSG_DONTWAIT) > 0) {
+		}
+	}
+
+	if(ret > 0 && FD_ISSET(fd, &readFds)) {
+		return SUCCESS;
+	}
+
+	return NETWORK_SSL_NOTHING_TO_READ;
+}
+
+IoT_Error_t iot_tls_wakeup(Network *pNetwork) {
+	char signal = 0;
+
+	if(pNetwork->tlsDataParams.wakeup_fd < 0) {
+		return NETWORK_ERR_NET_SOCKET_FAILED;
+	}
+
+	/* A full socket buffer means a wakeup is already pending */
+	(void) send(pNetwork->tlsDataParams.wakeup_fd, &signal, 1, MSG_DONTWAIT);
+
+	return SUCCESS;
+}
+
 IoT_Error_t iot_tls_disconnect(Network *pNetwork) {
 	mbedtls_ssl_context *ssl = &(pNetwork->tlsDataParams.ssl);
 	int ret = 0;
@@ -432,6 +558,11 @@ IoT_Error_t iot_tls_destroy(Network *pNetwork) {
 	mbedtls_ctr_drbg_free(&(tlsDataParams->ctr_drbg));
 	mbedtls_entropy_free(&(tlsDataParams->entropy));
 
+	if(tlsDataParams->wakeup_fd >= 0) {
+		close(tlsDataParams->wakeup_fd);
+		tlsDataParams->wakeup_fd = -1;
+	}
+
 	return SUCCESS;
 }
 
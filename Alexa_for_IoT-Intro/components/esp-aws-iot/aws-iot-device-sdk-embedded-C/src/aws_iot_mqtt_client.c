@@ -251,6 +251,24 @@ IoT_Error_t aws_iot_mqtt_init(AWS_IoT_Client *pClient, const IoT_Client_Init_Par
 		pClient->clientData.messageHandlers[i].qos = QOS0;
 	}
 
+	for(i = 0; i < AWS_IOT_MQTT_MAX_INFLIGHT_PUBLISH; ++i) {
+		pClient->clientData.publishInFlight[i].packetId = 0;
+	}
+	pClient->clientData.publishInFlightCount = 0;
+	pClient->clientData.publishWindow = AWS_IOT_MQTT_MAX_INFLIGHT_PUBLISH;
+
+	rc = aws_iot_mqtt_internal_subscription_index_init(&(pClient->clientData.subscriptionIndex),
+													   pClient->clientData.messageHandlers,
+													   pClient->clientData.subscriptionEntries,
+													   AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS,
+													   pClient->clientData.subscriptionBuckets,
+													   AWS_IOT_MQTT_SUBSCRIPTION_HASH_BUCKETS,
+													   pClient->clientData.subscriptionNodes,
+													   AWS_IOT_MQTT_SUBSCRIPTION_TRIE_NODES);
+	if(SUCCESS != rc) {
+		FUNC_EXIT_RC(rc);
+	}
+
 	pClient->clientData.packetTimeoutMs = pInitParams->mqttPacketTimeout_ms;
 	pClient->clientData.commandTimeoutMs = pInitParams->mqttCommandTimeout_ms;
 	pClient->clientData.writeBufSize = AWS_IOT_MQTT_TX_BUF_LEN;
@@ -287,6 +305,12 @@ IoT_Error_t aws_iot_mqtt_init(AWS_IoT_Client *pClient, const IoT_Client_Init_Par
 
 	pClient->clientStatus.isPingOutstanding = 0;
 	pClient->clientStatus.isAutoReconnectEnabled = pInitParams->enableAutoReconnect;
+	pClient->clientStatus.isYieldWakeupPending = false;
+
+	/* Optional in the network layer, iot_tls_init sets them if the platform supports them */
+	pClient->networkStack.writev = NULL;
+	pClient->networkStack.waitForData = NULL;
+	pClient->networkStack.wakeup = NULL;
 
 	rc = iot_tls_init(&(pClient->networkStack), pInitParams->pRootCALocation, pInitParams->pDeviceCertLocation,
 					  pInitParams->pDevicePrivateKeyLocation, pInitParams->pHostURL, pInitParams->port,
@@ -312,8 +336,14 @@ IoT_Error_t aws_iot_mqtt_init(AWS_IoT_Client *pClient, const IoT_Client_Init_Par
 }
 
 uint16_t aws_iot_mqtt_get_next_packet_id(AWS_IoT_Client *pClient) {
-	return pClient->clientData.nextPacketId = (uint16_t) ((MAX_PACKET_ID == pClient->clientData.nextPacketId) ? 1 : (
-			pClient->clientData.nextPacketId + 1));
+	/* Skip identifiers still used by messages waiting for their PUBACK */
+	do {
+		pClient->clientData.nextPacketId = (uint16_t) ((MAX_PACKET_ID == pClient->clientData.nextPacketId) ? 1 : (
+				pClient->clientData.nextPacketId + 1));
+	} while(0 < pClient->clientData.publishInFlightCount &&
+			NULL != aws_iot_mqtt_internal_find_publish_in_flight(pClient, pClient->clientData.nextPacketId));
+
+	return pClient->clientData.nextPacketId;
 }
 
 bool aws_iot_mqtt_is_client_connected(AWS_IoT_Client *pClient) {
@@ -384,6 +414,20 @@ IoT_Error_t aws_iot_mqtt_set_disconnect_handler(AWS_IoT_Client *pClient, iot_dis
 	FUNC_EXIT_RC(SUCCESS);
 }
 
+IoT_Error_t aws_iot_mqtt_set_publish_window(AWS_IoT_Client *pClient, uint16_t window) {
+	FUNC_ENTRY;
+	if(NULL == pClient) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	if(0 == window || AWS_IOT_MQTT_MAX_INFLIGHT_PUBLISH < window) {
+		FUNC_EXIT_RC(MAX_SIZE_ERROR);
+	}
+
+	pClient->clientData.publishWindow = window;
+	FUNC_EXIT_RC(SUCCESS);
+}
+
 uint32_t aws_iot_mqtt_get_network_disconnected_count(AWS_IoT_Client *pClient) {
 	return pClient->clientData.counterNetworkDisconnected;
 }
@@ -55,7 +55,7 @@ static IoT_Error_t _aws_iot_mqtt_handle_disconnect(AWS_IoT_Client *pClient) {
 
 	FUNC_ENTRY;
 
-	rc = aws_iot_mqtt_disconnect(pClient);
+	rc = aws_iot_mqtt_internal_disconnect(pClient);
 	if(rc != SUCCESS) {
 		// If the aws_iot_mqtt_internal_send_packet prevents us from sending a disconnect packet then we have to clean the stack
 		_aws_iot_mqtt_force_client_disconnect(pClient);
@@ -177,6 +177,60 @@ static IoT_Error_t _aws_iot_mqtt_keep_alive(AWS_IoT_Client *pClient) {
 	FUNC_EXIT_RC(SUCCESS);
 }
 
+static IoT_Error_t _aws_iot_mqtt_retransmit_publish(AWS_IoT_Client *pClient) {
+	IoT_Error_t rc;
+
+	FUNC_ENTRY;
+
+	if(0 == pClient->clientData.publishInFlightCount) {
+		FUNC_EXIT_RC(SUCCESS);
+	}
+
+	rc = aws_iot_mqtt_internal_retransmit_publish(pClient, false);
+	if(SUCCESS != rc) {
+		/* Same as a failed PINGREQ, the connection is considered lost */
+		rc = _aws_iot_mqtt_handle_disconnect(pClient);
+	}
+
+	FUNC_EXIT_RC(rc);
+}
+
+/* left_ms() rounds down, a timer about to expire must not turn into a busy loop of 0 ms waits */
+static uint32_t _aws_iot_mqtt_left_ms_round_up(Timer *pTimer) {
+	uint32_t leftMs = left_ms(pTimer);
+
+	if(0 == leftMs && !has_timer_expired(pTimer)) {
+		leftMs = 1;
+	}
+	return leftMs;
+}
+
+/* Time until the next PINGREQ, PINGRESP timeout or retransmit is due, capped by the yield timer */
+static uint32_t _aws_iot_mqtt_next_event_ms(AWS_IoT_Client *pClient, Timer *pTimer) {
+	uint32_t waitMs = _aws_iot_mqtt_left_ms_round_up(pTimer);
+	uint32_t eventMs;
+	size_t i;
+
+	if(0 != pClient->clientData.keepAliveInterval) {
+		eventMs = _aws_iot_mqtt_left_ms_round_up(pClient->clientStatus.isPingOutstanding ? &(pClient->pingRespTimer)
+																						  : &(pClient->pingReqTimer));
+		if(eventMs < waitMs) {
+			waitMs = eventMs;
+		}
+	}
+
+	for(i = 0; i < AWS_IOT_MQTT_MAX_INFLIGHT_PUBLISH && 0 < pClient->clientData.publishInFlightCount; i++) {
+		if(0 != pClient->clientData.publishInFlight[i].packetId) {
+			eventMs = _aws_iot_mqtt_left_ms_round_up(&(pClient->clientData.publishInFlight[i].retransmitTimer));
+			if(eventMs < waitMs) {
+				waitMs = eventMs;
+			}
+		}
+	}
+
+	return waitMs;
+}
+
 /**
  * @brief Yield to the MQTT client
  *
@@ -204,6 +258,9 @@ static IoT_Error_t _aws_iot_mqtt_internal_yield(AWS_IoT_Client *pClient, uint32_
 	uint8_t packet_type;
 	ClientState clientState;
 	Timer timer;
+	Timer waitTimer;
+	Timer *pWaitTimer;
+	uint32_t waitMs;
 	init_timer(&timer);
 	countdown_ms(&timer, timeout_ms);
 
@@ -221,17 +278,48 @@ static IoT_Error_t _aws_iot_mqtt_internal_yield(AWS_IoT_Client *pClient, uint32_
 			(CLIENT_STATE_CONNECTED_RESUBSCRIBE_IN_PROGRESS == clientState)) {
 			if(AWS_IOT_MQTT_MAX_RECONNECT_WAIT_INTERVAL < pClient->clientData.currentReconnectWaitInterval) {
 				yieldRc = NETWORK_RECONNECT_TIMED_OUT_ERROR;
+				aws_iot_mqtt_internal_fail_publish(pClient, yieldRc);
 				break;
 			}
 			yieldRc = _aws_iot_mqtt_handle_reconnect(pClient);
+			if(NETWORK_RECONNECTED == yieldRc && 0 < pClient->clientData.publishInFlightCount) {
+				/* Messages in flight may have been lost with the old connection. A send that
+				 * fails here is left to the regular retransmit below. */
+				(void)aws_iot_mqtt_internal_retransmit_publish(pClient, true);
+			}
 			/* Network reconnect attempted, check if yield timer expired before
 			 * doing anything else */
 			continue;
 		}
 
-		yieldRc = aws_iot_mqtt_internal_cycle_read(pClient, &timer, &packet_type);
+		/* Sleep until data arrives, the next keep-alive or retransmit is due, or the yield times out. When the
+		 * yield timer comes first it is waited on itself, a copy of it in whole ms would expire just before it. */
+		pWaitTimer = &timer;
+		waitMs = _aws_iot_mqtt_next_event_ms(pClient, &timer);
+		if(waitMs < _aws_iot_mqtt_left_ms_round_up(&timer)) {
+			init_timer(&waitTimer);
+			countdown_ms(&waitTimer, waitMs);
+			pWaitTimer = &waitTimer;
+		}
+		yieldRc = aws_iot_mqtt_internal_wait_for_data(pClient, pWaitTimer);
+		if(pClient->clientStatus.isYieldWakeupPending) {
+			pClient->clientStatus.isYieldWakeupPending = false;
+			yieldRc = SUCCESS;
+			break;
+		}
+
+		if(SUCCESS == yieldRc) {
+			/* Each pass reads one packet, the next wait returns at once while more are queued */
+			yieldRc = aws_iot_mqtt_internal_cycle_read(pClient, &timer, &packet_type);
+		} else if(NETWORK_SSL_NOTHING_TO_READ == yieldRc) {
+			yieldRc = SUCCESS;
+		}
+
 		if(SUCCESS == yieldRc) {
 			yieldRc = _aws_iot_mqtt_keep_alive(pClient);
+			if(SUCCESS == yieldRc) {
+				yieldRc = _aws_iot_mqtt_retransmit_publish(pClient);
+			}
 		} else {
 			// SSL read and write errors are terminal, connection must be closed and retried
 			if(NETWORK_SSL_READ_ERROR == yieldRc || NETWORK_SSL_WRITE_ERROR == yieldRc || NETWORK_SSL_WRITE_TIMEOUT_ERROR == yieldRc) {
@@ -261,6 +349,7 @@ static IoT_Error_t _aws_iot_mqtt_internal_yield(AWS_IoT_Client *pClient, uint32_
 				 * attempt has started */
 				yieldRc = NETWORK_ATTEMPTING_RECONNECT;
 			} else {
+				aws_iot_mqtt_internal_fail_publish(pClient, yieldRc);
 				break;
 			}
 		} else if(SUCCESS != yieldRc) {
@@ -271,6 +360,22 @@ static IoT_Error_t _aws_iot_mqtt_internal_yield(AWS_IoT_Client *pClient, uint32_
 	FUNC_EXIT_RC(yieldRc);
 }
 
+IoT_Error_t aws_iot_mqtt_yield_wakeup(AWS_IoT_Client *pClient) {
+	FUNC_ENTRY;
+
+	if(NULL == pClient) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	pClient->clientStatus.isYieldWakeupPending = true;
+
+	if(NULL != pClient->networkStack.wakeup) {
+		FUNC_EXIT_RC(pClient->networkStack.wakeup(&(pClient->networkStack)));
+	}
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+
 IoT_Error_t aws_iot_mqtt_yield(AWS_IoT_Client *pClient, uint32_t timeout_ms) {
 	IoT_Error_t rc, yieldRc;
 	ClientState clientState;
@@ -36,7 +36,7 @@ const ShadowInitParameters_t ShadowInitParametersDefault = {(char *) AWS_IOT_MQT
 															NULL, false, NULL};
 
 const ShadowConnectParameters_t ShadowConnectParametersDefault = {(char *) AWS_IOT_MY_THING_NAME,
-								  (char *) AWS_IOT_MQTT_CLIENT_ID, 0, NULL};
+								  (char *) AWS_IOT_MQTT_CLIENT_ID, 0, NULL, false};
 
 static char deleteAcceptedTopic[MAX_SHADOW_TOPIC_LENGTH_BYTES];
 
@@ -100,6 +100,7 @@ IoT_Error_t aws_iot_shadow_init(AWS_IoT_Client *pClient, const ShadowInitParamet
 	resetClientTokenSequenceNum();
 	aws_iot_shadow_reset_last_received_version();
 	initDeltaTokens();
+	initThingTopics();
 
 	FUNC_EXIT_RC(SUCCESS);
 }
@@ -133,7 +134,7 @@ IoT_Error_t aws_iot_shadow_connect(AWS_IoT_Client *pClient, const ShadowConnectP
 		FUNC_EXIT_RC(rc);
 	}
 
-	initializeRecords(pClient);
+	initializeRecords(pClient, pParams->isAckSubscriptionPersistent);
 
 	if(NULL != pParams->deleteActionHandler) {
 		snprintf(deleteAcceptedTopic, MAX_SHADOW_TOPIC_LENGTH_BYTES,
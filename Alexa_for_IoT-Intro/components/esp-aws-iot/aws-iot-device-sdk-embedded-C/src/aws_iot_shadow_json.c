@@ -26,6 +26,7 @@ extern "C" {
 
 #include <string.h>
 #include <stdbool.h>
+#include <math.h>
 
 #include "aws_iot_json_utils.h"
 #include "aws_iot_log.h"
@@ -334,6 +335,301 @@ IoT_Error_t aws_iot_finalize_json_document(char *pJsonDocument, size_t maxSizeOf
 	return ret_val;
 }
 
+/* Largest magnitude formatted by hand, the integer part then fits a uint64_t and snprintf does the rest */
+#define SHADOW_JSON_WRITER_MAX_HAND_FORMATTED 1e15
+
+static void writerAppend(ShadowJsonWriter_t *pWriter, const char *pText, size_t textLength) {
+	size_t room;
+
+	if(SUCCESS != pWriter->status) {
+		return;
+	}
+
+	room = pWriter->bufferSize - pWriter->length - 1;
+	if(textLength > room) {
+		/* Fill the buffer up like snprintf does */
+		memcpy(pWriter->pBuffer + pWriter->length, pText, room);
+		pWriter->length += room;
+		pWriter->pBuffer[pWriter->length] = '\0';
+		pWriter->status = SHADOW_JSON_BUFFER_TRUNCATED;
+		return;
+	}
+
+	memcpy(pWriter->pBuffer + pWriter->length, pText, textLength);
+	pWriter->length += textLength;
+	pWriter->pBuffer[pWriter->length] = '\0';
+}
+
+static void writerAppendUnsigned(ShadowJsonWriter_t *pWriter, uint64_t value, bool isNegative) {
+	char digits[21];
+	size_t i = sizeof(digits);
+
+	do {
+		digits[--i] = (char) ('0' + (value % 10));
+		value /= 10;
+	} while(0 != value);
+	if(isNegative) {
+		digits[--i] = '-';
+	}
+
+	writerAppend(pWriter, digits + i, sizeof(digits) - i);
+}
+
+static void writerAppendSigned(ShadowJsonWriter_t *pWriter, int32_t value) {
+	uint64_t magnitude = (value < 0) ? (uint64_t) (-(int64_t) value) : (uint64_t) value;
+
+	writerAppendUnsigned(pWriter, magnitude, value < 0);
+}
+
+/* Same text as "%f": six decimals, rounded half to even on the exact binary value */
+static void writerAppendDouble(ShadowJsonWriter_t *pWriter, double value) {
+	char text[48];
+	double magnitude, fraction, scaled, rest, below;
+	uint64_t integerPart;
+	uint32_t decimals;
+	int32_t i;
+
+	magnitude = fabs(value);
+	if(!(magnitude < SHADOW_JSON_WRITER_MAX_HAND_FORMATTED)) {
+		/* Huge, infinite or not a number */
+		i = snprintf(text, sizeof(text), "%f", value);
+		writerAppend(pWriter, text, (i > 0 && (size_t) i < sizeof(text)) ? (size_t) i : 0);
+		return;
+	}
+
+	integerPart = (uint64_t) magnitude;
+	fraction = magnitude - (double) integerPart;	/* exact */
+
+	/* fraction * 10^6 = fraction * 64 * 15625, where the first product is exact and fma() gives the
+	 * rounding error of the second, so halfway cases are found on the exact value */
+	scaled = fraction * 64.0 * 15625.0;
+	rest = fma(fraction * 64.0, 15625.0, -scaled);
+	below = floor(scaled);
+	decimals = (uint32_t) below;
+	rest += (scaled - below) - 0.5;
+	if(rest > 0.0 || (0.0 == rest && 0 != (decimals & 1u))) {
+		decimals++;
+	}
+	if(1000000u == decimals) {
+		decimals = 0;
+		integerPart++;
+	}
+
+	writerAppendUnsigned(pWriter, integerPart, 0 != signbit(value));
+	text[0] = '.';
+	for(i = 6; i > 0; i--) {
+		text[i] = (char) ('0' + (decimals % 10));
+		decimals /= 10;
+	}
+	writerAppend(pWriter, text, 7);
+}
+
+static void writerAppendEscaped(ShadowJsonWriter_t *pWriter, const char *pString) {
+	static const char hexDigits[] = "0123456789abcdef";
+	char escaped[6] = {'\\', 'u', '0', '0', '0', '0'};
+	const char *pRun = pString;
+
+	writerAppend(pWriter, "\"", 1);
+	for(; '\0' != *pString; pString++) {
+		if('"' != *pString && '\\' != *pString && (unsigned char) *pString >= 0x20) {
+			continue;
+		}
+		writerAppend(pWriter, pRun, (size_t) (pString - pRun));
+		if((unsigned char) *pString < 0x20) {
+			escaped[4] = hexDigits[(unsigned char) *pString >> 4];
+			escaped[5] = hexDigits[(unsigned char) *pString & 0x0F];
+			writerAppend(pWriter, escaped, sizeof(escaped));
+		} else {
+			escaped[1] = *pString;
+			writerAppend(pWriter, escaped, 2);
+			escaped[1] = 'u';
+		}
+		pRun = pString + 1;
+	}
+	writerAppend(pWriter, pRun, (size_t) (pString - pRun));
+	writerAppend(pWriter, "\"", 1);
+}
+
+static void writerAppendKey(ShadowJsonWriter_t *pWriter, const char *pKey) {
+	if(!pWriter->isFirstMember) {
+		writerAppend(pWriter, ",", 1);
+	}
+	pWriter->isFirstMember = false;
+	writerAppend(pWriter, "\"", 1);
+	writerAppend(pWriter, pKey, strlen(pKey));
+	writerAppend(pWriter, "\":", 2);
+}
+
+IoT_Error_t aws_iot_shadow_json_writer_init(ShadowJsonWriter_t *pWriter, char *pJsonDocument,
+											size_t maxSizeOfJsonDocument) {
+	if(pWriter == NULL || pJsonDocument == NULL) {
+		return NULL_VALUE_ERROR;
+	}
+
+	pWriter->pBuffer = pJsonDocument;
+	pWriter->bufferSize = maxSizeOfJsonDocument;
+	pWriter->length = 0;
+	pWriter->depth = 0;
+	pWriter->isFirstMember = true;
+	pWriter->status = SUCCESS;
+	if(maxSizeOfJsonDocument == 0) {
+		pWriter->status = SHADOW_JSON_ERROR;
+		return pWriter->status;
+	}
+	pJsonDocument[0] = '\0';
+
+	writerAppend(pWriter, "{", 1);
+	pWriter->depth = 1;
+	return aws_iot_shadow_json_writer_begin_object(pWriter, "state");
+}
+
+IoT_Error_t aws_iot_shadow_json_writer_begin_object(ShadowJsonWriter_t *pWriter, const char *pKey) {
+	if(pWriter == NULL) {
+		return NULL_VALUE_ERROR;
+	}
+	if(SUCCESS == pWriter->status && (pKey == NULL || pWriter->depth == 0)) {
+		pWriter->status = (pKey == NULL) ? NULL_VALUE_ERROR : SHADOW_JSON_ERROR;
+	}
+	if(SUCCESS == pWriter->status && pWriter->depth == UINT8_MAX) {
+		pWriter->status = SHADOW_JSON_ERROR;
+	}
+	if(SUCCESS != pWriter->status) {
+		return pWriter->status;
+	}
+
+	writerAppendKey(pWriter, pKey);
+	writerAppend(pWriter, "{", 1);
+	pWriter->depth++;
+	pWriter->isFirstMember = true;
+	return pWriter->status;
+}
+
+IoT_Error_t aws_iot_shadow_json_writer_end_object(ShadowJsonWriter_t *pWriter) {
+	if(pWriter == NULL) {
+		return NULL_VALUE_ERROR;
+	}
+	/* The document itself is closed by aws_iot_shadow_json_writer_finalize */
+	if(SUCCESS == pWriter->status && pWriter->depth <= 1) {
+		pWriter->status = SHADOW_JSON_ERROR;
+	}
+	if(SUCCESS != pWriter->status) {
+		return pWriter->status;
+	}
+
+	writerAppend(pWriter, "}", 1);
+	pWriter->depth--;
+	pWriter->isFirstMember = false;
+	return pWriter->status;
+}
+
+IoT_Error_t aws_iot_shadow_json_writer_add(ShadowJsonWriter_t *pWriter, const jsonStruct_t *pStruct) {
+	const void *pData;
+
+	if(pWriter == NULL) {
+		return NULL_VALUE_ERROR;
+	}
+	if(SUCCESS == pWriter->status && (pStruct == NULL || pStruct->pKey == NULL || pStruct->pData == NULL)) {
+		pWriter->status = NULL_VALUE_ERROR;
+	}
+	if(SUCCESS == pWriter->status && pWriter->depth == 0) {
+		pWriter->status = SHADOW_JSON_ERROR;
+	}
+	if(SUCCESS != pWriter->status) {
+		return pWriter->status;
+	}
+
+	writerAppendKey(pWriter, pStruct->pKey);
+	pData = pStruct->pData;
+	switch(pStruct->type) {
+		case SHADOW_JSON_INT32:
+			writerAppendSigned(pWriter, *(const int32_t *) pData);
+			break;
+		case SHADOW_JSON_INT16:
+			writerAppendSigned(pWriter, *(const int16_t *) pData);
+			break;
+		case SHADOW_JSON_INT8:
+			writerAppendSigned(pWriter, *(const int8_t *) pData);
+			break;
+		case SHADOW_JSON_UINT32:
+			writerAppendUnsigned(pWriter, *(const uint32_t *) pData, false);
+			break;
+		case SHADOW_JSON_UINT16:
+			writerAppendUnsigned(pWriter, *(const uint16_t *) pData, false);
+			break;
+		case SHADOW_JSON_UINT8:
+			writerAppendUnsigned(pWriter, *(const uint8_t *) pData, false);
+			break;
+		case SHADOW_JSON_FLOAT:
+			writerAppendDouble(pWriter, *(const float *) pData);
+			break;
+		case SHADOW_JSON_DOUBLE:
+			writerAppendDouble(pWriter, *(const double *) pData);
+			break;
+		case SHADOW_JSON_BOOL:
+			if(*(const bool *) pData) {
+				writerAppend(pWriter, "true", 4);
+			} else {
+				writerAppend(pWriter, "false", 5);
+			}
+			break;
+		case SHADOW_JSON_STRING:
+			writerAppendEscaped(pWriter, (const char *) pData);
+			break;
+		case SHADOW_JSON_OBJECT:
+			writerAppend(pWriter, (const char *) pData, strlen((const char *) pData));
+			break;
+		default:
+			pWriter->status = SHADOW_JSON_ERROR;
+			break;
+	}
+
+	return pWriter->status;
+}
+
+IoT_Error_t aws_iot_shadow_json_writer_finalize(ShadowJsonWriter_t *pWriter) {
+	if(pWriter == NULL) {
+		return NULL_VALUE_ERROR;
+	}
+	if(SUCCESS == pWriter->status && pWriter->depth == 0) {
+		pWriter->status = SHADOW_JSON_ERROR;
+	}
+	if(SUCCESS != pWriter->status) {
+		return pWriter->status;
+	}
+
+	for(; pWriter->depth > 1; pWriter->depth--) {
+		writerAppend(pWriter, "}", 1);
+	}
+	writerAppend(pWriter, ", \"", 3);
+	writerAppend(pWriter, SHADOW_CLIENT_TOKEN_STRING, strlen(SHADOW_CLIENT_TOKEN_STRING));
+	writerAppend(pWriter, "\":\"", 3);
+	writerAppend(pWriter, mqttClientID, strlen(mqttClientID));
+	writerAppend(pWriter, "-", 1);
+	writerAppendSigned(pWriter, (int32_t) clientTokenNum++);
+	writerAppend(pWriter, "\"}", 2);
+	pWriter->depth = 0;
+
+	return pWriter->status;
+}
+
+IoT_Error_t aws_iot_shadow_build_reported(const jsonStruct_t *pStructs, size_t count, char *pJsonDocument,
+										  size_t maxSizeOfJsonDocument) {
+	ShadowJsonWriter_t writer;
+	size_t i;
+
+	if(pJsonDocument == NULL || (pStructs == NULL && count > 0)) {
+		return NULL_VALUE_ERROR;
+	}
+
+	aws_iot_shadow_json_writer_init(&writer, pJsonDocument, maxSizeOfJsonDocument);
+	aws_iot_shadow_json_writer_begin_object(&writer, "reported");
+	for(i = 0; i < count; i++) {
+		aws_iot_shadow_json_writer_add(&writer, &pStructs[i]);
+	}
+
+	return aws_iot_shadow_json_writer_finalize(&writer);
+}
+
 static IoT_Error_t convertDataToString(char *pStringBuffer, size_t maxSizoStringBuffer, JsonPrimitiveType type,
 									   void *pData) {
 	int32_t snPrintfReturn = 0;
@@ -429,50 +725,115 @@ static IoT_Error_t UpdateValueIfNoObject(const char *pJsonString, jsonStruct_t *
 	return ret_val;
 }
 
-bool isJsonKeyMatchingAndUpdateValue(const char *pJsonDocument, void *pJsonHandler, int32_t tokenCount,
-									 jsonStruct_t *pDataStruct, uint32_t *pDataLength, int32_t *pDataPosition) {
-	int32_t i, metadataEnd;
-	uint32_t dataLength;
+bool updateValueOfJsonText(const char *pValue, uint32_t valueLength, jsmntype_t valueType, jsonStruct_t *pDataStruct) {
 	jsmntok_t dataToken;
 
-	IOT_UNUSED(pJsonHandler);
+	if(NULL == pValue || NULL == pDataStruct) {
+		return false;
+	}
 
-	for(i = 1; i < tokenCount; ) {
-		if(jsoneq(pJsonDocument, &(jsonTokenStruct[i]), pDataStruct->pKey) == 0) {
-			dataToken = jsonTokenStruct[i + 1];
-			dataLength = (uint32_t) (dataToken.end - dataToken.start);
-			UpdateValueIfNoObject(pJsonDocument, pDataStruct, dataToken);
-			*pDataPosition = dataToken.start;
-			*pDataLength = dataLength;
-			return true;
-		} else if(jsoneq(pJsonDocument, &(jsonTokenStruct[i]), "metadata") == 0) {
-			/* Sanity check: must not be at the last key in the json object. */
-			if(i >= tokenCount-2)
-			{
-				return false;
-			}
+	memset(&dataToken, 0, sizeof(dataToken));
+	dataToken.type = valueType;
+	dataToken.start = 0;
+	dataToken.end = (int) valueLength;
 
-			/* Record where the metadata object ends. */
-			metadataEnd = jsonTokenStruct[i+1].end;
+	return SUCCESS == UpdateValueIfNoObject(pValue, pDataStruct, dataToken);
+}
 
-			/* Skip past the "metadata" key and jsmn object element. */
-			i+= 2;
+int32_t findNextJsonKey(const char *pJsonDocument, void *pJsonHandler, int32_t tokenCount, int32_t tokenIndex,
+						const char **ppKey, uint32_t *pKeyLength) {
+	int32_t i = tokenIndex, metadataEnd;
 
-			/* Skip past every key inside "metadata". Keys inside "metadata" have
-			 * have an end character before the end of the metadata object.
-			 */
-			while(jsonTokenStruct[i].end < metadataEnd)
-			{
-				i++;
-			}
+	IOT_UNUSED(pJsonHandler);
+
+	if(i < 1) {
+		i = 1;
+	} else if(jsoneq(pJsonDocument, &(jsonTokenStruct[i]), "metadata") == 0) {
+		/* Sanity check: must not be at the last key in the json object. */
+		if(i >= tokenCount - 2) {
+			return -1;
 		}
-		else
-		{
-			/* Only increment the loop counter if the current object doesn't
-			 * match AND isn't "metadata".
-			 */
+
+		/* Record where the metadata object ends. */
+		metadataEnd = jsonTokenStruct[i + 1].end;
+
+		/* Skip past the "metadata" key and jsmn object element. */
+		i += 2;
+
+		/* Skip past every key inside "metadata". Keys inside "metadata" have
+		 * have an end character before the end of the metadata object.
+		 */
+		while(i < tokenCount && jsonTokenStruct[i].end < metadataEnd) {
 			i++;
 		}
+	} else {
+		i++;
+	}
+
+	/* Every string that is followed by another token can be a key */
+	for(; i < tokenCount - 1; i++) {
+		if(jsonTokenStruct[i].type == JSMN_STRING) {
+			*ppKey = pJsonDocument + jsonTokenStruct[i].start;
+			*pKeyLength = (uint32_t) (jsonTokenStruct[i].end - jsonTokenStruct[i].start);
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+int32_t findJsonStateKey(const char *pJsonDocument, void *pJsonHandler, int32_t tokenCount, int32_t *pStateEnd) {
+	jsmntok_t *pState;
+	int32_t i;
+
+	IOT_UNUSED(pJsonHandler);
+
+	pState = findToken("state", pJsonDocument, &(jsonTokenStruct[0]));
+	if(NULL == pState) {
+		return -1;
+	}
+
+	/* Every token inside the value starts before the value ends */
+	i = (int32_t) (pState - jsonTokenStruct) + 1;
+	while(i < tokenCount && jsonTokenStruct[i].start < pState->end) {
+		i++;
+	}
+	*pStateEnd = i;
+
+	return (int32_t) (pState - jsonTokenStruct) - 1;
+}
+
+bool updateValueOfJsonKey(const char *pJsonDocument, void *pJsonHandler, int32_t tokenCount, int32_t keyIndex,
+						  jsonStruct_t *pDataStruct, uint32_t *pDataLength, int32_t *pDataPosition) {
+	jsmntok_t dataToken;
+
+	IOT_UNUSED(pJsonHandler);
+
+	if(keyIndex < 1 || keyIndex >= tokenCount - 1) {
+		return false;
+	}
+
+	dataToken = jsonTokenStruct[keyIndex + 1];
+	UpdateValueIfNoObject(pJsonDocument, pDataStruct, dataToken);
+	*pDataPosition = dataToken.start;
+	*pDataLength = (uint32_t) (dataToken.end - dataToken.start);
+
+	return true;
+}
+
+bool isJsonKeyMatchingAndUpdateValue(const char *pJsonDocument, void *pJsonHandler, int32_t tokenCount,
+									 jsonStruct_t *pDataStruct, uint32_t *pDataLength, int32_t *pDataPosition) {
+	int32_t i;
+	const char *pKey;
+	uint32_t keyLength;
+	size_t dataKeyLength = strlen(pDataStruct->pKey);
+
+	for(i = findNextJsonKey(pJsonDocument, pJsonHandler, tokenCount, 0, &pKey, &keyLength); i > 0;
+		i = findNextJsonKey(pJsonDocument, pJsonHandler, tokenCount, i, &pKey, &keyLength)) {
+		if(keyLength == dataKeyLength && strncmp(pKey, pDataStruct->pKey, keyLength) == 0) {
+			return updateValueOfJsonKey(pJsonDocument, pJsonHandler, tokenCount, i, pDataStruct, pDataLength,
+										pDataPosition);
+		}
 	}
 	return false;
 }
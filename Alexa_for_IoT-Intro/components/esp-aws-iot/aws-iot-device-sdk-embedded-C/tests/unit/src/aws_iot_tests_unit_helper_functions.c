@@ -288,6 +288,7 @@ void setTLSRxBufferWithMsgOnSubscribedTopic(char *topicName, size_t topicNameLen
 											IoT_Publish_Message_Params params, char *pMsg) {
 	size_t VariableLen = topicNameLen + 2 + 2;
 	size_t i = 0, cursor = 0, packetIdStartLoc = 0, payloadStartLoc = 0, VarHeaderStartLoc = 0;
+	size_t fixedHeaderLen = 0;
 	size_t PayloadLen = strlen(pMsg) + 1;
 
 	RxBuffer.NoMsgFlag = false;
@@ -297,6 +298,7 @@ void setTLSRxBufferWithMsgOnSubscribedTopic(char *topicName, size_t topicNameLen
 	// Remaining Length
 	// Translate the Remaining Length into packet bytes
 	encodeRemainingLength(RxBuffer.pBuffer, &cursor, VariableLen + PayloadLen);
+	fixedHeaderLen = cursor;
 
 	VarHeaderStartLoc = cursor - 1;
 	// Variable header
@@ -321,7 +323,7 @@ void setTLSRxBufferWithMsgOnSubscribedTopic(char *topicName, size_t topicNameLen
 		RxBuffer.pBuffer[payloadStartLoc + i] = (unsigned char) pMsg[i];
 	}
 
-	RxBuffer.len = VariableLen + PayloadLen + 2; // 2 for fixed header
+	RxBuffer.len = VariableLen + PayloadLen + fixedHeaderLen; // remaining length takes more than 1 byte from 128
 	RxIndex = 0;
 	//printBuffer(RxBuffer.pBuffer, RxBuffer.len);
 }
@@ -0,0 +1,44 @@
+/*
+* Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_tests_unit_publish_gather.cpp
+ * @brief IoT Client Unit Testing - Publish From The Application's Buffer Tests
+ */
+
+#include <CppUTest/CommandLineTestRunner.h>
+#include <CppUTest/TestHarness_c.h>
+
+TEST_GROUP_C(PublishGatherTests){
+	TEST_GROUP_C_SETUP_WRAPPER(PublishGatherTests)
+	TEST_GROUP_C_TEARDOWN_WRAPPER(PublishGatherTests)
+};
+
+/* M:1 - QoS0 payload larger than the TX buffer is sent from the application's buffer */
+TEST_GROUP_C_WRAPPER(PublishGatherTests, PublishGatherLargeQos0)
+/* M:2 - QoS1 payload larger than the TX buffer, PUBACK received */
+TEST_GROUP_C_WRAPPER(PublishGatherTests, PublishGatherLargeQos1)
+/* M:3 - Small payload is copied and sent in one write */
+TEST_GROUP_C_WRAPPER(PublishGatherTests, PublishSmallPayloadCopied)
+/* M:4 - Network layer without writev, large payload does not fit the TX buffer */
+TEST_GROUP_C_WRAPPER(PublishGatherTests, PublishLargeWithoutWritev)
+/* M:5 - Header larger than the TX buffer */
+TEST_GROUP_C_WRAPPER(PublishGatherTests, PublishGatherHeaderTooLong)
+/* M:6 - Network layer takes the packet in several partial writes */
+TEST_GROUP_C_WRAPPER(PublishGatherTests, PublishGatherPartialWrites)
+/* M:7 - Async publish of a large payload, sent again with DUP after a lost PUBACK */
+TEST_GROUP_C_WRAPPER(PublishGatherTests, PublishAsyncGatherRetransmit)
+/* M:8 - TX buffer and CPU time of a 16 KB publish, gathered against copied */
+TEST_GROUP_C_WRAPPER(PublishGatherTests, PublishGather16KBenchmark)
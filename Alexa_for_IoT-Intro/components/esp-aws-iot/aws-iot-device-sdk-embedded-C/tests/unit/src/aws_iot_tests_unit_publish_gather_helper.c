@@ -0,0 +1,302 @@
+/*
+* Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_tests_unit_publish_gather_helper.c
+ * @brief IoT Client Unit Testing - Publish From The Application's Buffer Tests Helper
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <CppUTest/TestHarness_c.h>
+
+#include "aws_iot_mqtt_client_interface.h"
+#include "aws_iot_tests_unit_helper_functions.h"
+#include "aws_iot_tests_unit_mock_tls_params.h"
+#include "aws_iot_log.h"
+
+/* Larger than AWS_IOT_MQTT_TX_BUF_LEN, small enough for the mock to keep all of it */
+#define PUB_GATHER_TEST_PAYLOAD_LEN 2000
+#define PUB_GATHER_TEST_YIELD_MS 10
+#define PUB_GATHER_BENCH_PAYLOAD_LEN (16 * 1024)
+#define PUB_GATHER_BENCH_MESSAGES 5000
+
+static IoT_Client_Init_Params initParams;
+static IoT_Client_Connect_Params connectParams;
+static IoT_Publish_Message_Params testPubMsgParams;
+static AWS_IoT_Client iotClient;
+static char pubTopic[] = "sdk/Test";
+
+static unsigned char largePayload[PUB_GATHER_BENCH_PAYLOAD_LEN];
+static unsigned char copyBuffer[PUB_GATHER_BENCH_PAYLOAD_LEN + 16];
+
+static IoT_Error_t completedResult;
+static uint32_t completedCount;
+
+static void publishCompleted(AWS_IoT_Client *pClient, uint16_t packetId, IoT_Error_t result, void *pData) {
+	IOT_UNUSED(pClient);
+	IOT_UNUSED(packetId);
+	IOT_UNUSED(pData);
+
+	completedResult = result;
+	completedCount++;
+}
+
+static uint64_t cpuTimeUs(void) {
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return ((uint64_t) usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000 +
+		   (uint64_t) usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+static void setPayload(QoS qos, size_t payloadLen) {
+	testPubMsgParams.qos = qos;
+	testPubMsgParams.isRetained = 0;
+	testPubMsgParams.payload = (void *) largePayload;
+	testPubMsgParams.payloadLen = payloadLen;
+}
+
+TEST_GROUP_C_SETUP(PublishGatherTests) {
+	IoT_Error_t rc;
+	size_t i;
+
+	ResetTLSBuffer();
+	memset(&mockBroker, 0, sizeof(mockBroker));
+	memset(&mockNetwork, 0, sizeof(mockNetwork));
+	InitMQTTParamsSetup(&initParams, AWS_IOT_MQTT_HOST, AWS_IOT_MQTT_PORT, false, NULL);
+	initParams.mqttCommandTimeout_ms = 500;
+	rc = aws_iot_mqtt_init(&iotClient, &initParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	ConnectMQTTParamsSetup(&connectParams, AWS_IOT_MQTT_CLIENT_ID, (uint16_t) strlen(AWS_IOT_MQTT_CLIENT_ID));
+	setTLSRxBufferForConnack(&connectParams, 0, 0);
+	rc = aws_iot_mqtt_connect(&iotClient, &connectParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	for(i = 0; i < sizeof(largePayload); i++) {
+		largePayload[i] = (unsigned char) ('a' + (i % 26));
+	}
+
+	completedCount = 0;
+	completedResult = FAILURE;
+	ResetTLSBuffer();
+	memset(&mockNetwork, 0, sizeof(mockNetwork));
+}
+
+TEST_GROUP_C_TEARDOWN(PublishGatherTests) {
+	memset(&mockBroker, 0, sizeof(mockBroker));
+	memset(&mockNetwork, 0, sizeof(mockNetwork));
+}
+
+/* M:1 - QoS0 payload larger than the TX buffer is sent from the application's buffer */
+TEST_C(PublishGatherTests, PublishGatherLargeQos0) {
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Publish Gather Tests - M:1 - Large QoS0 payload sent from the application's buffer \n");
+
+	setPayload(QOS0, PUB_GATHER_TEST_PAYLOAD_LEN);
+	rc = aws_iot_mqtt_publish(&iotClient, pubTopic, 8, &testPubMsgParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	CHECK_EQUAL_C_INT(1, mockNetwork.writevCount);
+	CHECK_EQUAL_C_INT(0, mockNetwork.writeCount);
+	/* Header byte, two remaining length bytes, topic length and topic */
+	CHECK_EQUAL_C_INT(1 + 2 + 2 + 8 + PUB_GATHER_TEST_PAYLOAD_LEN, mockNetwork.bytesWritten);
+	CHECK_EQUAL_C_STRING(pubTopic, LastPublishMessageTopic);
+	CHECK_EQUAL_C_INT(PUB_GATHER_TEST_PAYLOAD_LEN, lastPublishMessagePayloadLen);
+	CHECK_EQUAL_C_INT(0, memcmp(largePayload, LastPublishMessagePayload, PUB_GATHER_TEST_PAYLOAD_LEN));
+
+	IOT_DEBUG("-->Success - M:1 - Large QoS0 payload sent from the application's buffer \n");
+}
+
+/* M:2 - QoS1 payload larger than the TX buffer, PUBACK received */
+TEST_C(PublishGatherTests, PublishGatherLargeQos1) {
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Publish Gather Tests - M:2 - Large QoS1 payload, PUBACK received \n");
+
+	setPayload(QOS1, PUB_GATHER_TEST_PAYLOAD_LEN);
+	setTLSRxBufferForPuback();
+	rc = aws_iot_mqtt_publish(&iotClient, pubTopic, 8, &testPubMsgParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	CHECK_EQUAL_C_INT(1, mockNetwork.writevCount);
+	CHECK_EQUAL_C_INT(1 + 2 + 2 + 8 + 2 + PUB_GATHER_TEST_PAYLOAD_LEN, mockNetwork.bytesWritten);
+	CHECK_EQUAL_C_STRING(pubTopic, LastPublishMessageTopic);
+	CHECK_EQUAL_C_INT(0, memcmp(largePayload, LastPublishMessagePayload, PUB_GATHER_TEST_PAYLOAD_LEN));
+
+	IOT_DEBUG("-->Success - M:2 - Large QoS1 payload, PUBACK received \n");
+}
+
+/* M:3 - Small payload is copied and sent in one write */
+TEST_C(PublishGatherTests, PublishSmallPayloadCopied) {
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Publish Gather Tests - M:3 - Small payload copied \n");
+
+	setPayload(QOS0, AWS_IOT_MQTT_PUBLISH_GATHER_MIN_PAYLOAD - 1);
+	rc = aws_iot_mqtt_publish(&iotClient, pubTopic, 8, &testPubMsgParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	CHECK_EQUAL_C_INT(0, mockNetwork.writevCount);
+	CHECK_EQUAL_C_INT(1, mockNetwork.writeCount);
+	CHECK_EQUAL_C_INT(AWS_IOT_MQTT_PUBLISH_GATHER_MIN_PAYLOAD - 1, lastPublishMessagePayloadLen);
+	CHECK_EQUAL_C_INT(0, memcmp(largePayload, LastPublishMessagePayload, AWS_IOT_MQTT_PUBLISH_GATHER_MIN_PAYLOAD - 1));
+
+	IOT_DEBUG("-->Success - M:3 - Small payload copied \n");
+}
+
+/* M:4 - Network layer without writev, large payload does not fit the TX buffer */
+TEST_C(PublishGatherTests, PublishLargeWithoutWritev) {
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Publish Gather Tests - M:4 - Network layer without writev \n");
+
+	iotClient.networkStack.writev = NULL;
+
+	setPayload(QOS0, PUB_GATHER_TEST_PAYLOAD_LEN);
+	rc = aws_iot_mqtt_publish(&iotClient, pubTopic, 8, &testPubMsgParams);
+	CHECK_EQUAL_C_INT(MQTT_TX_BUFFER_TOO_SHORT_ERROR, rc);
+	CHECK_EQUAL_C_INT(0, mockNetwork.bytesWritten);
+
+	/* Anything that fits is still sent */
+	setPayload(QOS0, AWS_IOT_MQTT_TX_BUF_LEN / 2);
+	rc = aws_iot_mqtt_publish(&iotClient, pubTopic, 8, &testPubMsgParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(0, mockNetwork.writevCount);
+	CHECK_EQUAL_C_INT(1, mockNetwork.writeCount);
+	CHECK_EQUAL_C_INT(0, memcmp(largePayload, LastPublishMessagePayload, AWS_IOT_MQTT_TX_BUF_LEN / 2));
+
+	IOT_DEBUG("-->Success - M:4 - Network layer without writev \n");
+}
+
+/* M:5 - Header larger than the TX buffer */
+TEST_C(PublishGatherTests, PublishGatherHeaderTooLong) {
+	char longTopic[AWS_IOT_MQTT_TX_BUF_LEN + 1];
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Publish Gather Tests - M:5 - Header larger than the TX buffer \n");
+
+	memset(longTopic, 't', sizeof(longTopic));
+
+	setPayload(QOS0, PUB_GATHER_TEST_PAYLOAD_LEN);
+	rc = aws_iot_mqtt_publish(&iotClient, longTopic, (uint16_t) sizeof(longTopic), &testPubMsgParams);
+	CHECK_EQUAL_C_INT(MQTT_TX_BUFFER_TOO_SHORT_ERROR, rc);
+	CHECK_EQUAL_C_INT(0, mockNetwork.writevCount);
+
+	IOT_DEBUG("-->Success - M:5 - Header larger than the TX buffer \n");
+}
+
+/* M:6 - Network layer takes the packet in several partial writes */
+TEST_C(PublishGatherTests, PublishGatherPartialWrites) {
+	IoT_Error_t rc;
+	size_t packetLen = 1 + 2 + 2 + 8 + PUB_GATHER_TEST_PAYLOAD_LEN;
+
+	IOT_DEBUG("-->Running Publish Gather Tests - M:6 - Partial writes \n");
+
+	/* Splits inside the header as well as inside the payload */
+	mockNetwork.maxWriteLen = 7;
+	setPayload(QOS0, PUB_GATHER_TEST_PAYLOAD_LEN);
+	rc = aws_iot_mqtt_publish(&iotClient, pubTopic, 8, &testPubMsgParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	CHECK_EQUAL_C_INT((packetLen + 6) / 7, mockNetwork.writevCount);
+	CHECK_EQUAL_C_INT(packetLen, mockNetwork.bytesWritten);
+	CHECK_EQUAL_C_INT(0, mockNetwork.txPacketLeft);
+	CHECK_EQUAL_C_STRING(pubTopic, LastPublishMessageTopic);
+	CHECK_EQUAL_C_INT(0, memcmp(largePayload, LastPublishMessagePayload, PUB_GATHER_TEST_PAYLOAD_LEN));
+
+	IOT_DEBUG("-->Success - M:6 - Partial writes \n");
+}
+
+/* M:7 - Async publish of a large payload, sent again with DUP after a lost PUBACK */
+TEST_C(PublishGatherTests, PublishAsyncGatherRetransmit) {
+	IoT_Error_t rc;
+	uint32_t itr;
+
+	IOT_DEBUG("-->Running Publish Gather Tests - M:7 - Async large payload sent again with DUP \n");
+
+	mockBroker.isEnabled = true;
+	mockBroker.roundTripMs = 10;
+	mockBroker.dropCount = 1;
+
+	setPayload(QOS1, PUB_GATHER_TEST_PAYLOAD_LEN);
+	rc = aws_iot_mqtt_publish_async(&iotClient, pubTopic, 8, &testPubMsgParams, publishCompleted, NULL);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	for(itr = 0; itr < 10 * AWS_IOT_MQTT_PUBLISH_RETRANSMIT_MS / PUB_GATHER_TEST_YIELD_MS && 0 == completedCount;
+		itr++) {
+		rc = aws_iot_mqtt_yield(&iotClient, PUB_GATHER_TEST_YIELD_MS);
+		CHECK_EQUAL_C_INT(SUCCESS, rc);
+	}
+
+	CHECK_EQUAL_C_INT(1, completedCount);
+	CHECK_EQUAL_C_INT(SUCCESS, completedResult);
+	CHECK_EQUAL_C_INT(2, mockBroker.publishCount);
+	CHECK_EQUAL_C_INT(1, mockBroker.dupCount);
+	CHECK_EQUAL_C_INT(2, mockNetwork.writevCount);
+	CHECK_EQUAL_C_INT(0, memcmp(largePayload, LastPublishMessagePayload, PUB_GATHER_TEST_PAYLOAD_LEN));
+
+	IOT_DEBUG("-->Success - M:7 - Async large payload sent again with DUP \n");
+}
+
+/* M:8 - TX buffer and CPU time of a 16 KB publish, gathered against copied */
+TEST_C(PublishGatherTests, PublishGather16KBenchmark) {
+	IoT_Error_t rc;
+	uint32_t itr;
+	uint64_t cpuStart, gatherCpuUs, copyCpuUs;
+	size_t headerLen, packetLen;
+
+	IOT_DEBUG("-->Running Publish Gather Tests - M:8 - 16 KB publish benchmark \n");
+
+	setPayload(QOS0, PUB_GATHER_BENCH_PAYLOAD_LEN);
+
+	cpuStart = cpuTimeUs();
+	for(itr = 0; itr < PUB_GATHER_BENCH_MESSAGES; itr++) {
+		rc = aws_iot_mqtt_publish(&iotClient, pubTopic, 8, &testPubMsgParams);
+		CHECK_EQUAL_C_INT(SUCCESS, rc);
+	}
+	gatherCpuUs = cpuTimeUs() - cpuStart;
+
+	CHECK_EQUAL_C_INT(PUB_GATHER_BENCH_MESSAGES, mockNetwork.writevCount);
+	packetLen = mockNetwork.bytesWritten / PUB_GATHER_BENCH_MESSAGES;
+	headerLen = packetLen - PUB_GATHER_BENCH_PAYLOAD_LEN;
+
+	/* The copy path cannot send this with the test TX buffer, it does the same plus copying
+	 * header and payload into a TX buffer of the packet's size */
+	cpuStart = cpuTimeUs();
+	for(itr = 0; itr < PUB_GATHER_BENCH_MESSAGES; itr++) {
+		memcpy(copyBuffer, iotClient.clientData.writeBuf, headerLen);
+		memcpy(&copyBuffer[headerLen], largePayload, PUB_GATHER_BENCH_PAYLOAD_LEN);
+		/* Keep the copy from being optimized away */
+		largePayload[itr % PUB_GATHER_BENCH_PAYLOAD_LEN] = copyBuffer[packetLen - 1 - (itr % headerLen)];
+	}
+	copyCpuUs = gatherCpuUs + cpuTimeUs() - cpuStart;
+
+	printf("\n16 KB QoS0 publish, %u messages:", PUB_GATHER_BENCH_MESSAGES);
+	printf("\n  gathered: TX buffer %5u bytes, %4u.%02u us CPU per publish", (unsigned) headerLen,
+		   (unsigned) (gatherCpuUs / PUB_GATHER_BENCH_MESSAGES),
+		   (unsigned) ((gatherCpuUs * 100 / PUB_GATHER_BENCH_MESSAGES) % 100));
+	printf("\n  copied:   TX buffer %5u bytes, %4u.%02u us CPU per publish\n", (unsigned) packetLen,
+		   (unsigned) (copyCpuUs / PUB_GATHER_BENCH_MESSAGES),
+		   (unsigned) ((copyCpuUs * 100 / PUB_GATHER_BENCH_MESSAGES) % 100));
+
+	CHECK_C(headerLen < AWS_IOT_MQTT_TX_BUF_LEN);
+	CHECK_C(packetLen > AWS_IOT_MQTT_TX_BUF_LEN);
+
+	IOT_DEBUG("-->Success - M:8 - 16 KB publish benchmark \n");
+}
@@ -19,10 +19,13 @@
  */
 
 #include <string.h>
+#include <stdio.h>
+#include <time.h>
 #include <CppUTest/TestHarness_c.h>
 #include <aws_iot_shadow_interface.h>
 
 #include "aws_iot_shadow_actions.h"
+#include "aws_iot_shadow_json.h"
 #include "aws_iot_log.h"
 #include "aws_iot_tests_unit_helper_functions.h"
 
@@ -35,6 +38,16 @@ static IoT_Client_Connect_Params connectParams;
 static ShadowInitParameters_t shadowInitParams;
 static ShadowConnectParameters_t shadowConnectParams;
 
+#define BUILDER_BENCHMARK_FIELDS 24
+#define BUILDER_BENCHMARK_ROUNDS 20000
+
+static uint64_t builderBenchmarkNowNs(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000000u) + (uint64_t) ts.tv_nsec;
+}
+
 TEST_GROUP_C_SETUP(ShadowJsonBuilderTests) {
 	IoT_Error_t ret_val;
 
@@ -129,3 +142,241 @@ TEST_C(ShadowJsonBuilderTests, SmallBuffer) {
 	ret_val = aws_iot_finalize_json_document(updateRequestJson, jsonBufSize);
 	CHECK_EQUAL_C_INT(SHADOW_JSON_ERROR, ret_val);
 }
+
+TEST_C(ShadowJsonBuilderTests, BuildReportedDocument) {
+	IoT_Error_t ret_val;
+	char updateRequestJson[SIZE_OF_UPFATE_BUF];
+	jsonStruct_t handlers[2];
+
+	IOT_DEBUG("\n-->Running Shadow Json Builder Tests - Build reported document from an array \n");
+
+	handlers[0] = dataDoubleHandler;
+	handlers[1] = dataFloatHandler;
+	ret_val = aws_iot_shadow_build_reported(handlers, 2, updateRequestJson, sizeof(updateRequestJson));
+	CHECK_EQUAL_C_INT(SUCCESS, ret_val);
+	CHECK_EQUAL_C_STRING(TEST_JSON_RESPONSE_UPDATE_DOCUMENT, updateRequestJson);
+
+	ret_val = aws_iot_shadow_build_reported(NULL, 2, updateRequestJson, sizeof(updateRequestJson));
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, ret_val);
+	ret_val = aws_iot_shadow_build_reported(handlers, 2, NULL, sizeof(updateRequestJson));
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, ret_val);
+	handlers[1].pData = NULL;
+	ret_val = aws_iot_shadow_build_reported(handlers, 2, updateRequestJson, sizeof(updateRequestJson));
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, ret_val);
+}
+
+TEST_C(ShadowJsonBuilderTests, WriterNumbersMatchSnprintf) {
+	static const double doubles[] = {0.0, -0.0, 1.0, -1.0, 0.5, 0.0000005, 0.0000015, 0.0078125, 0.0234375, -0.0078125,
+									 0.9999995, 0.99999949999, 1.0000005, 123456.7890125, 4.0908f, 3.445f, 1e-7, -1e-7,
+									 999999999999999.9, 1e15, -1e15, 1e300, 4294967295.5, 18446744073709551615.0};
+	static const int32_t integers[] = {0, 1, -1, 9, 10, -10, 32767, -32768, 2147483647, -2147483647 - 1};
+	char document[96], expected[400];
+	ShadowJsonWriter_t writer;
+	jsonStruct_t value;
+	double randomValue;
+	float floatValue;
+	uint32_t seed = 12345u, i;
+	int32_t intValue;
+
+	IOT_DEBUG("\n-->Running Shadow Json Builder Tests - Writer numbers are the same as with snprintf \n");
+
+	value.pKey = "v";
+	value.cb = NULL;
+	for(i = 0; i < sizeof(doubles) / sizeof(doubles[0]) + 20000; i++) {
+		if(i < sizeof(doubles) / sizeof(doubles[0])) {
+			randomValue = doubles[i];
+		} else {
+			/* Spread over many magnitudes, with short binary fractions to hit halfway cases */
+			seed = seed * 1664525u + 1013904223u;
+			randomValue = (double) (int32_t) seed / (double) (1u << (seed % 31));
+			if(0 == i % 3) {
+				randomValue = (double) (int32_t) (seed >> 8) / 128.0;
+			}
+		}
+		value.type = SHADOW_JSON_DOUBLE;
+		value.pData = &randomValue;
+		aws_iot_shadow_json_writer_init(&writer, document, sizeof(document));
+		aws_iot_shadow_json_writer_add(&writer, &value);
+		snprintf(expected, sizeof(expected), "{\"state\":{\"v\":%f", randomValue);
+		if(strlen(expected) < sizeof(document)) {
+			CHECK_EQUAL_C_INT(SUCCESS, writer.status);
+			CHECK_EQUAL_C_STRING(expected, document);
+		}
+
+		floatValue = (float) randomValue;
+		value.type = SHADOW_JSON_FLOAT;
+		value.pData = &floatValue;
+		aws_iot_shadow_json_writer_init(&writer, document, sizeof(document));
+		aws_iot_shadow_json_writer_add(&writer, &value);
+		snprintf(expected, sizeof(expected), "{\"state\":{\"v\":%f", floatValue);
+		if(strlen(expected) < sizeof(document)) {
+			CHECK_EQUAL_C_STRING(expected, document);
+		}
+	}
+
+	value.type = SHADOW_JSON_INT32;
+	value.pData = &intValue;
+	for(i = 0; i < sizeof(integers) / sizeof(integers[0]); i++) {
+		intValue = integers[i];
+		aws_iot_shadow_json_writer_init(&writer, document, sizeof(document));
+		aws_iot_shadow_json_writer_add(&writer, &value);
+		snprintf(expected, sizeof(expected), "{\"state\":{\"v\":%d", (int) intValue);
+		CHECK_EQUAL_C_STRING(expected, document);
+	}
+}
+
+TEST_C(ShadowJsonBuilderTests, WriterSectionsAndStrings) {
+	IoT_Error_t ret_val;
+	char updateRequestJson[SIZE_OF_UPFATE_BUF];
+	char mode[] = "a\"b\\c\n";
+	char nested[] = "{\"x\":[1,2]}";
+	int8_t level = -5;
+	uint16_t fan = 65535;
+	bool isOn = false;
+	jsonStruct_t modeHandler = {"mode", mode, sizeof(mode), SHADOW_JSON_STRING, NULL};
+	jsonStruct_t nestedHandler = {"nested", nested, sizeof(nested), SHADOW_JSON_OBJECT, NULL};
+	jsonStruct_t levelHandler = {"level", &level, sizeof(level), SHADOW_JSON_INT8, NULL};
+	jsonStruct_t fanHandler = {"fan", &fan, sizeof(fan), SHADOW_JSON_UINT16, NULL};
+	jsonStruct_t isOnHandler = {"isOn", &isOn, sizeof(isOn), SHADOW_JSON_BOOL, NULL};
+	ShadowJsonWriter_t writer;
+
+	IOT_DEBUG("\n-->Running Shadow Json Builder Tests - Writer with desired and reported sections \n");
+
+	ret_val = aws_iot_shadow_json_writer_init(&writer, updateRequestJson, sizeof(updateRequestJson));
+	CHECK_EQUAL_C_INT(SUCCESS, ret_val);
+	aws_iot_shadow_json_writer_begin_object(&writer, "desired");
+	aws_iot_shadow_json_writer_add(&writer, &modeHandler);
+	aws_iot_shadow_json_writer_add(&writer, &isOnHandler);
+	aws_iot_shadow_json_writer_end_object(&writer);
+	aws_iot_shadow_json_writer_begin_object(&writer, "reported");
+	aws_iot_shadow_json_writer_add(&writer, &levelHandler);
+	aws_iot_shadow_json_writer_add(&writer, &fanHandler);
+	aws_iot_shadow_json_writer_add(&writer, &nestedHandler);
+	ret_val = aws_iot_shadow_json_writer_finalize(&writer);
+	CHECK_EQUAL_C_INT(SUCCESS, ret_val);
+
+	CHECK_EQUAL_C_STRING("{\"state\":{\"desired\":{\"mode\":\"a\\\"b\\\\c\\u000a\",\"isOn\":false},"
+						 "\"reported\":{\"level\":-5,\"fan\":65535,\"nested\":{\"x\":[1,2]}}}, "
+						 "\"clientToken\":\"" AWS_IOT_MQTT_CLIENT_ID "-0\"}", updateRequestJson);
+	CHECK_EQUAL_C_INT(strlen(updateRequestJson), writer.length);
+	CHECK_C(isReceivedJsonValid(updateRequestJson, writer.length));
+
+	/* Closing the document or adding to it once it is finalized are errors */
+	ret_val = aws_iot_shadow_json_writer_init(&writer, updateRequestJson, sizeof(updateRequestJson));
+	CHECK_EQUAL_C_INT(SUCCESS, ret_val);
+	ret_val = aws_iot_shadow_json_writer_end_object(&writer);
+	CHECK_EQUAL_C_INT(SUCCESS, ret_val);
+	ret_val = aws_iot_shadow_json_writer_end_object(&writer);
+	CHECK_EQUAL_C_INT(SHADOW_JSON_ERROR, ret_val);
+	ret_val = aws_iot_shadow_json_writer_init(&writer, updateRequestJson, sizeof(updateRequestJson));
+	CHECK_EQUAL_C_INT(SUCCESS, ret_val);
+	ret_val = aws_iot_shadow_json_writer_finalize(&writer);
+	CHECK_EQUAL_C_INT(SUCCESS, ret_val);
+	ret_val = aws_iot_shadow_json_writer_add(&writer, &levelHandler);
+	CHECK_EQUAL_C_INT(SHADOW_JSON_ERROR, ret_val);
+}
+
+TEST_C(ShadowJsonBuilderTests, WriterSmallBuffer) {
+	IoT_Error_t ret_val;
+	char updateRequestJson[14];
+	jsonStruct_t handlers[2];
+	ShadowJsonWriter_t writer;
+
+	IOT_DEBUG("\n-->Running Shadow Json Builder Tests - Writer buffer is too small \n");
+
+	handlers[0] = dataDoubleHandler;
+	handlers[1] = dataFloatHandler;
+	ret_val = aws_iot_shadow_build_reported(handlers, 2, updateRequestJson, sizeof(updateRequestJson));
+	CHECK_EQUAL_C_INT(SHADOW_JSON_BUFFER_TRUNCATED, ret_val);
+	CHECK_EQUAL_C_STRING("{\"state\":{\"re", updateRequestJson);
+
+	ret_val = aws_iot_shadow_json_writer_init(&writer, updateRequestJson, sizeof(updateRequestJson));
+	CHECK_EQUAL_C_INT(SUCCESS, ret_val);
+	ret_val = aws_iot_shadow_json_writer_add(&writer, &dataDoubleHandler);
+	CHECK_EQUAL_C_INT(SHADOW_JSON_BUFFER_TRUNCATED, ret_val);
+	ret_val = aws_iot_shadow_json_writer_finalize(&writer);
+	CHECK_EQUAL_C_INT(SHADOW_JSON_BUFFER_TRUNCATED, ret_val);
+	CHECK_EQUAL_C_INT(sizeof(updateRequestJson) - 1, strlen(updateRequestJson));
+
+	ret_val = aws_iot_shadow_json_writer_init(&writer, updateRequestJson, 0);
+	CHECK_EQUAL_C_INT(SHADOW_JSON_ERROR, ret_val);
+}
+
+TEST_C(ShadowJsonBuilderTests, BuilderBenchmark) {
+	static jsonStruct_t handlers[BUILDER_BENCHMARK_FIELDS];
+	static char keys[BUILDER_BENCHMARK_FIELDS][16];
+	static char legacyJson[1024], writerJson[1024];
+	static int32_t intValues[BUILDER_BENCHMARK_FIELDS];
+	static float floatValues[BUILDER_BENCHMARK_FIELDS];
+	static bool boolValues[BUILDER_BENCHMARK_FIELDS];
+	static char stringValue[] = "heating";
+	IoT_Error_t ret_val = SUCCESS;
+	uint32_t i, round;
+	uint64_t start, legacyNs, writerNs;
+	size_t length;
+
+	IOT_DEBUG("\n-->Running Shadow Json Builder Tests - Variadic builder against writer benchmark \n");
+
+	/* A mix like the one a thermostat reports: mostly numbers, some flags and a string */
+	for(i = 0; i < BUILDER_BENCHMARK_FIELDS; i++) {
+		snprintf(keys[i], sizeof(keys[i]), "sensor_%02u", i);
+		handlers[i].pKey = keys[i];
+		handlers[i].cb = NULL;
+		if(0 == i % 3) {
+			floatValues[i] = 20.5f + (float) i * 0.37f;
+			handlers[i].type = SHADOW_JSON_FLOAT;
+			handlers[i].pData = &floatValues[i];
+			handlers[i].dataLength = sizeof(float);
+		} else if(1 == i % 3) {
+			intValues[i] = (int32_t) (i * 7919) - 40000;
+			handlers[i].type = SHADOW_JSON_INT32;
+			handlers[i].pData = &intValues[i];
+			handlers[i].dataLength = sizeof(int32_t);
+		} else if(i < BUILDER_BENCHMARK_FIELDS - 1) {
+			boolValues[i] = (0 == i % 2);
+			handlers[i].type = SHADOW_JSON_BOOL;
+			handlers[i].pData = &boolValues[i];
+			handlers[i].dataLength = sizeof(bool);
+		} else {
+			handlers[i].type = SHADOW_JSON_STRING;
+			handlers[i].pData = stringValue;
+			handlers[i].dataLength = sizeof(stringValue);
+		}
+	}
+
+#define BUILDER_BENCHMARK_ARGS(h) &h[0], &h[1], &h[2], &h[3], &h[4], &h[5], &h[6], &h[7], &h[8], &h[9], &h[10], \
+		&h[11], &h[12], &h[13], &h[14], &h[15], &h[16], &h[17], &h[18], &h[19], &h[20], &h[21], &h[22], &h[23]
+
+	start = builderBenchmarkNowNs();
+	for(round = 0; round < BUILDER_BENCHMARK_ROUNDS && SUCCESS == ret_val; round++) {
+		resetClientTokenSequenceNum();
+		ret_val = aws_iot_shadow_init_json_document(legacyJson, sizeof(legacyJson));
+		if(SUCCESS == ret_val) {
+			ret_val = aws_iot_shadow_add_reported(legacyJson, sizeof(legacyJson), BUILDER_BENCHMARK_FIELDS,
+												  BUILDER_BENCHMARK_ARGS(handlers));
+		}
+		if(SUCCESS == ret_val) {
+			ret_val = aws_iot_finalize_json_document(legacyJson, sizeof(legacyJson));
+		}
+	}
+	legacyNs = builderBenchmarkNowNs() - start;
+	CHECK_EQUAL_C_INT(SUCCESS, ret_val);
+
+	start = builderBenchmarkNowNs();
+	for(round = 0; round < BUILDER_BENCHMARK_ROUNDS && SUCCESS == ret_val; round++) {
+		resetClientTokenSequenceNum();
+		ret_val = aws_iot_shadow_build_reported(handlers, BUILDER_BENCHMARK_FIELDS, writerJson, sizeof(writerJson));
+	}
+	writerNs = builderBenchmarkNowNs() - start;
+	CHECK_EQUAL_C_INT(SUCCESS, ret_val);
+
+	CHECK_EQUAL_C_STRING(legacyJson, writerJson);
+
+	length = strlen(writerJson);
+	printf("\nShadow JSON builder, %u fields, %u byte document: variadic %llu ns (%llu KB/s), writer %llu ns (%llu KB/s)\n",
+		   BUILDER_BENCHMARK_FIELDS, (unsigned) length,
+		   (unsigned long long) (legacyNs / BUILDER_BENCHMARK_ROUNDS),
+		   (unsigned long long) ((uint64_t) length * BUILDER_BENCHMARK_ROUNDS * 1000000000u / 1024u / (legacyNs + 1)),
+		   (unsigned long long) (writerNs / BUILDER_BENCHMARK_ROUNDS),
+		   (unsigned long long) ((uint64_t) length * BUILDER_BENCHMARK_ROUNDS * 1000000000u / 1024u / (writerNs + 1)));
+}
@@ -0,0 +1,42 @@
+/*
+* Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_tests_unit_shadow_reporter.cpp
+ * @brief IoT Client Unit Testing - Shadow Reporter Tests
+ */
+
+#include <CppUTest/CommandLineTestRunner.h>
+#include <CppUTest/TestHarness_c.h>
+
+TEST_GROUP_C(ShadowReporterTests){
+	TEST_GROUP_C_SETUP_WRAPPER(ShadowReporterTests)
+	TEST_GROUP_C_TEARDOWN_WRAPPER(ShadowReporterTests)
+};
+
+/* J:1 - Init with Null parameters */
+TEST_GROUP_C_WRAPPER(ShadowReporterTests, InitInvalidParams)
+/* J:2 - First update reports every field */
+TEST_GROUP_C_WRAPPER(ShadowReporterTests, FirstBuildReportsEveryField)
+/* J:3 - Only fields past their deadband are reported */
+TEST_GROUP_C_WRAPPER(ShadowReporterTests, DeadbandAndChangedFields)
+/* J:4 - Fields of an update that was not accepted are sent again, changes in flight are coalesced */
+TEST_GROUP_C_WRAPPER(ShadowReporterTests, NotAcceptedFieldsSentAgain)
+/* J:5 - Minimum interval per field and between updates */
+TEST_GROUP_C_WRAPPER(ShadowReporterTests, MinimumIntervals)
+/* J:6 - Update with a client that is not connected */
+TEST_GROUP_C_WRAPPER(ShadowReporterTests, UpdateNotConnected)
+/* J:7 - Bytes sent for a thermostat sensor trace, full documents vs changed fields */
+TEST_GROUP_C_WRAPPER(ShadowReporterTests, SensorTraceSimulation)
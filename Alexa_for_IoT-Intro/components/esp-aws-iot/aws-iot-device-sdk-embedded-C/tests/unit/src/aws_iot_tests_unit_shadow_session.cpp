@@ -0,0 +1,42 @@
+/*
+* Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_tests_unit_shadow_session.cpp
+ * @brief IoT Client Unit Testing - Shadow Persistent Ack Subscription Tests
+ */
+
+#include <CppUTest/CommandLineTestRunner.h>
+#include <CppUTest/TestHarness_c.h>
+
+TEST_GROUP_C(ShadowSessionTests){
+	TEST_GROUP_C_SETUP_WRAPPER(ShadowSessionTests)
+	TEST_GROUP_C_TEARDOWN_WRAPPER(ShadowSessionTests)
+};
+
+/* N:1 - Accepted/rejected subscriptions are made once and kept between requests */
+TEST_GROUP_C_WRAPPER(ShadowSessionTests, SessionSubscribesOnce)
+/* N:2 - Without persistent subscriptions, every request subscribes and unsubscribes */
+TEST_GROUP_C_WRAPPER(ShadowSessionTests, LegacySubscribesPerRequest)
+/* N:3 - Timed out request keeps the subscriptions */
+TEST_GROUP_C_WRAPPER(ShadowSessionTests, SessionTimeoutKeepsSubscription)
+/* N:4 - Several requests in flight are matched by client token */
+TEST_GROUP_C_WRAPPER(ShadowSessionTests, SessionMatchesAcksByToken)
+/* N:5 - Things beyond the topic cache subscribe per request */
+TEST_GROUP_C_WRAPPER(ShadowSessionTests, SessionUncachedThingSubscribesPerRequest)
+/* N:6 - Round trips and latency of updates, persistent against per request subscriptions */
+TEST_GROUP_C_WRAPPER(ShadowSessionTests, SessionUpdateBenchmark)
+/* N:7 - Reconnecting drops the kept subscriptions instead of adding to them */
+TEST_GROUP_C_WRAPPER(ShadowSessionTests, SessionReconnectSubscribesAgain)
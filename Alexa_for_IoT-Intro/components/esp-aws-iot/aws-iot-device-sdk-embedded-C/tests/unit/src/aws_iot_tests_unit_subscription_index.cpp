@@ -0,0 +1,48 @@
+/*
+* Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_tests_unit_subscription_index.cpp
+ * @brief IoT Client Unit Testing - Subscription Index Tests
+ */
+
+#include <CppUTest/CommandLineTestRunner.h>
+#include <CppUTest/TestHarness_c.h>
+
+TEST_GROUP_C(SubscriptionIndexTests){
+	TEST_GROUP_C_SETUP_WRAPPER(SubscriptionIndexTests)
+	TEST_GROUP_C_TEARDOWN_WRAPPER(SubscriptionIndexTests)
+};
+
+/* H:1 - Init with Null/invalid parameters */
+TEST_GROUP_C_WRAPPER(SubscriptionIndexTests, InitInvalidParams)
+/* H:2 - Exact topic filters */
+TEST_GROUP_C_WRAPPER(SubscriptionIndexTests, ExactFilters)
+/* H:3 - Single level wildcard filters */
+TEST_GROUP_C_WRAPPER(SubscriptionIndexTests, SingleLevelWildcardFilters)
+/* H:4 - Multi level wildcard filters */
+TEST_GROUP_C_WRAPPER(SubscriptionIndexTests, MultiLevelWildcardFilters)
+/* H:5 - Same filter registered by two handlers */
+TEST_GROUP_C_WRAPPER(SubscriptionIndexTests, DuplicateFilters)
+/* H:6 - Removing filters releases trie nodes and hash buckets */
+TEST_GROUP_C_WRAPPER(SubscriptionIndexTests, RemoveFilters)
+/* H:7 - Filters the index does not handle are still matched */
+TEST_GROUP_C_WRAPPER(SubscriptionIndexTests, FallbackFilters)
+/* H:8 - Trie node pool exhausted */
+TEST_GROUP_C_WRAPPER(SubscriptionIndexTests, TrieNodePoolExhausted)
+/* H:9 - Index agrees with the linear scan over a mixed filter set */
+TEST_GROUP_C_WRAPPER(SubscriptionIndexTests, MatchesLinearScan)
+/* H:10 - Dispatch cost against handler count, linear scan vs index */
+TEST_GROUP_C_WRAPPER(SubscriptionIndexTests, DispatchBenchmark)
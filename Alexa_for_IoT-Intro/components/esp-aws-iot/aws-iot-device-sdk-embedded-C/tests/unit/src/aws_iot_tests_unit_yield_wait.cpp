@@ -0,0 +1,40 @@
+/*
+* Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_tests_unit_yield_wait.cpp
+ * @brief IoT Client Unit Testing - Yield Waiting For Socket Data Tests
+ */
+
+#include <CppUTest/CommandLineTestRunner.h>
+#include <CppUTest/TestHarness_c.h>
+
+TEST_GROUP_C(YieldWaitTests){
+	TEST_GROUP_C_SETUP_WRAPPER(YieldWaitTests)
+	TEST_GROUP_C_TEARDOWN_WRAPPER(YieldWaitTests)
+};
+
+/* L:1 - Idle yield sleeps in the network layer instead of polling */
+TEST_GROUP_C_WRAPPER(YieldWaitTests, YieldIdleWaitsForData)
+/* L:2 - Message arriving during the wait is handled at once */
+TEST_GROUP_C_WRAPPER(YieldWaitTests, YieldWakesOnData)
+/* L:3 - Wait ends at the keep-alive deadline to send PINGREQ */
+TEST_GROUP_C_WRAPPER(YieldWaitTests, YieldWakesForKeepAlive)
+/* L:4 - Yield wakeup from the application */
+TEST_GROUP_C_WRAPPER(YieldWaitTests, YieldWakeup)
+/* L:5 - Network layer without waitForData is polled */
+TEST_GROUP_C_WRAPPER(YieldWaitTests, YieldPollsWithoutWaitForData)
+/* L:6 - Wakeups and CPU time of an idle connection, waiting against polling */
+TEST_GROUP_C_WRAPPER(YieldWaitTests, YieldIdleWakeups)
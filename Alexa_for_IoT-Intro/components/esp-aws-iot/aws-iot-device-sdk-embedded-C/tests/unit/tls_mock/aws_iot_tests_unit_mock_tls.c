@@ -1,5 +1,6 @@
 #include <string.h>
 #include <stdio.h>
+#include <unistd.h>
 #include <network_interface.h>
 
 #include "network_interface.h"
@@ -27,9 +28,12 @@ IoT_Error_t iot_tls_init(Network *pNetwork, char *pRootCALocation, char *pDevice
 	pNetwork->connect = iot_tls_connect;
 	pNetwork->read = iot_tls_read;
 	pNetwork->write = iot_tls_write;
+	pNetwork->writev = iot_tls_writev;
 	pNetwork->disconnect = iot_tls_disconnect;
 	pNetwork->isConnected = iot_tls_is_connected;
 	pNetwork->destroy = iot_tls_destroy;
+	pNetwork->waitForData = iot_tls_wait_for_data;
+	pNetwork->wakeup = iot_tls_wakeup;
 
 	return SUCCESS;
 }
@@ -77,7 +81,7 @@ static size_t iot_tls_mqtt_read_variable_length_int(const unsigned char *buffer,
 	size_t pos = startPos;
 	size_t multiplier = 1;
 	do {
-		result = (buffer[pos] & 0x7f) * multiplier;
+		result += (buffer[pos] & 0x7f) * multiplier;
 		multiplier *= 0x80;
 		pos++;
 	} while ((buffer[pos - 1] & 0x80) && pos - startPos < 4);
@@ -106,29 +110,112 @@ static uint16_t iot_tls_mqtt_copy_string_from_message(char *dest, const unsigned
 	return length;
 }
 
-IoT_Error_t iot_tls_write(Network *pNetwork, unsigned char *pMsg, size_t len, Timer *timer, size_t *written_len) {
-	size_t i = 0;
-	uint8_t firstPacketByte;
-	size_t mqttPacketLength;
-	size_t variableHeaderStart;
-	IoT_Error_t status = SUCCESS;
-	IOT_UNUSED(pNetwork);
-	IOT_UNUSED(timer);
+/* Queues a packet to be read after the simulated round trip */
+static void iot_tls_mock_broker_queue(const unsigned char *pPacket, size_t len) {
+	struct timeval now, duration;
+	size_t slot = mockBroker.pendingTail % MOCK_BROKER_MAX_PENDING_PACKETS;
 
-	if(TxBuffer.mockedError != SUCCESS ) {
-		status = TxBuffer.mockedError;
+	if(mockBroker.pendingTail - mockBroker.pendingHead >= MOCK_BROKER_MAX_PENDING_PACKETS ||
+	   len > MOCK_BROKER_MAX_PACKET_LEN) {
+		return;
+	}
 
-		/* Clear the error before returning. */
-		TxBuffer.mockedError = SUCCESS;
+	gettimeofday(&now, NULL);
+	duration.tv_sec = mockBroker.roundTripMs / 1000;
+	duration.tv_usec = (mockBroker.roundTripMs % 1000) * 1000;
+	timeradd(&now, &duration, &(mockBroker.pendingDue[slot]));
+	memcpy(mockBroker.pendingPacket[slot], pPacket, len);
+	mockBroker.pendingLen[slot] = len;
+	mockBroker.pendingTail++;
+}
 
-		return status;
+static void iot_tls_mock_broker_receive_publish(uint8_t firstPacketByte, uint16_t packetId) {
+	unsigned char puback[4] = {0x40, 0x02, 0, 0};
+
+	mockBroker.publishCount++;
+	if(firstPacketByte & 0x08) {
+		mockBroker.dupCount++;
 	}
 
-	for(i = 0; (i < len) && left_ms(timer) > 0; i++) {
-		TxBuffer.pBuffer[i] = pMsg[i];
+	if(mockBroker.dropCount > 0) {
+		mockBroker.dropCount--;
+		return;
 	}
-	TxBuffer.len = len;
-	*written_len = len;
+
+	puback[2] = (unsigned char) (packetId >> 8);
+	puback[3] = (unsigned char) (packetId & 0xFF);
+	iot_tls_mock_broker_queue(puback, sizeof(puback));
+}
+
+/* Acknowledges a SUBSCRIBE with QoS 0 granted, or an UNSUBSCRIBE */
+static void iot_tls_mock_broker_receive_subscription(uint8_t firstPacketByte, uint16_t packetId) {
+	unsigned char ack[5];
+	size_t len;
+
+	if(firstPacketByte == 0x82) {
+		mockBroker.subscribeCount++;
+		ack[0] = 0x90;
+		ack[1] = 0x03;
+		ack[4] = 0x00;
+		len = 5;
+	} else {
+		mockBroker.unsubscribeCount++;
+		ack[0] = 0xB0;
+		ack[1] = 0x02;
+		len = 4;
+	}
+	ack[2] = (unsigned char) (packetId >> 8);
+	ack[3] = (unsigned char) (packetId & 0xFF);
+	iot_tls_mock_broker_queue(ack, len);
+}
+
+/* Answers a PUBLISH on $aws/things/{thingName}/shadow/{get|update|delete} on its accepted topic */
+static void iot_tls_mock_broker_receive_shadow_action(const char *pTopic, const char *pPayload) {
+	unsigned char packet[MOCK_BROKER_MAX_PACKET_LEN];
+	char acceptedTopic[MOCK_BROKER_MAX_PACKET_LEN];
+	char response[MOCK_BROKER_MAX_PACKET_LEN];
+	char clientToken[MAX_SIZE_CLIENT_TOKEN_CLIENT_SEQUENCE] = "";
+	const char *pAction = strstr(pTopic, "/shadow/");
+	const char *pToken = strstr(pPayload, "\"clientToken\":\"");
+	size_t topicLen, responseLen, i;
+
+	if(NULL == pAction || (0 != strcmp(pAction, "/shadow/get") && 0 != strcmp(pAction, "/shadow/update") &&
+						   0 != strcmp(pAction, "/shadow/delete"))) {
+		return;
+	}
+	mockBroker.shadowActionCount++;
+
+	if(NULL != pToken) {
+		pToken += strlen("\"clientToken\":\"");
+		for(i = 0; i < sizeof(clientToken) - 1 && pToken[i] != '"' && pToken[i] != 0; i++) {
+			clientToken[i] = pToken[i];
+		}
+		clientToken[i] = 0;
+	}
+
+	snprintf(acceptedTopic, sizeof(acceptedTopic), "%s/accepted", pTopic);
+	snprintf(response, sizeof(response), "{\"clientToken\":\"%s\"}", clientToken);
+	topicLen = strlen(acceptedTopic);
+	responseLen = strlen(response);
+	if(4 + topicLen + responseLen > sizeof(packet) || 2 + topicLen + responseLen > 127) {
+		return;
+	}
+
+	packet[0] = 0x30;
+	packet[1] = (unsigned char) (2 + topicLen + responseLen);
+	packet[2] = (unsigned char) (topicLen >> 8);
+	packet[3] = (unsigned char) (topicLen & 0xFF);
+	memcpy(&packet[4], acceptedTopic, topicLen);
+	memcpy(&packet[4 + topicLen], response, responseLen);
+	iot_tls_mock_broker_queue(packet, 4 + topicLen + responseLen);
+}
+
+/* Records the SUBSCRIBE, UNSUBSCRIBE or PUBLISH at the start of TxBuffer */
+static void iot_tls_mock_parse_tx_buffer(void) {
+	uint8_t firstPacketByte;
+	size_t mqttPacketLength;
+	size_t variableHeaderStart;
+	size_t copyLen;
 
 	mqttPacketLength = iot_tls_mqtt_read_variable_length_int(TxBuffer.pBuffer, 1);
 	variableHeaderStart = iot_tls_mqtt_get_end_of_variable_length_int(TxBuffer.pBuffer, 1);
@@ -141,9 +228,17 @@ IoT_Error_t iot_tls_write(Network *pNetwork, unsigned char *pMsg, size_t len, Ti
 
 		lastSubscribeMsgLen = iot_tls_mqtt_copy_string_from_message(
 				LastSubscribeMessage, TxBuffer.pBuffer, variableHeaderStart + 2);
+		if(mockBroker.isEnabled && mockBroker.isServingShadow) {
+			iot_tls_mock_broker_receive_subscription(
+					firstPacketByte, iot_tls_mqtt_get_fixed_uint16_from_message(TxBuffer.pBuffer, variableHeaderStart));
+		}
 	} else if (firstPacketByte == 0xA2) {
 		lastUnsubscribeMsgLen = iot_tls_mqtt_copy_string_from_message(
 						LastUnsubscribeMessage, TxBuffer.pBuffer, variableHeaderStart + 2);
+		if(mockBroker.isEnabled && mockBroker.isServingShadow) {
+			iot_tls_mock_broker_receive_subscription(
+					firstPacketByte, iot_tls_mqtt_get_fixed_uint16_from_message(TxBuffer.pBuffer, variableHeaderStart));
+		}
 	} else if ((firstPacketByte & 0x30) == 0x30) {
 		QoS qos = (QoS) (firstPacketByte & 0x6 >> 1);
 
@@ -156,9 +251,108 @@ IoT_Error_t iot_tls_write(Network *pNetwork, unsigned char *pMsg, size_t len, Ti
 			payloadStart += 2;
 		}
 
-		lastPublishMessagePayloadLen = mqttPacketLength - payloadStart + 2; /* + 2 as the first two bytes don't count towards the length */
-		memcpy(LastPublishMessagePayload, TxBuffer.pBuffer + payloadStart, lastPublishMessagePayloadLen);
-		LastPublishMessagePayload[lastPublishMessagePayloadLen] = 0;
+		lastPublishMessagePayloadLen = mqttPacketLength + variableHeaderStart - payloadStart;
+		/* TxBuffer only holds the start of a large payload */
+		copyLen = lastPublishMessagePayloadLen;
+		if(payloadStart + copyLen > TxBuffer.len) {
+			copyLen = TxBuffer.len - payloadStart;
+		}
+		memcpy(LastPublishMessagePayload, TxBuffer.pBuffer + payloadStart, copyLen);
+		LastPublishMessagePayload[copyLen] = 0;
+
+		if(mockBroker.isEnabled && (firstPacketByte & 0x06) == 0x02) {
+			iot_tls_mock_broker_receive_publish(firstPacketByte, iot_tls_mqtt_get_fixed_uint16_from_message(
+					TxBuffer.pBuffer, variableHeaderStart + 2 + lastPublishMessageTopicLen));
+		}
+		if(mockBroker.isEnabled && mockBroker.isServingShadow) {
+			iot_tls_mock_broker_receive_shadow_action(LastPublishMessageTopic, LastPublishMessagePayload);
+		}
+	}
+}
+
+IoT_Error_t iot_tls_write(Network *pNetwork, unsigned char *pMsg, size_t len, Timer *timer, size_t *written_len) {
+	size_t i = 0;
+	IoT_Error_t status = SUCCESS;
+	IOT_UNUSED(pNetwork);
+	IOT_UNUSED(timer);
+
+	mockNetwork.writeCount++;
+
+	if(TxBuffer.mockedError != SUCCESS ) {
+		status = TxBuffer.mockedError;
+
+		/* Clear the error before returning. */
+		TxBuffer.mockedError = SUCCESS;
+
+		return status;
+	}
+
+	for(i = 0; (i < len) && left_ms(timer) > 0; i++) {
+		TxBuffer.pBuffer[i] = pMsg[i];
+	}
+	TxBuffer.len = len;
+	*written_len = len;
+	mockNetwork.bytesWritten += len;
+
+	iot_tls_mock_parse_tx_buffer();
+
+	return status;
+}
+
+IoT_Error_t iot_tls_writev(Network *pNetwork, const NetworkIoVec *pVector, size_t count, Timer *timer,
+						   size_t *written_len) {
+	size_t i, len, keepLen;
+	size_t total = 0;
+	IoT_Error_t status = SUCCESS;
+	IOT_UNUSED(pNetwork);
+	IOT_UNUSED(timer);
+
+	mockNetwork.writevCount++;
+
+	if(TxBuffer.mockedError != SUCCESS ) {
+		status = TxBuffer.mockedError;
+
+		/* Clear the error before returning. */
+		TxBuffer.mockedError = SUCCESS;
+
+		return status;
+	}
+
+	/* A new packet starts at the front of TxBuffer, the rest of a partly written one is appended */
+	if(0 == mockNetwork.txPacketLeft) {
+		TxBuffer.len = 0;
+	}
+
+	for(i = 0; i < count; i++) {
+		len = pVector[i].len;
+		if(0 < mockNetwork.maxWriteLen && total + len > mockNetwork.maxWriteLen) {
+			len = mockNetwork.maxWriteLen - total;
+		}
+
+		/* Only the start of a large packet is kept */
+		keepLen = len;
+		if(TxBuffer.len + keepLen > TxBuffer.BufMaxSize - 1) {
+			keepLen = TxBuffer.BufMaxSize - 1 - TxBuffer.len;
+		}
+		memcpy(&(TxBuffer.pBuffer[TxBuffer.len]), pVector[i].pBuffer, keepLen);
+		TxBuffer.len += keepLen;
+
+		total += len;
+		if(len < pVector[i].len) {
+			break;
+		}
+	}
+	*written_len = total;
+	mockNetwork.bytesWritten += total;
+
+	if(0 == mockNetwork.txPacketLeft) {
+		mockNetwork.txPacketLeft = iot_tls_mqtt_get_end_of_variable_length_int(TxBuffer.pBuffer, 1) +
+								   iot_tls_mqtt_read_variable_length_int(TxBuffer.pBuffer, 1);
+	}
+	mockNetwork.txPacketLeft -= total;
+
+	if(0 == mockNetwork.txPacketLeft) {
+		iot_tls_mock_parse_tx_buffer();
 	}
 
 	return status;
@@ -180,12 +374,32 @@ static unsigned char isTimerExpired(struct timeval target_time) {
 	return ret_val;
 }
 
+/* Puts the next packet that is due into the RX buffer, once the previous packet was read */
+static void iot_tls_mock_broker_send_pending(void) {
+	size_t slot = mockBroker.pendingHead % MOCK_BROKER_MAX_PENDING_PACKETS;
+
+	if(mockBroker.pendingHead == mockBroker.pendingTail || RxIndex < RxBuffer.len ||
+	   !isTimerExpired(mockBroker.pendingDue[slot])) {
+		return;
+	}
+
+	memcpy(RxBuffer.pBuffer, mockBroker.pendingPacket[slot], mockBroker.pendingLen[slot]);
+	RxBuffer.len = mockBroker.pendingLen[slot];
+	RxBuffer.NoMsgFlag = false;
+	RxBuffer.expiry_time.tv_sec = 0;
+	RxBuffer.expiry_time.tv_usec = 0;
+	RxIndex = 0;
+	mockBroker.pendingHead++;
+}
+
 IoT_Error_t iot_tls_read(Network *pNetwork, unsigned char *pMsg, size_t len, Timer *pTimer, size_t *read_len) {
 	IoT_Error_t status = SUCCESS;
 
 	IOT_UNUSED(pNetwork);
 	IOT_UNUSED(pTimer);
 
+	mockNetwork.readCount++;
+
 	if(RxBuffer.mockedError != SUCCESS) {
 		status = RxBuffer.mockedError;
 
@@ -195,11 +409,18 @@ IoT_Error_t iot_tls_read(Network *pNetwork, unsigned char *pMsg, size_t len, Tim
 		return status;
 	}
 
+	if(mockBroker.isEnabled) {
+		iot_tls_mock_broker_send_pending();
+	}
+
 	if(RxIndex > TLSMaxBufferSize - 1) {
 		RxIndex = TLSMaxBufferSize - 1;
 	}
 
 	if(RxBuffer.len <= RxIndex || !isTimerExpired(RxBuffer.expiry_time)) {
+		if(0 < mockNetwork.readTimeoutUs) {
+			usleep(mockNetwork.readTimeoutUs);
+		}
 		return NETWORK_SSL_NOTHING_TO_READ;
 	}
 
@@ -212,6 +433,64 @@ IoT_Error_t iot_tls_read(Network *pNetwork, unsigned char *pMsg, size_t len, Tim
 	return status;
 }
 
+/* Microseconds until the target time, 0 if it has passed */
+static uint32_t usUntil(struct timeval target_time) {
+	struct timeval now, result;
+
+	gettimeofday(&now, NULL);
+	timersub(&target_time, &now, &result);
+	if(result.tv_sec < 0) {
+		return 0;
+	}
+	return (uint32_t) (result.tv_sec * 1000000 + result.tv_usec);
+}
+
+/* Sleeps until the RX buffer or the next packet of the mock broker is due, like select() on a socket */
+IoT_Error_t iot_tls_wait_for_data(Network *pNetwork, Timer *pTimer) {
+	uint32_t sleepUs;
+
+	IOT_UNUSED(pNetwork);
+
+	mockNetwork.waitCount++;
+
+	for(;;) {
+		if(mockNetwork.isWakeupPending) {
+			mockNetwork.isWakeupPending = false;
+			return NETWORK_SSL_NOTHING_TO_READ;
+		}
+
+		if(mockBroker.isEnabled) {
+			iot_tls_mock_broker_send_pending();
+		}
+
+		/* An injected error shows up on the next read, as a socket error would wake select() */
+		if(RxBuffer.mockedError != SUCCESS || (RxIndex < RxBuffer.len && isTimerExpired(RxBuffer.expiry_time))) {
+			return SUCCESS;
+		}
+
+		if(has_timer_expired(pTimer)) {
+			return NETWORK_SSL_NOTHING_TO_READ;
+		}
+
+		sleepUs = left_ms(pTimer) * 1000;
+		if(RxIndex < RxBuffer.len && usUntil(RxBuffer.expiry_time) < sleepUs) {
+			sleepUs = usUntil(RxBuffer.expiry_time);
+		}
+		if(mockBroker.isEnabled && mockBroker.pendingHead != mockBroker.pendingTail &&
+		   usUntil(mockBroker.pendingDue[mockBroker.pendingHead % MOCK_BROKER_MAX_PENDING_PACKETS]) < sleepUs) {
+			sleepUs = usUntil(mockBroker.pendingDue[mockBroker.pendingHead % MOCK_BROKER_MAX_PENDING_PACKETS]);
+		}
+		usleep(sleepUs > 0 ? sleepUs : 100);
+	}
+}
+
+IoT_Error_t iot_tls_wakeup(Network *pNetwork) {
+	IOT_UNUSED(pNetwork);
+
+	mockNetwork.isWakeupPending = true;
+	return SUCCESS;
+}
+
 IoT_Error_t iot_tls_disconnect(Network *pNetwork) {
 	IOT_UNUSED(pNetwork);
 	return SUCCESS;
@@ -40,6 +40,45 @@ typedef struct {
 } TlsBuffer;
 
 
+/* Mock broker, acknowledges QoS 1 PUBLISH packets after a simulated round trip.
+ * Serving the shadow, it also acknowledges SUBSCRIBE and UNSUBSCRIBE and accepts every shadow action. */
+#define MOCK_BROKER_MAX_PENDING_PACKETS 64
+#define MOCK_BROKER_MAX_PACKET_LEN 256
+
+typedef struct {
+	bool isEnabled;
+	uint32_t roundTripMs;
+	uint32_t dropCount; /* Number of next QoS 1 PUBLISH packets left without PUBACK */
+	uint32_t publishCount; /* QoS 1 PUBLISH packets received */
+	uint32_t dupCount; /* QoS 1 PUBLISH packets received with the DUP flag */
+	bool isServingShadow;
+	uint32_t subscribeCount; /* SUBSCRIBE packets received while serving the shadow */
+	uint32_t unsubscribeCount; /* UNSUBSCRIBE packets received while serving the shadow */
+	uint32_t shadowActionCount; /* PUBLISH packets received on shadow action topics */
+	unsigned char pendingPacket[MOCK_BROKER_MAX_PENDING_PACKETS][MOCK_BROKER_MAX_PACKET_LEN];
+	size_t pendingLen[MOCK_BROKER_MAX_PENDING_PACKETS];
+	struct timeval pendingDue[MOCK_BROKER_MAX_PENDING_PACKETS];
+	size_t pendingHead;
+	size_t pendingTail;
+} MockBroker;
+
+extern MockBroker mockBroker;
+
+/* Calls into the mock network layer, to compare waiting for data with polling and copied with gathered writes */
+typedef struct {
+	uint32_t readCount;
+	uint32_t waitCount;
+	uint32_t readTimeoutUs; /* Time a read with nothing to read blocks, as the SSL read timeout of a port */
+	bool isWakeupPending;
+	uint32_t writeCount;
+	uint32_t writevCount;
+	size_t bytesWritten;
+	size_t maxWriteLen; /* Bytes a writev call takes at most, 0 for no limit */
+	size_t txPacketLeft; /* Bytes of the packet in TxBuffer still to be written by writev */
+} MockNetwork;
+
+extern MockNetwork mockNetwork;
+
 extern TlsBuffer RxBuffer;
 extern TlsBuffer TxBuffer;
 
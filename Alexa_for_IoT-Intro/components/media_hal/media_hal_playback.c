@@ -24,7 +24,7 @@
 
 #include <esp_log.h>
 #include <string.h>
-#include <resampling.h>
+#include <audio_resampler.h>
 #include <audio_board.h>
 #include <esp_equalizer.h>
 #include "media_hal_playback.h"
@@ -49,7 +49,7 @@ static bool i2s_stop_flag = false;
 /* Contains data or config relevant to a playback. */
 typedef struct media_hal_playback {
     media_hal_playback_cfg_t cfg;
-    audio_resample_config_t resample;
+    audio_resampler_t *resampler; /* Recreated when the format of the audio changes */
     void *eq_handle; /* equalizer handle */
     bool is_disabled;
 } media_hal_playback_t;
@@ -271,7 +271,6 @@ void *media_hal_init_playback(media_hal_playback_cfg_t *cfg)
 int media_hal_playback_play(media_hal_playback_t *playback, media_hal_audio_info_t *audio_info, void *buf, int len)
 {
     media_hal_playback_cfg_t *cfg = &playback->cfg;
-    audio_resample_config_t *resample = &playback->resample; /* We need these to be separate */
     int current_convert_block_len;
     int convert_block_len = 0;
     int send_offset = 0;
@@ -282,13 +281,28 @@ int media_hal_playback_play(media_hal_playback_t *playback, media_hal_audio_info
     /**
      * Just check if first sample is zero and replace it with -1, a very small value.
      * pop-pop noise on es8388 codec devices can be fixed with this hack.
+     * `buf` may point straight into a ring buffer, so only assume sample (2 byte) alignment,
+     * and a region at the wrap point may hold a single sample.
      */
-    uint32_t *x = (uint32_t *) buf;
-    if (__builtin_expect(*x == 0, false)) {
-        *x = 0xffffffff;
+    uint16_t *x = (uint16_t *) buf;
+    if (len >= 4) {
+        if (__builtin_expect(x[0] == 0 && x[1] == 0, false)) {
+            x[0] = x[1] = 0xffff;
+        }
+    } else if (len >= 2) {
+        if (__builtin_expect(x[0] == 0, false)) {
+            x[0] = 0xffff;
+        }
     }
 #endif
 
+    playback->resampler = audio_resampler_update(playback->resampler, audio_info->sample_rate, cfg->sample_rate,
+                                                 audio_info->channels, cfg->channels, AUDIO_RESAMPLER_QUALITY_DEFAULT);
+    if (!playback->resampler) {
+        ESP_LOGE(TAG, "No resampler for %d Hz %d ch", audio_info->sample_rate, audio_info->channels);
+        return sent_len;
+    }
+
     if ((audio_info->channels == 1) && (cfg->channels == 2))  {
         /* If mono recording, we need to up-sample, so need half the buffer empty, also uint16_t data*/
         convert_block_len = CONVERT_BUF_SIZE / 4;
@@ -306,16 +320,11 @@ int media_hal_playback_play(media_hal_playback_t *playback, media_hal_audio_info
             printf("%s: Odd bytes in up sampling data, this should be backed up\n", TAG);
         }
         
-        if (((audio_info->channels == 2) && (cfg->channels == 2)) || ((audio_info->channels == 1) && (cfg->channels == 1))) {
-            conv_len = audio_resample((short *) ((char *) buf + send_offset), (short *) convert_buf, audio_info->sample_rate,
-                                                 cfg->sample_rate, current_convert_block_len / 2, BUF_SZ, audio_info->channels, resample);
-        } else if ((audio_info->channels == 1) && (cfg->channels == 2))  {
-            conv_len = audio_resample_up_channel((short *) ((char *) buf + send_offset), (short *) convert_buf, audio_info->sample_rate,
-                                                 cfg->sample_rate, current_convert_block_len / 2, BUF_SZ, resample);
-        } else if ((audio_info->channels == 2) && (cfg->channels == 1)) {
-            conv_len = audio_resample_down_channel((short *) ((char *) buf + send_offset), (short *) convert_buf, audio_info->sample_rate,
-                                                 cfg->sample_rate, current_convert_block_len / 2, BUF_SZ, 0, resample);
-        }
+        /* Rate and channels are converted in one pass. A partial frame at the end of buf is dropped. */
+        int out_frames = audio_resampler_process(playback->resampler, (int16_t *) ((char *) buf + send_offset),
+                                                 current_convert_block_len / 2 / audio_info->channels,
+                                                 (int16_t *) convert_buf, BUF_SZ / 2 / cfg->channels);
+        conv_len = (out_frames > 0) ? out_frames * cfg->channels : 0;
 
         len -= current_convert_block_len;
         /* The reason send_offset and send_len are different is because we could be converting from 24K to 16K */
@@ -79,6 +79,7 @@ typedef struct multipart_callbacks_t {
 void multipart_init(multipart_handle_t *handle, char *boundary);
 
 /* Function to parse the response. The buffer of the specified size (a part of the request) is passed to this function and the function does all the callbacks to the sections of the response. */
+/* Body data is given to data_cb in spans as long as the buffer allows, the callbacks are the same however the response is split into buffers. */
 int multipart_parse_data(multipart_handle_t *handle, multipart_callbacks_t *cbs, char *buffer, int buffer_size);
 
 #endif /* _MULTIPART_H_ */
@@ -27,16 +27,126 @@ This file has the function definations required for the multipart parser
 */
 
 #include <stdio.h>
+#include <stdint.h>
+#include <string.h>
 #include <multipart.h>
 
 static const char *TAG = "[multipart]";
 
+/* Boundary looked for in the body. The first one has no CRLF in front of it. */
+static const char *multipart_body_boundary(multipart_handle_t *handle, int *length)
+{
+    int skip = handle->first_buffer ? 2 : 0;
+    *length = handle->boundary_length - skip;
+    return handle->boundary + skip;
+}
+
+/* Data before the first boundary is a preamble and not part of any part */
+static void multipart_body_data(multipart_handle_t *handle, multipart_callbacks_t *cbs, const char *data, int size)
+{
+    if (size > 0 && !handle->first_buffer) {
+        cbs->data_cb(handle, data, size);
+    }
+}
+
+/* A whole boundary was found, the part (if any) ends here */
+static void multipart_body_end(multipart_handle_t *handle, multipart_callbacks_t *cbs)
+{
+    if (!handle->first_buffer) {
+        cbs->data_cb(handle, NULL, 0);
+        cbs->part_end_cb(handle);
+    } else {
+        handle->first_buffer = 0;
+    }
+    handle->state = finding_first_CR;
+    handle->matcher = 0;
+    handle->prev_matcher = 0;
+}
+
+/**
+ * Body of a part: hand out everything up to the boundary in as few callbacks as possible.
+ *
+ * The boundary is searched with Boyer-Moore-Horspool, so most of the body is skipped boundary_length bytes
+ * at a time. A boundary that may continue into the next buffer is held back in handle->matcher and checked
+ * when that buffer comes in. Consumes the buffer up to and including the boundary, or all of it.
+ */
+static void multipart_parse_body(multipart_handle_t *handle, multipart_callbacks_t *cbs, char *buffer, int buffer_size)
+{
+    int length;
+    const char *boundary = multipart_body_boundary(handle, &length);
+    const char *end = buffer + buffer_size;
+    const char *start = buffer + handle->iterator;
+    const char *p = start;
+
+    /* The previous buffer ended with the first handle->matcher bytes of the boundary */
+    while (handle->matcher > 0 && p < end) {
+        if (*p == boundary[handle->matcher]) {
+            p++;
+            handle->matcher++;
+            if (handle->matcher == length) {
+                multipart_body_end(handle, cbs);
+                handle->iterator = p - buffer;
+                return;
+            }
+            continue;
+        }
+        /* Not the boundary after all. Keep the part of the held back bytes it could still start in. */
+        int shift = 1;
+        while (shift < handle->matcher && memcmp(boundary + shift, boundary, handle->matcher - shift) != 0) {
+            shift++;
+        }
+        multipart_body_data(handle, cbs, boundary, shift);
+        handle->matcher -= shift;
+    }
+    if (handle->matcher > 0) {
+        handle->iterator = buffer_size;
+        return;
+    }
+    handle->state = finding_data;
+    start = p;
+
+    /* Skip table, built here as the handle has no room for it. Boundaries are at most 100 bytes. */
+    uint8_t skip[256];
+    memset(skip, length, sizeof(skip));
+    for (int i = 0; i < length - 1; i++) {
+        skip[(uint8_t) boundary[i]] = length - 1 - i;
+    }
+
+    const char *last = boundary + length - 1;
+    const char *window = start;
+    while (window + length <= end) {
+        const char *w_last = window + length - 1;
+        if (*w_last == *last && memcmp(window, boundary, length - 1) == 0) {
+            multipart_body_data(handle, cbs, start, window - start);
+            multipart_body_end(handle, cbs);
+            handle->iterator = w_last + 1 - buffer;
+            return;
+        }
+        window += skip[(uint8_t) *w_last];
+    }
+
+    /* No whole boundary left in the buffer. Hold back a start of it at the end, if there is one. */
+    const char *tail = window;
+    while ((tail = memchr(tail, boundary[0], end - tail)) != NULL) {
+        if (memcmp(tail, boundary, end - tail) == 0) {
+            break;
+        }
+        tail++;
+    }
+    multipart_body_data(handle, cbs, start, (tail ? tail : end) - start);
+    if (tail) {
+        handle->matcher = end - tail;
+        handle->state = finding_boundary;
+    }
+    handle->iterator = buffer_size;
+}
+
 /* Initialize the handle */
 void multipart_init(multipart_handle_t *handle, char *boundary)
 {
     handle->state = finding_data;
     handle->iterator = 0;
-    handle->matcher = 2;
+    handle->matcher = 0;
     handle->prev_matcher = 0;
     handle->boundary_length = 0;
     handle->boundary_init = "\r\n--";                                                  //the actual boundary is ("\r\n" + "--" + boundary)
@@ -68,45 +178,13 @@ int multipart_parse_data(multipart_handle_t *handle, multipart_callbacks_t *cbs,
     handle->current_data_size = 1;
 
     while (handle->iterator < buffer_size && handle->state != stream_over) {
-        switch (handle->state) {
-
-        case finding_data :
-            if (buffer[handle->iterator] == handle->boundary[handle->matcher]) {
-                handle->matcher++;
-                handle->state = finding_boundary;
-            }
-            if (handle->first_data) {
-                handle->current_data_start = (buffer + handle->iterator);
-                handle->current_data_size = 1;
-                handle->first_data = 0;
-            }
-            break;
+        if (handle->state == finding_data || handle->state == finding_boundary) {
+            multipart_parse_body(handle, cbs, buffer, buffer_size);
+            handle->current_data_size = 1;
+            continue;
+        }
 
-        case finding_boundary :
-            if (buffer[handle->iterator] == handle->boundary[handle->matcher]) {
-                handle->matcher++;
-                if (handle->matcher == handle->boundary_length) {
-                    if (!handle->first_buffer) {
-                        if (handle->current_data_size - (handle->matcher - handle->prev_matcher) > 0) {
-                            cbs->data_cb(handle, handle->current_data_start, handle->current_data_size - (handle->matcher - handle->prev_matcher));
-                        }
-                        cbs->data_cb(handle, NULL, 0);
-                        cbs->part_end_cb(handle);
-                    } else {
-                        handle->first_buffer = 0;
-                    }
-                    handle->state = finding_first_CR;
-                    handle->matcher = 0;
-                }
-            } else {
-                if (handle->prev_matcher > 0) {
-                    cbs->data_cb(handle, handle->boundary, handle->prev_matcher);
-                    handle->prev_matcher = 0;
-                }
-                handle->state = finding_data;
-                handle->matcher = 0;
-            }
-            break;
+        switch (handle->state) {
 
         case finding_header_name :
             if (buffer[handle->iterator] == ':') {
@@ -219,19 +297,6 @@ int multipart_parse_data(multipart_handle_t *handle, multipart_callbacks_t *cbs,
         handle->current_data_size--;
         switch (handle->state) {
 
-        case finding_data :
-            if (handle->current_data_size > 0 && handle->first_data == 0) {
-                cbs->data_cb(handle, handle->current_data_start, handle->current_data_size);
-            }
-            break;
-
-        case finding_boundary :
-            if (handle->current_data_size - (handle->matcher - handle->prev_matcher) > 0) {
-                cbs->data_cb(handle, handle->current_data_start, handle->current_data_size - (handle->matcher - handle->prev_matcher));
-            }
-            handle->prev_matcher = handle->matcher;
-            break;
-
         case finding_header_name :
             if (handle->current_data_size > 0) {
                 cbs->header_name_cb(handle, handle->current_data_start, handle->current_data_size);
@@ -0,0 +1,316 @@
+// Copyright 2018 Espressif Systems (Shanghai) PTE LTD
+// All rights reserved.
+
+/*
+ * The parser has to give the same parts, headers and bodies however the response is split into buffers.
+ * The responses have bodies with pieces of the boundary in them. The benchmark parses a multi-MB
+ * binary body, like an MP3 in a Speak directive, in buffers of a few sizes.
+ */
+
+#define _GNU_SOURCE
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <multipart.h>
+
+#define BOUNDARY "------abcdeABCDE12345"
+#define MAX_PARTS 8
+
+typedef struct {
+    char *buf;
+    int len;
+    int size;
+} text_t;
+
+/* What the callbacks were called with, with markers for the ends of names, values and bodies */
+typedef struct {
+    int parts;
+    int ends;
+    int data_cbs;
+    text_t headers[MAX_PARTS];
+    text_t bodies[MAX_PARTS];
+} events_t;
+
+static events_t *events;
+
+static void text_add(text_t *t, const char *data, size_t len)
+{
+    if (t->len + len + 1 > t->size) {
+        t->size = (t->len + len + 1) * 2;
+        t->buf = realloc(t->buf, t->size);
+    }
+    memcpy(t->buf + t->len, data, len);
+    t->len += len;
+}
+
+static text_t *part_text(text_t *texts)
+{
+    int part = events->parts ? events->parts - 1 : 0;
+    return &texts[part < MAX_PARTS ? part : MAX_PARTS - 1];
+}
+
+static void part_begin_cb(multipart_handle_t *handle)
+{
+    events->parts++;
+}
+
+static void part_end_cb(multipart_handle_t *handle)
+{
+    events->ends++;
+}
+
+static void header_name_cb(multipart_handle_t *handle, const char *data, size_t len)
+{
+    text_add(part_text(events->headers), data ? data : ":", data ? len : 1);
+}
+
+static void header_value_cb(multipart_handle_t *handle, const char *data, size_t len)
+{
+    text_add(part_text(events->headers), data ? data : "\n", data ? len : 1);
+}
+
+static void data_cb(multipart_handle_t *handle, const char *data, size_t len)
+{
+    if (data) {
+        events->data_cbs++;
+    }
+    text_add(part_text(events->bodies), data ? data : "|", data ? len : 1);
+}
+
+static multipart_callbacks_t cbs = {
+    .part_begin_cb = part_begin_cb,
+    .part_end_cb = part_end_cb,
+    .header_name_cb = header_name_cb,
+    .header_value_cb = header_value_cb,
+    .data_cb = data_cb,
+};
+
+static void events_free(events_t *e)
+{
+    for (int i = 0; i < MAX_PARTS; i++) {
+        free(e->headers[i].buf);
+        free(e->bodies[i].buf);
+    }
+    memset(e, 0, sizeof(*e));
+}
+
+/* Parse msg in buffers of sizes from `chunk()` */
+static void parse(events_t *e, const char *msg, int len, int (*chunk)(int))
+{
+    multipart_handle_t handle;
+    char *copy = malloc(len);
+    memcpy(copy, msg, len);
+    memset(e, 0, sizeof(*e));
+    events = e;
+    multipart_init(&handle, BOUNDARY);
+    for (int off = 0; off < len;) {
+        int n = chunk(len - off);
+        n = n < len - off ? n : len - off;
+        multipart_parse_data(&handle, &cbs, copy + off, n);
+        off += n;
+    }
+    free(copy);
+}
+
+static int whole(int left)
+{
+    return left;
+}
+
+static int one(int left)
+{
+    return 1;
+}
+
+static int small(int left)
+{
+    return 1 + rand() % 64;
+}
+
+static int large(int left)
+{
+    return 1 + rand() % 4096;
+}
+
+static bool events_equal(events_t *a, events_t *b)
+{
+    if (a->parts != b->parts || a->ends != b->ends) {
+        return false;
+    }
+    for (int i = 0; i < a->parts; i++) {
+        if (a->headers[i].len != b->headers[i].len || memcmp(a->headers[i].buf, b->headers[i].buf, a->headers[i].len) ||
+                a->bodies[i].len != b->bodies[i].len || memcmp(a->bodies[i].buf, b->bodies[i].buf, a->bodies[i].len)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Bodies with things that look like the start of the boundary */
+static const char *traps[] = {
+    "\r", "\r\n", "\r\n-", "\r\n--", "\r\r\n--", "\r\n---",
+    "\r\n--------abcdeABCDE1234", "\r\n\r\n--" "------abcde", "-" "------abcdeABCDE1234",
+};
+
+/* Random bytes with traps spliced in, never the delimiter itself */
+static int random_body(char *body)
+{
+    int len;
+    int traps_count = sizeof(traps) / sizeof(traps[0]);
+    do {
+        len = rand() % 400;
+        for (int j = 0; j < len; j++) {
+            body[j] = rand();
+        }
+        for (int t = rand() % 4; t > 0 && len > 40; t--) {
+            const char *trap = traps[rand() % traps_count];
+            memcpy(body + rand() % (len - 40), trap, strlen(trap));
+        }
+        if (rand() % 4 == 0 && len > 40) {
+            /* The body ends with a trap right before the boundary */
+            const char *trap = traps[rand() % traps_count];
+            memcpy(body + len - strlen(trap), trap, strlen(trap));
+        }
+    } while (memmem(body, len, "\r\n--" BOUNDARY, strlen("\r\n--" BOUNDARY)));
+    return len;
+}
+
+static int build_message(char *msg, const char *preamble, char bodies[][512], int *body_lens, int parts)
+{
+    int len = sprintf(msg, "%s--" BOUNDARY, preamble);
+    for (int i = 0; i < parts; i++) {
+        len += sprintf(msg + len, "\r\nContent-Type: application/octet-stream\r\nContent-ID: <part%d>\r\n\r\n", i);
+        memcpy(msg + len, bodies[i], body_lens[i]);
+        len += body_lens[i];
+        len += sprintf(msg + len, "\r\n--" BOUNDARY);
+    }
+    len += sprintf(msg + len, "--\r\n");
+    return len;
+}
+
+static int failed;
+
+static void check(bool ok, const char *what)
+{
+    printf("%-60s %s\n", what, ok ? "ok" : "FAILED");
+    failed += !ok;
+}
+
+static void check_chunkings(void)
+{
+    static char msg[8192];
+    char bodies[3][512];
+    int body_lens[3];
+    const char *preambles[] = { "", "\r\n", "preamble\r\n-" };
+    int iterations = 2000;
+    int mismatches = 0, wrong = 0;
+
+    for (int it = 0; it < iterations; it++) {
+        for (int i = 0; i < 3; i++) {
+            body_lens[i] = random_body(bodies[i]);
+        }
+        int len = build_message(msg, preambles[it % 3], bodies, body_lens, 3);
+
+        events_t ref, e;
+        parse(&ref, msg, len, whole);
+        /* The whole message in one buffer gives the parts that were put in */
+        bool ok = ref.parts == 3 && ref.ends == 3;
+        for (int i = 0; ok && i < 3; i++) {
+            ok = ref.bodies[i].len == body_lens[i] + 1 && !memcmp(ref.bodies[i].buf, bodies[i], body_lens[i]) &&
+                 ref.bodies[i].buf[body_lens[i]] == '|';
+        }
+        wrong += !ok;
+        int (*chunkers[])(int) = { one, small, large };
+        for (int c = 0; c < 3; c++) {
+            parse(&e, msg, len, chunkers[c]);
+            mismatches += !events_equal(&ref, &e);
+            events_free(&e);
+        }
+        events_free(&ref);
+    }
+    check(!wrong, "bodies with boundary look-alikes come out unchanged");
+    check(!mismatches, "same events for byte, small and large random chunks");
+}
+
+static void check_spans(void)
+{
+    /* A body without anything like the boundary comes in one callback per buffer */
+    static char msg[70000];
+    char bodies[1][512];
+    int body_lens[1] = { 0 };
+    int len = build_message(msg, "", bodies, body_lens, 1);
+    int head = len - strlen("\r\n--" BOUNDARY "--\r\n");
+    int body = 65536;
+    memmove(msg + head + body, msg + head, len - head);
+    memset(msg + head, 'a', body);
+    len += body;
+
+    events_t e;
+    parse(&e, msg, len, whole);
+    check(e.data_cbs == 1 && e.bodies[0].len == body + 1, "one data callback for a 64 KB body in one buffer");
+    events_free(&e);
+}
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void data_count_cb(multipart_handle_t *handle, const char *data, size_t len)
+{
+    events->data_cbs++;
+}
+
+static void benchmark(void)
+{
+    /* A JSON directive and a 4 MB MP3 */
+    int body = 4 * 1024 * 1024;
+    char *msg = malloc(body + 1024);
+    int len = sprintf(msg, "--" BOUNDARY "\r\nContent-Type: application/json; charset=UTF-8\r\n\r\n"
+                      "{\"directive\":{\"header\":{\"namespace\":\"SpeechSynthesizer\",\"name\":\"Speak\"}}}"
+                      "\r\n--" BOUNDARY "\r\nContent-Type: application/octet-stream\r\n"
+                      "Content-ID: <DeviceTTSRendererV4_4ad4ee2d-2bb5-4ffc-8ae2-9d3fb0c26bc7>\r\n\r\n");
+    for (int i = 0; i < body; i++) {
+        msg[len + i] = rand();
+    }
+    len += body;
+    len += sprintf(msg + len, "\r\n--" BOUNDARY "--\r\n");
+
+    multipart_callbacks_t count_cbs = cbs;
+    count_cbs.data_cb = data_count_cb;
+    int chunks[] = { 1024, 4096, 16384 };
+    printf("\n4 MB binary body\n%-8s %10s %12s\n", "buffer", "MB/s", "data cbs");
+    for (int c = 0; c < 3; c++) {
+        events_t e;
+        memset(&e, 0, sizeof(e));
+        events = &e;
+        int rounds = 10;
+        double start = now_sec();
+        for (int r = 0; r < rounds; r++) {
+            multipart_handle_t handle;
+            multipart_init(&handle, BOUNDARY);
+            for (int off = 0; off < len; off += chunks[c]) {
+                multipart_parse_data(&handle, &count_cbs, msg + off, len - off < chunks[c] ? len - off : chunks[c]);
+            }
+        }
+        double elapsed = now_sec() - start;
+        printf("%-8d %10.0f %12d\n", chunks[c], (double) len * rounds / elapsed / 1e6, e.data_cbs / rounds);
+        events_free(&e);
+    }
+    free(msg);
+}
+
+int main(int argc, char **argv)
+{
+    srand(1);
+    check_chunkings();
+    check_spans();
+    benchmark();
+    printf(failed ? "%d checks failed\n" : "All checks passed\n", failed);
+    return failed ? 1 : 0;
+}
@@ -5,22 +5,22 @@
 #include <esp_log.h>
 #include <basic_rb.h>
 #include <esp_err.h>
-#include <resampling.h>
 #include <audio_board.h>
 #include <hollow_stream.h>
 #include <va_dsp.h>
 #include "sys_playback.h"
 #include "media_hal_playback.h"
 #include <esp_audio_mem.h>
-#include <esp_downmix.h>
+#include "sys_playback_mixer.h"
 
 #define PB_DEFAULT_STACK_SIZE   (3 * 1024)
 #define PB_DOWNMIX_STACK_SIZE   (4 * 1024)
 #define PB_TASK_PRIORITY        5
 #define PB_DOWNMIX_PRIORITY     5
 #define PB_DEFAULT_BUF_SIZE     512
-#define PB_BUFFER_SIZE          (12 * 512) /* 12x can handle 8k/1 --> 48k/2 */
 #define OUT_SAMPLING_RATE       48000
+#define PB_DUCK_GAIN            3277 /* -20 dB in Q15 */
+#define PB_DOWNMIX_RB_FRAMES    2 /* Mixed frames the writer task can fall behind */
 
 static const char *TAG = "[sys_playback]";
 
@@ -32,9 +32,10 @@ static struct {
     /**
      * This is where we write downmixed data.
      * sys_playback_consume_buffer reads from this buffer and calls va_playback_data.
+     * Not used with CONFIG_SYS_PLAYBACK_DIRECT_OUTPUT.
      */
     rb_handle_t downmix_rb;
-    void *downmix_handle;
+    sys_playback_mixer_t mixer;
     /* If present, the tone gets priority */
     sys_playback_requester_t *tone;
     /* The currently playing playback requester */
@@ -77,34 +78,45 @@ int sys_playback_play_data(media_hal_audio_info_t *audio_info, void *buf, ssize_
    return sent_len;
 }
 
+static void sys_playback_log_load(sys_playback_mixer_t *m)
+{
+    if (m->mixed_frames) {
+        int64_t audio_us = m->mixed_frames * 1000000 / m->rate;
+        int permille = (int) (m->busy_us * 1000 / audio_us);
+        ESP_LOGI(TAG, "Mixed %d ms of audio, %d.%d%% CPU", (int) (audio_us / 1000), permille / 10, permille % 10);
+    }
+    m->busy_us = 0;
+    m->mixed_frames = 0;
+}
+
 /**
- * The function keeps reading data from main audio and ducked audio,
- * resamples+mixes it and writes to downmix_rb.
+ * The function keeps reading frames of main audio and ducked audio,
+ * resamples+mixes them in one pass and writes the mix to downmix_rb,
+ * or straight to media_hal with CONFIG_SYS_PLAYBACK_DIRECT_OUTPUT.
  */
 static void sys_playback_task()
 {
 #define DATA_BUF_SIZE   (512)
-    int prev_remain = 0;
-    char *data = (char *) esp_audio_mem_calloc(1, DATA_BUF_SIZE);
-    unsigned char *duck_buffer  = NULL;
-    unsigned char *conv_main_buf = NULL;
-    unsigned char *conv_duck_buf = NULL;
+    char *data = NULL;
+    sys_playback_mixer_t *m = &sp.mixer;
+    /* The ducked requester whose audio is in the duck source */
+    sys_playback_requester_t *duck = NULL;
     int wait = portMAX_DELAY;
+#ifdef CONFIG_SYS_PLAYBACK_DIRECT_OUTPUT
+    media_hal_audio_info_t out_info = {
+        .sample_rate = OUT_SAMPLING_RATE,
+        .channels = 2,
+        .bits_per_sample = 16,
+    };
+#endif
 
-    if (sp.downmix_support) {
-        duck_buffer  = (unsigned char *) esp_audio_mem_calloc(1, PB_BUFFER_SIZE);
-        conv_main_buf = (unsigned char *) esp_audio_mem_calloc(1, PB_BUFFER_SIZE);
-        conv_duck_buf = (unsigned char *) esp_audio_mem_calloc(1, PB_BUFFER_SIZE);
+    if (!sp.downmix_support) {
+        data = (char *) esp_audio_mem_calloc(1, DATA_BUF_SIZE);
     }
 
-    audio_resample_config_t resample_main = {0};
-    audio_resample_config_t resample_duck = {0};
-    downmix_status_t downmix_status = DOWNMIX_SWITCH_ON;
-
     while (1) {
-        int conv_main_len = 0, conv_duck_len = 0;
         sys_playback_requester_t *active = sp.current;
-        int data_read = 0, duck_read = 0;
+        int data_read = 0;
         unsigned int wait_main = wait, wait_duck = 2;
 
         if (sp.tone) {
@@ -116,118 +128,79 @@ static void sys_playback_task()
             wait_main = 0;
         }
 
-        /**** Read and Process Main Data ****/
-        data_read = active->read_cb(active->cb_data, data, DATA_BUF_SIZE, wait_main);
-
-        if (data_read == RB_READER_UNBLOCK) {
-            /* Just a wakeup, do nothing and go for duck audio. */
-        } else if (data_read > 0) {
-            active->samples_cnt += data_read;
-            if (sp.downmix_support) {
-                /* Resample to OUT_SAMPLING_RATE */
-                conv_main_len = audio_resample((short *) data, (short *) conv_main_buf, active->audio_info.sample_rate, OUT_SAMPLING_RATE,
-                                               data_read / 2, PB_BUFFER_SIZE, active->audio_info.channels, &resample_main);
-
-                if (active->audio_info.channels == 1) {
-                    conv_main_len = audio_resample_up_channel((short *) conv_main_buf, (short *) conv_main_buf, OUT_SAMPLING_RATE, OUT_SAMPLING_RATE,
-                                                              conv_main_len, PB_BUFFER_SIZE, &resample_main);
-                }
+        if (!sp.downmix_support) {
+            /* No mixing, media_hal converts the audio */
+            void *main_data = data;
+            bool in_place = active->acquire_read_cb && active->release_read_cb;
+            if (in_place) {
+                data_read = active->acquire_read_cb(active->cb_data, &main_data, DATA_BUF_SIZE, wait_main);
             } else {
-                sys_playback_play_data(&active->audio_info, data, data_read);
+                data_read = active->read_cb(active->cb_data, data, DATA_BUF_SIZE, wait_main);
             }
-        } else if (data_read < 0) {
-            /* If this was a tone, it has been completely played out, reset the pointer now */
-            if (active == sp.tone) {
+            if (data_read > 0) {
+                active->samples_cnt += data_read;
+                sys_playback_play_data(&active->audio_info, main_data, data_read);
+                if (in_place) {
+                    active->release_read_cb(active->cb_data, data_read);
+                }
+            } else if (data_read < 0 && data_read != RB_READER_UNBLOCK && active == sp.tone) {
+                /* The tone has been completely played out, reset the pointer now */
                 sp.tone = NULL;
             }
-            prev_remain = 0;
+            continue;
         }
-        /**** Main Data Done ****/
-
-        if (sp.downmix_support) {
-            /**** Read and Process Ducked Data ****/
-            xSemaphoreTake(sp.duck_lock, portMAX_DELAY);
-            if (sp.duck) {
-                int duck_to_read = DATA_BUF_SIZE;
-                if (conv_main_len && conv_main_len < prev_remain) {
-                    duck_to_read = 0;
-                    conv_duck_len = prev_remain;
-                } else if (conv_main_len) {
-                    /* How many bytes to read to get out bytes = conv_main_len * 2? */
-                    duck_to_read = ((conv_main_len - prev_remain) * sp.duck->audio_info.sample_rate) / OUT_SAMPLING_RATE;
-                    duck_to_read = (duck_to_read + 3) & ~(int) 0x01; /* Read few extra and make it multiple of 2 */
-                    duck_to_read *= sp.duck->audio_info.channels;
-                }
 
-                duck_read = sp.duck->read_cb(sp.duck->cb_data, duck_buffer, duck_to_read, wait_duck);
-
-                if (duck_read == RB_READER_UNBLOCK && data_read <= 0) {
-                    /* Just a wakeup, simply return */
-                    xSemaphoreGive(sp.duck_lock);
-                    continue;
-                } else if (duck_read < 0) {
-                    conv_duck_len = 0;
-                } else if (duck_read > 0) {
-                    sp.duck->samples_cnt += duck_read;
-                    /* Resample to OUT_SAMPLING_RATE. */
-                    conv_duck_len = audio_resample((short *) duck_buffer, (short *) conv_duck_buf + prev_remain, sp.duck->audio_info.sample_rate, OUT_SAMPLING_RATE,
-                                               duck_read / 2, PB_BUFFER_SIZE - 2 * prev_remain, sp.duck->audio_info.channels, &resample_duck);
-
-                    if (sp.duck->audio_info.channels == 1) {
-                        conv_duck_len = audio_resample_up_channel((short *) conv_duck_buf + prev_remain, (short *) conv_duck_buf + prev_remain, OUT_SAMPLING_RATE, OUT_SAMPLING_RATE,
-                                                              conv_duck_len, PB_BUFFER_SIZE - 2 * prev_remain, &resample_duck);
-                    }
-                }
-                conv_duck_len += prev_remain;
-                prev_remain = 0;
-            }
-            /**** Duck Data Done ****/
-
-            xSemaphoreGive(sp.duck_lock);
-
-            /**** Downmix and write data to downmix_rb ****/
-            if (conv_main_len && conv_duck_len) { /* Mix main and ducked audio */
-                prev_remain = 0;
-                if (conv_main_len > conv_duck_len) {
-                    /**
-                     * Happens only when we are not able to read enough duck audio.
-                     * This should be seldom thing.
-                     */
-                    bzero(conv_duck_buf + 2 * conv_duck_len, 2 * (conv_main_len - conv_duck_len));
-                }
-                /* Otherwise we are anyway handling this properly.! */
-                esp_downmix_process(sp.downmix_handle, conv_main_buf, conv_main_len * 2, conv_duck_buf, conv_main_len * 2, duck_buffer, downmix_status);
-                rb_write(sp.downmix_rb, duck_buffer, conv_main_len * 2, wait);
-                if (conv_duck_len > conv_main_len) {
-                    prev_remain = conv_duck_len - conv_main_len;
-                    memmove(conv_duck_buf, conv_duck_buf + conv_main_len * 2, prev_remain * 2);
-                }
-            } else if (conv_main_len) { /* Just main audio */
-                rb_write(sp.downmix_rb, conv_main_buf, conv_main_len * 2, wait);
-            } else if (conv_duck_len) { /* Only ducked audio! Downmix this with silence. */
-                bzero(conv_main_buf, conv_duck_len * 2); /* Silence. */
-                esp_downmix_process(sp.downmix_handle, conv_main_buf, conv_duck_len * 2, conv_duck_buf, conv_duck_len * 2, duck_buffer, downmix_status);
-                rb_write(sp.downmix_rb, duck_buffer, conv_duck_len * 2, wait);
+        /**** Read a frame of main audio ****/
+        data_read = sys_playback_mixer_pull(m, &m->main, active, m->frame_len, wait_main);
+        bool main_ended = data_read < 0 && data_read != RB_READER_UNBLOCK;
+        if (main_ended && active == sp.tone) {
+            /* The tone has been completely played out, reset the pointer now */
+            sp.tone = NULL;
+        }
+
+        /**** Read as much ducked audio ****/
+        xSemaphoreTake(sp.duck_lock, portMAX_DELAY);
+        if (sp.duck != duck) {
+            /* Replaced or removed, the next one fades in from silence */
+            sys_playback_mixer_drop(&m->duck);
+            duck = sp.duck;
+        }
+        if (duck) {
+            int duck_frames = m->main.frames ? m->main.frames : m->frame_len;
+            if (duck_frames > m->frame_len) {
+                duck_frames = m->frame_len;
             }
+            sys_playback_mixer_pull(m, &m->duck, duck, duck_frames, wait_duck);
+        }
+        xSemaphoreGive(sp.duck_lock);
+
+        /**** Mix and write ****/
+        int frames;
+        int16_t *out = sys_playback_mixer_mix(m, SYS_PLAYBACK_GAIN_UNITY, PB_DUCK_GAIN, &frames);
+        if (out) {
+#ifdef CONFIG_SYS_PLAYBACK_DIRECT_OUTPUT
+            sys_playback_play_data(&out_info, out, frames * 4);
+#else
+            rb_write(sp.downmix_rb, (uint8_t *) out, frames * 4, wait);
+#endif
+        }
+        if (main_ended && m->mixed_frames) {
+            sys_playback_log_load(m);
+            sys_playback_mixer_drop(&m->main);
         }
     }
 
     /**
      * We never exit the while loop and the task, but let's keep it clean.
      */
-    if (duck_buffer) {
-        esp_audio_mem_free(duck_buffer);
-    }
-    if (conv_main_buf) {
-        esp_audio_mem_free(conv_main_buf);
-    }
-    if (conv_duck_buf) {
-        esp_audio_mem_free(conv_duck_buf);
+    if (data) {
+        esp_audio_mem_free(data);
     }
     vTaskDelete(NULL);
 #undef DATA_BUF_SIZE
 }
 
+#ifndef CONFIG_SYS_PLAYBACK_DIRECT_OUTPUT
 /**
  * This function reads data from downmix_rb,
  * and calls va_app_playback_data to write it to i2s.
@@ -235,10 +208,10 @@ static void sys_playback_task()
  */
 static void sys_playback_downmix_consumer_task(void *arg)
 {
-    int read_size = 512;
-    char data[read_size];
+    int read_size = sp.mixer.frame_len * 4;
+    rb_region_t region;
     /**
-     * Read data from downmixed buffer and call va_app_playback_data
+     * Play data straight out of downmixed buffer and call va_app_playback_data
      */
     media_hal_audio_info_t audio_info = {
         .sample_rate = OUT_SAMPLING_RATE,
@@ -247,12 +220,17 @@ static void sys_playback_downmix_consumer_task(void *arg)
     };
 
     while (1) {
-        int bytes_read = rb_read(sp.downmix_rb, (void *) data, read_size, portMAX_DELAY);
+        int bytes_read = rb_acquire_read(sp.downmix_rb, &region, read_size, portMAX_DELAY);
         if (bytes_read > 0) {
-            sys_playback_play_data(&audio_info, data, bytes_read);
+            sys_playback_play_data(&audio_info, region.ptr, region.len);
+            if (region.wrap_len) {
+                sys_playback_play_data(&audio_info, region.wrap_ptr, region.wrap_len);
+            }
+            rb_release_read(sp.downmix_rb, bytes_read);
         }
     }
 }
+#endif
 
 /* This is fairly similar to acquire */
 int sys_playback_play_tone(sys_playback_requester_t *tone)
@@ -352,37 +330,26 @@ static void sys_playback_downmix_deinit() {
         rb_cleanup(sp.downmix_rb);
         sp.downmix_rb = NULL;
     }
-    if (sp.downmix_handle) {
-        esp_downmix_close(sp.downmix_handle);
-        sp.downmix_handle = NULL;
-    }
+    sys_playback_mixer_deinit(&sp.mixer);
 }
 
 static esp_err_t sys_playback_downmix_init(sys_playback_config_t *sys_playback_cfg)
 {
     (void) sys_playback_cfg; /* Unused */
 
-    //init downmix_info structure.
-    esp_downmix_info_t downmix_info;
-    bzero(&downmix_info, sizeof (esp_downmix_info_t));
-    downmix_info.sample_rate = OUT_SAMPLING_RATE;
-    downmix_info.bits_num = 16;
-    downmix_info.dual_2_mono_select_ch = 2;
-    downmix_info.downmix_gain[0].set_dbgain[1] = 0;
-    downmix_info.downmix_gain[1].set_dbgain[1] = -20;
-    downmix_info.channels[0] = 2;
-    downmix_info.channels[1] = 2;
-    sp.downmix_handle = esp_downmix_open(&downmix_info);
-    if (!sp.downmix_handle) {
-        ESP_LOGE(TAG, "Could not open downmix!");
+    if (sys_playback_mixer_init(&sp.mixer, OUT_SAMPLING_RATE, CONFIG_SYS_PLAYBACK_FRAME_MS,
+                                CONFIG_SYS_PLAYBACK_DUCK_RAMP_MS) != ESP_OK) {
+        ESP_LOGE(TAG, "Could not create mixer!");
         return ESP_FAIL;
     }
-    sp.downmix_rb = rb_init("downmix_rb", PB_BUFFER_SIZE);
+#ifndef CONFIG_SYS_PLAYBACK_DIRECT_OUTPUT
+    sp.downmix_rb = rb_init("downmix_rb", PB_DOWNMIX_RB_FRAMES * sp.mixer.frame_len * 4);
     if (sp.downmix_rb == NULL) {
         ESP_LOGE(TAG, "failed to create downmix_rb");
         sys_playback_downmix_deinit();
         return ESP_FAIL;
     }
+#endif
 #if 0
     /* Assign default params */
     hollow_stream_cfg.hollow_stream_stack_sz = PB_DEFAULT_STACK_SIZE;
@@ -440,6 +407,7 @@ int sys_playback_init(sys_playback_config_t *sys_playback_cfg)
         }
     }
 
+#ifndef CONFIG_SYS_PLAYBACK_DIRECT_OUTPUT
     if (sp.downmix_support) {
         if (xTaskCreate(sys_playback_downmix_consumer_task, "sys_pb_downmix_writer", PB_DEFAULT_STACK_SIZE, NULL, PB_TASK_PRIORITY, NULL) != pdPASS) {
             ESP_LOGE(TAG, "Error creating sys_playback_downmix_consumer_task task! Downmixing will be disabled...");
@@ -448,6 +416,7 @@ int sys_playback_init(sys_playback_config_t *sys_playback_cfg)
             sp.downmix_support = false;
         }
     }
+#endif
 
     if (xTaskCreate(sys_playback_task, "sys_pb_task", PB_DOWNMIX_STACK_SIZE, NULL, PB_DOWNMIX_PRIORITY, NULL) != pdPASS) {
         ESP_LOGE(TAG, "Error creating sys_playback_task");
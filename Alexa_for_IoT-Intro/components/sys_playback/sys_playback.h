@@ -7,11 +7,21 @@
 
 typedef int (*read_cb_t)(void *cb_data, void *data, int len, unsigned int wait);
 typedef void (*wakeup_reader_cb_t)(void *cb_data);
+/* Hand out up to `len` bytes in place at `*data`. Returns the same values as `read_cb_t`. */
+typedef int (*acquire_read_cb_t)(void *cb_data, void **data, int len, unsigned int wait);
+/* Give back `len` bytes handed out by the last successful `acquire_read_cb_t` */
+typedef void (*release_read_cb_t)(void *cb_data, int len);
 
 typedef struct {
     uint32_t samples_cnt;
     read_cb_t read_cb;
     wakeup_reader_cb_t wakeup_reader_cb;
+    /**
+     * Optional. If both are set, they are used instead of `read_cb` and the data
+     * is played straight out of the requester's buffer without a copy.
+     */
+    acquire_read_cb_t acquire_read_cb;
+    release_read_cb_t release_read_cb;
     void *cb_data;
     media_hal_audio_info_t audio_info;
 } sys_playback_requester_t;
@@ -0,0 +1,239 @@
+// Copyright 2018 Espressif Systems (Shanghai) PTE LTD
+// All rights reserved.
+
+#include <string.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <common_rb.h>
+#include <esp_audio_mem.h>
+#include "sys_playback_mixer.h"
+
+static const char *TAG = "[sys_playback_mixer]";
+
+#define FRAME_BYTES (2 * sizeof(int16_t)) /* Output is always stereo */
+
+static esp_err_t sys_playback_source_init(sys_playback_source_t *src, int room)
+{
+    memset(src, 0, sizeof(*src));
+    src->pcm = esp_audio_mem_calloc(room, FRAME_BYTES);
+    src->room = room;
+    src->gain = src->target = SYS_PLAYBACK_GAIN_UNITY;
+    return src->pcm ? ESP_OK : ESP_FAIL;
+}
+
+static void sys_playback_source_deinit(sys_playback_source_t *src)
+{
+    audio_resampler_destroy(src->resampler);
+    esp_audio_mem_free(src->pcm);
+    memset(src, 0, sizeof(*src));
+}
+
+esp_err_t sys_playback_mixer_init(sys_playback_mixer_t *m, int rate, int frame_ms, int ramp_ms)
+{
+    memset(m, 0, sizeof(*m));
+    m->rate = rate;
+    m->frame_len = rate * frame_ms / 1000;
+    m->ramp_len = rate * ramp_ms / 1000;
+    /* A frame of input at up to the output rate. Faster input is read in more than one go. */
+    m->in_size = m->frame_len * FRAME_BYTES;
+    m->in = esp_audio_mem_calloc(1, m->in_size);
+    m->out = esp_audio_mem_calloc(m->frame_len, FRAME_BYTES);
+    /* Room for a frame and what the resampler gives on top when a read doesn't end on a frame */
+    if (!m->in || !m->out || sys_playback_source_init(&m->main, 2 * m->frame_len) != ESP_OK ||
+            sys_playback_source_init(&m->duck, 2 * m->frame_len) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to allocate mixer for %d ms frames", frame_ms);
+        sys_playback_mixer_deinit(m);
+        return ESP_FAIL;
+    }
+    /* Ducked audio fades in */
+    m->duck.gain = m->duck.target = 0;
+    return ESP_OK;
+}
+
+void sys_playback_mixer_deinit(sys_playback_mixer_t *m)
+{
+    sys_playback_source_deinit(&m->main);
+    sys_playback_source_deinit(&m->duck);
+    esp_audio_mem_free(m->in);
+    esp_audio_mem_free(m->out);
+    m->in = NULL;
+    m->out = NULL;
+}
+
+int sys_playback_mixer_pull(sys_playback_mixer_t *m, sys_playback_source_t *src,
+                            sys_playback_requester_t *requester, int frames, unsigned int wait)
+{
+    media_hal_audio_info_t *info = &requester->audio_info;
+    int frame_bytes = 2 * info->channels;
+    bool in_place = requester->acquire_read_cb && requester->release_read_cb;
+    int total = 0;
+
+    if (src->start) {
+        memmove(src->pcm, src->pcm + 2 * src->start, src->frames * FRAME_BYTES);
+        src->start = 0;
+    }
+    if (frames > src->room) {
+        frames = src->room;
+    }
+    src->resampler = audio_resampler_update(src->resampler, info->sample_rate, m->rate, info->channels, 2,
+                                            AUDIO_RESAMPLER_QUALITY_DEFAULT);
+    if (!src->resampler) {
+        return RB_FAIL;
+    }
+
+    while (src->frames < frames) {
+        /* Input that gives the missing output */
+        int missing = frames - src->frames;
+        int in_frames = ((int64_t) missing * info->sample_rate + m->rate - 1) / m->rate;
+        if (in_frames > m->in_size / frame_bytes) {
+            in_frames = m->in_size / frame_bytes;
+        }
+        while (in_frames > 1 && audio_resampler_get_max_output(src->resampler, in_frames) > src->room - src->frames) {
+            in_frames--;
+        }
+        int len = in_frames * frame_bytes;
+
+        void *data = m->in;
+        bool acquired = false;
+        int ret;
+        if (in_place) {
+            ret = requester->acquire_read_cb(requester->cb_data, &data, len, wait);
+            acquired = ret > 0;
+            if (acquired && ret < frame_bytes) {
+                /* Only a piece of a frame before the buffer wraps around, copy it out together with the rest */
+                requester->release_read_cb(requester->cb_data, 0);
+                acquired = false;
+                data = m->in;
+                ret = requester->read_cb(requester->cb_data, m->in, frame_bytes, wait);
+            }
+        } else {
+            ret = requester->read_cb(requester->cb_data, m->in, len, wait);
+        }
+        if (ret <= 0) {
+            if (!total) {
+                total = ret;
+            }
+            break;
+        }
+
+        int n = ret / frame_bytes;
+        int64_t start_us = esp_timer_get_time();
+        int out = audio_resampler_process(src->resampler, (const int16_t *) data, n,
+                                          src->pcm + 2 * (src->start + src->frames), src->room - src->frames);
+        m->busy_us += esp_timer_get_time() - start_us;
+        if (acquired) {
+            /* A piece of a frame at the end stays for the next read */
+            ret = n * frame_bytes;
+            requester->release_read_cb(requester->cb_data, ret);
+        }
+        requester->samples_cnt += ret;
+        total += ret;
+        if (out > 0) {
+            src->frames += out;
+        }
+        if (!acquired && ret < len) {
+            /* Timed out or the stream ended */
+            break;
+        }
+    }
+    return total;
+}
+
+void sys_playback_mixer_drop(sys_playback_source_t *src)
+{
+    src->start = 0;
+    src->frames = 0;
+    src->gain = src->target = 0;
+    if (src->resampler) {
+        /* Don't let the end of this stream leak into the next one */
+        audio_resampler_reset(src->resampler);
+    }
+}
+
+static void sys_playback_set_target(sys_playback_mixer_t *m, sys_playback_source_t *src, int32_t target)
+{
+    if (src->target != target) {
+        int32_t change = target > src->gain ? target - src->gain : src->gain - target;
+        src->target = target;
+        src->step = m->ramp_len ? change / m->ramp_len : change;
+        if (src->step < 1) {
+            src->step = 1;
+        }
+    }
+}
+
+static inline int32_t sys_playback_ramp(int32_t gain, int32_t target, int32_t step)
+{
+    if (gain < target) {
+        return (target - gain > step) ? gain + step : target;
+    }
+    if (gain > target) {
+        return (gain - target > step) ? gain - step : target;
+    }
+    return gain;
+}
+
+static inline int16_t sys_playback_saturate(int32_t acc)
+{
+    acc = (acc + (1 << 14)) >> 15;
+    return acc > INT16_MAX ? INT16_MAX : (acc < INT16_MIN ? INT16_MIN : acc);
+}
+
+int16_t *sys_playback_mixer_mix(sys_playback_mixer_t *m, int32_t main_gain, int32_t duck_gain, int *frames)
+{
+    sys_playback_source_t *a = &m->main;
+    sys_playback_source_t *b = &m->duck;
+    int32_t target_a = main_gain;
+    int32_t target_b = duck_gain;
+    if (!a->frames) {
+        /* Only ducked audio, mixed with silence */
+        a = &m->duck;
+        b = &m->main;
+        target_a = duck_gain;
+        target_b = main_gain;
+    }
+
+    sys_playback_set_target(m, a, target_a);
+    sys_playback_set_target(m, b, target_b);
+    int n = a->frames < m->frame_len ? a->frames : m->frame_len;
+    int nb = b->frames < n ? b->frames : n;
+    *frames = n;
+    if (!n) {
+        return NULL;
+    }
+
+    int64_t start_us = esp_timer_get_time();
+    const int16_t *pa = a->pcm + 2 * a->start;
+    const int16_t *pb = b->pcm + 2 * b->start;
+    int16_t *out;
+    if (!nb && a->gain == target_a && target_a == SYS_PLAYBACK_GAIN_UNITY) {
+        /* Nothing to mix, play straight out of the source */
+        out = (int16_t *) pa;
+    } else {
+        int32_t ga = a->gain;
+        int32_t gb = b->gain;
+        out = m->out;
+        for (int i = 0; i < n; i++) {
+            ga = sys_playback_ramp(ga, target_a, a->step);
+            int32_t l = pa[2 * i] * ga;
+            int32_t r = pa[2 * i + 1] * ga;
+            if (i < nb) {
+                gb = sys_playback_ramp(gb, target_b, b->step);
+                l += pb[2 * i] * gb;
+                r += pb[2 * i + 1] * gb;
+            }
+            out[2 * i] = sys_playback_saturate(l);
+            out[2 * i + 1] = sys_playback_saturate(r);
+        }
+        a->gain = ga;
+        b->gain = gb;
+    }
+    m->busy_us += esp_timer_get_time() - start_us;
+    m->mixed_frames += n;
+
+    a->start += n;
+    a->frames -= n;
+    b->start += nb;
+    b->frames -= nb;
+    return out;
+}
@@ -0,0 +1,76 @@
+// Copyright 2018 Espressif Systems (Shanghai) PTE LTD
+// All rights reserved.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <esp_err.h>
+#include <audio_resampler.h>
+#include "sys_playback.h"
+
+#define SYS_PLAYBACK_GAIN_UNITY 32768   /* Gains are Q15 */
+
+/**
+ * One input of the mix: audio of a requester, already converted to the output rate and stereo.
+ */
+typedef struct {
+    audio_resampler_t *resampler;
+    int16_t *pcm;           /* Stereo frames at the output rate */
+    int start;              /* First frame in pcm not mixed yet */
+    int frames;             /* Frames in pcm from start */
+    int room;               /* Size of pcm in frames */
+    int32_t gain;           /* Gain applied last, Q15. Ramps to the gain asked for in sys_playback_mixer_mix */
+    int32_t target;         /* Gain the ramp goes to */
+    int32_t step;           /* Gain change per frame of the ramp */
+} sys_playback_source_t;
+
+/**
+ * Pulls fixed size frames from the main and the ducked requester and mixes them in one pass.
+ */
+typedef struct {
+    int rate;               /* Output rate, the output is always stereo */
+    int frame_len;          /* Frames in an output frame */
+    int ramp_len;           /* Frames a gain change takes */
+    uint8_t *in;            /* Input of requesters that can't hand out their data in place */
+    int in_size;
+    int16_t *out;           /* Mixed frame */
+    sys_playback_source_t main;
+    sys_playback_source_t duck;
+    int64_t busy_us;        /* Time spent converting and mixing */
+    int64_t mixed_frames;   /* Frames output */
+} sys_playback_mixer_t;
+
+/**
+ * Allocate the buffers of the mixer.
+ *
+ * `frame_ms` is the size of the output frames and of the reads from the requesters.
+ * Gain changes, like a source fading in from silence, take `ramp_ms`.
+ */
+esp_err_t sys_playback_mixer_init(sys_playback_mixer_t *m, int rate, int frame_ms, int ramp_ms);
+
+void sys_playback_mixer_deinit(sys_playback_mixer_t *m);
+
+/**
+ * Read from `requester` until `src` has `frames` frames, a read comes back short or fails.
+ *
+ * Returns the bytes read, or the result of the first read if it didn't return data
+ * (0 on timeout, `RB_READER_UNBLOCK` or a negative value at the end of the stream).
+ */
+int sys_playback_mixer_pull(sys_playback_mixer_t *m, sys_playback_source_t *src,
+                            sys_playback_requester_t *requester, int frames, unsigned int wait);
+
+/**
+ * Forget the audio of `src` that wasn't mixed yet, e.g. at the end of a stream.
+ * The next audio of the source ramps up from silence.
+ */
+void sys_playback_mixer_drop(sys_playback_source_t *src);
+
+/**
+ * Mix up to one frame of the main and the ducked source with the given gains.
+ *
+ * The frame is as long as the main audio, or as the ducked audio if there is no main audio.
+ * Missing ducked audio is silence. Returns the frame and sets `*frames`, or NULL if there is nothing to mix.
+ * The frame is valid until the next call to sys_playback_mixer_pull.
+ */
+int16_t *sys_playback_mixer_mix(sys_playback_mixer_t *m, int32_t main_gain, int32_t duck_gain, int *frames);
@@ -0,0 +1,255 @@
+// Copyright 2018 Espressif Systems (Shanghai) PTE LTD
+// All rights reserved.
+
+/*
+ * CPU load and latency of the sys_playback mixing stage with TTS and a ducked tone playing together,
+ * for a few frame sizes. The requesters are served from memory, the loop is the one of sys_playback_task.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <common_rb.h>
+#include <esp_timer.h>
+#include "sys_playback_mixer.h"
+
+#define OUT_RATE        48000
+#define DUCK_GAIN       3277    /* -20 dB, as in sys_playback.c */
+#define RAMP_MS         5
+#define RB_FRAMES       2       /* PB_DOWNMIX_RB_FRAMES */
+#define BENCH_SECONDS   60
+
+/* A requester reading from memory. In place reads stop at multiples of `wrap` bytes like a ring buffer would. */
+typedef struct {
+    sys_playback_requester_t requester;
+    int16_t *pcm;
+    int bytes;
+    int pos;
+    int wrap;
+} stream_t;
+
+static int stream_read_cb(void *cb_data, void *data, int len, unsigned int wait)
+{
+    stream_t *s = cb_data;
+    int n = s->bytes - s->pos;
+    if (n <= 0) {
+        return RB_WRITER_FINISHED;
+    }
+    n = n < len ? n : len;
+    memcpy(data, (uint8_t *) s->pcm + s->pos, n);
+    s->pos += n;
+    return n;
+}
+
+static int stream_acquire_read_cb(void *cb_data, void **data, int len, unsigned int wait)
+{
+    stream_t *s = cb_data;
+    int n = s->bytes - s->pos;
+    if (n <= 0) {
+        return RB_WRITER_FINISHED;
+    }
+    int to_wrap = s->wrap - s->pos % s->wrap;
+    n = n < len ? n : len;
+    n = n < to_wrap ? n : to_wrap;
+    *data = (uint8_t *) s->pcm + s->pos;
+    return n;
+}
+
+static void stream_release_read_cb(void *cb_data, int len)
+{
+    stream_t *s = cb_data;
+    s->pos += len;
+}
+
+static void stream_init(stream_t *s, int rate, int channels, int frames, bool in_place)
+{
+    memset(s, 0, sizeof(*s));
+    s->pcm = calloc(frames * channels, sizeof(int16_t));
+    s->bytes = frames * channels * sizeof(int16_t);
+    s->wrap = 1001;
+    s->requester.read_cb = stream_read_cb;
+    if (in_place) {
+        s->requester.acquire_read_cb = stream_acquire_read_cb;
+        s->requester.release_read_cb = stream_release_read_cb;
+    }
+    s->requester.cb_data = s;
+    s->requester.audio_info.sample_rate = rate;
+    s->requester.audio_info.channels = channels;
+    s->requester.audio_info.bits_per_sample = 16;
+}
+
+/* Speech-like: a few harmonics with a syllable envelope and some noise */
+static void fill_tts(stream_t *s)
+{
+    int rate = s->requester.audio_info.sample_rate;
+    for (int i = 0; i < s->bytes / 2; i++) {
+        double t = (double) i / rate;
+        double env = 0.5 + 0.5 * sin(2 * M_PI * 4 * t);
+        double v = sin(2 * M_PI * 180 * t) + 0.5 * sin(2 * M_PI * 360 * t) + 0.25 * sin(2 * M_PI * 1100 * t);
+        s->pcm[i] = lrint(8000 * env * v + (rand() % 512 - 256));
+    }
+}
+
+static void fill_tone(stream_t *s, double hz, int amplitude)
+{
+    int rate = s->requester.audio_info.sample_rate;
+    int channels = s->requester.audio_info.channels;
+    for (int i = 0; i < s->bytes / 2 / channels; i++) {
+        for (int ch = 0; ch < channels; ch++) {
+            s->pcm[i * channels + ch] = lrint(amplitude * sin(2 * M_PI * hz * i / rate));
+        }
+    }
+}
+
+/* The downmix loop of sys_playback_task, with the mixed frames written to `sink` */
+static int run_mix(sys_playback_mixer_t *m, stream_t *main_s, stream_t *duck_s, int16_t *sink, int sink_frames)
+{
+    bool main_done = !main_s;
+    bool duck_done = !duck_s;
+    int written = 0;
+    while (1) {
+        if (!main_done && sys_playback_mixer_pull(m, &m->main, &main_s->requester, m->frame_len, 0) < 0) {
+            main_done = true;
+        }
+        if (!duck_done) {
+            int duck_frames = m->main.frames ? m->main.frames : m->frame_len;
+            duck_frames = duck_frames < m->frame_len ? duck_frames : m->frame_len;
+            if (sys_playback_mixer_pull(m, &m->duck, &duck_s->requester, duck_frames, 0) < 0) {
+                duck_done = true;
+            }
+        }
+        int frames;
+        int16_t *out = sys_playback_mixer_mix(m, SYS_PLAYBACK_GAIN_UNITY, DUCK_GAIN, &frames);
+        if (!out) {
+            if (main_done && duck_done) {
+                break;
+            }
+            continue;
+        }
+        if (written + frames <= sink_frames) {
+            memcpy(sink + 2 * written, out, frames * 4);
+        }
+        written += frames;
+    }
+    return written;
+}
+
+static double rms(const int16_t *pcm, int from, int to)
+{
+    double sum = 0;
+    for (int i = from; i < to; i++) {
+        sum += (double) pcm[2 * i] * pcm[2 * i];
+    }
+    return sqrt(sum / (to - from));
+}
+
+static int failed;
+
+static void check(bool ok, const char *what)
+{
+    printf("%-60s %s\n", what, ok ? "ok" : "FAILED");
+    failed += !ok;
+}
+
+static void check_mixing(void)
+{
+    sys_playback_mixer_t m;
+    int sink_frames = OUT_RATE * 2;
+    int16_t *sink = malloc(sink_frames * 4);
+    int16_t *ref = malloc(sink_frames * 4);
+    stream_t tts, tone;
+
+    /* Main audio alone is the resampler's output, wherever the reads break */
+    stream_init(&tts, 24000, 1, 24000, false);
+    fill_tts(&tts);
+    sys_playback_mixer_init(&m, OUT_RATE, 10, RAMP_MS);
+    int len = run_mix(&m, &tts, NULL, sink, sink_frames);
+    sys_playback_mixer_deinit(&m);
+    audio_resampler_t *rs = audio_resampler_create(24000, OUT_RATE, 1, 2, AUDIO_RESAMPLER_QUALITY_DEFAULT);
+    int ref_len = audio_resampler_process(rs, tts.pcm, 24000, ref, sink_frames);
+    audio_resampler_destroy(rs);
+    check(len == ref_len && !memcmp(sink, ref, len * 4), "main audio alone is passed through");
+
+    tts.pos = 0;
+    tts.requester.acquire_read_cb = stream_acquire_read_cb;
+    tts.requester.release_read_cb = stream_release_read_cb;
+    sys_playback_mixer_init(&m, OUT_RATE, 10, RAMP_MS);
+    len = run_mix(&m, &tts, NULL, sink, sink_frames);
+    sys_playback_mixer_deinit(&m);
+    check(len == ref_len && !memcmp(sink, ref, len * 4), "in place reads across odd ring buffer wraps");
+    free(tts.pcm);
+
+    /* Ducked audio alone is at DUCK_GAIN once it faded in */
+    stream_init(&tone, 44100, 2, 44100, true);
+    fill_tone(&tone, 1000, 20000);
+    sys_playback_mixer_init(&m, OUT_RATE, 10, RAMP_MS);
+    len = run_mix(&m, NULL, &tone, sink, sink_frames);
+    sys_playback_mixer_deinit(&m);
+    double level = rms(sink, OUT_RATE / 10, len - OUT_RATE / 10) / (20000 / sqrt(2));
+    check(fabs(level - DUCK_GAIN / 32768.0) < 0.002, "ducked audio is at -20 dB");
+    int ramp_len = OUT_RATE * RAMP_MS / 1000;
+    check(rms(sink, 0, ramp_len / 4) < rms(sink, ramp_len, 2 * ramp_len) / 2, "ducked audio fades in");
+    free(tone.pcm);
+    free(sink);
+    free(ref);
+}
+
+int main(int argc, char **argv)
+{
+    srand(1);
+    check_mixing();
+
+    /* Prerecorded TTS at 24 kHz mono in place, like basic_player hands it out, with an alarm tone ducked */
+    int tts_rate = 24000, tone_rate = 44100;
+    stream_t tts, tone;
+    stream_init(&tts, tts_rate, 1, tts_rate * BENCH_SECONDS, true);
+    stream_init(&tone, tone_rate, 2, tone_rate * BENCH_SECONDS, false);
+    fill_tts(&tts);
+    fill_tone(&tone, 880, 12000);
+
+    /* Before: 512 byte reads, a 12 * 512 byte downmix_rb kept full by the mixing task, 512 byte writes */
+    double old_ms = 512.0 / 2 / tts_rate * 1000 + 12 * 512.0 / 4 / OUT_RATE * 1000 + 512.0 / 4 / OUT_RATE * 1000;
+
+    printf("\nTTS %d Hz mono + ducked tone %d Hz stereo, %d s\n", tts_rate, tone_rate, BENCH_SECONDS);
+    printf("%-8s %10s %8s %10s %12s %12s\n", "frame", "us/frame", "CPU %", "filter ms", "direct ms", "ring ms");
+    int frame_ms[] = { 5, 10, 20 };
+    for (int i = 0; i < 3; i++) {
+        sys_playback_mixer_t m;
+        sys_playback_mixer_init(&m, OUT_RATE, frame_ms[i], RAMP_MS);
+        tts.pos = tone.pos = 0;
+        int64_t start = esp_timer_get_time();
+        int len = run_mix(&m, &tts, &tone, NULL, 0);
+        int64_t elapsed = esp_timer_get_time() - start;
+        sys_playback_mixer_deinit(&m);
+
+        /* A click in the TTS, where does it come out? */
+        stream_t click;
+        int16_t *sink = calloc(OUT_RATE, 4);
+        stream_init(&click, tts_rate, 1, tts_rate / 10, true);
+        click.pcm[tts_rate / 20] = 30000;
+        sys_playback_mixer_init(&m, OUT_RATE, frame_ms[i], RAMP_MS);
+        int out_len = run_mix(&m, &click, NULL, sink, OUT_RATE);
+        sys_playback_mixer_deinit(&m);
+        int peak = 0;
+        for (int j = 0; j < out_len; j++) {
+            peak = abs(sink[2 * j]) > abs(sink[2 * peak]) ? j : peak;
+        }
+        double filter_ms = peak * 1000.0 / OUT_RATE - 50.0;
+        free(click.pcm);
+        free(sink);
+
+        /* Live input waits for a whole frame before it is mixed, the ring adds RB_FRAMES when it is full */
+        double direct_ms = frame_ms[i] + filter_ms;
+        int frames = len / (OUT_RATE * frame_ms[i] / 1000);
+        printf("%-5d ms %10.1f %8.3f %10.2f %12.2f %12.2f\n", frame_ms[i], (double) elapsed / frames,
+               elapsed / 10000.0 / BENCH_SECONDS, filter_ms, direct_ms, direct_ms + RB_FRAMES * frame_ms[i]);
+    }
+    printf("before: 512 byte reads and 6 KB downmix_rb, %.2f ms\n", old_ms);
+    free(tts.pcm);
+    free(tone.pcm);
+
+    printf(failed ? "%d checks failed\n" : "All checks passed\n", failed);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1 @@
+/* Host build: no PSRAM, options such as the resampler quality are picked on the command line */
@@ -28,12 +28,17 @@
 #include <common_rb.h>
 #include <basic_rb.h>
 #include <special_rb.h>
+#include <spsc_rb.h>
 
 #define DEFAULT_RB_TYPE_BASIC_FUNC() {                           \
     .func.init = rb_init,                                        \
     .func.deinit = rb_cleanup,                                   \
     .func.read = rb_read,                                        \
     .func.write = rb_write,                                      \
+    .func.acquire_read = rb_acquire_read,                        \
+    .func.release_read = rb_release_read,                        \
+    .func.acquire_write = rb_acquire_write,                      \
+    .func.commit_write = rb_commit_write,                        \
     .func.drain = NULL,                                          \
     .func.reset = rb_reset,                                      \
     .func.abort = rb_abort,                                      \
@@ -57,6 +62,10 @@
     .func.deinit = NULL,                                         \
     .func.read = srb_read,                                       \
     .func.write = srb_write,                                     \
+    .func.acquire_read = srb_acquire_read,                       \
+    .func.release_read = srb_release_read,                       \
+    .func.acquire_write = srb_acquire_write,                     \
+    .func.commit_write = srb_commit_write,                       \
     .func.drain = srb_drain,                                     \
     .func.reset = srb_reset,                                     \
     .func.abort = srb_abort,                                     \
@@ -75,11 +84,43 @@
     .func.put_anchor_at_current = srb_put_anchor_at_current,     \
 }
 
+#define DEFAULT_RB_TYPE_SPSC_FUNC() {                            \
+    .func.init = spsc_rb_init,                                   \
+    .func.deinit = spsc_rb_cleanup,                              \
+    .func.read = spsc_rb_read,                                   \
+    .func.write = spsc_rb_write,                                 \
+    .func.acquire_read = NULL,                                   \
+    .func.release_read = NULL,                                   \
+    .func.acquire_write = NULL,                                  \
+    .func.commit_write = NULL,                                   \
+    .func.drain = NULL,                                          \
+    .func.reset = spsc_rb_reset,                                 \
+    .func.abort = spsc_rb_abort,                                 \
+    .func.abort_read = spsc_rb_abort_read,                       \
+    .func.abort_write = spsc_rb_abort_write,                     \
+    .func.get_filled = spsc_rb_filled,                           \
+    .func.get_available = spsc_rb_available,                     \
+    .func.get_read_offset = NULL,                                \
+    .func.get_write_offset = NULL,                               \
+    .func.reset_read_offset = NULL,                              \
+    .func.print_stats = spsc_rb_stat,                            \
+    .func.wakeup_reader = spsc_rb_wakeup_reader,                 \
+    .func.signal_writer_finished = spsc_rb_signal_writer_finished, \
+    .func.put_anchor = NULL,                                     \
+    .func.get_anchor = NULL,                                     \
+    .func.put_anchor_at_current = NULL,                          \
+}
+
 struct rb_func {
     rb_handle_t (*init)(const char *rb_name, uint32_t size);
     void (*deinit)(rb_handle_t handle);
     int (*read)(rb_handle_t handle, uint8_t *buf, int len, uint32_t ticks_to_wait);
     int (*write)(rb_handle_t handle, uint8_t *buf, int len, uint32_t ticks_to_wait);
+    /* Optional in-place access. NULL if the rb type only supports copying read/write. */
+    int (*acquire_read)(rb_handle_t handle, rb_region_t *region, int len, uint32_t ticks_to_wait);
+    int (*release_read)(rb_handle_t handle, int len);
+    int (*acquire_write)(rb_handle_t handle, rb_region_t *region, int len, uint32_t ticks_to_wait);
+    int (*commit_write)(rb_handle_t handle, int len);
     int (*drain)(rb_handle_t handle, uint64_t drain_upto);
     void (*reset)(rb_handle_t handle);
     void (*abort)(rb_handle_t handle);
@@ -108,6 +149,11 @@ void arb_deinit(rb_handle_t handle);
 int arb_read(rb_handle_t handle, uint8_t *buf, int len, uint32_t ticks_to_wait);
 int arb_write(rb_handle_t handle, uint8_t *buf, int len, uint32_t ticks_to_wait);
 
+int arb_acquire_read(rb_handle_t handle, rb_region_t *region, int len, uint32_t ticks_to_wait);
+int arb_release_read(rb_handle_t handle, int len);
+int arb_acquire_write(rb_handle_t handle, rb_region_t *region, int len, uint32_t ticks_to_wait);
+int arb_commit_write(rb_handle_t handle, int len);
+
 int arb_drain(rb_handle_t handle, uint64_t drain_upto);
 void arb_reset(rb_handle_t handle);
 void arb_abort(rb_handle_t handle);
@@ -95,14 +95,14 @@ void rb_stat(rb_handle_t handle);
  *
  * @param[in]  rb ringbuffer handle
  */
-ssize_t rb_filled(rb_handle_t handle);
+int rb_filled(rb_handle_t handle);
 
 /**
  * @brief Return rb available size.
  *
  * @param[in]  rb ringbuffer handle
  */
-ssize_t rb_available(rb_handle_t handle);
+int rb_available(rb_handle_t handle);
 
 /**
  * @brief Read from ring buffer
@@ -134,6 +134,60 @@ int rb_read(rb_handle_t handle, uint8_t *buf, int len, uint32_t ticks_to_wait);
  */
 int rb_write(rb_handle_t handle, uint8_t *buf, int len, uint32_t ticks_to_wait);
 
+/**
+ * @brief Expose filled data in place instead of copying it out.
+ *
+ * Blocks like `rb_read` until `len` bytes are filled, or the writer finishes,
+ * the reader is woken up or `ticks_to_wait` expires, and then describes the
+ * filled bytes (at most `len`) in `region`. The data stays in the ring buffer
+ * until it is given back with `rb_release_read`.
+ *
+ * @param[in]  rb Ringbuffer handle
+ * @param[out] region Location of the data. `wrap_len` is non-zero if the data wraps around.
+ * @param[in]  len Max bytes to expose. Capped to the ringbuffer size.
+ * @param[in]  ticks_to_wait Max wait ticks if data not available
+ *
+ * @return
+ *     - Number of bytes exposed (`region->len + region->wrap_len`)
+ *     - -ve value indicating error, as for `rb_read`.
+ *
+ * @note Only one region may be acquired for reading at a time. Every successful
+ *       acquire must be followed by `rb_release_read` before the next acquire.
+ */
+int rb_acquire_read(rb_handle_t handle, rb_region_t *region, int len, uint32_t ticks_to_wait);
+
+/**
+ * @brief Consume `len` bytes of the region returned by `rb_acquire_read`.
+ *
+ * `len` may be less than what was acquired, the rest stays in the ringbuffer.
+ *
+ * @return Number of bytes consumed. This is 0 if the ringbuffer was reset in between.
+ */
+int rb_release_read(rb_handle_t handle, int len);
+
+/**
+ * @brief Expose empty space in place so that it can be filled without a copy.
+ *
+ * Blocks until some space is free, or `ticks_to_wait` expires, and then
+ * describes the free bytes (at most `len`) in `region`. Unlike `rb_write`,
+ * this may return less than `len` without waiting for more space. Nothing is
+ * visible to the reader until `rb_commit_write` is called.
+ *
+ * @return
+ *     - Number of bytes exposed (`region->len + region->wrap_len`)
+ *     - -ve value indicating error.
+ *
+ * @note Only one region may be acquired for writing at a time.
+ */
+int rb_acquire_write(rb_handle_t handle, rb_region_t *region, int len, uint32_t ticks_to_wait);
+
+/**
+ * @brief Publish `len` bytes written into the region returned by `rb_acquire_write`.
+ *
+ * @return Number of bytes published. This is 0 if the ringbuffer was reset in between.
+ */
+int rb_commit_write(rb_handle_t handle, int len);
+
 /**
  * @brief Tell ringbuffer that no more writes will be done.
  *
@@ -48,11 +48,24 @@ typedef struct rb_anchor {
     void *data;
 } rb_anchor_t;
 
+/* A span of ring buffer memory handed out in place by the acquire APIs.
+ * If the span runs past the end of the buffer, the part that wrapped
+ * around to the start is described by `wrap_ptr` and `wrap_len`.
+ * Otherwise `wrap_ptr` is NULL and `wrap_len` is 0.
+ */
+typedef struct rb_region {
+    uint8_t *ptr;
+    int len;
+    uint8_t *wrap_ptr;
+    int wrap_len;
+} rb_region_t;
+
 /* For internal use. */
 typedef enum rb_type {
     RB_TYPE_BASIC,
     RB_TYPE_SPECIAL,
     RB_TYPE_ABSTRACT,
+    RB_TYPE_SPSC,
     RB_TYPE_MAX,
 } rb_type_t;
 
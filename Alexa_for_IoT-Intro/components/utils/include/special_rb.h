@@ -21,6 +21,16 @@ int srb_write(rb_handle_t handle, uint8_t *buf, int len, uint32_t ticks_to_wait)
  * read further
  */
 int srb_read(rb_handle_t handle, uint8_t *buf, int len, uint32_t ticks_to_wait);
+/* In-place counterparts of srb_read()/srb_write(), see rb_acquire_read()
+ * and friends. srb_acquire_read() stops at the next anchor like
+ * srb_read() does, and the read offset only advances on
+ * srb_release_read(). A successful srb_acquire_read() keeps other
+ * readers (and srb_drain()) out until srb_release_read() is called.
+ */
+int srb_acquire_read(rb_handle_t handle, rb_region_t *region, int len, uint32_t ticks_to_wait);
+int srb_release_read(rb_handle_t handle, int len);
+int srb_acquire_write(rb_handle_t handle, rb_region_t *region, int len, uint32_t ticks_to_wait);
+int srb_commit_write(rb_handle_t handle, int len);
 /* Put an anchor in the data stream at a particular offset */
 int srb_put_anchor(rb_handle_t handle, rb_anchor_t *anchor);
 /* Read the current anchor */
@@ -0,0 +1,101 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+#ifndef _SPSC_RING_BUF_H_
+#define _SPSC_RING_BUF_H_
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <common_rb.h>
+
+/* Single Producer Single Consumer Ring Buffer: a lock-free variant of the
+ * basic ring buffer for pipeline edges with exactly one writer task and
+ * one reader task. Read and write indices are published with
+ * acquire/release ordering, so the fast path takes no lock. A task only
+ * blocks, using its FreeRTOS task notification, when the buffer is
+ * actually empty (reader) or full (writer).
+ *
+ * The usable size is rounded up to the next power of two.
+ *
+ * Since blocking uses the direct-to-task notification value, reader and
+ * writer tasks must not wait on task notifications for anything else.
+ */
+
+/**
+ * @brief Create and initialize SPSC ringbuffer.
+ *
+ * @param[in]  rb_name Name of the ringbuffer
+ * @param[in]  size size of the ringbuffer, rounded up to a power of two
+ * @return
+ *     - ringbuffer handle
+ *     - NULL if failed.
+ */
+rb_handle_t spsc_rb_init(const char *rb_name, uint32_t size);
+
+/**
+ * @brief Cleanup and destroy SPSC ringbuffer.
+ */
+void spsc_rb_cleanup(rb_handle_t handle);
+
+/**
+ * @brief Read from SPSC ring buffer. Must only be called from the reader task.
+ *
+ * Semantics are the same as `rb_read`: if `buf` is NULL, `len` bytes are
+ * discarded. Returns the number of bytes read, `RB_ABORT`,
+ * `RB_WRITER_FINISHED`, `RB_READER_UNBLOCK` or `RB_FAIL`.
+ */
+int spsc_rb_read(rb_handle_t handle, uint8_t *buf, int len, uint32_t ticks_to_wait);
+
+/**
+ * @brief Write to SPSC ring buffer. Must only be called from the writer task.
+ *
+ * Semantics are the same as `rb_write`.
+ */
+int spsc_rb_write(rb_handle_t handle, uint8_t *buf, int len, uint32_t ticks_to_wait);
+
+/**
+ * @brief Reset the ringbuffer as if new.
+ *
+ * @note Neither the reader nor the writer may be inside read/write while resetting.
+ */
+void spsc_rb_reset(rb_handle_t handle);
+
+/* Abort reads, writes or both. Blocked reader/writer are woken up. */
+void spsc_rb_abort_read(rb_handle_t handle);
+void spsc_rb_abort_write(rb_handle_t handle);
+void spsc_rb_abort(rb_handle_t handle);
+
+/* Return filled/available size in bytes */
+int spsc_rb_filled(rb_handle_t handle);
+int spsc_rb_available(rb_handle_t handle);
+
+/* Print buffer stats */
+void spsc_rb_stat(rb_handle_t handle);
+
+/* Tell the reader that no more writes will be done */
+void spsc_rb_signal_writer_finished(rb_handle_t handle);
+
+/* Wake up the reader from the current spsc_rb_read */
+void spsc_rb_wakeup_reader(rb_handle_t handle);
+
+#endif /* _SPSC_RING_BUF_H_ */
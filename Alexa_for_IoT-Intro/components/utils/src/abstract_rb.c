@@ -127,6 +127,82 @@ int arb_write(rb_handle_t handle, uint8_t *buf, int len, uint32_t ticks_to_wait)
     return arb->func.write(arb->rb, buf, len, ticks_to_wait);
 }
 
+int arb_acquire_read(rb_handle_t handle, rb_region_t *region, int len, uint32_t ticks_to_wait)
+{
+    if (handle == NULL) {
+        ESP_LOGE(TAG, "Handle is NULL");
+        return 0;
+    }
+    abstract_rb_t *arb = (abstract_rb_t *)handle;
+    if (arb->type != RB_TYPE_ABSTRACT) {
+        ESP_LOGE(TAG, "Incorrect rb_type: %d", arb->type);
+        return 0;
+    }
+    if (!arb->func.acquire_read) {
+        ESP_LOGE(TAG, "rb function not defined");
+        return 0;
+    }
+
+    return arb->func.acquire_read(arb->rb, region, len, ticks_to_wait);
+}
+
+int arb_release_read(rb_handle_t handle, int len)
+{
+    if (handle == NULL) {
+        ESP_LOGE(TAG, "Handle is NULL");
+        return 0;
+    }
+    abstract_rb_t *arb = (abstract_rb_t *)handle;
+    if (arb->type != RB_TYPE_ABSTRACT) {
+        ESP_LOGE(TAG, "Incorrect rb_type: %d", arb->type);
+        return 0;
+    }
+    if (!arb->func.release_read) {
+        ESP_LOGE(TAG, "rb function not defined");
+        return 0;
+    }
+
+    return arb->func.release_read(arb->rb, len);
+}
+
+int arb_acquire_write(rb_handle_t handle, rb_region_t *region, int len, uint32_t ticks_to_wait)
+{
+    if (handle == NULL) {
+        ESP_LOGE(TAG, "Handle is NULL");
+        return 0;
+    }
+    abstract_rb_t *arb = (abstract_rb_t *)handle;
+    if (arb->type != RB_TYPE_ABSTRACT) {
+        ESP_LOGE(TAG, "Incorrect rb_type: %d", arb->type);
+        return 0;
+    }
+    if (!arb->func.acquire_write) {
+        ESP_LOGE(TAG, "rb function not defined");
+        return 0;
+    }
+
+    return arb->func.acquire_write(arb->rb, region, len, ticks_to_wait);
+}
+
+int arb_commit_write(rb_handle_t handle, int len)
+{
+    if (handle == NULL) {
+        ESP_LOGE(TAG, "Handle is NULL");
+        return 0;
+    }
+    abstract_rb_t *arb = (abstract_rb_t *)handle;
+    if (arb->type != RB_TYPE_ABSTRACT) {
+        ESP_LOGE(TAG, "Incorrect rb_type: %d", arb->type);
+        return 0;
+    }
+    if (!arb->func.commit_write) {
+        ESP_LOGE(TAG, "rb function not defined");
+        return 0;
+    }
+
+    return arb->func.commit_write(arb->rb, len);
+}
+
 int arb_drain(rb_handle_t handle, uint64_t drain_upto)
 {
     if (handle == NULL) {
@@ -55,6 +55,8 @@ typedef struct ringbuf {
     int abort_write;
     int writer_finished;  //to prevent infinite blocking for buffer read
     int reader_unblock;
+    int read_acquired;    /**< Bytes handed out by rb_acquire_read */
+    int write_acquired;   /**< Bytes handed out by rb_acquire_write */
 } ringbuf_t;
 
 rb_handle_t rb_init(const char *name, uint32_t size)
@@ -88,6 +90,8 @@ rb_handle_t rb_init(const char *name, uint32_t size)
     r->abort_write = 0;
     r->writer_finished = 0;
     r->reader_unblock = 0;
+    r->read_acquired = 0;
+    r->write_acquired = 0;
 
     return (rb_handle_t)r;
 }
@@ -118,7 +122,7 @@ void rb_cleanup(rb_handle_t handle)
 /*
  * @brief: get the number of filled bytes in the buffer
  */
-ssize_t rb_filled(rb_handle_t handle)
+int rb_filled(rb_handle_t handle)
 {
     if (handle == NULL) {
         ESP_LOGE(TAG, "handle is NULL");
@@ -136,7 +140,7 @@ ssize_t rb_filled(rb_handle_t handle)
 /*
  * @brief: get the number of empty bytes available in the buffer
  */
-ssize_t rb_available(rb_handle_t handle)
+int rb_available(rb_handle_t handle)
 {
     if (handle == NULL) {
         ESP_LOGE(TAG, "handle is NULL");
@@ -148,7 +152,7 @@ ssize_t rb_available(rb_handle_t handle)
         return -1;
     }
 
-    ESP_LOGD(TAG, "rb leftover %d bytes", rb->size - rb->fill_cnt);
+    ESP_LOGD(TAG, "rb leftover %d bytes", (int) (rb->size - rb->fill_cnt));
     return (rb->size - rb->fill_cnt);
 }
 
@@ -320,6 +324,211 @@ out:
     return total_write_size;
 }
 
+/*
+ * Describe `len` bytes starting at `start` in `region`, splitting at the end of the buffer.
+ * Lock must be held.
+ */
+static void rb_fill_region(ringbuf_t *rb, uint8_t *start, int len, rb_region_t *region)
+{
+    if (start == rb->base + rb->size) {
+        start = rb->base;
+    }
+    int len1 = rb->base + rb->size - start;
+    if (len <= len1) {
+        region->ptr = start;
+        region->len = len;
+        region->wrap_ptr = NULL;
+        region->wrap_len = 0;
+    } else {
+        region->ptr = start;
+        region->len = len1;
+        region->wrap_ptr = rb->base;
+        region->wrap_len = len - len1;
+    }
+}
+
+/*
+ * Move `ptr` ahead by `len` bytes, wrapping around the end of the buffer.
+ * Lock must be held.
+ */
+static uint8_t *rb_advance(ringbuf_t *rb, uint8_t *ptr, int len)
+{
+    ptr += len;
+    if (ptr >= rb->base + rb->size) {
+        ptr -= rb->size;
+    }
+    return ptr;
+}
+
+int rb_acquire_read(rb_handle_t handle, rb_region_t *region, int len, uint32_t ticks_to_wait)
+{
+    if (handle == NULL) {
+        ESP_LOGE(TAG, "handle is NULL");
+        return 0;
+    }
+    ringbuf_t *rb = (ringbuf_t *)handle;
+    if (rb->type != RB_TYPE_BASIC) {
+        ESP_LOGE(TAG, "Incorrect rb_type: %d", rb->type);
+        return 0;
+    }
+
+    if (region == NULL || len <= 0 || rb->abort_read == 1) {
+        return RB_FAIL;
+    }
+    if (len > rb->size) {
+        len = rb->size;
+    }
+
+    int ret;
+    xSemaphoreTake(rb->lock, portMAX_DELAY);
+    /* Unlike rb_read, we cannot hand out data while waiting for more. So wait for all of it. */
+    while (rb->fill_cnt < len) {
+        if (rb->abort_read || rb->writer_finished || rb->reader_unblock) {
+            break;
+        }
+        xSemaphoreGive(rb->lock);
+        if (xSemaphoreTake(rb->can_read, ticks_to_wait) != pdTRUE) {
+            /* Small delay to avoid WDT triggering when the ticks_to_wait is set to 0 */
+            vTaskDelay(1);
+            xSemaphoreTake(rb->lock, portMAX_DELAY);
+            break;
+        }
+        xSemaphoreTake(rb->lock, portMAX_DELAY);
+    }
+
+    if (rb->abort_read == 1) {
+        ret = RB_ABORT;
+    } else if (rb->fill_cnt > 0) {
+        ret = (rb->fill_cnt < len) ? rb->fill_cnt : len;
+        rb_fill_region(rb, rb->readptr, ret, region);
+        rb->read_acquired = ret;
+    } else if (rb->writer_finished == 1) {
+        ret = RB_WRITER_FINISHED;
+    } else if (rb->reader_unblock == 1) {
+        ret = RB_READER_UNBLOCK;
+    } else {
+        ret = 0;
+    }
+    rb->reader_unblock = 0; /* We are anyway unblocking reader */
+    xSemaphoreGive(rb->lock);
+    return ret;
+}
+
+int rb_release_read(rb_handle_t handle, int len)
+{
+    if (handle == NULL) {
+        ESP_LOGE(TAG, "handle is NULL");
+        return 0;
+    }
+    ringbuf_t *rb = (ringbuf_t *)handle;
+    if (rb->type != RB_TYPE_BASIC) {
+        ESP_LOGE(TAG, "Incorrect rb_type: %d", rb->type);
+        return 0;
+    }
+
+    xSemaphoreTake(rb->lock, portMAX_DELAY);
+    if (len > rb->read_acquired) {
+        len = rb->read_acquired;
+    }
+    if (len > 0) {
+        rb->readptr = rb_advance(rb, rb->readptr, len);
+        rb->fill_cnt -= len;
+    } else {
+        len = 0;
+    }
+    rb->read_acquired = 0;
+    xSemaphoreGive(rb->lock);
+
+    if (len) {
+        xSemaphoreGive(rb->can_write);
+    }
+    return len;
+}
+
+int rb_acquire_write(rb_handle_t handle, rb_region_t *region, int len, uint32_t ticks_to_wait)
+{
+    if (handle == NULL) {
+        ESP_LOGE(TAG, "handle is NULL");
+        return 0;
+    }
+    ringbuf_t *rb = (ringbuf_t *)handle;
+    if (rb->type != RB_TYPE_BASIC) {
+        ESP_LOGE(TAG, "Incorrect rb_type: %d", rb->type);
+        return 0;
+    }
+
+    if (region == NULL || len <= 0 || rb->abort_write == 1) {
+        return RB_FAIL;
+    }
+    if (len > rb->size) {
+        len = rb->size;
+    }
+
+    int ret;
+    xSemaphoreTake(rb->lock, portMAX_DELAY);
+    /* Hand out whatever is free. If the reader is waiting in rb_acquire_read
+     * for more data, waiting for all of `len` here would deadlock both. */
+    while (rb->fill_cnt == rb->size) {
+        if (rb->abort_write || rb->writer_finished) {
+            break;
+        }
+        xSemaphoreGive(rb->lock);
+        if (xSemaphoreTake(rb->can_write, ticks_to_wait) != pdTRUE) {
+            xSemaphoreTake(rb->lock, portMAX_DELAY);
+            break;
+        }
+        xSemaphoreTake(rb->lock, portMAX_DELAY);
+    }
+
+    if (rb->abort_write == 1) {
+        ret = RB_ABORT;
+    } else if (rb->writer_finished == 1) {
+        ret = RB_WRITER_FINISHED;
+    } else {
+        ret = rb->size - rb->fill_cnt;
+        if (ret > len) {
+            ret = len;
+        }
+        if (ret > 0) {
+            rb_fill_region(rb, rb->writeptr, ret, region);
+            rb->write_acquired = ret;
+        }
+    }
+    xSemaphoreGive(rb->lock);
+    return ret;
+}
+
+int rb_commit_write(rb_handle_t handle, int len)
+{
+    if (handle == NULL) {
+        ESP_LOGE(TAG, "handle is NULL");
+        return 0;
+    }
+    ringbuf_t *rb = (ringbuf_t *)handle;
+    if (rb->type != RB_TYPE_BASIC) {
+        ESP_LOGE(TAG, "Incorrect rb_type: %d", rb->type);
+        return 0;
+    }
+
+    xSemaphoreTake(rb->lock, portMAX_DELAY);
+    if (len > rb->write_acquired) {
+        len = rb->write_acquired;
+    }
+    if (len > 0) {
+        rb->writeptr = rb_advance(rb, rb->writeptr, len);
+        rb->fill_cnt += len;
+    } else {
+        len = 0;
+    }
+    rb->write_acquired = 0;
+    xSemaphoreGive(rb->lock);
+
+    if (len) {
+        xSemaphoreGive(rb->can_read);
+    }
+    return len;
+}
+
 /**
  * abort and set abort_read and abort_write to asked values.
  */
@@ -340,6 +549,9 @@ static void _rb_reset(rb_handle_t handle, int abort_read, int abort_write)
     rb->fill_cnt = 0;
     rb->writer_finished = 0;
     rb->reader_unblock = 0;
+    /* Anything acquired so far is gone, a late release/commit becomes a no-op */
+    rb->read_acquired = 0;
+    rb->write_acquired = 0;
     rb->abort_read = abort_read;
     rb->abort_write = abort_write;
     xSemaphoreGive(rb->lock);
@@ -495,6 +707,6 @@ void rb_stat(rb_handle_t handle)
 
     xSemaphoreTake(rb->lock, portMAX_DELAY);
     ESP_LOGI(TAG, "filled: %d, base: %p, read_ptr: %p, write_ptr: %p, size: %d\n",
-                rb->fill_cnt, rb->base, rb->readptr, rb->writeptr, rb->size);
+                (int) rb->fill_cnt, rb->base, rb->readptr, rb->writeptr, (int) rb->size);
     xSemaphoreGive(rb->lock);
 }
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <stdbool.h>
 #include <string.h>
 #include <esp_audio_mem.h>
 
@@ -30,6 +31,8 @@ typedef struct {
     /* The lock that protects this data structure*/
     xSemaphoreHandle lock;
     xSemaphoreHandle read_lock;
+    /* Set while srb_acquire_read() holds read_lock on behalf of the reader */
+    bool read_acquired;
 } s_ringbuf_t;
 
 rb_handle_t srb_init(const char *rb_name, uint32_t size)
@@ -178,6 +181,100 @@ int srb_write(rb_handle_t handle, uint8_t *buf, int len, uint32_t ticks_to_wait)
     return rb_write(srb->rb, buf, len, ticks_to_wait);
 }
 
+int srb_acquire_read(rb_handle_t handle, rb_region_t *region, int len, uint32_t ticks_to_wait)
+{
+    if (handle == NULL) {
+        ESP_LOGE(TAG, "handle is NULL");
+        return 0;
+    }
+    s_ringbuf_t *srb = (s_ringbuf_t *)handle;
+    if (srb->type != RB_TYPE_SPECIAL) {
+        ESP_LOGE(TAG, "Incorrect rb_type: %d", srb->type);
+        return 0;
+    }
+
+    xSemaphoreTake(srb->read_lock, portMAX_DELAY);
+    xSemaphoreTake(srb->lock, portMAX_DELAY);
+    if (srb->list.next) {
+        /* Same as srb_read(): never hand out data beyond the next anchor */
+        int64_t anchor_distance = srb->list.next->anchor.offset - srb->read_offset;
+        if (anchor_distance <= 0) {
+            xSemaphoreGive(srb->lock);
+            xSemaphoreGive(srb->read_lock);
+            return RB_FETCH_ANCHOR;
+        }
+        if (len > anchor_distance) {
+            len = anchor_distance;
+        }
+    }
+    xSemaphoreGive(srb->lock);
+
+    int ret = rb_acquire_read(srb->rb, region, len, ticks_to_wait);
+    if (ret <= 0) {
+        xSemaphoreGive(srb->read_lock);
+        return ret;
+    }
+    /* read_lock is now held until srb_release_read() */
+    srb->read_acquired = true;
+    return ret;
+}
+
+int srb_release_read(rb_handle_t handle, int len)
+{
+    if (handle == NULL) {
+        ESP_LOGE(TAG, "handle is NULL");
+        return 0;
+    }
+    s_ringbuf_t *srb = (s_ringbuf_t *)handle;
+    if (srb->type != RB_TYPE_SPECIAL) {
+        ESP_LOGE(TAG, "Incorrect rb_type: %d", srb->type);
+        return 0;
+    }
+    if (!srb->read_acquired) {
+        ESP_LOGE(TAG, "Release without acquire");
+        return 0;
+    }
+
+    xSemaphoreTake(srb->lock, portMAX_DELAY);
+    /* Returns 0 if srb_reset() ran in between, which has already accounted for the data */
+    int ret = rb_release_read(srb->rb, len);
+    srb->read_offset += ret;
+    xSemaphoreGive(srb->lock);
+    srb->read_acquired = false;
+    xSemaphoreGive(srb->read_lock);
+    return ret;
+}
+
+int srb_acquire_write(rb_handle_t handle, rb_region_t *region, int len, uint32_t ticks_to_wait)
+{
+    if (handle == NULL) {
+        ESP_LOGE(TAG, "handle is NULL");
+        return 0;
+    }
+    s_ringbuf_t *srb = (s_ringbuf_t *)handle;
+    if (srb->type != RB_TYPE_SPECIAL) {
+        ESP_LOGE(TAG, "Incorrect rb_type: %d", srb->type);
+        return 0;
+    }
+
+    return rb_acquire_write(srb->rb, region, len, ticks_to_wait);
+}
+
+int srb_commit_write(rb_handle_t handle, int len)
+{
+    if (handle == NULL) {
+        ESP_LOGE(TAG, "handle is NULL");
+        return 0;
+    }
+    s_ringbuf_t *srb = (s_ringbuf_t *)handle;
+    if (srb->type != RB_TYPE_SPECIAL) {
+        ESP_LOGE(TAG, "Incorrect rb_type: %d", srb->type);
+        return 0;
+    }
+
+    return rb_commit_write(srb->rb, len);
+}
+
 int srb_get_anchor(rb_handle_t handle, rb_anchor_t *anchor)
 {
     if (handle == NULL) {
@@ -0,0 +1,413 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+/**
+* \file
+*   Lock-free single producer single consumer Ring Buffer library
+*/
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <spsc_rb.h>
+#include "esp_log.h"
+#include "esp_err.h"
+#include <esp_audio_mem.h>
+
+static const char *TAG = "[spsc_rb]";
+
+typedef struct spsc_ringbuf {
+    /* Keep rb_type_t first */
+    rb_type_t type;
+    char *name;
+    uint8_t *base;
+    uint32_t size;      /**< Buffer size, power of two */
+    uint32_t mask;      /**< size - 1 */
+    /* Free running byte counters. Only the writer stores `head`, only the reader stores `tail`. */
+    atomic_uint head;
+    atomic_uint tail;
+    /* Task blocked for data (reader) or space (writer), NULL if none */
+    _Atomic(TaskHandle_t) reader;
+    _Atomic(TaskHandle_t) writer;
+    atomic_int abort_read;
+    atomic_int abort_write;
+    atomic_int writer_finished;
+    atomic_int reader_unblock;
+} spsc_ringbuf_t;
+
+static spsc_ringbuf_t *spsc_rb_get(rb_handle_t handle)
+{
+    if (handle == NULL) {
+        ESP_LOGE(TAG, "handle is NULL");
+        return NULL;
+    }
+    spsc_ringbuf_t *rb = (spsc_ringbuf_t *)handle;
+    if (rb->type != RB_TYPE_SPSC) {
+        ESP_LOGE(TAG, "Incorrect rb_type: %d", rb->type);
+        return NULL;
+    }
+    return rb;
+}
+
+static inline uint32_t spsc_rb_fill(spsc_ringbuf_t *rb)
+{
+    return atomic_load_explicit(&rb->head, memory_order_acquire) -
+           atomic_load_explicit(&rb->tail, memory_order_acquire);
+}
+
+/* Wake up the task parked on `waiter`. The fence orders the preceding index
+ * or flag update against reading the waiter, pairing with the fence in
+ * spsc_rb_wait(), so that a wakeup can never be lost.
+ */
+static inline void spsc_rb_notify(_Atomic(TaskHandle_t) *waiter)
+{
+    atomic_thread_fence(memory_order_seq_cst);
+    TaskHandle_t task = atomic_load_explicit(waiter, memory_order_relaxed);
+    if (task) {
+        xTaskNotifyGive(task);
+    }
+}
+
+static bool spsc_rb_reader_can_go(spsc_ringbuf_t *rb)
+{
+    return spsc_rb_fill(rb) != 0 || atomic_load(&rb->abort_read) ||
+           atomic_load(&rb->writer_finished) || atomic_load(&rb->reader_unblock);
+}
+
+static bool spsc_rb_writer_can_go(spsc_ringbuf_t *rb)
+{
+    return spsc_rb_fill(rb) != rb->size || atomic_load(&rb->abort_write);
+}
+
+/* Park the calling task on `waiter` until `can_go` holds or `ticks_to_wait` expires. */
+static bool spsc_rb_wait(spsc_ringbuf_t *rb, _Atomic(TaskHandle_t) *waiter,
+                         bool (*can_go)(spsc_ringbuf_t *rb), TickType_t ticks_to_wait)
+{
+    TimeOut_t timeout;
+    bool ret = true;
+
+    vTaskSetTimeOutState(&timeout);
+    atomic_store_explicit(waiter, xTaskGetCurrentTaskHandle(), memory_order_relaxed);
+    while (1) {
+        atomic_thread_fence(memory_order_seq_cst);
+        if (can_go(rb)) {
+            break;
+        }
+        if (xTaskCheckForTimeOut(&timeout, &ticks_to_wait) == pdTRUE) {
+            ret = false;
+            break;
+        }
+        /* A stale notification only costs one more pass through the loop */
+        ulTaskNotifyTake(pdTRUE, ticks_to_wait);
+    }
+    atomic_store_explicit(waiter, NULL, memory_order_relaxed);
+    return ret;
+}
+
+rb_handle_t spsc_rb_init(const char *name, uint32_t size)
+{
+    spsc_ringbuf_t *rb;
+    uint32_t rb_size = 2;
+
+    if (size < 2 || size > (1u << 30) || !name) {
+        return NULL;
+    }
+    while (rb_size < size) {
+        rb_size <<= 1;
+    }
+
+    rb = esp_audio_mem_calloc(1, sizeof(spsc_ringbuf_t));
+    if (rb == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate %s", name);
+        return NULL;
+    }
+    rb->base = esp_audio_mem_calloc(1, rb_size);
+    if (rb->base == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate %d bytes for %s", rb_size, name);
+        esp_audio_mem_free(rb);
+        return NULL;
+    }
+
+    rb->type = RB_TYPE_SPSC;
+    rb->name = (char *) name;
+    rb->size = rb_size;
+    rb->mask = rb_size - 1;
+    atomic_init(&rb->head, 0);
+    atomic_init(&rb->tail, 0);
+    atomic_init(&rb->abort_read, 0);
+    atomic_init(&rb->abort_write, 0);
+    atomic_init(&rb->writer_finished, 0);
+    atomic_init(&rb->reader_unblock, 0);
+    atomic_init(&rb->reader, NULL);
+    atomic_init(&rb->writer, NULL);
+
+    return (rb_handle_t)rb;
+}
+
+void spsc_rb_cleanup(rb_handle_t handle)
+{
+    spsc_ringbuf_t *rb = spsc_rb_get(handle);
+    if (rb == NULL) {
+        return;
+    }
+
+    esp_audio_mem_free(rb->base);
+    rb->base = NULL;
+    esp_audio_mem_free(rb);
+}
+
+int spsc_rb_filled(rb_handle_t handle)
+{
+    spsc_ringbuf_t *rb = spsc_rb_get(handle);
+    if (rb == NULL) {
+        return -1;
+    }
+
+    return spsc_rb_fill(rb);
+}
+
+int spsc_rb_available(rb_handle_t handle)
+{
+    spsc_ringbuf_t *rb = spsc_rb_get(handle);
+    if (rb == NULL) {
+        return -1;
+    }
+
+    return rb->size - spsc_rb_fill(rb);
+}
+
+int spsc_rb_read(rb_handle_t handle, uint8_t *buf, int buf_len, uint32_t ticks_to_wait)
+{
+    spsc_ringbuf_t *rb = spsc_rb_get(handle);
+    if (rb == NULL) {
+        return 0;
+    }
+
+    int total_read_size = 0;
+
+    if (atomic_load(&rb->abort_read)) {
+        return ESP_FAIL;
+    }
+
+    while (buf_len) {
+        /* Only this task moves tail, the acquire on head makes the written bytes visible */
+        uint32_t tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+        uint32_t head = atomic_load_explicit(&rb->head, memory_order_acquire);
+        uint32_t read_size = head - tail;
+
+        if (read_size > (uint32_t)buf_len) {
+            read_size = buf_len;
+        }
+        if (read_size) {
+            uint32_t offset = tail & rb->mask;
+            uint32_t rlen1 = rb->size - offset;
+            if (buf) {
+                if (rlen1 >= read_size) {
+                    memcpy(buf, rb->base + offset, read_size);
+                } else {
+                    memcpy(buf, rb->base + offset, rlen1);
+                    memcpy(buf + rlen1, rb->base, read_size - rlen1);
+                }
+                buf += read_size;
+            }
+            atomic_store_explicit(&rb->tail, tail + read_size, memory_order_release);
+            spsc_rb_notify(&rb->writer);
+
+            buf_len -= read_size;
+            total_read_size += read_size;
+            if (buf_len == 0) {
+                break;
+            }
+        }
+
+        if (!atomic_load(&rb->writer_finished) && !atomic_load(&rb->abort_read) && !atomic_load(&rb->reader_unblock)) {
+            if (!spsc_rb_wait(rb, &rb->reader, spsc_rb_reader_can_go, ticks_to_wait)) {
+                /* Small delay to avoid WDT triggering when the ticks_to_wait is set to 0 */
+                vTaskDelay(1);
+                goto out;
+            }
+        }
+        if (atomic_load(&rb->abort_read)) {
+            total_read_size = RB_ABORT;
+            goto out;
+        }
+        /* Drain whatever the writer left before reporting it finished */
+        if (atomic_load(&rb->writer_finished) && spsc_rb_fill(rb) == 0) {
+            goto out;
+        }
+        if (atomic_load(&rb->reader_unblock)) {
+            if (total_read_size == 0) {
+                total_read_size = RB_READER_UNBLOCK;
+            }
+            goto out;
+        }
+    }
+
+out:
+    if (atomic_load(&rb->writer_finished) && total_read_size == 0) {
+        total_read_size = RB_WRITER_FINISHED;
+    }
+    atomic_store(&rb->reader_unblock, 0); /* We are anyway unblocking reader */
+    return total_read_size;
+}
+
+int spsc_rb_write(rb_handle_t handle, uint8_t *buf, int buf_len, uint32_t ticks_to_wait)
+{
+    spsc_ringbuf_t *rb = spsc_rb_get(handle);
+    if (rb == NULL) {
+        return 0;
+    }
+
+    int total_write_size = 0;
+
+    if (buf == NULL || atomic_load(&rb->abort_write)) {
+        return RB_FAIL;
+    }
+
+    while (buf_len) {
+        /* Only this task moves head, the acquire on tail makes sure the reader is done with the space */
+        uint32_t head = atomic_load_explicit(&rb->head, memory_order_relaxed);
+        uint32_t tail = atomic_load_explicit(&rb->tail, memory_order_acquire);
+        uint32_t write_size = rb->size - (head - tail);
+
+        if (write_size > (uint32_t)buf_len) {
+            write_size = buf_len;
+        }
+        if (write_size) {
+            uint32_t offset = head & rb->mask;
+            uint32_t wlen1 = rb->size - offset;
+            if (wlen1 >= write_size) {
+                memcpy(rb->base + offset, buf, write_size);
+            } else {
+                memcpy(rb->base + offset, buf, wlen1);
+                memcpy(rb->base, buf + wlen1, write_size - wlen1);
+            }
+            atomic_store_explicit(&rb->head, head + write_size, memory_order_release);
+            spsc_rb_notify(&rb->reader);
+
+            buf += write_size;
+            buf_len -= write_size;
+            total_write_size += write_size;
+            if (buf_len == 0) {
+                break;
+            }
+        }
+
+        if (atomic_load(&rb->writer_finished)) {
+            return total_write_size > 0 ? total_write_size : RB_WRITER_FINISHED;
+        }
+        if (!spsc_rb_wait(rb, &rb->writer, spsc_rb_writer_can_go, ticks_to_wait)) {
+            break;
+        }
+        if (atomic_load(&rb->abort_write)) {
+            break;
+        }
+    }
+
+    return total_write_size;
+}
+
+void spsc_rb_reset(rb_handle_t handle)
+{
+    spsc_ringbuf_t *rb = spsc_rb_get(handle);
+    if (rb == NULL) {
+        return;
+    }
+
+    atomic_store(&rb->head, 0);
+    atomic_store(&rb->tail, 0);
+    atomic_store(&rb->writer_finished, 0);
+    atomic_store(&rb->reader_unblock, 0);
+    atomic_store(&rb->abort_read, 0);
+    atomic_store(&rb->abort_write, 0);
+}
+
+void spsc_rb_abort_read(rb_handle_t handle)
+{
+    spsc_ringbuf_t *rb = spsc_rb_get(handle);
+    if (rb == NULL) {
+        return;
+    }
+
+    atomic_store(&rb->abort_read, 1);
+    spsc_rb_notify(&rb->reader);
+}
+
+void spsc_rb_abort_write(rb_handle_t handle)
+{
+    spsc_ringbuf_t *rb = spsc_rb_get(handle);
+    if (rb == NULL) {
+        return;
+    }
+
+    atomic_store(&rb->abort_write, 1);
+    spsc_rb_notify(&rb->writer);
+}
+
+void spsc_rb_abort(rb_handle_t handle)
+{
+    spsc_ringbuf_t *rb = spsc_rb_get(handle);
+    if (rb == NULL) {
+        return;
+    }
+
+    atomic_store(&rb->abort_read, 1);
+    atomic_store(&rb->abort_write, 1);
+    spsc_rb_notify(&rb->reader);
+    spsc_rb_notify(&rb->writer);
+}
+
+void spsc_rb_signal_writer_finished(rb_handle_t handle)
+{
+    spsc_ringbuf_t *rb = spsc_rb_get(handle);
+    if (rb == NULL) {
+        return;
+    }
+
+    atomic_store(&rb->writer_finished, 1);
+    spsc_rb_notify(&rb->reader);
+}
+
+void spsc_rb_wakeup_reader(rb_handle_t handle)
+{
+    spsc_ringbuf_t *rb = spsc_rb_get(handle);
+    if (rb == NULL) {
+        return;
+    }
+
+    atomic_store(&rb->reader_unblock, 1);
+    spsc_rb_notify(&rb->reader);
+}
+
+void spsc_rb_stat(rb_handle_t handle)
+{
+    spsc_ringbuf_t *rb = spsc_rb_get(handle);
+    if (rb == NULL) {
+        return;
+    }
+
+    ESP_LOGI(TAG, "%s filled: %u, base: %p, head: %u, tail: %u, size: %u\n", rb->name,
+             spsc_rb_fill(rb), rb->base, atomic_load(&rb->head), atomic_load(&rb->tail), rb->size);
+}
@@ -0,0 +1,24 @@
+/* Host stand-in for FreeRTOS on pthreads, just what the ring buffers use. A tick is a millisecond. */
+#pragma once
+
+/* As the ESP-IDF FreeRTOSConfig.h does */
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdTRUE              1
+#define pdFALSE             0
+#define pdPASS              pdTRUE
+#define portMAX_DELAY       ((TickType_t) 0xffffffff)
+#define portTICK_PERIOD_MS  1
+#define pdMS_TO_TICKS(ms)   ((TickType_t) (ms))
+
+typedef struct host_task *TaskHandle_t;
+
+typedef struct {
+    uint64_t start_ms;
+} TimeOut_t;
@@ -0,0 +1,4 @@
+/* Host stand-in for the FreeRTOS queues, not used by the ring buffers */
+#pragma once
+
+#include "FreeRTOS.h"
@@ -0,0 +1,17 @@
+/* Host stand-in for the FreeRTOS semaphores. Mutexes are binary semaphores, the ring buffers do not nest them. */
+#pragma once
+
+#include "FreeRTOS.h"
+
+typedef struct host_sem *SemaphoreHandle_t;
+typedef SemaphoreHandle_t xSemaphoreHandle;
+
+SemaphoreHandle_t host_sem_create(int count);
+void host_sem_delete(SemaphoreHandle_t sem);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks_to_wait);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+
+#define vSemaphoreCreateBinary(sem) ((sem) = host_sem_create(1))
+#define xSemaphoreCreateBinary()    host_sem_create(0)
+#define xSemaphoreCreateMutex()     host_sem_create(1)
+#define vSemaphoreDelete(sem)       host_sem_delete(sem)
@@ -0,0 +1,176 @@
+/*
+ * FreeRTOS task notifications, timeouts and semaphores on pthreads, for the host build of the ring buffers.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+struct host_task {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t notified;
+};
+
+struct host_sem {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t count;
+};
+
+static __thread struct host_task *current_task;
+/* Orders the creation of a task handle before its use by another thread */
+static pthread_mutex_t tasks_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void deadline(struct timespec *ts, TickType_t ticks)
+{
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    uint64_t ns = ts->tv_nsec + (uint64_t) ticks * 1000000;
+    ts->tv_sec += ns / 1000000000;
+    ts->tv_nsec = ns % 1000000000;
+}
+
+static void init_cond(pthread_cond_t *cond)
+{
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+/* Waits on `cond` until `*value` is set or the ticks run out, with `lock` held */
+static void wait_for(pthread_cond_t *cond, pthread_mutex_t *lock, const uint32_t *value, TickType_t ticks)
+{
+    struct timespec ts;
+    deadline(&ts, ticks);
+    while (*value == 0) {
+        if (ticks == portMAX_DELAY) {
+            pthread_cond_wait(cond, lock);
+        } else if (pthread_cond_timedwait(cond, lock, &ts) == ETIMEDOUT) {
+            break;
+        }
+    }
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    if (current_task == NULL) {
+        pthread_mutex_lock(&tasks_lock);
+        current_task = calloc(1, sizeof(*current_task));
+        pthread_mutex_init(&current_task->lock, NULL);
+        init_cond(&current_task->cond);
+        pthread_mutex_unlock(&tasks_lock);
+    }
+    return current_task;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    usleep(ticks * 1000);
+}
+
+void vTaskSetTimeOutState(TimeOut_t *timeout)
+{
+    timeout->start_ms = now_ms();
+}
+
+BaseType_t xTaskCheckForTimeOut(TimeOut_t *timeout, TickType_t *ticks_to_wait)
+{
+    if (*ticks_to_wait == portMAX_DELAY) {
+        return pdFALSE;
+    }
+    uint64_t now = now_ms();
+    uint64_t elapsed = now - timeout->start_ms;
+    if (elapsed >= *ticks_to_wait) {
+        *ticks_to_wait = 0;
+        return pdTRUE;
+    }
+    *ticks_to_wait -= elapsed;
+    timeout->start_ms = now;
+    return pdFALSE;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait)
+{
+    struct host_task *task = xTaskGetCurrentTaskHandle();
+
+    pthread_mutex_lock(&task->lock);
+    wait_for(&task->cond, &task->lock, &task->notified, ticks_to_wait);
+    uint32_t value = task->notified;
+    if (clear_on_exit) {
+        task->notified = 0;
+    } else if (value) {
+        task->notified--;
+    }
+    pthread_mutex_unlock(&task->lock);
+    return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+#ifdef __SANITIZE_THREAD__
+    /* spsc_rb hands the handle over with fences, which ThreadSanitizer does not follow */
+    pthread_mutex_lock(&tasks_lock);
+    pthread_mutex_unlock(&tasks_lock);
+#endif
+
+    pthread_mutex_lock(&task->lock);
+    task->notified++;
+    pthread_cond_signal(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+    return pdPASS;
+}
+
+SemaphoreHandle_t host_sem_create(int count)
+{
+    struct host_sem *sem = calloc(1, sizeof(*sem));
+    if (sem) {
+        pthread_mutex_init(&sem->lock, NULL);
+        init_cond(&sem->cond);
+        sem->count = count;
+    }
+    return sem;
+}
+
+void host_sem_delete(SemaphoreHandle_t sem)
+{
+    pthread_mutex_destroy(&sem->lock);
+    pthread_cond_destroy(&sem->cond);
+    free(sem);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks_to_wait)
+{
+    pthread_mutex_lock(&sem->lock);
+    wait_for(&sem->cond, &sem->lock, &sem->count, ticks_to_wait);
+    BaseType_t taken = sem->count > 0;
+    if (taken) {
+        sem->count--;
+    }
+    pthread_mutex_unlock(&sem->lock);
+    return taken ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    pthread_mutex_lock(&sem->lock);
+    /* Binary: giving a given semaphore fails, as in FreeRTOS */
+    BaseType_t given = sem->count == 0;
+    sem->count = 1;
+    pthread_cond_signal(&sem->cond);
+    pthread_mutex_unlock(&sem->lock);
+    return given ? pdTRUE : pdFALSE;
+}
@@ -0,0 +1,434 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Stress test of the SPSC ring buffer and a throughput benchmark against the basic ring buffer.
+ * Both are used through the abstract ring buffer, as basic_player does. A writer and a reader
+ * thread move a byte pattern through the ring in random chunks and the reader checks every byte.
+ * The in-place acquire/release API of the basic and special ring buffers is checked the same way.
+ */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <esp_err.h>
+#include <abstract_rb.h>
+#include <basic_rb.h>
+#include <special_rb.h>
+#include <esp_timer.h>
+
+#define STRESS_BYTES    (50 * 1024 * 1024)
+#define BENCH_BYTES     (64 * 1024 * 1024)
+#define MAX_CHUNK       4096
+
+typedef struct {
+    rb_handle_t rb;
+    long bytes;
+    int max_chunk;
+    unsigned int seed;
+} stream_t;
+
+static int failed;
+
+static void check(bool ok, const char *what)
+{
+    printf("%-60s %s\n", what, ok ? "ok" : "FAILED");
+    failed += !ok;
+}
+
+/* A pattern that does not repeat at any power of two, so a wrong wrap offset shows */
+static inline uint8_t pattern(long pos)
+{
+    return (uint8_t) (pos * 131 + pos / 251);
+}
+
+static int chunk_len(stream_t *s, long pos)
+{
+    int n = rand_r(&s->seed) % s->max_chunk + 1;
+    return n > s->bytes - pos ? s->bytes - pos : n;
+}
+
+static void *writer_task(void *arg)
+{
+    stream_t *s = arg;
+    static uint8_t buf[MAX_CHUNK];
+    long pos = 0;
+
+    while (pos < s->bytes) {
+        int n = chunk_len(s, pos);
+        for (int i = 0; i < n; i++) {
+            buf[i] = pattern(pos + i);
+        }
+        int ret = arb_write(s->rb, buf, n, portMAX_DELAY);
+        if (ret != n) {
+            printf("write of %d returned %d at %ld\n", n, ret, pos);
+            break;
+        }
+        pos += n;
+    }
+    arb_signal_writer_finished(s->rb);
+    return NULL;
+}
+
+/* Returns the bytes received in order, or -1 on the first wrong byte */
+static long run_stream(rb_handle_t rb, long bytes, int max_chunk, bool verify, double *mb_per_s)
+{
+    stream_t s = { .rb = rb, .bytes = bytes, .max_chunk = max_chunk, .seed = 1 };
+    unsigned int seed = 2;
+    uint8_t buf[MAX_CHUNK];
+    pthread_t writer;
+    long pos = 0;
+
+    int64_t start = esp_timer_get_time();
+    pthread_create(&writer, NULL, writer_task, &s);
+    while (1) {
+        int ret = arb_read(rb, buf, rand_r(&seed) % max_chunk + 1, portMAX_DELAY);
+        if (ret == RB_WRITER_FINISHED) {
+            break;
+        }
+        if (ret <= 0) {
+            printf("read returned %d at %ld\n", ret, pos);
+            break;
+        }
+        for (int i = 0; verify && i < ret; i++) {
+            if (buf[i] != pattern(pos + i)) {
+                printf("byte %ld is %d, expected %d\n", pos + i, buf[i], pattern(pos + i));
+                pthread_join(writer, NULL);
+                return -1;
+            }
+        }
+        pos += ret;
+    }
+    pthread_join(writer, NULL);
+    if (mb_per_s) {
+        *mb_per_s = pos / ((esp_timer_get_time() - start) / 1e6) / (1024 * 1024);
+    }
+    return pos;
+}
+
+static void *wakeup_task(void *arg)
+{
+    vTaskDelay(pdMS_TO_TICKS(20));
+    arb_wakeup_reader(arg);
+    return NULL;
+}
+
+static void *abort_task(void *arg)
+{
+    vTaskDelay(pdMS_TO_TICKS(20));
+    arb_abort(arg);
+    return NULL;
+}
+
+static void check_spsc(void)
+{
+    abstract_rb_cfg_t cfg = DEFAULT_RB_TYPE_SPSC_FUNC();
+    uint8_t buf[64] = { 0 };
+    pthread_t thread;
+    rb_handle_t rb;
+
+    rb = arb_init("stress", 3000, cfg);
+    check(rb && arb_get_available(rb) == 4096, "size is rounded up to a power of two");
+    check(run_stream(rb, STRESS_BYTES, MAX_CHUNK, true, NULL) == STRESS_BYTES, "50 MB in random chunks arrive in order");
+    arb_deinit(rb);
+
+    /* Smaller than the chunks, both sides block on nearly every call */
+    rb = arb_init("tiny", 64, cfg);
+    check(run_stream(rb, 4 * 1024 * 1024, 200, true, NULL) == 4 * 1024 * 1024, "4 MB through a 64 byte ring");
+
+    arb_reset(rb);
+    int64_t start = esp_timer_get_time();
+    int ret = arb_read(rb, buf, sizeof(buf), pdMS_TO_TICKS(10));
+    int64_t waited = esp_timer_get_time() - start;
+    check(ret == 0 && waited >= 9000, "read of an empty ring times out");
+
+    arb_write(rb, buf, 10, 0);
+    check(arb_read(rb, buf, sizeof(buf), pdMS_TO_TICKS(10)) == 10, "read times out with what it has");
+
+    arb_write(rb, buf, 64, 0);
+    check(arb_write(rb, buf, 1, pdMS_TO_TICKS(10)) == 0, "write to a full ring times out");
+    arb_reset(rb);
+
+    pthread_create(&thread, NULL, wakeup_task, rb);
+    check(arb_read(rb, buf, sizeof(buf), portMAX_DELAY) == RB_READER_UNBLOCK, "blocked reader is woken up");
+    pthread_join(thread, NULL);
+
+    arb_write(rb, buf, 5, 0);
+    arb_signal_writer_finished(rb);
+    check(arb_read(rb, buf, sizeof(buf), portMAX_DELAY) == 5, "finished writer's data is drained first");
+    check(arb_read(rb, buf, sizeof(buf), portMAX_DELAY) == RB_WRITER_FINISHED, "then the reader sees it finished");
+    arb_reset(rb);
+
+    pthread_create(&thread, NULL, abort_task, rb);
+    check(arb_read(rb, buf, sizeof(buf), portMAX_DELAY) == RB_ABORT, "blocked reader is aborted");
+    pthread_join(thread, NULL);
+    arb_reset(rb);
+
+    arb_write(rb, buf, 64, 0);
+    pthread_create(&thread, NULL, abort_task, rb);
+    check(arb_write(rb, buf, 1, portMAX_DELAY) == 0, "blocked writer is aborted");
+    pthread_join(thread, NULL);
+    check(arb_read(rb, buf, 1, 0) == RB_FAIL && arb_write(rb, buf, 1, 0) == RB_FAIL, "aborted ring fails until reset");
+    arb_deinit(rb);
+}
+
+/* Copies what the region describes, the wrapped part after the first */
+static void region_copy_out(const rb_region_t *region, uint8_t *buf)
+{
+    memcpy(buf, region->ptr, region->len);
+    if (region->wrap_len) {
+        memcpy(buf + region->len, region->wrap_ptr, region->wrap_len);
+    }
+}
+
+static void region_copy_in(const rb_region_t *region, const uint8_t *buf)
+{
+    memcpy(region->ptr, buf, region->len);
+    if (region->wrap_len) {
+        memcpy(region->wrap_ptr, buf + region->len, region->wrap_len);
+    }
+}
+
+static bool is_pattern(const uint8_t *buf, long pos, int len)
+{
+    for (int i = 0; i < len; i++) {
+        if (buf[i] != pattern(pos + i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Same as writer_task, but fills acquired space in place and commits a random part of it */
+static void *in_place_writer_task(void *arg)
+{
+    stream_t *s = arg;
+    static uint8_t buf[MAX_CHUNK];
+    rb_region_t region;
+    long pos = 0;
+
+    while (pos < s->bytes) {
+        int ret = arb_acquire_write(s->rb, &region, chunk_len(s, pos), portMAX_DELAY);
+        if (ret <= 0) {
+            printf("acquire_write returned %d at %ld\n", ret, pos);
+            break;
+        }
+        int n = rand_r(&s->seed) % ret + 1;
+        for (int i = 0; i < ret; i++) {
+            buf[i] = pattern(pos + i);
+        }
+        region_copy_in(&region, buf);
+        pos += arb_commit_write(s->rb, n);
+    }
+    arb_signal_writer_finished(s->rb);
+    return NULL;
+}
+
+/* Returns the bytes received in order through acquire/release, or -1 on the first wrong byte */
+static long run_in_place_stream(rb_handle_t rb, long bytes, int max_chunk)
+{
+    stream_t s = { .rb = rb, .bytes = bytes, .max_chunk = max_chunk, .seed = 3 };
+    unsigned int seed = 4;
+    uint8_t buf[MAX_CHUNK];
+    rb_region_t region;
+    pthread_t writer;
+    long pos = 0;
+
+    pthread_create(&writer, NULL, in_place_writer_task, &s);
+    while (1) {
+        int ret = arb_acquire_read(rb, &region, rand_r(&seed) % max_chunk + 1, portMAX_DELAY);
+        if (ret == RB_WRITER_FINISHED) {
+            break;
+        }
+        if (ret <= 0 || region.len + region.wrap_len != ret) {
+            printf("acquire_read returned %d at %ld\n", ret, pos);
+            break;
+        }
+        region_copy_out(&region, buf);
+        if (!is_pattern(buf, pos, ret)) {
+            printf("bytes from %ld are wrong\n", pos);
+            arb_release_read(rb, ret);
+            pthread_join(writer, NULL);
+            return -1;
+        }
+        pos += arb_release_read(rb, rand_r(&seed) % ret + 1);
+    }
+    pthread_join(writer, NULL);
+    return pos;
+}
+
+static void check_basic_in_place(void)
+{
+    uint8_t buf[16];
+    rb_region_t region;
+    int ret;
+
+    rb_handle_t rb = rb_init("in place", 16);
+    for (int i = 0; i < 10; i++) {
+        buf[i] = pattern(i);
+    }
+    rb_write(rb, buf, 10, 0);
+    rb_read(rb, buf, 6, 0);
+
+    /* Free space runs from offset 10 to the end and on from the start up to offset 6 */
+    ret = rb_acquire_write(rb, &region, 16, 0);
+    check(ret == 12 && region.len == 6 && region.wrap_len == 6 && region.wrap_ptr + 10 == region.ptr,
+          "acquire_write splits the free space at the wrap");
+    check(rb_filled(rb) == 4, "acquired space is not visible before the commit");
+    for (int i = 0; i < 12; i++) {
+        buf[i] = pattern(10 + i);
+    }
+    region_copy_in(&region, buf);
+    check(rb_commit_write(rb, 12) == 12 && rb_filled(rb) == 16, "commit across the wrap");
+
+    ret = rb_acquire_read(rb, &region, 16, 0);
+    region_copy_out(&region, buf);
+    check(ret == 16 && region.len == 10 && region.wrap_len == 6 && is_pattern(buf, 6, 16),
+          "acquire_read splits the data at the wrap");
+    check(rb_release_read(rb, 5) == 5 && rb_filled(rb) == 11 && rb_available(rb) == 5,
+          "partial release keeps the rest");
+
+    ret = rb_acquire_read(rb, &region, 4, 0);
+    check(ret == 4 && region.wrap_len == 0 && is_pattern(region.ptr, 11, 4), "next acquire starts after the release");
+    check(rb_release_read(rb, 100) == 4, "release is capped to what was acquired");
+    check(rb_release_read(rb, 1) == 0, "release without acquire does nothing");
+
+    rb_acquire_read(rb, &region, 4, 0);
+    rb_reset(rb);
+    check(rb_release_read(rb, 4) == 0 && rb_filled(rb) == 0, "release after a reset does nothing");
+
+    int64_t start = esp_timer_get_time();
+    ret = rb_acquire_read(rb, &region, 4, pdMS_TO_TICKS(10));
+    check(ret == 0 && esp_timer_get_time() - start >= 9000, "acquire_read of an empty ring times out");
+
+    rb_write(rb, buf, 3, 0);
+    rb_signal_writer_finished(rb);
+    check(rb_acquire_read(rb, &region, 8, portMAX_DELAY) == 3, "finished writer's data is acquired short");
+    rb_release_read(rb, 3);
+    check(rb_acquire_read(rb, &region, 8, portMAX_DELAY) == RB_WRITER_FINISHED, "then the reader sees it finished");
+    rb_cleanup(rb);
+}
+
+static void check_special_in_place(void)
+{
+    static int marker;
+    uint8_t buf[16];
+    rb_region_t region;
+    rb_anchor_t anchor = { .offset = 5, .data = &marker };
+    int ret;
+
+    rb_handle_t rb = srb_init("anchors", 16);
+    for (int i = 0; i < 8; i++) {
+        buf[i] = pattern(i);
+    }
+    srb_write(rb, buf, 8, 0);
+    srb_put_anchor(rb, &anchor);
+
+    ret = srb_acquire_read(rb, &region, 8, 0);
+    check(ret == 5 && is_pattern(region.ptr, 0, 5), "srb_acquire_read stops at the anchor");
+    check(srb_release_read(rb, 5) == 5 && srb_get_read_offset(rb) == 5, "srb_release_read moves the read offset");
+    check(srb_acquire_read(rb, &region, 8, 0) == RB_FETCH_ANCHOR, "anchor is fetched before the data after it");
+    anchor.data = NULL;
+    check(srb_get_anchor(rb, &anchor) == 0 && anchor.data == &marker, "anchor is returned");
+
+    ret = srb_acquire_read(rb, &region, 8, 0);
+    check(ret == 3 && srb_release_read(rb, 2) == 2 && srb_get_read_offset(rb) == 7, "partial srb_release_read");
+    ret = srb_acquire_read(rb, &region, 8, 0);
+    check(ret == 1 && region.ptr[0] == pattern(7), "next srb_acquire_read starts after the release");
+    srb_release_read(rb, ret);
+    check(srb_release_read(rb, 1) == 0, "srb_release_read without acquire does nothing");
+
+    /* Both offsets are at 8, half way through the buffer */
+    ret = srb_acquire_write(rb, &region, 12, 0);
+    check(ret == 12 && region.len == 8 && region.wrap_len == 4, "srb_acquire_write splits the free space at the wrap");
+    for (int i = 0; i < 12; i++) {
+        buf[i] = pattern(8 + i);
+    }
+    region_copy_in(&region, buf);
+    check(srb_commit_write(rb, 12) == 12 && srb_get_write_offset(rb) == 20, "srb_commit_write across the wrap");
+
+    ret = srb_acquire_read(rb, &region, 12, 0);
+    region_copy_out(&region, buf);
+    check(ret == 12 && region.wrap_len == 4 && is_pattern(buf, 8, 12), "srb_acquire_read across the wrap");
+    srb_release_read(rb, ret);
+    check(srb_get_read_offset(rb) == 20 && srb_get_filled(rb) == 0, "everything written was read");
+}
+
+static void check_arb_in_place(void)
+{
+    abstract_rb_cfg_t types[] = { DEFAULT_RB_TYPE_BASIC_FUNC(), DEFAULT_RB_TYPE_SPECIAL_FUNC() };
+    const char *names[] = { "basic", "special" };
+    char what[64];
+    rb_region_t region;
+
+    for (int t = 0; t < 2; t++) {
+        rb_handle_t rb = arb_init(names[t], 64, types[t]);
+        snprintf(what, sizeof(what), "%s: 4 MB in place through a 64 byte ring", names[t]);
+        check(run_in_place_stream(rb, 4 * 1024 * 1024, 200) == 4 * 1024 * 1024, what);
+        if (t == 0) {
+            arb_deinit(rb);
+        }
+    }
+
+    abstract_rb_cfg_t cfg = DEFAULT_RB_TYPE_SPSC_FUNC();
+    rb_handle_t rb = arb_init("spsc", 64, cfg);
+    check(arb_acquire_read(rb, &region, 8, 0) == 0 && arb_acquire_write(rb, &region, 8, 0) == 0,
+          "spsc has no in-place API");
+    arb_deinit(rb);
+}
+
+int main(int argc, char **argv)
+{
+    check_spsc();
+    check_basic_in_place();
+    check_special_in_place();
+    check_arb_in_place();
+
+    abstract_rb_cfg_t types[] = { DEFAULT_RB_TYPE_BASIC_FUNC(), DEFAULT_RB_TYPE_SPSC_FUNC() };
+    const char *names[] = { "basic", "spsc" };
+    int chunks[] = { 32, 512, 4096 };
+
+    printf("\n%d MB through a 32 KB ring, random chunks up to\n", BENCH_BYTES / (1024 * 1024));
+    printf("%-8s %12s %12s %12s\n", "type", "32 B", "512 B", "4096 B");
+    for (int t = 0; t < 2; t++) {
+        printf("%-8s", names[t]);
+        for (int c = 0; c < 3; c++) {
+            double mb_per_s = 0;
+            rb_handle_t rb = arb_init(names[t], 32 * 1024, types[t]);
+            long received = run_stream(rb, BENCH_BYTES, chunks[c], false, &mb_per_s);
+            arb_deinit(rb);
+            printf(" %7.0f MB/s", mb_per_s);
+            failed += received != BENCH_BYTES;
+        }
+        printf("\n");
+    }
+
+    printf(failed ? "%d checks failed\n" : "All checks passed\n", failed);
+    return failed ? 1 : 0;
+}
@@ -5,6 +5,7 @@
 
 #pragma once
 #include "stdint.h"
+#include "stdbool.h"
 
 #define AXP192_DC_VOLT_STEP  25
 #define AXP192_DC_VOLT_MIN   700
@@ -55,10 +56,15 @@
 #define AXP192_VBUS_ADC_VOLTAGE_REG         0x5A
 #define AXP192_VBUS_ADC_CURRENT_REG         0x5C
 
+#define AXP192_INTERNAL_TEMP_REG            0x5E
+
 #define AXP192_BAT_ADC_VOLTAGE_REG          0x78
 #define AXP192_BAT_ADC_CURRENT_IN_REG       0x7A
 #define AXP192_BAT_ADC_CURRENT_OUT_REG      0x7C
 
+/* The ADCs sample at 25Hz unless changed in register 0x84 */
+#define AXP192_ADC_PERIOD_MS                40
+
 #define AXP192_GPIO0_CTL_REG                0x90                   
 #define AXP192_GPIO0_VOLT_REG               0x91                   
 #define AXP192_GPIO1_CTL_REG                0x92                   
@@ -143,6 +149,21 @@ typedef enum {
 } Axp192_PoweroffTime_t;
 /* @[declare_axp192_powerofftime] */
 
+/**
+ * @brief Snapshot of the AXP192 measurements, read from the ADCs in one I2C transaction.
+ */
+/* @[declare_axp192_telemetry] */
+typedef struct {
+    float bat_volt;     /**< @brief Battery voltage in volts. */
+    float bat_current;  /**< @brief Battery current in milliamps, positive when charging. */
+    float vbus_volt;    /**< @brief USB voltage in volts. */
+    float vbus_current; /**< @brief USB current in milliamps. */
+    float acin_volt;    /**< @brief ACIN voltage in volts. */
+    float acin_current; /**< @brief ACIN current in milliamps. */
+    float temp;         /**< @brief Internal temperature of the AXP192 in Celsius. */
+} Axp192_Telemetry_t;
+/* @[declare_axp192_telemetry] */
+
 /**
  * @brief Initializes the AXP192 over I2C.
  * 
@@ -152,6 +173,76 @@ typedef enum {
 void Axp192_Init();
 /* @[declare_axp192_init] */
 
+/**
+ * @brief Starts a group of register updates sent to the AXP192 
+ * together.
+ * 
+ * The AXP192 driver keeps a copy of the control registers, so 
+ * changing some bits of a register needs no read. Between 
+ * Axp192_BeginUpdate() and Axp192_EndUpdate() the updates are only 
+ * made to that copy, and Axp192_EndUpdate() writes all of the 
+ * changed registers in one I2C transaction. Other tasks wait for 
+ * the AXP192 until Axp192_EndUpdate() is called. Updates can be 
+ * nested.
+ * 
+ * **Example:**
+ * 
+ * Set the voltage of LDO 3 and turn it on in one transaction.
+ * @code{c}
+ *  Axp192_BeginUpdate();
+ *  Axp192_SetLDO3Volt(2000);
+ *  Axp192_EnableLDO3(1);
+ *  Axp192_EndUpdate();
+ * @endcode
+ */
+/* @[declare_axp192_beginupdate] */
+void Axp192_BeginUpdate();
+/* @[declare_axp192_beginupdate] */
+
+/**
+ * @brief Writes the register updates made since 
+ * Axp192_BeginUpdate() to the AXP192.
+ */
+/* @[declare_axp192_endupdate] */
+void Axp192_EndUpdate();
+/* @[declare_axp192_endupdate] */
+
+/**
+ * @brief Retrieves the number of I2C reads and writes made to the 
+ * AXP192 since it was initialized.
+ * 
+ * @param[out] reads Number of reads.
+ * @param[out] writes Number of writes.
+ */
+/* @[declare_axp192_geti2cstats] */
+void Axp192_GetI2CStats(uint32_t *reads, uint32_t *writes);
+/* @[declare_axp192_geti2cstats] */
+
+/**
+ * @brief Retrieves the battery, USB and temperature measurements 
+ * of the AXP192.
+ * 
+ * All the measurements are read in one I2C transaction and kept. 
+ * They are read again only once they are older than `max_age_ms`.
+ * 
+ * **Example:**
+ * 
+ * Get measurements at most one second old.
+ * @code{c}
+ *  Axp192_Telemetry_t telemetry;
+ *  Axp192_GetTelemetry(&telemetry, 1000);
+ *  printf("Battery: %0.2fV %0.1fmA", telemetry.bat_volt, telemetry.bat_current);
+ * @endcode
+ * 
+ * @param[out] telemetry The measurements.
+ * @param[in] max_age_ms The oldest measurements that may be 
+ * returned, in milliseconds. The ADCs update every 
+ * @ref AXP192_ADC_PERIOD_MS.
+ */
+/* @[declare_axp192_gettelemetry] */
+void Axp192_GetTelemetry(Axp192_Telemetry_t *telemetry, uint32_t max_age_ms);
+/* @[declare_axp192_gettelemetry] */
+
 /**
  * @brief Extends the DC voltage range of the Low-Dropout
  * regulator (LDO) on the AXP192.
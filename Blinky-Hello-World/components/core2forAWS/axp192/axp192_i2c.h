@@ -5,11 +5,22 @@ extern "C" {
 #endif
 
 #include "stdint.h"
+#include "stdbool.h"
 void Axp192_I2CInit();
 
-void Axp192_WriteBytes(uint8_t reg_addr, uint8_t *data, uint16_t length);
+/*
+    Writes between Axp192_I2CBeginBatch() and Axp192_I2CEndBatch() only update the shadow,
+    Axp192_I2CEndBatch() sends them all in one I2C transaction. Batches can be nested.
+*/
+void Axp192_I2CBeginBatch();
 
-void Axp192_ReadBytes(uint8_t reg_addr, uint8_t *data, uint16_t length);
+void Axp192_I2CEndBatch();
+
+void Axp192_I2CGetStats(uint32_t *reads, uint32_t *writes);
+
+bool Axp192_WriteBytes(uint8_t reg_addr, uint8_t *data, uint16_t length);
+
+bool Axp192_ReadBytes(uint8_t reg_addr, uint8_t *data, uint16_t length);
 
 void Axp192_Write8Bit(uint8_t reg_addr, uint8_t value);
 
@@ -30,4 +41,4 @@ uint32_t Axp192_Read32Bit(uint8_t reg_addr);
 
 #ifdef __cplusplus
 }
-#endif
\ No newline at end of file
+#endif
@@ -10,6 +10,7 @@ static I2CDevice_t bm8563_device;
 
 static void I2CInit() {
     bm8563_device = i2c_malloc_device(I2C_NUM_1, 21, 22, 400000, BM8563_ADDR);
+    i2c_device_set_priority(bm8563_device, I2C_DEVICE_PRIORITY_LOW);
 }
 
 static void I2CWrite(uint8_t addr, uint8_t* buf, uint8_t len) {
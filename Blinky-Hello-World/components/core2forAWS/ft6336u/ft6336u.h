@@ -5,6 +5,68 @@
 
 #pragma once
 
+#include "stdint.h"
+#include "stdbool.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/**
+ * @brief Number of touch points the FT6336U reports.
+ */
+#define FT6336U_MAX_POINTS 2
+
+/**
+ * @brief Number of touch events each subscriber can hold before new 
+ * ones are dropped.
+ */
+#define FT6336U_EVENT_QUEUE_LEN 64
+
+/**
+ * @brief Number of event queues FT6336U_Subscribe() can hand out.
+ */
+#define FT6336U_MAX_SUBSCRIBERS 4
+
+/**
+ * @brief List of touch events.
+ */
+/* @[declare_ft6336_eventtype_t] */
+typedef enum {
+    FT6336U_EVENT_DOWN = 0,     /**< @brief A finger touched the screen. */
+    FT6336U_EVENT_MOVE,         /**< @brief A finger on the screen moved. */
+    FT6336U_EVENT_UP,           /**< @brief A finger left the screen, at the last position it was seen. */
+} FT6336U_EventType_t;
+/* @[declare_ft6336_eventtype_t] */
+
+/**
+ * @brief A touch event.
+ */
+/* @[declare_ft6336_event_t] */
+typedef struct {
+    FT6336U_EventType_t type;   /**< @brief What happened. */
+    uint8_t id;                 /**< @brief Touch point ID given by the FT6336U, 0 or 1. */
+    bool primary;               /**< @brief The point is the first finger down, the one reported by FT6336U_GetTouch(). */
+    uint16_t x;                 /**< @brief X-coordinate of the touch point. */
+    uint16_t y;                 /**< @brief Y-coordinate of the touch point. */
+    int64_t timestamp_us;       /**< @brief Time of the FT6336U interrupt, from esp_timer_get_time(). */
+} FT6336U_Event_t;
+/* @[declare_ft6336_event_t] */
+
+/**
+ * @brief Queue of touch events for one subscriber.
+ * 
+ * Lock free, the FT6336U task adds events and one task of the 
+ * subscriber takes them with FT6336U_GetEvent().
+ */
+/* @[declare_ft6336_eventqueue_t] */
+typedef struct {
+    FT6336U_Event_t events[FT6336U_EVENT_QUEUE_LEN];
+    uint32_t head;              /**< @brief Events added, written by the FT6336U task. */
+    uint32_t tail;              /**< @brief Events taken, written by the subscriber. */
+    uint32_t dropped;           /**< @brief Events dropped because the queue was full. */
+    TaskHandle_t notify;        /**< @brief Task notified for each event, or NULL. */
+} FT6336U_EventQueue_t;
+/* @[declare_ft6336_eventqueue_t] */
+
 /**
  * @brief Initializes the FT6336U over I2C.
  * 
@@ -13,14 +75,13 @@
  * @note It creates a FreeRTOS task with the task name `FT6336Task` and installs
  * an ISR on the interrupt pin FT6336U_INTR_PIN.
  *
- * The most recent button press state is stored within the library and can
+ * The most recent touch state is stored within the library and can
  * be queried using the functions provided by this library.
  *
- * The FreeRTOS task remains suspended and only resumes when the screen is
- * pressed (which is informed by the FT6336U using the interrupt on the
- * FT6336U_INTR_PIN). If multiple press events are stashed by the hardware, the
- * FreeRTOS task keeps retrieving them one by one at an interval of 20 ticks.
- * Once all the events are retrieved, the task suspends itself.
+ * The FT6336U pulses the interrupt pin for every new touch report. The
+ * FreeRTOS task sleeps until then, reads both touch points in one I2C
+ * transaction and adds the down, move and up events to the queue of each
+ * subscriber. Nothing is polled while the screen is not touched.
  */
 /* @[declare_ft6336_init] */
 void FT6336U_Init();
@@ -76,3 +137,46 @@ uint16_t FT6336U_GetPressPosX();
 /* @[declare_ft6336_getpressposy] */
 uint16_t FT6336U_GetPressPosY();
 /* @[declare_ft6336_getpressposy] */
+
+/**
+ * @brief Creates a queue which receives every following touch event.
+ * 
+ * Can be called before FT6336U_Init(). Each queue must be read by 
+ * one task only.
+ * 
+ * **Example:**
+ * 
+ * Print every touch of the screen.
+ * @code{c}
+ *  FT6336U_EventQueue_t *queue = FT6336U_Subscribe(xTaskGetCurrentTaskHandle());
+ *  FT6336U_Event_t event;
+ * 
+ *  for (;;) {
+ *      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+ *      while (FT6336U_GetEvent(queue, &event)) {
+ *          if (event.type == FT6336U_EVENT_DOWN) {
+ *              printf("Touch at X: %d, Y: %d", event.x, event.y);
+ *          }
+ *      }
+ *  }
+ * @endcode
+ * 
+ * @param[in] notify The task to notify with xTaskNotifyGive() for 
+ * each event, or NULL to read the queue without notifications.
+ * @return The queue, or NULL if there are already 
+ * FT6336U_MAX_SUBSCRIBERS queues.
+ */
+/* @[declare_ft6336_subscribe] */
+FT6336U_EventQueue_t *FT6336U_Subscribe(TaskHandle_t notify);
+/* @[declare_ft6336_subscribe] */
+
+/**
+ * @brief Takes the oldest touch event from a queue.
+ * 
+ * @param[in] queue The queue from FT6336U_Subscribe().
+ * @param[out] event The event.
+ * @return true if there was an event, false if the queue is empty.
+ */
+/* @[declare_ft6336_getevent] */
+bool FT6336U_GetEvent(FT6336U_EventQueue_t *queue, FT6336U_Event_t *event);
+/* @[declare_ft6336_getevent] */
@@ -7,6 +7,8 @@ extern "C" {
 #include "esp_log.h"
 #include "driver/gpio.h"
 #include "driver/i2c.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 
 // Know reg update value
 // #define I2C_DEVICE_DEBUG_REG
@@ -19,6 +21,64 @@ extern "C" {
 
 typedef void * I2CDevice_t;
 
+/*
+    All transfers on a port are run by one manager task, in priority order.
+    Transfers of the same priority run in the order they were submitted.
+*/
+typedef enum {
+    I2C_DEVICE_PRIORITY_LOW = 0,
+    I2C_DEVICE_PRIORITY_NORMAL,
+    I2C_DEVICE_PRIORITY_HIGH,
+    I2C_DEVICE_PRIORITY_MAX,
+} i2c_device_priority_t;
+
+typedef enum {
+    I2C_DEVICE_OP_WRITE = 0,
+    I2C_DEVICE_OP_READ,
+    I2C_DEVICE_OP_READ_NO_STOP,
+    I2C_DEVICE_OP_PROBE,
+} i2c_device_op_t;
+
+typedef struct _i2c_transaction_t I2CTransaction_t;
+
+// Called from the manager task when the transfer is done, keep it short
+typedef void (*i2c_transaction_cb_t)(I2CTransaction_t *trans, esp_err_t err, void *arg);
+
+/*
+    A transfer for i2c_submit(), owned by the caller until the callback is called.
+    device, op, reg_addr, data, length, priority and cb are set by the caller.
+*/
+struct _i2c_transaction_t {
+    I2CDevice_t device;
+    i2c_device_op_t op;
+    uint8_t reg_addr;
+    uint8_t *data;
+    uint16_t length;
+    i2c_device_priority_t priority;
+    i2c_transaction_cb_t cb;
+    void *arg;
+
+    // Used by the manager task
+    int64_t submit_us;
+    SemaphoreHandle_t done;
+    esp_err_t err;
+    I2CTransaction_t *next;
+};
+
+// Transfer latency, submit to done, in buckets of power of 2 microseconds
+#define I2C_LATENCY_BUCKETS (12)
+
+/*
+    latency[0] counts transfers under 128us, latency[i] under 128us << i,
+    the last bucket all from 128us << (I2C_LATENCY_BUCKETS - 2) on.
+*/
+typedef struct {
+    uint32_t count;
+    uint32_t max_us;
+    uint64_t total_us;
+    uint32_t latency[I2C_LATENCY_BUCKETS];
+} i2c_device_stats_t;
+
 I2CDevice_t i2c_malloc_device(i2c_port_t i2c_num, gpio_num_t sda, gpio_num_t scl, uint32_t freq, uint8_t device_addr);
 
 void i2c_free_device(I2CDevice_t i2c_device);
@@ -65,6 +125,30 @@ esp_err_t i2c_write_bits(I2CDevice_t i2c_device, uint8_t reg_addr, uint8_t data,
 
 esp_err_t i2c_device_valid(I2CDevice_t i2c_device);
 
+/*
+    Priority of the blocking read and write functions of the device,
+    I2C_DEVICE_PRIORITY_NORMAL by default.
+*/
+void i2c_device_set_priority(I2CDevice_t i2c_device, i2c_device_priority_t priority);
+
+/*
+    Queues a transfer and returns, trans->cb is called when it is done.
+    Transfers to the same device queued back to back run in one bus hold.
+*/
+esp_err_t i2c_submit(I2CTransaction_t *trans);
+
+void i2c_device_get_stats(I2CDevice_t i2c_device, i2c_device_stats_t *stats);
+
+void i2c_port_reset_stats(i2c_port_t i2c_num);
+
+// Logs the transfer count and latency histogram of every device on the port
+void i2c_port_log_stats(i2c_port_t i2c_num);
+
+/*
+    Holds the port for a sequence of transfers, or for another driver
+    to use it. The blocking read and write functions of the holding
+    task run right away, transfers of other tasks wait.
+*/
 BaseType_t i2c_take_port(i2c_port_t i2c_num, uint32_t timeout);
 
 BaseType_t i2c_free_port(i2c_port_t i2c_num);
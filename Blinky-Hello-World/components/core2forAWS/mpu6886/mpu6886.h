@@ -6,6 +6,7 @@
 #pragma once
 
 #include "stdint.h"
+#include "esp_err.h"
 
 #define MPU6886_ADDRESS           0x68 
 #define MPU6886_WHOAMI            0x75
@@ -38,6 +39,18 @@
 #define MPU6886_ACCEL_CONFIG      0x1C
 #define MPU6886_ACCEL_CONFIG2     0x1D
 #define MPU6886_FIFO_EN           0x23
+#define MPU6886_FIFO_WM_INT_STATUS 0x39
+#define MPU6886_INT_STATUS        0x3A
+#define MPU6886_FIFO_WM_TH1       0x60
+#define MPU6886_FIFO_WM_TH2       0x61
+#define MPU6886_FIFO_COUNTH       0x72
+#define MPU6886_FIFO_COUNTL       0x73
+#define MPU6886_FIFO_R_W          0x74
+
+#define MPU6886_FIFO_SIZE         1024
+/* Accel, temperature and gyro, 2 bytes each, when both sensors are in the FIFO */
+#define MPU6886_FIFO_FRAME_SIZE   14
+#define MPU6886_STREAM_MAX_BATCH  (MPU6886_FIFO_SIZE / MPU6886_FIFO_FRAME_SIZE)
 
 /**
  * @brief List of possible accelerometer scalars in Gs.
@@ -63,6 +76,31 @@ typedef enum {
 } gyro_scale_t;
 /* @[declare_mpu6886_gyro_scale_t] */
 
+/**
+ * @brief One sample read from the MPU6886 FIFO.
+ */
+/* @[declare_mpu6886_sample_t] */
+typedef struct {
+    int64_t timestamp_us;   /**< @brief Time of the sample on the esp_timer clock. */
+    float ax, ay, az;       /**< @brief Acceleration in Gs, as MPU6886_GetAccelData(). */
+    float gx, gy, gz;       /**< @brief Rotation in degrees per second, as MPU6886_GetGyroData(). */
+    float t;                /**< @brief Temperature in Celsius, as MPU6886_GetTempData(). */
+} mpu6886_sample_t;
+/* @[declare_mpu6886_sample_t] */
+
+/**
+ * @brief Called by the stream with each batch of samples read from the FIFO.
+ *
+ * @param[in] samples The samples, oldest first. Only valid until the callback returns.
+ * @param[in] count Number of samples.
+ * @param[in] dropped Estimated number of samples lost after this batch because the FIFO was full.
+ * The samples of such a batch are timestamped on from the previous batch, the gap follows them.
+ * @param[in] arg The argument given to MPU6886_StartStream().
+ */
+/* @[declare_mpu6886_stream_cb_t] */
+typedef void (*mpu6886_stream_cb_t)(const mpu6886_sample_t *samples, uint16_t count, uint32_t dropped, void *arg);
+/* @[declare_mpu6886_stream_cb_t] */
+
 /**
  * @brief Initializes the MPU6886 over I2C.
  * 
@@ -210,3 +248,55 @@ void MPU6886_GetGyroData(float *roll, float *yaw, float *pitch);
 /* @[declare_mpu6886_gettempdata] */
 void MPU6886_GetTempData(float *t);
 /* @[declare_mpu6886_gettempdata] */
+
+/**
+ * @brief Streams accelerometer, gyroscope and temperature samples through
+ * the MPU6886 FIFO.
+ *
+ * The MPU6886 samples at the given rate on its own clock and queues the
+ * samples in its FIFO. A reader task reads all the queued samples in one I2C
+ * transaction once about `batch` samples are in, and hands them to
+ * `callback`. If CONFIG_MPU6886_INT_PIN is set, the reader is woken by the
+ * FIFO watermark interrupt, otherwise it wakes every `batch` sample periods.
+ *
+ * The FIFO holds MPU6886_STREAM_MAX_BATCH samples, so the callback has to
+ * return within about `MPU6886_STREAM_MAX_BATCH - batch` sample periods for
+ * the stream to be gap free. The register reads, like
+ * MPU6886_GetAccelData(), keep working while streaming.
+ *
+ * **Example:**
+ *
+ * Read 1 kHz motion data in batches of 20 samples.
+ * @code{c}
+ *  static void on_motion(const mpu6886_sample_t *samples, uint16_t count, uint32_t dropped, void *arg){
+ *      for (uint16_t i = 0; i < count; i++){
+ *          // samples[i].ax, samples[i].gx, ...
+ *      }
+ *  }
+ *
+ *  MPU6886_StartStream(1000, 20, on_motion, NULL);
+ * @endcode
+ *
+ * @param[in] odr_hz The sample rate, from 4 to 1000 Hz. It is rounded to
+ * 1000 / n Hz.
+ * @param[in] batch Number of samples per callback, from 1 to
+ * MPU6886_STREAM_MAX_BATCH.
+ * @param[in] callback Called with each batch of samples from the reader task.
+ * @param[in] arg Passed to `callback`.
+ *
+ * @return [esp_err_t](https://docs.espressif.com/projects/esp-idf/en/release-v4.2/esp32/api-reference/system/esp_err.html#macros).
+ * 0 or `ESP_OK` if successful, `ESP_ERR_INVALID_STATE` if already streaming.
+ */
+/* @[declare_mpu6886_startstream] */
+esp_err_t MPU6886_StartStream(uint16_t odr_hz, uint16_t batch, mpu6886_stream_cb_t callback, void *arg);
+/* @[declare_mpu6886_startstream] */
+
+/**
+ * @brief Stops the stream started with MPU6886_StartStream().
+ *
+ * Waits for the callback in progress to return. Must not be called from the
+ * callback.
+ */
+/* @[declare_mpu6886_stopstream] */
+void MPU6886_StopStream(void);
+/* @[declare_mpu6886_stopstream] */
@@ -369,7 +369,23 @@ advanced_features = {
   "LV_USE_WIN":1
 }
 
+esp32_gpu = dict(all_obj_all_features)
+esp32_gpu.update({
+  "LV_HOR_RES_MAX":320,
+  "LV_VER_RES_MAX":240,
+  "LV_COLOR_DEPTH":16,
+  "LV_COLOR_16_SWAP":1,
+  "LV_COLOR_SCREEN_TRANSP":0,
+  "LV_USE_GPU":1,
+  "LV_USE_GPU_ESP32":1
+})
+
+esp32_gpu_no_swap = dict(esp32_gpu)
+esp32_gpu_no_swap["LV_COLOR_16_SWAP"] = 0
+
 build("Minimal monochrome", minimal_monochrome)
 build("All objects, minimal features", all_obj_minimal_features)
 build("All objects, all common features", all_obj_all_features)
 build("All objects, with advanced features", advanced_features)
+build("ESP32 GPU kernels, 16 bit swapped", esp32_gpu)
+build("ESP32 GPU kernels, 16 bit", esp32_gpu_no_swap)
@@ -13,6 +13,7 @@
 #include "lv_test_obj.h"
 #include "lv_test_style.h"
 #include "lv_test_font_loader.h"
+#include "lv_test_gpu_esp32.h"
 
 /*********************
  *      DEFINES
@@ -48,6 +49,7 @@ void lv_test_core(void)
     lv_test_obj();
     lv_test_style();
     lv_test_font_loader();
+    lv_test_gpu_esp32();
 }
 
 /**********************
@@ -0,0 +1,60 @@
+/*
+ * Copyright 2010-2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file aws_iot_hash.h
+ * @brief Hash of short byte strings, for internal use by the SDK
+ *
+ * The MQTT subscription index keys topic levels by hash, the shadow records key
+ * JSON keys and client tokens by hash and the shadow reporter compares reported
+ * strings by hash to keep no copy of them.
+ *
+ */
+
+#ifndef AWS_IOT_SDK_SRC_HASH_H_
+#define AWS_IOT_SDK_SRC_HASH_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief 32 bit FNV-1a of a byte string
+ *
+ * @param pData The bytes to hash, need not be NUL terminated
+ * @param length Number of bytes to hash
+ *
+ * @return The hash
+ */
+static inline uint32_t aws_iot_hash_fnv1a(const char *pData, size_t length) {
+	uint32_t hash = 2166136261u;
+	size_t i;
+
+	for(i = 0; i < length; i++) {
+		hash ^= (uint8_t) pData[i];
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AWS_IOT_SDK_SRC_HASH_H_ */
@@ -26,6 +26,8 @@ extern "C" {
  */
 
 #include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
 
 /**
  * @brief This is a static JSON object that could be used in code
@@ -143,6 +145,89 @@ IoT_Error_t aws_iot_finalize_json_document(char *pJsonDocument, size_t maxSizeOf
 
 IoT_Error_t aws_iot_fill_with_client_token(char *pBufferToBeUpdatedWithClientToken, size_t maxSizeOfJsonDocument);
 
+/**
+ * @brief Append-only writer of a Shadow JSON document
+ *
+ * Writes straight into the document buffer and keeps track of where the document ends, so the buffer is never
+ * scanned again and values are formatted by hand instead of through snprintf. Numbers come out the same as with
+ * aws_iot_shadow_add_reported. The document stays null terminated after every call. Once a call fails the following
+ * ones do nothing and return the same error, so the result of aws_iot_shadow_json_writer_finalize is enough to check.
+ *
+ * Use the functions below rather than the fields.
+ */
+typedef struct {
+	char *pBuffer; ///< Document being written
+	size_t bufferSize; ///< Size of pBuffer
+	size_t length; ///< Length of the document written so far
+	uint8_t depth; ///< Number of open objects
+	bool isFirstMember; ///< Nothing was written yet in the innermost open object
+	IoT_Error_t status; ///< SUCCESS or the first error met
+} ShadowJsonWriter_t;
+
+/**
+ * @brief Start a Shadow JSON document with the writer
+ *
+ * Writes {"state":{ like aws_iot_shadow_init_json_document.
+ *
+ * @param pWriter Writer to initialize
+ * @param pJsonDocument The JSON Document filled in this char buffer
+ * @param maxSizeOfJsonDocument maximum size of the pJsonDocument that can be used to fill the JSON document
+ * @return An IoT Error Type defining if the buffer was null or the entire string was not filled up
+ */
+IoT_Error_t aws_iot_shadow_json_writer_init(ShadowJsonWriter_t *pWriter, char *pJsonDocument,
+											size_t maxSizeOfJsonDocument);
+
+/**
+ * @brief Open an object, such as the "reported" or "desired" section, in the current object
+ *
+ * @param pWriter Writer of the document
+ * @param pKey Key of the new object
+ * @return An IoT Error Type defining if the buffer was null or the entire string was not filled up
+ */
+IoT_Error_t aws_iot_shadow_json_writer_begin_object(ShadowJsonWriter_t *pWriter, const char *pKey);
+
+/**
+ * @brief Close the object opened last with aws_iot_shadow_json_writer_begin_object
+ *
+ * @param pWriter Writer of the document
+ * @return An IoT Error Type defining if the buffer was null or the entire string was not filled up
+ */
+IoT_Error_t aws_iot_shadow_json_writer_end_object(ShadowJsonWriter_t *pWriter);
+
+/**
+ * @brief Add the key and value of a jsonStruct_t to the current object
+ *
+ * Strings are escaped, SHADOW_JSON_OBJECT values are copied as they are.
+ *
+ * @param pWriter Writer of the document
+ * @param pStruct Key, type and value to add
+ * @return An IoT Error Type defining if the buffer was null or the entire string was not filled up
+ */
+IoT_Error_t aws_iot_shadow_json_writer_add(ShadowJsonWriter_t *pWriter, const jsonStruct_t *pStruct);
+
+/**
+ * @brief Close the open objects and add the client token, like aws_iot_finalize_json_document
+ *
+ * @param pWriter Writer of the document
+ * @return SUCCESS if the whole document was written, the first error met otherwise
+ */
+IoT_Error_t aws_iot_shadow_json_writer_finalize(ShadowJsonWriter_t *pWriter);
+
+/**
+ * @brief Build a whole update document with a reported section from an array of jsonStruct_t
+ *
+ * Same document as aws_iot_shadow_init_json_document, aws_iot_shadow_add_reported and aws_iot_finalize_json_document
+ * in a row, written in a single pass with ShadowJsonWriter_t. Not limited to 255 values and no variadic arguments.
+ *
+ * @param pStructs Values to report
+ * @param count Number of values in pStructs
+ * @param pJsonDocument The JSON Document filled in this char buffer
+ * @param maxSizeOfJsonDocument maximum size of the pJsonDocument that can be used to fill the JSON document
+ * @return An IoT Error Type defining if the buffer was null or the entire string was not filled up
+ */
+IoT_Error_t aws_iot_shadow_build_reported(const jsonStruct_t *pStructs, size_t count, char *pJsonDocument,
+										  size_t maxSizeOfJsonDocument);
+
 #ifdef __cplusplus
 }
 #endif
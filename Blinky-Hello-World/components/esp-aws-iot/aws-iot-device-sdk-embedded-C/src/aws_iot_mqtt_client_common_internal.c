@@ -363,6 +363,81 @@ IoT_Error_t aws_iot_mqtt_internal_send_packet(AWS_IoT_Client *pClient, size_t le
 	FUNC_EXIT_RC(rc);
 }
 
+/**
+ * @brief Send an MQTT packet made of several buffers on the network
+ *
+ * The buffers are handed to the gather write of the network layer as they are,
+ * so a payload can be sent from the caller's memory without a copy into writeBuf.
+ * Must only be called when the network layer has a writev function.
+ *
+ * @param pClient MQTT client
+ * @param pVector Buffers of the packet in order, updated while the packet is sent
+ * @param count Number of buffers
+ * @param pTimer Amount of time allowed to send packet
+ *
+ * @return IoT_Error_t of send status
+ */
+IoT_Error_t aws_iot_mqtt_internal_send_packet_vector(AWS_IoT_Client *pClient, NetworkIoVec *pVector, size_t count,
+													 Timer *pTimer) {
+
+	size_t sentLen;
+	IoT_Error_t rc = FAILURE;
+
+#ifdef _ENABLE_THREAD_SUPPORT_
+	IoT_Error_t threadRc;
+#endif
+
+	FUNC_ENTRY;
+
+	if(NULL == pClient || NULL == pVector || NULL == pTimer || NULL == pClient->networkStack.writev) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+#ifdef _ENABLE_THREAD_SUPPORT_
+	threadRc = aws_iot_mqtt_client_lock_mutex(pClient, &(pClient->clientData.tls_write_mutex));
+	if(SUCCESS != threadRc) {
+		FUNC_EXIT_RC(threadRc);
+	}
+#endif
+
+	while(0 < count && !has_timer_expired(pTimer)) {
+		sentLen = 0;
+		rc = pClient->networkStack.writev(&(pClient->networkStack), pVector, count, pTimer, &sentLen);
+		if(SUCCESS != rc) {
+			/* there was an error writing the data */
+			break;
+		}
+		/* Drop the buffers sent in full, a partly sent one continues where it stopped */
+		while(0 < count && sentLen >= pVector->len) {
+			sentLen -= pVector->len;
+			pVector++;
+			count--;
+		}
+		if(0 < count) {
+			pVector->pBuffer += sentLen;
+			pVector->len -= sentLen;
+		}
+	}
+
+#ifdef _ENABLE_THREAD_SUPPORT_
+	threadRc = aws_iot_mqtt_client_unlock_mutex(pClient, &(pClient->clientData.tls_write_mutex));
+	if((SUCCESS != threadRc) && ( SUCCESS == rc )) {
+		FUNC_EXIT_RC(threadRc);
+	}
+#endif
+
+	if(0 == count) {
+		FUNC_EXIT_RC(SUCCESS);
+	}
+
+	if(SUCCESS == rc) {
+		/* Timer expired between two writes */
+		rc = NETWORK_SSL_WRITE_TIMEOUT_ERROR;
+	}
+
+	FUNC_EXIT_RC(rc);
+}
+
 static IoT_Error_t _aws_iot_mqtt_internal_readWrapper( AWS_IoT_Client *pClient, size_t offset, size_t size, Timer *pTimer, size_t * read_len ) {
     IoT_Error_t rc;
     int byteToRead;
@@ -423,15 +498,188 @@ static IoT_Error_t _aws_iot_mqtt_internal_decode_packet_remaining_len(AWS_IoT_Cl
 	FUNC_EXIT_RC(rc);
 }
 
+/* Reads the remaining rem_len bytes of a packet that does not fit the read buffer and drops them */
+static IoT_Error_t _aws_iot_mqtt_internal_discard_packet(AWS_IoT_Client *pClient, Timer *pTimer, size_t rem_len) {
+	size_t total_bytes_read, bytes_to_be_read, read_len;
+	IoT_Error_t rc = SUCCESS;
+
+	total_bytes_read = 0;
+	while(total_bytes_read < rem_len && SUCCESS == rc) {
+		bytes_to_be_read = rem_len - total_bytes_read;
+		if(bytes_to_be_read > pClient->clientData.readBufSize) {
+			bytes_to_be_read = pClient->clientData.readBufSize;
+		}
+		read_len = 0;
+		rc = pClient->networkStack.read(&(pClient->networkStack), pClient->clientData.readBuf, bytes_to_be_read,
+										pTimer, &read_len);
+		if(SUCCESS == rc) {
+			total_bytes_read += read_len;
+		}
+	}
+
+	/* Check buffer was correctly emptied, otherwise, return error message. */
+	if(total_bytes_read == rem_len) {
+		aws_iot_mqtt_internal_flushBuffers(pClient);
+		return MQTT_RX_BUFFER_TOO_SHORT_ERROR;
+	}
+
+	return rc;
+}
+
+static void _aws_iot_mqtt_internal_send_puback(AWS_IoT_Client *pClient, uint16_t packetId) {
+	uint32_t len;
+	IoT_Error_t rc;
+	Timer sendTimer;
+
+	/* Initialize timer for sending PUBACK. */
+	init_timer(&sendTimer);
+	countdown_ms(&sendTimer, pClient->clientData.commandTimeoutMs);
+
+	len = 0;
+
+	/* Generate and send a PUBACK. Warn if the PUBACK isn't sent; the server
+	will send the PUBLISH again in that case. */
+	rc = aws_iot_mqtt_internal_serialize_ack(pClient->clientData.writeBuf,
+		pClient->clientData.writeBufSize, PUBACK, 0, packetId, &len);
+
+	if(SUCCESS == rc) {
+		rc = aws_iot_mqtt_internal_send_packet(pClient, len, &sendTimer);
+
+		if(SUCCESS != rc) {
+			IOT_WARN("Failed to send PUBACK");
+		}
+	} else {
+		IOT_WARN("Failed to generate PUBACK");
+	}
+}
+
+/**
+ * @brief Deliver a PUBLISH too large for the read buffer in fragments
+ *
+ * The topic name stays at the start of the read buffer and the rest of it is refilled with
+ * the payload, which is handed piece by piece to the handlers that accept fragments. Other
+ * matching handlers do not see the message. The client state is left as it is while the
+ * handlers run, so they cannot call back into the client in the middle of the packet.
+ *
+ * @param pClient MQTT client
+ * @param pTimer Amount of time allowed to read the packet
+ * @param offset Length of the fixed header, which has been read already
+ * @param rem_len Remaining length of the packet
+ *
+ * @return MQTT_NOTHING_TO_READ once delivered, as there is no packet left for the caller
+ */
+static IoT_Error_t _aws_iot_mqtt_internal_read_publish_fragments(AWS_IoT_Client *pClient, Timer *pTimer,
+																 size_t offset, size_t rem_len) {
+	uint32_t itr;
+	uint32_t matched[(AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS + 31) / 32];
+	bool isAccepted;
+	uint16_t topicNameLen;
+	char *pTopicName;
+	unsigned char *curData;
+	size_t headerLen, read_len, chunkLen;
+	IoT_Publish_Message_Params msg;
+	MQTTHeader header = {0};
+	IoT_Error_t rc;
+
+	FUNC_ENTRY;
+
+	header.byte = pClient->clientData.readBuf[0];
+	msg.isDup = (uint8_t) MQTT_HEADER_FIELD_DUP(header.byte);
+	msg.qos = (QoS) MQTT_HEADER_FIELD_QOS(header.byte);
+	msg.isRetained = (uint8_t) MQTT_HEADER_FIELD_RETAIN(header.byte);
+	msg.id = 0;
+
+	/* Topic name length, topic name, then the packet id for QoS 1 */
+	headerLen = (QOS0 == msg.qos) ? 2 : 4;
+	if(rem_len < headerLen || (offset + 2) >= pClient->clientData.readBufSize) {
+		FUNC_EXIT_RC(_aws_iot_mqtt_internal_discard_packet(pClient, pTimer, rem_len));
+	}
+
+	rc = _aws_iot_mqtt_internal_readWrapper(pClient, offset, 2, pTimer, &read_len);
+	if(SUCCESS != rc || 2 != read_len) {
+		FUNC_EXIT_RC(FAILURE);
+	}
+	curData = pClient->clientData.readBuf + offset;
+	topicNameLen = aws_iot_mqtt_internal_read_uint16_t(&curData);
+	headerLen += topicNameLen;
+	if(rem_len < headerLen || (offset + headerLen) >= pClient->clientData.readBufSize) {
+		FUNC_EXIT_RC(_aws_iot_mqtt_internal_discard_packet(pClient, pTimer, rem_len - 2));
+	}
+
+	rc = _aws_iot_mqtt_internal_readWrapper(pClient, offset + 2, headerLen - 2, pTimer, &read_len);
+	if(SUCCESS != rc || (headerLen - 2) != read_len) {
+		FUNC_EXIT_RC(FAILURE);
+	}
+	pTopicName = (char *) curData;
+	curData += topicNameLen;
+	if(QOS0 != msg.qos) {
+		msg.id = aws_iot_mqtt_internal_read_uint16_t(&curData);
+	}
+
+	/* Only the handlers that asked for fragments get them */
+	memset(matched, 0, sizeof(matched));
+	aws_iot_mqtt_internal_subscription_index_match(&(pClient->clientData.subscriptionIndex), pTopicName, topicNameLen,
+												   matched);
+	isAccepted = false;
+	for(itr = 0; itr < AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS; ++itr) {
+		if(0 != (matched[itr / 32] & (1u << (itr % 32)))) {
+			if(pClient->clientData.messageHandlers[itr].acceptsFragments &&
+			   aws_iot_mqtt_internal_is_handler_matched(&(pClient->clientData.messageHandlers[itr]), pTopicName,
+														topicNameLen)) {
+				isAccepted = true;
+			} else {
+				matched[itr / 32] &= ~(1u << (itr % 32));
+			}
+		}
+	}
+	if(!isAccepted) {
+		FUNC_EXIT_RC(_aws_iot_mqtt_internal_discard_packet(pClient, pTimer, rem_len - headerLen));
+	}
+
+	msg.payload = pClient->clientData.readBuf + offset + headerLen;
+	msg.payloadOffset = 0;
+	msg.totalPayloadLen = rem_len - headerLen;
+	while(msg.payloadOffset < msg.totalPayloadLen) {
+		chunkLen = msg.totalPayloadLen - msg.payloadOffset;
+		if(chunkLen > pClient->clientData.readBufSize - offset - headerLen) {
+			chunkLen = pClient->clientData.readBufSize - offset - headerLen;
+		}
+		read_len = 0;
+		rc = pClient->networkStack.read(&(pClient->networkStack), (unsigned char *) msg.payload, chunkLen, pTimer,
+										&read_len);
+		if(0 == read_len) {
+			/* Out of step with the packet boundary now, as when dropping a message */
+			FUNC_EXIT_RC((SUCCESS == rc) ? FAILURE : rc);
+		}
+
+		msg.payloadLen = read_len;
+		for(itr = 0; itr < AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS; ++itr) {
+			if(0 != (matched[itr / 32] & (1u << (itr % 32))) &&
+			   NULL != pClient->clientData.messageHandlers[itr].pApplicationHandler) {
+				pClient->clientData.messageHandlers[itr].pApplicationHandler(pClient, pTopicName, topicNameLen, &msg,
+																			 pClient->clientData.messageHandlers[itr].pApplicationHandlerData);
+			}
+		}
+		msg.payloadOffset += read_len;
+	}
+
+	aws_iot_mqtt_internal_flushBuffers(pClient);
+
+	/* Acknowledged once the whole message is in, so a broken transfer is sent again */
+	if(QOS1 == msg.qos) {
+		_aws_iot_mqtt_internal_send_puback(pClient, msg.id);
+	}
+
+	FUNC_EXIT_RC(MQTT_NOTHING_TO_READ);
+}
+
 static IoT_Error_t _aws_iot_mqtt_internal_read_packet(AWS_IoT_Client *pClient, Timer *pTimer, uint8_t *pPacketType) {
-	size_t rem_len, total_bytes_read, bytes_to_be_read, read_len;
+	size_t rem_len, read_len;
 	IoT_Error_t rc;
     size_t offset = 0;
 	MQTTHeader header = {0};
 
 	rem_len = 0;
-	total_bytes_read = 0;
-	bytes_to_be_read = 0;
 	read_len = 0;
 
     rc = _aws_iot_mqtt_internal_readWrapper( pClient, offset, 1, pTimer, &read_len );
@@ -448,32 +696,14 @@ static IoT_Error_t _aws_iot_mqtt_internal_read_packet(AWS_IoT_Client *pClient, T
 		return rc;
 	}
 
-	/* if the buffer is too short then the message will be dropped silently */
+	/* if the buffer is too short then the message will be dropped silently, unless it is
+	 * a PUBLISH that can be delivered in fragments */
 	if((rem_len + offset) >= pClient->clientData.readBufSize) {
-		bytes_to_be_read = pClient->clientData.readBufSize;
-		do {
-			rc = pClient->networkStack.read(&(pClient->networkStack), pClient->clientData.readBuf, bytes_to_be_read,
-											pTimer, &read_len);
-			if(SUCCESS == rc) {
-				total_bytes_read += read_len;
-				if((rem_len - total_bytes_read) >= pClient->clientData.readBufSize) {
-					bytes_to_be_read = pClient->clientData.readBufSize;
-				} else {
-					bytes_to_be_read = rem_len - total_bytes_read;
-				}
-			}
-		} while(total_bytes_read < rem_len && SUCCESS == rc);
-
-        /* Check buffer was correctly emptied, otherwise, return error message. */
-        if ( total_bytes_read == rem_len )
-        {
-            aws_iot_mqtt_internal_flushBuffers( pClient );
-            return MQTT_RX_BUFFER_TOO_SHORT_ERROR;
-        }
-        else
-        {
-            return rc;
-        }
+		header.byte = pClient->clientData.readBuf[0];
+		if(PUBLISH == MQTT_HEADER_FIELD_TYPE(header.byte)) {
+			return _aws_iot_mqtt_internal_read_publish_fragments(pClient, pTimer, offset, rem_len);
+		}
+		return _aws_iot_mqtt_internal_discard_packet(pClient, pTimer, rem_len);
 	}
 
 	/* 3. read the rest of the buffer using a callback to supply the rest of the data */
@@ -495,9 +725,9 @@ static IoT_Error_t _aws_iot_mqtt_internal_read_packet(AWS_IoT_Client *pClient, T
 // assume topic filter and name is in correct format
 // # can only be at end
 // + and # can only be next to separator
-static bool _aws_iot_mqtt_internal_is_topic_matched(char *pTopicFilter, char *pTopicName, uint16_t topicNameLen) {
+bool aws_iot_mqtt_internal_is_topic_matched(const char *pTopicFilter, const char *pTopicName, uint16_t topicNameLen) {
 
-	char *curf, *curn, *curn_end;
+	const char *curf, *curn, *curn_end;
 
 	if(NULL == pTopicFilter || NULL == pTopicName) {
 		return false;
@@ -516,7 +746,7 @@ static bool _aws_iot_mqtt_internal_is_topic_matched(char *pTopicFilter, char *pT
 		}
 		if(*curf == '+') {
 			/* skip until we meet the next separator, or end of string */
-			char *nextpos = curn + 1;
+			const char *nextpos = curn + 1;
 			while(nextpos < curn_end && *nextpos != '/')
 				nextpos = ++curn + 1;
 		} else if(*curf == '#') {
@@ -531,12 +761,25 @@ static bool _aws_iot_mqtt_internal_is_topic_matched(char *pTopicFilter, char *pT
 	return (curn == curn_end) && (*curf == '\0');
 }
 
+/* Whether a PUBLISH on pTopicName is delivered to pHandler. This is the reference rule, the
+ * subscription index only narrows down which handlers need to be checked against it. */
+bool aws_iot_mqtt_internal_is_handler_matched(const MessageHandlers *pHandler, const char *pTopicName,
+											  uint16_t topicNameLen) {
+	if(NULL == pHandler->topicName) {
+		return false;
+	}
+
+	return ((topicNameLen == pHandler->topicNameLen) && (strncmp(pTopicName, pHandler->topicName, topicNameLen) == 0))
+		   || aws_iot_mqtt_internal_is_topic_matched(pHandler->topicName, pTopicName, topicNameLen);
+}
+
 static IoT_Error_t _aws_iot_mqtt_internal_deliver_message(AWS_IoT_Client *pClient, char *pTopicName,
 														  uint16_t topicNameLen,
 														  IoT_Publish_Message_Params *pMessageParams) {
 	uint32_t itr;
 	IoT_Error_t rc;
 	ClientState clientState;
+	uint32_t matched[(AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS + 31) / 32];
 
 	FUNC_ENTRY;
 
@@ -550,20 +793,27 @@ static IoT_Error_t _aws_iot_mqtt_internal_deliver_message(AWS_IoT_Client *pClien
 	clientState = aws_iot_mqtt_get_client_state(pClient);
 	aws_iot_mqtt_set_client_state(pClient, clientState, CLIENT_STATE_CONNECTED_WAIT_FOR_CB_RETURN);
 
-	/* Find the right message handler - indexed by topic */
+	/* Find the right message handlers - indexed by topic */
+	memset(matched, 0, sizeof(matched));
+	aws_iot_mqtt_internal_subscription_index_match(&(pClient->clientData.subscriptionIndex), pTopicName, topicNameLen,
+												   matched);
+
+	/* Call them in table order, as the linear scan this replaces did */
 	for(itr = 0; itr < AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS; ++itr) {
-		if(NULL != pClient->clientData.messageHandlers[itr].topicName) {
-			if(((topicNameLen == pClient->clientData.messageHandlers[itr].topicNameLen)
-				&&
-				(strncmp(pTopicName, (char *) pClient->clientData.messageHandlers[itr].topicName, topicNameLen) == 0))
-			   || _aws_iot_mqtt_internal_is_topic_matched((char *) pClient->clientData.messageHandlers[itr].topicName,
-														  pTopicName, topicNameLen)) {
-				if(NULL != pClient->clientData.messageHandlers[itr].pApplicationHandler) {
-					pClient->clientData.messageHandlers[itr].pApplicationHandler(pClient, pTopicName, topicNameLen,
-																				 pMessageParams,
-																				 pClient->clientData.messageHandlers[itr].pApplicationHandlerData);
-				}
-			}
+		if(0 == matched[itr / 32]) {
+			itr |= 31;
+			continue;
+		}
+		if(0 == (matched[itr / 32] & (1u << (itr % 32)))) {
+			continue;
+		}
+		/* An earlier callback may have unsubscribed this one or reused its slot */
+		if(aws_iot_mqtt_internal_is_handler_matched(&(pClient->clientData.messageHandlers[itr]), pTopicName,
+													topicNameLen) &&
+		   NULL != pClient->clientData.messageHandlers[itr].pApplicationHandler) {
+			pClient->clientData.messageHandlers[itr].pApplicationHandler(pClient, pTopicName, topicNameLen,
+																		 pMessageParams,
+																		 pClient->clientData.messageHandlers[itr].pApplicationHandlerData);
 		}
 	}
 	rc = aws_iot_mqtt_set_client_state(pClient, CLIENT_STATE_CONNECTED_WAIT_FOR_CB_RETURN, clientState);
@@ -574,16 +824,13 @@ static IoT_Error_t _aws_iot_mqtt_internal_deliver_message(AWS_IoT_Client *pClien
 static IoT_Error_t _aws_iot_mqtt_internal_handle_publish(AWS_IoT_Client *pClient) {
 	char *topicName;
 	uint16_t topicNameLen;
-	uint32_t len;
 	IoT_Error_t rc;
 	IoT_Publish_Message_Params msg;
-	Timer sendTimer;
 
 	FUNC_ENTRY;
 
 	topicName = NULL;
 	topicNameLen = 0;
-	len = 0;
 
 	rc = aws_iot_mqtt_internal_deserialize_publish(&msg.isDup, &msg.qos, &msg.isRetained,
 												   &msg.id, &topicName, &topicNameLen,
@@ -594,27 +841,12 @@ static IoT_Error_t _aws_iot_mqtt_internal_handle_publish(AWS_IoT_Client *pClient
 	if(SUCCESS != rc) {
 		FUNC_EXIT_RC(rc);
 	}
+	msg.payloadOffset = 0;
+	msg.totalPayloadLen = msg.payloadLen;
 
 	/* Send acknowledgement of QoS 1 message. */
 	if(QOS1 == msg.qos) {
-		/* Initialize timer for sending PUBACK. */
-		init_timer(&sendTimer);
-		countdown_ms(&sendTimer, pClient->clientData.commandTimeoutMs);
-
-		/* Generate and send a PUBACK. Warn if the PUBACK isn't sent; the server
-		will send the PUBLISH again in that case. */
-		rc = aws_iot_mqtt_internal_serialize_ack(pClient->clientData.writeBuf,
-			pClient->clientData.writeBufSize, PUBACK, 0, msg.id, &len);
-
-		if(SUCCESS == rc) {
-			rc = aws_iot_mqtt_internal_send_packet(pClient, len, &sendTimer);
-
-			if(SUCCESS != rc) {
-				IOT_WARN("Failed to send PUBACK");
-			}
-		} else {
-			IOT_WARN("Failed to generate PUBACK");
-		}
+		_aws_iot_mqtt_internal_send_puback(pClient, msg.id);
 	}
 
 	rc = _aws_iot_mqtt_internal_deliver_message(pClient, topicName, topicNameLen, &msg);
@@ -670,8 +902,14 @@ IoT_Error_t aws_iot_mqtt_internal_cycle_read(AWS_IoT_Client *pClient, Timer *pTi
 	}
 
 	switch(*pPacketType) {
-		case CONNACK:
 		case PUBACK:
+			/* Acks of messages sent with aws_iot_mqtt_publish_async are handled here and not
+			 * forwarded, so a blocking publish keeps waiting for its own PUBACK */
+			if(aws_iot_mqtt_internal_handle_puback(pClient)) {
+				*pPacketType = (uint8_t) UNKNOWN;
+			}
+			break;
+		case CONNACK:
 		case SUBACK:
 		case UNSUBACK:
 			/* SDK is blocking, these responses will be forwarded to calling function to process */
@@ -712,6 +950,25 @@ IoT_Error_t aws_iot_mqtt_internal_flushBuffers( AWS_IoT_Client *pClient ) {
     return SUCCESS;
 }
 
+/**
+ * @brief Wait until the network has data to read
+ *
+ * Sleeps in the network layer instead of polling the socket with short reads.
+ * Network layers without waitForData return at once, so the caller polls as before.
+ *
+ * @param pClient MQTT client
+ * @param pTimer Amount of time to wait at most
+ *
+ * @return SUCCESS if a read is worth trying, NETWORK_SSL_NOTHING_TO_READ on timeout or wakeup
+ */
+IoT_Error_t aws_iot_mqtt_internal_wait_for_data(AWS_IoT_Client *pClient, Timer *pTimer) {
+	if(NULL == pClient->networkStack.waitForData) {
+		return SUCCESS;
+	}
+
+	return pClient->networkStack.waitForData(&(pClient->networkStack), pTimer);
+}
+
 /**
  * @brief Wait until a packet is read from the network
  *
@@ -739,6 +996,13 @@ IoT_Error_t aws_iot_mqtt_internal_wait_for_read(AWS_IoT_Client *pClient, uint8_t
 			rc = MQTT_REQUEST_TIMEOUT_ERROR;
 			break;
 		}
+		rc = aws_iot_mqtt_internal_wait_for_data(pClient, pTimer);
+		if(NETWORK_SSL_NOTHING_TO_READ == rc) {
+			rc = SUCCESS;
+			continue;
+		} else if(SUCCESS != rc) {
+			break;
+		}
 		rc = aws_iot_mqtt_internal_cycle_read(pClient, pTimer, &read_packet_type);
 	} while(((SUCCESS == rc) || (MQTT_NOTHING_TO_READ == rc)) && (read_packet_type != packetType));
 
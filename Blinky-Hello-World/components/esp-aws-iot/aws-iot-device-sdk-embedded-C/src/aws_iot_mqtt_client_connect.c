@@ -423,6 +423,11 @@ IoT_Error_t aws_iot_mqtt_connect(AWS_IoT_Client *pClient, const IoT_Client_Conne
 		FUNC_EXIT_RC(NETWORK_ALREADY_CONNECTED_ERROR);
 	}
 
+	/* Only the auto-reconnect sends the messages in flight again, a new connection starts without them */
+	if(CLIENT_STATE_PENDING_RECONNECT != clientState) {
+		aws_iot_mqtt_internal_fail_publish(pClient, NETWORK_MANUALLY_DISCONNECTED);
+	}
+
 	aws_iot_mqtt_set_client_state(pClient, clientState, CLIENT_STATE_CONNECTING);
 
 	rc = _aws_iot_mqtt_internal_connect(pClient, pConnectParams);
@@ -486,7 +491,8 @@ static IoT_Error_t _aws_iot_mqtt_internal_disconnect(AWS_IoT_Client *pClient) {
 	FUNC_EXIT_RC(SUCCESS);
 }
 
-IoT_Error_t aws_iot_mqtt_disconnect(AWS_IoT_Client *pClient) {
+/* Also used when the connection is lost, where the messages in flight are kept for the auto-reconnect */
+IoT_Error_t aws_iot_mqtt_internal_disconnect(AWS_IoT_Client *pClient) {
 	ClientState clientState;
 	IoT_Error_t rc;
 
@@ -519,6 +525,20 @@ IoT_Error_t aws_iot_mqtt_disconnect(AWS_IoT_Client *pClient) {
 	FUNC_EXIT_RC(rc);
 }
 
+IoT_Error_t aws_iot_mqtt_disconnect(AWS_IoT_Client *pClient) {
+	IoT_Error_t rc;
+
+	FUNC_ENTRY;
+
+	rc = aws_iot_mqtt_internal_disconnect(pClient);
+	if(SUCCESS == rc) {
+		/* No PUBACK will come for the messages in flight */
+		aws_iot_mqtt_internal_fail_publish(pClient, NETWORK_MANUALLY_DISCONNECTED);
+	}
+
+	FUNC_EXIT_RC(rc);
+}
+
 IoT_Error_t aws_iot_mqtt_attempt_reconnect(AWS_IoT_Client *pClient) {
 	IoT_Error_t rc;
 
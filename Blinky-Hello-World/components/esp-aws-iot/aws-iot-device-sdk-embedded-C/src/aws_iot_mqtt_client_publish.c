@@ -42,6 +42,9 @@ extern "C" {
 
 #include "aws_iot_mqtt_client_common_internal.h"
 
+/** Largest remaining length the four length bytes of a packet can hold (MQTT 3.1.1 - 2.2.3) */
+#define MAX_REMAINING_LENGTH 268435455U
+
 /**
  * @param stringVar pointer to the String into which the data is to be read
  * @param stringLen pointer to variable which has the length of the string
@@ -68,6 +71,72 @@ static IoT_Error_t _aws_iot_mqtt_read_string_with_len(char **stringVar, uint16_t
 	FUNC_EXIT_RC(rc);
 }
 
+/**
+  * Serializes the fixed header, topic and packet identifier of a publish into the supplied buffer.
+  * The remaining length counts the payload, which is not written.
+  * @param pTxBuf the buffer into which the header will be serialized
+  * @param txBufLen the length in bytes of the supplied buffer
+  * @param dup uint8_t - the MQTT dup flag
+  * @param qos QoS - the MQTT QoS value
+  * @param retained uint8_t - the MQTT retained flag
+  * @param packetId uint16_t - the MQTT packet identifier
+  * @param pTopicName char * - the MQTT topic in the publish
+  * @param topicNameLen uint16_t - the length of the Topic Name
+  * @param payloadLen size_t - the length of the MQTT payload
+  * @param pSerializedLen uint32_t - pointer to the variable that stores serialized len
+  *
+  * @return An IoT Error Type defining successful/failed call
+  */
+static IoT_Error_t _aws_iot_mqtt_internal_serialize_publish_header(unsigned char *pTxBuf, size_t txBufLen,
+																   uint8_t dup, QoS qos, uint8_t retained,
+																   uint16_t packetId, const char *pTopicName,
+																   uint16_t topicNameLen, size_t payloadLen,
+																   uint32_t *pSerializedLen) {
+	unsigned char *ptr;
+	uint32_t rem_len;
+	size_t headerLen;
+	IoT_Error_t rc;
+	MQTTHeader header = {0};
+
+	FUNC_ENTRY;
+	if(NULL == pTxBuf || NULL == pSerializedLen) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	headerLen = (size_t) topicNameLen + 2;
+	if(qos > 0) {
+		headerLen += 2; /* packetId */
+	}
+	if(payloadLen > MAX_REMAINING_LENGTH - headerLen) {
+		FUNC_EXIT_RC(MAX_SIZE_ERROR);
+	}
+	rem_len = (uint32_t) (headerLen + payloadLen);
+
+	if(aws_iot_mqtt_internal_get_final_packet_length_from_remaining_length(rem_len) - payloadLen > txBufLen) {
+		FUNC_EXIT_RC(MQTT_TX_BUFFER_TOO_SHORT_ERROR);
+	}
+
+	ptr = pTxBuf;
+
+	rc = aws_iot_mqtt_internal_init_header(&header, PUBLISH, qos, dup, retained);
+	if(SUCCESS != rc) {
+		FUNC_EXIT_RC(rc);
+	}
+	aws_iot_mqtt_internal_write_char(&ptr, header.byte); /* write header */
+
+	ptr += aws_iot_mqtt_internal_write_len_to_buffer(ptr, rem_len); /* write remaining length */;
+
+	aws_iot_mqtt_internal_write_utf8_string(&ptr, pTopicName, topicNameLen);
+
+	if(qos > 0) {
+		aws_iot_mqtt_internal_write_uint_16(&ptr, packetId);
+	}
+
+	*pSerializedLen = (uint32_t) (ptr - pTxBuf);
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+
 /**
   * Serializes the supplied publish data into the supplied buffer, ready for sending
   * @param pTxBuf the buffer into which the packet will be serialized
@@ -89,17 +158,18 @@ static IoT_Error_t _aws_iot_mqtt_internal_serialize_publish(unsigned char *pTxBu
 															const char *pTopicName, uint16_t topicNameLen,
 															const unsigned char *pPayload, size_t payloadLen,
 															uint32_t *pSerializedLen) {
-	unsigned char *ptr;
 	uint32_t rem_len;
 	IoT_Error_t rc;
-	MQTTHeader header = {0};
 
 	FUNC_ENTRY;
 	if(NULL == pTxBuf || NULL == pPayload || NULL == pSerializedLen) {
 		FUNC_EXIT_RC(NULL_VALUE_ERROR);
 	}
 
-	ptr = pTxBuf;
+	if(payloadLen >= txBufLen) {
+		FUNC_EXIT_RC(MQTT_TX_BUFFER_TOO_SHORT_ERROR);
+	}
+
 	rem_len = 0;
 
 	rem_len += (uint32_t) (topicNameLen + payloadLen + 2);
@@ -110,26 +180,76 @@ static IoT_Error_t _aws_iot_mqtt_internal_serialize_publish(unsigned char *pTxBu
 		FUNC_EXIT_RC(MQTT_TX_BUFFER_TOO_SHORT_ERROR);
 	}
 
-	rc = aws_iot_mqtt_internal_init_header(&header, PUBLISH, qos, dup, retained);
+	rc = _aws_iot_mqtt_internal_serialize_publish_header(pTxBuf, txBufLen, dup, qos, retained, packetId,
+														 pTopicName, topicNameLen, payloadLen, pSerializedLen);
 	if(SUCCESS != rc) {
 		FUNC_EXIT_RC(rc);
 	}
-	aws_iot_mqtt_internal_write_char(&ptr, header.byte); /* write header */
 
-	ptr += aws_iot_mqtt_internal_write_len_to_buffer(ptr, rem_len); /* write remaining length */;
+	memcpy(&pTxBuf[*pSerializedLen], pPayload, payloadLen);
+	*pSerializedLen += (uint32_t) payloadLen;
 
-	aws_iot_mqtt_internal_write_utf8_string(&ptr, pTopicName, topicNameLen);
+	FUNC_EXIT_RC(SUCCESS);
+}
 
-	if(qos > 0) {
-		aws_iot_mqtt_internal_write_uint_16(&ptr, packetId);
+/**
+  * Sends a publish packet. Large payloads go to the gather write of the network layer
+  * straight from the application's buffer, behind a header serialized into the TX buffer.
+  * Small payloads, or all of them if the network layer has no writev, are copied into
+  * the TX buffer with the header and sent in one write.
+  * @param pClient Reference to the IoT Client
+  * @param dup uint8_t - the MQTT dup flag
+  * @param qos QoS - the MQTT QoS value
+  * @param retained uint8_t - the MQTT retained flag
+  * @param packetId uint16_t - the MQTT packet identifier
+  * @param pTopicName char * - the MQTT topic in the publish
+  * @param topicNameLen uint16_t - the length of the Topic Name
+  * @param pPayload byte buffer - the MQTT publish payload
+  * @param payloadLen size_t - the length of the MQTT payload
+  * @param pTimer Amount of time allowed to send packet
+  *
+  * @return An IoT Error Type defining successful/failed call
+  */
+static IoT_Error_t _aws_iot_mqtt_internal_send_publish(AWS_IoT_Client *pClient, uint8_t dup, QoS qos,
+													   uint8_t retained, uint16_t packetId, const char *pTopicName,
+													   uint16_t topicNameLen, const unsigned char *pPayload,
+													   size_t payloadLen, Timer *pTimer) {
+	uint32_t len = 0;
+	NetworkIoVec vector[2];
+	IoT_Error_t rc;
+
+	FUNC_ENTRY;
+
+	if(NULL == pClient->networkStack.writev || AWS_IOT_MQTT_PUBLISH_GATHER_MIN_PAYLOAD > payloadLen) {
+		rc = _aws_iot_mqtt_internal_serialize_publish(pClient->clientData.writeBuf, pClient->clientData.writeBufSize,
+													  dup, qos, retained, packetId, pTopicName, topicNameLen,
+													  pPayload, payloadLen, &len);
+		if(SUCCESS != rc) {
+			FUNC_EXIT_RC(rc);
+		}
+
+		rc = aws_iot_mqtt_internal_send_packet(pClient, len, pTimer);
+		FUNC_EXIT_RC(rc);
 	}
 
-	memcpy(ptr, pPayload, payloadLen);
-	ptr += payloadLen;
+	if(NULL == pPayload) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
 
-	*pSerializedLen = (uint32_t) (ptr - pTxBuf);
+	rc = _aws_iot_mqtt_internal_serialize_publish_header(pClient->clientData.writeBuf,
+														 pClient->clientData.writeBufSize, dup, qos, retained,
+														 packetId, pTopicName, topicNameLen, payloadLen, &len);
+	if(SUCCESS != rc) {
+		FUNC_EXIT_RC(rc);
+	}
 
-	FUNC_EXIT_RC(SUCCESS);
+	vector[0].pBuffer = pClient->clientData.writeBuf;
+	vector[0].len = len;
+	vector[1].pBuffer = pPayload;
+	vector[1].len = payloadLen;
+
+	rc = aws_iot_mqtt_internal_send_packet_vector(pClient, vector, 2, pTimer);
+	FUNC_EXIT_RC(rc);
 }
 
 /**
@@ -197,7 +317,6 @@ IoT_Error_t aws_iot_mqtt_internal_serialize_ack(unsigned char *pTxBuf, size_t tx
 static IoT_Error_t _aws_iot_mqtt_internal_publish(AWS_IoT_Client *pClient, const char *pTopicName,
 												  uint16_t topicNameLen, IoT_Publish_Message_Params *pParams) {
 	Timer timer;
-	uint32_t len = 0;
 	uint16_t packet_id;
 	unsigned char dup, type;
 	IoT_Error_t rc;
@@ -211,16 +330,10 @@ static IoT_Error_t _aws_iot_mqtt_internal_publish(AWS_IoT_Client *pClient, const
 		pParams->id = aws_iot_mqtt_get_next_packet_id(pClient);
 	}
 
-	rc = _aws_iot_mqtt_internal_serialize_publish(pClient->clientData.writeBuf, pClient->clientData.writeBufSize, 0,
-												  pParams->qos, pParams->isRetained, pParams->id, pTopicName,
-												  topicNameLen, (unsigned char *) pParams->payload,
-												  pParams->payloadLen, &len);
-	if(SUCCESS != rc) {
-		FUNC_EXIT_RC(rc);
-	}
-
 	/* send the publish packet */
-	rc = aws_iot_mqtt_internal_send_packet(pClient, len, &timer);
+	rc = _aws_iot_mqtt_internal_send_publish(pClient, 0, pParams->qos, pParams->isRetained, pParams->id, pTopicName,
+											 topicNameLen, (unsigned char *) pParams->payload, pParams->payloadLen,
+											 &timer);
 	if(SUCCESS != rc) {
 		FUNC_EXIT_RC(rc);
 	}
@@ -277,6 +390,258 @@ IoT_Error_t aws_iot_mqtt_publish(AWS_IoT_Client *pClient, const char *pTopicName
 	FUNC_EXIT_RC(pubRc);
 }
 
+PublishInFlight *aws_iot_mqtt_internal_find_publish_in_flight(AWS_IoT_Client *pClient, uint16_t packetId) {
+	uint32_t itr;
+
+	for(itr = 0; itr < AWS_IOT_MQTT_MAX_INFLIGHT_PUBLISH; ++itr) {
+		if(packetId == pClient->clientData.publishInFlight[itr].packetId) {
+			return &(pClient->clientData.publishInFlight[itr]);
+		}
+	}
+
+	return NULL;
+}
+
+static IoT_Error_t _aws_iot_mqtt_internal_send_publish_in_flight(AWS_IoT_Client *pClient, PublishInFlight *pEntry,
+																 uint8_t dup) {
+	Timer timer;
+	IoT_Error_t rc;
+
+	FUNC_ENTRY;
+
+	init_timer(&timer);
+	countdown_ms(&timer, pClient->clientData.commandTimeoutMs);
+
+	rc = _aws_iot_mqtt_internal_send_publish(pClient, dup, QOS1, pEntry->isRetained, pEntry->packetId,
+											 pEntry->pTopicName, pEntry->topicNameLen,
+											 (const unsigned char *) pEntry->pPayload, pEntry->payloadLen, &timer);
+	if(SUCCESS != rc) {
+		FUNC_EXIT_RC(rc);
+	}
+
+	countdown_ms(&(pEntry->retransmitTimer), AWS_IOT_MQTT_PUBLISH_RETRANSMIT_MS);
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+
+static void _aws_iot_mqtt_internal_complete_publish_in_flight(AWS_IoT_Client *pClient, PublishInFlight *pEntry,
+															  IoT_Error_t result) {
+	uint16_t packetId;
+	ClientState clientState;
+	pPublishCompletionHandler_t pCompletionHandler;
+	void *pCompletionHandlerData;
+
+	packetId = pEntry->packetId;
+	pCompletionHandler = pEntry->pCompletionHandler;
+	pCompletionHandlerData = pEntry->pCompletionHandlerData;
+
+	/* Freed before the callback, so the callback can publish again */
+	pEntry->packetId = 0;
+	pClient->clientData.publishInFlightCount--;
+
+	if(NULL == pCompletionHandler) {
+		return;
+	}
+
+	/* Same as for message callbacks, yield must not be called from the callback */
+	if(aws_iot_mqtt_is_client_connected(pClient)) {
+		clientState = aws_iot_mqtt_get_client_state(pClient);
+		aws_iot_mqtt_set_client_state(pClient, clientState, CLIENT_STATE_CONNECTED_WAIT_FOR_CB_RETURN);
+		pCompletionHandler(pClient, packetId, result, pCompletionHandlerData);
+		aws_iot_mqtt_set_client_state(pClient, CLIENT_STATE_CONNECTED_WAIT_FOR_CB_RETURN, clientState);
+	} else {
+		pCompletionHandler(pClient, packetId, result, pCompletionHandlerData);
+	}
+}
+
+/**
+ * @brief Complete the in-flight message acknowledged by the PUBACK in the read buffer
+ *
+ * @param pClient MQTT client
+ *
+ * @return true if the PUBACK belonged to an in-flight message, false if it is for a blocking publish
+ */
+bool aws_iot_mqtt_internal_handle_puback(AWS_IoT_Client *pClient) {
+	uint16_t packetId;
+	unsigned char dup, type;
+	PublishInFlight *pEntry;
+
+	if(0 == pClient->clientData.publishInFlightCount) {
+		return false;
+	}
+
+	if(SUCCESS != aws_iot_mqtt_internal_deserialize_ack(&type, &dup, &packetId, pClient->clientData.readBuf,
+														 pClient->clientData.readBufSize)) {
+		return false;
+	}
+
+	pEntry = aws_iot_mqtt_internal_find_publish_in_flight(pClient, packetId);
+	if(0 == packetId || NULL == pEntry) {
+		return false;
+	}
+
+	_aws_iot_mqtt_internal_complete_publish_in_flight(pClient, pEntry, SUCCESS);
+	return true;
+}
+
+/**
+ * @brief Send again the in-flight messages whose PUBACK is overdue
+ *
+ * Messages that were sent again AWS_IOT_MQTT_PUBLISH_MAX_RETRANSMITS times complete
+ * with MQTT_REQUEST_TIMEOUT_ERROR instead.
+ *
+ * @param pClient MQTT client
+ * @param resendAll Send all messages now, as after a reconnect, without counting it as a retransmit
+ *
+ * @return IoT_Error_t of the first send that failed
+ */
+IoT_Error_t aws_iot_mqtt_internal_retransmit_publish(AWS_IoT_Client *pClient, bool resendAll) {
+	uint32_t itr;
+	IoT_Error_t rc;
+	PublishInFlight *pEntry;
+
+	FUNC_ENTRY;
+
+	for(itr = 0; itr < AWS_IOT_MQTT_MAX_INFLIGHT_PUBLISH && 0 < pClient->clientData.publishInFlightCount; ++itr) {
+		pEntry = &(pClient->clientData.publishInFlight[itr]);
+		if(0 == pEntry->packetId || (!resendAll && !has_timer_expired(&(pEntry->retransmitTimer)))) {
+			continue;
+		}
+
+		if(!resendAll) {
+			if(AWS_IOT_MQTT_PUBLISH_MAX_RETRANSMITS <= pEntry->retransmitCount) {
+				_aws_iot_mqtt_internal_complete_publish_in_flight(pClient, pEntry, MQTT_REQUEST_TIMEOUT_ERROR);
+				continue;
+			}
+			pEntry->retransmitCount++;
+		}
+
+		rc = _aws_iot_mqtt_internal_send_publish_in_flight(pClient, pEntry, 1);
+		if(SUCCESS != rc) {
+			FUNC_EXIT_RC(rc);
+		}
+	}
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+
+/**
+ * @brief Complete all in-flight messages with an error, when the connection will not come back
+ *
+ * @param pClient MQTT client
+ * @param result Error passed to the completion handlers
+ */
+void aws_iot_mqtt_internal_fail_publish(AWS_IoT_Client *pClient, IoT_Error_t result) {
+	uint32_t itr;
+
+	for(itr = 0; itr < AWS_IOT_MQTT_MAX_INFLIGHT_PUBLISH && 0 < pClient->clientData.publishInFlightCount; ++itr) {
+		if(0 != pClient->clientData.publishInFlight[itr].packetId) {
+			_aws_iot_mqtt_internal_complete_publish_in_flight(pClient, &(pClient->clientData.publishInFlight[itr]),
+															  result);
+		}
+	}
+}
+
+static IoT_Error_t _aws_iot_mqtt_internal_publish_async(AWS_IoT_Client *pClient, const char *pTopicName,
+														uint16_t topicNameLen, IoT_Publish_Message_Params *pParams,
+														pPublishCompletionHandler_t pCompletionHandler,
+														void *pCompletionHandlerData) {
+	Timer timer;
+	uint8_t packetType;
+	PublishInFlight *pEntry;
+	IoT_Error_t rc;
+
+	FUNC_ENTRY;
+
+	init_timer(&timer);
+	countdown_ms(&timer, pClient->clientData.commandTimeoutMs);
+
+	/* Window full, read until a PUBACK frees an entry */
+	while(pClient->clientData.publishWindow <= pClient->clientData.publishInFlightCount) {
+		if(has_timer_expired(&timer)) {
+			FUNC_EXIT_RC(MQTT_REQUEST_TIMEOUT_ERROR);
+		}
+		rc = aws_iot_mqtt_internal_wait_for_data(pClient, &timer);
+		if(SUCCESS == rc) {
+			rc = aws_iot_mqtt_internal_cycle_read(pClient, &timer, &packetType);
+		} else if(NETWORK_SSL_NOTHING_TO_READ == rc) {
+			rc = SUCCESS;
+		}
+		if(SUCCESS != rc) {
+			FUNC_EXIT_RC(rc);
+		}
+	}
+
+	pEntry = aws_iot_mqtt_internal_find_publish_in_flight(pClient, 0);
+	if(NULL == pEntry) {
+		FUNC_EXIT_RC(LIMIT_EXCEEDED_ERROR);
+	}
+
+	pEntry->packetId = aws_iot_mqtt_get_next_packet_id(pClient);
+	pEntry->pTopicName = pTopicName;
+	pEntry->topicNameLen = topicNameLen;
+	pEntry->pPayload = pParams->payload;
+	pEntry->payloadLen = pParams->payloadLen;
+	pEntry->isRetained = pParams->isRetained;
+	pEntry->retransmitCount = 0;
+	pEntry->pCompletionHandler = pCompletionHandler;
+	pEntry->pCompletionHandlerData = pCompletionHandlerData;
+	init_timer(&(pEntry->retransmitTimer));
+
+	rc = _aws_iot_mqtt_internal_send_publish_in_flight(pClient, pEntry, 0);
+	if(SUCCESS != rc) {
+		pEntry->packetId = 0;
+		FUNC_EXIT_RC(rc);
+	}
+
+	pParams->id = pEntry->packetId;
+	pClient->clientData.publishInFlightCount++;
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+
+IoT_Error_t aws_iot_mqtt_publish_async(AWS_IoT_Client *pClient, const char *pTopicName, uint16_t topicNameLen,
+									   IoT_Publish_Message_Params *pParams,
+									   pPublishCompletionHandler_t pCompletionHandler, void *pCompletionHandlerData) {
+	IoT_Error_t rc, pubRc;
+	ClientState clientState;
+
+	FUNC_ENTRY;
+
+	if(NULL == pClient || NULL == pTopicName || 0 == topicNameLen || NULL == pParams || NULL == pParams->payload) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	if(QOS1 != pParams->qos) {
+		rc = aws_iot_mqtt_publish(pClient, pTopicName, topicNameLen, pParams);
+		FUNC_EXIT_RC(rc);
+	}
+
+	if(!aws_iot_mqtt_is_client_connected(pClient)) {
+		FUNC_EXIT_RC(NETWORK_DISCONNECTED_ERROR);
+	}
+
+	clientState = aws_iot_mqtt_get_client_state(pClient);
+	if(CLIENT_STATE_CONNECTED_IDLE != clientState && CLIENT_STATE_CONNECTED_WAIT_FOR_CB_RETURN != clientState) {
+		FUNC_EXIT_RC(MQTT_CLIENT_NOT_IDLE_ERROR);
+	}
+
+	rc = aws_iot_mqtt_set_client_state(pClient, clientState, CLIENT_STATE_CONNECTED_PUBLISH_IN_PROGRESS);
+	if(SUCCESS != rc) {
+		FUNC_EXIT_RC(rc);
+	}
+
+	pubRc = _aws_iot_mqtt_internal_publish_async(pClient, pTopicName, topicNameLen, pParams, pCompletionHandler,
+												 pCompletionHandlerData);
+
+	rc = aws_iot_mqtt_set_client_state(pClient, CLIENT_STATE_CONNECTED_PUBLISH_IN_PROGRESS, clientState);
+	if(SUCCESS == pubRc && SUCCESS != rc) {
+		pubRc = rc;
+	}
+
+	FUNC_EXIT_RC(pubRc);
+}
+
 /**
   * Deserializes the supplied (wire) buffer into publish data
   * @param dup returned uint8_t - the MQTT dup flag
@@ -201,13 +201,14 @@ static uint32_t _aws_iot_mqtt_get_free_message_handler_index(AWS_IoT_Client *pCl
  * @param pApplicationHandler_t Reference to the handler function for this subscription
  * @param pApplicationHandlerData Point to data passed to the callback.
  *    pApplicationHandlerData also needs to be static in memory  since no malloc are performed by the SDK
+ * @param acceptsFragments Whether messages too large for the read buffer are delivered in fragments
  *
  * @return An IoT Error Type defining successful/failed subscription
  */
 static IoT_Error_t _aws_iot_mqtt_internal_subscribe(AWS_IoT_Client *pClient, const char *pTopicName,
 													uint16_t topicNameLen, QoS qos,
 													pApplicationHandler_t pApplicationHandler,
-													void *pApplicationHandlerData) {
+													void *pApplicationHandlerData, bool acceptsFragments) {
 	uint16_t txPacketId, rxPacketId;
 	uint32_t serializedLen, indexOfFreeMessageHandler, count;
 	IoT_Error_t rc;
@@ -269,12 +270,16 @@ static IoT_Error_t _aws_iot_mqtt_internal_subscribe(AWS_IoT_Client *pClient, con
 	pClient->clientData.messageHandlers[indexOfFreeMessageHandler].pApplicationHandlerData =
 			pApplicationHandlerData;
 	pClient->clientData.messageHandlers[indexOfFreeMessageHandler].qos = qos;
+	pClient->clientData.messageHandlers[indexOfFreeMessageHandler].acceptsFragments = acceptsFragments;
+	aws_iot_mqtt_internal_subscription_index_add(&(pClient->clientData.subscriptionIndex),
+												 (uint16_t) indexOfFreeMessageHandler);
 
 	FUNC_EXIT_RC(SUCCESS);
 }
 
-IoT_Error_t aws_iot_mqtt_subscribe(AWS_IoT_Client *pClient, const char *pTopicName, uint16_t topicNameLen,
-								   QoS qos, pApplicationHandler_t pApplicationHandler, void *pApplicationHandlerData) {
+static IoT_Error_t _aws_iot_mqtt_subscribe(AWS_IoT_Client *pClient, const char *pTopicName, uint16_t topicNameLen,
+											QoS qos, pApplicationHandler_t pApplicationHandler,
+											void *pApplicationHandlerData, bool acceptsFragments) {
 	ClientState clientState;
 	IoT_Error_t rc, subRc;
 
@@ -299,7 +304,7 @@ IoT_Error_t aws_iot_mqtt_subscribe(AWS_IoT_Client *pClient, const char *pTopicNa
 	}
 
 	subRc = _aws_iot_mqtt_internal_subscribe(pClient, pTopicName, topicNameLen, qos,
-											 pApplicationHandler, pApplicationHandlerData);
+											 pApplicationHandler, pApplicationHandlerData, acceptsFragments);
 
 	rc = aws_iot_mqtt_set_client_state(pClient, CLIENT_STATE_CONNECTED_SUBSCRIBE_IN_PROGRESS, clientState);
 	if(SUCCESS == subRc && SUCCESS != rc) {
@@ -309,6 +314,19 @@ IoT_Error_t aws_iot_mqtt_subscribe(AWS_IoT_Client *pClient, const char *pTopicNa
 	FUNC_EXIT_RC(subRc);
 }
 
+IoT_Error_t aws_iot_mqtt_subscribe(AWS_IoT_Client *pClient, const char *pTopicName, uint16_t topicNameLen,
+								   QoS qos, pApplicationHandler_t pApplicationHandler, void *pApplicationHandlerData) {
+	return _aws_iot_mqtt_subscribe(pClient, pTopicName, topicNameLen, qos, pApplicationHandler,
+								   pApplicationHandlerData, false);
+}
+
+IoT_Error_t aws_iot_mqtt_subscribe_fragmented(AWS_IoT_Client *pClient, const char *pTopicName, uint16_t topicNameLen,
+											  QoS qos, pApplicationHandler_t pApplicationHandler,
+											  void *pApplicationHandlerData) {
+	return _aws_iot_mqtt_subscribe(pClient, pTopicName, topicNameLen, qos, pApplicationHandler,
+								   pApplicationHandlerData, true);
+}
+
 /**
  * @brief Subscribe to an MQTT topic.
  *
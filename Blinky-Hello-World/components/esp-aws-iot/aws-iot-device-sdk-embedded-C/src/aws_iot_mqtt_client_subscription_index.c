@@ -0,0 +1,485 @@
+/*
+* Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_mqtt_client_subscription_index.c
+ * @brief MQTT client subscription index
+ *
+ * Narrows down the message handlers an incoming PUBLISH has to be checked against.
+ * Exact topic filters are found through a hash table keyed by the whole topic,
+ * wildcard filters through a trie with one node per topic level. The index only
+ * produces candidates, each of them is confirmed with
+ * aws_iot_mqtt_internal_is_handler_matched() so delivery is the same as checking
+ * every handler in turn.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <aws_iot_mqtt_client.h>
+#include "aws_iot_mqtt_client_common_internal.h"
+#include "aws_iot_hash.h"
+
+/** How a handler is indexed */
+typedef enum {
+	SUBSCRIPTION_INDEX_NONE = 0,	///< Not indexed, the handler slot is free
+	SUBSCRIPTION_INDEX_EXACT,	///< In the hash table
+	SUBSCRIPTION_INDEX_TRIE,	///< In the trie, on the exact list of its last level
+	SUBSCRIPTION_INDEX_TRIE_HASH,	///< In the trie, on the '#' list of the level before the '#'
+	SUBSCRIPTION_INDEX_FALLBACK	///< On the fallback list
+} SubscriptionIndexKind;
+
+/** Marks a level that was not found in the trie while counting the nodes a filter needs */
+#define SUBSCRIPTION_INDEX_NO_NODE 0xFFFF
+
+/* Returns the end of the topic level starting at start, i.e. the position of the next '/' or len */
+static uint16_t _aws_iot_mqtt_subscription_level_end(const char *pStr, uint16_t len, uint16_t start) {
+	uint16_t end = start;
+
+	while(end < len && pStr[end] != '/') {
+		end++;
+	}
+
+	return end;
+}
+
+static SubscriptionIndexKind _aws_iot_mqtt_subscription_classify(const char *pFilter, uint16_t filterLen) {
+	uint16_t start = 0, end, i;
+	bool hasWildcard = false;
+
+	/* The exact comparison uses topicNameLen while the wildcard matching uses the
+	 * C string. Filters where those disagree are left to the linear scan. */
+	for(i = 0; i < filterLen; i++) {
+		if('\0' == pFilter[i]) {
+			return SUBSCRIPTION_INDEX_FALLBACK;
+		}
+	}
+	if('\0' != pFilter[filterLen]) {
+		return SUBSCRIPTION_INDEX_FALLBACK;
+	}
+
+	for(;;) {
+		end = _aws_iot_mqtt_subscription_level_end(pFilter, filterLen, start);
+		for(i = start; i < end; i++) {
+			if('+' != pFilter[i] && '#' != pFilter[i]) {
+				continue;
+			}
+			if(end - start != 1) {
+				/* Wildcard sharing a level with other characters */
+				return SUBSCRIPTION_INDEX_FALLBACK;
+			}
+			if('#' == pFilter[i]) {
+				/* '#' is only handled as the last level */
+				return (end == filterLen) ? SUBSCRIPTION_INDEX_TRIE_HASH : SUBSCRIPTION_INDEX_FALLBACK;
+			}
+			hasWildcard = true;
+		}
+		if(end == filterLen) {
+			break;
+		}
+		start = end + 1;
+	}
+
+	return hasWildcard ? SUBSCRIPTION_INDEX_TRIE : SUBSCRIPTION_INDEX_EXACT;
+}
+
+static void _aws_iot_mqtt_subscription_list_push(SubscriptionIndex *pIndex, uint16_t *pHead, uint16_t handlerIndex) {
+	pIndex->pEntries[handlerIndex].next = *pHead;
+	*pHead = handlerIndex + 1;
+}
+
+static void _aws_iot_mqtt_subscription_list_unlink(SubscriptionIndex *pIndex, uint16_t *pHead, uint16_t handlerIndex) {
+	uint16_t *pLink = pHead;
+
+	while(0 != *pLink) {
+		if(*pLink == handlerIndex + 1) {
+			*pLink = pIndex->pEntries[handlerIndex].next;
+			break;
+		}
+		pLink = &(pIndex->pEntries[*pLink - 1].next);
+	}
+	pIndex->pEntries[handlerIndex].next = 0;
+}
+
+static void _aws_iot_mqtt_subscription_hash_insert(SubscriptionIndex *pIndex, uint16_t handlerIndex) {
+	uint16_t slot = (uint16_t) (pIndex->pEntries[handlerIndex].hash % pIndex->bucketCount);
+
+	/* bucketCount > handlerCount, so there always is a free bucket */
+	while(0 != pIndex->pBuckets[slot]) {
+		slot = (uint16_t) ((slot + 1) % pIndex->bucketCount);
+	}
+	pIndex->pBuckets[slot] = handlerIndex + 1;
+}
+
+static void _aws_iot_mqtt_subscription_hash_remove(SubscriptionIndex *pIndex, uint16_t handlerIndex) {
+	uint16_t hole = (uint16_t) (pIndex->pEntries[handlerIndex].hash % pIndex->bucketCount);
+	uint16_t slot, home;
+
+	while(pIndex->pBuckets[hole] != handlerIndex + 1) {
+		if(0 == pIndex->pBuckets[hole]) {
+			return;
+		}
+		hole = (uint16_t) ((hole + 1) % pIndex->bucketCount);
+	}
+
+	/* Linear probing: shift later entries of the cluster back instead of leaving a tombstone */
+	slot = hole;
+	for(;;) {
+		slot = (uint16_t) ((slot + 1) % pIndex->bucketCount);
+		if(0 == pIndex->pBuckets[slot]) {
+			break;
+		}
+		home = (uint16_t) (pIndex->pEntries[pIndex->pBuckets[slot] - 1].hash % pIndex->bucketCount);
+		/* Move the entry into the hole unless its home lies cyclically in (hole, slot] */
+		if((hole <= slot) ? (home <= hole || home > slot) : (home <= hole && home > slot)) {
+			pIndex->pBuckets[hole] = pIndex->pBuckets[slot];
+			hole = slot;
+		}
+	}
+	pIndex->pBuckets[hole] = 0;
+}
+
+static uint16_t _aws_iot_mqtt_subscription_find_child(const SubscriptionIndex *pIndex, uint16_t node,
+													  uint32_t labelHash, uint16_t labelLen) {
+	uint16_t child = pIndex->pNodes[node].firstChild;
+
+	while(0 != child) {
+		if(pIndex->pNodes[child].labelHash == labelHash && pIndex->pNodes[child].labelLen == labelLen) {
+			break;
+		}
+		child = pIndex->pNodes[child].nextSibling;
+	}
+
+	return child;
+}
+
+static uint16_t _aws_iot_mqtt_subscription_alloc_node(SubscriptionIndex *pIndex, uint16_t parent, bool isPlus,
+													  uint32_t labelHash, uint16_t labelLen) {
+	uint16_t node = pIndex->freeNodeHead;
+
+	pIndex->freeNodeHead = pIndex->pNodes[node].nextSibling;
+	pIndex->freeNodeCount--;
+
+	memset(&(pIndex->pNodes[node]), 0, sizeof(SubscriptionTrieNode));
+	pIndex->pNodes[node].parent = parent;
+	if(isPlus) {
+		pIndex->pNodes[parent].plusChild = node;
+	} else {
+		pIndex->pNodes[node].labelHash = labelHash;
+		pIndex->pNodes[node].labelLen = labelLen;
+		pIndex->pNodes[node].nextSibling = pIndex->pNodes[parent].firstChild;
+		pIndex->pNodes[parent].firstChild = node;
+	}
+
+	return node;
+}
+
+static void _aws_iot_mqtt_subscription_free_node(SubscriptionIndex *pIndex, uint16_t node) {
+	uint16_t parent = pIndex->pNodes[node].parent;
+	uint16_t *pLink;
+
+	if(pIndex->pNodes[parent].plusChild == node) {
+		pIndex->pNodes[parent].plusChild = 0;
+	} else {
+		pLink = &(pIndex->pNodes[parent].firstChild);
+		while(*pLink != node) {
+			pLink = &(pIndex->pNodes[*pLink].nextSibling);
+		}
+		*pLink = pIndex->pNodes[node].nextSibling;
+	}
+
+	pIndex->pNodes[node].nextSibling = pIndex->freeNodeHead;
+	pIndex->freeNodeHead = node;
+	pIndex->freeNodeCount++;
+}
+
+/**
+ * Walks the trie along the levels of a wildcard filter, up to but excluding a trailing '#'.
+ * With create set, missing levels are added and the last node is returned. Otherwise
+ * nothing is changed and *pMissing is set to the number of nodes that would be added.
+ */
+static uint16_t _aws_iot_mqtt_subscription_walk(SubscriptionIndex *pIndex, const char *pFilter, uint16_t filterLen,
+												SubscriptionIndexKind kind, bool create, uint16_t *pMissing) {
+	uint16_t node = 0, child, start = 0, end, missing = 0;
+	uint32_t labelHash;
+	bool isPlus;
+
+	for(;;) {
+		end = _aws_iot_mqtt_subscription_level_end(pFilter, filterLen, start);
+		if(SUBSCRIPTION_INDEX_TRIE_HASH == kind && end == filterLen) {
+			/* The '#' level itself is not a node */
+			break;
+		}
+
+		isPlus = (end - start == 1) && ('+' == pFilter[start]);
+		labelHash = isPlus ? 0 : aws_iot_hash_fnv1a(pFilter + start, end - start);
+		if(SUBSCRIPTION_INDEX_NO_NODE == node) {
+			child = 0;
+		} else if(isPlus) {
+			child = pIndex->pNodes[node].plusChild;
+		} else {
+			child = _aws_iot_mqtt_subscription_find_child(pIndex, node, labelHash, end - start);
+		}
+
+		if(0 == child) {
+			if(create) {
+				child = _aws_iot_mqtt_subscription_alloc_node(pIndex, node, isPlus, labelHash, end - start);
+			} else {
+				missing++;
+				child = SUBSCRIPTION_INDEX_NO_NODE;
+			}
+		}
+		node = child;
+
+		if(end == filterLen) {
+			break;
+		}
+		start = end + 1;
+	}
+
+	if(NULL != pMissing) {
+		*pMissing = missing;
+	}
+
+	return node;
+}
+
+static void _aws_iot_mqtt_subscription_mark(const SubscriptionIndex *pIndex, uint16_t handlerIndex,
+											const char *pTopicName, uint16_t topicNameLen, uint32_t *pMatched) {
+	uint32_t bit = 1u << (handlerIndex % 32);
+
+	if(0 == (pMatched[handlerIndex / 32] & bit)
+	   && aws_iot_mqtt_internal_is_handler_matched(&(pIndex->pHandlers[handlerIndex]), pTopicName, topicNameLen)) {
+		pMatched[handlerIndex / 32] |= bit;
+	}
+}
+
+static void _aws_iot_mqtt_subscription_mark_list(const SubscriptionIndex *pIndex, uint16_t head,
+												 const char *pTopicName, uint16_t topicNameLen, uint32_t *pMatched) {
+	while(0 != head) {
+		_aws_iot_mqtt_subscription_mark(pIndex, head - 1, pTopicName, topicNameLen, pMatched);
+		head = pIndex->pEntries[head - 1].next;
+	}
+}
+
+/* start is where the next level of the topic begins, topicNameLen + 1 once all levels are consumed */
+static void _aws_iot_mqtt_subscription_match_node(const SubscriptionIndex *pIndex, uint16_t node,
+												  const char *pTopicName, uint16_t topicNameLen, uint32_t start,
+												  uint32_t *pMatched) {
+	const SubscriptionTrieNode *pNode = &(pIndex->pNodes[node]);
+	uint16_t end, child;
+	uint32_t labelHash;
+
+	_aws_iot_mqtt_subscription_mark_list(pIndex, pNode->hashHead, pTopicName, topicNameLen, pMatched);
+
+	if(start > topicNameLen) {
+		_aws_iot_mqtt_subscription_mark_list(pIndex, pNode->exactHead, pTopicName, topicNameLen, pMatched);
+		return;
+	}
+
+	end = _aws_iot_mqtt_subscription_level_end(pTopicName, topicNameLen, (uint16_t) start);
+	if(0 != pNode->firstChild) {
+		labelHash = aws_iot_hash_fnv1a(pTopicName + start, end - start);
+		/* Levels with colliding hashes share a node, so there is at most one literal child to follow */
+		child = _aws_iot_mqtt_subscription_find_child(pIndex, node, labelHash, (uint16_t) (end - start));
+		if(0 != child) {
+			_aws_iot_mqtt_subscription_match_node(pIndex, child, pTopicName, topicNameLen, (uint32_t) end + 1,
+												  pMatched);
+		}
+	}
+	if(0 != pNode->plusChild) {
+		_aws_iot_mqtt_subscription_match_node(pIndex, pNode->plusChild, pTopicName, topicNameLen,
+											  (uint32_t) end + 1, pMatched);
+	}
+}
+
+IoT_Error_t aws_iot_mqtt_internal_subscription_index_init(SubscriptionIndex *pIndex, MessageHandlers *pHandlers,
+														  SubscriptionIndexEntry *pEntries, uint16_t handlerCount,
+														  uint16_t *pBuckets, uint16_t bucketCount,
+														  SubscriptionTrieNode *pNodes, uint16_t nodeCount) {
+	uint16_t i;
+
+	FUNC_ENTRY;
+
+	if(NULL == pIndex || NULL == pHandlers || NULL == pEntries || NULL == pBuckets || NULL == pNodes) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	if(bucketCount <= handlerCount || 0 == nodeCount) {
+		FUNC_EXIT_RC(FAILURE);
+	}
+
+	pIndex->pHandlers = pHandlers;
+	pIndex->pEntries = pEntries;
+	pIndex->handlerCount = handlerCount;
+	pIndex->pBuckets = pBuckets;
+	pIndex->bucketCount = bucketCount;
+	pIndex->pNodes = pNodes;
+	pIndex->nodeCount = nodeCount;
+	pIndex->fallbackHead = 0;
+
+	memset(pEntries, 0, handlerCount * sizeof(SubscriptionIndexEntry));
+	memset(pBuckets, 0, bucketCount * sizeof(uint16_t));
+	memset(pNodes, 0, nodeCount * sizeof(SubscriptionTrieNode));
+
+	/* Node 0 is the root, the rest go on the free list */
+	pIndex->freeNodeHead = 0;
+	for(i = nodeCount - 1; i > 0; i--) {
+		pNodes[i].nextSibling = pIndex->freeNodeHead;
+		pIndex->freeNodeHead = i;
+	}
+	pIndex->freeNodeCount = nodeCount - 1;
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+
+void aws_iot_mqtt_internal_subscription_index_add(SubscriptionIndex *pIndex, uint16_t handlerIndex) {
+	const MessageHandlers *pHandler;
+	SubscriptionIndexEntry *pEntry;
+	SubscriptionIndexKind kind;
+	uint16_t node, missing;
+
+	if(NULL == pIndex || handlerIndex >= pIndex->handlerCount) {
+		return;
+	}
+
+	pHandler = &(pIndex->pHandlers[handlerIndex]);
+	pEntry = &(pIndex->pEntries[handlerIndex]);
+	if(SUBSCRIPTION_INDEX_NONE != pEntry->kind) {
+		aws_iot_mqtt_internal_subscription_index_remove(pIndex, handlerIndex);
+	}
+	if(NULL == pHandler->topicName) {
+		return;
+	}
+
+	kind = _aws_iot_mqtt_subscription_classify(pHandler->topicName, pHandler->topicNameLen);
+	if(SUBSCRIPTION_INDEX_TRIE == kind || SUBSCRIPTION_INDEX_TRIE_HASH == kind) {
+		(void) _aws_iot_mqtt_subscription_walk(pIndex, pHandler->topicName, pHandler->topicNameLen, kind, false,
+											   &missing);
+		if(missing > pIndex->freeNodeCount) {
+			IOT_WARN("Subscription trie is full, %.*s will be matched linearly",
+					 pHandler->topicNameLen, pHandler->topicName);
+			kind = SUBSCRIPTION_INDEX_FALLBACK;
+		}
+	}
+
+	pEntry->kind = (uint8_t) kind;
+	switch(kind) {
+		case SUBSCRIPTION_INDEX_EXACT:
+			pEntry->hash = aws_iot_hash_fnv1a(pHandler->topicName, pHandler->topicNameLen);
+			_aws_iot_mqtt_subscription_hash_insert(pIndex, handlerIndex);
+			break;
+		case SUBSCRIPTION_INDEX_TRIE:
+		case SUBSCRIPTION_INDEX_TRIE_HASH:
+			node = _aws_iot_mqtt_subscription_walk(pIndex, pHandler->topicName, pHandler->topicNameLen, kind, true,
+												   NULL);
+			pEntry->node = node;
+			if(SUBSCRIPTION_INDEX_TRIE == kind) {
+				_aws_iot_mqtt_subscription_list_push(pIndex, &(pIndex->pNodes[node].exactHead), handlerIndex);
+			} else {
+				_aws_iot_mqtt_subscription_list_push(pIndex, &(pIndex->pNodes[node].hashHead), handlerIndex);
+			}
+			for(;;) {
+				pIndex->pNodes[node].refCount++;
+				if(0 == node) {
+					break;
+				}
+				node = pIndex->pNodes[node].parent;
+			}
+			break;
+		default:
+			_aws_iot_mqtt_subscription_list_push(pIndex, &(pIndex->fallbackHead), handlerIndex);
+			break;
+	}
+}
+
+void aws_iot_mqtt_internal_subscription_index_remove(SubscriptionIndex *pIndex, uint16_t handlerIndex) {
+	SubscriptionIndexEntry *pEntry;
+	uint16_t node, parent;
+
+	if(NULL == pIndex || handlerIndex >= pIndex->handlerCount) {
+		return;
+	}
+
+	pEntry = &(pIndex->pEntries[handlerIndex]);
+	switch(pEntry->kind) {
+		case SUBSCRIPTION_INDEX_EXACT:
+			_aws_iot_mqtt_subscription_hash_remove(pIndex, handlerIndex);
+			break;
+		case SUBSCRIPTION_INDEX_TRIE:
+		case SUBSCRIPTION_INDEX_TRIE_HASH:
+			node = pEntry->node;
+			if(SUBSCRIPTION_INDEX_TRIE == pEntry->kind) {
+				_aws_iot_mqtt_subscription_list_unlink(pIndex, &(pIndex->pNodes[node].exactHead), handlerIndex);
+			} else {
+				_aws_iot_mqtt_subscription_list_unlink(pIndex, &(pIndex->pNodes[node].hashHead), handlerIndex);
+			}
+			/* Release the path bottom up, dropping nodes no other filter goes through */
+			for(;;) {
+				pIndex->pNodes[node].refCount--;
+				if(0 == node) {
+					break;
+				}
+				parent = pIndex->pNodes[node].parent;
+				if(0 == pIndex->pNodes[node].refCount) {
+					_aws_iot_mqtt_subscription_free_node(pIndex, node);
+				}
+				node = parent;
+			}
+			break;
+		case SUBSCRIPTION_INDEX_FALLBACK:
+			_aws_iot_mqtt_subscription_list_unlink(pIndex, &(pIndex->fallbackHead), handlerIndex);
+			break;
+		default:
+			break;
+	}
+
+	memset(pEntry, 0, sizeof(SubscriptionIndexEntry));
+}
+
+/**
+ * Sets bit i of pMatched (handlerCount bits, cleared by the caller) for every
+ * handler i that a PUBLISH on pTopicName has to be delivered to.
+ */
+void aws_iot_mqtt_internal_subscription_index_match(const SubscriptionIndex *pIndex, const char *pTopicName,
+													uint16_t topicNameLen, uint32_t *pMatched) {
+	uint32_t hash;
+	uint16_t slot, bucket;
+
+	if(NULL == pIndex || NULL == pIndex->pHandlers || NULL == pTopicName || NULL == pMatched) {
+		return;
+	}
+
+	/* Exact filters with the same hash sit in one probe sequence */
+	hash = aws_iot_hash_fnv1a(pTopicName, topicNameLen);
+	slot = (uint16_t) (hash % pIndex->bucketCount);
+	while(0 != (bucket = pIndex->pBuckets[slot])) {
+		if(pIndex->pEntries[bucket - 1].hash == hash) {
+			_aws_iot_mqtt_subscription_mark(pIndex, bucket - 1, pTopicName, topicNameLen, pMatched);
+		}
+		slot = (uint16_t) ((slot + 1) % pIndex->bucketCount);
+	}
+
+	if(0 != pIndex->pNodes[0].refCount) {
+		_aws_iot_mqtt_subscription_match_node(pIndex, 0, pTopicName, topicNameLen, 0, pMatched);
+	}
+
+	_aws_iot_mqtt_subscription_mark_list(pIndex, pIndex->fallbackHead, pTopicName, topicNameLen, pMatched);
+}
+
+#ifdef __cplusplus
+}
+#endif
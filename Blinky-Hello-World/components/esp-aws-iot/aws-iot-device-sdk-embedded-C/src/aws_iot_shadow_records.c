@@ -29,8 +29,11 @@ extern "C" {
 
 #include "timer_interface.h"
 #include "aws_iot_json_utils.h"
+#include "aws_iot_json_stream.h"
+#include "aws_iot_hash.h"
 #include "aws_iot_log.h"
 #include "aws_iot_shadow_json.h"
+#include "aws_iot_shadow_key.h"
 #include "aws_iot_config.h"
 
 typedef struct {
@@ -40,6 +43,9 @@ typedef struct {
 	fpActionCallback_t callback;
 	void *pCallbackContext;
 	bool isFree;
+	bool isAckSubscriptionKept;
+	uint32_t clientTokenHash;
+	uint8_t nextInBucket;
 	Timer timer;
 } ToBeReceivedAckRecord_t;
 
@@ -48,6 +54,13 @@ typedef struct {
 	void *pStruct;
 	jsonStructCallback_t callback;
 	bool isFree;
+	uint32_t keyHash;
+	uint32_t keyLength;
+	uint32_t nextInBucket;
+	int32_t deltaKeyIndex;
+	uint32_t deltaValueOffset;	/* where the value of a large delta is kept in shadowRxBuf */
+	uint32_t deltaValueLength;
+	jsmntype_t deltaValueType;
 } JsonTokenTable_t;
 
 typedef struct {
@@ -61,7 +74,39 @@ typedef enum {
 	SHADOW_ACCEPTED, SHADOW_REJECTED, SHADOW_ACTION
 } ShadowAckTopicTypes_t;
 
+#define SHADOW_ACTION_TYPES (SHADOW_DELETE + 1)
+#define SHADOW_TOPIC_TYPES (SHADOW_ACTION + 1)
+
+/* Topics of a thing, formatted once. Subscriptions point to them, so an entry is only freed once they are gone */
+typedef struct {
+	char thingName[MAX_SIZE_OF_THING_NAME];
+	char topic[SHADOW_ACTION_TYPES][SHADOW_TOPIC_TYPES][MAX_SHADOW_TOPIC_LENGTH_BYTES];
+	uint16_t topicLen[SHADOW_ACTION_TYPES][SHADOW_TOPIC_TYPES];
+	bool isAckSubscribed[SHADOW_ACTION_TYPES];
+	bool isFree;
+} ThingTopics_t;
+
+/* A delta document too large for shadowRxBuf, tokenized as it arrives */
+typedef struct {
+	JsonStreamParser_t parser;
+	bool isActive;
+	bool isIgnored;
+	bool isVersionSeen;
+	bool isInState;	/* inside the top-level "state" object */
+	bool isTerminated;	/* a null was received, what follows it is not part of the document */
+	uint32_t versionNumber;
+	uint32_t valuesLength;	/* bytes of shadowRxBuf taken by the values kept so far */
+	uint16_t metadataDepth;	/* depth + 1 of the metadata object being skipped, 0 if none */
+	bool hasPendingContainer[JSON_STREAM_MAX_DEPTH];
+} DeltaStream_t;
+
 ToBeReceivedAckRecord_t AckWaitList[MAX_ACKS_TO_COMEIN_AT_ANY_GIVEN_TIME];
+/* Chains of AckWaitList entries by client token hash, holding index + 1 so 0 ends a chain */
+#define ACK_WAIT_LIST_BUCKETS MAX_ACKS_TO_COMEIN_AT_ANY_GIVEN_TIME
+static uint8_t ackWaitListBuckets[ACK_WAIT_LIST_BUCKETS];
+
+static ThingTopics_t thingTopicsCache[SHADOW_MAX_CACHED_THING_TOPICS];
+static bool isAckSubscriptionPersistent = false;
 
 AWS_IoT_Client *pMqttClient;
 
@@ -78,7 +123,11 @@ char shadowRxBuf[SHADOW_MAX_SIZE_OF_RX_BUFFER];
 
 static JsonTokenTable_t tokenTable[MAX_JSON_TOKEN_EXPECTED];
 static uint32_t tokenTableIndex = 0;
+/* Chains of tokenTable entries by key hash, holding index + 1 so 0 ends a chain */
+#define TOKEN_TABLE_BUCKETS MAX_JSON_TOKEN_EXPECTED
+static uint32_t tokenTableBuckets[TOKEN_TABLE_BUCKETS];
 static bool deltaTopicSubscribedFlag = false;
+static DeltaStream_t deltaStream;
 uint32_t shadowJsonVersionNum = 0;
 bool shadowDiscardOldDeltaFlag = true;
 
@@ -89,6 +138,8 @@ static void AckStatusCallback(AWS_IoT_Client *pClient, char *topicName,
 static void shadow_delta_callback(AWS_IoT_Client *pClient, char *topicName,
 								  uint16_t topicNameLen, IoT_Publish_Message_Params *params, void *pData);
 
+static void shadow_delta_stream(const IoT_Publish_Message_Params *params);
+
 static void topicNameFromThingAndAction(char *pTopic, const char *pThingName, ShadowActions_t action,
 										ShadowAckTopicTypes_t ackType);
 
@@ -96,11 +147,22 @@ static int16_t getNextFreeIndexOfSubscriptionList(void);
 
 static void unsubscribeFromAcceptedAndRejected(uint8_t index);
 
+static void removeFromAckWaitList(uint8_t index);
+
+/* Whether pEntry is registered for the key and has not been seen in the current delta yet */
+static bool isUnseenDeltaKey(const JsonTokenTable_t *pEntry, const char *pKey, uint32_t keyLength, uint32_t keyHash) {
+	return !pEntry->isFree && 0 == pEntry->deltaKeyIndex && pEntry->keyHash == keyHash &&
+		   pEntry->keyLength == keyLength && strncmp(pEntry->pKey, pKey, keyLength) == 0;
+}
+
 void initDeltaTokens(void) {
 	uint32_t i;
 	for(i = 0; i < MAX_JSON_TOKEN_EXPECTED; i++) {
 		tokenTable[i].isFree = true;
 	}
+	for(i = 0; i < TOKEN_TABLE_BUCKETS; i++) {
+		tokenTableBuckets[i] = 0;
+	}
 	tokenTableIndex = 0;
 	deltaTopicSubscribedFlag = false;
 }
@@ -108,11 +170,12 @@ void initDeltaTokens(void) {
 IoT_Error_t registerJsonTokenOnDelta(jsonStruct_t *pStruct) {
 
 	IoT_Error_t rc = SUCCESS;
+	uint32_t bucket;
 
 	if(!deltaTopicSubscribedFlag) {
 		snprintf(shadowDeltaTopic, MAX_SHADOW_TOPIC_LENGTH_BYTES, "$aws/things/%s/shadow/update/delta", myThingName);
-		rc = aws_iot_mqtt_subscribe(pMqttClient, shadowDeltaTopic, (uint16_t) strlen(shadowDeltaTopic), QOS0,
-									shadow_delta_callback, NULL);
+		rc = aws_iot_mqtt_subscribe_fragmented(pMqttClient, shadowDeltaTopic, (uint16_t) strlen(shadowDeltaTopic),
+											   QOS0, shadow_delta_callback, NULL);
 		deltaTopicSubscribedFlag = true;
 	}
 
@@ -124,6 +187,11 @@ IoT_Error_t registerJsonTokenOnDelta(jsonStruct_t *pStruct) {
 	tokenTable[tokenTableIndex].callback = pStruct->cb;
 	tokenTable[tokenTableIndex].pStruct = pStruct;
 	tokenTable[tokenTableIndex].isFree = false;
+	tokenTable[tokenTableIndex].keyLength = (uint32_t) strlen(pStruct->pKey);
+	tokenTable[tokenTableIndex].keyHash = aws_iot_hash_fnv1a(pStruct->pKey, tokenTable[tokenTableIndex].keyLength);
+	bucket = tokenTable[tokenTableIndex].keyHash % TOKEN_TABLE_BUCKETS;
+	tokenTable[tokenTableIndex].nextInBucket = tokenTableBuckets[bucket];
+	tokenTableBuckets[bucket] = tokenTableIndex + 1;
 	tokenTableIndex++;
 
 	return rc;
@@ -168,6 +236,57 @@ static void topicNameFromThingAndAction(char *pTopic, const char *pThingName, Sh
 	}
 }
 
+/* Cached topics of the thing, cached now if there is room. NULL if the cache is full */
+static ThingTopics_t *getThingTopics(const char *pThingName) {
+	uint8_t i;
+	ShadowActions_t action;
+	ShadowAckTopicTypes_t topicType;
+	ThingTopics_t *pFree = NULL;
+
+	if(strlen(pThingName) >= MAX_SIZE_OF_THING_NAME) {
+		return NULL;
+	}
+
+	for(i = 0; i < SHADOW_MAX_CACHED_THING_TOPICS; i++) {
+		if(!thingTopicsCache[i].isFree) {
+			if(strcmp(pThingName, thingTopicsCache[i].thingName) == 0) {
+				return &(thingTopicsCache[i]);
+			}
+		} else if(NULL == pFree) {
+			pFree = &(thingTopicsCache[i]);
+		}
+	}
+
+	if(NULL == pFree) {
+		return NULL;
+	}
+
+	snprintf(pFree->thingName, MAX_SIZE_OF_THING_NAME, "%s", pThingName);
+	for(action = SHADOW_GET; action < SHADOW_ACTION_TYPES; action++) {
+		for(topicType = SHADOW_ACCEPTED; topicType < SHADOW_TOPIC_TYPES; topicType++) {
+			topicNameFromThingAndAction(pFree->topic[action][topicType], pThingName, action, topicType);
+			pFree->topicLen[action][topicType] = (uint16_t) strlen(pFree->topic[action][topicType]);
+		}
+		pFree->isAckSubscribed[action] = false;
+	}
+	pFree->isFree = false;
+
+	return pFree;
+}
+
+/* Topic from the cache, or formatted into pBuffer for a thing that is not cached */
+static const char *shadowTopic(const char *pThingName, ShadowActions_t action, ShadowAckTopicTypes_t topicType,
+							   char *pBuffer) {
+	ThingTopics_t *pThingTopics = getThingTopics(pThingName);
+
+	if(NULL != pThingTopics) {
+		return pThingTopics->topic[action][topicType];
+	}
+
+	topicNameFromThingAndAction(pBuffer, pThingName, action, topicType);
+	return pBuffer;
+}
+
 static bool isValidShadowVersionUpdate(const char *pTopicName) {
 	if(strstr(pTopicName, myThingName) != NULL &&
 	   ((strstr(pTopicName, "get/accepted") != NULL) ||
@@ -181,6 +300,8 @@ static void AckStatusCallback(AWS_IoT_Client *pClient, char *topicName, uint16_t
 							  IoT_Publish_Message_Params *params, void *pData) {
 	int32_t tokenCount;
 	uint8_t i;
+	uint8_t next;
+	uint32_t tokenHash;
 	void *pJsonHandler = NULL;
 	char temporaryClientToken[MAX_SIZE_CLIENT_TOKEN_CLIENT_SEQUENCE];
 
@@ -211,24 +332,27 @@ static void AckStatusCallback(AWS_IoT_Client *pClient, char *topicName, uint16_t
 	}
 
 	if(extractClientToken(shadowRxBuf, SHADOW_MAX_SIZE_OF_RX_BUFFER, temporaryClientToken, MAX_SIZE_CLIENT_TOKEN_CLIENT_SEQUENCE)) {
-		for(i = 0; i < MAX_ACKS_TO_COMEIN_AT_ANY_GIVEN_TIME; i++) {
-			if(!AckWaitList[i].isFree) {
-				if(strcmp(AckWaitList[i].clientTokenID, temporaryClientToken) == 0) {
-					Shadow_Ack_Status_t status = SHADOW_ACK_REJECTED;
-					if(strstr(topicName, "accepted") != NULL) {
-						status = SHADOW_ACK_ACCEPTED;
-					} else if(strstr(topicName, "rejected") != NULL) {
-						status = SHADOW_ACK_REJECTED;
+		tokenHash = aws_iot_hash_fnv1a(temporaryClientToken, strlen(temporaryClientToken));
+		for(next = ackWaitListBuckets[tokenHash % ACK_WAIT_LIST_BUCKETS]; 0 != next; next = AckWaitList[i].nextInBucket) {
+			i = (uint8_t) (next - 1);
+			if(AckWaitList[i].clientTokenHash == tokenHash &&
+			   strcmp(AckWaitList[i].clientTokenID, temporaryClientToken) == 0) {
+				Shadow_Ack_Status_t status = SHADOW_ACK_REJECTED;
+				if(strstr(topicName, "accepted") != NULL) {
+					status = SHADOW_ACK_ACCEPTED;
+				} else if(strstr(topicName, "rejected") != NULL) {
+					status = SHADOW_ACK_REJECTED;
+				}
+				if(status == SHADOW_ACK_ACCEPTED || status == SHADOW_ACK_REJECTED) {
+					if(AckWaitList[i].callback != NULL) {
+						AckWaitList[i].callback(AckWaitList[i].thingName, AckWaitList[i].action, status,
+												shadowRxBuf, AckWaitList[i].pCallbackContext);
 					}
-					if(status == SHADOW_ACK_ACCEPTED || status == SHADOW_ACK_REJECTED) {
-						if(AckWaitList[i].callback != NULL) {
-							AckWaitList[i].callback(AckWaitList[i].thingName, AckWaitList[i].action, status,
-													shadowRxBuf, AckWaitList[i].pCallbackContext);
-						}
+					if(!AckWaitList[i].isAckSubscriptionKept) {
 						unsubscribeFromAcceptedAndRejected(i);
-						AckWaitList[i].isFree = true;
-						return;
 					}
+					removeFromAckWaitList(i);
+					return;
 				}
 			}
 		}
@@ -249,16 +373,18 @@ static int16_t findIndexOfSubscriptionList(const char *pTopic) {
 
 static void unsubscribeFromAcceptedAndRejected(uint8_t index) {
 
-	char TemporaryTopicNameAccepted[MAX_SHADOW_TOPIC_LENGTH_BYTES];
-	char TemporaryTopicNameRejected[MAX_SHADOW_TOPIC_LENGTH_BYTES];
+	char topicBufferAccepted[MAX_SHADOW_TOPIC_LENGTH_BYTES];
+	char topicBufferRejected[MAX_SHADOW_TOPIC_LENGTH_BYTES];
+	const char *TemporaryTopicNameAccepted;
+	const char *TemporaryTopicNameRejected;
 	IoT_Error_t ret_val = SUCCESS;
 
 	int16_t indexSubList;
 
-	topicNameFromThingAndAction(TemporaryTopicNameAccepted, AckWaitList[index].thingName, AckWaitList[index].action,
-								SHADOW_ACCEPTED);
-	topicNameFromThingAndAction(TemporaryTopicNameRejected, AckWaitList[index].thingName, AckWaitList[index].action,
-								SHADOW_REJECTED);
+	TemporaryTopicNameAccepted = shadowTopic(AckWaitList[index].thingName, AckWaitList[index].action, SHADOW_ACCEPTED,
+											 topicBufferAccepted);
+	TemporaryTopicNameRejected = shadowTopic(AckWaitList[index].thingName, AckWaitList[index].action, SHADOW_REJECTED,
+											 topicBufferRejected);
 
 	indexSubList = findIndexOfSubscriptionList(TemporaryTopicNameAccepted);
 	if((indexSubList >= 0)) {
@@ -287,18 +413,62 @@ static void unsubscribeFromAcceptedAndRejected(uint8_t index) {
 	}
 }
 
-void initializeRecords(AWS_IoT_Client *pClient) {
+void initThingTopics(void) {
+	uint8_t i;
+
+	/* The client was initialized too, so no subscription points to the cache */
+	for(i = 0; i < SHADOW_MAX_CACHED_THING_TOPICS; i++) {
+		thingTopicsCache[i].isFree = true;
+	}
+}
+
+/* Drops the ack subscriptions kept for a thing, as the new connection is a clean session. Returns false if a
+ * subscription could not be removed, its handler still points to the entry then. */
+static bool unsubscribeThingTopics(AWS_IoT_Client *pClient, ThingTopics_t *pThingTopics) {
+	ShadowActions_t action;
+	ShadowAckTopicTypes_t topicType;
+	bool isUnsubscribed = true;
+
+	for(action = SHADOW_GET; action < SHADOW_ACTION_TYPES; action++) {
+		if(!pThingTopics->isAckSubscribed[action]) {
+			continue;
+		}
+		for(topicType = SHADOW_ACCEPTED; topicType <= SHADOW_REJECTED; topicType++) {
+			if(SUCCESS != aws_iot_mqtt_unsubscribe(pClient, pThingTopics->topic[action][topicType],
+												   pThingTopics->topicLen[action][topicType])) {
+				IOT_WARN("Failed to unsubscribe from %s", pThingTopics->topic[action][topicType]);
+				isUnsubscribed = false;
+			}
+		}
+	}
+
+	return isUnsubscribed;
+}
+
+void initializeRecords(AWS_IoT_Client *pClient, bool persistentAckSubscriptions) {
 	uint8_t i;
 	for(i = 0; i < MAX_ACKS_TO_COMEIN_AT_ANY_GIVEN_TIME; i++) {
 		AckWaitList[i].isFree = true;
 	}
+	for(i = 0; i < ACK_WAIT_LIST_BUCKETS; i++) {
+		ackWaitListBuckets[i] = 0;
+	}
 	for(i = 0; i < MAX_TOPICS_AT_ANY_GIVEN_TIME; i++) {
 		SubscriptionList[i].isFree = true;
 		SubscriptionList[i].count = 0;
 		SubscriptionList[i].isSticky = false;
 	}
+	for(i = 0; i < SHADOW_MAX_CACHED_THING_TOPICS; i++) {
+		if(!thingTopicsCache[i].isFree && unsubscribeThingTopics(pClient, &(thingTopicsCache[i]))) {
+			thingTopicsCache[i].isFree = true;
+		}
+	}
 
 	pMqttClient = pClient;
+	isAckSubscriptionPersistent = persistentAckSubscriptions;
+
+	/* The own thing is cached first, so it always has a place */
+	(void) getThingTopics(myThingName);
 }
 
 bool isSubscriptionPresent(const char *pThingName, ShadowActions_t action) {
@@ -306,11 +476,10 @@ bool isSubscriptionPresent(const char *pThingName, ShadowActions_t action) {
 	uint8_t i = 0;
 	bool isAcceptedPresent = false;
 	bool isRejectedPresent = false;
-	char TemporaryTopicNameAccepted[MAX_SHADOW_TOPIC_LENGTH_BYTES];
-	char TemporaryTopicNameRejected[MAX_SHADOW_TOPIC_LENGTH_BYTES];
-
-	topicNameFromThingAndAction(TemporaryTopicNameAccepted, pThingName, action, SHADOW_ACCEPTED);
-	topicNameFromThingAndAction(TemporaryTopicNameRejected, pThingName, action, SHADOW_REJECTED);
+	char topicBufferAccepted[MAX_SHADOW_TOPIC_LENGTH_BYTES];
+	char topicBufferRejected[MAX_SHADOW_TOPIC_LENGTH_BYTES];
+	const char *TemporaryTopicNameAccepted = shadowTopic(pThingName, action, SHADOW_ACCEPTED, topicBufferAccepted);
+	const char *TemporaryTopicNameRejected = shadowTopic(pThingName, action, SHADOW_REJECTED, topicBufferRejected);
 
 	for(i = 0; i < MAX_TOPICS_AT_ANY_GIVEN_TIME; i++) {
 		if(!SubscriptionList[i].isFree) {
@@ -385,11 +554,11 @@ IoT_Error_t subscribeToShadowActionAcks(const char *pThingName, ShadowActions_t
 }
 
 void incrementSubscriptionCnt(const char *pThingName, ShadowActions_t action, bool isSticky) {
-	char TemporaryTopicNameAccepted[MAX_SHADOW_TOPIC_LENGTH_BYTES];
-	char TemporaryTopicNameRejected[MAX_SHADOW_TOPIC_LENGTH_BYTES];
+	char topicBufferAccepted[MAX_SHADOW_TOPIC_LENGTH_BYTES];
+	char topicBufferRejected[MAX_SHADOW_TOPIC_LENGTH_BYTES];
+	const char *TemporaryTopicNameAccepted = shadowTopic(pThingName, action, SHADOW_ACCEPTED, topicBufferAccepted);
+	const char *TemporaryTopicNameRejected = shadowTopic(pThingName, action, SHADOW_REJECTED, topicBufferRejected);
 	uint8_t i;
-	topicNameFromThingAndAction(TemporaryTopicNameAccepted, pThingName, action, SHADOW_ACCEPTED);
-	topicNameFromThingAndAction(TemporaryTopicNameRejected, pThingName, action, SHADOW_REJECTED);
 
 	for(i = 0; i < MAX_TOPICS_AT_ANY_GIVEN_TIME; i++) {
 		if(!SubscriptionList[i].isFree) {
@@ -402,16 +571,59 @@ void incrementSubscriptionCnt(const char *pThingName, ShadowActions_t action, bo
 	}
 }
 
+bool canKeepShadowActionAcks(const char *pThingName) {
+	return isAckSubscriptionPersistent && NULL != getThingTopics(pThingName);
+}
+
+IoT_Error_t subscribeToShadowActionAcksOnce(const char *pThingName, ShadowActions_t action) {
+	IoT_Error_t ret_val;
+	Timer subSettlingtimer;
+	ThingTopics_t *pThingTopics = getThingTopics(pThingName);
+
+	if(NULL == pThingTopics) {
+		return FAILURE;
+	}
+
+	if(pThingTopics->isAckSubscribed[action]) {
+		return SUCCESS;
+	}
+
+	/* Auto-reconnect restores them with the other subscriptions of the client */
+	ret_val = aws_iot_mqtt_subscribe(pMqttClient, pThingTopics->topic[action][SHADOW_ACCEPTED],
+									 pThingTopics->topicLen[action][SHADOW_ACCEPTED], QOS0, AckStatusCallback, NULL);
+	if(SUCCESS != ret_val) {
+		return ret_val;
+	}
+
+	ret_val = aws_iot_mqtt_subscribe(pMqttClient, pThingTopics->topic[action][SHADOW_REJECTED],
+									 pThingTopics->topicLen[action][SHADOW_REJECTED], QOS0, AckStatusCallback, NULL);
+	if(SUCCESS != ret_val) {
+		aws_iot_mqtt_unsubscribe(pMqttClient, pThingTopics->topic[action][SHADOW_ACCEPTED],
+								 pThingTopics->topicLen[action][SHADOW_ACCEPTED]);
+		return ret_val;
+	}
+
+	pThingTopics->isAckSubscribed[action] = true;
+
+	// wait for SUBSCRIBE_SETTLING_TIME seconds to let the subscription take effect
+	init_timer(&subSettlingtimer);
+	countdown_sec(&subSettlingtimer, SUBSCRIBE_SETTLING_TIME);
+	while(!has_timer_expired(&subSettlingtimer));
+
+	return SUCCESS;
+}
+
 IoT_Error_t publishToShadowAction(const char *pThingName, ShadowActions_t action, const char *pJsonDocumentToBeSent) {
 	IoT_Error_t ret_val = SUCCESS;
-	char TemporaryTopicName[MAX_SHADOW_TOPIC_LENGTH_BYTES];
+	char topicBuffer[MAX_SHADOW_TOPIC_LENGTH_BYTES];
+	const char *TemporaryTopicName;
 	IoT_Publish_Message_Params msgParams;
 
 	if(NULL == pThingName || NULL == pJsonDocumentToBeSent) {
 		return NULL_VALUE_ERROR;
 	}
 
-	topicNameFromThingAndAction(TemporaryTopicName, pThingName, action, SHADOW_ACTION);
+	TemporaryTopicName = shadowTopic(pThingName, action, SHADOW_ACTION, topicBuffer);
 
 	msgParams.qos = QOS0;
 	msgParams.isRetained = 0;
@@ -443,17 +655,39 @@ bool getNextFreeIndexOfAckWaitList(uint8_t *pIndex) {
 
 void addToAckWaitList(uint8_t indexAckWaitList, const char *pThingName, ShadowActions_t action,
 					  const char *pExtractedClientToken, fpActionCallback_t callback, void *pCallbackContext,
-					  uint32_t timeout_seconds) {
+					  uint32_t timeout_seconds, bool isAckSubscriptionKept) {
+	uint32_t bucket;
+
 	AckWaitList[indexAckWaitList].callback = callback;
 	memcpy(AckWaitList[indexAckWaitList].clientTokenID, pExtractedClientToken, MAX_SIZE_CLIENT_ID_WITH_SEQUENCE);
 	memcpy(AckWaitList[indexAckWaitList].thingName, pThingName, MAX_SIZE_OF_THING_NAME);
 	AckWaitList[indexAckWaitList].pCallbackContext = pCallbackContext;
 	AckWaitList[indexAckWaitList].action = action;
+	AckWaitList[indexAckWaitList].isAckSubscriptionKept = isAckSubscriptionKept;
 	init_timer(&(AckWaitList[indexAckWaitList].timer));
 	countdown_sec(&(AckWaitList[indexAckWaitList].timer), timeout_seconds);
+	AckWaitList[indexAckWaitList].clientTokenHash =
+			aws_iot_hash_fnv1a(AckWaitList[indexAckWaitList].clientTokenID,
+							   strlen(AckWaitList[indexAckWaitList].clientTokenID));
+	bucket = AckWaitList[indexAckWaitList].clientTokenHash % ACK_WAIT_LIST_BUCKETS;
+	AckWaitList[indexAckWaitList].nextInBucket = ackWaitListBuckets[bucket];
+	ackWaitListBuckets[bucket] = (uint8_t) (indexAckWaitList + 1);
 	AckWaitList[indexAckWaitList].isFree = false;
 }
 
+static void removeFromAckWaitList(uint8_t index) {
+	uint8_t *pNext = &(ackWaitListBuckets[AckWaitList[index].clientTokenHash % ACK_WAIT_LIST_BUCKETS]);
+
+	while(0 != *pNext) {
+		if(*pNext == index + 1) {
+			*pNext = AckWaitList[index].nextInBucket;
+			break;
+		}
+		pNext = &(AckWaitList[*pNext - 1].nextInBucket);
+	}
+	AckWaitList[index].isFree = true;
+}
+
 void HandleExpiredResponseCallbacks(void) {
 	uint8_t i;
 	for(i = 0; i < MAX_ACKS_TO_COMEIN_AT_ANY_GIVEN_TIME; i++) {
@@ -463,8 +697,10 @@ void HandleExpiredResponseCallbacks(void) {
 					AckWaitList[i].callback(AckWaitList[i].thingName, AckWaitList[i].action, SHADOW_ACK_TIMEOUT,
 											shadowRxBuf, AckWaitList[i].pCallbackContext);
 				}
-				AckWaitList[i].isFree = true;
-				unsubscribeFromAcceptedAndRejected(i);
+				removeFromAckWaitList(i);
+				if(!AckWaitList[i].isAckSubscriptionKept) {
+					unsubscribeFromAcceptedAndRejected(i);
+				}
 			}
 		}
 	}
@@ -473,10 +709,7 @@ void HandleExpiredResponseCallbacks(void) {
 static void shadow_delta_callback(AWS_IoT_Client *pClient, char *topicName,
 								  uint16_t topicNameLen, IoT_Publish_Message_Params *params, void *pData) {
 	int32_t tokenCount;
-	uint32_t i = 0;
 	void *pJsonHandler = NULL;
-	int32_t DataPosition;
-	uint32_t dataLength;
 	uint32_t tempVersionNumber = 0;
 
 	FUNC_ENTRY;
@@ -486,8 +719,9 @@ static void shadow_delta_callback(AWS_IoT_Client *pClient, char *topicName,
 	IOT_UNUSED(topicNameLen);
 	IOT_UNUSED(pData);
 
-	if(params->payloadLen >= SHADOW_MAX_SIZE_OF_RX_BUFFER) {
-		IOT_WARN("Payload larger than RX Buffer");
+	/* Deltas too large for the RX buffer are tokenized in place, fragment by fragment */
+	if(params->payloadLen >= SHADOW_MAX_SIZE_OF_RX_BUFFER || params->payloadLen != params->totalPayloadLen) {
+		shadow_delta_stream(params);
 		return;
 	}
 
@@ -511,12 +745,46 @@ static void shadow_delta_callback(AWS_IoT_Client *pClient, char *topicName,
 		}
 	}
 
+	dispatchDeltaJsonTokens(shadowRxBuf, pJsonHandler, tokenCount);
+}
+
+void dispatchDeltaJsonTokens(const char *pJsonDocument, void *pJsonHandler, int32_t tokenCount) {
+	uint32_t i, entry;
+	int32_t keyIndex, stateEnd;
+	const char *pKey;
+	uint32_t keyLength, keyHash;
+	int32_t DataPosition;
+	uint32_t dataLength;
+	JsonTokenTable_t *pEntry;
+
+	for(i = 0; i < tokenTableIndex; i++) {
+		tokenTable[i].deltaKeyIndex = 0;
+	}
+
+	/* Single pass over "state", each key is looked up among the registered ones. The "state" key is
+	 * itself matched so that it can be registered to get the whole state. As with
+	 * isJsonKeyMatchingAndUpdateValue(), the first occurrence of a key is the one used. */
+	pKey = "state";
+	keyLength = (uint32_t) strlen(pKey);
+	for(keyIndex = findJsonStateKey(pJsonDocument, pJsonHandler, tokenCount, &stateEnd);
+		keyIndex > 0 && keyIndex < stateEnd;
+		keyIndex = findNextJsonKey(pJsonDocument, pJsonHandler, tokenCount, keyIndex, &pKey, &keyLength)) {
+		keyHash = aws_iot_hash_fnv1a(pKey, keyLength);
+		for(entry = tokenTableBuckets[keyHash % TOKEN_TABLE_BUCKETS]; 0 != entry; entry = pEntry->nextInBucket) {
+			pEntry = &tokenTable[entry - 1];
+			if(isUnseenDeltaKey(pEntry, pKey, keyLength, keyHash)) {
+				pEntry->deltaKeyIndex = keyIndex;
+			}
+		}
+	}
+
+	/* Callbacks still run in registration order */
 	for(i = 0; i < tokenTableIndex; i++) {
-		if(!tokenTable[i].isFree) {
-			if(isJsonKeyMatchingAndUpdateValue(shadowRxBuf, pJsonHandler, tokenCount,
-											   (jsonStruct_t *) tokenTable[i].pStruct, &dataLength, &DataPosition)) {
+		if(!tokenTable[i].isFree && 0 != tokenTable[i].deltaKeyIndex) {
+			if(updateValueOfJsonKey(pJsonDocument, pJsonHandler, tokenCount, tokenTable[i].deltaKeyIndex,
+									(jsonStruct_t *) tokenTable[i].pStruct, &dataLength, &DataPosition)) {
 				if(tokenTable[i].callback != NULL) {
-					tokenTable[i].callback(shadowRxBuf + DataPosition, dataLength,
+					tokenTable[i].callback(pJsonDocument + DataPosition, dataLength,
 										   (jsonStruct_t *) tokenTable[i].pStruct);
 				}
 			}
@@ -524,6 +792,206 @@ static void shadow_delta_callback(AWS_IoT_Client *pClient, char *topicName,
 	}
 }
 
+/* Keeps a value of a large delta in shadowRxBuf, which the document itself does not use, until the
+ * whole document is in and its version was checked */
+static void keepDeltaValue(DeltaStream_t *pStream, JsonTokenTable_t *pEntry, const char *pValue,
+						   uint32_t valueLength, jsmntype_t valueType) {
+	pEntry->deltaKeyIndex = 1;
+	if(valueLength >= SHADOW_MAX_SIZE_OF_RX_BUFFER - pStream->valuesLength) {
+		IOT_WARN("Values of the delta do not fit the receive buffer - Ignoring %s", pEntry->pKey);
+		return;
+	}
+
+	/* Followed by a terminating null, as updateValueOfJsonText() needs */
+	memcpy(shadowRxBuf + pStream->valuesLength, pValue, valueLength);
+	shadowRxBuf[pStream->valuesLength + valueLength] = '\0';
+	pEntry->deltaValueOffset = pStream->valuesLength;
+	pEntry->deltaValueLength = valueLength;
+	pEntry->deltaValueType = valueType;
+	pEntry->deltaKeyIndex = 2;
+	pStream->valuesLength += valueLength + 1;
+}
+
+/* Same rules as dispatchDeltaJsonTokens(), applied as the keys go by. A value is kept when it
+ * arrives, an object or array when it closes, and nothing is dispatched before the document is
+ * complete since the service sends "version" after the state. tokenTable entries waiting for a
+ * container to close have deltaKeyIndex set to -(depth + 1), those with a value kept to 2. */
+static void shadow_delta_stream_event(const JsonStreamEvent_t *pEvent, void *pUserData) {
+	DeltaStream_t *pStream = (DeltaStream_t *) pUserData;
+	uint32_t i, entry, keyHash;
+	bool isStateKey;
+	JsonTokenTable_t *pEntry;
+	jsonStruct_t version;
+
+	if(pStream->isIgnored) {
+		return;
+	}
+
+	if(0 == pEvent->depth) {
+		/* As in isJsonValidAndParse() */
+		if(JSON_STREAM_EVENT_OBJECT_START != pEvent->type && JSON_STREAM_EVENT_OBJECT_END != pEvent->type) {
+			IOT_WARN("Top Level is not an object");
+			pStream->isIgnored = true;
+		}
+		return;
+	}
+
+	if(JSON_STREAM_EVENT_OBJECT_END == pEvent->type || JSON_STREAM_EVENT_ARRAY_END == pEvent->type) {
+		if(1 == pEvent->depth) {
+			pStream->isInState = false;
+		}
+		if(pStream->metadataDepth == pEvent->depth + 1) {
+			pStream->metadataDepth = 0;
+		}
+		if(0 != pStream->metadataDepth || !pStream->hasPendingContainer[pEvent->depth]) {
+			return;
+		}
+
+		pStream->hasPendingContainer[pEvent->depth] = false;
+		for(i = 0; i < tokenTableIndex; i++) {
+			if(!tokenTable[i].isFree && -((int32_t) pEvent->depth + 1) == tokenTable[i].deltaKeyIndex) {
+				tokenTable[i].deltaKeyIndex = 1;
+				if(NULL == pEvent->pValue) {
+					IOT_WARN("Value of %s does not fit one fragment - Ignoring", tokenTable[i].pKey);
+				} else {
+					keepDeltaValue(pStream, &tokenTable[i], pEvent->pValue, pEvent->valueLength, pEvent->valueType);
+				}
+			}
+		}
+		return;
+	}
+
+	if(0 != pStream->metadataDepth || NULL == pEvent->pKey) {
+		return;
+	}
+
+	/* As with extractVersionNumber(), the first version found is the one checked */
+	if(JSON_STREAM_EVENT_VALUE == pEvent->type && !pStream->isVersionSeen &&
+	   strlen(SHADOW_VERSION_STRING) == pEvent->keyLength &&
+	   strncmp(pEvent->pKey, SHADOW_VERSION_STRING, pEvent->keyLength) == 0) {
+		version.pKey = SHADOW_VERSION_STRING;
+		version.pData = &(pStream->versionNumber);
+		version.dataLength = sizeof(pStream->versionNumber);
+		version.type = SHADOW_JSON_UINT32;
+		version.cb = NULL;
+		pStream->isVersionSeen = updateValueOfJsonText(pEvent->pValue, pEvent->valueLength, pEvent->valueType,
+													   &version);
+	}
+
+	/* Only "state" and the keys inside it are matched, as in dispatchDeltaJsonTokens() */
+	isStateKey = 1 == pEvent->depth && strlen("state") == pEvent->keyLength &&
+				 strncmp(pEvent->pKey, "state", pEvent->keyLength) == 0;
+	if(isStateKey && JSON_STREAM_EVENT_OBJECT_START == pEvent->type) {
+		pStream->isInState = true;
+	} else if(!isStateKey && !pStream->isInState) {
+		return;
+	}
+
+	keyHash = aws_iot_hash_fnv1a(pEvent->pKey, pEvent->keyLength);
+	for(entry = tokenTableBuckets[keyHash % TOKEN_TABLE_BUCKETS]; 0 != entry; entry = pEntry->nextInBucket) {
+		pEntry = &tokenTable[entry - 1];
+		if(!isUnseenDeltaKey(pEntry, pEvent->pKey, pEvent->keyLength, keyHash)) {
+			continue;
+		}
+		if(JSON_STREAM_EVENT_VALUE != pEvent->type) {
+			pEntry->deltaKeyIndex = -((int32_t) pEvent->depth + 1);
+			pStream->hasPendingContainer[pEvent->depth] = true;
+			continue;
+		}
+		pEntry->deltaKeyIndex = 1;
+		if(NULL == pEvent->pValue) {
+			IOT_WARN("Value of %s is too long to put together - Ignoring", pEntry->pKey);
+			continue;
+		}
+		keepDeltaValue(pStream, pEntry, pEvent->pValue, pEvent->valueLength, pEvent->valueType);
+	}
+
+	/* Keys inside metadata are not matched, see findNextJsonKey() */
+	if(JSON_STREAM_EVENT_OBJECT_START == pEvent->type && strlen("metadata") == pEvent->keyLength &&
+	   strncmp(pEvent->pKey, "metadata", pEvent->keyLength) == 0) {
+		pStream->metadataDepth = pEvent->depth + 1;
+	}
+}
+
+/* Checks the version of a complete large delta, as shadow_delta_callback() does, then runs the
+ * callbacks on the values kept in registration order */
+static void shadow_delta_stream_dispatch(const DeltaStream_t *pStream) {
+	uint32_t i;
+	const char *pValue;
+
+	if(shadowDiscardOldDeltaFlag && pStream->isVersionSeen) {
+		if(pStream->versionNumber > shadowJsonVersionNum) {
+			shadowJsonVersionNum = pStream->versionNumber;
+		} else {
+			IOT_WARN("Old Delta Message received - Ignoring rx: %d local: %d", pStream->versionNumber,
+					 shadowJsonVersionNum);
+			return;
+		}
+	}
+
+	for(i = 0; i < tokenTableIndex; i++) {
+		if(tokenTable[i].isFree || 2 != tokenTable[i].deltaKeyIndex) {
+			continue;
+		}
+		pValue = shadowRxBuf + tokenTable[i].deltaValueOffset;
+		if(JSMN_OBJECT != tokenTable[i].deltaValueType && JSMN_ARRAY != tokenTable[i].deltaValueType) {
+			updateValueOfJsonText(pValue, tokenTable[i].deltaValueLength, tokenTable[i].deltaValueType,
+								  (jsonStruct_t *) tokenTable[i].pStruct);
+		}
+		if(tokenTable[i].callback != NULL) {
+			tokenTable[i].callback(pValue, tokenTable[i].deltaValueLength, (jsonStruct_t *) tokenTable[i].pStruct);
+		}
+	}
+}
+
+/* Tokenizes a delta that does not fit shadowRxBuf in place, one fragment of the MQTT message at a time */
+static void shadow_delta_stream(const IoT_Publish_Message_Params *params) {
+	uint32_t i;
+	size_t length = params->payloadLen;
+	const char *pTerminator;
+	IoT_Error_t rc = SUCCESS;
+
+	if(0 == params->payloadOffset) {
+		aws_iot_json_stream_init(&(deltaStream.parser), shadow_delta_stream_event, &deltaStream);
+		deltaStream.isActive = true;
+		deltaStream.isIgnored = false;
+		deltaStream.isVersionSeen = false;
+		deltaStream.isInState = false;
+		deltaStream.isTerminated = false;
+		deltaStream.valuesLength = 0;
+		deltaStream.metadataDepth = 0;
+		memset(deltaStream.hasPendingContainer, 0, sizeof(deltaStream.hasPendingContainer));
+		for(i = 0; i < tokenTableIndex; i++) {
+			tokenTable[i].deltaKeyIndex = 0;
+		}
+	} else if(!deltaStream.isActive) {
+		/* The start of this document was missed */
+		return;
+	}
+
+	/* Like the copy to shadowRxBuf that jsmn_parse reads, the document ends at a null */
+	if(!deltaStream.isTerminated) {
+		pTerminator = (const char *) memchr(params->payload, '\0', length);
+		if(NULL != pTerminator) {
+			length = (size_t) (pTerminator - (const char *) params->payload);
+			deltaStream.isTerminated = true;
+		}
+		rc = aws_iot_json_stream_feed(&(deltaStream.parser), (const char *) params->payload, length);
+	}
+	if(SUCCESS == rc && params->payloadOffset + params->payloadLen >= params->totalPayloadLen) {
+		deltaStream.isActive = false;
+		rc = aws_iot_json_stream_finish(&(deltaStream.parser));
+		if(SUCCESS == rc && !deltaStream.isIgnored) {
+			shadow_delta_stream_dispatch(&deltaStream);
+		}
+	}
+
+	if(SUCCESS != rc) {
+		IOT_WARN("Received JSON is not valid");
+		deltaStream.isActive = false;
+	}
+}
+
 #ifdef __cplusplus
 }
 #endif
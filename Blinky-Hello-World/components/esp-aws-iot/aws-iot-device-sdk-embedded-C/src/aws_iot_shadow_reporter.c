@@ -0,0 +1,267 @@
+/*
+ * Copyright 2010-2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file aws_iot_shadow_reporter.c
+ * @brief Reports only the fields of a Thing Shadow that changed
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "aws_iot_shadow_reporter.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "aws_iot_hash.h"
+#include "aws_iot_log.h"
+
+static bool isTextField(const jsonStruct_t *pStruct) {
+	return SHADOW_JSON_STRING == pStruct->type || SHADOW_JSON_OBJECT == pStruct->type;
+}
+
+/* Strings and objects are compared by hash to keep no copy of them */
+static uint32_t hashOfText(const char *pText) {
+	return aws_iot_hash_fnv1a(pText, strlen(pText));
+}
+
+static double numberOfField(const jsonStruct_t *pStruct) {
+	switch(pStruct->type) {
+		case SHADOW_JSON_INT32:
+			return *(const int32_t *) pStruct->pData;
+		case SHADOW_JSON_INT16:
+			return *(const int16_t *) pStruct->pData;
+		case SHADOW_JSON_INT8:
+			return *(const int8_t *) pStruct->pData;
+		case SHADOW_JSON_UINT32:
+			return *(const uint32_t *) pStruct->pData;
+		case SHADOW_JSON_UINT16:
+			return *(const uint16_t *) pStruct->pData;
+		case SHADOW_JSON_UINT8:
+			return *(const uint8_t *) pStruct->pData;
+		case SHADOW_JSON_FLOAT:
+			return *(const float *) pStruct->pData;
+		case SHADOW_JSON_DOUBLE:
+			return *(const double *) pStruct->pData;
+		case SHADOW_JSON_BOOL:
+			return *(const bool *) pStruct->pData ? 1.0 : 0.0;
+		default:
+			return 0.0;
+	}
+}
+
+/* Whether the field is to be put in the next update */
+static bool isFieldDue(const ShadowReportedField_t *pField, uint32_t nowMs) {
+	double number;
+
+	if(pField->isSent && (uint32_t) (nowMs - pField->lastSentMs) < pField->minIntervalMs) {
+		return false;
+	}
+	if(!pField->isAcked) {
+		return true;
+	}
+
+	if(isTextField(pField->pStruct)) {
+		return hashOfText((const char *) pField->pStruct->pData) != pField->ackedHash;
+	}
+
+	number = numberOfField(pField->pStruct);
+	if(pField->deadband > 0.0) {
+		return fabs(number - pField->ackedNumber) > pField->deadband;
+	}
+	return number != pField->ackedNumber;
+}
+
+static void reporterUpdateCallback(const char *pThingName, ShadowActions_t action, Shadow_Ack_Status_t status,
+								   const char *pReceivedJsonDocument, void *pContextData) {
+	IOT_UNUSED(pThingName);
+	IOT_UNUSED(action);
+	IOT_UNUSED(pReceivedJsonDocument);
+
+	aws_iot_shadow_reporter_ack((ShadowReporter_t *) pContextData, status);
+}
+
+IoT_Error_t aws_iot_shadow_reporter_init(ShadowReporter_t *pReporter, const char *pThingName,
+										 ShadowReportedField_t *pFields, size_t fieldCount,
+										 uint32_t minUpdateIntervalMs, uint8_t timeoutSec) {
+	size_t i;
+
+	if(NULL == pReporter || NULL == pThingName || (NULL == pFields && fieldCount > 0)) {
+		return NULL_VALUE_ERROR;
+	}
+	for(i = 0; i < fieldCount; i++) {
+		if(NULL == pFields[i].pStruct || NULL == pFields[i].pStruct->pKey || NULL == pFields[i].pStruct->pData) {
+			return NULL_VALUE_ERROR;
+		}
+	}
+
+	pReporter->pThingName = pThingName;
+	pReporter->pFields = pFields;
+	pReporter->fieldCount = fieldCount;
+	pReporter->minUpdateIntervalMs = minUpdateIntervalMs;
+	pReporter->timeoutSec = timeoutSec;
+	pReporter->isUpdateInProgress = false;
+	pReporter->hasSentUpdate = false;
+	pReporter->lastUpdateMs = 0;
+	pReporter->updateCount = 0;
+	pReporter->bytesSent = 0;
+	for(i = 0; i < fieldCount; i++) {
+		pFields[i].isPending = false;
+		pFields[i].isSent = false;
+		pFields[i].lastSentMs = 0;
+	}
+	aws_iot_shadow_reporter_invalidate(pReporter);
+
+	return SUCCESS;
+}
+
+IoT_Error_t aws_iot_shadow_reporter_build(ShadowReporter_t *pReporter, uint32_t nowMs, char *pJsonDocument,
+										  size_t maxSizeOfJsonDocument, size_t *pFieldCount) {
+	ShadowJsonWriter_t writer;
+	ShadowReportedField_t *pField;
+	IoT_Error_t rc;
+	size_t i, count = 0;
+
+	if(NULL == pReporter || NULL == pJsonDocument || NULL == pFieldCount) {
+		return NULL_VALUE_ERROR;
+	}
+	*pFieldCount = 0;
+
+	if(pReporter->isUpdateInProgress) {
+		return SUCCESS;
+	}
+	if(pReporter->hasSentUpdate && (uint32_t) (nowMs - pReporter->lastUpdateMs) < pReporter->minUpdateIntervalMs) {
+		return SUCCESS;
+	}
+
+	for(i = 0; i < pReporter->fieldCount; i++) {
+		pField = &(pReporter->pFields[i]);
+		if(!isFieldDue(pField, nowMs)) {
+			continue;
+		}
+		if(0 == count) {
+			aws_iot_shadow_json_writer_init(&writer, pJsonDocument, maxSizeOfJsonDocument);
+			aws_iot_shadow_json_writer_begin_object(&writer, "reported");
+		}
+		aws_iot_shadow_json_writer_add(&writer, pField->pStruct);
+		pField->isPending = true;
+		if(isTextField(pField->pStruct)) {
+			pField->pendingHash = hashOfText((const char *) pField->pStruct->pData);
+		} else {
+			pField->pendingNumber = numberOfField(pField->pStruct);
+		}
+		count++;
+	}
+	if(0 == count) {
+		return SUCCESS;
+	}
+
+	rc = aws_iot_shadow_json_writer_finalize(&writer);
+	if(SUCCESS != rc) {
+		for(i = 0; i < pReporter->fieldCount; i++) {
+			pReporter->pFields[i].isPending = false;
+		}
+		return rc;
+	}
+
+	for(i = 0; i < pReporter->fieldCount; i++) {
+		pField = &(pReporter->pFields[i]);
+		if(pField->isPending) {
+			pField->isSent = true;
+			pField->lastSentMs = nowMs;
+		}
+	}
+	pReporter->isUpdateInProgress = true;
+	pReporter->hasSentUpdate = true;
+	pReporter->lastUpdateMs = nowMs;
+	pReporter->updateCount++;
+	pReporter->bytesSent += (uint32_t) writer.length;
+	*pFieldCount = count;
+
+	return SUCCESS;
+}
+
+void aws_iot_shadow_reporter_ack(ShadowReporter_t *pReporter, Shadow_Ack_Status_t status) {
+	ShadowReportedField_t *pField;
+	size_t i;
+
+	if(NULL == pReporter) {
+		return;
+	}
+
+	for(i = 0; i < pReporter->fieldCount; i++) {
+		pField = &(pReporter->pFields[i]);
+		if(!pField->isPending) {
+			continue;
+		}
+		pField->isPending = false;
+		if(SHADOW_ACK_ACCEPTED == status) {
+			pField->isAcked = true;
+			pField->ackedNumber = pField->pendingNumber;
+			pField->ackedHash = pField->pendingHash;
+		}
+	}
+	if(SHADOW_ACK_ACCEPTED != status) {
+		IOT_WARN("Shadow update not accepted, the fields will be sent again");
+	}
+	pReporter->isUpdateInProgress = false;
+}
+
+IoT_Error_t aws_iot_shadow_reporter_update(AWS_IoT_Client *pClient, ShadowReporter_t *pReporter, uint32_t nowMs,
+										   char *pJsonDocument, size_t maxSizeOfJsonDocument) {
+	IoT_Error_t rc;
+	size_t fieldCount;
+
+	FUNC_ENTRY;
+
+	if(NULL == pClient) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	rc = aws_iot_shadow_reporter_build(pReporter, nowMs, pJsonDocument, maxSizeOfJsonDocument, &fieldCount);
+	if(SUCCESS != rc || 0 == fieldCount) {
+		FUNC_EXIT_RC(rc);
+	}
+
+	IOT_DEBUG("Reporting %u fields: %s", (unsigned) fieldCount, pJsonDocument);
+	rc = aws_iot_shadow_update(pClient, pReporter->pThingName, pJsonDocument, reporterUpdateCallback, pReporter,
+							   pReporter->timeoutSec, true);
+	if(SUCCESS != rc) {
+		/* Not sent, so not in flight either */
+		aws_iot_shadow_reporter_ack(pReporter, SHADOW_ACK_TIMEOUT);
+	}
+
+	FUNC_EXIT_RC(rc);
+}
+
+void aws_iot_shadow_reporter_invalidate(ShadowReporter_t *pReporter) {
+	size_t i;
+
+	if(NULL == pReporter) {
+		return;
+	}
+
+	for(i = 0; i < pReporter->fieldCount; i++) {
+		pReporter->pFields[i].isAcked = false;
+		pReporter->pFields[i].ackedNumber = 0.0;
+		pReporter->pFields[i].ackedHash = 0;
+	}
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -32,3 +32,4 @@ TEST_GROUP_C_WRAPPER(CommonTests, NullClientSetAutoreconnect)
 TEST_GROUP_C_WRAPPER(CommonTests, UnexpectedAckFiltering)
 TEST_GROUP_C_WRAPPER(CommonTests, BigMQTTRxMessageIgnore)
 TEST_GROUP_C_WRAPPER(CommonTests, BigMQTTRxMessageReadNextMessage)
+TEST_GROUP_C_WRAPPER(CommonTests, BigMQTTRxMessageFragmented)
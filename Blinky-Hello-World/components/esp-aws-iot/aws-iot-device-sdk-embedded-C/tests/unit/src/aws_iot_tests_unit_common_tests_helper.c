@@ -52,6 +52,26 @@ static void iot_tests_unit_common_subscribe_callback_handler(AWS_IoT_Client *pCl
 	}
 }
 
+static char fragmentBuffer[4 * AWS_IOT_MQTT_RX_BUF_LEN];
+static size_t fragmentBytes;
+static size_t fragmentTotalLen;
+static uint32_t fragmentCount;
+
+static void iot_tests_unit_common_fragment_callback_handler(AWS_IoT_Client *pClient, char *topicName, uint16_t topicNameLen, IoT_Publish_Message_Params *params,
+				   void *pData) {
+	IOT_UNUSED(pClient);
+	IOT_UNUSED(topicName);
+	IOT_UNUSED(topicNameLen);
+	IOT_UNUSED(pData);
+
+	if(params->payloadOffset == fragmentBytes && params->payloadOffset + params->payloadLen <= sizeof(fragmentBuffer)) {
+		memcpy(fragmentBuffer + params->payloadOffset, params->payload, params->payloadLen);
+		fragmentBytes += params->payloadLen;
+	}
+	fragmentTotalLen = params->totalPayloadLen;
+	fragmentCount++;
+}
+
 TEST_GROUP_C_SETUP(CommonTests) {
 	ResetTLSBuffer();
 	InitMQTTParamsSetup(&initParams, AWS_IOT_MQTT_HOST, AWS_IOT_MQTT_PORT, false, NULL);
@@ -139,10 +159,10 @@ TEST_C(CommonTests, BigMQTTRxMessageIgnore) {
 	rc = aws_iot_mqtt_subscribe(&iotClient, "limitTest/topic1", 16, QOS0, iot_tests_unit_common_subscribe_callback_handler, NULL);
 	CHECK_EQUAL_C_INT(SUCCESS, rc);
 
+	memset(expectedCallbackString, 0, sizeof(expectedCallbackString));
 	for(i = 0; i < AWS_IOT_MQTT_RX_BUF_LEN; i++) {
 		expectedCallbackString[i] = 'X';
 	}
-	expectedCallbackString[i + 1] = '\0';
 
 	setTLSRxBufferWithMsgOnSubscribedTopic("limitTest/topic1", 16, QOS0, testPubMsgParams, expectedCallbackString);
 	rc = aws_iot_mqtt_yield(&iotClient, 1000);
@@ -164,10 +184,10 @@ TEST_C(CommonTests, BigMQTTRxMessageReadNextMessage) {
 	rc = aws_iot_mqtt_subscribe(&iotClient, "limitTest/topic1", 16, QOS0, iot_tests_unit_common_subscribe_callback_handler, NULL);
 	CHECK_EQUAL_C_INT(SUCCESS, rc);
 
+	memset(expectedCallbackString, 0, sizeof(expectedCallbackString));
 	for(i = 0; i < AWS_IOT_MQTT_RX_BUF_LEN; i++) {
 		expectedCallbackString[i] = 'X';
 	}
-	expectedCallbackString[i + 1] = '\0';
 
 	setTLSRxBufferWithMsgOnSubscribedTopic("limitTest/topic1", 16, QOS0, testPubMsgParams, expectedCallbackString);
 	rc = aws_iot_mqtt_yield(&iotClient, 1000);
@@ -184,3 +204,45 @@ TEST_C(CommonTests, BigMQTTRxMessageReadNextMessage) {
 	CHECK_EQUAL_C_INT(rc, SUCCESS);
 	CHECK_EQUAL_C_STRING("XXX", cbBuffer);
 }
+
+TEST_C(CommonTests, BigMQTTRxMessageFragmented) {
+	uint32_t i = 0;
+	IoT_Error_t rc = FAILURE;
+	char expectedCallbackString[2 * AWS_IOT_MQTT_RX_BUF_LEN + 1];
+
+	IOT_DEBUG("\n-->Running CommonTests - Deliver large message in fragments and continue reading \n");
+
+	fragmentBytes = 0;
+	fragmentTotalLen = 0;
+	fragmentCount = 0;
+
+	setTLSRxBufferForSuback("limitTest/topic1", 16, QOS1, testPubMsgParams);
+	rc = aws_iot_mqtt_subscribe_fragmented(&iotClient, "limitTest/topic1", 16, QOS1,
+										   iot_tests_unit_common_fragment_callback_handler, NULL);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	for(i = 0; i < 2 * AWS_IOT_MQTT_RX_BUF_LEN; i++) {
+		expectedCallbackString[i] = (char) ('a' + (i % 26));
+	}
+	expectedCallbackString[i] = '\0';
+
+	setTLSRxBufferWithMsgOnSubscribedTopic("limitTest/topic1", 16, QOS1, testPubMsgParams, expectedCallbackString);
+	rc = aws_iot_mqtt_yield(&iotClient, 1000);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	/* The payload written by the mock includes the terminating null */
+	CHECK_EQUAL_C_INT(1, fragmentCount > 1);
+	CHECK_EQUAL_C_INT(2 * AWS_IOT_MQTT_RX_BUF_LEN + 1, fragmentTotalLen);
+	CHECK_EQUAL_C_INT(fragmentTotalLen, fragmentBytes);
+	CHECK_EQUAL_C_STRING(expectedCallbackString, fragmentBuffer);
+
+	fragmentBytes = 0;
+	fragmentCount = 0;
+	expectedCallbackString[3] = '\0';
+	setTLSRxBufferWithMsgOnSubscribedTopic("limitTest/topic1", 16, QOS1, testPubMsgParams, expectedCallbackString);
+	rc = aws_iot_mqtt_yield(&iotClient, 1000);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(1, fragmentCount);
+	CHECK_EQUAL_C_INT(4, fragmentTotalLen);
+	CHECK_EQUAL_C_STRING("abc", fragmentBuffer);
+}
@@ -0,0 +1,42 @@
+/*
+* Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_tests_unit_json_stream.cpp
+ * @brief IoT Client Unit Testing - JSON Stream Tokenizer Tests
+ */
+
+#include <CppUTest/CommandLineTestRunner.h>
+#include <CppUTest/TestHarness_c.h>
+
+TEST_GROUP_C(JsonStreamTests){
+	TEST_GROUP_C_SETUP_WRAPPER(JsonStreamTests)
+	TEST_GROUP_C_TEARDOWN_WRAPPER(JsonStreamTests)
+};
+
+/* I:1 - Init and feed with Null parameters */
+TEST_GROUP_C_WRAPPER(JsonStreamTests, InitInvalidParams)
+/* I:2 - Events for a document fed in one chunk */
+TEST_GROUP_C_WRAPPER(JsonStreamTests, EventsInOneChunk)
+/* I:3 - Same events wherever the document is split */
+TEST_GROUP_C_WRAPPER(JsonStreamTests, EventsAtEverySplit)
+/* I:4 - Documents that are not valid JSON */
+TEST_GROUP_C_WRAPPER(JsonStreamTests, InvalidDocuments)
+/* I:5 - Tokens too long to put together across chunks */
+TEST_GROUP_C_WRAPPER(JsonStreamTests, LongTokensAcrossChunks)
+/* I:6 - Nesting deeper than JSON_STREAM_MAX_DEPTH */
+TEST_GROUP_C_WRAPPER(JsonStreamTests, DepthLimit)
+/* I:7 - Parse time and memory for 1, 8 and 32 KB documents, copy and jsmn vs stream */
+TEST_GROUP_C_WRAPPER(JsonStreamTests, ParseBenchmark)
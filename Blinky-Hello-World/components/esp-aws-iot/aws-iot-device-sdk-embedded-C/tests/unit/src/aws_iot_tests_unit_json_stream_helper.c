@@ -0,0 +1,397 @@
+/*
+* Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_tests_unit_json_stream_helper.c
+ * @brief IoT Client Unit Testing - JSON Stream Tokenizer Tests Helper
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <CppUTest/TestHarness_c.h>
+
+#include "aws_iot_json_stream.h"
+#include "aws_iot_config.h"
+#include "aws_iot_log.h"
+
+#define JSON_STREAM_TEST_LOG_SIZE 2048
+#define JSON_STREAM_BENCH_ROUNDS 50
+
+#define JSON_STREAM_TEST_DOCUMENT \
+	"{\"version\":12,\"state\":{\"temp\":21.5,\"name\":\"th\\\"erm\",\"on\":true," \
+	"\"modes\":[\"heat\",\"cool\"],\"empty\":{},\"list\":[],\"nil\":null},\"neg\":-3}"
+
+static JsonStreamParser_t parser;
+static char eventLog[JSON_STREAM_TEST_LOG_SIZE];
+static size_t eventLogLen;
+static bool logContainerText;
+static uint32_t eventCount;
+static uint32_t keyCount;
+
+/* One entry per event: kind, depth, key and value, ~ for NULL */
+static void logEvent(const JsonStreamEvent_t *pEvent, void *pUserData) {
+	static const char *kinds[] = {"V", "{", "}", "[", "]"};
+	const char *pValue = pEvent->pValue;
+	char after;
+
+	IOT_UNUSED(pUserData);
+
+	if(JSON_STREAM_EVENT_VALUE == pEvent->type && NULL != pValue) {
+		/* Contract for the json_utils parse functions */
+		after = pValue[pEvent->valueLength];
+		if(JSMN_STRING == pEvent->valueType) {
+			CHECK_C('"' == after || '\0' == after);
+		} else {
+			CHECK_C('\0' == after || ',' == after || '}' == after || ']' == after || ' ' == after);
+		}
+	}
+	if(JSON_STREAM_EVENT_VALUE != pEvent->type && !logContainerText) {
+		pValue = NULL;
+	}
+
+	eventLogLen += (size_t) snprintf(eventLog + eventLogLen, sizeof(eventLog) - eventLogLen, "%s%u:%.*s=%.*s;",
+									 kinds[pEvent->type], pEvent->depth,
+									 (int) ((NULL != pEvent->pKey) ? pEvent->keyLength : 1),
+									 (NULL != pEvent->pKey) ? pEvent->pKey : "~",
+									 (int) ((NULL != pValue) ? pEvent->valueLength : 1),
+									 (NULL != pValue) ? pValue : "~");
+	CHECK_C(eventLogLen < sizeof(eventLog));
+}
+
+static void countEvent(const JsonStreamEvent_t *pEvent, void *pUserData) {
+	IOT_UNUSED(pUserData);
+
+	/* jsmn has a token per key and per value, objects and arrays included */
+	if(JSON_STREAM_EVENT_VALUE == pEvent->type || JSON_STREAM_EVENT_OBJECT_START == pEvent->type ||
+	   JSON_STREAM_EVENT_ARRAY_START == pEvent->type) {
+		eventCount++;
+		if(NULL != pEvent->pKey) {
+			keyCount++;
+		}
+	}
+}
+
+static void resetLog(bool withContainerText) {
+	eventLog[0] = '\0';
+	eventLogLen = 0;
+	logContainerText = withContainerText;
+}
+
+/* Feeds pDocument split at the given offsets, in order */
+static IoT_Error_t feedSplit(const char *pDocument, const size_t *pSplits, size_t splitCount) {
+	size_t i, from = 0, length = strlen(pDocument);
+	IoT_Error_t rc;
+
+	rc = aws_iot_json_stream_init(&parser, logEvent, NULL);
+	for(i = 0; i <= splitCount && SUCCESS == rc; i++) {
+		size_t to = (i < splitCount) ? pSplits[i] : length;
+		rc = aws_iot_json_stream_feed(&parser, pDocument + from, to - from);
+		from = to;
+	}
+	if(SUCCESS == rc) {
+		rc = aws_iot_json_stream_finish(&parser);
+	}
+
+	return rc;
+}
+
+static uint64_t jsonStreamNowNs(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000000u) + (uint64_t) ts.tv_nsec;
+}
+
+TEST_GROUP_C_SETUP(JsonStreamTests) {
+	resetLog(false);
+}
+
+TEST_GROUP_C_TEARDOWN(JsonStreamTests) {
+}
+
+TEST_C(JsonStreamTests, InitInvalidParams) {
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running JSON Stream Tests - I:1 - Init with Null parameters \n");
+
+	rc = aws_iot_json_stream_init(NULL, logEvent, NULL);
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, rc);
+	rc = aws_iot_json_stream_init(&parser, NULL, NULL);
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, rc);
+
+	rc = aws_iot_json_stream_init(&parser, logEvent, NULL);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	rc = aws_iot_json_stream_feed(NULL, "{}", 2);
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, rc);
+	rc = aws_iot_json_stream_feed(&parser, NULL, 2);
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, rc);
+	rc = aws_iot_json_stream_feed(&parser, NULL, 0);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	rc = aws_iot_json_stream_finish(NULL);
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, rc);
+
+	IOT_DEBUG("-->Success - I:1 - Init with Null parameters \n");
+}
+
+TEST_C(JsonStreamTests, EventsInOneChunk) {
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running JSON Stream Tests - I:2 - Events in one chunk \n");
+
+	resetLog(true);
+	rc = feedSplit(JSON_STREAM_TEST_DOCUMENT, NULL, 0);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_STRING("{0:~=~;V1:version=12;{1:state=~;V2:temp=21.5;V2:name=th\\\"erm;V2:on=true;"
+						 "[2:modes=~;V3:~=heat;V3:~=cool;]2:~=[\"heat\",\"cool\"];{2:empty=~;}2:~={};"
+						 "[2:list=~;]2:~=[];V2:nil=null;"
+						 "}1:~={\"temp\":21.5,\"name\":\"th\\\"erm\",\"on\":true,\"modes\":[\"heat\",\"cool\"],"
+						 "\"empty\":{},\"list\":[],\"nil\":null};"
+						 "V1:neg=-3;}0:~=" JSON_STREAM_TEST_DOCUMENT ";", eventLog);
+
+	/* Whitespace anywhere between tokens, and a top-level primitive */
+	resetLog(false);
+	rc = feedSplit(" {\r\n\t\"a\" : [ 1 , \"b\" ] , \"c\" : { } } ", NULL, 0);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_STRING("{0:~=~;[1:a=~;V2:~=1;V2:~=b;]1:~=~;{1:c=~;}1:~=~;}0:~=~;", eventLog);
+
+	resetLog(false);
+	rc = feedSplit("42", NULL, 0);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_STRING("V0:~=42;", eventLog);
+
+	IOT_DEBUG("-->Success - I:2 - Events in one chunk \n");
+}
+
+TEST_C(JsonStreamTests, EventsAtEverySplit) {
+	static char expected[JSON_STREAM_TEST_LOG_SIZE];
+	const char *pDocument = JSON_STREAM_TEST_DOCUMENT;
+	size_t splits[sizeof(JSON_STREAM_TEST_DOCUMENT)];
+	size_t length = strlen(pDocument), i, j;
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running JSON Stream Tests - I:3 - Events at every split \n");
+
+	rc = feedSplit(pDocument, NULL, 0);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	strcpy(expected, eventLog);
+
+	/* Two chunks, split at every offset */
+	for(i = 0; i <= length; i++) {
+		resetLog(false);
+		splits[0] = i;
+		rc = feedSplit(pDocument, splits, 1);
+		CHECK_EQUAL_C_INT(SUCCESS, rc);
+		CHECK_EQUAL_C_STRING(expected, eventLog);
+	}
+
+	/* Three chunks, one of them empty, and a byte at a time */
+	for(i = 0; i <= length; i += 7) {
+		for(j = i; j <= length; j += 5) {
+			resetLog(false);
+			splits[0] = i;
+			splits[1] = i;
+			splits[2] = j;
+			rc = feedSplit(pDocument, splits, 3);
+			CHECK_EQUAL_C_INT(SUCCESS, rc);
+			CHECK_EQUAL_C_STRING(expected, eventLog);
+		}
+	}
+	resetLog(false);
+	for(i = 0; i < length; i++) {
+		splits[i] = i + 1;
+	}
+	rc = feedSplit(pDocument, splits, length - 1);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_STRING(expected, eventLog);
+
+	IOT_DEBUG("-->Success - I:3 - Events at every split \n");
+}
+
+TEST_C(JsonStreamTests, InvalidDocuments) {
+	static const char *invalid[] = {
+			"", "}", "{\"a\":}", "{\"a\" 1}", "{\"a\":1,}", "[1,]", "{\"a\":1]", "[1}", "{1:2}", "{\"a\":1}}",
+			"{\"a\":1} x", "{\"a\":1", "{\"a\":\"b}", "{\"a\":tru e}", "{\"a\"::1}", "[,1]",
+	};
+	uint32_t i;
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running JSON Stream Tests - I:4 - Invalid documents \n");
+
+	for(i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+		rc = feedSplit(invalid[i], NULL, 0);
+		CHECK_EQUAL_C_INT(JSON_PARSE_ERROR, rc);
+	}
+
+	/* Once invalid, further chunks are refused */
+	rc = aws_iot_json_stream_init(&parser, logEvent, NULL);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	rc = aws_iot_json_stream_feed(&parser, "{\"a\":]", 6);
+	CHECK_EQUAL_C_INT(JSON_PARSE_ERROR, rc);
+	rc = aws_iot_json_stream_feed(&parser, "}", 1);
+	CHECK_EQUAL_C_INT(JSON_PARSE_ERROR, rc);
+
+	IOT_DEBUG("-->Success - I:4 - Invalid documents \n");
+}
+
+TEST_C(JsonStreamTests, LongTokensAcrossChunks) {
+	static char document[1024];
+	static char expected[1024];
+	char longKey[JSON_STREAM_MAX_KEY_LENGTH + 2];
+	char fitValue[JSON_STREAM_MAX_VALUE_LENGTH + 1];
+	char longValue[JSON_STREAM_MAX_VALUE_LENGTH + 2];
+	size_t splits[3];
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running JSON Stream Tests - I:5 - Long tokens across chunks \n");
+
+	memset(longKey, 'k', sizeof(longKey) - 1);
+	longKey[sizeof(longKey) - 1] = '\0';
+	memset(fitValue, '7', sizeof(fitValue) - 1);
+	fitValue[sizeof(fitValue) - 1] = '\0';
+	memset(longValue, 'v', sizeof(longValue) - 1);
+	longValue[sizeof(longValue) - 1] = '\0';
+	snprintf(document, sizeof(document), "{\"%s\":1,\"fit\":%s,\"long\":\"%s\"}", longKey, fitValue, longValue);
+
+	/* In one chunk everything is reported in place, whatever its length */
+	rc = feedSplit(document, NULL, 0);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	snprintf(expected, sizeof(expected), "{0:~=~;V1:%s=1;V1:fit=%s;V1:long=%s;}0:~=~;", longKey, fitValue, longValue);
+	CHECK_EQUAL_C_STRING(expected, eventLog);
+
+	/* Split in the middle of each token, only the ones that fit the buffers survive */
+	resetLog(false);
+	splits[0] = 2 + (sizeof(longKey) / 2);
+	splits[1] = strstr(document, fitValue) - document + 3;
+	splits[2] = strstr(document, longValue) - document + 3;
+	rc = feedSplit(document, splits, 3);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	snprintf(expected, sizeof(expected), "{0:~=~;V1:~=1;V1:fit=%s;V1:long=~;}0:~=~;", fitValue);
+	CHECK_EQUAL_C_STRING(expected, eventLog);
+
+	IOT_DEBUG("-->Success - I:5 - Long tokens across chunks \n");
+}
+
+TEST_C(JsonStreamTests, DepthLimit) {
+	char document[(2 * JSON_STREAM_MAX_DEPTH) + 3];
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running JSON Stream Tests - I:6 - Depth limit \n");
+
+	memset(document, '[', JSON_STREAM_MAX_DEPTH);
+	memset(document + JSON_STREAM_MAX_DEPTH, ']', JSON_STREAM_MAX_DEPTH);
+	document[2 * JSON_STREAM_MAX_DEPTH] = '\0';
+	rc = feedSplit(document, NULL, 0);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	memset(document, '[', JSON_STREAM_MAX_DEPTH + 1);
+	memset(document + JSON_STREAM_MAX_DEPTH + 1, ']', JSON_STREAM_MAX_DEPTH + 1);
+	document[(2 * JSON_STREAM_MAX_DEPTH) + 2] = '\0';
+	rc = feedSplit(document, NULL, 0);
+	CHECK_EQUAL_C_INT(JSON_PARSE_ERROR, rc);
+
+	IOT_DEBUG("-->Success - I:6 - Depth limit \n");
+}
+
+TEST_C(JsonStreamTests, ParseBenchmark) {
+	static const size_t sizes[] = {1024, 8 * 1024, 32 * 1024};
+	char *pDocument, *pCopy;
+	jsmntok_t *pTokens;
+	jsmn_parser jsmnParser;
+	size_t size, len, offset, chunk;
+	uint32_t i, round;
+	int tokenCount;
+	uint64_t start, jsmnNs, streamNs;
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running JSON Stream Tests - I:7 - Parse benchmark \n");
+
+	for(i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		size = sizes[i];
+		pDocument = (char *) malloc(size + 1);
+		pCopy = (char *) malloc(size + 1);
+		CHECK_C(NULL != pDocument && NULL != pCopy);
+
+		/* A shadow delta with strings, numbers, booleans and small objects */
+		len = (size_t) snprintf(pDocument, size + 1, "{\"version\":7,\"timestamp\":1600000000,\"state\":{");
+		for(round = 0; len < size - 64; round++) {
+			switch(round % 4) {
+				case 0:
+					len += (size_t) snprintf(pDocument + len, size + 1 - len, "\"key_%05u\":\"value %u\",", round, round);
+					break;
+				case 1:
+					len += (size_t) snprintf(pDocument + len, size + 1 - len, "\"key_%05u\":%u.%u,", round, round, round % 10);
+					break;
+				case 2:
+					len += (size_t) snprintf(pDocument + len, size + 1 - len, "\"key_%05u\":true,", round);
+					break;
+				default:
+					len += (size_t) snprintf(pDocument + len, size + 1 - len, "\"key_%05u\":{\"min\":%u,\"max\":%u},",
+											 round, round, round + 10);
+					break;
+			}
+		}
+		len += (size_t) snprintf(pDocument + len, size + 1 - len, "\"last\":0}}");
+		CHECK_C(len <= size);
+
+		jsmn_init(&jsmnParser);
+		tokenCount = jsmn_parse(&jsmnParser, pDocument, len, NULL, 0);
+		CHECK_C(tokenCount > 0);
+		pTokens = (jsmntok_t *) malloc((size_t) tokenCount * sizeof(jsmntok_t));
+		CHECK_C(NULL != pTokens);
+
+		/* Current path: the payload is copied to shadowRxBuf and parsed into a token array */
+		start = jsonStreamNowNs();
+		for(round = 0; round < JSON_STREAM_BENCH_ROUNDS; round++) {
+			memcpy(pCopy, pDocument, len);
+			pCopy[len] = '\0';
+			jsmn_init(&jsmnParser);
+			CHECK_EQUAL_C_INT(tokenCount, jsmn_parse(&jsmnParser, pCopy, len, pTokens, (unsigned int) tokenCount));
+		}
+		jsmnNs = jsonStreamNowNs() - start;
+
+		/* Stream: tokenized in place as read buffer sized fragments arrive */
+		start = jsonStreamNowNs();
+		for(round = 0; round < JSON_STREAM_BENCH_ROUNDS; round++) {
+			eventCount = 0;
+			keyCount = 0;
+			rc = aws_iot_json_stream_init(&parser, countEvent, NULL);
+			for(offset = 0; offset < len && SUCCESS == rc; offset += chunk) {
+				chunk = (len - offset < AWS_IOT_MQTT_RX_BUF_LEN) ? len - offset : AWS_IOT_MQTT_RX_BUF_LEN;
+				rc = aws_iot_json_stream_feed(&parser, pDocument + offset, chunk);
+			}
+			CHECK_EQUAL_C_INT(SUCCESS, rc);
+			CHECK_EQUAL_C_INT(SUCCESS, aws_iot_json_stream_finish(&parser));
+		}
+		streamNs = jsonStreamNowNs() - start;
+		CHECK_EQUAL_C_INT(tokenCount, (int) (eventCount + keyCount));
+
+		/* Both need the receive buffer, the current path has to fit the whole message in it */
+		printf("\nJSON parse, %5u byte document, %4d tokens: copy + jsmn %7llu ns, %6u bytes;"
+			   " stream %7llu ns, %5u bytes", (unsigned) len, tokenCount,
+			   (unsigned long long) (jsmnNs / JSON_STREAM_BENCH_ROUNDS),
+			   (unsigned) ((2 * (len + 1)) + ((size_t) tokenCount * sizeof(jsmntok_t))),
+			   (unsigned long long) (streamNs / JSON_STREAM_BENCH_ROUNDS),
+			   (unsigned) (AWS_IOT_MQTT_RX_BUF_LEN + sizeof(JsonStreamParser_t)));
+
+		free(pTokens);
+		free(pCopy);
+		free(pDocument);
+	}
+	printf("\n");
+
+	IOT_DEBUG("-->Success - I:7 - Parse benchmark \n");
+}
@@ -0,0 +1,54 @@
+/*
+* Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_tests_unit_publish_async.cpp
+ * @brief IoT Client Unit Testing - Asynchronous QoS 1 Publish Tests
+ */
+
+#include <CppUTest/CommandLineTestRunner.h>
+#include <CppUTest/TestHarness_c.h>
+
+TEST_GROUP_C(PublishAsyncTests){
+	TEST_GROUP_C_SETUP_WRAPPER(PublishAsyncTests)
+	TEST_GROUP_C_TEARDOWN_WRAPPER(PublishAsyncTests)
+};
+
+/* K:1 - Publish async with Null/invalid parameters */
+TEST_GROUP_C_WRAPPER(PublishAsyncTests, PublishAsyncInvalidParams)
+/* K:2 - Publish async with network disconnected */
+TEST_GROUP_C_WRAPPER(PublishAsyncTests, PublishAsyncNetworkDisconnected)
+/* K:3 - PUBACKs complete the messages from yield */
+TEST_GROUP_C_WRAPPER(PublishAsyncTests, PublishAsyncCompletedByYield)
+/* K:4 - Full window, no PUBACK before the command timeout */
+TEST_GROUP_C_WRAPPER(PublishAsyncTests, PublishAsyncWindowFullTimeout)
+/* K:5 - Full window, waits for a PUBACK */
+TEST_GROUP_C_WRAPPER(PublishAsyncTests, PublishAsyncWindowFullWaitsForPuback)
+/* K:6 - Blocking publish while messages are in flight */
+TEST_GROUP_C_WRAPPER(PublishAsyncTests, PublishBlockingWhileInFlight)
+/* K:7 - Lost PUBACK, message sent again with DUP */
+TEST_GROUP_C_WRAPPER(PublishAsyncTests, PublishAsyncRetransmitWithDup)
+/* K:8 - No PUBACK after all retransmits */
+TEST_GROUP_C_WRAPPER(PublishAsyncTests, PublishAsyncRetransmitsExhausted)
+/* K:9 - Packet identifiers in flight are not reused */
+TEST_GROUP_C_WRAPPER(PublishAsyncTests, PublishAsyncPacketIdNotReused)
+/* K:10 - Disconnect without auto-reconnect fails the messages in flight */
+TEST_GROUP_C_WRAPPER(PublishAsyncTests, PublishAsyncFailedOnDisconnect)
+/* K:11 - Manual disconnect fails the messages in flight */
+TEST_GROUP_C_WRAPPER(PublishAsyncTests, PublishAsyncFailedOnManualDisconnect)
+/* K:12 - Connect fails the messages left in flight */
+TEST_GROUP_C_WRAPPER(PublishAsyncTests, PublishAsyncFailedOnConnect)
+/* K:13 - Messages per second against window size with a 50 ms round trip */
+TEST_GROUP_C_WRAPPER(PublishAsyncTests, PublishAsyncThroughput)
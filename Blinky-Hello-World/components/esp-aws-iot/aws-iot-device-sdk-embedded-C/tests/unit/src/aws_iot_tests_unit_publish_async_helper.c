@@ -0,0 +1,426 @@
+/*
+* Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_tests_unit_publish_async_helper.c
+ * @brief IoT Client Unit Testing - Asynchronous QoS 1 Publish Tests Helper
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <CppUTest/TestHarness_c.h>
+
+#include "aws_iot_mqtt_client_interface.h"
+#include "aws_iot_tests_unit_helper_functions.h"
+#include "aws_iot_tests_unit_mock_tls_params.h"
+#include "aws_iot_log.h"
+
+#define PUB_ASYNC_TEST_MAX_COMPLETIONS 64
+#define PUB_ASYNC_TEST_YIELD_MS 10
+#define PUB_ASYNC_BENCH_RTT_MS 50
+#define PUB_ASYNC_BENCH_MESSAGES 32
+
+static IoT_Client_Init_Params initParams;
+static IoT_Client_Connect_Params connectParams;
+static IoT_Publish_Message_Params testPubMsgParams;
+static AWS_IoT_Client iotClient;
+static char pubTopic[] = "sdk/Test";
+static char cPayload[] = "hello from SDK";
+
+static uint16_t completedIds[PUB_ASYNC_TEST_MAX_COMPLETIONS];
+static IoT_Error_t completedResults[PUB_ASYNC_TEST_MAX_COMPLETIONS];
+static uint32_t completedCount;
+
+static void publishCompleted(AWS_IoT_Client *pClient, uint16_t packetId, IoT_Error_t result, void *pData) {
+	IOT_UNUSED(pData);
+
+	/* Callbacks run with the client marked busy, so they cannot call yield */
+	CHECK_EQUAL_C_INT(MQTT_CLIENT_NOT_IDLE_ERROR == aws_iot_mqtt_yield(pClient, 1) ? 1 : 0,
+					  aws_iot_mqtt_is_client_connected(pClient) ? 1 : 0);
+
+	if(completedCount < PUB_ASYNC_TEST_MAX_COMPLETIONS) {
+		completedIds[completedCount] = packetId;
+		completedResults[completedCount] = result;
+	}
+	completedCount++;
+}
+
+static uint64_t nowMs(void) {
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	return ((uint64_t) now.tv_sec * 1000) + ((uint64_t) now.tv_usec / 1000);
+}
+
+/* Yields until nothing is in flight anymore or timeout_ms passed */
+static IoT_Error_t yieldUntilCompleted(uint32_t timeout_ms) {
+	IoT_Error_t rc = SUCCESS;
+	uint64_t deadline = nowMs() + timeout_ms;
+
+	while(0 < iotClient.clientData.publishInFlightCount && nowMs() < deadline) {
+		rc = aws_iot_mqtt_yield(&iotClient, PUB_ASYNC_TEST_YIELD_MS);
+		if(SUCCESS != rc) {
+			break;
+		}
+	}
+	return rc;
+}
+
+TEST_GROUP_C_SETUP(PublishAsyncTests) {
+	IoT_Error_t rc;
+
+	ResetTLSBuffer();
+	memset(&mockBroker, 0, sizeof(mockBroker));
+	InitMQTTParamsSetup(&initParams, AWS_IOT_MQTT_HOST, AWS_IOT_MQTT_PORT, false, NULL);
+	initParams.mqttCommandTimeout_ms = 500;
+	rc = aws_iot_mqtt_init(&iotClient, &initParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	ConnectMQTTParamsSetup(&connectParams, AWS_IOT_MQTT_CLIENT_ID, (uint16_t) strlen(AWS_IOT_MQTT_CLIENT_ID));
+	setTLSRxBufferForConnack(&connectParams, 0, 0);
+	rc = aws_iot_mqtt_connect(&iotClient, &connectParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	testPubMsgParams.qos = QOS1;
+	testPubMsgParams.isRetained = 0;
+	testPubMsgParams.payload = (void *) cPayload;
+	testPubMsgParams.payloadLen = strlen(cPayload);
+
+	completedCount = 0;
+	ResetTLSBuffer();
+	mockBroker.isEnabled = true;
+	mockBroker.roundTripMs = 10;
+}
+
+TEST_GROUP_C_TEARDOWN(PublishAsyncTests) {
+	memset(&mockBroker, 0, sizeof(mockBroker));
+}
+
+/* K:1 - Publish async with Null/invalid parameters */
+TEST_C(PublishAsyncTests, PublishAsyncInvalidParams) {
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Publish Async Tests - K:1 - Publish async with Null/invalid parameters \n");
+
+	rc = aws_iot_mqtt_publish_async(NULL, pubTopic, 8, &testPubMsgParams, publishCompleted, NULL);
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, rc);
+	rc = aws_iot_mqtt_publish_async(&iotClient, NULL, 8, &testPubMsgParams, publishCompleted, NULL);
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, rc);
+	rc = aws_iot_mqtt_publish_async(&iotClient, pubTopic, 0, &testPubMsgParams, publishCompleted, NULL);
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, rc);
+	rc = aws_iot_mqtt_publish_async(&iotClient, pubTopic, 8, NULL, publishCompleted, NULL);
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, rc);
+
+	rc = aws_iot_mqtt_set_publish_window(NULL, 1);
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, rc);
+	rc = aws_iot_mqtt_set_publish_window(&iotClient, 0);
+	CHECK_EQUAL_C_INT(MAX_SIZE_ERROR, rc);
+	rc = aws_iot_mqtt_set_publish_window(&iotClient, AWS_IOT_MQTT_MAX_INFLIGHT_PUBLISH + 1);
+	CHECK_EQUAL_C_INT(MAX_SIZE_ERROR, rc);
+	CHECK_EQUAL_C_INT(0, mockBroker.publishCount);
+
+	IOT_DEBUG("-->Success - K:1 - Publish async with Null/invalid parameters \n");
+}
+
+/* K:2 - Publish async with network disconnected */
+TEST_C(PublishAsyncTests, PublishAsyncNetworkDisconnected) {
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Publish Async Tests - K:2 - Publish async with network disconnected \n");
+
+	aws_iot_mqtt_disconnect(&iotClient);
+	rc = aws_iot_mqtt_publish_async(&iotClient, pubTopic, 8, &testPubMsgParams, publishCompleted, NULL);
+	CHECK_EQUAL_C_INT(NETWORK_DISCONNECTED_ERROR, rc);
+	CHECK_EQUAL_C_INT(0, iotClient.clientData.publishInFlightCount);
+	CHECK_EQUAL_C_INT(0, completedCount);
+
+	IOT_DEBUG("-->Success - K:2 - Publish async with network disconnected \n");
+}
+
+/* K:3 - PUBACKs complete the messages from yield */
+TEST_C(PublishAsyncTests, PublishAsyncCompletedByYield) {
+	IoT_Error_t rc;
+	uint16_t ids[3];
+	uint32_t i;
+
+	IOT_DEBUG("-->Running Publish Async Tests - K:3 - PUBACKs complete the messages from yield \n");
+
+	for(i = 0; i < 3; i++) {
+		rc = aws_iot_mqtt_publish_async(&iotClient, pubTopic, 8, &testPubMsgParams, publishCompleted, NULL);
+		CHECK_EQUAL_C_INT(SUCCESS, rc);
+		ids[i] = testPubMsgParams.id;
+	}
+	CHECK_EQUAL_C_INT(3, mockBroker.publishCount);
+	CHECK_EQUAL_C_INT(3, iotClient.clientData.publishInFlightCount);
+	CHECK_EQUAL_C_INT(0, completedCount);
+	CHECK_EQUAL_C_STRING(cPayload, LastPublishMessagePayload);
+
+	rc = yieldUntilCompleted(1000);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(3, completedCount);
+	for(i = 0; i < 3; i++) {
+		CHECK_EQUAL_C_INT(ids[i], completedIds[i]);
+		CHECK_EQUAL_C_INT(SUCCESS, completedResults[i]);
+	}
+	CHECK_EQUAL_C_INT(0, iotClient.clientData.publishInFlightCount);
+	CHECK_EQUAL_C_INT(0, mockBroker.dupCount);
+
+	IOT_DEBUG("-->Success - K:3 - PUBACKs complete the messages from yield \n");
+}
+
+/* K:4 - Full window, no PUBACK before the command timeout */
+TEST_C(PublishAsyncTests, PublishAsyncWindowFullTimeout) {
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Publish Async Tests - K:4 - Full window, no PUBACK before the command timeout \n");
+
+	mockBroker.dropCount = 2;
+	rc = aws_iot_mqtt_set_publish_window(&iotClient, 2);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	rc = aws_iot_mqtt_publish_async(&iotClient, pubTopic, 8, &testPubMsgParams, publishCompleted, NULL);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	rc = aws_iot_mqtt_publish_async(&iotClient, pubTopic, 8, &testPubMsgParams, publishCompleted, NULL);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	rc = aws_iot_mqtt_publish_async(&iotClient, pubTopic, 8, &testPubMsgParams, publishCompleted, NULL);
+	CHECK_EQUAL_C_INT(MQTT_REQUEST_TIMEOUT_ERROR, rc);
+
+	CHECK_EQUAL_C_INT(2, mockBroker.publishCount);
+	CHECK_EQUAL_C_INT(2, iotClient.clientData.publishInFlightCount);
+	CHECK_EQUAL_C_INT(CLIENT_STATE_CONNECTED_IDLE, aws_iot_mqtt_get_client_state(&iotClient));
+
+	IOT_DEBUG("-->Success - K:4 - Full window, no PUBACK before the command timeout \n");
+}
+
+/* K:5 - Full window, waits for a PUBACK */
+TEST_C(PublishAsyncTests, PublishAsyncWindowFullWaitsForPuback) {
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Publish Async Tests - K:5 - Full window, waits for a PUBACK \n");
+
+	rc = aws_iot_mqtt_set_publish_window(&iotClient, 1);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	rc = aws_iot_mqtt_publish_async(&iotClient, pubTopic, 8, &testPubMsgParams, publishCompleted, NULL);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	rc = aws_iot_mqtt_publish_async(&iotClient, pubTopic, 8, &testPubMsgParams, publishCompleted, NULL);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	/* The first PUBACK was read by the second publish */
+	CHECK_EQUAL_C_INT(1, completedCount);
+	CHECK_EQUAL_C_INT(SUCCESS, completedResults[0]);
+	CHECK_EQUAL_C_INT(1, iotClient.clientData.publishInFlightCount);
+
+	rc = yieldUntilCompleted(1000);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(2, completedCount);
+
+	IOT_DEBUG("-->Success - K:5 - Full window, waits for a PUBACK \n");
+}
+
+/* K:6 - Blocking publish while messages are in flight */
+TEST_C(PublishAsyncTests, PublishBlockingWhileInFlight) {
+	IoT_Error_t rc;
+	IoT_Publish_Message_Params blockingParams;
+
+	IOT_DEBUG("-->Running Publish Async Tests - K:6 - Blocking publish while messages are in flight \n");
+
+	rc = aws_iot_mqtt_publish_async(&iotClient, pubTopic, 8, &testPubMsgParams, publishCompleted, NULL);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	/* The PUBACK of the asynchronous message arrives first and must not end the blocking publish */
+	blockingParams = testPubMsgParams;
+	rc = aws_iot_mqtt_publish(&iotClient, pubTopic, 8, &blockingParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_C(blockingParams.id != testPubMsgParams.id);
+	CHECK_EQUAL_C_INT(1, completedCount);
+	CHECK_EQUAL_C_INT(testPubMsgParams.id, completedIds[0]);
+	CHECK_EQUAL_C_INT(0, iotClient.clientData.publishInFlightCount);
+	CHECK_EQUAL_C_INT(2, mockBroker.publishCount);
+
+	IOT_DEBUG("-->Success - K:6 - Blocking publish while messages are in flight \n");
+}
+
+/* K:7 - Lost PUBACK, message sent again with DUP */
+TEST_C(PublishAsyncTests, PublishAsyncRetransmitWithDup) {
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Publish Async Tests - K:7 - Lost PUBACK, message sent again with DUP \n");
+
+	mockBroker.dropCount = 1;
+	rc = aws_iot_mqtt_publish_async(&iotClient, pubTopic, 8, &testPubMsgParams, publishCompleted, NULL);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	rc = yieldUntilCompleted(10 * AWS_IOT_MQTT_PUBLISH_RETRANSMIT_MS);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(1, completedCount);
+	CHECK_EQUAL_C_INT(testPubMsgParams.id, completedIds[0]);
+	CHECK_EQUAL_C_INT(SUCCESS, completedResults[0]);
+	CHECK_EQUAL_C_INT(2, mockBroker.publishCount);
+	CHECK_EQUAL_C_INT(1, mockBroker.dupCount);
+	CHECK_EQUAL_C_STRING(cPayload, LastPublishMessagePayload);
+
+	IOT_DEBUG("-->Success - K:7 - Lost PUBACK, message sent again with DUP \n");
+}
+
+/* K:8 - No PUBACK after all retransmits */
+TEST_C(PublishAsyncTests, PublishAsyncRetransmitsExhausted) {
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Publish Async Tests - K:8 - No PUBACK after all retransmits \n");
+
+	mockBroker.dropCount = 1 + AWS_IOT_MQTT_PUBLISH_MAX_RETRANSMITS;
+	rc = aws_iot_mqtt_publish_async(&iotClient, pubTopic, 8, &testPubMsgParams, publishCompleted, NULL);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	rc = yieldUntilCompleted((AWS_IOT_MQTT_PUBLISH_MAX_RETRANSMITS + 2) * 2 * AWS_IOT_MQTT_PUBLISH_RETRANSMIT_MS);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(1, completedCount);
+	CHECK_EQUAL_C_INT(MQTT_REQUEST_TIMEOUT_ERROR, completedResults[0]);
+	CHECK_EQUAL_C_INT(1 + AWS_IOT_MQTT_PUBLISH_MAX_RETRANSMITS, mockBroker.publishCount);
+	CHECK_EQUAL_C_INT(AWS_IOT_MQTT_PUBLISH_MAX_RETRANSMITS, mockBroker.dupCount);
+
+	IOT_DEBUG("-->Success - K:8 - No PUBACK after all retransmits \n");
+}
+
+/* K:9 - Packet identifiers in flight are not reused */
+TEST_C(PublishAsyncTests, PublishAsyncPacketIdNotReused) {
+	IoT_Error_t rc;
+	uint16_t inFlightId;
+
+	IOT_DEBUG("-->Running Publish Async Tests - K:9 - Packet identifiers in flight are not reused \n");
+
+	mockBroker.dropCount = 1;
+	iotClient.clientData.nextPacketId = MAX_PACKET_ID - 1;
+	rc = aws_iot_mqtt_publish_async(&iotClient, pubTopic, 8, &testPubMsgParams, publishCompleted, NULL);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	inFlightId = testPubMsgParams.id;
+	CHECK_EQUAL_C_INT(MAX_PACKET_ID, inFlightId);
+
+	/* Wraps around past the identifier still in flight */
+	iotClient.clientData.nextPacketId = inFlightId - 1;
+	CHECK_EQUAL_C_INT(1, aws_iot_mqtt_get_next_packet_id(&iotClient));
+	CHECK_EQUAL_C_INT(1, iotClient.clientData.nextPacketId);
+
+	IOT_DEBUG("-->Success - K:9 - Packet identifiers in flight are not reused \n");
+}
+
+/* K:10 - Disconnect without auto-reconnect fails the messages in flight */
+TEST_C(PublishAsyncTests, PublishAsyncFailedOnDisconnect) {
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Publish Async Tests - K:10 - Disconnect without auto-reconnect fails the messages in flight \n");
+
+	mockBroker.dropCount = 2;
+	rc = aws_iot_mqtt_publish_async(&iotClient, pubTopic, 8, &testPubMsgParams, publishCompleted, NULL);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	rc = aws_iot_mqtt_publish_async(&iotClient, pubTopic, 8, &testPubMsgParams, publishCompleted, NULL);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	setTLSRxBufferForError(NETWORK_SSL_READ_ERROR);
+	rc = aws_iot_mqtt_yield(&iotClient, PUB_ASYNC_TEST_YIELD_MS);
+	CHECK_EQUAL_C_INT(NETWORK_DISCONNECTED_ERROR, rc);
+	CHECK_EQUAL_C_INT(2, completedCount);
+	CHECK_EQUAL_C_INT(NETWORK_DISCONNECTED_ERROR, completedResults[0]);
+	CHECK_EQUAL_C_INT(NETWORK_DISCONNECTED_ERROR, completedResults[1]);
+	CHECK_EQUAL_C_INT(0, iotClient.clientData.publishInFlightCount);
+
+	IOT_DEBUG("-->Success - K:10 - Disconnect without auto-reconnect fails the messages in flight \n");
+}
+
+/* K:11 - Manual disconnect fails the messages in flight */
+TEST_C(PublishAsyncTests, PublishAsyncFailedOnManualDisconnect) {
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Publish Async Tests - K:11 - Manual disconnect fails the messages in flight \n");
+
+	rc = aws_iot_mqtt_publish_async(&iotClient, pubTopic, 8, &testPubMsgParams, publishCompleted, NULL);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	rc = aws_iot_mqtt_publish_async(&iotClient, pubTopic, 8, &testPubMsgParams, publishCompleted, NULL);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	rc = aws_iot_mqtt_disconnect(&iotClient);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(2, completedCount);
+	CHECK_EQUAL_C_INT(NETWORK_MANUALLY_DISCONNECTED, completedResults[0]);
+	CHECK_EQUAL_C_INT(NETWORK_MANUALLY_DISCONNECTED, completedResults[1]);
+	CHECK_EQUAL_C_INT(0, iotClient.clientData.publishInFlightCount);
+
+	IOT_DEBUG("-->Success - K:11 - Manual disconnect fails the messages in flight \n");
+}
+
+/* K:12 - Connect fails the messages left in flight */
+TEST_C(PublishAsyncTests, PublishAsyncFailedOnConnect) {
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Publish Async Tests - K:12 - Connect fails the messages left in flight \n");
+
+	rc = aws_iot_mqtt_publish_async(&iotClient, pubTopic, 8, &testPubMsgParams, publishCompleted, NULL);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	/* Connection lost without the messages being completed, as when an auto-reconnect is given up */
+	iotClient.clientStatus.clientState = CLIENT_STATE_DISCONNECTED_ERROR;
+	CHECK_EQUAL_C_INT(1, iotClient.clientData.publishInFlightCount);
+
+	mockBroker.isEnabled = false;
+	ResetTLSBuffer();
+	setTLSRxBufferForConnack(&connectParams, 0, 0);
+	rc = aws_iot_mqtt_connect(&iotClient, &connectParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(1, completedCount);
+	CHECK_EQUAL_C_INT(NETWORK_MANUALLY_DISCONNECTED, completedResults[0]);
+	CHECK_EQUAL_C_INT(0, iotClient.clientData.publishInFlightCount);
+
+	IOT_DEBUG("-->Success - K:12 - Connect fails the messages left in flight \n");
+}
+
+/* K:13 - Messages per second against window size with a 50 ms round trip */
+TEST_C(PublishAsyncTests, PublishAsyncThroughput) {
+	static const uint16_t windows[] = {1, 4, 16};
+	uint32_t rates[sizeof(windows) / sizeof(windows[0])];
+	uint64_t start, elapsed;
+	uint32_t i, msg;
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Publish Async Tests - K:13 - Messages per second against window size \n");
+
+	mockBroker.roundTripMs = PUB_ASYNC_BENCH_RTT_MS;
+	for(i = 0; i < sizeof(windows) / sizeof(windows[0]); i++) {
+		rc = aws_iot_mqtt_set_publish_window(&iotClient, windows[i]);
+		CHECK_EQUAL_C_INT(SUCCESS, rc);
+		completedCount = 0;
+
+		start = nowMs();
+		for(msg = 0; msg < PUB_ASYNC_BENCH_MESSAGES; msg++) {
+			rc = aws_iot_mqtt_publish_async(&iotClient, pubTopic, 8, &testPubMsgParams, publishCompleted, NULL);
+			CHECK_EQUAL_C_INT(SUCCESS, rc);
+		}
+		rc = yieldUntilCompleted(10 * PUB_ASYNC_BENCH_RTT_MS);
+		CHECK_EQUAL_C_INT(SUCCESS, rc);
+		elapsed = nowMs() - start;
+
+		CHECK_EQUAL_C_INT(PUB_ASYNC_BENCH_MESSAGES, completedCount);
+		rates[i] = (uint32_t) ((PUB_ASYNC_BENCH_MESSAGES * 1000) / (elapsed ? elapsed : 1));
+		printf("\nQoS 1 publish, %u ms round trip, window %2u: %4u msgs/s", PUB_ASYNC_BENCH_RTT_MS, windows[i],
+			   rates[i]);
+	}
+	printf("\n");
+
+	/* Each window is at least twice the one before, expect at least half of that in throughput */
+	CHECK_C(rates[1] > 2 * rates[0]);
+	CHECK_C(rates[2] > 2 * rates[1]);
+
+	IOT_DEBUG("-->Success - K:13 - Messages per second against window size \n");
+}
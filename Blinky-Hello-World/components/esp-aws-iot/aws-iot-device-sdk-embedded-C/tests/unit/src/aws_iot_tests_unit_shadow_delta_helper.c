@@ -20,9 +20,12 @@
 
 #include <string.h>
 #include <stdio.h>
+#include <time.h>
 #include <CppUTest/TestHarness_c.h>
 
 #include "aws_iot_shadow_interface.h"
+#include "aws_iot_shadow_json.h"
+#include "aws_iot_shadow_records.h"
 #include "aws_iot_tests_unit_helper_functions.h"
 #include "aws_iot_log.h"
 
@@ -40,10 +43,30 @@ static char shadowDeltaTopic[MAX_SHADOW_TOPIC_LENGTH_BYTES];
 #undef AWS_IOT_MY_THING_NAME
 #define AWS_IOT_MY_THING_NAME "AWS-IoT-C-SDK"
 
+#define DELTA_BENCHMARK_KEYS 64
+#define DELTA_BENCHMARK_DOCUMENT_SIZE 4096
+#define DELTA_BENCHMARK_ROUNDS 1000
+
+static uint32_t deltaCallbackCount;
+
 void genericCallback(const char *pJsonStringData, uint32_t JsonStringDataLen, jsonStruct_t *pContext) {
 	printf("\nkey[%s]==Data[%.*s]\n", pContext->pKey, JsonStringDataLen, pJsonStringData);
 }
 
+void countingCallback(const char *pJsonStringData, uint32_t JsonStringDataLen, jsonStruct_t *pContext) {
+	IOT_UNUSED(pJsonStringData);
+	IOT_UNUSED(JsonStringDataLen);
+	IOT_UNUSED(pContext);
+	deltaCallbackCount++;
+}
+
+static uint64_t deltaBenchmarkNowNs(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000000u) + (uint64_t) ts.tv_nsec;
+}
+
 void nestedObjectCallback(const char *pJsonStringData, uint32_t JsonStringDataLen, jsonStruct_t *pContext) {
 	printf("\nkey[%s]==Data[%.*s]\n", pContext->pKey, JsonStringDataLen, pJsonStringData);
 	snprintf(receivedNestedObject, 100, "%.*s", JsonStringDataLen, pJsonStringData);
@@ -322,3 +345,328 @@ TEST_C(ShadowDeltaTest, DeltaVersionIgnoreOldVersion) {
 	aws_iot_shadow_yield(&client, 100);
 	CHECK_EQUAL_C_STRING(sentNestedObjectData, receivedNestedObject);
 }
+
+TEST_C(ShadowDeltaTest, DeltaMetadataAndRepeatedKeys) {
+	IoT_Error_t ret_val = SUCCESS;
+	IoT_Publish_Message_Params params;
+	jsonStruct_t firstHandler, secondHandler, metadataOnlyHandler;
+	int32_t firstData = 0, secondData = 0, metadataOnlyData = 0;
+	char deltaJSONString[] = "{\"version\":4,\"state\":{\"level\":7},"
+			"\"metadata\":{\"level\":{\"timestamp\":11},\"hidden\":{\"timestamp\":12}},\"level\":9}";
+
+	IOT_DEBUG("\n-->Running Shadow Delta Tests - Metadata skipped and repeated keys \n");
+
+	firstHandler.cb = countingCallback;
+	firstHandler.pKey = "level";
+	firstHandler.type = SHADOW_JSON_INT32;
+	firstHandler.pData = &firstData;
+	firstHandler.dataLength = sizeof(int32_t);
+	secondHandler = firstHandler;
+	secondHandler.pData = &secondData;
+	metadataOnlyHandler = firstHandler;
+	metadataOnlyHandler.pKey = "hidden";
+	metadataOnlyHandler.pData = &metadataOnlyData;
+
+	params.payloadLen = strlen(deltaJSONString);
+	params.payload = deltaJSONString;
+	params.qos = QOS0;
+
+	ResetTLSBuffer();
+	setTLSRxBufferForSuback(shadowDeltaTopic, strlen(shadowDeltaTopic), QOS0, params);
+
+	ret_val = aws_iot_shadow_register_delta(&client, &firstHandler);
+	CHECK_EQUAL_C_INT(SUCCESS, ret_val);
+	ret_val = aws_iot_shadow_register_delta(&client, &secondHandler);
+	CHECK_EQUAL_C_INT(SUCCESS, ret_val);
+	ret_val = aws_iot_shadow_register_delta(&client, &metadataOnlyHandler);
+	CHECK_EQUAL_C_INT(SUCCESS, ret_val);
+
+	ResetTLSBuffer();
+	setTLSRxBufferWithMsgOnSubscribedTopic(shadowDeltaTopic, strlen(shadowDeltaTopic), QOS0, params, params.payload);
+
+	deltaCallbackCount = 0;
+	aws_iot_shadow_yield(&client, 100);
+
+	/* Both handlers of a key get the first occurrence, keys only found inside metadata are ignored */
+	CHECK_EQUAL_C_INT(7, firstData);
+	CHECK_EQUAL_C_INT(7, secondData);
+	CHECK_EQUAL_C_INT(0, metadataOnlyData);
+	CHECK_EQUAL_C_INT(2, deltaCallbackCount);
+}
+
+TEST_C(ShadowDeltaTest, DeltaKeysOutsideState) {
+	IoT_Error_t ret_val = SUCCESS;
+	IoT_Publish_Message_Params params;
+	jsonStruct_t levelHandler, outsideHandler;
+	int32_t levelData = 0, outsideData = 0;
+	char deltaJSONString[2 * SHADOW_MAX_SIZE_OF_RX_BUFFER];
+	size_t len = 0;
+	uint32_t i;
+
+	IOT_DEBUG("\n-->Running Shadow Delta Tests - Keys outside of the state ignored \n");
+
+	levelHandler.cb = countingCallback;
+	levelHandler.pKey = "level";
+	levelHandler.type = SHADOW_JSON_INT32;
+	levelHandler.pData = &levelData;
+	levelHandler.dataLength = sizeof(int32_t);
+	outsideHandler = levelHandler;
+	outsideHandler.pKey = "outside";
+	outsideHandler.pData = &outsideData;
+
+	snprintf(deltaJSONString, sizeof(deltaJSONString), "{\"outside\":5,\"version\":6,\"state\":{\"level\":3},"
+			 "\"metadata\":{\"outside\":{\"timestamp\":11}},\"outside\":8}");
+	params.payloadLen = strlen(deltaJSONString);
+	params.payload = deltaJSONString;
+	params.qos = QOS0;
+
+	ResetTLSBuffer();
+	setTLSRxBufferForSuback(shadowDeltaTopic, strlen(shadowDeltaTopic), QOS0, params);
+
+	ret_val = aws_iot_shadow_register_delta(&client, &levelHandler);
+	CHECK_EQUAL_C_INT(SUCCESS, ret_val);
+	ret_val = aws_iot_shadow_register_delta(&client, &outsideHandler);
+	CHECK_EQUAL_C_INT(SUCCESS, ret_val);
+
+	aws_iot_shadow_reset_last_received_version();
+	ResetTLSBuffer();
+	setTLSRxBufferWithMsgOnSubscribedTopic(shadowDeltaTopic, strlen(shadowDeltaTopic), QOS0, params, params.payload);
+
+	deltaCallbackCount = 0;
+	aws_iot_shadow_yield(&client, 100);
+	CHECK_EQUAL_C_INT(3, levelData);
+	CHECK_EQUAL_C_INT(0, outsideData);
+	CHECK_EQUAL_C_INT(1, deltaCallbackCount);
+
+	/* The same for a delta that takes the stream path */
+	len += (size_t) snprintf(deltaJSONString + len, sizeof(deltaJSONString) - len,
+							 "{\"outside\":5,\"state\":{\"level\":4,\"filler\":\"");
+	for(i = 0; i < SHADOW_MAX_SIZE_OF_RX_BUFFER; i++) {
+		deltaJSONString[len++] = 'f';
+	}
+	len += (size_t) snprintf(deltaJSONString + len, sizeof(deltaJSONString) - len,
+							 "\"},\"metadata\":{\"outside\":{\"timestamp\":1}},\"version\":7}");
+	params.payloadLen = len;
+	CHECK_C(params.payloadLen > SHADOW_MAX_SIZE_OF_RX_BUFFER && params.payloadLen < sizeof(deltaJSONString));
+
+	ResetTLSBuffer();
+	setTLSRxBufferWithMsgOnSubscribedTopic(shadowDeltaTopic, strlen(shadowDeltaTopic), QOS0, params, params.payload);
+
+	deltaCallbackCount = 0;
+	aws_iot_shadow_yield(&client, 100);
+	CHECK_EQUAL_C_INT(4, levelData);
+	CHECK_EQUAL_C_INT(0, outsideData);
+	CHECK_EQUAL_C_INT(1, deltaCallbackCount);
+}
+
+TEST_C(ShadowDeltaTest, DeltaLargerThanRxBuffer) {
+	IoT_Error_t ret_val = SUCCESS;
+	IoT_Publish_Message_Params params;
+	jsonStruct_t targetHandler, modeHandler, nestedHandler;
+	int32_t targetData = 0;
+	char modeData[16] = "";
+	char deltaJSONString[2 * SHADOW_MAX_SIZE_OF_RX_BUFFER];
+	size_t len = 0;
+	uint32_t i;
+
+	IOT_DEBUG("\n-->Running Shadow Delta Tests - Delta larger than the receive buffer \n");
+
+	/* Keys on both sides of a filler value that pushes the document past the receive buffer */
+	len += (size_t) snprintf(deltaJSONString + len, sizeof(deltaJSONString) - len,
+							 "{\"version\":10,\"state\":{\"target\":21,\"filler\":\"");
+	for(i = 0; i < SHADOW_MAX_SIZE_OF_RX_BUFFER; i++) {
+		deltaJSONString[len++] = 'f';
+	}
+	len += (size_t) snprintf(deltaJSONString + len, sizeof(deltaJSONString) - len,
+							 "\",\"mode\":\"heat\",\"nested\":%s},\"metadata\":{\"mode\":{\"timestamp\":1}}}",
+							 sentNestedObjectData);
+	CHECK_C(len > SHADOW_MAX_SIZE_OF_RX_BUFFER && len < sizeof(deltaJSONString));
+
+	targetHandler.cb = countingCallback;
+	targetHandler.pKey = "target";
+	targetHandler.type = SHADOW_JSON_INT32;
+	targetHandler.pData = &targetData;
+	targetHandler.dataLength = sizeof(int32_t);
+	modeHandler.cb = countingCallback;
+	modeHandler.pKey = "mode";
+	modeHandler.type = SHADOW_JSON_STRING;
+	modeHandler.pData = modeData;
+	modeHandler.dataLength = sizeof(modeData);
+	nestedHandler.cb = nestedObjectCallback;
+	nestedHandler.pKey = "nested";
+	nestedHandler.type = SHADOW_JSON_OBJECT;
+	nestedHandler.pData = NULL;
+	nestedHandler.dataLength = 0;
+
+	params.payloadLen = len;
+	params.payload = deltaJSONString;
+	params.qos = QOS0;
+
+	ResetTLSBuffer();
+	setTLSRxBufferForSuback(shadowDeltaTopic, strlen(shadowDeltaTopic), QOS0, params);
+
+	ret_val = aws_iot_shadow_register_delta(&client, &targetHandler);
+	CHECK_EQUAL_C_INT(SUCCESS, ret_val);
+	ret_val = aws_iot_shadow_register_delta(&client, &modeHandler);
+	CHECK_EQUAL_C_INT(SUCCESS, ret_val);
+	ret_val = aws_iot_shadow_register_delta(&client, &nestedHandler);
+	CHECK_EQUAL_C_INT(SUCCESS, ret_val);
+
+	ResetTLSBuffer();
+	setTLSRxBufferWithMsgOnSubscribedTopic(shadowDeltaTopic, strlen(shadowDeltaTopic), QOS0, params, params.payload);
+
+	deltaCallbackCount = 0;
+	receivedNestedObject[0] = '\0';
+	ret_val = aws_iot_shadow_yield(&client, 100);
+	CHECK_EQUAL_C_INT(SUCCESS, ret_val);
+
+	CHECK_EQUAL_C_INT(21, targetData);
+	CHECK_EQUAL_C_STRING("heat", modeData);
+	CHECK_EQUAL_C_INT(2, deltaCallbackCount);
+	CHECK_EQUAL_C_STRING(sentNestedObjectData, receivedNestedObject);
+}
+
+/* A large delta laid out as the service sends it, with "version" after the state and metadata */
+static size_t largeDeltaWithVersionLast(char *pBuffer, size_t bufferSize, int32_t target, uint32_t version) {
+	size_t len = 0;
+	uint32_t i;
+
+	len += (size_t) snprintf(pBuffer + len, bufferSize - len, "{\"state\":{\"target\":%d,\"filler\":\"", target);
+	for(i = 0; i < SHADOW_MAX_SIZE_OF_RX_BUFFER; i++) {
+		pBuffer[len++] = 'f';
+	}
+	len += (size_t) snprintf(pBuffer + len, bufferSize - len,
+							 "\"},\"metadata\":{\"target\":{\"timestamp\":1}},\"version\":%u}", version);
+	return len;
+}
+
+TEST_C(ShadowDeltaTest, DeltaLargerThanRxBufferVersionLast) {
+	IoT_Error_t ret_val = SUCCESS;
+	IoT_Publish_Message_Params params;
+	jsonStruct_t targetHandler;
+	int32_t targetData = 0;
+	char deltaJSONString[2 * SHADOW_MAX_SIZE_OF_RX_BUFFER];
+
+	IOT_DEBUG("\n-->Running Shadow Delta Tests - Delta larger than the receive buffer, version last \n");
+
+	targetHandler.cb = countingCallback;
+	targetHandler.pKey = "target";
+	targetHandler.type = SHADOW_JSON_INT32;
+	targetHandler.pData = &targetData;
+	targetHandler.dataLength = sizeof(int32_t);
+
+	params.payloadLen = largeDeltaWithVersionLast(deltaJSONString, sizeof(deltaJSONString), 21, 30);
+	params.payload = deltaJSONString;
+	params.qos = QOS0;
+	CHECK_C(params.payloadLen > SHADOW_MAX_SIZE_OF_RX_BUFFER && params.payloadLen < sizeof(deltaJSONString));
+
+	ResetTLSBuffer();
+	setTLSRxBufferForSuback(shadowDeltaTopic, strlen(shadowDeltaTopic), QOS0, params);
+
+	ret_val = aws_iot_shadow_register_delta(&client, &targetHandler);
+	CHECK_EQUAL_C_INT(SUCCESS, ret_val);
+
+	aws_iot_shadow_enable_discard_old_delta_msgs();
+	aws_iot_shadow_reset_last_received_version();
+	ResetTLSBuffer();
+	setTLSRxBufferWithMsgOnSubscribedTopic(shadowDeltaTopic, strlen(shadowDeltaTopic), QOS0, params, params.payload);
+
+	deltaCallbackCount = 0;
+	ret_val = aws_iot_shadow_yield(&client, 100);
+	CHECK_EQUAL_C_INT(SUCCESS, ret_val);
+	CHECK_EQUAL_C_INT(21, targetData);
+	CHECK_EQUAL_C_INT(1, deltaCallbackCount);
+	CHECK_EQUAL_C_INT(30, aws_iot_shadow_get_last_received_version());
+
+	/* An older version must leave the state alone even though the keys come before it */
+	params.payloadLen = largeDeltaWithVersionLast(deltaJSONString, sizeof(deltaJSONString), 42, 29);
+	ResetTLSBuffer();
+	setTLSRxBufferWithMsgOnSubscribedTopic(shadowDeltaTopic, strlen(shadowDeltaTopic), QOS0, params, params.payload);
+
+	deltaCallbackCount = 0;
+	ret_val = aws_iot_shadow_yield(&client, 100);
+	CHECK_EQUAL_C_INT(SUCCESS, ret_val);
+	CHECK_EQUAL_C_INT(21, targetData);
+	CHECK_EQUAL_C_INT(0, deltaCallbackCount);
+	CHECK_EQUAL_C_INT(30, aws_iot_shadow_get_last_received_version());
+}
+
+TEST_C(ShadowDeltaTest, DeltaDispatchBenchmark) {
+	IoT_Error_t ret_val = SUCCESS;
+	IoT_Publish_Message_Params params;
+	static jsonStruct_t handlers[DELTA_BENCHMARK_KEYS];
+	static char keys[DELTA_BENCHMARK_KEYS][16];
+	static char values[DELTA_BENCHMARK_KEYS][32];
+	static char deltaJSONString[DELTA_BENCHMARK_DOCUMENT_SIZE + 512];
+	size_t len = 0;
+	int32_t tokenCount = 0, dataPosition;
+	uint32_t i, round, dataLength;
+	uint64_t start, perKeyNs, singlePassNs;
+
+	IOT_DEBUG("\n-->Running Shadow Delta Tests - Delta dispatch benchmark \n");
+
+	/* Delta as the service sends it: state plus a metadata entry per key */
+	len += (size_t) snprintf(deltaJSONString + len, sizeof(deltaJSONString) - len,
+							 "{\"version\":5,\"timestamp\":1600000000,\"state\":{");
+	for(i = 0; i < DELTA_BENCHMARK_KEYS; i++) {
+		len += (size_t) snprintf(deltaJSONString + len, sizeof(deltaJSONString) - len,
+								 "%s\"setting_%02u\":\"value_%02u\"", (i > 0) ? "," : "", i, i);
+	}
+	len += (size_t) snprintf(deltaJSONString + len, sizeof(deltaJSONString) - len, "},\"metadata\":{");
+	for(i = 0; i < DELTA_BENCHMARK_KEYS; i++) {
+		len += (size_t) snprintf(deltaJSONString + len, sizeof(deltaJSONString) - len,
+								 "%s\"setting_%02u\":{\"timestamp\":1600000000}", (i > 0) ? "," : "", i);
+	}
+	len += (size_t) snprintf(deltaJSONString + len, sizeof(deltaJSONString) - len, "}}");
+	CHECK_C(len >= DELTA_BENCHMARK_DOCUMENT_SIZE - 512 && len < sizeof(deltaJSONString));
+
+	params.payloadLen = len;
+	params.payload = deltaJSONString;
+	params.qos = QOS0;
+
+	ResetTLSBuffer();
+	setTLSRxBufferForSuback(shadowDeltaTopic, strlen(shadowDeltaTopic), QOS0, params);
+
+	/* Registered in reverse so document order and registration order differ */
+	for(i = 0; i < DELTA_BENCHMARK_KEYS; i++) {
+		snprintf(keys[i], sizeof(keys[i]), "setting_%02u", DELTA_BENCHMARK_KEYS - 1 - i);
+		handlers[i].cb = countingCallback;
+		handlers[i].pKey = keys[i];
+		handlers[i].type = SHADOW_JSON_STRING;
+		handlers[i].pData = values[i];
+		handlers[i].dataLength = sizeof(values[i]);
+		ret_val = aws_iot_shadow_register_delta(&client, &handlers[i]);
+		CHECK_EQUAL_C_INT(SUCCESS, ret_val);
+	}
+
+	CHECK_C(isJsonValidAndParse(deltaJSONString, len, NULL, &tokenCount));
+
+	deltaCallbackCount = 0;
+	start = deltaBenchmarkNowNs();
+	for(round = 0; round < DELTA_BENCHMARK_ROUNDS; round++) {
+		for(i = 0; i < DELTA_BENCHMARK_KEYS; i++) {
+			if(isJsonKeyMatchingAndUpdateValue(deltaJSONString, NULL, tokenCount, &handlers[i], &dataLength,
+											   &dataPosition)) {
+				handlers[i].cb(deltaJSONString + dataPosition, dataLength, &handlers[i]);
+			}
+		}
+	}
+	perKeyNs = deltaBenchmarkNowNs() - start;
+	CHECK_EQUAL_C_INT(DELTA_BENCHMARK_KEYS * DELTA_BENCHMARK_ROUNDS, deltaCallbackCount);
+
+	deltaCallbackCount = 0;
+	memset(values, 0, sizeof(values));
+	start = deltaBenchmarkNowNs();
+	for(round = 0; round < DELTA_BENCHMARK_ROUNDS; round++) {
+		dispatchDeltaJsonTokens(deltaJSONString, NULL, tokenCount);
+	}
+	singlePassNs = deltaBenchmarkNowNs() - start;
+	CHECK_EQUAL_C_INT(DELTA_BENCHMARK_KEYS * DELTA_BENCHMARK_ROUNDS, deltaCallbackCount);
+	CHECK_EQUAL_C_STRING("value_63", values[0]);
+	CHECK_EQUAL_C_STRING("value_00", values[DELTA_BENCHMARK_KEYS - 1]);
+
+	printf("\nDelta dispatch, %u keys, %u byte document, %d tokens: per key scan %llu ns, single pass %llu ns\n",
+		   DELTA_BENCHMARK_KEYS, (unsigned) len, tokenCount,
+		   (unsigned long long) (perKeyNs / DELTA_BENCHMARK_ROUNDS),
+		   (unsigned long long) (singlePassNs / DELTA_BENCHMARK_ROUNDS));
+}
@@ -0,0 +1,338 @@
+/*
+* Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_tests_unit_shadow_reporter_helper.c
+ * @brief IoT Client Unit Testing - Shadow Reporter Tests Helper
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <CppUTest/TestHarness_c.h>
+
+#include "aws_iot_shadow_reporter.h"
+#include "aws_iot_shadow_json.h"
+#include "aws_iot_config.h"
+#include "aws_iot_log.h"
+
+#define REPORTER_TEST_DOCUMENT_SIZE 300
+#define REPORTER_TEST_FIELDS 4
+#define REPORTER_TRACE_SECONDS 3600
+
+static ShadowReporter_t reporter;
+static ShadowReportedField_t fields[REPORTER_TEST_FIELDS];
+static jsonStruct_t handlers[REPORTER_TEST_FIELDS];
+static char document[REPORTER_TEST_DOCUMENT_SIZE];
+static float temperature;
+static uint8_t sound;
+static char hvacStatus[16];
+static bool roomOccupancy;
+
+/* Same fields as the Smart-Thermostat */
+TEST_GROUP_C_SETUP(ShadowReporterTests) {
+	resetClientTokenSequenceNum();
+
+	temperature = 70.0f;
+	sound = 10;
+	strcpy(hvacStatus, "STANDBY");
+	roomOccupancy = false;
+
+	handlers[0].pKey = "temperature";
+	handlers[0].pData = &temperature;
+	handlers[0].dataLength = sizeof(float);
+	handlers[0].type = SHADOW_JSON_FLOAT;
+	handlers[1].pKey = "sound";
+	handlers[1].pData = &sound;
+	handlers[1].dataLength = sizeof(uint8_t);
+	handlers[1].type = SHADOW_JSON_UINT8;
+	handlers[2].pKey = "hvacStatus";
+	handlers[2].pData = hvacStatus;
+	handlers[2].dataLength = sizeof(hvacStatus);
+	handlers[2].type = SHADOW_JSON_STRING;
+	handlers[3].pKey = "roomOccupancy";
+	handlers[3].pData = &roomOccupancy;
+	handlers[3].dataLength = sizeof(bool);
+	handlers[3].type = SHADOW_JSON_BOOL;
+
+	memset(fields, 0, sizeof(fields));
+	fields[0].pStruct = &handlers[0];
+	fields[0].deadband = 0.2;
+	fields[1].pStruct = &handlers[1];
+	fields[1].deadband = 5;
+	fields[2].pStruct = &handlers[2];
+	fields[3].pStruct = &handlers[3];
+}
+
+TEST_GROUP_C_TEARDOWN(ShadowReporterTests) {
+
+}
+
+/* The fields in the document, the client token depends on the connection */
+static void checkReported(const char *pExpectedFields) {
+	static const char prefix[] = "{\"state\":{\"reported\":{";
+	static const char suffix[] = "}}, \"clientToken\":\"";
+	size_t length = strlen(pExpectedFields);
+
+	CHECK_C(0 == strncmp(document, prefix, strlen(prefix)));
+	CHECK_C(0 == strncmp(document + strlen(prefix), pExpectedFields, length));
+	CHECK_C(0 == strncmp(document + strlen(prefix) + length, suffix, strlen(suffix)));
+}
+
+static size_t buildReport(uint32_t nowMs) {
+	size_t fieldCount = 0;
+	IoT_Error_t rc;
+
+	document[0] = '\0';
+	rc = aws_iot_shadow_reporter_build(&reporter, nowMs, document, sizeof(document), &fieldCount);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	if(0 != fieldCount) {
+		CHECK_C(isReceivedJsonValid(document, strlen(document)));
+	}
+	return fieldCount;
+}
+
+TEST_C(ShadowReporterTests, InitInvalidParams) {
+	IoT_Error_t rc;
+	size_t fieldCount;
+
+	IOT_DEBUG("\n-->Running Shadow Reporter Tests - Init with Null parameters \n");
+
+	rc = aws_iot_shadow_reporter_init(NULL, "thing", fields, REPORTER_TEST_FIELDS, 0, 4);
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, rc);
+	rc = aws_iot_shadow_reporter_init(&reporter, NULL, fields, REPORTER_TEST_FIELDS, 0, 4);
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, rc);
+	rc = aws_iot_shadow_reporter_init(&reporter, "thing", NULL, REPORTER_TEST_FIELDS, 0, 4);
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, rc);
+	handlers[2].pData = NULL;
+	rc = aws_iot_shadow_reporter_init(&reporter, "thing", fields, REPORTER_TEST_FIELDS, 0, 4);
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, rc);
+	handlers[2].pData = hvacStatus;
+	rc = aws_iot_shadow_reporter_init(&reporter, "thing", fields, REPORTER_TEST_FIELDS, 0, 4);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	rc = aws_iot_shadow_reporter_build(&reporter, 0, NULL, sizeof(document), &fieldCount);
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, rc);
+	rc = aws_iot_shadow_reporter_build(&reporter, 0, document, sizeof(document), NULL);
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, rc);
+}
+
+TEST_C(ShadowReporterTests, FirstBuildReportsEveryField) {
+	IoT_Error_t rc;
+
+	IOT_DEBUG("\n-->Running Shadow Reporter Tests - First update reports every field \n");
+
+	rc = aws_iot_shadow_reporter_init(&reporter, "thing", fields, REPORTER_TEST_FIELDS, 0, 4);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	CHECK_EQUAL_C_INT(REPORTER_TEST_FIELDS, buildReport(0));
+	checkReported("\"temperature\":70.000000,\"sound\":10,\"hvacStatus\":\"STANDBY\",\"roomOccupancy\":false");
+	CHECK_EQUAL_C_INT(1, reporter.updateCount);
+	CHECK_EQUAL_C_INT(strlen(document), reporter.bytesSent);
+
+	/* Nothing more while the update is in flight */
+	temperature = 75.0f;
+	CHECK_EQUAL_C_INT(0, buildReport(1000));
+
+	aws_iot_shadow_reporter_ack(&reporter, SHADOW_ACK_ACCEPTED);
+	CHECK_EQUAL_C_INT(1, buildReport(2000));
+	aws_iot_shadow_reporter_ack(&reporter, SHADOW_ACK_ACCEPTED);
+	CHECK_EQUAL_C_INT(0, buildReport(3000));
+
+	/* Everything again once the acknowledged values are forgotten */
+	aws_iot_shadow_reporter_invalidate(&reporter);
+	CHECK_EQUAL_C_INT(REPORTER_TEST_FIELDS, buildReport(4000));
+}
+
+TEST_C(ShadowReporterTests, DeadbandAndChangedFields) {
+	IoT_Error_t rc;
+
+	IOT_DEBUG("\n-->Running Shadow Reporter Tests - Only fields past their deadband are reported \n");
+
+	rc = aws_iot_shadow_reporter_init(&reporter, "thing", fields, REPORTER_TEST_FIELDS, 0, 4);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(REPORTER_TEST_FIELDS, buildReport(0));
+	aws_iot_shadow_reporter_ack(&reporter, SHADOW_ACK_ACCEPTED);
+
+	/* Within the deadbands of the acknowledged values, however long it drifts */
+	temperature = 70.15f;
+	sound = 15;
+	CHECK_EQUAL_C_INT(0, buildReport(1000));
+	temperature = 69.85f;
+	sound = 5;
+	CHECK_EQUAL_C_INT(0, buildReport(2000));
+
+	temperature = 70.25f;
+	CHECK_EQUAL_C_INT(1, buildReport(3000));
+	checkReported("\"temperature\":70.250000");
+	aws_iot_shadow_reporter_ack(&reporter, SHADOW_ACK_ACCEPTED);
+
+	/* The deadband now starts from 70.25 */
+	temperature = 70.1f;
+	CHECK_EQUAL_C_INT(0, buildReport(4000));
+
+	/* Strings and bools have no deadband */
+	strcpy(hvacStatus, "HEATING");
+	roomOccupancy = true;
+	sound = 4;
+	CHECK_EQUAL_C_INT(3, buildReport(5000));
+	checkReported("\"sound\":4,\"hvacStatus\":\"HEATING\",\"roomOccupancy\":true");
+	aws_iot_shadow_reporter_ack(&reporter, SHADOW_ACK_ACCEPTED);
+	CHECK_EQUAL_C_INT(0, buildReport(6000));
+}
+
+TEST_C(ShadowReporterTests, NotAcceptedFieldsSentAgain) {
+	IoT_Error_t rc;
+
+	IOT_DEBUG("\n-->Running Shadow Reporter Tests - Fields of an update not accepted are sent again \n");
+
+	rc = aws_iot_shadow_reporter_init(&reporter, "thing", fields, REPORTER_TEST_FIELDS, 0, 4);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(REPORTER_TEST_FIELDS, buildReport(0));
+	aws_iot_shadow_reporter_ack(&reporter, SHADOW_ACK_ACCEPTED);
+
+	roomOccupancy = true;
+	CHECK_EQUAL_C_INT(1, buildReport(1000));
+
+	/* Changes while in flight go into the next update */
+	temperature = 72.0f;
+	strcpy(hvacStatus, "COOLING");
+	CHECK_EQUAL_C_INT(0, buildReport(1500));
+	aws_iot_shadow_reporter_ack(&reporter, SHADOW_ACK_TIMEOUT);
+
+	CHECK_EQUAL_C_INT(3, buildReport(2000));
+	checkReported("\"temperature\":72.000000,\"hvacStatus\":\"COOLING\",\"roomOccupancy\":true");
+	aws_iot_shadow_reporter_ack(&reporter, SHADOW_ACK_REJECTED);
+
+	/* Back to the acknowledged value before it was sent again, nothing left to report */
+	roomOccupancy = false;
+	strcpy(hvacStatus, "STANDBY");
+	temperature = 70.1f;
+	CHECK_EQUAL_C_INT(0, buildReport(3000));
+}
+
+TEST_C(ShadowReporterTests, MinimumIntervals) {
+	IoT_Error_t rc;
+
+	IOT_DEBUG("\n-->Running Shadow Reporter Tests - Minimum interval per field and between updates \n");
+
+	fields[1].minIntervalMs = 10000;
+	rc = aws_iot_shadow_reporter_init(&reporter, "thing", fields, REPORTER_TEST_FIELDS, 3000, 4);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(REPORTER_TEST_FIELDS, buildReport(0xFFFFF000u));
+	aws_iot_shadow_reporter_ack(&reporter, SHADOW_ACK_ACCEPTED);
+
+	/* Coalesced until 3 s after the last update, across the wrap of the clock */
+	roomOccupancy = true;
+	CHECK_EQUAL_C_INT(0, buildReport(0xFFFFF000u + 1000));
+	temperature = 71.0f;
+	sound = 60;
+	CHECK_EQUAL_C_INT(0, buildReport(0xFFFFF000u + 2000));
+	CHECK_EQUAL_C_INT(2, buildReport(0xFFFFF000u + 3000));
+	checkReported("\"temperature\":71.000000,\"roomOccupancy\":true");
+	aws_iot_shadow_reporter_ack(&reporter, SHADOW_ACK_ACCEPTED);
+
+	/* Sound waits for 10 s after its last report */
+	CHECK_EQUAL_C_INT(0, buildReport(0xFFFFF000u + 6000));
+	CHECK_EQUAL_C_INT(1, buildReport(0xFFFFF000u + 10000));
+	checkReported("\"sound\":60");
+	aws_iot_shadow_reporter_ack(&reporter, SHADOW_ACK_ACCEPTED);
+	CHECK_EQUAL_C_INT(3, reporter.updateCount);
+}
+
+TEST_C(ShadowReporterTests, UpdateNotConnected) {
+	AWS_IoT_Client client;
+	IoT_Error_t rc;
+
+	IOT_DEBUG("\n-->Running Shadow Reporter Tests - Update with a client that is not connected \n");
+
+	memset(&client, 0, sizeof(client));
+	rc = aws_iot_shadow_reporter_init(&reporter, "thing", fields, REPORTER_TEST_FIELDS, 0, 4);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	rc = aws_iot_shadow_reporter_update(NULL, &reporter, 0, document, sizeof(document));
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, rc);
+	rc = aws_iot_shadow_reporter_update(&client, &reporter, 0, document, sizeof(document));
+	CHECK_EQUAL_C_INT(MQTT_CONNECTION_ERROR, rc);
+
+	/* Not in flight, so everything is still to be reported */
+	CHECK_EQUAL_C_INT(REPORTER_TEST_FIELDS, buildReport(1000));
+}
+
+/* Uniform in [0, 1) */
+static double traceRandom(uint32_t *pSeed) {
+	*pSeed = *pSeed * 1664525u + 1013904223u;
+	return (double) (*pSeed >> 8) / (double) (1u << 24);
+}
+
+TEST_C(ShadowReporterTests, SensorTraceSimulation) {
+	static char fullDocument[REPORTER_TEST_DOCUMENT_SIZE];
+	double trueTemperature = 70.0;
+	uint32_t seed = 2021u, second, nowMs, fullBytes = 0, fullUpdates = 0, overhead;
+	size_t fieldCount;
+	bool isInFlight = false;
+	IoT_Error_t rc;
+
+	IOT_DEBUG("\n-->Running Shadow Reporter Tests - Sensor trace, full documents vs changed fields \n");
+
+	/* Like the Smart-Thermostat: a slow room temperature read through a noisy sensor, a microphone level
+	 * that moves a lot, an HVAC status that follows the temperature and an occupancy flag that rarely changes */
+	fields[1].minIntervalMs = 10000;
+	rc = aws_iot_shadow_reporter_init(&reporter, AWS_IOT_MY_THING_NAME, fields, REPORTER_TEST_FIELDS, 1000, 4);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	for(second = 0; second < REPORTER_TRACE_SECONDS; second++) {
+		nowMs = second * 1000u;
+		trueTemperature += (traceRandom(&seed) - 0.5) * 0.02 + ((second / 900) % 2 ? 0.002 : -0.002);
+		temperature = (float) (trueTemperature + (traceRandom(&seed) - 0.5) * 0.3);
+		sound = (uint8_t) (10 + traceRandom(&seed) * 8 + ((second % 600) < 60 ? 40 : 0));
+		strcpy(hvacStatus, trueTemperature < 69.5 ? "HEATING" : (trueTemperature > 70.5 ? "COOLING" : "STANDBY"));
+		roomOccupancy = (second % 1200) < 400;
+
+		/* Before: the whole document every second */
+		rc = aws_iot_shadow_build_reported(handlers, REPORTER_TEST_FIELDS, fullDocument, sizeof(fullDocument));
+		CHECK_EQUAL_C_INT(SUCCESS, rc);
+		fullBytes += (uint32_t) strlen(fullDocument);
+		fullUpdates++;
+
+		/* After: the response to an update comes in before the next sample, one in fifty times out */
+		if(isInFlight) {
+			aws_iot_shadow_reporter_ack(&reporter, (0 == reporter.updateCount % 50) ? SHADOW_ACK_TIMEOUT :
+																					   SHADOW_ACK_ACCEPTED);
+			isInFlight = false;
+		}
+		fieldCount = buildReport(nowMs);
+		isInFlight = (0 != fieldCount);
+	}
+	if(isInFlight) {
+		aws_iot_shadow_reporter_ack(&reporter, SHADOW_ACK_ACCEPTED);
+	}
+	while(0 != buildReport(nowMs += 10000)) {
+		aws_iot_shadow_reporter_ack(&reporter, SHADOW_ACK_ACCEPTED);
+	}
+
+	/* The shadow ends up within the deadbands of the device */
+	CHECK_C(fields[0].isAcked && fields[0].ackedNumber > temperature - 0.2 - 1e-6 &&
+			fields[0].ackedNumber < temperature + 0.2 + 1e-6);
+	CHECK_C(fields[1].ackedNumber >= sound - 5 && fields[1].ackedNumber <= sound + 5);
+	CHECK_C(fields[3].ackedNumber == (roomOccupancy ? 1.0 : 0.0));
+	CHECK_C(reporter.bytesSent * 4 < fullBytes);
+
+	/* MQTT fixed header, topic length and topic of every PUBLISH */
+	overhead = 4 + (uint32_t) strlen("$aws/things/" AWS_IOT_MY_THING_NAME "/shadow/update");
+	printf("\nShadow reporting over %u s: full documents %u updates, %u JSON bytes (%u with MQTT headers), "
+		   "changed fields %u updates, %u JSON bytes (%u with MQTT headers)\n",
+		   REPORTER_TRACE_SECONDS, fullUpdates, fullBytes, fullBytes + fullUpdates * overhead,
+		   reporter.updateCount, reporter.bytesSent, reporter.bytesSent + reporter.updateCount * overhead);
+}
@@ -0,0 +1,402 @@
+/*
+* Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_tests_unit_subscription_index_helper.c
+ * @brief IoT Client Unit Testing - Subscription Index Tests Helper
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <CppUTest/TestHarness_c.h>
+
+#include "aws_iot_tests_unit_helper_functions.h"
+#include "aws_iot_mqtt_client_common_internal.h"
+#include "aws_iot_log.h"
+
+#define SUB_INDEX_TEST_HANDLERS 16
+#define SUB_INDEX_TEST_BUCKETS ((2 * SUB_INDEX_TEST_HANDLERS) + 1)
+#define SUB_INDEX_TEST_NODES ((4 * SUB_INDEX_TEST_HANDLERS) + 1)
+#define SUB_INDEX_TEST_WORDS ((SUB_INDEX_TEST_HANDLERS + 31) / 32)
+
+#define SUB_INDEX_BENCH_MIN_HANDLERS 8
+#define SUB_INDEX_BENCH_MAX_HANDLERS 512
+#define SUB_INDEX_BENCH_ROUNDS 200
+#define SUB_INDEX_BENCH_TOPIC_LEN 64
+
+static MessageHandlers handlers[SUB_INDEX_TEST_HANDLERS];
+static SubscriptionIndexEntry entries[SUB_INDEX_TEST_HANDLERS];
+static uint16_t buckets[SUB_INDEX_TEST_BUCKETS];
+static SubscriptionTrieNode nodes[SUB_INDEX_TEST_NODES];
+static SubscriptionIndex subIndex;
+
+static void setHandler(uint16_t handlerIndex, const char *pFilter) {
+	handlers[handlerIndex].topicName = pFilter;
+	handlers[handlerIndex].topicNameLen = (uint16_t) strlen(pFilter);
+	aws_iot_mqtt_internal_subscription_index_add(&subIndex, handlerIndex);
+}
+
+static void clearHandler(uint16_t handlerIndex) {
+	aws_iot_mqtt_internal_subscription_index_remove(&subIndex, handlerIndex);
+	handlers[handlerIndex].topicName = NULL;
+}
+
+/* Same predicate _aws_iot_mqtt_internal_deliver_message() used before the index, on every handler */
+static void linearMatch(const MessageHandlers *pHandlers, uint16_t handlerCount, const char *pTopicName,
+						uint16_t topicNameLen, uint32_t *pMatched) {
+	uint16_t i;
+
+	for(i = 0; i < handlerCount; i++) {
+		if(NULL != pHandlers[i].topicName &&
+		   (((topicNameLen == pHandlers[i].topicNameLen) &&
+			 (strncmp(pTopicName, pHandlers[i].topicName, topicNameLen) == 0)) ||
+			aws_iot_mqtt_internal_is_topic_matched(pHandlers[i].topicName, pTopicName, topicNameLen))) {
+			pMatched[i / 32] |= (1u << (i % 32));
+		}
+	}
+}
+
+/* Returns the index result for pTopicName after checking it against the linear scan */
+static uint32_t matchTopic(const char *pTopicName) {
+	uint32_t indexed[SUB_INDEX_TEST_WORDS] = {0};
+	uint32_t linear[SUB_INDEX_TEST_WORDS] = {0};
+	uint16_t topicNameLen = (uint16_t) strlen(pTopicName);
+
+	aws_iot_mqtt_internal_subscription_index_match(&subIndex, pTopicName, topicNameLen, indexed);
+	linearMatch(handlers, SUB_INDEX_TEST_HANDLERS, pTopicName, topicNameLen, linear);
+	CHECK_C(0 == memcmp(indexed, linear, sizeof(indexed)));
+
+	return indexed[0];
+}
+
+static uint64_t nowNs(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000000u) + (uint64_t) ts.tv_nsec;
+}
+
+TEST_GROUP_C_SETUP(SubscriptionIndexTests) {
+	IoT_Error_t rc;
+
+	memset(handlers, 0, sizeof(handlers));
+	rc = aws_iot_mqtt_internal_subscription_index_init(&subIndex, handlers, entries, SUB_INDEX_TEST_HANDLERS,
+													   buckets, SUB_INDEX_TEST_BUCKETS, nodes, SUB_INDEX_TEST_NODES);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+}
+
+TEST_GROUP_C_TEARDOWN(SubscriptionIndexTests) { }
+
+/* H:1 - Init with Null/invalid parameters */
+TEST_C(SubscriptionIndexTests, InitInvalidParams) {
+	SubscriptionIndex other;
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Subscription Index Tests - H:1 - Init with Null/invalid parameters \n");
+
+	rc = aws_iot_mqtt_internal_subscription_index_init(NULL, handlers, entries, SUB_INDEX_TEST_HANDLERS,
+													   buckets, SUB_INDEX_TEST_BUCKETS, nodes, SUB_INDEX_TEST_NODES);
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, rc);
+	rc = aws_iot_mqtt_internal_subscription_index_init(&other, handlers, entries, SUB_INDEX_TEST_HANDLERS,
+													   NULL, SUB_INDEX_TEST_BUCKETS, nodes, SUB_INDEX_TEST_NODES);
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, rc);
+	/* Open addressing needs at least one empty bucket */
+	rc = aws_iot_mqtt_internal_subscription_index_init(&other, handlers, entries, SUB_INDEX_TEST_HANDLERS,
+													   buckets, SUB_INDEX_TEST_HANDLERS, nodes, SUB_INDEX_TEST_NODES);
+	CHECK_EQUAL_C_INT(FAILURE, rc);
+	rc = aws_iot_mqtt_internal_subscription_index_init(&other, handlers, entries, SUB_INDEX_TEST_HANDLERS,
+													   buckets, SUB_INDEX_TEST_BUCKETS, nodes, 0);
+	CHECK_EQUAL_C_INT(FAILURE, rc);
+
+	IOT_DEBUG("-->Success - H:1 - Init with Null/invalid parameters \n");
+}
+
+/* H:2 - Exact topic filters */
+TEST_C(SubscriptionIndexTests, ExactFilters) {
+	IOT_DEBUG("-->Running Subscription Index Tests - H:2 - Exact topic filters \n");
+
+	setHandler(0, "$aws/things/thermostat/shadow/update/delta");
+	setHandler(1, "$aws/things/thermostat/shadow/get/accepted");
+	setHandler(2, "sdk/Test");
+
+	CHECK_EQUAL_C_INT(0x1, matchTopic("$aws/things/thermostat/shadow/update/delta"));
+	CHECK_EQUAL_C_INT(0x2, matchTopic("$aws/things/thermostat/shadow/get/accepted"));
+	CHECK_EQUAL_C_INT(0x4, matchTopic("sdk/Test"));
+	CHECK_EQUAL_C_INT(0x0, matchTopic("sdk/Tes"));
+	CHECK_EQUAL_C_INT(0x0, matchTopic("sdk/Test/"));
+	CHECK_EQUAL_C_INT(0x0, matchTopic("$aws/things/thermostat/shadow/get/rejected"));
+
+	IOT_DEBUG("-->Success - H:2 - Exact topic filters \n");
+}
+
+/* H:3 - Single level wildcard filters */
+TEST_C(SubscriptionIndexTests, SingleLevelWildcardFilters) {
+	IOT_DEBUG("-->Running Subscription Index Tests - H:3 - Single level wildcard filters \n");
+
+	setHandler(0, "$aws/things/+/shadow/update/delta");
+	setHandler(1, "sensors/+/temperature");
+	setHandler(2, "+");
+	setHandler(3, "sensors/+/+");
+	setHandler(4, "sensors/+");
+
+	CHECK_EQUAL_C_INT(0x1, matchTopic("$aws/things/thermostat/shadow/update/delta"));
+	CHECK_EQUAL_C_INT(0xA, matchTopic("sensors/kitchen/temperature"));
+	CHECK_EQUAL_C_INT(0x8, matchTopic("sensors/kitchen/humidity"));
+	CHECK_EQUAL_C_INT(0x10, matchTopic("sensors/kitchen"));
+	CHECK_EQUAL_C_INT(0x4, matchTopic("sensors"));
+	CHECK_EQUAL_C_INT(0x0, matchTopic("sensors/kitchen/temperature/max"));
+	CHECK_EQUAL_C_INT(0x0, matchTopic("$aws/things/thermostat/shadow/update"));
+
+	IOT_DEBUG("-->Success - H:3 - Single level wildcard filters \n");
+}
+
+/* H:4 - Multi level wildcard filters */
+TEST_C(SubscriptionIndexTests, MultiLevelWildcardFilters) {
+	IOT_DEBUG("-->Running Subscription Index Tests - H:4 - Multi level wildcard filters \n");
+
+	setHandler(0, "$aws/things/thermostat/shadow/#");
+	setHandler(1, "sensors/+/#");
+	setHandler(2, "#");
+
+	CHECK_EQUAL_C_INT(0x5, matchTopic("$aws/things/thermostat/shadow/update/delta"));
+	CHECK_EQUAL_C_INT(0x6, matchTopic("sensors/kitchen/temperature"));
+	CHECK_EQUAL_C_INT(0x4, matchTopic("other"));
+
+	/* Whatever is_topic_matched() decides for the parent level, the index must agree */
+	(void) matchTopic("$aws/things/thermostat/shadow");
+	(void) matchTopic("sensors/kitchen");
+	(void) matchTopic("sensors");
+
+	IOT_DEBUG("-->Success - H:4 - Multi level wildcard filters \n");
+}
+
+/* H:5 - Same filter registered by two handlers */
+TEST_C(SubscriptionIndexTests, DuplicateFilters) {
+	IOT_DEBUG("-->Running Subscription Index Tests - H:5 - Same filter registered by two handlers \n");
+
+	setHandler(0, "sdk/Test");
+	setHandler(1, "sdk/+");
+	setHandler(2, "sdk/Test");
+	setHandler(3, "sdk/+");
+
+	CHECK_EQUAL_C_INT(0xF, matchTopic("sdk/Test"));
+	CHECK_EQUAL_C_INT(0xA, matchTopic("sdk/Other"));
+
+	clearHandler(0);
+	clearHandler(3);
+	CHECK_EQUAL_C_INT(0x6, matchTopic("sdk/Test"));
+	CHECK_EQUAL_C_INT(0x2, matchTopic("sdk/Other"));
+
+	IOT_DEBUG("-->Success - H:5 - Same filter registered by two handlers \n");
+}
+
+/* H:6 - Removing filters releases trie nodes and hash buckets */
+TEST_C(SubscriptionIndexTests, RemoveFilters) {
+	uint16_t i, freeNodes = subIndex.freeNodeCount;
+
+	IOT_DEBUG("-->Running Subscription Index Tests - H:6 - Removing filters releases trie nodes and hash buckets \n");
+
+	setHandler(0, "a/+/c");
+	setHandler(1, "a/b/+");
+	setHandler(2, "a/#");
+	setHandler(3, "a/b/c");
+	CHECK_C(freeNodes > subIndex.freeNodeCount);
+	CHECK_EQUAL_C_INT(0xF, matchTopic("a/b/c"));
+
+	clearHandler(1);
+	CHECK_EQUAL_C_INT(0xD, matchTopic("a/b/c"));
+	clearHandler(3);
+	CHECK_EQUAL_C_INT(0x5, matchTopic("a/b/c"));
+	clearHandler(0);
+	clearHandler(2);
+	CHECK_EQUAL_C_INT(0x0, matchTopic("a/b/c"));
+
+	CHECK_EQUAL_C_INT(freeNodes, subIndex.freeNodeCount);
+	CHECK_EQUAL_C_INT(0, nodes[0].refCount);
+	for(i = 0; i < SUB_INDEX_TEST_BUCKETS; i++) {
+		CHECK_EQUAL_C_INT(0, buckets[i]);
+	}
+
+	IOT_DEBUG("-->Success - H:6 - Removing filters releases trie nodes and hash buckets \n");
+}
+
+/* H:7 - Filters the index does not handle are still matched */
+TEST_C(SubscriptionIndexTests, FallbackFilters) {
+	static const char longFilter[] = "sdk/Test/extra";
+
+	IOT_DEBUG("-->Running Subscription Index Tests - H:7 - Filters the index does not handle are still matched \n");
+
+	setHandler(0, "sdk/a+b");
+	setHandler(1, "sdk/#/b");
+	/* topicNameLen shorter than the C string */
+	handlers[2].topicName = longFilter;
+	handlers[2].topicNameLen = 8;
+	aws_iot_mqtt_internal_subscription_index_add(&subIndex, 2);
+
+	CHECK_EQUAL_C_INT(0x4, matchTopic("sdk/Test") & 0x4);
+	(void) matchTopic("sdk/a+b");
+	(void) matchTopic("sdk/anything/b");
+	(void) matchTopic("sdk/Test/extra");
+
+	clearHandler(0);
+	clearHandler(1);
+	clearHandler(2);
+	CHECK_EQUAL_C_INT(0, subIndex.fallbackHead);
+
+	IOT_DEBUG("-->Success - H:7 - Filters the index does not handle are still matched \n");
+}
+
+/* H:8 - Trie node pool exhausted */
+TEST_C(SubscriptionIndexTests, TrieNodePoolExhausted) {
+	SubscriptionTrieNode smallPool[4];
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Subscription Index Tests - H:8 - Trie node pool exhausted \n");
+
+	rc = aws_iot_mqtt_internal_subscription_index_init(&subIndex, handlers, entries, SUB_INDEX_TEST_HANDLERS,
+													   buckets, SUB_INDEX_TEST_BUCKETS, smallPool, 4);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	setHandler(0, "a/+/c");
+	CHECK_EQUAL_C_INT(0, subIndex.freeNodeCount);
+	/* Needs three more nodes, goes to the fallback list instead */
+	setHandler(1, "x/+/z");
+	CHECK_EQUAL_C_INT(2, subIndex.fallbackHead);
+	/* Shares all nodes with handler 0 */
+	setHandler(2, "a/+/#");
+
+	CHECK_EQUAL_C_INT(0x5, matchTopic("a/b/c"));
+	CHECK_EQUAL_C_INT(0x2, matchTopic("x/y/z"));
+
+	clearHandler(0);
+	clearHandler(2);
+	CHECK_EQUAL_C_INT(3, subIndex.freeNodeCount);
+	CHECK_EQUAL_C_INT(0x2, matchTopic("x/y/z"));
+
+	IOT_DEBUG("-->Success - H:8 - Trie node pool exhausted \n");
+}
+
+/* H:9 - Index agrees with the linear scan over a mixed filter set */
+TEST_C(SubscriptionIndexTests, MatchesLinearScan) {
+	static const char *filters[] = {
+			"a", "a/b", "a/+", "+/b", "a/#", "#", "+/+", "a/b/c", "+/b/#", "a//c",
+			"a/+/c", "/a", "+", "a/b/", "a/+/", "a+",
+	};
+	static const char *topics[] = {
+			"a", "a/b", "a/c", "b/b", "a/b/c", "a//c", "/a", "a/b/", "x/b/y/z", "a+", "", "/", "//",
+	};
+	uint16_t round, i, j;
+
+	IOT_DEBUG("-->Running Subscription Index Tests - H:9 - Index agrees with the linear scan \n");
+
+	srand(1);
+	for(round = 0; round < 200; round++) {
+		i = (uint16_t) (rand() % SUB_INDEX_TEST_HANDLERS);
+		if(NULL == handlers[i].topicName || 0 == rand() % 3) {
+			setHandler(i, filters[rand() % (sizeof(filters) / sizeof(filters[0]))]);
+		} else {
+			clearHandler(i);
+		}
+		for(j = 0; j < sizeof(topics) / sizeof(topics[0]); j++) {
+			(void) matchTopic(topics[j]);
+		}
+	}
+
+	IOT_DEBUG("-->Success - H:9 - Index agrees with the linear scan \n");
+}
+
+/* H:10 - Dispatch cost against handler count, linear scan vs index */
+TEST_C(SubscriptionIndexTests, DispatchBenchmark) {
+	static const char *suffixes[] = {
+			"shadow/update/delta", "shadow/update/accepted", "shadow/update/rejected", "shadow/get/accepted",
+			"shadow/get/rejected", "jobs/notify-next", "jobs/get/accepted", "jobs/start-next/accepted",
+	};
+	MessageHandlers *pHandlers;
+	SubscriptionIndexEntry *pEntries;
+	uint16_t *pBuckets;
+	SubscriptionTrieNode *pNodes;
+	SubscriptionIndex benchIndex;
+	char (*pFilters)[SUB_INDEX_BENCH_TOPIC_LEN];
+	uint32_t indexed[(SUB_INDEX_BENCH_MAX_HANDLERS + 31) / 32];
+	uint32_t linear[(SUB_INDEX_BENCH_MAX_HANDLERS + 31) / 32];
+	char topic[SUB_INDEX_BENCH_TOPIC_LEN];
+	uint16_t count, i, topicLen;
+	uint32_t round;
+	uint64_t start, linearNs, indexNs;
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Subscription Index Tests - H:10 - Dispatch benchmark \n");
+
+	for(count = SUB_INDEX_BENCH_MIN_HANDLERS; count <= SUB_INDEX_BENCH_MAX_HANDLERS; count *= 2) {
+		pHandlers = (MessageHandlers *) calloc(count, sizeof(MessageHandlers));
+		pEntries = (SubscriptionIndexEntry *) calloc(count, sizeof(SubscriptionIndexEntry));
+		pBuckets = (uint16_t *) calloc((2 * count) + 1, sizeof(uint16_t));
+		pNodes = (SubscriptionTrieNode *) calloc((4 * count) + 1, sizeof(SubscriptionTrieNode));
+		pFilters = calloc(count, SUB_INDEX_BENCH_TOPIC_LEN);
+		CHECK_C(NULL != pHandlers && NULL != pEntries && NULL != pBuckets && NULL != pNodes && NULL != pFilters);
+
+		rc = aws_iot_mqtt_internal_subscription_index_init(&benchIndex, pHandlers, pEntries, count, pBuckets,
+														   (uint16_t) ((2 * count) + 1), pNodes,
+														   (uint16_t) ((4 * count) + 1));
+		CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+		/* Shadow and jobs topics of count / 8 things, every eighth handler a wildcard filter instead */
+		for(i = 0; i < count; i++) {
+			if(7 == i % 8) {
+				snprintf(pFilters[i], SUB_INDEX_BENCH_TOPIC_LEN, "$aws/things/thing%u/shadow/+/+", i / 8);
+			} else {
+				snprintf(pFilters[i], SUB_INDEX_BENCH_TOPIC_LEN, "$aws/things/thing%u/%s", i / 8, suffixes[i % 8]);
+			}
+			pHandlers[i].topicName = pFilters[i];
+			pHandlers[i].topicNameLen = (uint16_t) strlen(pFilters[i]);
+			aws_iot_mqtt_internal_subscription_index_add(&benchIndex, i);
+		}
+
+		linearNs = 0;
+		indexNs = 0;
+		for(round = 0; round < SUB_INDEX_BENCH_ROUNDS; round++) {
+			i = (uint16_t) (round % count);
+			snprintf(topic, sizeof(topic), "$aws/things/thing%u/%s", i / 8, suffixes[round % 5]);
+			topicLen = (uint16_t) strlen(topic);
+
+			memset(linear, 0, sizeof(linear));
+			start = nowNs();
+			linearMatch(pHandlers, count, topic, topicLen, linear);
+			linearNs += nowNs() - start;
+
+			memset(indexed, 0, sizeof(indexed));
+			start = nowNs();
+			aws_iot_mqtt_internal_subscription_index_match(&benchIndex, topic, topicLen, indexed);
+			indexNs += nowNs() - start;
+
+			CHECK_C(0 == memcmp(indexed, linear, sizeof(indexed)));
+		}
+
+		printf("\nSubscription dispatch, %3u handlers: linear %6llu ns/msg, indexed %6llu ns/msg", count,
+			   (unsigned long long) (linearNs / SUB_INDEX_BENCH_ROUNDS),
+			   (unsigned long long) (indexNs / SUB_INDEX_BENCH_ROUNDS));
+
+		free(pFilters);
+		free(pNodes);
+		free(pBuckets);
+		free(pEntries);
+		free(pHandlers);
+	}
+	printf("\n");
+
+	IOT_DEBUG("-->Success - H:10 - Dispatch benchmark \n");
+}
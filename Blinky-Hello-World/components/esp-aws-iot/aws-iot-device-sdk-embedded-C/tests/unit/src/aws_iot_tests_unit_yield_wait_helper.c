@@ -0,0 +1,275 @@
+/*
+* Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_tests_unit_yield_wait_helper.c
+ * @brief IoT Client Unit Testing - Yield Waiting For Socket Data Tests Helper
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <CppUTest/TestHarness_c.h>
+
+#include "aws_iot_mqtt_client_interface.h"
+#include "aws_iot_tests_unit_helper_functions.h"
+#include "aws_iot_tests_unit_mock_tls_params.h"
+#include "aws_iot_log.h"
+
+/* Port defaults, a poll blocks for IOT_SSL_READ_TIMEOUT_MS */
+#define YIELD_WAIT_BENCH_READ_TIMEOUT_US 3000
+#define YIELD_WAIT_BENCH_DURATION_MS 2000
+#define YIELD_WAIT_BENCH_YIELD_MS 200
+
+static IoT_Client_Init_Params initParams;
+static IoT_Client_Connect_Params connectParams;
+static IoT_Publish_Message_Params testPubMsgParams;
+static AWS_IoT_Client iotClient;
+static char subTopic[10] = "sdk/Test";
+static uint16_t subTopicLen = 8;
+
+static char CallbackMsgString[100];
+static uint64_t callbackTimeMs;
+
+static uint64_t nowMs(void) {
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	return ((uint64_t) now.tv_sec * 1000) + ((uint64_t) now.tv_usec / 1000);
+}
+
+static uint64_t cpuTimeUs(void) {
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return ((uint64_t) usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000 +
+		   (uint64_t) usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+static void iot_tests_unit_yield_wait_subscribe_callback_handler(AWS_IoT_Client *pClient, char *topicName,
+																 uint16_t topicNameLen,
+																 IoT_Publish_Message_Params *params, void *pData) {
+	IOT_UNUSED(pClient);
+	IOT_UNUSED(topicName);
+	IOT_UNUSED(topicNameLen);
+	IOT_UNUSED(pData);
+
+	snprintf(CallbackMsgString, sizeof(CallbackMsgString), "%.*s", (int) params->payloadLen, (char *) params->payload);
+	callbackTimeMs = nowMs();
+}
+
+TEST_GROUP_C_SETUP(YieldWaitTests) {
+	IoT_Error_t rc;
+
+	ResetTLSBuffer();
+	memset(&mockNetwork, 0, sizeof(mockNetwork));
+	InitMQTTParamsSetup(&initParams, AWS_IOT_MQTT_HOST, AWS_IOT_MQTT_PORT, false, NULL);
+	rc = aws_iot_mqtt_init(&iotClient, &initParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	ConnectMQTTParamsSetup(&connectParams, AWS_IOT_MQTT_CLIENT_ID, (uint16_t) strlen(AWS_IOT_MQTT_CLIENT_ID));
+	setTLSRxBufferForConnack(&connectParams, 0, 0);
+	rc = aws_iot_mqtt_connect(&iotClient, &connectParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	CallbackMsgString[0] = '\0';
+	callbackTimeMs = 0;
+	ResetTLSBuffer();
+	memset(&mockNetwork, 0, sizeof(mockNetwork));
+}
+
+TEST_GROUP_C_TEARDOWN(YieldWaitTests) {
+	IoT_Error_t rc = aws_iot_mqtt_disconnect(&iotClient);
+	IOT_UNUSED(rc);
+	memset(&mockNetwork, 0, sizeof(mockNetwork));
+}
+
+/* L:1 - Idle yield sleeps in the network layer instead of polling */
+TEST_C(YieldWaitTests, YieldIdleWaitsForData) {
+	uint64_t start, elapsed;
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Yield Wait Tests - L:1 - Idle yield sleeps in the network layer \n");
+
+	start = nowMs();
+	rc = aws_iot_mqtt_yield(&iotClient, 500);
+	elapsed = nowMs() - start;
+
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_C(elapsed >= 500);
+	/* One wait for the whole yield, nothing was read */
+	CHECK_EQUAL_C_INT(1, mockNetwork.waitCount);
+	CHECK_EQUAL_C_INT(0, mockNetwork.readCount);
+
+	IOT_DEBUG("-->Success - L:1 - Idle yield sleeps in the network layer \n");
+}
+
+/* L:2 - Message arriving during the wait is handled at once */
+TEST_C(YieldWaitTests, YieldWakesOnData) {
+	char expectedCallbackString[100];
+	uint64_t start;
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Yield Wait Tests - L:2 - Message arriving during the wait is handled at once \n");
+
+	setTLSRxBufferForSuback(subTopic, subTopicLen, QOS1, testPubMsgParams);
+	rc = aws_iot_mqtt_subscribe(&iotClient, subTopic, subTopicLen, QOS0,
+								iot_tests_unit_yield_wait_subscribe_callback_handler, NULL);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	ResetTLSBuffer();
+
+	snprintf(expectedCallbackString, sizeof(expectedCallbackString), "Message for %s", subTopic);
+	setTLSRxBufferWithMsgOnSubscribedTopic(subTopic, subTopicLen, QOS0, testPubMsgParams, expectedCallbackString);
+	setTLSRxBufferDelay(0, 100000);
+
+	start = nowMs();
+	rc = aws_iot_mqtt_yield(&iotClient, 1000);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_STRING(expectedCallbackString, CallbackMsgString);
+	CHECK_C(callbackTimeMs - start >= 100);
+	CHECK_C(callbackTimeMs - start < 300);
+	/* Woken for the message, then slept until the yield timeout, and a wait may end just before its timer */
+	CHECK_C(mockNetwork.waitCount <= 4);
+
+	IOT_DEBUG("-->Success - L:2 - Message arriving during the wait is handled at once \n");
+}
+
+/* L:3 - Wait ends at the keep-alive deadline to send PINGREQ */
+TEST_C(YieldWaitTests, YieldWakesForKeepAlive) {
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Yield Wait Tests - L:3 - Wait ends at the keep-alive deadline \n");
+
+	iotClient.clientData.keepAliveInterval = 1;
+	countdown_sec(&(iotClient.pingReqTimer), iotClient.clientData.keepAliveInterval);
+
+	rc = aws_iot_mqtt_yield(&iotClient, 1500);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(true, isLastTLSTxMessagePingreq());
+	CHECK_EQUAL_C_INT(true, iotClient.clientStatus.isPingOutstanding);
+	/* Once until the PINGREQ is due, once until the yield timeout, and a wait may end just before its timer */
+	CHECK_C(mockNetwork.waitCount <= 4);
+
+	IOT_DEBUG("-->Success - L:3 - Wait ends at the keep-alive deadline \n");
+}
+
+/* L:4 - Yield wakeup from the application */
+TEST_C(YieldWaitTests, YieldWakeup) {
+	uint64_t start, elapsed;
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Yield Wait Tests - L:4 - Yield wakeup from the application \n");
+
+	rc = aws_iot_mqtt_yield_wakeup(NULL);
+	CHECK_EQUAL_C_INT(NULL_VALUE_ERROR, rc);
+
+	rc = aws_iot_mqtt_yield_wakeup(&iotClient);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	start = nowMs();
+	rc = aws_iot_mqtt_yield(&iotClient, 5000);
+	elapsed = nowMs() - start;
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_C(elapsed < 100);
+	CHECK_EQUAL_C_INT(false, iotClient.clientStatus.isYieldWakeupPending);
+	CHECK_EQUAL_C_INT(CLIENT_STATE_CONNECTED_IDLE, aws_iot_mqtt_get_client_state(&iotClient));
+
+	/* The wakeup was used up, the next yield runs to its timeout */
+	start = nowMs();
+	rc = aws_iot_mqtt_yield(&iotClient, 200);
+	elapsed = nowMs() - start;
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_C(elapsed >= 200);
+
+	IOT_DEBUG("-->Success - L:4 - Yield wakeup from the application \n");
+}
+
+/* L:5 - Network layer without waitForData is polled */
+TEST_C(YieldWaitTests, YieldPollsWithoutWaitForData) {
+	char expectedCallbackString[100];
+	IoT_Error_t rc;
+
+	IOT_DEBUG("-->Running Yield Wait Tests - L:5 - Network layer without waitForData is polled \n");
+
+	iotClient.networkStack.waitForData = NULL;
+	iotClient.networkStack.wakeup = NULL;
+
+	setTLSRxBufferForSuback(subTopic, subTopicLen, QOS1, testPubMsgParams);
+	rc = aws_iot_mqtt_subscribe(&iotClient, subTopic, subTopicLen, QOS0,
+								iot_tests_unit_yield_wait_subscribe_callback_handler, NULL);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	ResetTLSBuffer();
+
+	snprintf(expectedCallbackString, sizeof(expectedCallbackString), "Message for %s", subTopic);
+	setTLSRxBufferWithMsgOnSubscribedTopic(subTopic, subTopicLen, QOS0, testPubMsgParams, expectedCallbackString);
+	rc = aws_iot_mqtt_yield(&iotClient, 100);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_STRING(expectedCallbackString, CallbackMsgString);
+	CHECK_EQUAL_C_INT(0, mockNetwork.waitCount);
+	CHECK_C(mockNetwork.readCount > 1);
+
+	/* Wakeup still ends the yield, at the next poll */
+	rc = aws_iot_mqtt_yield_wakeup(&iotClient);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	rc = aws_iot_mqtt_yield(&iotClient, 5000);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+	CHECK_EQUAL_C_INT(false, iotClient.clientStatus.isYieldWakeupPending);
+
+	IOT_DEBUG("-->Success - L:5 - Network layer without waitForData is polled \n");
+}
+
+/* Yields in a loop for YIELD_WAIT_BENCH_DURATION_MS, returns network calls per second */
+static uint32_t yieldIdle(uint64_t *pCpuUs) {
+	uint64_t start, cpuStart;
+	uint32_t calls;
+	IoT_Error_t rc;
+
+	memset(&mockNetwork, 0, sizeof(mockNetwork));
+	mockNetwork.readTimeoutUs = YIELD_WAIT_BENCH_READ_TIMEOUT_US;
+
+	start = nowMs();
+	cpuStart = cpuTimeUs();
+	while(nowMs() - start < YIELD_WAIT_BENCH_DURATION_MS) {
+		rc = aws_iot_mqtt_yield(&iotClient, YIELD_WAIT_BENCH_YIELD_MS);
+		CHECK_EQUAL_C_INT(SUCCESS, rc);
+	}
+	*pCpuUs = cpuTimeUs() - cpuStart;
+
+	calls = mockNetwork.readCount + mockNetwork.waitCount;
+	return (uint32_t) ((calls * 1000) / YIELD_WAIT_BENCH_DURATION_MS);
+}
+
+/* L:6 - Wakeups and CPU time of an idle connection, waiting against polling */
+TEST_C(YieldWaitTests, YieldIdleWakeups) {
+	uint32_t waitRate, pollRate;
+	uint64_t waitCpuUs, pollCpuUs;
+
+	IOT_DEBUG("-->Running Yield Wait Tests - L:6 - Wakeups of an idle connection \n");
+
+	waitRate = yieldIdle(&waitCpuUs);
+
+	iotClient.networkStack.waitForData = NULL;
+	pollRate = yieldIdle(&pollCpuUs);
+
+	printf("\nIdle connection, yield %u ms for %u ms, %u ms read timeout:", YIELD_WAIT_BENCH_YIELD_MS,
+		   YIELD_WAIT_BENCH_DURATION_MS, YIELD_WAIT_BENCH_READ_TIMEOUT_US / 1000);
+	printf("\n  waiting: %5u wakeups/s, %6u us CPU", waitRate, (unsigned) waitCpuUs);
+	printf("\n  polling: %5u wakeups/s, %6u us CPU\n", pollRate, (unsigned) pollCpuUs);
+
+	/* One or two wakeups per yield call against one per read timeout */
+	CHECK_C(waitRate <= 2 * (1000 / YIELD_WAIT_BENCH_YIELD_MS));
+	CHECK_C(pollRate > 10 * waitRate);
+
+	IOT_DEBUG("-->Success - L:6 - Wakeups of an idle connection \n");
+}
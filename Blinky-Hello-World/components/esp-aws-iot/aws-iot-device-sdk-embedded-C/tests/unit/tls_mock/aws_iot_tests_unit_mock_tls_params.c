@@ -40,6 +40,9 @@ TlsBuffer TxBuffer = {.pBuffer = TxBuf,.len = 512, .NoMsgFlag=1, .expiry_time =
 
 size_t RxIndex = 0;
 
+MockBroker mockBroker;
+MockNetwork mockNetwork;
+
 char *invalidEndpointFilter;
 char *invalidRootCAPathFilter;
 char *invalidCertPathFilter;
@@ -53,6 +53,7 @@ typedef struct _TLSDataParams {
     mbedtls_x509_crt clicert;
     mbedtls_pk_context pkey;
     mbedtls_net_context server_fd;
+    int wakeup_fd; /* Loopback UDP socket that interrupts iot_tls_wait_for_data, closed by iot_tls_destroy */
 }TLSDataParams;
 
 #define IOTSDKC_NETWORK_MBEDTLS_PLATFORM_H_H
@@ -2,17 +2,21 @@
 #include "freertos/task.h"
 #include "freertos/semphr.h"
 #include "freertos/queue.h"
+#include "esp_timer.h"
 
 #include "ft6336u.h"
 #include "button.h"
 
 Button_t* button_ahead = NULL;
 static SemaphoreHandle_t button_lock = NULL;
-static void Button_UpdateTask(void *arg);
+static FT6336U_EventQueue_t *button_events = NULL;
+static uint32_t button_dropped = 0;
+static void Button_Poll();
+static void Button_UpdateAt(Button_t* button, uint8_t press, uint16_t x, uint16_t y, uint32_t now_ticks);
 
 void Button_Init() {
     button_lock = xSemaphoreCreateMutex();
-    xTaskCreatePinnedToCore(Button_UpdateTask, "Button", 2 * 1024, NULL, 1, NULL, 0);
+    button_events = FT6336U_Subscribe(NULL);
 }
 
 Button_t* Button_Attach(uint16_t x, uint16_t y, uint16_t w, uint16_t h) {
@@ -42,6 +46,7 @@ Button_t* Button_Attach(uint16_t x, uint16_t y, uint16_t w, uint16_t h) {
 
 uint8_t Button_WasPressed(Button_t* button) {
     xSemaphoreTake(button_lock, portMAX_DELAY);
+    Button_Poll();
     uint8_t result = (button->state & PRESS) > 0;
     button->state &= ~PRESS;
     xSemaphoreGive(button_lock);
@@ -50,6 +55,7 @@ uint8_t Button_WasPressed(Button_t* button) {
 
 uint8_t Button_WasReleased(Button_t* button) {
     xSemaphoreTake(button_lock, portMAX_DELAY);
+    Button_Poll();
     uint8_t result = (button->state & RELEASE) > 0;
     button->state &= ~RELEASE;
     xSemaphoreGive(button_lock);
@@ -58,6 +64,7 @@ uint8_t Button_WasReleased(Button_t* button) {
 
 uint8_t Button_WasLongPress(Button_t* button, uint32_t long_press_time) {
     xSemaphoreTake(button_lock, portMAX_DELAY);
+    Button_Poll();
     button->long_press_time = long_press_time;
     uint8_t result = (button->state & LONGPRESS) > 0;
     button->state &= ~LONGPRESS;
@@ -67,6 +74,7 @@ uint8_t Button_WasLongPress(Button_t* button, uint32_t long_press_time) {
 
 uint8_t Button_IsPress(Button_t* button) {
     xSemaphoreTake(button_lock, portMAX_DELAY);
+    Button_Poll();
     uint8_t result = (button->value == 1);
     xSemaphoreGive(button_lock);
     return result;
@@ -74,14 +82,18 @@ uint8_t Button_IsPress(Button_t* button) {
 
 uint8_t Button_IsRelease(Button_t* button) {
     xSemaphoreTake(button_lock, portMAX_DELAY);
+    Button_Poll();
     uint8_t result = (button->value == 0);
     xSemaphoreGive(button_lock);
     return result;
 }
 
 void Button_Update(Button_t* button, uint8_t press, uint16_t x, uint16_t y) {
+    Button_UpdateAt(button, press, x, y, xTaskGetTickCount());
+}
+
+static void Button_UpdateAt(Button_t* button, uint8_t press, uint16_t x, uint16_t y, uint32_t now_ticks) {
     uint8_t value = press & !((x < button->x) || (x > (button->x + button->w)) || (y < button->y) || (y > (button->y + button->h)));
-    uint32_t now_ticks = xTaskGetTickCount();
     if (value != button->last_value) {
         if (value == 1) {
             button->state |= PRESS;
@@ -99,20 +111,36 @@ void Button_Update(Button_t* button, uint8_t press, uint16_t x, uint16_t y) {
     button->value = value;
 }
 
-static void Button_UpdateTask(void *arg) {
+/* Applies the touch events queued since the last call to every button, with button_lock held */
+static void Button_Poll() {
     Button_t* button;
-    uint16_t x, y;
-    bool press;
+    FT6336U_Event_t event;
 
-    for (;;) {
+    if (button_events == NULL) {
+        return;
+    }
+
+    while (FT6336U_GetEvent(button_events, &event)) {
+        if (!event.primary) {
+            continue;
+        }
+        /* Ticks when the screen was touched, not when the event is looked at */
+        uint32_t age_ms = (esp_timer_get_time() - event.timestamp_us) / 1000;
+        uint32_t event_ticks = xTaskGetTickCount() - pdMS_TO_TICKS(age_ms);
+        uint8_t press = event.type != FT6336U_EVENT_UP;
+        for (button = button_ahead; button != NULL; button = button->next) {
+            Button_UpdateAt(button, press, event.x, event.y, event_ticks);
+        }
+    }
+
+    /* Events were lost while nobody asked, catch up with the current touch */
+    if (button_events->dropped != button_dropped) {
+        uint16_t x, y;
+        bool press;
+        button_dropped = button_events->dropped;
         FT6336U_GetTouch(&x, &y, &press);
-        xSemaphoreTake(button_lock, portMAX_DELAY);
-        button = button_ahead;
-        while (button != NULL) {
+        for (button = button_ahead; button != NULL; button = button->next) {
             Button_Update(button, press, x, y);
-            button = button->next;
         }
-        xSemaphoreGive(button_lock);
-        vTaskDelay(pdMS_TO_TICKS(20));
     }
-}
\ No newline at end of file
+}
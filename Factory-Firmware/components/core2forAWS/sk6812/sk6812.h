@@ -26,6 +26,8 @@
 
 #pragma once
 
+#include <stdbool.h>
+
 #include "driver/gpio.h"
 #include "driver/rmt.h"
 
@@ -44,14 +46,31 @@ typedef struct pixel_settings {
 	uint8_t brightness;		// brightness factor applied to pixel color
 	char color_order[5];
 	uint8_t nbits;			// number of bits used (24 for RGB devices, 32 for RGBW devices)
+	bool gamma;				// gamma correct the pixel values before the brightness is applied
 } pixel_settings_t;
 
+typedef struct np_stats {
+	uint32_t frames;		// frames started by np_show()
+	uint32_t show_us;		// CPU time of np_show(), without the wait for the previous frame
+	uint32_t isr_us;		// time in the RMT translator, the first block is translated by np_show()
+	uint32_t isr_calls;		// calls of the RMT translator
+} np_stats_t;
+
+// Called by the animation task before each frame is shown, return false to end the animation
+typedef bool (*np_frame_cb_t)(pixel_settings_t *px, uint32_t frame, void *arg);
+
 void np_set_pixel_color(pixel_settings_t *px, uint16_t idx, uint32_t color);
 void np_set_pixel_color_hsb(pixel_settings_t *px, uint16_t idx, float hue, float saturation, float brightness);
 uint32_t np_get_pixel_color(pixel_settings_t *px, uint16_t idx, uint8_t *white);
 void np_show(pixel_settings_t *px, rmt_channel_t channel);
 void np_clear(pixel_settings_t *px);
 
+void np_get_stats(np_stats_t *stats);
+void np_enable_stats(bool enable);
+
+esp_err_t np_animation_start(pixel_settings_t *px, rmt_channel_t channel, uint16_t fps, np_frame_cb_t frame_cb, void *arg);
+void np_animation_stop(void);
+
 int neopixel_init(int gpioNum, rmt_channel_t channel);
 void neopixel_deinit(rmt_channel_t channel);
 
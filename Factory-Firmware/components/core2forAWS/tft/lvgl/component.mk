@@ -14,5 +14,6 @@ COMPONENT_SRCDIRS := lvgl/ \
 	lvgl/src/lv_hal \
 	lvgl/src/lv_misc \
 	lvgl/src/lv_themes \
-	lvgl/src/lv_font
+	lvgl/src/lv_font \
+	lvgl/src/lv_gpu
 COMPONENT_ADD_INCLUDEDIRS := $(COMPONENT_SRCDIRS) .
@@ -0,0 +1,95 @@
+/**
+ * @file lv_gpu_esp32.h
+ *
+ */
+
+#ifndef LV_GPU_ESP32_H
+#define LV_GPU_ESP32_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "../lv_misc/lv_area.h"
+#include "../lv_misc/lv_color.h"
+#include "../lv_hal/lv_hal_disp.h"
+
+#if LV_USE_GPU_ESP32
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Fill an area in the buffer with a color
+ * @param buf a buffer which should be filled
+ * @param buf_w width of the buffer in pixels
+ * @param color fill color
+ * @param fill_w width to fill in pixels (<= buf_w)
+ * @param fill_h height to fill in pixels
+ * @note `buf_w - fill_w` is offset to the next line after fill
+ */
+void lv_gpu_esp32_fill(lv_color_t * buf, lv_coord_t buf_w, lv_color_t color, lv_coord_t fill_w, lv_coord_t fill_h);
+
+/**
+ * Copy a map (typically RGB image) to a buffer
+ * @param buf a buffer where map should be copied
+ * @param buf_w width of the buffer in pixels
+ * @param map an "image" to copy
+ * @param map_w width of the map in pixels
+ * @param copy_w width of the area to copy in pixels (<= buf_w)
+ * @param copy_h height of the area to copy in pixels
+ * @note `map_w - fill_w` is offset to the next line after copy
+ */
+void lv_gpu_esp32_copy(lv_color_t * buf, lv_coord_t buf_w, const lv_color_t * map, lv_coord_t map_w,
+                       lv_coord_t copy_w, lv_coord_t copy_h);
+
+/**
+ * Blend a map (RGB image with opacity) to a buffer. The result is the same as `lv_color_mix` gives.
+ * @param buf a buffer where `map` should be copied
+ * @param buf_w width of the buffer in pixels
+ * @param map an "image" to copy
+ * @param opa opacity of `map`
+ * @param map_w width of the map in pixels
+ * @param copy_w width of the area to copy in pixels (<= buf_w)
+ * @param copy_h height of the area to copy in pixels
+ * @note `map_w - fill_w` is offset to the next line after copy
+ */
+void lv_gpu_esp32_blend(lv_color_t * buf, lv_coord_t buf_w, const lv_color_t * map, lv_opa_t opa,
+                        lv_coord_t map_w, lv_coord_t copy_w, lv_coord_t copy_h);
+
+/**
+ * Can be used as `gpu_fill_cb` in display driver
+ */
+void lv_gpu_esp32_fill_cb(lv_disp_drv_t * disp_drv, lv_color_t * dest_buf, lv_coord_t dest_width,
+                          const lv_area_t * fill_area, lv_color_t color);
+
+/**
+ * Can be used as `gpu_blend_cb` in display driver. Copies when `opa` is above `LV_OPA_MAX` as the software
+ * rendering does.
+ */
+void lv_gpu_esp32_blend_cb(lv_disp_drv_t * disp_drv, lv_color_t * dest, const lv_color_t * src, uint32_t length,
+                           lv_opa_t opa);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#endif /*LV_USE_GPU_ESP32*/
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /*LV_GPU_ESP32_H*/
@@ -0,0 +1,38 @@
+/**
+ * @file lv_test_gpu_esp32.h
+ *
+ */
+
+#ifndef LV_TEST_GPU_ESP32_H
+#define LV_TEST_GPU_ESP32_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+void lv_test_gpu_esp32(void);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /*LV_TEST_GPU_ESP32_H*/
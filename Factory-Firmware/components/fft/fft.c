@@ -54,20 +54,29 @@ fft_config_t *fft_init(int size, fft_type_t type, fft_direction_t direction, flo
    */
   int k,m;
 
-  fft_config_t *config = (fft_config_t *)malloc(sizeof(fft_config_t));
-
   // Check if the size is a power of two
   if ((size & (size-1)) != 0)  // tests if size is a power of two
     return NULL;
 
+  fft_config_t *config = (fft_config_t *)malloc(sizeof(fft_config_t));
+  if (config == NULL)
+    return NULL;
+
   // start configuration
   config->flags = 0;
   config->type = type;
   config->direction = direction;
   config->size = size;
+  config->input = NULL;
+  config->output = NULL;
 
   // Allocate and precompute twiddle factors
   config->twiddle_factors = (float *)malloc(2 * config->size * sizeof(float));
+  if (config->twiddle_factors == NULL)
+  {
+    fft_destroy(config);
+    return NULL;
+  }
 
   float two_pi_by_n = TWO_PI / config->size;
 
@@ -91,7 +100,10 @@ fft_config_t *fft_init(int size, fft_type_t type, fft_direction_t direction, flo
   }
 
   if (config->input == NULL)
+  {
+    fft_destroy(config);
     return NULL;
+  }
 
   // Allocate output buffer
   if (output != NULL)
@@ -107,7 +119,10 @@ fft_config_t *fft_init(int size, fft_type_t type, fft_direction_t direction, flo
   }
 
   if (config->output == NULL)
+  {
+    fft_destroy(config);
     return NULL;
+  }
 
   return config;
 }
@@ -136,6 +151,345 @@ void fft_execute(fft_config_t *config)
     ifft(config->input, config->output, config->twiddle_factors, config->size);
 }
 
+fft_q15_config_t *fft_q15_init(int size)
+{
+  /*
+   * Prepare a forward real FFT on Q15 fixed-point data.
+   *
+   * The transform is computed as a complex FFT of size / 2 points on the
+   * even/odd packed samples, followed by a split step to recover the
+   * positive frequencies. All buffers and tables are allocated here.
+   */
+  int k, b, m;
+  int half = size / 2;
+
+  // Check if the size is a power of two
+  if (size < 4 || (size & (size-1)) != 0)
+    return NULL;
+
+  fft_q15_config_t *config = (fft_q15_config_t *)calloc(1, sizeof(fft_q15_config_t));
+  if (config == NULL)
+    return NULL;
+
+  config->size = size;
+  config->buffer = (int16_t *)malloc(size * sizeof(int16_t));
+  config->twiddle_factors = (int16_t *)malloc(size * sizeof(int16_t));
+  config->bitrev = (uint16_t *)malloc(half * sizeof(uint16_t));
+
+  if (config->buffer == NULL || config->twiddle_factors == NULL || config->bitrev == NULL)
+  {
+    fft_q15_destroy(config);
+    return NULL;
+  }
+
+  // W_N^k for k < N / 2, covers both the complex stages and the split step
+  float two_pi_by_n = TWO_PI / size;
+  for (k = 0, m = 0 ; k < half ; k++, m+=2)
+  {
+    config->twiddle_factors[m] = (int16_t)lrintf(Q15_ONE * cosf(two_pi_by_n * k));
+    config->twiddle_factors[m+1] = (int16_t)lrintf(Q15_ONE * sinf(two_pi_by_n * k));
+  }
+
+  for (k = 0 ; k < half ; k++)
+  {
+    int r = 0;
+    for (b = 1 ; b < half ; b <<= 1)
+      r = (r << 1) | ((k & b) ? 1 : 0);
+    config->bitrev[k] = r;
+  }
+
+  return config;
+}
+
+void fft_q15_destroy(fft_q15_config_t *config)
+{
+  free(config->buffer);
+  free(config->twiddle_factors);
+  free(config->bitrev);
+  free(config);
+}
+
+void rfft_q15(fft_q15_config_t *config, const int16_t *x, const int16_t *window)
+{
+  /*
+   * Forward real FFT of Q15 samples
+   *
+   * If window is not NULL, each sample is multiplied by the matching Q15
+   * window coefficient while it is loaded.
+   *
+   * Every stage is scaled by 1/2 so that no intermediate result can
+   * overflow. The output is therefore X[k] / (2 * N), stored in
+   * config->buffer with the same layout as rfft:
+   *
+   *   [ X[0], X[N/2], Re(X[1]), Im(X[1]), ..., Re(X[N/2-1]), Im(X[N/2-1]) ]
+   */
+  int k, j, len;
+  int n = config->size;
+  int half = n / 2;
+  int16_t *y = config->buffer;
+  const int16_t *tw = config->twiddle_factors;
+
+  // Pack even samples into the real and odd samples into the imaginary
+  // parts, in bit reversed order, with headroom for the butterflies
+  if (window != NULL)
+  {
+    for (k = 0 ; k < half ; k++)
+    {
+      int r = 2 * config->bitrev[k];
+      y[r]   = ((int32_t)x[2 * k] * window[2 * k] + (1 << 15)) >> 16;
+      y[r+1] = ((int32_t)x[2 * k + 1] * window[2 * k + 1] + (1 << 15)) >> 16;
+    }
+  }
+  else
+  {
+    for (k = 0 ; k < half ; k++)
+    {
+      int r = 2 * config->bitrev[k];
+      y[r]   = x[2 * k] >> 1;
+      y[r+1] = x[2 * k + 1] >> 1;
+    }
+  }
+
+  // Iterative radix-2 decimation in time, scaled by 1/2 per stage
+  for (len = 2 ; len <= half ; len <<= 1)
+  {
+    int tw_stride = 2 * (n / len);
+    for (k = 0 ; k < half ; k += len)
+    {
+      int16_t *a = y + 2 * k;
+      int16_t *b = a + len;
+      for (j = 0 ; j < len / 2 ; j++)
+      {
+        int32_t c = tw[j * tw_stride];
+        int32_t s = tw[j * tw_stride + 1];
+        int32_t br = b[2 * j];
+        int32_t bi = b[2 * j + 1];
+        int32_t tr = (br * c + bi * s + (1 << 14)) >> 15;
+        int32_t ti = (bi * c - br * s + (1 << 14)) >> 15;
+        int32_t ar = a[2 * j];
+        int32_t ai = a[2 * j + 1];
+
+        a[2 * j]     = (ar + tr) >> 1;
+        a[2 * j + 1] = (ai + ti) >> 1;
+        b[2 * j]     = (ar - tr) >> 1;
+        b[2 * j + 1] = (ai - ti) >> 1;
+      }
+    }
+  }
+
+  // Split step, X[k] = Xe[k] + W_N^k Xo[k], with one more scaling by 1/2
+  int32_t z0r = y[0];
+  int32_t z0i = y[1];
+  y[0] = (z0r + z0i) >> 1;  // DC coefficient
+  y[1] = (z0r - z0i) >> 1;  // Center coefficient
+
+  for (k = 1 ; k <= half / 2 ; k++)
+  {
+    int32_t zkr = y[2 * k];
+    int32_t zki = y[2 * k + 1];
+    int32_t zmr = y[2 * (half - k)];
+    int32_t zmi = y[2 * (half - k) + 1];
+
+    int32_t er = (zkr + zmr) >> 1;
+    int32_t ei = (zki - zmi) >> 1;
+    int32_t or_t = (zki + zmi) >> 1;
+    int32_t oi = (zmr - zkr) >> 1;
+
+    int32_t c = tw[2 * k];
+    int32_t s = tw[2 * k + 1];
+
+    // W_N^k Xo[k]
+    int32_t tr = (or_t * c + oi * s + (1 << 14)) >> 15;
+    int32_t ti = (oi * c - or_t * s + (1 << 14)) >> 15;
+
+    // W_N^(N/2-k) = -conj(W_N^k) and Xe, Xo are conjugated at N/2-k,
+    // the imaginary part of the product is the same as ti
+    int32_t ur = (-or_t * c - oi * s + (1 << 14)) >> 15;
+
+    y[2 * k]     = (er + tr) >> 1;
+    y[2 * k + 1] = (ei + ti) >> 1;
+    y[2 * (half - k)]     = (er + ur) >> 1;
+    y[2 * (half - k) + 1] = (ti - ei) >> 1;
+  }
+}
+
+spectrum_config_t *spectrum_init(int size, spectrum_backend_t backend, spectrum_window_t window, float scale, float *input, float *output, float *magnitude)
+{
+  /*
+   * Prepare a streaming magnitude spectrum of a real signal.
+   *
+   * The FFT plan, window and buffers are set up once here so that
+   * spectrum_process can run on every frame without touching the heap.
+   * As with fft_init, buffers that are not provided will be allocated.
+   *
+   * Parameters
+   * ----------
+   *  size (int)
+   *    The FFT size, should be a power of 2
+   *  backend (spectrum_backend_t)
+   *    SPECTRUM_BACKEND_FLOAT or SPECTRUM_BACKEND_Q15
+   *  window (spectrum_window_t)
+   *    The analysis window applied to each frame
+   *  scale (float)
+   *    The gain applied to each int16 PCM sample before the transform
+   *  input, output (float *)
+   *    Work buffers of size floats each, or NULL. Unused by the Q15 backend
+   *  magnitude (float *)
+   *    The buffer receiving size / 2 magnitude bins, or NULL
+   */
+  int k;
+
+  spectrum_config_t *spectrum = (spectrum_config_t *)calloc(1, sizeof(spectrum_config_t));
+  if (spectrum == NULL)
+    return NULL;
+
+  spectrum->size = size;
+  spectrum->backend = backend;
+  spectrum->scale = scale;
+
+  if (backend == SPECTRUM_BACKEND_Q15)
+    spectrum->plan_q15 = fft_q15_init(size);
+  else
+    spectrum->plan = fft_init(size, FFT_REAL, FFT_FORWARD, input, output);
+
+  if (spectrum->plan == NULL && spectrum->plan_q15 == NULL)
+  {
+    spectrum_destroy(spectrum);
+    return NULL;
+  }
+
+  if (window == SPECTRUM_WINDOW_HANN)
+  {
+    float two_pi_by_n = TWO_PI / size;
+
+    if (backend == SPECTRUM_BACKEND_Q15)
+    {
+      spectrum->window_q15 = (int16_t *)malloc(size * sizeof(int16_t));
+      if (spectrum->window_q15 == NULL)
+      {
+        spectrum_destroy(spectrum);
+        return NULL;
+      }
+
+      for (k = 0 ; k < size ; k++)
+        spectrum->window_q15[k] = (int16_t)lrintf(Q15_ONE * 0.5f * (1.0f - cosf(two_pi_by_n * k)));
+    }
+    else
+    {
+      // Fold the input scale into the window so each sample costs one multiply
+      spectrum->window = (float *)malloc(size * sizeof(float));
+      if (spectrum->window == NULL)
+      {
+        spectrum_destroy(spectrum);
+        return NULL;
+      }
+
+      for (k = 0 ; k < size ; k++)
+        spectrum->window[k] = scale * 0.5f * (1.0f - cosf(two_pi_by_n * k));
+    }
+    spectrum->flags |= SPECTRUM_OWN_WINDOW_MEM;
+  }
+
+  if (magnitude != NULL)
+    spectrum->magnitude = magnitude;
+  else
+  {
+    spectrum->magnitude = (float *)malloc(size / 2 * sizeof(float));
+    if (spectrum->magnitude == NULL)
+    {
+      spectrum_destroy(spectrum);
+      return NULL;
+    }
+    spectrum->flags |= SPECTRUM_OWN_MAGNITUDE_MEM;
+  }
+
+  return spectrum;
+}
+
+void spectrum_destroy(spectrum_config_t *spectrum)
+{
+  if (spectrum->plan != NULL)
+    fft_destroy(spectrum->plan);
+
+  if (spectrum->plan_q15 != NULL)
+    fft_q15_destroy(spectrum->plan_q15);
+
+  if (spectrum->flags & SPECTRUM_OWN_WINDOW_MEM)
+  {
+    free(spectrum->window);
+    free(spectrum->window_q15);
+  }
+
+  if (spectrum->flags & SPECTRUM_OWN_MAGNITUDE_MEM)
+    free(spectrum->magnitude);
+
+  free(spectrum);
+}
+
+static void spectrum_process_float(spectrum_config_t *spectrum, const int16_t *pcm)
+{
+  int k;
+  int n = spectrum->size;
+  float *x = spectrum->plan->input;
+  float *y = spectrum->plan->output;
+  float *mag = spectrum->magnitude;
+
+  if (spectrum->window != NULL)
+  {
+    const float *w = spectrum->window;
+    for (k = 0 ; k < n ; k++)
+      x[k] = w[k] * pcm[k];
+  }
+  else
+  {
+    float scale = spectrum->scale;
+    for (k = 0 ; k < n ; k++)
+      x[k] = scale * pcm[k];
+  }
+
+  fft_execute(spectrum->plan);
+
+  // y[0] is the DC coefficient, y[1] the real-valued N/2 coefficient
+  mag[0] = fabsf(y[0]);
+  for (k = 1 ; k < n / 2 ; k++)
+    mag[k] = sqrtf(y[2 * k] * y[2 * k] + y[2 * k + 1] * y[2 * k + 1]);
+}
+
+static void spectrum_process_q15(spectrum_config_t *spectrum, const int16_t *pcm)
+{
+  int k;
+  int n = spectrum->size;
+  int16_t *y = spectrum->plan_q15->buffer;
+  float *mag = spectrum->magnitude;
+
+  rfft_q15(spectrum->plan_q15, pcm, spectrum->window_q15);
+
+  // Undo the 1 / (2 * N) scaling of rfft_q15 and apply the input scale
+  float gain = spectrum->scale * 2 * n;
+
+  mag[0] = gain * abs(y[0]);
+  for (k = 1 ; k < n / 2 ; k++)
+  {
+    int32_t re = y[2 * k];
+    int32_t im = y[2 * k + 1];
+    mag[k] = gain * sqrtf((float)(re * re + im * im));
+  }
+}
+
+void spectrum_process(spectrum_config_t *spectrum, const int16_t *pcm)
+{
+  /*
+   * Window one frame of int16 PCM, run the real FFT and store the
+   * magnitude of bins 0 to size / 2 - 1 in spectrum->magnitude.
+   *
+   * The frame must hold spectrum->size samples.
+   */
+  if (spectrum->backend == SPECTRUM_BACKEND_Q15)
+    spectrum_process_q15(spectrum, pcm);
+  else
+    spectrum_process_float(spectrum, pcm);
+}
+
 void fft(float *input, float *output, float *twiddle_factors, int n)
 {
   /*
@@ -0,0 +1,247 @@
+/*
+ * Accuracy and throughput of the float and Q15 backends of the spectrum engine.
+ * Both are compared with a DFT computed in double precision on the same int16 frames.
+ * The frame rate and heap calls of spectrum_process are compared with a plan built and
+ * destroyed on every frame, as the microphone tasks did before.
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "fft.h"
+
+#define NFFT          512
+#define SCALE         (1.0f / 32768)
+#define BENCH_FRAMES  200000
+
+static int failed;
+static long heap_calls;
+static long heap_fail_after = -1;  // fail the allocation after this many, -1 never
+static long heap_live;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void __real_free(void *p);
+
+static bool heap_fails(void)
+{
+  heap_calls++;
+  return heap_fail_after >= 0 && heap_fail_after-- == 0;
+}
+
+void *__wrap_malloc(size_t size)
+{
+  void *p = heap_fails() ? NULL : __real_malloc(size);
+  heap_live += p != NULL;
+  return p;
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+  void *p = heap_fails() ? NULL : __real_calloc(n, size);
+  heap_live += p != NULL;
+  return p;
+}
+
+void __wrap_free(void *p)
+{
+  heap_calls += p != NULL;
+  heap_live -= p != NULL;
+  __real_free(p);
+}
+
+static void check(bool ok, const char *what)
+{
+  printf("%-60s %s\n", what, ok ? "ok" : "FAILED");
+  failed += !ok;
+}
+
+static double now_s(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Two tones off the bin centres and some noise, the kind of frame the microphone tasks see
+static void fill_frame(int16_t *pcm, int n, unsigned int seed)
+{
+  int k;
+  for (k = 0 ; k < n ; k++)
+  {
+    double v = 12000 * sin(2 * M_PI * 37.3 * k / n) + 3000 * sin(2 * M_PI * 101.7 * k / n);
+    pcm[k] = (int16_t)lrint(v + (rand_r(&seed) % 2001 - 1000));
+  }
+}
+
+// Magnitude of bins 0 to n / 2 - 1 as spectrum_process computes them
+static void reference(const int16_t *pcm, int n, bool hann, double scale, double *mag)
+{
+  int k, j;
+  for (k = 0 ; k < n / 2 ; k++)
+  {
+    double re = 0, im = 0;
+    for (j = 0 ; j < n ; j++)
+    {
+      double w = hann ? 0.5 * (1 - cos(2 * M_PI * j / n)) : 1.0;
+      double x = scale * w * pcm[j];
+      re += x * cos(2 * M_PI * k * j / n);
+      im -= x * sin(2 * M_PI * k * j / n);
+    }
+    mag[k] = sqrt(re * re + im * im);
+  }
+}
+
+// Largest error over all bins, relative to the largest bin
+static double max_error(const float *mag, const double *ref, int bins)
+{
+  int k;
+  double peak = 0, err = 0;
+  for (k = 0 ; k < bins ; k++)
+  {
+    peak = fmax(peak, ref[k]);
+    err = fmax(err, fabs(mag[k] - ref[k]));
+  }
+  return err / peak;
+}
+
+static int peak_bin(const float *mag, int bins)
+{
+  int k, peak = 0;
+  for (k = 1 ; k < bins ; k++)
+    if (mag[k] > mag[peak])
+      peak = k;
+  return peak;
+}
+
+static double frames_per_s(spectrum_config_t *spectrum, const int16_t *pcm, long *calls)
+{
+  int i;
+  long before = heap_calls;
+  double start = now_s();
+  for (i = 0 ; i < BENCH_FRAMES ; i++)
+    spectrum_process(spectrum, pcm);
+  double rate = BENCH_FRAMES / (now_s() - start);
+  *calls = heap_calls - before;
+  return rate;
+}
+
+// The loop of the microphone tasks before the spectrum engine: a new plan for every frame
+static double frames_per_s_per_frame_plan(const int16_t *pcm, float *mag, long *calls)
+{
+  int i, k;
+  long before = heap_calls;
+  double start = now_s();
+  for (i = 0 ; i < BENCH_FRAMES ; i++)
+  {
+    fft_config_t *plan = fft_init(NFFT, FFT_REAL, FFT_FORWARD, NULL, NULL);
+    for (k = 0 ; k < NFFT ; k++)
+      plan->input[k] = SCALE * pcm[k];
+    fft_execute(plan);
+    mag[0] = fabsf(plan->output[0]);
+    for (k = 1 ; k < NFFT / 2 ; k++)
+      mag[k] = sqrtf(plan->output[2 * k] * plan->output[2 * k] + plan->output[2 * k + 1] * plan->output[2 * k + 1]);
+    fft_destroy(plan);
+  }
+  double rate = BENCH_FRAMES / (now_s() - start);
+  *calls = heap_calls - before;
+  return rate;
+}
+
+// Fail each allocation of spectrum_init in turn, it must return NULL and leak nothing
+static bool init_fails_cleanly(spectrum_backend_t backend)
+{
+  long n;
+  bool ok = true;
+  for (n = 0 ; ; n++)
+  {
+    heap_fail_after = n;
+    spectrum_config_t *spectrum = spectrum_init(NFFT, backend, SPECTRUM_WINDOW_HANN, SCALE, NULL, NULL, NULL);
+    bool failed_alloc = heap_fail_after < 0;
+    heap_fail_after = -1;
+    if (spectrum != NULL)
+    {
+      spectrum_destroy(spectrum);
+      return ok && !failed_alloc && n > 0;
+    }
+    ok = ok && failed_alloc && heap_live == 0;
+  }
+}
+
+int main(int argc, char **argv)
+{
+  static int16_t pcm[NFFT];
+  static double ref[NFFT / 2];
+  spectrum_backend_t backends[] = { SPECTRUM_BACKEND_FLOAT, SPECTRUM_BACKEND_Q15 };
+  spectrum_window_t windows[] = { SPECTRUM_WINDOW_NONE, SPECTRUM_WINDOW_HANN };
+  const char *backend_names[] = { "float", "q15" };
+  const char *window_names[] = { "none", "hann" };
+  static float mag[NFFT / 2];
+  double errors[2][2], rates[2], plan_rate;
+  long calls[2], plan_calls;
+  double bounds[] = { 1e-5, 3e-3 };  // float rounding, a few LSB of the Q15 output
+  char what[80];
+  int b, w, k;
+
+  check(spectrum_init(500, SPECTRUM_BACKEND_FLOAT, SPECTRUM_WINDOW_NONE, SCALE, NULL, NULL, NULL) == NULL, "float backend rejects a size that is not a power of two");
+  check(spectrum_init(500, SPECTRUM_BACKEND_Q15, SPECTRUM_WINDOW_NONE, SCALE, NULL, NULL, NULL) == NULL, "q15 backend rejects a size that is not a power of two");
+
+  fill_frame(pcm, NFFT, 1);
+  for (w = 0 ; w < 2 ; w++)
+  {
+    reference(pcm, NFFT, windows[w] == SPECTRUM_WINDOW_HANN, SCALE, ref);
+    for (b = 0 ; b < 2 ; b++)
+    {
+      spectrum_config_t *spectrum = spectrum_init(NFFT, backends[b], windows[w], SCALE, NULL, NULL, NULL);
+      spectrum_process(spectrum, pcm);
+      errors[b][w] = max_error(spectrum->magnitude, ref, NFFT / 2);
+
+      snprintf(what, sizeof(what), "%s, %s window: within %g of the peak", backend_names[b], window_names[w], bounds[b]);
+      check(errors[b][w] < bounds[b], what);
+      snprintf(what, sizeof(what), "%s, %s window: peak in bin 37", backend_names[b], window_names[w]);
+      check(peak_bin(spectrum->magnitude, NFFT / 2) == 37, what);
+      spectrum_destroy(spectrum);
+    }
+  }
+
+  // A full scale square wave is the worst case for overflow in the Q15 stages
+  for (k = 0 ; k < NFFT ; k++)
+    pcm[k] = (k / 8) % 2 ? -32768 : 32767;
+  reference(pcm, NFFT, false, SCALE, ref);
+  spectrum_config_t *q15 = spectrum_init(NFFT, SPECTRUM_BACKEND_Q15, SPECTRUM_WINDOW_NONE, SCALE, NULL, NULL, NULL);
+  spectrum_process(q15, pcm);
+  check(max_error(q15->magnitude, ref, NFFT / 2) < bounds[1], "q15 does not overflow on a full scale square wave");
+  spectrum_destroy(q15);
+
+  check(init_fails_cleanly(SPECTRUM_BACKEND_FLOAT), "float init returns NULL and leaks nothing when out of memory");
+  check(init_fails_cleanly(SPECTRUM_BACKEND_Q15), "q15 init returns NULL and leaks nothing when out of memory");
+
+  fill_frame(pcm, NFFT, 1);
+  plan_rate = frames_per_s_per_frame_plan(pcm, mag, &plan_calls);
+  for (b = 0 ; b < 2 ; b++)
+  {
+    spectrum_config_t *spectrum = spectrum_init(NFFT, backends[b], SPECTRUM_WINDOW_NONE, SCALE, NULL, NULL, NULL);
+    rates[b] = frames_per_s(spectrum, pcm, &calls[b]);
+    spectrum_destroy(spectrum);
+    snprintf(what, sizeof(what), "%s spectrum_process makes no heap calls", backend_names[b]);
+    check(calls[b] == 0, what);
+  }
+  check(heap_live == 0, "every allocation is freed");
+
+  printf("\n%d point frames, error relative to the peak bin\n", NFFT);
+  printf("%-8s %12s %12s\n", "backend", "no window", "hann");
+  for (b = 0 ; b < 2 ; b++)
+    printf("%-8s %12.2e %12.2e\n", backend_names[b], errors[b][0], errors[b][1]);
+
+  printf("\n%d frames, no window\n", BENCH_FRAMES);
+  printf("%-32s %12s %16s\n", "", "frames/s", "heap calls/frame");
+  printf("%-32s %12.0f %16.1f\n", "before: fft_init per frame", plan_rate, (double)plan_calls / BENCH_FRAMES);
+  for (b = 0 ; b < 2 ; b++)
+    printf("after: spectrum_process, %-7s %12.0f %16.1f\n", backend_names[b], rates[b], (double)calls[b] / BENCH_FRAMES);
+
+  printf(failed ? "%d checks failed\n" : "All checks passed\n", failed);
+  return failed ? 1 : 0;
+}
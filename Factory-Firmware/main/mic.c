@@ -31,6 +31,7 @@
 #include "freertos/semphr.h"
 #include "freertos/queue.h"
 
+#include "esp_log.h"
 #include "driver/i2s.h"
 
 #include "core2forAWS.h"
@@ -101,41 +102,42 @@ void microphoneTask(void* pvParameters) {
     size_t bytesread;
     int16_t* buffptr;
     double data = 0;
-    uint8_t* fft_dis_buff = NULL;
+    uint8_t fft_dis_buff[CANVAS_HEIGHT];
     Microphone_Init();
     QueueHandle_t queue = (QueueHandle_t) pvParameters;
 
+    // Plan, twiddle factors and buffers are built once; per-frame processing is allocation free.
+    // The spectrogram only needs 8-bit color steps, so the fixed-point transform is accurate enough.
+    spectrum_config_t* spectrum = spectrum_init(512, SPECTRUM_BACKEND_Q15, SPECTRUM_WINDOW_NONE, 2000.0f / 65535.0f, NULL, NULL, NULL);
+    if (spectrum == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate the spectrum engine");
+        vTaskDelete(NULL);
+        return;
+    }
+
     for (;;) {
-        fft_dis_buff = (uint8_t*)heap_caps_malloc(CANVAS_HEIGHT * sizeof(uint8_t), MALLOC_CAP_DEFAULT | MALLOC_CAP_SPIRAM);
         memset(fft_dis_buff, 0, CANVAS_HEIGHT);
-        fft_config_t* real_fft_plan = fft_init(512, FFT_REAL, FFT_FORWARD, NULL, NULL);
         i2s_read(I2S_NUM_0, (char*)i2s_readraw_buff, 1024, &bytesread, pdMS_TO_TICKS(100));
         buffptr = (int16_t*)i2s_readraw_buff;
-        for (uint16_t count_n = 0; count_n < real_fft_plan->size; count_n++) {
-            real_fft_plan->input[count_n] = (float)map(buffptr[count_n], INT16_MIN, INT16_MAX, -1000, 1000);
-        }
-        fft_execute(real_fft_plan);
+        spectrum_process(spectrum, buffptr);
 
         for (uint16_t count_n = 1; count_n < CANVAS_HEIGHT; count_n++) {
-            data = sqrt(real_fft_plan->output[2 * count_n] * real_fft_plan->output[2 * count_n] + real_fft_plan->output[2 * count_n + 1] * real_fft_plan->output[2 * count_n + 1]);
+            data = spectrum->magnitude[count_n];
             fft_dis_buff[CANVAS_HEIGHT - count_n]  = map(data, 0, 2000, 0, 256);
         }
-        fft_destroy(real_fft_plan);
-        if(xQueueSend(queue, &fft_dis_buff, 0) != pdPASS) {
-            free(fft_dis_buff);
-        }
+        xQueueSend(queue, fft_dis_buff, 0);
     }
     vTaskDelete(NULL); // Should never get to here...
 }
 
 void fft_show_task(void* pvParameters) {    
-    QueueHandle_t mic_queue = xQueueCreate(2, sizeof(uint8_t*));
+    QueueHandle_t mic_queue = xQueueCreate(2, sizeof(uint8_t) * CANVAS_HEIGHT);
     xTaskCreatePinnedToCore(microphoneTask, "microphoneTask", 4096 * 2, (void*) mic_queue, 1, &mic_handle, 1);
     
     vTaskSuspend(NULL);
     static uint16_t position_data = 0;
     uint16_t color_position;
-    uint8_t* fft_dis_buff = heap_caps_malloc(sizeof (uint8_t) * CANVAS_HEIGHT, MALLOC_CAP_DEFAULT | MALLOC_CAP_SPIRAM);
+    uint8_t fft_dis_buff[CANVAS_HEIGHT] = { 0 };
     
     xSemaphoreTake(xGuiSemaphore, portMAX_DELAY);
     lv_obj_t* canvas = lv_canvas_create((lv_obj_t*)pvParameters, NULL);
@@ -149,7 +151,7 @@ void fft_show_task(void* pvParameters) {
     
     for (;;) {
         if(mic_queue != NULL){
-            xQueueReceive(mic_queue, &fft_dis_buff, 0);
+            xQueueReceive(mic_queue, fft_dis_buff, 0);
             for (uint16_t count_y = 0; count_y < CANVAS_HEIGHT; count_y++) {
                 color_position = fft_dis_buff[count_y];
                 xSemaphoreTake(xGuiSemaphore, portMAX_DELAY);
@@ -31,6 +31,7 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
+#include "freertos/queue.h"
 
 #include "esp_log.h"
 
@@ -134,42 +135,63 @@ void display_mpu_tab(lv_obj_t* tv){
     xTaskCreatePinnedToCore(MPU_task, "MPUTask", 2048, (void*) gauge, 1, &MPU_handle, 1);
 }
 
-void MPU_task(void* pvParameters){
-    float calib_gx = 0.00;
-    float calib_gy = 0.00;
-    float calib_gz = 0.00;
+/* The IMU is streamed at 100 Hz and each batch of 10 samples is averaged for one gauge update. */
+#define MPU_STREAM_HZ       100
+#define MPU_STREAM_BATCH    10
+
+static QueueHandle_t mpu_queue;
+
+static void MPU_stream_cb(const mpu6886_sample_t *samples, uint16_t count, uint32_t dropped, void *arg){
+    mpu6886_sample_t avg = { 0 };
+    if (count == 0) {
+        return;
+    }
 
-    float calib_ax = 0.00;
-    float calib_ay = 0.00;
-    float calib_az = 0.00;
+    for (uint16_t i = 0; i < count; i++) {
+        avg.ax += samples[i].ax;
+        avg.ay += samples[i].ay;
+        avg.az += samples[i].az;
+        avg.gx += samples[i].gx;
+        avg.gy += samples[i].gy;
+        avg.gz += samples[i].gz;
+    }
+    avg.ax /= count;
+    avg.ay /= count;
+    avg.az /= count;
+    avg.gx /= count;
+    avg.gy /= count;
+    avg.gz /= count;
+    avg.timestamp_us = samples[count - 1].timestamp_us;
+
+    xQueueOverwrite(mpu_queue, &avg);
+}
 
-    MPU6886_GetAccelData(&calib_ax, &calib_ay, &calib_az);
-    MPU6886_GetGyroData(&calib_gx, &calib_gy, &calib_gz);
+void MPU_task(void* pvParameters){
+    mpu6886_sample_t calib;
+    mpu6886_sample_t sample;
+
+    mpu_queue = xQueueCreate(1, sizeof(mpu6886_sample_t));
+    MPU6886_StartStream(MPU_STREAM_HZ, MPU_STREAM_BATCH, MPU_stream_cb, NULL);
+    xQueueReceive(mpu_queue, &calib, portMAX_DELAY);
     
     vTaskSuspend(NULL);
 
     for (;;) {
-        float gx, gy, gz;
-        float ax, ay, az;
-        MPU6886_GetAccelData(&ax, &ay, &az);
-        MPU6886_GetGyroData(&gx, &gy, &gz);
-        
+        xQueueReceive(mpu_queue, &sample, portMAX_DELAY);
 
         // float pitch, roll, yaw;
-        // MahonyAHRSupdateIMU(gx * DEGREES_TO_RADIANS, gy * DEGREES_TO_RADIANS, gz * DEGREES_TO_RADIANS, ax, ay, az, &pitch, &roll, &yaw);
-        // ESP_LOGI(TAG, "Pitch: %.6f Roll: %.6f Yaw: %.6f | Raw Accel: X-%.6f Y-%.6f Z-%.6f | Gyro: X-%.6f Y-%.6fZ- %.6f", pitch, yaw, roll, ax, ay, az, gx, gy, gz);
+        // MahonyAHRSupdateIMU(sample.gx * DEGREES_TO_RADIANS, sample.gy * DEGREES_TO_RADIANS, sample.gz * DEGREES_TO_RADIANS, sample.ax, sample.ay, sample.az, &pitch, &roll, &yaw);
+        // ESP_LOGI(TAG, "Pitch: %.6f Roll: %.6f Yaw: %.6f | Raw Accel: X-%.6f Y-%.6f Z-%.6f | Gyro: X-%.6f Y-%.6fZ- %.6f", pitch, yaw, roll, sample.ax, sample.ay, sample.az, sample.gx, sample.gy, sample.gz);
 
-        ESP_LOGI(TAG, "Raw Accel: X-%.6f Y-%.6f Z-%.6f | Gyro: X-%.6f Y-%.6fZ- %.6f", ax, ay, az, gx, gy, gz);
+        ESP_LOGI(TAG, "Raw Accel: X-%.6f Y-%.6f Z-%.6f | Gyro: X-%.6f Y-%.6fZ- %.6f", sample.ax, sample.ay, sample.az, sample.gx, sample.gy, sample.gz);
 
         lv_obj_t* gauges = (lv_obj_t*) pvParameters;
         
         xSemaphoreTake(xGuiSemaphore, portMAX_DELAY);
-        lv_gauge_set_value(gauges, 0, (int) (gx-calib_gx));
-        lv_gauge_set_value(gauges, 1, (int) (gy-calib_gy));
-        lv_gauge_set_value(gauges, 2, (int) (gz-calib_gz));
+        lv_gauge_set_value(gauges, 0, (int) (sample.gx-calib.gx));
+        lv_gauge_set_value(gauges, 1, (int) (sample.gy-calib.gy));
+        lv_gauge_set_value(gauges, 2, (int) (sample.gz-calib.gz));
         xSemaphoreGive(xGuiSemaphore); 
-        
-        vTaskDelay(pdMS_TO_TICKS(100));
     }
     vTaskDelete(NULL); // Should never get to here...
-}
\ No newline at end of file
+}
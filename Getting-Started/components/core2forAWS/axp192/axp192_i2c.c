@@ -1,21 +1,209 @@
 #include "stdint.h"
+#include "stdbool.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "i2c_device.h"
 #include "esp_err.h"
+#include "axp192_i2c.h"
 
 #define AXP192_ADDR (0x34)
 
+/* Registers written in one I2C transaction by Axp192_I2CEndBatch() at most */
+#define AXP192_BATCH_MAX (32)
+
+/* GPIO state registers, the output bits are kept in the shadow but the input bits change */
+#define AXP192_GPIO012_STATE (0x94)
+#define AXP192_GPIO34_STATE  (0x96)
+
 static I2CDevice_t axp192_device;
+static SemaphoreHandle_t axp192_mutex;
+
+/* Write-through copy of the control registers, so bit updates need no read */
+static uint8_t shadow[256];
+static uint8_t shadow_valid[256 / 8];
+
+static uint8_t batch_regs[AXP192_BATCH_MAX];
+static uint8_t batch_count;
+static uint8_t batch_depth;
+
+static uint32_t read_count;
+static uint32_t write_count;
+
+/* Control registers only the host changes. Status, IRQ and ADC registers are read from the chip. */
+static bool Axp192_IsShadowed(uint8_t reg_addr) {
+    return (reg_addr >= 0x10 && reg_addr <= 0x3F) ||
+           (reg_addr >= 0x80 && reg_addr <= 0x89) ||
+           (reg_addr >= 0x90 && reg_addr <= 0x97);
+}
+
+static bool Axp192_ShadowValid(uint8_t reg_addr) {
+    return shadow_valid[reg_addr / 8] & (1 << (reg_addr % 8));
+}
+
+static void Axp192_ShadowSet(uint8_t reg_addr, uint8_t value) {
+    shadow[reg_addr] = value;
+    if (Axp192_IsShadowed(reg_addr)) {
+        shadow_valid[reg_addr / 8] |= 1 << (reg_addr % 8);
+    }
+}
+
+static void Axp192_ShadowInvalidate(uint8_t reg_addr) {
+    shadow_valid[reg_addr / 8] &= ~(1 << (reg_addr % 8));
+}
+
+static bool Axp192_InBatch(uint8_t reg_addr) {
+    for (uint8_t i = 0; i < batch_count; i++) {
+        if (batch_regs[i] == reg_addr) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool Axp192_BusWrite(uint8_t reg_addr, uint8_t *data, uint16_t length) {
+    write_count++;
+    return i2c_write_bytes(axp192_device, reg_addr, data, length) == ESP_OK;
+}
+
+static bool Axp192_BusRead(uint8_t reg_addr, uint8_t *data, uint16_t length) {
+    read_count++;
+    return i2c_read_bytes(axp192_device, reg_addr, data, length) == ESP_OK;
+}
+
+/*
+    The AXP192 takes several registers in one write as address and data pairs:
+    reg_0, data_0, reg_1, data_1, ...
+    so the batch does not need to be contiguous.
+*/
+static void Axp192_FlushBatch() {
+    uint8_t buf[AXP192_BATCH_MAX * 2 - 1];
+    uint16_t length = 0;
+
+    if (batch_count == 0) {
+        return;
+    }
+
+    for (uint8_t i = 0; i < batch_count; i++) {
+        if (i > 0) {
+            buf[length++] = batch_regs[i];
+        }
+        buf[length++] = shadow[batch_regs[i]];
+    }
+
+    if (Axp192_BusWrite(batch_regs[0], buf, length) == false) {
+        for (uint8_t i = 0; i < batch_count; i++) {
+            Axp192_ShadowInvalidate(batch_regs[i]);
+        }
+    }
+    batch_count = 0;
+}
+
+static bool Axp192_Store(uint8_t reg_addr, uint8_t value) {
+    if (Axp192_InBatch(reg_addr)) {
+        shadow[reg_addr] = value;
+        return true;
+    }
+    if (Axp192_ShadowValid(reg_addr) && shadow[reg_addr] == value) {
+        return true;
+    }
+
+    if (batch_depth > 0) {
+        if (batch_count == AXP192_BATCH_MAX) {
+            Axp192_FlushBatch();
+        }
+        Axp192_ShadowSet(reg_addr, value);
+        batch_regs[batch_count++] = reg_addr;
+        return true;
+    }
+
+    if (Axp192_BusWrite(reg_addr, &value, 1) == false) {
+        Axp192_ShadowInvalidate(reg_addr);
+        return false;
+    }
+    Axp192_ShadowSet(reg_addr, value);
+    return true;
+}
+
+static bool Axp192_Load(uint8_t reg_addr, uint8_t *value) {
+    if (Axp192_ShadowValid(reg_addr) || Axp192_InBatch(reg_addr)) {
+        *value = shadow[reg_addr];
+        return true;
+    }
+    if (Axp192_BusRead(reg_addr, value, 1) == false) {
+        return false;
+    }
+    Axp192_ShadowSet(reg_addr, *value);
+    return true;
+}
+
+/* Fills the shadow of a register range with one read */
+static void Axp192_ShadowFetch(uint8_t first_reg, uint8_t last_reg) {
+    uint8_t buf[64];
+    uint16_t length = last_reg - first_reg + 1;
+
+    if (Axp192_BusRead(first_reg, buf, length)) {
+        for (uint16_t i = 0; i < length; i++) {
+            Axp192_ShadowSet(first_reg + i, buf[i]);
+        }
+    }
+}
 
 void Axp192_I2CInit() {
     axp192_device = i2c_malloc_device(I2C_NUM_1, 21, 22, 400000, AXP192_ADDR);
+    if (axp192_mutex == NULL) {
+        axp192_mutex = xSemaphoreCreateRecursiveMutex();
+    }
+
+    xSemaphoreTakeRecursive(axp192_mutex, portMAX_DELAY);
+    Axp192_ShadowFetch(0x10, 0x3F);
+    Axp192_ShadowFetch(0x90, 0x97);
+    xSemaphoreGiveRecursive(axp192_mutex);
+}
+
+void Axp192_I2CBeginBatch() {
+    xSemaphoreTakeRecursive(axp192_mutex, portMAX_DELAY);
+    batch_depth++;
+}
+
+void Axp192_I2CEndBatch() {
+    if (batch_depth > 0 && --batch_depth == 0) {
+        Axp192_FlushBatch();
+    }
+    xSemaphoreGiveRecursive(axp192_mutex);
+}
+
+void Axp192_I2CGetStats(uint32_t *reads, uint32_t *writes) {
+    xSemaphoreTakeRecursive(axp192_mutex, portMAX_DELAY);
+    *reads = read_count;
+    *writes = write_count;
+    xSemaphoreGiveRecursive(axp192_mutex);
 }
 
 bool Axp192_WriteBytes(uint8_t reg_addr, uint8_t *data, uint16_t length) {
-    return i2c_write_bytes(axp192_device, reg_addr, data, length) == ESP_OK;
+    bool ok = true;
+    Axp192_I2CBeginBatch();
+    for (uint16_t i = 0; i < length; i++) {
+        ok &= Axp192_Store(reg_addr + i, data[i]);
+    }
+    Axp192_I2CEndBatch();
+    return ok;
 }
 
+/* Status, ADC and GPIO input registers change on their own, so reads go to the chip */
 bool Axp192_ReadBytes(uint8_t reg_addr, uint8_t *data, uint16_t length) {
-    return i2c_read_bytes(axp192_device, reg_addr, data, length) == ESP_OK;
+    bool ok;
+    xSemaphoreTakeRecursive(axp192_mutex, portMAX_DELAY);
+    ok = Axp192_BusRead(reg_addr, data, length);
+    if (ok) {
+        for (uint16_t i = 0; i < length; i++) {
+            uint8_t reg = reg_addr + i;
+            if (Axp192_IsShadowed(reg) && !Axp192_InBatch(reg)) {
+                Axp192_ShadowSet(reg, data[i]);
+            }
+        }
+    }
+    xSemaphoreGiveRecursive(axp192_mutex);
+    return ok;
 }
 
 void Axp192_Write8Bit(uint8_t reg_addr, uint8_t value) {
@@ -27,21 +215,25 @@ void Axp192_WriteBits(uint8_t reg_addr, uint8_t data, uint8_t bit_pos, uint8_t b
         return ;
     }
 
+    xSemaphoreTakeRecursive(axp192_mutex, portMAX_DELAY);
     uint8_t value = 0x00;
-    if (Axp192_ReadBytes(reg_addr, &value, 1) == false) {
-        return ;
-    }
+    if (Axp192_Load(reg_addr, &value)) {
+        value &= ~(((1 << bit_length) - 1) << bit_pos);
+        data &= (1 << bit_length) - 1;
+        value |= data << bit_pos;
 
-    value &= ~(((1 << bit_length) - 1) << bit_pos);
-    data &= (1 << bit_length) - 1;
-    value |= data << bit_pos;
-
-    Axp192_WriteBytes(reg_addr, &value, 1);
+        Axp192_Store(reg_addr, value);
+    }
+    xSemaphoreGiveRecursive(axp192_mutex);
 }
 
 uint8_t Axp192_Read8Bit(uint8_t reg_addr) {
     uint8_t value = 0x00;
-    Axp192_ReadBytes(reg_addr, &value, 1);
+    xSemaphoreTakeRecursive(axp192_mutex, portMAX_DELAY);
+    if (reg_addr == AXP192_GPIO012_STATE || reg_addr == AXP192_GPIO34_STATE || !Axp192_Load(reg_addr, &value)) {
+        Axp192_ReadBytes(reg_addr, &value, 1);
+    }
+    xSemaphoreGiveRecursive(axp192_mutex);
     return value;
 }
 
@@ -1,9 +1,12 @@
 #include "stdio.h"
 #include "stdbool.h"
+#include "string.h"
 #include "driver/gpio.h"
 
 #include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "freertos/semphr.h"
+#include "esp_timer.h"
 
 #include "ft6336u.h"
 #include "i2c_device.h"
@@ -11,58 +14,183 @@
 #define FT6336U_I2C_ADDR 0x38
 #define FT6336U_INTR_PIN 39
 
+#define FT6336U_TD_STATUS_REG   0x02
+#define FT6336U_G_MODE_REG      0xa4
+/* INT pulses once per new report, so moves are reported without polling */
+#define FT6336U_G_MODE_TRIGGER  0x01
+
+/* TD_STATUS, then 6 bytes for each of the two touch points */
+#define FT6336U_POINT_SIZE      6
+#define FT6336U_READ_SIZE       (1 + FT6336U_MAX_POINTS * FT6336U_POINT_SIZE)
+
+/* Reads again if no report comes while pressed, so a missed lift does not leave the screen pressed */
+#define FT6336U_PRESSED_TIMEOUT_MS 100
+
+typedef struct {
+    bool down;
+    uint16_t x;
+    uint16_t y;
+} ft6336u_point_t;
+
 static uint16_t _x, _y;
 static bool _pressed;
 static I2CDevice_t ft6336u_i2c;
 static xTaskHandle ft6336_task_handle;
 static SemaphoreHandle_t thread_mutex;
 
+static volatile int64_t irq_time_us;
+static ft6336u_point_t points[FT6336U_MAX_POINTS];
+static int8_t primary_id = -1;
+
+static FT6336U_EventQueue_t event_queues[FT6336U_MAX_SUBSCRIBERS];
+static uint8_t event_queue_count;
+static portMUX_TYPE subscribe_lock = portMUX_INITIALIZER_UNLOCKED;
+
 static void IRAM_ATTR FT6336U_ISRHandler(void* arg);
 static void FT6336U_UpdateTask(void *arg);
 
 void FT6336U_Init() {
     ft6336u_i2c = i2c_malloc_device(I2C_NUM_1, 21, 22, 400000, FT6336U_I2C_ADDR);
-    i2c_write_byte(ft6336u_i2c, 0xa4, 0x00);
-    
+    // Touch reads go ahead of the PMU, IMU and RTC transfers
+    i2c_device_set_priority(ft6336u_i2c, I2C_DEVICE_PRIORITY_HIGH);
+    i2c_write_byte(ft6336u_i2c, FT6336U_G_MODE_REG, FT6336U_G_MODE_TRIGGER);
+
     thread_mutex = xSemaphoreCreateMutex();
 
     gpio_config_t io_conf;
-    io_conf.intr_type = GPIO_INTR_ANYEDGE;
+    io_conf.intr_type = GPIO_INTR_NEGEDGE;
     io_conf.pin_bit_mask = (1ULL << FT6336U_INTR_PIN);
     io_conf.mode = GPIO_MODE_INPUT;
     io_conf.pull_up_en = 1;
+    io_conf.pull_down_en = 0;
     gpio_config(&io_conf);
-    xTaskCreatePinnedToCore(FT6336U_UpdateTask, "FT6336Task", 2 * 1024, NULL, 1, &ft6336_task_handle, 0);
+    xTaskCreatePinnedToCore(FT6336U_UpdateTask, "FT6336Task", 2 * 1024, NULL, 3, &ft6336_task_handle, 0);
     gpio_install_isr_service(0);
-    gpio_isr_handler_add(FT6336U_INTR_PIN, FT6336U_ISRHandler, &ft6336_task_handle);
+    gpio_isr_handler_add(FT6336U_INTR_PIN, FT6336U_ISRHandler, NULL);
 }
 
 static void IRAM_ATTR FT6336U_ISRHandler(void* arg) {
-    xTaskHandle task_handle = *(xTaskHandle *)arg;
-    xTaskResumeFromISR(task_handle);
+    BaseType_t woken = pdFALSE;
+    irq_time_us = esp_timer_get_time();
+    vTaskNotifyGiveFromISR(ft6336_task_handle, &woken);
+    if (woken == pdTRUE) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+/* Single producer: only the touch task writes head, only the subscriber writes tail */
+static void FT6336U_PushEvent(const FT6336U_Event_t *event) {
+    uint8_t count = __atomic_load_n(&event_queue_count, __ATOMIC_ACQUIRE);
+    for (uint8_t i = 0; i < count; i++) {
+        FT6336U_EventQueue_t *queue = &event_queues[i];
+        uint32_t head = queue->head;
+        if (head - __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE) >= FT6336U_EVENT_QUEUE_LEN) {
+            __atomic_store_n(&queue->dropped, queue->dropped + 1, __ATOMIC_RELEASE);
+            continue;
+        }
+        queue->events[head % FT6336U_EVENT_QUEUE_LEN] = *event;
+        __atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);
+        if (queue->notify != NULL) {
+            xTaskNotifyGive(queue->notify);
+        }
+    }
+}
+
+static void FT6336U_Emit(FT6336U_EventType_t type, uint8_t id, const ft6336u_point_t *point, int64_t timestamp_us) {
+    FT6336U_Event_t event = {
+        .type = type,
+        .id = id,
+        .primary = id == primary_id,
+        .x = point->x,
+        .y = point->y,
+        .timestamp_us = timestamp_us,
+    };
+    FT6336U_PushEvent(&event);
+}
+
+/* Turns a report of both touch points into down, move and up events */
+static void FT6336U_Process(const uint8_t *buff, int64_t timestamp_us) {
+    ft6336u_point_t now[FT6336U_MAX_POINTS] = { 0 };
+    uint8_t count = buff[0] & 0x0f;
+    if (count > FT6336U_MAX_POINTS) {
+        count = 0;
+    }
+
+    for (uint8_t i = 0; i < count; i++) {
+        const uint8_t *point = &buff[1 + i * FT6336U_POINT_SIZE];
+        uint8_t id = point[2] >> 4;
+        if (id >= FT6336U_MAX_POINTS) {
+            continue;
+        }
+        now[id].down = true;
+        now[id].x = ((point[0] & 0x0f) << 8) | point[1];
+        now[id].y = ((point[2] & 0x0f) << 8) | point[3];
+    }
+
+    for (uint8_t id = 0; id < FT6336U_MAX_POINTS; id++) {
+        if (now[id].down && !points[id].down) {
+            if (primary_id < 0) {
+                primary_id = id;
+            }
+            FT6336U_Emit(FT6336U_EVENT_DOWN, id, &now[id], timestamp_us);
+        } else if (now[id].down && (now[id].x != points[id].x || now[id].y != points[id].y)) {
+            FT6336U_Emit(FT6336U_EVENT_MOVE, id, &now[id], timestamp_us);
+        } else if (!now[id].down && points[id].down) {
+            FT6336U_Emit(FT6336U_EVENT_UP, id, &points[id], timestamp_us);
+            if (primary_id == id) {
+                primary_id = -1;
+            }
+        }
+        points[id] = now[id];
+    }
+
+    xSemaphoreTake(thread_mutex, portMAX_DELAY);
+    if (primary_id >= 0) {
+        _pressed = true;
+        _x = points[primary_id].x;
+        _y = points[primary_id].y;
+    } else {
+        _pressed = false;
+    }
+    xSemaphoreGive(thread_mutex);
 }
 
 static void FT6336U_UpdateTask(void *arg) {
-    uint8_t buff[5] = {0x00, 0x00, 0x00, 0x00, 0x00};
-    bool press_stash;
+    uint8_t buff[FT6336U_READ_SIZE];
     for (;;) {
-        i2c_read_bytes(ft6336u_i2c, 0x02, buff, 5);
-        
-        xSemaphoreTake(thread_mutex, portMAX_DELAY);
-        _pressed = buff[0] ? true : false;
-        _x = ((buff[1] & 0x0f) << 8) | buff[2];
-        _y = ((buff[3] & 0x0f) << 8) | buff[4];
-        press_stash = _pressed;
-        xSemaphoreGive(thread_mutex);
-
-        if (press_stash == false) {
-            vTaskSuspend(NULL);
-        } else {
-            vTaskDelay(pdMS_TO_TICKS(20));
+        TickType_t wait = primary_id >= 0 ? pdMS_TO_TICKS(FT6336U_PRESSED_TIMEOUT_MS) : portMAX_DELAY;
+        int64_t timestamp_us = ulTaskNotifyTake(pdTRUE, wait) ? irq_time_us : esp_timer_get_time();
+
+        if (i2c_read_bytes(ft6336u_i2c, FT6336U_TD_STATUS_REG, buff, sizeof(buff)) == ESP_OK) {
+            FT6336U_Process(buff, timestamp_us);
         }
     }
 }
 
+FT6336U_EventQueue_t *FT6336U_Subscribe(TaskHandle_t notify) {
+    FT6336U_EventQueue_t *queue = NULL;
+
+    portENTER_CRITICAL(&subscribe_lock);
+    if (event_queue_count < FT6336U_MAX_SUBSCRIBERS) {
+        queue = &event_queues[event_queue_count];
+        memset(queue, 0, sizeof(*queue));
+        queue->notify = notify;
+        __atomic_store_n(&event_queue_count, event_queue_count + 1, __ATOMIC_RELEASE);
+    }
+    portEXIT_CRITICAL(&subscribe_lock);
+    return queue;
+}
+
+bool FT6336U_GetEvent(FT6336U_EventQueue_t *queue, FT6336U_Event_t *event) {
+    uint32_t tail = queue->tail;
+    if (tail == __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+    *event = queue->events[tail % FT6336U_EVENT_QUEUE_LEN];
+    __atomic_store_n(&queue->tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
 void FT6336U_GetTouch(uint16_t* x, uint16_t* y, bool* press_down) {
     xSemaphoreTake(thread_mutex, portMAX_DELAY);
     *x = _x;
@@ -2,18 +2,64 @@
  * @file disp_driver.c
  */
 
+#include <string.h>
+
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <freertos/semphr.h>
 
+#include "esp_attr.h"
+#include "esp_timer.h"
+
 #include "disp_driver.h"
 #include "disp_spi.h"
 
+static disp_driver_stats_t stats;
+static int64_t flush_start_us;
+static portMUX_TYPE stats_mux = portMUX_INITIALIZER_UNLOCKED;
+
 void disp_driver_init(void) {
     ili9341_init();
 }
 
 void disp_driver_flush(lv_disp_drv_t * drv, const lv_area_t * area, lv_color_t * color_map) {
+    int64_t start = esp_timer_get_time();
+
+    portENTER_CRITICAL(&stats_mux);
+    flush_start_us = start;
+    portEXIT_CRITICAL(&stats_mux);
+
     ili9341_flush(drv, area, color_map);
+
+    portENTER_CRITICAL(&stats_mux);
+    stats.flushes++;
+    stats.pixels += lv_area_get_width(area) * lv_area_get_height(area);
+    stats.flush_cb_us += esp_timer_get_time() - start;
+    portEXIT_CRITICAL(&stats_mux);
 }
 
+void IRAM_ATTR disp_driver_flush_ready(lv_disp_drv_t * drv) {
+    uint32_t latency;
+
+    portENTER_CRITICAL_ISR(&stats_mux);
+    latency = esp_timer_get_time() - flush_start_us;
+    stats.flush_latency_us += latency;
+    if (latency > stats.max_latency_us) {
+        stats.max_latency_us = latency;
+    }
+    portEXIT_CRITICAL_ISR(&stats_mux);
+
+    lv_disp_flush_ready(drv);
+}
+
+void disp_driver_get_stats(disp_driver_stats_t * out) {
+    portENTER_CRITICAL(&stats_mux);
+    memcpy(out, &stats, sizeof(stats));
+    portEXIT_CRITICAL(&stats_mux);
+}
+
+void disp_driver_reset_stats(void) {
+    portENTER_CRITICAL(&stats_mux);
+    memset(&stats, 0, sizeof(stats));
+    portEXIT_CRITICAL(&stats_mux);
+}
@@ -29,8 +29,13 @@ typedef enum _disp_spi_send_flag_t {
     DISP_SPI_MODE_DIO           = 0x00000400, /* Reserved */
     DISP_SPI_MODE_QIO           = 0x00000800, /* Reserved */
     DISP_SPI_MODE_DIOQIO_ADDR   = 0x00001000, /* Reserved */
+    DISP_SPI_DC_COMMAND         = 0x00002000, /* D/C low when the transaction starts */
+    DISP_SPI_DC_DATA            = 0x00004000, /* D/C high when the transaction starts */
 } disp_spi_send_flag_t;
 
+/* Transactions the display device can have queued, enough for a whole flush batch */
+#define DISP_SPI_QUEUE_SIZE 8
+
 typedef struct _disp_spi_read_data {
     uint8_t _dummy_byte;
     union {
@@ -56,6 +61,20 @@ void disp_spi_transaction(const uint8_t *data, size_t length,
     disp_spi_send_flag_t flags, disp_spi_read_data *out, uint64_t addr);
 void disp_wait_for_pending_transactions(void);
 
+/**
+ * @brief Queues prepared transactions back to back, without waiting for any of them.
+ *
+ * The flags of each transaction are in its `user` field. Use DISP_SPI_DC_COMMAND and
+ * DISP_SPI_DC_DATA to switch the D/C line as each one starts. The last transaction must
+ * have DISP_SPI_SIGNAL_FLUSH, its completion releases the bus and the spi_mutex.
+ * The transactions are owned by the SPI driver until disp_wait_for_pending_transactions
+ * returns.
+ *
+ * @param trans Transactions to queue, at most DISP_SPI_QUEUE_SIZE.
+ * @param count Number of transactions.
+ */
+void disp_spi_queue_batch(spi_transaction_t *trans, size_t count);
+
 static inline void disp_spi_send_data(uint8_t *data, size_t length) {
     disp_spi_transaction(data, length, DISP_SPI_SEND_POLLING, NULL, 0);
 }
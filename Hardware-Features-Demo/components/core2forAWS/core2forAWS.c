@@ -9,6 +9,7 @@
 #include "esp_system.h"
 #include "esp_err.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 
 #include "core2forAWS.h"
 
@@ -38,7 +39,7 @@ void Core2ForAWS_Init(void) {
         .sclk_io_num = 18,
         .quadwp_io_num = -1,
         .quadhd_io_num = -1,
-        .max_transfer_sz = 320 * 32 * 3,
+        .max_transfer_sz = LV_HOR_RES_MAX * DISP_BUF_MAX_LINES * 3,
     };
     spi_bus_initialize(SPI_HOST_USE, &bus_cfg, SPI_DMA_CHAN);
 #endif
@@ -143,8 +144,10 @@ void Core2ForAWS_Motor_SetStrength(uint8_t strength) {
 
     if (strength > 0){
         uint16_t volt = (uint32_t)strength * (AXP192_LDO_VOLT_MAX - AXP192_LDO_VOLT_MIN) / 100 + AXP192_LDO_VOLT_MIN;
+        Axp192_BeginUpdate();
         Axp192_SetLDO3Volt(volt);
         Axp192_EnableLDO3(1);
+        Axp192_EndUpdate();
     } else {
         Axp192_EnableLDO3(0);
     }
@@ -183,8 +186,13 @@ void Core2ForAWS_PMU_Init(uint16_t ldo2_volt, uint16_t ldo3_volt, uint16_t dc2_v
     value |= (dc3_volt > 0) << AXP192_DC3_EN_BIT;
     value |= 0x01 << AXP192_DC1_EN_BIT;
 
+    int64_t start_us = esp_timer_get_time();
+    uint32_t reads, writes;
+
     Axp192_Init();
 
+    /* Every register below is changed in the driver's copy and written to the AXP192 in one transaction */
+    Axp192_BeginUpdate();
     // value |= 0x01 << AXP192_EXT_EN_BIT;
     Axp192_SetLDO23Volt(ldo2_volt, ldo3_volt);
     // Axp192_SetDCDC1Volt(3300);
@@ -205,6 +213,10 @@ void Core2ForAWS_PMU_Init(uint16_t ldo2_volt, uint16_t ldo3_volt, uint16_t dc2_v
     Axp192_SetAdc1Enable(0xfe);
     Axp192_SetGPIO1Mode(1);
     Core2ForAWS_PMU_SetPowerIn(0);
+    Axp192_EndUpdate();
+
+    Axp192_GetI2CStats(&reads, &writes);
+    ESP_LOGD(TAG, "PMU initialized in %lldus, %u I2C reads, %u I2C writes", esp_timer_get_time() - start_us, (unsigned)reads, (unsigned)writes);
 }
 /* ----------------------------------------------- End -----------------------------------------------*/
 /* ===================================================================================================*/
@@ -256,6 +268,14 @@ void Core2ForAWS_Sk6812_Show(void) {
 void Core2ForAWS_Sk6812_Clear(void) {
     np_clear(&px);
 }
+
+esp_err_t Core2ForAWS_Sk6812_StartAnimation(uint16_t fps, np_frame_cb_t frame_cb, void *arg) {
+    return np_animation_start(&px, RMT_CHANNEL_0, fps, frame_cb, arg);
+}
+
+void Core2ForAWS_Sk6812_StopAnimation(void) {
+    np_animation_stop();
+}
 #endif
 /* ----------------------------------------------- End -----------------------------------------------*/
 /* ===================================================================================================*/
@@ -263,17 +283,29 @@ void Core2ForAWS_Sk6812_Clear(void) {
 /* ===================================================================================================*/
 /* --------------------------------------------- DISPLAY ---------------------------------------------*/
 #if CONFIG_SOFTWARE_ILI9342C_SUPPORT
+#include "lvgl/src/lv_gpu/lv_gpu_esp32.h"
 
 #define DISPLAY_BRIGHTNESS_MIN_VOLT 2200
 #define DISPLAY_BRIGHTNESS_MAX_VOLT 3300
 #define LV_TICK_PERIOD_MS 1
+#define DISPLAY_BUF_MIN_LINES 8
 
 SemaphoreHandle_t xGuiSemaphore;
 
+static lv_disp_buf_t disp_buf;
+static display_buf_mem_t disp_buf_mem;
+static uint16_t disp_buf_lines;
+
 static void guiTask(void *pvParameter);
 static void lv_tick_task(void *arg);
+static esp_err_t display_buf_set(display_buf_mem_t mem, uint16_t lines);
 
 #if CONFIG_SOFTWARE_FT6336U_SUPPORT
+static lv_indev_t *touch_indev;
+static FT6336U_EventQueue_t *touch_events;
+static uint32_t touch_dropped;
+static lv_indev_data_t touch_data;
+
 static bool ft6336u_read(lv_indev_drv_t * drv, lv_indev_data_t * data);
 #endif
 
@@ -287,22 +319,22 @@ void Core2ForAWS_Display_Init(void) {
     disp_driver_init();
 
     /* Use double buffered when not working with monochrome displays. 
-	 * Application should allocate two buffers buf1 and buf2 of size
-	 * (DISP_BUF_SIZE * sizeof(lv_color_t)) each
+	 * Two stripes of DISP_BUF_LINES lines, so LVGL renders into one
+	 * while the other is sent.
 	 */
-
-    static lv_disp_buf_t disp_buf;
-
-    uint32_t size_in_px = DISP_BUF_SIZE;
-    lv_color_t *buf1 = heap_caps_malloc(DISP_BUF_SIZE * sizeof(lv_color_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT); //Assuming max size of lv_color_t = 16bit, DISP_BUF_SIZE calculated from max horizontal display size 480
-    lv_color_t *buf2 = heap_caps_malloc(DISP_BUF_SIZE * sizeof(lv_color_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT); //Assuming max size of lv_color_t = 16bit, DISP_BUF_SIZE calculated from max horizontal display size 480
-    
-    /* Initialize the working buffer depending on the selected display */
-    lv_disp_buf_init(&disp_buf, buf1, buf2, size_in_px);
+#if CONFIG_DISP_BUF_MEM_SPIRAM
+    ESP_ERROR_CHECK(display_buf_set(DISPLAY_BUF_SPIRAM, DISP_BUF_LINES));
+#else
+    ESP_ERROR_CHECK(display_buf_set(DISPLAY_BUF_INTERNAL, DISP_BUF_LINES));
+#endif
 
     lv_disp_drv_t disp_drv;
     lv_disp_drv_init(&disp_drv);
     disp_drv.flush_cb = disp_driver_flush;
+#if LV_USE_GPU_ESP32
+    disp_drv.gpu_fill_cb = lv_gpu_esp32_fill_cb;
+    disp_drv.gpu_blend_cb = lv_gpu_esp32_blend_cb;
+#endif
 
     disp_drv.buffer = &disp_buf;
     lv_disp_drv_register(&disp_drv);
@@ -313,7 +345,7 @@ void Core2ForAWS_Display_Init(void) {
     lv_indev_drv_init(&indev_drv);
     indev_drv.read_cb = ft6336u_read;
     indev_drv.type = LV_INDEV_TYPE_POINTER;
-    lv_indev_drv_register(&indev_drv);
+    touch_indev = lv_indev_drv_register(&indev_drv);
 #endif
 
     /* Create and start a periodic timer interrupt to call lv_tick_inc */
@@ -330,6 +362,25 @@ void Core2ForAWS_Display_Init(void) {
     xTaskCreatePinnedToCore(guiTask, "gui", 4096*2, NULL, 2, NULL, 1);
 }
 
+esp_err_t Core2ForAWS_Display_SetBuffers(display_buf_mem_t mem, uint16_t lines) {
+    xSemaphoreTake(xGuiSemaphore, portMAX_DELAY);
+    /* The stripe on its way to the display must not be freed */
+    while (disp_buf.flushing) {
+        taskYIELD();
+    }
+    esp_err_t err = display_buf_set(mem, lines);
+    if (err == ESP_OK) {
+        lv_obj_invalidate(lv_scr_act());
+    }
+    xSemaphoreGive(xGuiSemaphore);
+    return err;
+}
+
+void Core2ForAWS_Display_GetBuffers(display_buf_mem_t *mem, uint16_t *lines) {
+    *mem = disp_buf_mem;
+    *lines = disp_buf_lines;
+}
+
 void Core2ForAWS_Display_SetBrightness(uint8_t brightness) {
     if (brightness > 100) {
         brightness = 100;
@@ -344,18 +395,92 @@ void Core2ForAWS_LED_Enable(uint8_t enable) {
 }
 
 #if CONFIG_SOFTWARE_FT6336U_SUPPORT
+/* Hands LVGL one queued touch event per call, so a tap shorter than the read period is not missed */
 static bool ft6336u_read(lv_indev_drv_t * drv, lv_indev_data_t * data) {
-    bool valid = true;
-    uint16_t x = 0;
-    uint16_t y = 0;
-    FT6336U_GetTouch(&x, &y, &valid);
-    data->point.x = x;
-    data->point.y = y;
-    data->state = valid == false ? LV_INDEV_STATE_REL : LV_INDEV_STATE_PR;
+    FT6336U_Event_t event;
+
+    while (touch_events != NULL && FT6336U_GetEvent(touch_events, &event)) {
+        if (!event.primary) {
+            continue;
+        }
+        touch_data.point.x = event.x;
+        touch_data.point.y = event.y;
+        touch_data.state = event.type == FT6336U_EVENT_UP ? LV_INDEV_STATE_REL : LV_INDEV_STATE_PR;
+        *data = touch_data;
+        return true;
+    }
+
+    if (touch_events == NULL || touch_events->dropped != touch_dropped) {
+        bool valid = false;
+        uint16_t x = 0;
+        uint16_t y = 0;
+        FT6336U_GetTouch(&x, &y, &valid);
+        touch_data.point.x = x;
+        touch_data.point.y = y;
+        touch_data.state = valid == false ? LV_INDEV_STATE_REL : LV_INDEV_STATE_PR;
+        touch_dropped = touch_events != NULL ? touch_events->dropped : 0;
+    }
+    *data = touch_data;
     return false;
 }
 #endif
 
+/* Allocates both stripes or neither */
+static bool display_buf_alloc(display_buf_mem_t mem, uint16_t lines, lv_color_t **buf1, lv_color_t **buf2) {
+    size_t size = LV_HOR_RES_MAX * lines * sizeof(lv_color_t);
+    uint32_t caps = mem == DISPLAY_BUF_INTERNAL ? MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL : MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT;
+
+    *buf1 = heap_caps_malloc(size, caps);
+    *buf2 = heap_caps_malloc(size, caps);
+    if (*buf1 == NULL || *buf2 == NULL) {
+        heap_caps_free(*buf1);
+        heap_caps_free(*buf2);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Allocates the stripes LVGL renders into and frees the previous ones.
+ *
+ * Internal RAM is tried with fewer lines down to DISPLAY_BUF_MIN_LINES
+ * before falling back to SPIRAM. The caller holds xGuiSemaphore and no
+ * flush is in progress.
+ */
+static esp_err_t display_buf_set(display_buf_mem_t mem, uint16_t lines) {
+    lv_color_t *buf1, *buf2;
+    display_buf_mem_t used_mem = mem;
+
+    lines = lines < DISPLAY_BUF_MIN_LINES ? DISPLAY_BUF_MIN_LINES : lines;
+    lines = lines > DISP_BUF_MAX_LINES ? DISP_BUF_MAX_LINES : lines;
+    lines = lines > LV_VER_RES_MAX ? LV_VER_RES_MAX : lines;
+    uint16_t used_lines = lines;
+
+    while (!display_buf_alloc(used_mem, used_lines, &buf1, &buf2)) {
+        if (used_mem == DISPLAY_BUF_INTERNAL && used_lines / 2 >= DISPLAY_BUF_MIN_LINES) {
+            used_lines /= 2;
+        } else if (used_mem == DISPLAY_BUF_INTERNAL) {
+            used_mem = DISPLAY_BUF_SPIRAM;
+            used_lines = lines;
+        } else {
+            ESP_LOGE(TAG, "No memory for the display buffers of %u lines", lines);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    if (used_mem != mem || used_lines != lines) {
+        ESP_LOGW(TAG, "Display buffers of %u lines do not fit in %s RAM, using %u lines in %s RAM", lines,
+                 mem == DISPLAY_BUF_INTERNAL ? "internal" : "SPI", used_lines, used_mem == DISPLAY_BUF_INTERNAL ? "internal" : "SPI");
+    }
+
+    heap_caps_free(disp_buf.buf1);
+    heap_caps_free(disp_buf.buf2);
+    lv_disp_buf_init(&disp_buf, buf1, buf2, LV_HOR_RES_MAX * used_lines);
+    disp_buf_mem = used_mem;
+    disp_buf_lines = used_lines;
+
+    return ESP_OK;
+}
+
 static void lv_tick_task(void *arg) {
     (void) arg;
     lv_tick_inc(LV_TICK_PERIOD_MS);
@@ -373,13 +498,24 @@ static void guiTask(void *pvParameter) {
     
     (void) pvParameter;
 
+#if CONFIG_SOFTWARE_FT6336U_SUPPORT
+    /* Touch events wake this task, so LVGL reads them right away instead of at its next read period */
+    touch_events = FT6336U_Subscribe(xTaskGetCurrentTaskHandle());
+#endif
 
     while (1) {
-        /* Delay 1 tick (assumes FreeRTOS tick is 10ms */
-        vTaskDelay(pdMS_TO_TICKS(10));
+        /* Delay 1 tick (assumes FreeRTOS tick is 10ms), or less when the screen is touched */
+        bool touched = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(10)) > 0;
 
         /* Try to take the semaphore, call lvgl related function on success */
         if (pdTRUE == xSemaphoreTake(xGuiSemaphore, portMAX_DELAY)) {
+#if CONFIG_SOFTWARE_FT6336U_SUPPORT
+            if (touched && touch_indev != NULL) {
+                lv_task_ready(touch_indev->driver.read_task);
+            }
+#else
+            (void) touched;
+#endif
             lv_task_handler();
             xSemaphoreGive(xGuiSemaphore);
        }
@@ -434,6 +434,59 @@ void Core2ForAWS_Display_Init(void);
 /* @[declare_core2foraws_display_setbrightness] */
 void Core2ForAWS_Display_SetBrightness(uint8_t brightness);
 /* @[declare_core2foraws_display_setbrightness] */
+
+/**
+ * @brief Memory the LVGL draw buffers are allocated in.
+ */
+/* @[declare_core2foraws_display_buf_mem_t] */
+typedef enum {
+    DISPLAY_BUF_INTERNAL = 0,   /**< @brief Internal DMA-capable RAM, fastest to render into and send. */
+    DISPLAY_BUF_SPIRAM          /**< @brief SPIRAM, leaves internal RAM to the application. */
+} display_buf_mem_t;
+/* @[declare_core2foraws_display_buf_mem_t] */
+
+/**
+ * @brief Reallocates the two stripes LVGL renders into.
+ *
+ * Core2ForAWS_Display_Init() allocates them as set in
+ * menuconfig (DISP_BUF_MEM and DISP_BUF_LINES). This
+ * function moves or resizes them at runtime. It takes the
+ * xGuiSemaphore mutex, so it must not be held by the caller,
+ * and waits for the flush in progress to finish.
+ *
+ * If the stripes do not fit in internal RAM, the number of
+ * lines is halved down to 8 lines, then SPIRAM is used.
+ * Core2ForAWS_Display_GetBuffers() tells what was used.
+ *
+ * Large application buffers, like canvases, are better
+ * allocated in SPIRAM so the stripes fit in internal RAM.
+ *
+ * **Example:**
+ *
+ * Render into 40 line stripes in internal RAM.
+ * @code{c}
+ *  Core2ForAWS_Display_SetBuffers(DISPLAY_BUF_INTERNAL, 40);
+ * @endcode
+ *
+ * @param[in] mem the memory to allocate the stripes in.
+ * @param[in] lines the height of each stripe, from 8 to 64.
+ * @return [esp_err_t](https://docs.espressif.com/projects/esp-idf/en/latest/esp32/api-reference/system/esp_err.html#macros).
+ *  - ESP_OK                : Success, possibly with the fallback
+ *  - ESP_ERR_NO_MEM        : Nothing fit, the previous stripes are kept
+ */
+/* @[declare_core2foraws_display_setbuffers] */
+esp_err_t Core2ForAWS_Display_SetBuffers(display_buf_mem_t mem, uint16_t lines);
+/* @[declare_core2foraws_display_setbuffers] */
+
+/**
+ * @brief Gets where the LVGL draw buffers are and their height.
+ *
+ * @param[out] mem the memory the stripes are allocated in.
+ * @param[out] lines the height of each stripe.
+ */
+/* @[declare_core2foraws_display_getbuffers] */
+void Core2ForAWS_Display_GetBuffers(display_buf_mem_t *mem, uint16_t *lines);
+/* @[declare_core2foraws_display_getbuffers] */
 #endif
 
 /**
@@ -584,6 +637,51 @@ void Core2ForAWS_Sk6812_Show(void);
 /* @[declare_core2foraws_sk6812_clear] */
 void Core2ForAWS_Sk6812_Clear(void);
 /* @[declare_core2foraws_sk6812_clear] */
+
+/**
+ * @brief Animates the LED bars from a task which calls
+ * `frame_cb` and shows the LEDs `fps` times per second.
+ *
+ * The callback sets the LEDs for each frame with
+ * Core2ForAWS_Sk6812_SetColor or Core2ForAWS_Sk6812_SetSideColor,
+ * the task shows them. The animation ends when the callback
+ * returns false or Core2ForAWS_Sk6812_StopAnimation() is called.
+ * Starting an animation stops the running one.
+ *
+ * @note The frame rate is limited to the FreeRTOS tick rate.
+ *
+ * **Example:**
+ *
+ * Run a light along the LED bars for 2 seconds at 100 frames per second.
+ * @code{c}
+ *  static bool chase(pixel_settings_t *px, uint32_t frame, void *arg) {
+ *      Core2ForAWS_Sk6812_Clear();
+ *      Core2ForAWS_Sk6812_SetColor(frame % 10, 0x00ff00);
+ *      return frame < 200;
+ *  }
+ *
+ *  Core2ForAWS_Sk6812_StartAnimation(100, chase, NULL);
+ * @endcode
+ *
+ * @param[in] fps Frames per second.
+ * @param[in] frame_cb Called before each frame with the frame number.
+ * @param[in] arg Passed to `frame_cb`.
+ * @return [esp_err_t](https://docs.espressif.com/projects/esp-idf/en/latest/esp32/api-reference/system/esp_err.html#macros).
+ *  - ESP_OK                : Success
+ *  - ESP_ERR_INVALID_ARG   : No callback or fps is 0
+ *  - ESP_ERR_NO_MEM        : The animation task could not be created
+ */
+/* @[declare_core2foraws_sk6812_startanimation] */
+esp_err_t Core2ForAWS_Sk6812_StartAnimation(uint16_t fps, np_frame_cb_t frame_cb, void *arg);
+/* @[declare_core2foraws_sk6812_startanimation] */
+
+/**
+ * @brief Stops the animation started with Core2ForAWS_Sk6812_StartAnimation()
+ * and waits for its last frame. The LEDs keep the last frame.
+ */
+/* @[declare_core2foraws_sk6812_stopanimation] */
+void Core2ForAWS_Sk6812_StopAnimation(void);
+/* @[declare_core2foraws_sk6812_stopanimation] */
 #endif
 
 #if CONFIG_SOFTWARE_SDCARD_SUPPORT
@@ -1,11 +1,54 @@
 #include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "driver/gpio.h"
+#include "esp_timer.h"
+#include "esp_log.h"
 #include "i2c_device.h"
 #include "mpu6886.h"
 
+#define MPU6886_USER_CTRL_FIFO_EN   (0x01 << 6)
+#define MPU6886_USER_CTRL_FIFO_RST  (0x01 << 2)
+#define MPU6886_CONFIG_FIFO_MODE    (0x01 << 6)
+#define MPU6886_FIFO_EN_GYRO        (0x01 << 4)
+#define MPU6886_FIFO_EN_ACCEL       (0x01 << 3)
+#define MPU6886_INT_FIFO_OFLOW      (0x01 << 4)
+#define MPU6886_FIFO_WM_INT         (0x01 << 6)
+#define MPU6886_INT_DATA_RDY        (0x01 << 0)
+#define MPU6886_DLPF_CFG            0x01
+
+/* FIFO frames per I2C read, so a full FIFO does not hold the bus for 23ms and touch reads get in between */
+#define MPU6886_FIFO_READ_FRAMES    4
+
+#ifdef CONFIG_MPU6886_INT_PIN
+#define MPU6886_STREAM_INT_PIN      CONFIG_MPU6886_INT_PIN
+#else
+#define MPU6886_STREAM_INT_PIN      -1
+#endif
+
+#if MPU6886_STREAM_INT_PIN >= 0
+static const char *TAG = "MPU6886";
+#endif
+
+typedef struct {
+    mpu6886_stream_cb_t callback;
+    void *arg;
+    uint16_t batch;
+    int64_t period_us;
+    int64_t last_read_us;
+    bool wm_int_seen;
+    volatile bool run;
+    TaskHandle_t task;
+    SemaphoreHandle_t done;
+} mpu6886_stream_t;
+
 static I2CDevice_t mpu6886_device;
 static gyro_scale_t gyro_scale = MPU6886_GFS_2000DPS;
 static acc_scale_t acc_scale = MPU6886_AFS_8G;
 static float acc_res, gyro_res;
+static mpu6886_stream_t stream;
+static uint8_t stream_buf[MPU6886_STREAM_MAX_BATCH * MPU6886_FIFO_FRAME_SIZE];
+static mpu6886_sample_t stream_samples[MPU6886_STREAM_MAX_BATCH];
 
 static void MPU6886_I2CInit() {
     mpu6886_device = i2c_malloc_device(I2C_NUM_1, 21, 22, 400000, MPU6886_ADDRESS);
@@ -187,3 +230,204 @@ void MPU6886_GetTempData(float *t) {
     MPU6886_GetTempAdc(&temp);
     *t = (float)temp / 326.8 + 25.0;
 }
+
+static void MPU6886_WriteReg(uint8_t reg, uint8_t value) {
+    MPU6886_I2CWriteBytes(reg, 1, &value);
+}
+
+static void MPU6886_FIFOReset(void) {
+    MPU6886_WriteReg(MPU6886_USER_CTRL, MPU6886_USER_CTRL_FIFO_EN | MPU6886_USER_CTRL_FIFO_RST);
+}
+
+#if MPU6886_STREAM_INT_PIN >= 0
+static void IRAM_ATTR MPU6886_StreamISRHandler(void *arg) {
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(stream.task, &woken);
+    if (woken) {
+        portYIELD_FROM_ISR();
+    }
+}
+#endif
+
+static void MPU6886_StreamDecode(const uint8_t *frame, int64_t timestamp_us, mpu6886_sample_t *sample) {
+    int16_t raw[7];
+    for (int i = 0; i < 7; i++) {
+        raw[i] = ((uint16_t)frame[2 * i] << 8) | frame[2 * i + 1];
+    }
+
+    sample->timestamp_us = timestamp_us;
+    sample->ax = (float)raw[0] * acc_res;
+    sample->ay = (float)raw[1] * acc_res;
+    sample->az = (float)raw[2] * acc_res;
+    sample->t = (float)raw[3] / 326.8 + 25.0;
+    sample->gx = (float)raw[4] * gyro_res;
+    sample->gy = (float)raw[5] * gyro_res;
+    sample->gz = (float)raw[6] * gyro_res;
+}
+
+/* Reads everything in the FIFO, a few frames per transaction, and hands it to the callback */
+static void MPU6886_StreamRead(void) {
+    uint8_t buf[2];
+    uint32_t dropped = 0;
+    int64_t previous_read_us = stream.last_read_us;
+
+#if MPU6886_STREAM_INT_PIN >= 0
+    /*
+        The watermark and the overflow latch their own status registers, both
+        are cleared on read and the INT pin is released once both are clear.
+    */
+    MPU6886_I2CReadBytes(MPU6886_FIFO_WM_INT_STATUS, 2, buf);
+    if (buf[0] & MPU6886_FIFO_WM_INT) {
+        stream.wm_int_seen = true;
+    }
+#endif
+
+    MPU6886_I2CReadBytes(MPU6886_FIFO_COUNTH, 2, buf);
+    int64_t now = esp_timer_get_time();
+    uint16_t count = (((uint16_t)buf[0] << 8) | buf[1]) & 0x1FFF;
+    uint16_t frames = count / MPU6886_FIFO_FRAME_SIZE;
+    bool full = count > MPU6886_FIFO_SIZE - MPU6886_FIFO_FRAME_SIZE;
+
+    if (frames > MPU6886_STREAM_MAX_BATCH) {
+        frames = MPU6886_STREAM_MAX_BATCH;
+    }
+    if (full) {
+        /* The FIFO stopped taking samples some time ago, guess how many from the clock */
+        int64_t expected = (now - stream.last_read_us) / stream.period_us;
+        dropped = expected > frames ? expected - frames : 0;
+    }
+    stream.last_read_us = now;
+
+    if (frames > 0) {
+        for (uint16_t i = 0; i < frames; i += MPU6886_FIFO_READ_FRAMES) {
+            uint16_t chunk = frames - i < MPU6886_FIFO_READ_FRAMES ? frames - i : MPU6886_FIFO_READ_FRAMES;
+            i2c_read_bytes(mpu6886_device, MPU6886_FIFO_R_W, &stream_buf[i * MPU6886_FIFO_FRAME_SIZE], chunk * MPU6886_FIFO_FRAME_SIZE);
+        }
+        for (uint16_t i = 0; i < frames; i++) {
+            int64_t timestamp_us;
+            if (full) {
+                /* The FIFO kept the oldest samples and stopped, they follow the previous read */
+                timestamp_us = previous_read_us + (int64_t)(i + 1) * stream.period_us;
+            } else {
+                /* The newest sample was taken just before the count was read */
+                timestamp_us = now - (int64_t)(frames - 1 - i) * stream.period_us;
+            }
+            MPU6886_StreamDecode(&stream_buf[i * MPU6886_FIFO_FRAME_SIZE], timestamp_us, &stream_samples[i]);
+        }
+    }
+
+    if (full) {
+        /* A full FIFO may end in a partial frame, start over on a frame boundary */
+        MPU6886_FIFOReset();
+    }
+
+    if (frames > 0 || dropped > 0) {
+        stream.callback(stream_samples, frames, dropped, stream.arg);
+    }
+}
+
+static void MPU6886_StreamTask(void *arg) {
+    TickType_t batch_ticks = pdMS_TO_TICKS(stream.batch * stream.period_us / 1000);
+    if (batch_ticks == 0) {
+        batch_ticks = 1;
+    }
+#if MPU6886_STREAM_INT_PIN >= 0
+    /* Only in case an interrupt is missed */
+    batch_ticks *= 2;
+#endif
+
+    while (stream.run) {
+        uint32_t notified = ulTaskNotifyTake(pdTRUE, batch_ticks);
+        if (!stream.run) {
+            break;
+        }
+        MPU6886_StreamRead();
+#if MPU6886_STREAM_INT_PIN >= 0
+        if (notified == 0 && !stream.wm_int_seen) {
+            ESP_LOGW(TAG, "No FIFO watermark interrupt on GPIO %d, reading every %d ms", MPU6886_STREAM_INT_PIN,
+                     (int)(batch_ticks * portTICK_PERIOD_MS));
+            /* Only warn once */
+            stream.wm_int_seen = true;
+        }
+#else
+        (void)notified;
+#endif
+    }
+
+    xSemaphoreGive(stream.done);
+    vTaskDelete(NULL);
+}
+
+esp_err_t MPU6886_StartStream(uint16_t odr_hz, uint16_t batch, mpu6886_stream_cb_t callback, void *arg) {
+    if (odr_hz < 4 || odr_hz > 1000 || batch < 1 || batch > MPU6886_STREAM_MAX_BATCH || callback == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (stream.task != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (stream.done == NULL) {
+        stream.done = xSemaphoreCreateBinary();
+        if (stream.done == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    uint8_t divider = 1000 / odr_hz - 1;
+    stream.callback = callback;
+    stream.arg = arg;
+    stream.batch = batch;
+    stream.period_us = 1000 * (divider + 1);
+
+    MPU6886_WriteReg(MPU6886_USER_CTRL, 0x00);
+    MPU6886_WriteReg(MPU6886_FIFO_EN, 0x00);
+    MPU6886_WriteReg(MPU6886_SMPLRT_DIV, divider);
+    /* Stop taking samples when full instead of overwriting, so the FIFO keeps whole frames */
+    MPU6886_WriteReg(MPU6886_CONFIG, MPU6886_CONFIG_FIFO_MODE | MPU6886_DLPF_CFG);
+    MPU6886_WriteReg(MPU6886_FIFO_WM_TH1, (batch * MPU6886_FIFO_FRAME_SIZE) >> 8);
+    MPU6886_WriteReg(MPU6886_FIFO_WM_TH2, (batch * MPU6886_FIFO_FRAME_SIZE) & 0xFF);
+    /* The watermark interrupt has no enable bit, it reaches the INT pin once FIFO_WM_TH is set */
+    MPU6886_WriteReg(MPU6886_INT_ENABLE, MPU6886_INT_FIFO_OFLOW);
+    MPU6886_WriteReg(MPU6886_FIFO_EN, MPU6886_FIFO_EN_GYRO | MPU6886_FIFO_EN_ACCEL);
+    MPU6886_FIFOReset();
+    stream.last_read_us = esp_timer_get_time();
+    stream.wm_int_seen = false;
+
+    stream.run = true;
+    if (xTaskCreatePinnedToCore(MPU6886_StreamTask, "MPU6886Stream", 3 * 1024, NULL, 3, &stream.task, tskNO_AFFINITY) != pdPASS) {
+        stream.task = NULL;
+        MPU6886_StopStream();
+        return ESP_ERR_NO_MEM;
+    }
+
+#if MPU6886_STREAM_INT_PIN >= 0
+    gpio_config_t io_conf = {
+        .intr_type = GPIO_INTR_POSEDGE,
+        .pin_bit_mask = (1ULL << MPU6886_STREAM_INT_PIN),
+        .mode = GPIO_MODE_INPUT,
+    };
+    gpio_config(&io_conf);
+    gpio_install_isr_service(0);
+    gpio_isr_handler_add(MPU6886_STREAM_INT_PIN, MPU6886_StreamISRHandler, NULL);
+#endif
+    return ESP_OK;
+}
+
+void MPU6886_StopStream(void) {
+#if MPU6886_STREAM_INT_PIN >= 0
+    gpio_isr_handler_remove(MPU6886_STREAM_INT_PIN);
+#endif
+
+    if (stream.task != NULL) {
+        stream.run = false;
+        xTaskNotifyGive(stream.task);
+        xSemaphoreTake(stream.done, portMAX_DELAY);
+        stream.task = NULL;
+    }
+
+    /* Back to the settings of MPU6886_Init() */
+    MPU6886_WriteReg(MPU6886_USER_CTRL, 0x00);
+    MPU6886_WriteReg(MPU6886_FIFO_EN, 0x00);
+    MPU6886_WriteReg(MPU6886_CONFIG, MPU6886_DLPF_CFG);
+    MPU6886_WriteReg(MPU6886_SMPLRT_DIV, 0x05);
+    MPU6886_WriteReg(MPU6886_INT_ENABLE, MPU6886_INT_DATA_RDY);
+}
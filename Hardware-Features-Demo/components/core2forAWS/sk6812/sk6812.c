@@ -25,6 +25,7 @@
  */
 
 #include <math.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "freertos/FreeRTOS.h"
@@ -38,15 +39,76 @@
 
 #include "soc/dport_access.h"
 #include "soc/dport_reg.h"
+#include "xtensa/hal.h"
+
+// RMT clock with clk_div = 2, ticks per us
+#define NEOPIXEL_RMT_TICKS_PER_US	40
+#define NEOPIXEL_ANIMATION_STACK	(3 * 1024)
+#define NEOPIXEL_ANIMATION_PRIORITY	2
+
+// Two frame buffers per channel, one is sent by the RMT while np_show() fills the other
+typedef struct np_channel {
+	uint8_t *frames[2];
+	uint16_t frame_len;		// size of each frame buffer
+	uint8_t back;			// frame filled by the next np_show()
+} np_channel_t;
 
 static SemaphoreHandle_t neopixel_sem = NULL;
-static uint16_t neopixel_buf_len = 0;
-static uint8_t *neopixel_buffer = NULL;
-static uint32_t neopixel_t0h_ticks = 0;
-static uint32_t neopixel_t1h_ticks = 0;
-static uint32_t neopixel_t0l_ticks = 0;
-static uint32_t neopixel_t1l_ticks = 0;
-static uint32_t neopixel_reset_ticks = 0;
+static np_channel_t neopixel_channels[RMT_CHANNEL_MAX];
+static uint32_t neopixel_sending = 0;		// channels which may have a frame in flight
+
+// RMT symbols of each nibble, MSB first, so the translator copies 8 words per byte
+static rmt_item32_t neopixel_symbols[16][4];
+static rmt_item32_t neopixel_reset;
+static pixel_timing_t neopixel_timings;
+static bool neopixel_symbols_valid = false;
+
+// Brightness and gamma applied to each color byte
+static uint8_t neopixel_lut[256];
+static uint8_t neopixel_lut_brightness;
+static bool neopixel_lut_gamma;
+static bool neopixel_lut_valid = false;
+
+// Off unless np_enable_stats() is called, so the translator does not pay for them
+static volatile bool neopixel_stats_enabled = false;
+static portMUX_TYPE neopixel_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint64_t neopixel_show_cycles = 0;
+static uint32_t neopixel_frames = 0;
+// Added to without a lock from the translator, the cycles wrap after about 17 s at 240 MHz
+static uint32_t neopixel_isr_cycles = 0;
+static uint32_t neopixel_isr_calls = 0;
+
+static struct {
+	pixel_settings_t *px;
+	rmt_channel_t channel;
+	TickType_t period;
+	np_frame_cb_t frame_cb;
+	void *arg;
+} neopixel_animation;
+static TaskHandle_t neopixel_animation_task = NULL;
+static SemaphoreHandle_t neopixel_animation_done = NULL;
+static volatile bool neopixel_animation_stop = false;
+static portMUX_TYPE neopixel_animation_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Gamma 2.8 for 8-bit color values
+static const uint8_t neopixel_gamma8[256] = {
+	  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+	  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   1,   1,   1,   1,
+	  1,   1,   1,   1,   1,   1,   1,   1,   1,   2,   2,   2,   2,   2,   2,   2,
+	  2,   3,   3,   3,   3,   3,   3,   3,   4,   4,   4,   4,   4,   5,   5,   5,
+	  5,   6,   6,   6,   6,   7,   7,   7,   7,   8,   8,   8,   9,   9,   9,  10,
+	 10,  10,  11,  11,  11,  12,  12,  13,  13,  13,  14,  14,  15,  15,  16,  16,
+	 17,  17,  18,  18,  19,  19,  20,  20,  21,  21,  22,  22,  23,  24,  24,  25,
+	 25,  26,  27,  27,  28,  29,  29,  30,  31,  32,  32,  33,  34,  35,  35,  36,
+	 37,  38,  39,  39,  40,  41,  42,  43,  44,  45,  46,  47,  48,  49,  50,  50,
+	 51,  52,  54,  55,  56,  57,  58,  59,  60,  61,  62,  63,  64,  66,  67,  68,
+	 69,  70,  72,  73,  74,  75,  77,  78,  79,  81,  82,  83,  85,  86,  87,  89,
+	 90,  92,  93,  95,  96,  98,  99, 101, 102, 104, 105, 107, 109, 110, 112, 114,
+	115, 117, 119, 120, 122, 124, 126, 127, 129, 131, 133, 135, 137, 138, 140, 142,
+	144, 146, 148, 150, 152, 154, 156, 158, 160, 162, 164, 167, 169, 171, 173, 175,
+	177, 180, 182, 184, 186, 189, 191, 193, 196, 198, 200, 203, 205, 208, 210, 213,
+	215, 218, 220, 223, 225, 228, 231, 233, 236, 239, 241, 244, 247, 249, 252, 255
+};
 
 // Get color value of RGB component
 //---------------------------------------------------
@@ -125,13 +187,13 @@ static void IRAM_ATTR np_rmt_adapter(const void *src, rmt_item32_t *dest, size_t
         *item_num = 0;
         return;
     }
-    const rmt_item32_t bit0 = {{{ neopixel_t0h_ticks, 1, neopixel_t0l_ticks, 0 }}}; //Logical 0
-    const rmt_item32_t bit1 = {{{ neopixel_t1h_ticks, 1, neopixel_t1l_ticks, 0 }}}; //Logical 1
+    bool stats = neopixel_stats_enabled;
+    uint32_t start = stats ? xthal_get_ccount() : 0;
     size_t size = 0;
     size_t num = 0;
-    uint8_t *psrc = (uint8_t *)src;
+    const uint8_t *psrc = (const uint8_t *)src;
     rmt_item32_t *pdest = dest;
-	uint8_t transmit_end = 0;	
+	uint8_t transmit_end = 0;
 
 	if ((wanted_num >> 3) >= src_size) {
 		src_size -= 1;
@@ -139,29 +201,79 @@ static void IRAM_ATTR np_rmt_adapter(const void *src, rmt_item32_t *dest, size_t
 	}
 
     while (size < src_size && num < wanted_num) {
-        for (int i = 0; i < 8; i++) {
-            // MSB first
-            if (*psrc & (1 << (7 - i))) {
-                pdest->val =  bit1.val;
-            } else {
-                pdest->val =  bit0.val;
-            }
-            num++;
-            pdest++;
-        }
+        const rmt_item32_t *hi = neopixel_symbols[*psrc >> 4];
+        const rmt_item32_t *lo = neopixel_symbols[*psrc & 0x0f];
+        pdest[0].val = hi[0].val;
+        pdest[1].val = hi[1].val;
+        pdest[2].val = hi[2].val;
+        pdest[3].val = hi[3].val;
+        pdest[4].val = lo[0].val;
+        pdest[5].val = lo[1].val;
+        pdest[6].val = lo[2].val;
+        pdest[7].val = lo[3].val;
+        pdest += 8;
+        num += 8;
         size++;
         psrc++;
     }
 
 	if (transmit_end) {
-		const rmt_item32_t reset = {{{ neopixel_reset_ticks >> 1, 0, neopixel_reset_ticks >> 1, 0 }}};
-		pdest->val = reset.val;
+		pdest->val = neopixel_reset.val;
 		size += 1;
 		num += 1;
 	}
 
 	*translated_size = size;
     *item_num = num;
+
+	if (stats) {
+		__atomic_fetch_add(&neopixel_isr_cycles, xthal_get_ccount() - start, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&neopixel_isr_calls, 1, __ATOMIC_RELAXED);
+	}
+}
+
+// Rebuild the RMT symbols if the timings changed, integer ns to ticks
+//----------------------------------------------------
+static void np_update_symbols(const pixel_timing_t *t) {
+	if (neopixel_symbols_valid && t->t0h == neopixel_timings.t0h && t->t0l == neopixel_timings.t0l &&
+			t->t1h == neopixel_timings.t1h && t->t1l == neopixel_timings.t1l && t->reset == neopixel_timings.reset) {
+		return;
+	}
+
+	// The translator may be reading the symbols for a frame still in flight
+	for (int ch = 0; ch < RMT_CHANNEL_MAX; ch++) {
+		if (neopixel_sending & (1 << ch)) rmt_wait_tx_done(ch, portMAX_DELAY);
+	}
+
+	const rmt_item32_t bit0 = {{{ t->t0h * NEOPIXEL_RMT_TICKS_PER_US / 1000, 1, t->t0l * NEOPIXEL_RMT_TICKS_PER_US / 1000, 0 }}}; //Logical 0
+	const rmt_item32_t bit1 = {{{ t->t1h * NEOPIXEL_RMT_TICKS_PER_US / 1000, 1, t->t1l * NEOPIXEL_RMT_TICKS_PER_US / 1000, 0 }}}; //Logical 1
+	uint32_t reset_ticks = t->reset * NEOPIXEL_RMT_TICKS_PER_US / 1000;
+
+	for (int n = 0; n < 16; n++) {
+		for (int i = 0; i < 4; i++) {
+			neopixel_symbols[n][i].val = (n & (0x08 >> i)) ? bit1.val : bit0.val;
+		}
+	}
+	const rmt_item32_t reset = {{{ reset_ticks >> 1, 0, reset_ticks >> 1, 0 }}};
+	neopixel_reset.val = reset.val;
+
+	neopixel_timings = *t;
+	neopixel_symbols_valid = true;
+}
+
+// Rebuild the color lookup table if brightness or gamma changed
+//----------------------------------------------------
+static void np_update_lut(uint8_t brightness, bool gamma) {
+	if (neopixel_lut_valid && brightness == neopixel_lut_brightness && gamma == neopixel_lut_gamma) {
+		return;
+	}
+	for (int i = 0; i < 256; i++) {
+		uint32_t value = gamma ? neopixel_gamma8[i] : i;
+		neopixel_lut[i] = value * brightness / 255;
+	}
+	neopixel_lut_brightness = brightness;
+	neopixel_lut_gamma = gamma;
+	neopixel_lut_valid = true;
 }
 
 // Initialize Neopixel RMT interface on specific GPIO
@@ -212,48 +324,166 @@ failed:
 // Deinitialize RMT interface
 //=========================================
 void neopixel_deinit(rmt_channel_t channel) {
+	np_channel_t *ch = &neopixel_channels[channel];
+
 	xSemaphoreTake(neopixel_sem, portMAX_DELAY);
+	if (neopixel_sending & (1 << channel)) {
+		rmt_wait_tx_done(channel, portMAX_DELAY);
+		neopixel_sending &= ~(1 << channel);
+	}
 	rmt_driver_uninstall(channel);
+	free(ch->frames[0]);
+	free(ch->frames[1]);
+	memset(ch, 0, sizeof(np_channel_t));
 	xSemaphoreGive(neopixel_sem);
 }
 
 // Start the transfer of Neopixel color bytes from buffer
+// Returns once the previous frame of the channel is sent, while this one is still going out
 //=======================================================
 void np_show(pixel_settings_t *px, rmt_channel_t channel)
 {
-	float ratio = 40000000.0 / 1e9; 
-	uint16_t blen = px->pixel_count * (px->nbits / 8) + 1;
+	np_channel_t *ch = &neopixel_channels[channel];
+	uint16_t len = px->pixel_count * (px->nbits / 8);
+	// One more byte, the translator sends the reset for the last one
+	uint16_t blen = len + 1;
 
 	xSemaphoreTake(neopixel_sem, portMAX_DELAY);
-	neopixel_t0h_ticks = (uint32_t)(ratio * px->timings.t0h);
-    neopixel_t0l_ticks = (uint32_t)(ratio * px->timings.t0l);
-    neopixel_t1h_ticks = (uint32_t)(ratio * px->timings.t1h);
-    neopixel_t1l_ticks = (uint32_t)(ratio * px->timings.t1l);
-	neopixel_reset_ticks = (uint32_t)(ratio * px->timings.reset);
-
-	// Allocate neopixel buffer if needed
-	if (neopixel_buffer == NULL) {
-		neopixel_buffer = (uint8_t *)malloc(blen);
-		if (neopixel_buffer == NULL) return;
-		neopixel_buf_len = blen;
-	}
-	// Resize neopixel buffer if needed
-	if (neopixel_buf_len < blen) {
-		// larger buffer needed
-		free(neopixel_buffer);
-		neopixel_buffer = (uint8_t *)malloc(blen);
-		if (neopixel_buffer == NULL) return;
+	uint32_t start = xthal_get_ccount();
+
+	// Allocate or grow the frame buffers, only when the strip gets longer
+	if (ch->frame_len < blen) {
+		if (neopixel_sending & (1 << channel)) {
+			rmt_wait_tx_done(channel, portMAX_DELAY);
+			neopixel_sending &= ~(1 << channel);
+		}
+		free(ch->frames[0]);
+		free(ch->frames[1]);
+		ch->frames[0] = (uint8_t *)malloc(blen);
+		ch->frames[1] = (uint8_t *)malloc(blen);
+		if (ch->frames[0] == NULL || ch->frames[1] == NULL) {
+			free(ch->frames[0]);
+			free(ch->frames[1]);
+			memset(ch, 0, sizeof(np_channel_t));
+			xSemaphoreGive(neopixel_sem);
+			return;
+		}
+		ch->frame_len = blen;
 	}
 
-	memcpy(neopixel_buffer, px->pixels, blen);
-	for (uint16_t i = 0; i < blen; i++) {
-		float b = px->brightness / 255.0;
-		neopixel_buffer[i] = b * neopixel_buffer[i]; 
+	np_update_symbols(&px->timings);
+	np_update_lut(px->brightness, px->gamma);
+
+	uint8_t *frame = ch->frames[ch->back];
+	for (uint16_t i = 0; i < len; i++) {
+		frame[i] = neopixel_lut[px->pixels[i]];
+	}
+	frame[len] = 0;
+
+	if (neopixel_stats_enabled) {
+		uint32_t cycles = xthal_get_ccount() - start;
+		portENTER_CRITICAL(&neopixel_stats_lock);
+		neopixel_show_cycles += cycles;
+		neopixel_frames++;
+		portEXIT_CRITICAL(&neopixel_stats_lock);
 	}
-	rmt_write_sample(channel, neopixel_buffer, blen, true);
+
+	// Waits for the frame in flight, then sends this one from the ISR
+	rmt_write_sample(channel, frame, blen, false);
+	neopixel_sending |= 1 << channel;
+	ch->back ^= 1;
 	xSemaphoreGive(neopixel_sem);
 }
 
+// Get the time spent in np_show() and in the RMT translator since the stats were enabled
+//=======================================================================================
+void np_get_stats(np_stats_t *stats)
+{
+	portENTER_CRITICAL(&neopixel_stats_lock);
+	stats->frames = neopixel_frames;
+	stats->show_us = neopixel_show_cycles / CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ;
+	portEXIT_CRITICAL(&neopixel_stats_lock);
+	stats->isr_us = __atomic_load_n(&neopixel_isr_cycles, __ATOMIC_RELAXED) / CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ;
+	stats->isr_calls = __atomic_load_n(&neopixel_isr_calls, __ATOMIC_RELAXED);
+}
+
+// Start counting from zero, or stop counting
+//=========================================
+void np_enable_stats(bool enable)
+{
+	neopixel_stats_enabled = false;
+	portENTER_CRITICAL(&neopixel_stats_lock);
+	neopixel_show_cycles = 0;
+	neopixel_frames = 0;
+	portEXIT_CRITICAL(&neopixel_stats_lock);
+	__atomic_store_n(&neopixel_isr_cycles, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&neopixel_isr_calls, 0, __ATOMIC_RELAXED);
+	neopixel_stats_enabled = enable;
+}
+
+//-------------------------------------------
+static void np_animation_task(void *arg) {
+	TickType_t last_wake = xTaskGetTickCount();
+
+	for (uint32_t frame = 0; neopixel_animation_stop == false; frame++) {
+		if (neopixel_animation.frame_cb(neopixel_animation.px, frame, neopixel_animation.arg) == false) {
+			break;
+		}
+		np_show(neopixel_animation.px, neopixel_animation.channel);
+		vTaskDelayUntil(&last_wake, neopixel_animation.period);
+	}
+
+	portENTER_CRITICAL(&neopixel_animation_lock);
+	neopixel_animation_task = NULL;
+	portEXIT_CRITICAL(&neopixel_animation_lock);
+	xSemaphoreGive(neopixel_animation_done);
+	vTaskDelete(NULL);
+}
+
+// Call frame_cb and show the pixels fps times per second from a task, until it returns false
+// or np_animation_stop() is called. fps is limited to the FreeRTOS tick rate.
+//===========================================================================================
+esp_err_t np_animation_start(pixel_settings_t *px, rmt_channel_t channel, uint16_t fps, np_frame_cb_t frame_cb, void *arg)
+{
+	if (frame_cb == NULL || fps == 0) return ESP_ERR_INVALID_ARG;
+
+	np_animation_stop();
+	if (neopixel_animation_done == NULL) {
+		neopixel_animation_done = xSemaphoreCreateBinary();
+		if (neopixel_animation_done == NULL) return ESP_ERR_NO_MEM;
+	}
+	// An animation which ended by itself left the semaphore given
+	xSemaphoreTake(neopixel_animation_done, 0);
+
+	neopixel_animation.px = px;
+	neopixel_animation.channel = channel;
+	neopixel_animation.period = configTICK_RATE_HZ / fps > 0 ? configTICK_RATE_HZ / fps : 1;
+	neopixel_animation.frame_cb = frame_cb;
+	neopixel_animation.arg = arg;
+	neopixel_animation_stop = false;
+
+	if (xTaskCreatePinnedToCore(np_animation_task, "np_animation", NEOPIXEL_ANIMATION_STACK, NULL,
+			NEOPIXEL_ANIMATION_PRIORITY, &neopixel_animation_task, 1) != pdPASS) {
+		neopixel_animation_task = NULL;
+		return ESP_ERR_NO_MEM;
+	}
+	return ESP_OK;
+}
+
+// Stop the animation and wait for its task to end. From frame_cb it only asks it to stop.
+//========================================================================================
+void np_animation_stop(void)
+{
+	portENTER_CRITICAL(&neopixel_animation_lock);
+	TaskHandle_t task = neopixel_animation_task;
+	neopixel_animation_stop = true;
+	portEXIT_CRITICAL(&neopixel_animation_lock);
+
+	if (task != NULL && task != xTaskGetCurrentTaskHandle()) {
+		xSemaphoreTake(neopixel_animation_done, portMAX_DELAY);
+	}
+}
+
 // Clear the Neopixel color buffer
 //=================================
 void np_clear(pixel_settings_t *px)
@@ -254,12 +254,19 @@ typedef void * lv_group_user_data_t;
 
 /* 1: Enable GPU interface
  * Only enables `gpu_fill_cb` and `gpu_blend_cb` in the disp. drv- */
-#if defined CONFIG_LV_FEATURE_USE_GPU
+#if defined CONFIG_LV_FEATURE_USE_GPU || defined CONFIG_LV_USE_GPU_ESP32
     #define LV_USE_GPU              1
 #else
     #define LV_USE_GPU              0
 #endif
 
+/* 1: Use the word-at-a-time RGB565 kernels of lv_gpu_esp32 as `gpu_fill_cb` and `gpu_blend_cb` */
+#if defined CONFIG_LV_USE_GPU_ESP32
+    #define LV_USE_GPU_ESP32        1
+#else
+    #define LV_USE_GPU_ESP32        0
+#endif
+
 #if defined CONFIG_LV_FEATURE_USE_GPU_STM32_DMA2D
     #define LV_USE_GPU_STM32_DMA2D  1
 #else
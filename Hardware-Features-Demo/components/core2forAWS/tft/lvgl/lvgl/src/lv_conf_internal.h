@@ -500,6 +500,15 @@ e.g. "stm32f769xx.h" or "stm32f429xx.h" */
 #  endif
 #endif
 
+/* 1: Use the word-at-a-time RGB565 kernels of lv_gpu_esp32 as `gpu_fill_cb` and `gpu_blend_cb` */
+#ifndef LV_USE_GPU_ESP32
+#  ifdef CONFIG_LV_USE_GPU_ESP32
+#    define LV_USE_GPU_ESP32 CONFIG_LV_USE_GPU_ESP32
+#  else
+#    define  LV_USE_GPU_ESP32        0
+#  endif
+#endif
+
 /*1: Use PXP for CPU off-load on NXP RTxxx platforms */
 #ifndef LV_USE_GPU_NXP_PXP
 #  ifdef CONFIG_LV_USE_GPU_NXP_PXP
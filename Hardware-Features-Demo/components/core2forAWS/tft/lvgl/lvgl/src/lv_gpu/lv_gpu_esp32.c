@@ -0,0 +1,287 @@
+/**
+ * @file lv_gpu_esp32.c
+ *
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "lv_gpu_esp32.h"
+
+#if LV_USE_GPU_ESP32
+
+/*********************
+ *      DEFINES
+ *********************/
+
+#if LV_COLOR_DEPTH != 16
+    #error "Can't use the ESP32 GPU kernels with LV_COLOR_DEPTH != 16"
+#endif
+
+/*The R, G or B of two pixels in 16 bit lanes*/
+#define LANES_5     0x001F001F
+#define LANES_6     0x003F003F
+#define LANES_8     0x00FF00FF
+#define LANES_ONE   0x00010001
+#define LANES_ROUND 0x00800080  /*LV_COLOR_MIX_ROUND_OFS in both lanes*/
+
+/*`LV_MATH_UDIV255` in both lanes. Same as `(x * 0x8081) >> 23` for x < 65535, and a lane is at most 63 * 255 + 128*/
+#define LANES_UDIV255(x) ((((x) + LANES_ONE + (((x) >> 8) & LANES_8)) >> 8) & LANES_8)
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static inline uint32_t swap2(uint32_t px2);
+static inline uint32_t mix2(uint32_t fg2, uint32_t bg2, uint32_t opa, uint32_t opa_inv);
+static inline uint32_t load2(const lv_color_t * px);
+static void fill_line(lv_color_t * buf, lv_color_t color, int32_t w);
+static void copy_line(lv_color_t * buf, const lv_color_t * map, int32_t w);
+static void blend_line(lv_color_t * buf, const lv_color_t * map, lv_opa_t opa, int32_t w);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+/**********************
+ *      MACROS
+ **********************/
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+/**
+ * Fill an area in the buffer with a color
+ * @param buf a buffer which should be filled
+ * @param buf_w width of the buffer in pixels
+ * @param color fill color
+ * @param fill_w width to fill in pixels (<= buf_w)
+ * @param fill_h height to fill in pixels
+ * @note `buf_w - fill_w` is offset to the next line after fill
+ */
+LV_ATTRIBUTE_FAST_MEM void lv_gpu_esp32_fill(lv_color_t * buf, lv_coord_t buf_w, lv_color_t color, lv_coord_t fill_w,
+                                             lv_coord_t fill_h)
+{
+    lv_coord_t y;
+    for(y = 0; y < fill_h; y++) {
+        fill_line(buf, color, fill_w);
+        buf += buf_w;
+    }
+}
+
+/**
+ * Copy a map (typically RGB image) to a buffer
+ * @param buf a buffer where map should be copied
+ * @param buf_w width of the buffer in pixels
+ * @param map an "image" to copy
+ * @param map_w width of the map in pixels
+ * @param copy_w width of the area to copy in pixels (<= buf_w)
+ * @param copy_h height of the area to copy in pixels
+ * @note `map_w - fill_w` is offset to the next line after copy
+ */
+LV_ATTRIBUTE_FAST_MEM void lv_gpu_esp32_copy(lv_color_t * buf, lv_coord_t buf_w, const lv_color_t * map,
+                                             lv_coord_t map_w, lv_coord_t copy_w, lv_coord_t copy_h)
+{
+    lv_coord_t y;
+    for(y = 0; y < copy_h; y++) {
+        copy_line(buf, map, copy_w);
+        buf += buf_w;
+        map += map_w;
+    }
+}
+
+/**
+ * Blend a map (RGB image with opacity) to a buffer. The result is the same as `lv_color_mix` gives.
+ * @param buf a buffer where `map` should be copied
+ * @param buf_w width of the buffer in pixels
+ * @param map an "image" to copy
+ * @param opa opacity of `map`
+ * @param map_w width of the map in pixels
+ * @param copy_w width of the area to copy in pixels (<= buf_w)
+ * @param copy_h height of the area to copy in pixels
+ * @note `map_w - fill_w` is offset to the next line after copy
+ */
+LV_ATTRIBUTE_FAST_MEM void lv_gpu_esp32_blend(lv_color_t * buf, lv_coord_t buf_w, const lv_color_t * map, lv_opa_t opa,
+                                              lv_coord_t map_w, lv_coord_t copy_w, lv_coord_t copy_h)
+{
+    lv_coord_t y;
+    for(y = 0; y < copy_h; y++) {
+        blend_line(buf, map, opa, copy_w);
+        buf += buf_w;
+        map += map_w;
+    }
+}
+
+/**
+ * Can be used as `gpu_fill_cb` in display driver
+ */
+LV_ATTRIBUTE_FAST_MEM void lv_gpu_esp32_fill_cb(lv_disp_drv_t * disp_drv, lv_color_t * dest_buf, lv_coord_t dest_width,
+                                                const lv_area_t * fill_area, lv_color_t color)
+{
+    LV_UNUSED(disp_drv);
+
+    dest_buf += dest_width * fill_area->y1 + fill_area->x1;
+    lv_gpu_esp32_fill(dest_buf, dest_width, color, lv_area_get_width(fill_area), lv_area_get_height(fill_area));
+}
+
+/**
+ * Can be used as `gpu_blend_cb` in display driver. Copies when `opa` is above `LV_OPA_MAX` as the software
+ * rendering does.
+ */
+LV_ATTRIBUTE_FAST_MEM void lv_gpu_esp32_blend_cb(lv_disp_drv_t * disp_drv, lv_color_t * dest, const lv_color_t * src,
+                                                 uint32_t length, lv_opa_t opa)
+{
+    LV_UNUSED(disp_drv);
+
+    if(opa > LV_OPA_MAX) copy_line(dest, src, length);
+    else blend_line(dest, src, opa, length);
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Swap the bytes of the two pixels of a word, between `LV_COLOR_16_SWAP` and plain RGB565
+ */
+static inline uint32_t swap2(uint32_t px2)
+{
+#if LV_COLOR_16_SWAP
+    return ((px2 >> 8) & LANES_8) | ((px2 << 8) & ~LANES_8);
+#else
+    return px2;
+#endif
+}
+
+/**
+ * Mix two pixels with two others as `lv_color_mix` does, with R, G and B of both pixels in the lanes of one word.
+ * So 3 multiplications per pixel pair and color instead of 3 per pixel.
+ * @param fg2 two foreground pixels
+ * @param bg2 two background pixels
+ * @param opa opacity of the foreground
+ * @param opa_inv 255 - opa
+ * @return the two mixed pixels
+ */
+LV_ATTRIBUTE_FAST_MEM static inline uint32_t mix2(uint32_t fg2, uint32_t bg2, uint32_t opa, uint32_t opa_inv)
+{
+    fg2 = swap2(fg2);
+    bg2 = swap2(bg2);
+
+    uint32_t r = ((fg2 >> 11) & LANES_5) * opa + ((bg2 >> 11) & LANES_5) * opa_inv + LANES_ROUND;
+    uint32_t g = ((fg2 >> 5) & LANES_6) * opa + ((bg2 >> 5) & LANES_6) * opa_inv + LANES_ROUND;
+    uint32_t b = (fg2 & LANES_5) * opa + (bg2 & LANES_5) * opa_inv + LANES_ROUND;
+
+    return swap2((LANES_UDIV255(r) << 11) | (LANES_UDIV255(g) << 5) | LANES_UDIV255(b));
+}
+
+/**
+ * Two pixels of a map which is not word aligned. Halfword loads, so nothing around the map is read.
+ */
+static inline uint32_t load2(const lv_color_t * px)
+{
+    return px[0].full | ((uint32_t)px[1].full << 16);
+}
+
+LV_ATTRIBUTE_FAST_MEM static void fill_line(lv_color_t * buf, lv_color_t color, int32_t w)
+{
+    if(((lv_uintptr_t)buf & 0x3) && w > 0) {
+        *buf++ = color;
+        w--;
+    }
+
+    uint32_t c32 = color.full | ((uint32_t)color.full << 16);
+    uint32_t * buf32 = (uint32_t *)buf;
+    for(; w >= 8; w -= 8) {
+        buf32[0] = c32;
+        buf32[1] = c32;
+        buf32[2] = c32;
+        buf32[3] = c32;
+        buf32 += 4;
+    }
+    for(; w >= 2; w -= 2) {
+        *buf32++ = c32;
+    }
+
+    if(w > 0) *((lv_color_t *)buf32) = color;
+}
+
+LV_ATTRIBUTE_FAST_MEM static void copy_line(lv_color_t * buf, const lv_color_t * map, int32_t w)
+{
+    if(((lv_uintptr_t)buf & 0x3) && w > 0) {
+        *buf++ = *map++;
+        w--;
+    }
+
+    uint32_t * buf32 = (uint32_t *)buf;
+    if(((lv_uintptr_t)map & 0x3) == 0) {
+        const uint32_t * map32 = (const uint32_t *)map;
+        for(; w >= 8; w -= 8) {
+            buf32[0] = map32[0];
+            buf32[1] = map32[1];
+            buf32[2] = map32[2];
+            buf32[3] = map32[3];
+            buf32 += 4;
+            map32 += 4;
+        }
+        for(; w >= 2; w -= 2) {
+            *buf32++ = *map32++;
+        }
+        map = (const lv_color_t *)map32;
+    }
+    else {
+        /*`_lv_memcpy` copies byte by byte here*/
+        for(; w >= 4; w -= 4) {
+            buf32[0] = load2(map);
+            buf32[1] = load2(map + 2);
+            buf32 += 2;
+            map += 4;
+        }
+        for(; w >= 2; w -= 2) {
+            *buf32++ = load2(map);
+            map += 2;
+        }
+    }
+
+    if(w > 0) *((lv_color_t *)buf32) = *map;
+}
+
+LV_ATTRIBUTE_FAST_MEM static void blend_line(lv_color_t * buf, const lv_color_t * map, lv_opa_t opa, int32_t w)
+{
+    uint32_t opa_inv = 255 - opa;
+
+    if(((lv_uintptr_t)buf & 0x3) && w > 0) {
+        buf->full = (uint16_t)mix2(map->full, buf->full, opa, opa_inv);
+        buf++;
+        map++;
+        w--;
+    }
+
+    uint32_t * buf32 = (uint32_t *)buf;
+    if(((lv_uintptr_t)map & 0x3) == 0) {
+        const uint32_t * map32 = (const uint32_t *)map;
+        for(; w >= 2; w -= 2) {
+            *buf32 = mix2(*map32, *buf32, opa, opa_inv);
+            buf32++;
+            map32++;
+        }
+        map = (const lv_color_t *)map32;
+    }
+    else {
+        for(; w >= 2; w -= 2) {
+            *buf32 = mix2(load2(map), *buf32, opa, opa_inv);
+            buf32++;
+            map += 2;
+        }
+    }
+
+    if(w > 0) {
+        buf = (lv_color_t *)buf32;
+        buf->full = (uint16_t)mix2(map->full, buf->full, opa, opa_inv);
+    }
+}
+
+#endif /*LV_USE_GPU_ESP32*/
@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+
+#include "core2forAWS.h"
+#include "display_test.h"
+
+#define BENCHMARK_FRAMES 30
+
+static const char *TAG = "DISPLAY";
+
+typedef struct {
+    display_buf_mem_t mem;
+    uint16_t lines;
+} buf_policy_t;
+
+/* The old setup (32 lines in SPIRAM) and the internal RAM stripes the driver now defaults to */
+static const buf_policy_t policies[] = {
+    { DISPLAY_BUF_SPIRAM, 32 },
+    { DISPLAY_BUF_SPIRAM, 20 },
+    { DISPLAY_BUF_INTERNAL, 20 },
+    { DISPLAY_BUF_INTERNAL, 40 },
+};
+
+/* Redraws bench_scr BENCHMARK_FRAMES times, returns the average redraw time in us. Holds xGuiSemaphore. */
+static int64_t redrawFrames(lv_disp_t *disp, lv_obj_t *bench_scr, int64_t *min, int64_t *max) {
+    int64_t start, elapsed, total = 0;
+
+    *min = INT64_MAX;
+    *max = 0;
+    for (int i = 0; i < BENCHMARK_FRAMES; i++) {
+        /* A different gradient every frame, so every pixel changes */
+        lv_obj_set_style_local_bg_color(bench_scr, LV_OBJ_PART_MAIN, LV_STATE_DEFAULT, lv_color_hsv_to_rgb(i * 12, 100, 100));
+        lv_obj_set_style_local_bg_grad_color(bench_scr, LV_OBJ_PART_MAIN, LV_STATE_DEFAULT, lv_color_hsv_to_rgb(i * 12 + 180, 100, 50));
+        lv_obj_invalidate(bench_scr);
+
+        start = esp_timer_get_time();
+        lv_refr_now(disp);
+        /* The last stripe is still on its way to the display */
+        while (lv_disp_get_buf(disp)->flushing) {
+            taskYIELD();
+        }
+        elapsed = esp_timer_get_time() - start;
+
+        total += elapsed;
+        *min = elapsed < *min ? elapsed : *min;
+        *max = elapsed > *max ? elapsed : *max;
+    }
+    return total / BENCHMARK_FRAMES;
+}
+
+/*
+ * Redraws the whole screen BENCHMARK_FRAMES times with each of the draw buffer policies and shows the
+ * redraw time, the FPS it allows and the internal RAM left, then goes back to the previous buffers and screen.
+ * The flush timings of the display driver are logged for each policy.
+ */
+void displayBenchmark() {
+    char label_stash[400];
+    int len;
+    int64_t avg, min, max;
+    disp_driver_stats_t stats;
+    display_buf_mem_t prev_mem, mem;
+    uint16_t prev_lines, lines;
+
+    xSemaphoreTake(xGuiSemaphore, portMAX_DELAY);
+
+    lv_disp_t *disp = lv_disp_get_default();
+    lv_obj_t *prev_scr = lv_scr_act();
+    lv_obj_t *bench_scr = lv_obj_create(NULL, NULL);
+    lv_scr_load(bench_scr);
+
+    lv_obj_set_style_local_bg_grad_dir(bench_scr, LV_OBJ_PART_MAIN, LV_STATE_DEFAULT, LV_GRAD_DIR_VER);
+    lv_obj_t *result_label = lv_label_create(bench_scr, NULL);
+    lv_obj_set_pos(result_label, 10, 10);
+    lv_label_set_text(result_label, "Display benchmark");
+    lv_refr_now(disp);
+
+    xSemaphoreGive(xGuiSemaphore);
+
+    Core2ForAWS_Display_GetBuffers(&prev_mem, &prev_lines);
+    len = sprintf(label_stash, "Full screen redraw, internal RAM free\n");
+    for (int p = 0; p < sizeof(policies) / sizeof(policies[0]); p++) {
+        Core2ForAWS_Display_SetBuffers(policies[p].mem, policies[p].lines);
+        /* With the fallback the buffers may not be where they were asked for */
+        Core2ForAWS_Display_GetBuffers(&mem, &lines);
+
+        xSemaphoreTake(xGuiSemaphore, portMAX_DELAY);
+        disp_driver_reset_stats();
+        avg = redrawFrames(disp, bench_scr, &min, &max);
+        disp_driver_get_stats(&stats);
+        xSemaphoreGive(xGuiSemaphore);
+
+        ESP_LOGI(TAG, "%s %u lines: %.2f ms (%.2f - %.2f), %u flushes per frame, flush latency %u us avg, %u us max, "
+                 "%u us per frame in flush callback, %u bytes internal RAM free, %u largest block",
+                 mem == DISPLAY_BUF_INTERNAL ? "Internal" : "SPIRAM", lines, avg / 1000.0, min / 1000.0, max / 1000.0,
+                 stats.flushes / BENCHMARK_FRAMES, stats.flushes ? (uint32_t) (stats.flush_latency_us / stats.flushes) : 0,
+                 stats.max_latency_us, (uint32_t) (stats.flush_cb_us / BENCHMARK_FRAMES),
+                 heap_caps_get_free_size(MALLOC_CAP_INTERNAL), heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL));
+        len += sprintf(label_stash + len, "%s %u lines: %.1f ms, %.1f FPS, %u KB\n",
+                       mem == DISPLAY_BUF_INTERNAL ? "Internal" : "SPIRAM", lines, avg / 1000.0, 1000000.0 / avg,
+                       heap_caps_get_free_size(MALLOC_CAP_INTERNAL) / 1024);
+    }
+    Core2ForAWS_Display_SetBuffers(prev_mem, prev_lines);
+
+    xSemaphoreTake(xGuiSemaphore, portMAX_DELAY);
+    lv_label_set_text(result_label, label_stash);
+    xSemaphoreGive(xGuiSemaphore);
+
+    vTaskDelay(pdMS_TO_TICKS(5000));
+
+    xSemaphoreTake(xGuiSemaphore, portMAX_DELAY);
+    lv_scr_load(prev_scr);
+    lv_obj_del(bench_scr);
+    xSemaphoreGive(xGuiSemaphore);
+}
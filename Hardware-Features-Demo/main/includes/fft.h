@@ -37,6 +37,8 @@
 #ifndef __FFT_H__
 #define __FFT_H__
 
+#include <stdint.h>
+
 typedef enum
 {
   FFT_REAL,
@@ -51,6 +53,10 @@ typedef enum
 
 #define FFT_OWN_INPUT_MEM 1
 #define FFT_OWN_OUTPUT_MEM 2
+#define SPECTRUM_OWN_WINDOW_MEM 4
+#define SPECTRUM_OWN_MAGNITUDE_MEM 8
+
+#define Q15_ONE 32767
 
 typedef struct
 {
@@ -63,9 +69,48 @@ typedef struct
   unsigned int flags; // FFT flags
 } fft_config_t;
 
+typedef struct
+{
+  int size;  // FFT size (number of real samples)
+  int16_t *buffer;  // packed work/output buffer of size int16 values
+  int16_t *twiddle_factors;  // Q15 twiddle factors, size / 2 complex values
+  uint16_t *bitrev;  // bit reversal permutation of the size / 2 point complex FFT
+} fft_q15_config_t;
+
+typedef enum
+{
+  SPECTRUM_WINDOW_NONE,
+  SPECTRUM_WINDOW_HANN
+} spectrum_window_t;
+
+typedef enum
+{
+  SPECTRUM_BACKEND_FLOAT,  // float split-radix FFT
+  SPECTRUM_BACKEND_Q15     // Q15 fixed-point packed real FFT
+} spectrum_backend_t;
+
+typedef struct
+{
+  int size;  // FFT size
+  spectrum_backend_t backend;  // transform used by spectrum_process
+  fft_config_t *plan;  // float real forward FFT plan, NULL for the Q15 backend
+  fft_q15_config_t *plan_q15;  // Q15 real FFT plan, NULL for the float backend
+  float *window;  // float backend: per-sample gain (window coefficient times input scale), NULL if rectangular
+  int16_t *window_q15;  // Q15 backend: window coefficients, NULL if rectangular
+  float scale;  // gain applied to each PCM sample
+  float *magnitude;  // pointer to buffer holding size / 2 magnitude bins
+  unsigned int flags; // spectrum flags
+} spectrum_config_t;
+
 fft_config_t *fft_init(int size, fft_type_t type, fft_direction_t direction, float *input, float *output);
 void fft_destroy(fft_config_t *config);
 void fft_execute(fft_config_t *config);
+fft_q15_config_t *fft_q15_init(int size);
+void fft_q15_destroy(fft_q15_config_t *config);
+void rfft_q15(fft_q15_config_t *config, const int16_t *x, const int16_t *window);
+spectrum_config_t *spectrum_init(int size, spectrum_backend_t backend, spectrum_window_t window, float scale, float *input, float *output, float *magnitude);
+void spectrum_destroy(spectrum_config_t *spectrum);
+void spectrum_process(spectrum_config_t *spectrum, const int16_t *pcm);
 void fft(float *input, float *output, float *twiddle_factors, int n);
 void ifft(float *input, float *output, float *twiddle_factors, int n);
 void rfft(float *x, float *y, float *twiddle_factors, int n);
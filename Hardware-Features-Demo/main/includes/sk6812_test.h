@@ -4,3 +4,4 @@ void sk6812Test();
 void sk6812ShowTask(void *arg);
 void sk6812TaskSuspend();
 void sk6812TaskResume();
+void sk6812Benchmark();
@@ -16,6 +16,7 @@
 #include "atecc608_test.h"
 #include "sk6812_test.h"
 #include "mic_fft_test.h"
+#include "display_test.h"
 
 static void brightness_slider_event_cb(lv_obj_t * slider, lv_event_t event);
 static void strength_slider_event_cb(lv_obj_t * slider, lv_event_t event);
@@ -136,9 +137,11 @@ void app_main(void)
 
         if (Button_WasPressed(button_left)) {
             printf("button left press\r\n");
+            displayBenchmark();
         }
         if (Button_WasReleased(button_middle)) {
             printf("button middle release\r\n");
+            sk6812Benchmark();
         }
         if (Button_WasLongPress(button_right, 500)) {
             printf("button right long pressed\r\n");
@@ -1,12 +1,26 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
 #include "core2forAWS.h"
 #include "sk6812_test.h"
 
+/* Benchmark strip on Port B, it does not need to be connected */
+#define BENCHMARK_GPIO GPIO_NUM_26
+#define BENCHMARK_CHANNEL RMT_CHANNEL_1
+#define BENCHMARK_MAX_PIXELS 300
+#define BENCHMARK_FRAMES 100
+#define BENCHMARK_FPS 100
+
+static const char *TAG = "SK6812";
+
 static xSemaphoreHandle lock;
 static uint8_t stop_show = true;
 
+static uint8_t benchmark_pixels[BENCHMARK_MAX_PIXELS * 3];
+static uint32_t benchmark_palette[64];
+
 void sk6812Test() {
     lock = xSemaphoreCreateMutex();
     xTaskCreatePinnedToCore(sk6812ShowTask, "sk6812ShowTask", 4096*2, NULL, 1, NULL, 1);
@@ -66,3 +80,56 @@ void sk6812TaskResume() {
     stop_show = false;    
     xSemaphoreGive(lock);
 }
+
+/* Moves the palette along the strip, one pixel per frame */
+static bool benchmarkFrame(pixel_settings_t *px, uint32_t frame, void *arg) {
+    if (frame == BENCHMARK_FRAMES) {
+        xSemaphoreGive((xSemaphoreHandle) arg);
+        return false;
+    }
+    for (uint16_t i = 0; i < px->pixel_count; i++) {
+        np_set_pixel_color(px, i, benchmark_palette[(i + frame) % 64] << 8);
+    }
+    return true;
+}
+
+/*
+ * Shows BENCHMARK_FRAMES frames of a 10 and a 300 pixel strip at BENCHMARK_FPS with the animation task
+ * and logs the CPU time of np_show() and of the RMT translator per frame.
+ * The driver counts the time of all strips, so switch the LED bar off first.
+ */
+void sk6812Benchmark() {
+    const uint16_t counts[] = { 10, BENCHMARK_MAX_PIXELS };
+    xSemaphoreHandle done = xSemaphoreCreateBinary();
+    pixel_settings_t strip = {
+        .pixels = benchmark_pixels,
+        .timings = { .t0h = 350, .t0l = 800, .t1h = 600, .t1l = 700, .reset = 80000 },
+        .brightness = 20,
+        .color_order = "GRBW",
+        .nbits = 24,
+    };
+    np_stats_t stats;
+
+    for (uint8_t i = 0; i < 64; i++) {
+        benchmark_palette[i] = hsb_to_rgb(i * 360.0 / 64, 1.0, 1.0);
+    }
+
+    neopixel_init(BENCHMARK_GPIO, BENCHMARK_CHANNEL);
+    for (uint8_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        strip.pixel_count = counts[c];
+        np_enable_stats(true);
+        int64_t start = esp_timer_get_time();
+        np_animation_start(&strip, BENCHMARK_CHANNEL, BENCHMARK_FPS, benchmarkFrame, done);
+        xSemaphoreTake(done, portMAX_DELAY);
+        np_animation_stop();
+        int64_t elapsed = esp_timer_get_time() - start;
+        np_get_stats(&stats);
+        np_enable_stats(false);
+
+        ESP_LOGI(TAG, "%u pixels: np_show %u us, RMT translator %u us in %u calls per frame, %.1f FPS",
+                 counts[c], (unsigned) (stats.show_us / stats.frames), (unsigned) (stats.isr_us / stats.frames),
+                 (unsigned) (stats.isr_calls / stats.frames), stats.frames * 1000000.0 / elapsed);
+    }
+    neopixel_deinit(BENCHMARK_CHANNEL);
+    vSemaphoreDelete(done);
+}
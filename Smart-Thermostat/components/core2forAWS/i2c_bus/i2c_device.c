@@ -1,9 +1,15 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
 
 #include "driver/i2c.h"
 #include "esp_log.h"
 #include "esp_err.h"
+#include "esp_timer.h"
+
+#include "stdio.h"
+#include "string.h"
 
 #include "i2c_device.h"
 
@@ -30,6 +36,16 @@
 #define I2C_TIMEOUT_MS (100) // 1000ms
 #define MAX_DEVICE_NUMBER 24
 
+// Runs the transfers, above the touch and IMU tasks so they get their data soon after asking
+#define I2C_MANAGER_TASK_PRIORITY (5)
+#define I2C_MANAGER_TASK_STACK (3 * 1024)
+
+// Most transfers to one device run in one bus hold, so the next device is not kept waiting
+#define I2C_MANAGER_BATCH_MAX (8)
+
+// Tasks blocked in a read or write at the same time, each waits on one of these
+#define I2C_DONE_POOL_SIZE (8)
+
 typedef struct _i2c_port_obj_t {
     i2c_port_t port;
     gpio_num_t scl;
@@ -40,14 +56,32 @@ typedef struct _i2c_port_obj_t {
 typedef struct _i2c_device_t {
     i2c_port_obj_t* i2c_port;
     uint8_t addr;
+    i2c_device_priority_t priority;
+    i2c_device_stats_t stats;
 } i2c_device_t;
 
+typedef struct _i2c_manager_t {
+    TaskHandle_t task;
+    portMUX_TYPE lock;
+    I2CTransaction_t *head[I2C_DEVICE_PRIORITY_MAX];
+    I2CTransaction_t *tail[I2C_DEVICE_PRIORITY_MAX];
+} i2c_manager_t;
+
 static SemaphoreHandle_t i2c_mutex[I2C_NUM_MAX];
 static i2c_port_obj_t *i2c_port_used[2] = { NULL, NULL };
+static i2c_manager_t i2c_manager[I2C_NUM_MAX] = {
+    { .lock = portMUX_INITIALIZER_UNLOCKED },
+    { .lock = portMUX_INITIALIZER_UNLOCKED },
+};
+static QueueHandle_t i2c_done_pool;
+static i2c_device_t *i2c_devices[MAX_DEVICE_NUMBER];
+
+static void i2c_manager_task(void *arg);
+static esp_err_t i2c_device_transfer(I2CDevice_t i2c_device, i2c_device_op_t op, uint8_t reg_addr, uint8_t *data, uint16_t length);
 
 I2CDevice_t i2c_malloc_device(i2c_port_t i2c_num, gpio_num_t sda, gpio_num_t scl, uint32_t freq, uint8_t device_addr) {
-    if (i2c_num > I2C_NUM_MAX) {
-        i2c_num = I2C_NUM_MAX;
+    if (i2c_num >= I2C_NUM_MAX) {
+        i2c_num = I2C_NUM_MAX - 1;
     }
 
     if (i2c_mutex[0] == NULL) {
@@ -58,6 +92,19 @@ I2CDevice_t i2c_malloc_device(i2c_port_t i2c_num, gpio_num_t sda, gpio_num_t scl
         i2c_mutex[1] = xSemaphoreCreateRecursiveMutex(); 
     }
 
+    if (i2c_done_pool == NULL) {
+        i2c_done_pool = xQueueCreate(I2C_DONE_POOL_SIZE, sizeof(SemaphoreHandle_t));
+        for (uint8_t i = 0; i < I2C_DONE_POOL_SIZE; i++) {
+            SemaphoreHandle_t done = xSemaphoreCreateBinary();
+            xQueueSend(i2c_done_pool, &done, 0);
+        }
+    }
+
+    if (i2c_manager[i2c_num].task == NULL) {
+        xTaskCreatePinnedToCore(i2c_manager_task, "I2CManager", I2C_MANAGER_TASK_STACK, (void *)(intptr_t)i2c_num,
+                                I2C_MANAGER_TASK_PRIORITY, &i2c_manager[i2c_num].task, tskNO_AFFINITY);
+    }
+
     i2c_port_obj_t* new_device_port = (i2c_port_obj_t *)malloc(sizeof(i2c_port_obj_t));
     if (new_device_port == NULL) {
         return NULL;
@@ -75,6 +122,14 @@ I2CDevice_t i2c_malloc_device(i2c_port_t i2c_num, gpio_num_t sda, gpio_num_t scl
 
     device->i2c_port = new_device_port;
     device->addr = device_addr;
+    device->priority = I2C_DEVICE_PRIORITY_NORMAL;
+    memset(&device->stats, 0, sizeof(device->stats));
+    for (uint8_t i = 0; i < MAX_DEVICE_NUMBER; i++) {
+        if (i2c_devices[i] == NULL) {
+            i2c_devices[i] = device;
+            break;
+        }
+    }
     log_i("New device malloc, scl: %d, sda: %d, freq: %d HZ",
         device->i2c_port->scl, device->i2c_port->sda, device->i2c_port->freq);
 
@@ -85,6 +140,11 @@ void i2c_free_device(I2CDevice_t i2c_device) {
     if (i2c_device == NULL) {
         return ;
     }
+    for (uint8_t i = 0; i < MAX_DEVICE_NUMBER; i++) {
+        if (i2c_devices[i] == i2c_device) {
+            i2c_devices[i] = NULL;
+        }
+    }
     free(((i2c_device_t *)i2c_device)->i2c_port);
     free(i2c_device);
 }
@@ -160,13 +220,7 @@ void i2c_free_bus(I2CDevice_t i2c_device) {
     xSemaphoreGiveRecursive(i2c_mutex[device->i2c_port->port]);
 }
 
-esp_err_t i2c_read_bytes(I2CDevice_t i2c_device, uint8_t reg_addr, uint8_t *data, uint16_t length) {
-    if (i2c_device == NULL || (length > 0 && data == NULL)) {
-        return ESP_FAIL;
-    }
-
-    i2c_device_t* device = (i2c_device_t *)i2c_device;
-
+static esp_err_t i2c_device_read(i2c_device_t *device, uint8_t reg_addr, uint8_t *data, uint16_t length) {
     i2c_cmd_handle_t write_cmd = i2c_cmd_link_create();
     i2c_master_start(write_cmd);
     i2c_master_write_byte(write_cmd, (device->addr << 1) | I2C_MASTER_WRITE, 1);
@@ -184,14 +238,11 @@ esp_err_t i2c_read_bytes(I2CDevice_t i2c_device, uint8_t reg_addr, uint8_t *data
     }
     i2c_master_stop(read_cmd);
 
-
-    i2c_apply_bus(i2c_device);
     esp_err_t err = ESP_FAIL;
     err = i2c_master_cmd_begin(device->i2c_port->port, write_cmd, pdMS_TO_TICKS(I2C_TIMEOUT_MS));
     if (err == ESP_OK && length > 0) {
         err = i2c_master_cmd_begin(device->i2c_port->port, read_cmd, pdMS_TO_TICKS(I2C_TIMEOUT_MS));
     }
-    i2c_free_bus(i2c_device);
 
     i2c_cmd_link_delete(write_cmd);
     i2c_cmd_link_delete(read_cmd);
@@ -206,13 +257,7 @@ esp_err_t i2c_read_bytes(I2CDevice_t i2c_device, uint8_t reg_addr, uint8_t *data
     return err;
 }
 
-esp_err_t i2c_read_bytes_no_stop(I2CDevice_t i2c_device, uint8_t reg_addr, uint8_t *data, uint16_t length) {
-    if (i2c_device == NULL || (length > 0 && data == NULL)) {
-        return ESP_FAIL;
-    }
-
-    i2c_device_t* device = (i2c_device_t *)i2c_device;
-
+static esp_err_t i2c_device_read_no_stop(i2c_device_t *device, uint8_t reg_addr, uint8_t *data, uint16_t length) {
     i2c_cmd_handle_t write_cmd = i2c_cmd_link_create();
     i2c_master_start(write_cmd);
     i2c_master_write_byte(write_cmd, (device->addr << 1) | I2C_MASTER_WRITE, 1);
@@ -227,11 +272,8 @@ esp_err_t i2c_read_bytes_no_stop(I2CDevice_t i2c_device, uint8_t reg_addr, uint8
     }
     i2c_master_stop(write_cmd);
 
-
-    i2c_apply_bus(i2c_device);
     esp_err_t err = ESP_FAIL;
     err = i2c_master_cmd_begin(device->i2c_port->port, write_cmd, pdMS_TO_TICKS(I2C_TIMEOUT_MS));
-    i2c_free_bus(i2c_device);
 
     i2c_cmd_link_delete(write_cmd);
 
@@ -245,6 +287,14 @@ esp_err_t i2c_read_bytes_no_stop(I2CDevice_t i2c_device, uint8_t reg_addr, uint8
     return err;
 }
 
+esp_err_t i2c_read_bytes(I2CDevice_t i2c_device, uint8_t reg_addr, uint8_t *data, uint16_t length) {
+    return i2c_device_transfer(i2c_device, I2C_DEVICE_OP_READ, reg_addr, data, length);
+}
+
+esp_err_t i2c_read_bytes_no_stop(I2CDevice_t i2c_device, uint8_t reg_addr, uint8_t *data, uint16_t length) {
+    return i2c_device_transfer(i2c_device, I2C_DEVICE_OP_READ_NO_STOP, reg_addr, data, length);
+}
+
 esp_err_t i2c_read_byte(I2CDevice_t i2c_device, uint8_t reg_addr, uint8_t* data) {
     return i2c_read_bytes(i2c_device, reg_addr, data, 1);
 }
@@ -283,13 +333,7 @@ esp_err_t i2c_read_bits(I2CDevice_t i2c_device, uint8_t reg_addr, uint8_t *data,
     return ESP_OK;
 }
 
-esp_err_t i2c_write_bytes(I2CDevice_t i2c_device, uint8_t reg_addr, uint8_t *data, uint16_t length) {
-    if (i2c_device == NULL || (length > 0 && data == NULL)) {
-        return ESP_FAIL;
-    }
-
-    i2c_device_t* device = (i2c_device_t *)i2c_device;
-
+static esp_err_t i2c_device_write(i2c_device_t *device, uint8_t reg_addr, uint8_t *data, uint16_t length) {
     i2c_cmd_handle_t write_cmd = i2c_cmd_link_create();
     i2c_master_start(write_cmd);
     i2c_master_write_byte(write_cmd, (device->addr << 1) | I2C_MASTER_WRITE, 1);
@@ -300,10 +344,7 @@ esp_err_t i2c_write_bytes(I2CDevice_t i2c_device, uint8_t reg_addr, uint8_t *dat
     i2c_master_stop(write_cmd);
 
     esp_err_t err = ESP_FAIL;
-
-    i2c_apply_bus(i2c_device);
     err = i2c_master_cmd_begin(device->i2c_port->port, write_cmd, pdMS_TO_TICKS(I2C_TIMEOUT_MS));
-    i2c_free_bus(i2c_device);
 
     i2c_cmd_link_delete(write_cmd);
 
@@ -317,6 +358,10 @@ esp_err_t i2c_write_bytes(I2CDevice_t i2c_device, uint8_t reg_addr, uint8_t *dat
     return err;
 }
 
+esp_err_t i2c_write_bytes(I2CDevice_t i2c_device, uint8_t reg_addr, uint8_t *data, uint16_t length) {
+    return i2c_device_transfer(i2c_device, I2C_DEVICE_OP_WRITE, reg_addr, data, length);
+}
+
 esp_err_t i2c_write_byte(I2CDevice_t i2c_device, uint8_t reg_addr, uint8_t data) {
     return i2c_write_bytes(i2c_device, reg_addr, &data, 1);
 }
@@ -373,23 +418,230 @@ esp_err_t i2c_device_change_freq(I2CDevice_t i2c_device, uint32_t freq) {
 }
 
 esp_err_t i2c_device_valid(I2CDevice_t i2c_device) {
-    if (i2c_device == NULL ) {
-        return ESP_FAIL;
-    }
-
-    i2c_device_t* device = (i2c_device_t *)i2c_device;
+    return i2c_device_transfer(i2c_device, I2C_DEVICE_OP_PROBE, 0, NULL, 0);
+}
 
+static esp_err_t i2c_device_probe(i2c_device_t *device) {
     i2c_cmd_handle_t write_cmd = i2c_cmd_link_create();
     i2c_master_start(write_cmd);
     i2c_master_write_byte(write_cmd, (device->addr << 1) | I2C_MASTER_WRITE, 1);
     i2c_master_stop(write_cmd);
 
     esp_err_t err = ESP_FAIL;
-
-    i2c_apply_bus(i2c_device);
     err = i2c_master_cmd_begin(device->i2c_port->port, write_cmd, pdMS_TO_TICKS(I2C_TIMEOUT_MS));
-    i2c_free_bus(i2c_device);
 
     i2c_cmd_link_delete(write_cmd);
     return err;
-}
\ No newline at end of file
+}
+
+static uint8_t i2c_latency_bucket(uint32_t latency_us) {
+    uint8_t bucket = 0;
+    latency_us >>= 7;
+    while (latency_us > 0 && bucket < I2C_LATENCY_BUCKETS - 1) {
+        latency_us >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+// Runs one transfer with the bus already applied, then hands it back
+static void i2c_execute(I2CTransaction_t *trans) {
+    i2c_device_t* device = (i2c_device_t *)trans->device;
+    esp_err_t err = ESP_FAIL;
+
+    switch (trans->op) {
+        case I2C_DEVICE_OP_WRITE:
+            err = i2c_device_write(device, trans->reg_addr, trans->data, trans->length);
+            break;
+        case I2C_DEVICE_OP_READ:
+            err = i2c_device_read(device, trans->reg_addr, trans->data, trans->length);
+            break;
+        case I2C_DEVICE_OP_READ_NO_STOP:
+            err = i2c_device_read_no_stop(device, trans->reg_addr, trans->data, trans->length);
+            break;
+        case I2C_DEVICE_OP_PROBE:
+            err = i2c_device_probe(device);
+            break;
+    }
+
+    uint32_t latency_us = esp_timer_get_time() - trans->submit_us;
+    device->stats.count++;
+    device->stats.total_us += latency_us;
+    if (latency_us > device->stats.max_us) {
+        device->stats.max_us = latency_us;
+    }
+    device->stats.latency[i2c_latency_bucket(latency_us)]++;
+
+    // The transaction may be gone once the owner knows it is done
+    trans->err = err;
+    if (trans->cb != NULL) {
+        trans->cb(trans, err, trans->arg);
+    } else if (trans->done != NULL) {
+        xSemaphoreGive(trans->done);
+    }
+}
+
+// Highest priority transaction, or the next one only if it is for `device` when one is given
+static I2CTransaction_t *i2c_manager_pop(i2c_manager_t *manager, I2CDevice_t device) {
+    I2CTransaction_t *trans = NULL;
+
+    portENTER_CRITICAL(&manager->lock);
+    for (int8_t priority = I2C_DEVICE_PRIORITY_MAX - 1; priority >= 0; priority--) {
+        trans = manager->head[priority];
+        if (trans == NULL) {
+            continue;
+        }
+        if (device != NULL && trans->device != device) {
+            trans = NULL;
+            break;
+        }
+        manager->head[priority] = trans->next;
+        if (manager->head[priority] == NULL) {
+            manager->tail[priority] = NULL;
+        }
+        break;
+    }
+    portEXIT_CRITICAL(&manager->lock);
+    return trans;
+}
+
+static void i2c_manager_task(void *arg) {
+    i2c_manager_t *manager = &i2c_manager[(intptr_t)arg];
+
+    for (;;) {
+        I2CTransaction_t *trans = i2c_manager_pop(manager, NULL);
+        if (trans == NULL) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+
+        I2CDevice_t device = trans->device;
+        uint8_t batch = 0;
+        i2c_apply_bus(device);
+        do {
+            i2c_execute(trans);
+            batch++;
+        } while (batch < I2C_MANAGER_BATCH_MAX && (trans = i2c_manager_pop(manager, device)) != NULL);
+        i2c_free_bus(device);
+    }
+}
+
+esp_err_t i2c_submit(I2CTransaction_t *trans) {
+    if (trans == NULL || trans->device == NULL || (trans->length > 0 && trans->data == NULL) || 
+        trans->priority >= I2C_DEVICE_PRIORITY_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    i2c_device_t* device = (i2c_device_t *)trans->device;
+    i2c_manager_t *manager = &i2c_manager[device->i2c_port->port];
+    if (manager->task == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    trans->submit_us = esp_timer_get_time();
+    trans->err = ESP_ERR_TIMEOUT;
+    trans->next = NULL;
+
+    portENTER_CRITICAL(&manager->lock);
+    if (manager->tail[trans->priority] == NULL) {
+        manager->head[trans->priority] = trans;
+    } else {
+        manager->tail[trans->priority]->next = trans;
+    }
+    manager->tail[trans->priority] = trans;
+    portEXIT_CRITICAL(&manager->lock);
+
+    xTaskNotifyGive(manager->task);
+    return ESP_OK;
+}
+
+/*
+    Blocking transfer through the manager task. Runs right away when the
+    calling task already holds the port, it would wait for itself otherwise.
+*/
+static esp_err_t i2c_device_transfer(I2CDevice_t i2c_device, i2c_device_op_t op, uint8_t reg_addr, uint8_t *data, uint16_t length) {
+    if (i2c_device == NULL || (length > 0 && data == NULL)) {
+        return ESP_FAIL;
+    }
+
+    i2c_device_t* device = (i2c_device_t *)i2c_device;
+    i2c_port_t port = device->i2c_port->port;
+    I2CTransaction_t trans = {
+        .device = i2c_device,
+        .op = op,
+        .reg_addr = reg_addr,
+        .data = data,
+        .length = length,
+        .priority = device->priority,
+    };
+
+    TaskHandle_t current = xTaskGetCurrentTaskHandle();
+    if (current == i2c_manager[port].task || xSemaphoreGetMutexHolder(i2c_mutex[port]) == current) {
+        trans.submit_us = esp_timer_get_time();
+        i2c_apply_bus(i2c_device);
+        i2c_execute(&trans);
+        i2c_free_bus(i2c_device);
+        return trans.err;
+    }
+
+    xQueueReceive(i2c_done_pool, &trans.done, portMAX_DELAY);
+    esp_err_t err = i2c_submit(&trans);
+    if (err == ESP_OK) {
+        xSemaphoreTake(trans.done, portMAX_DELAY);
+        err = trans.err;
+    }
+    xQueueSend(i2c_done_pool, &trans.done, 0);
+    return err;
+}
+
+void i2c_device_set_priority(I2CDevice_t i2c_device, i2c_device_priority_t priority) {
+    if (i2c_device == NULL || priority >= I2C_DEVICE_PRIORITY_MAX) {
+        return ;
+    }
+    ((i2c_device_t *)i2c_device)->priority = priority;
+}
+
+void i2c_device_get_stats(I2CDevice_t i2c_device, i2c_device_stats_t *stats) {
+    if (i2c_device == NULL || stats == NULL) {
+        return ;
+    }
+    i2c_device_t* device = (i2c_device_t *)i2c_device;
+    xSemaphoreTakeRecursive(i2c_mutex[device->i2c_port->port], portMAX_DELAY);
+    *stats = device->stats;
+    xSemaphoreGiveRecursive(i2c_mutex[device->i2c_port->port]);
+}
+
+void i2c_port_reset_stats(i2c_port_t i2c_num) {
+    if (i2c_num >= I2C_NUM_MAX || i2c_mutex[i2c_num] == NULL) {
+        return ;
+    }
+    xSemaphoreTakeRecursive(i2c_mutex[i2c_num], portMAX_DELAY);
+    for (uint8_t i = 0; i < MAX_DEVICE_NUMBER; i++) {
+        if (i2c_devices[i] != NULL && i2c_devices[i]->i2c_port->port == i2c_num) {
+            memset(&i2c_devices[i]->stats, 0, sizeof(i2c_devices[i]->stats));
+        }
+    }
+    xSemaphoreGiveRecursive(i2c_mutex[i2c_num]);
+}
+
+void i2c_port_log_stats(i2c_port_t i2c_num) {
+    i2c_device_stats_t stats;
+    char line[I2C_LATENCY_BUCKETS * 11 + 1];
+
+    if (i2c_num >= I2C_NUM_MAX) {
+        return ;
+    }
+    for (uint8_t i = 0; i < MAX_DEVICE_NUMBER; i++) {
+        if (i2c_devices[i] == NULL || i2c_devices[i]->i2c_port->port != i2c_num) {
+            continue;
+        }
+        i2c_device_get_stats(i2c_devices[i], &stats);
+        int length = 0;
+        for (uint8_t j = 0; j < I2C_LATENCY_BUCKETS; j++) {
+            length += snprintf(line + length, sizeof(line) - length, " %u", (unsigned)stats.latency[j]);
+        }
+        ESP_LOGI(TAG, "0x%02x: %u transfers, avg %uus, max %uus, latency 128us << n:%s", i2c_devices[i]->addr,
+                 (unsigned)stats.count, stats.count ? (unsigned)(stats.total_us / stats.count) : 0,
+                 (unsigned)stats.max_us, line);
+    }
+}
@@ -20,12 +20,23 @@ extern "C" {
 /*********************
  *      DEFINES
  *********************/
-#define DISP_BUF_SIZE  (LV_HOR_RES_MAX * 32)
+#define DISP_BUF_LINES      CONFIG_DISP_BUF_LINES
+#define DISP_BUF_MAX_LINES  64
+#define DISP_BUF_SIZE  (LV_HOR_RES_MAX * DISP_BUF_LINES)
 
 /**********************
  *      TYPEDEFS
  **********************/
 
+/* Flush timings since the last disp_driver_reset_stats */
+typedef struct {
+    uint32_t flushes;
+    uint32_t pixels;
+    uint64_t flush_cb_us;       /* Time spent in the flush callback, LVGL renders nothing meanwhile */
+    uint64_t flush_latency_us;  /* From the flush callback to lv_disp_flush_ready */
+    uint32_t max_latency_us;
+} disp_driver_stats_t;
+
 /**********************
  * GLOBAL PROTOTYPES
  **********************/
@@ -36,6 +47,13 @@ void disp_driver_init(void);
 /* Display flush callback */
 void disp_driver_flush(lv_disp_drv_t * drv, const lv_area_t * area, lv_color_t * color_map);
 
+/* Called when the last transaction of a flush is done, calls lv_disp_flush_ready */
+void disp_driver_flush_ready(lv_disp_drv_t * drv);
+
+/* Flush timings */
+void disp_driver_get_stats(disp_driver_stats_t * stats);
+void disp_driver_reset_stats(void);
+
 /**********************
  *      MACROS
  **********************/
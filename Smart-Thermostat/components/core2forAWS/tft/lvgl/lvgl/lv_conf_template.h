@@ -197,6 +197,9 @@ typedef void * lv_group_user_data_t;
 e.g. "stm32f769xx.h" or "stm32f429xx.h" */
 #define LV_GPU_DMA2D_CMSIS_INCLUDE
 
+/* 1: Use the word-at-a-time RGB565 kernels of lv_gpu_esp32 as `gpu_fill_cb` and `gpu_blend_cb` */
+#define LV_USE_GPU_ESP32        0
+
 /*1: Use PXP for CPU off-load on NXP RTxxx platforms */
 #define LV_USE_GPU_NXP_PXP      0
 
@@ -0,0 +1,219 @@
+/**
+ * @file lv_test_gpu_esp32.c
+ *
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "../../lvgl.h"
+#include "../../src/lv_draw/lv_draw_blend.h"
+#include "../../src/lv_gpu/lv_gpu_esp32.h"
+#include "../lv_test_assert.h"
+#include "lv_test_gpu_esp32.h"
+
+#if LV_BUILD_TEST
+#include <stdlib.h>
+#include <time.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+#define BENCH_ROUNDS    200
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+typedef enum {
+    DRAW_FILL,
+    DRAW_MAP,
+} draw_type_t;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+#if LV_COLOR_DEPTH == 16 && LV_USE_GPU_ESP32
+static void same_as_sw(void);
+static void benchmark(void);
+static void set_kernels(bool en);
+static void draw(draw_type_t type, const lv_area_t * area, lv_opa_t opa);
+static void fill_pattern(lv_color_t * buf, uint32_t px_num, uint32_t seed);
+static lv_opa_t rand_opa(uint32_t i);
+#endif
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+#if LV_COLOR_DEPTH == 16 && LV_USE_GPU_ESP32
+static lv_color_t map_buf[LV_HOR_RES_MAX * LV_VER_RES_MAX + 1];
+static lv_color_t ref_buf[LV_HOR_RES_MAX * LV_VER_RES_MAX];
+static lv_color_t fill_color;
+#endif
+
+/**********************
+ *      MACROS
+ **********************/
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+void lv_test_gpu_esp32(void)
+{
+#if LV_COLOR_DEPTH == 16 && LV_USE_GPU_ESP32
+    lv_test_print("");
+    lv_test_print("========================");
+    lv_test_print("Start lv_gpu_esp32 tests");
+    lv_test_print("========================");
+
+    lv_disp_t * disp = lv_disp_get_default();
+    lv_disp_buf_t * vdb = lv_disp_get_buf(disp);
+    lv_area_t area_save = vdb->area;
+    lv_disp_t * refr_save = _lv_refr_get_disp_refreshing();
+
+    /*Draw to the whole screen as the refresh would to a full size buffer*/
+    _lv_refr_set_disp_refreshing(disp);
+    lv_area_set(&vdb->area, 0, 0, LV_HOR_RES - 1, LV_VER_RES - 1);
+
+    same_as_sw();
+    benchmark();
+
+    set_kernels(false);
+    vdb->area = area_save;
+    _lv_refr_set_disp_refreshing(refr_save);
+#endif
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+#if LV_COLOR_DEPTH == 16 && LV_USE_GPU_ESP32
+
+static void same_as_sw(void)
+{
+    lv_test_print("");
+    lv_test_print("Fill and blend the same as the software rendering:");
+    lv_test_print("--------------------------------------------------");
+
+    lv_disp_buf_t * vdb = lv_disp_get_buf(lv_disp_get_default());
+    uint32_t px_num = LV_HOR_RES * LV_VER_RES;
+    uint32_t i;
+
+    srand(1234);
+    for(i = 0; i < 400; i++) {
+        /*Odd and even `x1`, widths and map offsets to try every alignment*/
+        lv_area_t area;
+        area.x1 = (rand() % LV_HOR_RES) - 8;
+        area.y1 = (rand() % LV_VER_RES) - 8;
+        area.x2 = area.x1 + (rand() % LV_HOR_RES);
+        area.y2 = area.y1 + (rand() % (LV_VER_RES / 2));
+
+        draw_type_t type = (i & 1) ? DRAW_MAP : DRAW_FILL;
+        lv_opa_t opa = rand_opa(i);
+        uint32_t seed = rand();
+        fill_color.full = rand() & 0xFFFF;
+        fill_pattern(map_buf, px_num + 1, seed);
+
+        fill_pattern(vdb->buf_act, px_num, ~seed);
+        set_kernels(false);
+        draw(type, &area, opa);
+        _lv_memcpy(ref_buf, vdb->buf_act, px_num * sizeof(lv_color_t));
+
+        fill_pattern(vdb->buf_act, px_num, ~seed);
+        set_kernels(true);
+        draw(type, &area, opa);
+
+        char s[64];
+        lv_snprintf(s, sizeof(s), "%s %d;%d %dx%d with opa %d", type == DRAW_MAP ? "Map" : "Fill",
+                    area.x1, area.y1, lv_area_get_width(&area), lv_area_get_height(&area), opa);
+        lv_test_assert_array_eq((const uint8_t *)ref_buf, (const uint8_t *)vdb->buf_act, px_num * sizeof(lv_color_t), s);
+    }
+}
+
+static void benchmark(void)
+{
+    lv_test_print("");
+    lv_test_print("Speed of the software rendering and the kernels (Mpx/s):");
+    lv_test_print("--------------------------------------------------------");
+
+    static const struct {
+        const char * name;
+        draw_type_t type;
+        lv_opa_t opa;
+    } cases[] = {
+        {"Fill", DRAW_FILL, LV_OPA_COVER},
+        {"Fill 50%", DRAW_FILL, LV_OPA_50},
+        {"Copy", DRAW_MAP, LV_OPA_COVER},
+        {"Blend 50%", DRAW_MAP, LV_OPA_50},
+    };
+
+    lv_area_t area;
+    lv_area_set(&area, 1, 0, LV_HOR_RES - 2, LV_VER_RES - 1);
+    fill_pattern(map_buf, LV_HOR_RES * LV_VER_RES, 1);
+    fill_color = LV_COLOR_MAKE(0x12, 0x34, 0x56);
+
+    uint32_t c;
+    for(c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        double mpx[2];
+        uint32_t k;
+        for(k = 0; k < 2; k++) {
+            set_kernels(k == 1);
+            clock_t t = clock();
+            uint32_t r;
+            for(r = 0; r < BENCH_ROUNDS; r++) {
+                draw(cases[c].type, &area, cases[c].opa);
+            }
+            double sec = (double)(clock() - t) / CLOCKS_PER_SEC;
+            if(sec <= 0.0) sec = 1e-9;
+            mpx[k] = (double)lv_area_get_size(&area) * BENCH_ROUNDS / sec / 1e6;
+        }
+        lv_test_print("%-10s software: %8.1f, kernels: %8.1f", cases[c].name, mpx[0], mpx[1]);
+    }
+}
+
+static void set_kernels(bool en)
+{
+    lv_disp_t * disp = lv_disp_get_default();
+    disp->driver.gpu_fill_cb = en ? lv_gpu_esp32_fill_cb : NULL;
+    disp->driver.gpu_blend_cb = en ? lv_gpu_esp32_blend_cb : NULL;
+}
+
+static void draw(draw_type_t type, const lv_area_t * area, lv_opa_t opa)
+{
+    lv_area_t clip;
+    lv_area_set(&clip, 0, 0, LV_HOR_RES - 1, LV_VER_RES - 1);
+
+    if(type == DRAW_FILL) {
+        _lv_blend_fill(&clip, area, fill_color, NULL, LV_DRAW_MASK_RES_FULL_COVER, opa, LV_BLEND_MODE_NORMAL);
+    }
+    else {
+        /*Start the map on a halfword for odd `opa`s to test the not word aligned case too*/
+        _lv_blend_map(&clip, area, map_buf + (opa & 1), NULL, LV_DRAW_MASK_RES_FULL_COVER, opa, LV_BLEND_MODE_NORMAL);
+    }
+}
+
+static void fill_pattern(lv_color_t * buf, uint32_t px_num, uint32_t seed)
+{
+    uint32_t i;
+    for(i = 0; i < px_num; i++) {
+        seed = seed * 1103515245 + 12345;
+        buf[i].full = seed >> 16;
+    }
+}
+
+static lv_opa_t rand_opa(uint32_t i)
+{
+    switch(i % 4) {
+        case 0:
+            return LV_OPA_COVER;
+        case 1:
+            return LV_OPA_50;
+        default:
+            return LV_OPA_MIN + rand() % (LV_OPA_COVER - LV_OPA_MIN + 1);
+    }
+}
+
+#endif /*LV_COLOR_DEPTH == 16 && LV_USE_GPU_ESP32*/
+
+#endif /*LV_BUILD_TEST*/
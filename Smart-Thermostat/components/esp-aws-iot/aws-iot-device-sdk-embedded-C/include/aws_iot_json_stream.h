@@ -0,0 +1,179 @@
+/*
+ * Copyright 2010-2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file aws_iot_json_stream.h
+ * @brief Incremental JSON tokenizer
+ *
+ * Tokenizes a JSON document that arrives in chunks, such as the fragments of an MQTT
+ * message larger than the MQTT receive buffer, and reports keys and values as events.
+ * Unlike jsmn, the document never needs to be in memory as a whole and no token array
+ * is needed. Tokens are reported in place, pointing into the chunk being fed, and only
+ * the ones that straddle two chunks are put together in small buffers of the parser.
+ *
+ */
+
+#ifndef AWS_IOT_SDK_SRC_JSON_STREAM_H_
+#define AWS_IOT_SDK_SRC_JSON_STREAM_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "aws_iot_error.h"
+#include "jsmn.h"
+
+/** Deepest nesting of objects and arrays the tokenizer accepts */
+#ifndef JSON_STREAM_MAX_DEPTH
+#define JSON_STREAM_MAX_DEPTH 16
+#endif
+
+/** Longest key that can still be reported when it straddles two chunks */
+#ifndef JSON_STREAM_MAX_KEY_LENGTH
+#define JSON_STREAM_MAX_KEY_LENGTH 64
+#endif
+
+/** Longest string or primitive value that can still be reported when it straddles two chunks */
+#ifndef JSON_STREAM_MAX_VALUE_LENGTH
+#define JSON_STREAM_MAX_VALUE_LENGTH 128
+#endif
+
+/**
+ * @brief Kind of a tokenizer event
+ */
+typedef enum {
+	JSON_STREAM_EVENT_VALUE,		///< A string or a primitive
+	JSON_STREAM_EVENT_OBJECT_START,	///< An object was opened
+	JSON_STREAM_EVENT_OBJECT_END,	///< An object was closed
+	JSON_STREAM_EVENT_ARRAY_START,	///< An array was opened
+	JSON_STREAM_EVENT_ARRAY_END		///< An array was closed
+} JsonStreamEventType_t;
+
+/**
+ * @brief Event reported by the tokenizer
+ *
+ * All pointers are only valid for the duration of the event handler.
+ */
+typedef struct {
+	JsonStreamEventType_t type;	///< What happened
+	jsmntype_t valueType;		///< Type of the value, as jsmn would report it
+	uint16_t depth;				///< Nesting level of the value, 0 for the top-level value
+	const char *pKey;			///< Key of the value inside an object. NULL in arrays, at the top level, on the END events or when the key was too long to put together
+	uint32_t keyLength;			///< Length of pKey
+	/**
+	 * Text of the value, strings without their quotes and with escapes left as they are, like jsmn does.
+	 * Strings and primitives are followed by a delimiter or a terminating null, so the parse functions of
+	 * aws_iot_json_utils.h can be used on them. On the END events this is the text of the whole object or
+	 * array if it started in the current chunk. NULL on the START events, when the value started in an
+	 * earlier chunk or when it was too long to put together.
+	 */
+	const char *pValue;
+	uint32_t valueLength;		///< Length of pValue
+} JsonStreamEvent_t;
+
+/**
+ * @brief Tokenizer event handler
+ *
+ * @param pEvent What was found in the document
+ * @param pUserData Data given to aws_iot_json_stream_init
+ */
+typedef void (*pJsonStreamEventHandler_t)(const JsonStreamEvent_t *pEvent, void *pUserData);
+
+/**
+ * @brief Lexer state of the tokenizer
+ */
+typedef enum {
+	JSON_STREAM_STATE_VALUE,		///< A value is expected
+	JSON_STREAM_STATE_KEY,			///< A key is expected
+	JSON_STREAM_STATE_COLON,		///< The colon after a key is expected
+	JSON_STREAM_STATE_NEXT,			///< A comma or the end of the enclosing object or array is expected
+	JSON_STREAM_STATE_STRING,		///< Inside a string
+	JSON_STREAM_STATE_PRIMITIVE,	///< Inside a primitive
+	JSON_STREAM_STATE_DONE,			///< The top-level value is complete
+	JSON_STREAM_STATE_ERROR			///< The document is not valid JSON
+} JsonStreamState_t;
+
+/**
+ * @brief Incremental JSON tokenizer
+ *
+ * The whole state needed to carry on from one chunk to the next. Use the functions below
+ * rather than the fields.
+ */
+typedef struct {
+	JsonStreamState_t state;
+	bool isContainerEmpty;
+	bool isStringKey;
+	bool isEscaped;
+	bool isTokenTruncated;
+	bool hasKey;
+	uint16_t depth;
+	uint8_t containerIsObject[(JSON_STREAM_MAX_DEPTH + 7) / 8];
+	const char *pContainerStart[JSON_STREAM_MAX_DEPTH];
+	const char *pTokenStart;
+	uint32_t spilledLength;
+	const char *pKey;
+	uint32_t keyLength;
+	char keyBuffer[JSON_STREAM_MAX_KEY_LENGTH + 1];
+	char valueBuffer[JSON_STREAM_MAX_VALUE_LENGTH + 1];
+	size_t bytesConsumed;
+	pJsonStreamEventHandler_t pEventHandler;
+	void *pUserData;
+} JsonStreamParser_t;
+
+/**
+ * @brief Initialize the tokenizer for a new document
+ *
+ * @param pParser Tokenizer
+ * @param pEventHandler Called for every value found in the document
+ * @param pUserData Passed to pEventHandler
+ *
+ * @return SUCCESS or NULL_VALUE_ERROR
+ */
+IoT_Error_t aws_iot_json_stream_init(JsonStreamParser_t *pParser, pJsonStreamEventHandler_t pEventHandler,
+									 void *pUserData);
+
+/**
+ * @brief Tokenize the next chunk of the document
+ *
+ * Events are reported from within this call. The chunk does not need to outlive it.
+ *
+ * @param pParser Tokenizer
+ * @param pChunk Next bytes of the document
+ * @param chunkLength Number of bytes in pChunk
+ *
+ * @return SUCCESS, NULL_VALUE_ERROR or JSON_PARSE_ERROR once the document turned out not to be valid
+ */
+IoT_Error_t aws_iot_json_stream_feed(JsonStreamParser_t *pParser, const char *pChunk, size_t chunkLength);
+
+/**
+ * @brief Signal the end of the document
+ *
+ * Reports a top-level primitive that was still waiting for a delimiter.
+ *
+ * @param pParser Tokenizer
+ *
+ * @return SUCCESS if a complete document was fed, JSON_PARSE_ERROR otherwise
+ */
+IoT_Error_t aws_iot_json_stream_finish(JsonStreamParser_t *pParser);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AWS_IOT_SDK_SRC_JSON_STREAM_H_ */
@@ -25,12 +25,30 @@ extern "C" {
 
 #include "aws_iot_error.h"
 #include "aws_iot_shadow_json_data.h"
+#include "jsmn.h"
 
 bool isJsonValidAndParse(const char *pJsonDocument, size_t jsonSize, void *pJsonHandler, int32_t *pTokenCount);
 
 bool isJsonKeyMatchingAndUpdateValue(const char *pJsonDocument, void *pJsonHandler, int32_t tokenCount,
 									 jsonStruct_t *pDataStruct, uint32_t *pDataLength, int32_t *pDataPosition);
 
+/* Returns the token index of the next key after tokenIndex (0 to start) in a document parsed by
+ * isJsonValidAndParse(), or -1 at the end. The contents of "metadata" objects are skipped. */
+int32_t findNextJsonKey(const char *pJsonDocument, void *pJsonHandler, int32_t tokenCount, int32_t tokenIndex,
+						const char **ppKey, uint32_t *pKeyLength);
+
+/* Returns the token index of the top-level "state" key in a document parsed by isJsonValidAndParse(), or -1 if
+ * there is none. *pStateEnd is set to the index of the first token after its value. */
+int32_t findJsonStateKey(const char *pJsonDocument, void *pJsonHandler, int32_t tokenCount, int32_t *pStateEnd);
+
+/* Updates pDataStruct from the value following the key at keyIndex, as returned by findNextJsonKey() */
+bool updateValueOfJsonKey(const char *pJsonDocument, void *pJsonHandler, int32_t tokenCount, int32_t keyIndex,
+						  jsonStruct_t *pDataStruct, uint32_t *pDataLength, int32_t *pDataPosition);
+
+/* Updates pDataStruct from a value found outside of a document parsed by isJsonValidAndParse(), such as
+ * one reported by the JSON stream tokenizer. pValue must be followed by a delimiter or a terminating null. */
+bool updateValueOfJsonText(const char *pValue, uint32_t valueLength, jsmntype_t valueType, jsonStruct_t *pDataStruct);
+
 IoT_Error_t aws_iot_shadow_internal_get_request_json(char *pBuffer, size_t bufferSize);
 
 IoT_Error_t aws_iot_shadow_internal_delete_request_json(char *pBuffer, size_t bufferSize);
@@ -0,0 +1,154 @@
+/*
+ * Copyright 2010-2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file aws_iot_shadow_reporter.h
+ * @brief Reports only the fields of a Thing Shadow that changed
+ *
+ * The reporter keeps the last value of every field the Shadow service acknowledged and only puts the
+ * fields that moved past their deadband in the next update. Fields can be held back for a minimum
+ * interval, and changes that come in while an update is in flight or within the minimum interval
+ * between updates are coalesced into a single update.
+ *
+ */
+
+#ifndef AWS_IOT_SDK_SRC_IOT_SHADOW_REPORTER_H_
+#define AWS_IOT_SDK_SRC_IOT_SHADOW_REPORTER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "aws_iot_error.h"
+#include "aws_iot_mqtt_client.h"
+#include "aws_iot_shadow_interface.h"
+
+/**
+ * @brief A reported field of the Thing Shadow
+ *
+ * Set pStruct, deadband and minIntervalMs, the other fields are kept by the reporter.
+ */
+typedef struct {
+	jsonStruct_t *pStruct;		///< Key, type and current value of the field. The value is read on every update
+	double deadband;			///< Numbers only. Changes from the acknowledged value up to this much are not reported, 0 reports any change
+	uint32_t minIntervalMs;		///< Shortest time between two reports of the field, 0 for none
+	bool isAcked;				///< A value of the field was acknowledged
+	bool isPending;				///< The field is in the update in flight
+	bool isSent;				///< The field was reported at least once, lastSentMs is valid
+	double ackedNumber;			///< Acknowledged value of a number or bool
+	uint32_t ackedHash;			///< Hash of the acknowledged value of a string or object
+	double pendingNumber;		///< Value of a number or bool in the update in flight
+	uint32_t pendingHash;		///< Hash of the value of a string or object in the update in flight
+	uint32_t lastSentMs;		///< When the field was last reported
+} ShadowReportedField_t;
+
+/**
+ * @brief Reporter of the fields of one Thing Shadow
+ *
+ * Use the functions below rather than the fields.
+ */
+typedef struct {
+	const char *pThingName;
+	ShadowReportedField_t *pFields;
+	size_t fieldCount;
+	uint32_t minUpdateIntervalMs;
+	uint8_t timeoutSec;
+	bool isUpdateInProgress;
+	bool hasSentUpdate;
+	uint32_t lastUpdateMs;
+	uint32_t updateCount;		///< Updates sent since init
+	uint32_t bytesSent;			///< JSON bytes sent since init
+} ShadowReporter_t;
+
+/**
+ * @brief Initialize a reporter
+ *
+ * No value is acknowledged yet, so the first update reports every field.
+ *
+ * @param pReporter Reporter to initialize
+ * @param pThingName Thing Name of the shadow, must outlive the reporter
+ * @param pFields Fields to report, must outlive the reporter
+ * @param fieldCount Number of fields in pFields
+ * @param minUpdateIntervalMs Shortest time between two updates, changes in between are sent together
+ * @param timeoutSec Time to wait for the Shadow service to accept an update
+ *
+ * @return SUCCESS or NULL_VALUE_ERROR
+ */
+IoT_Error_t aws_iot_shadow_reporter_init(ShadowReporter_t *pReporter, const char *pThingName,
+										 ShadowReportedField_t *pFields, size_t fieldCount,
+										 uint32_t minUpdateIntervalMs, uint8_t timeoutSec);
+
+/**
+ * @brief Build the update document with the fields that need to be reported
+ *
+ * The fields put in the document are pending until aws_iot_shadow_reporter_ack is called. Nothing is built
+ * while an update is pending or within the minimum interval between updates.
+ *
+ * @param pReporter Reporter
+ * @param nowMs Current time in milliseconds, from any clock that wraps around at 2^32
+ * @param pJsonDocument The JSON Document filled in this char buffer
+ * @param maxSizeOfJsonDocument maximum size of the pJsonDocument that can be used to fill the JSON document
+ * @param pFieldCount Set to the number of fields in the document, 0 if there is nothing to send
+ *
+ * @return SUCCESS, NULL_VALUE_ERROR or the error of the JSON writer
+ */
+IoT_Error_t aws_iot_shadow_reporter_build(ShadowReporter_t *pReporter, uint32_t nowMs, char *pJsonDocument,
+										  size_t maxSizeOfJsonDocument, size_t *pFieldCount);
+
+/**
+ * @brief Settle the update built last
+ *
+ * Once accepted the pending values become the acknowledged ones. Otherwise the fields stay dirty and are sent again.
+ *
+ * @param pReporter Reporter
+ * @param status Response of the Shadow service
+ */
+void aws_iot_shadow_reporter_ack(ShadowReporter_t *pReporter, Shadow_Ack_Status_t status);
+
+/**
+ * @brief Send the fields that need to be reported, if any
+ *
+ * Builds the document with aws_iot_shadow_reporter_build and sends it with aws_iot_shadow_update. The response
+ * is handled from aws_iot_shadow_yield. Call it as often as the values are sampled.
+ *
+ * @param pClient MQTT Client used as the protocol layer
+ * @param pReporter Reporter
+ * @param nowMs Current time in milliseconds, from any clock that wraps around at 2^32
+ * @param pJsonDocument Buffer for the update document
+ * @param maxSizeOfJsonDocument Size of pJsonDocument
+ *
+ * @return SUCCESS, also when there was nothing to send, or the error of aws_iot_shadow_update
+ */
+IoT_Error_t aws_iot_shadow_reporter_update(AWS_IoT_Client *pClient, ShadowReporter_t *pReporter, uint32_t nowMs,
+										   char *pJsonDocument, size_t maxSizeOfJsonDocument);
+
+/**
+ * @brief Forget the acknowledged values, so the next update reports every field
+ *
+ * Useful when the shadow may have changed behind the device's back, e.g. after it was deleted.
+ *
+ * @param pReporter Reporter
+ */
+void aws_iot_shadow_reporter_invalidate(ShadowReporter_t *pReporter);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AWS_IOT_SDK_SRC_IOT_SHADOW_REPORTER_H_ */
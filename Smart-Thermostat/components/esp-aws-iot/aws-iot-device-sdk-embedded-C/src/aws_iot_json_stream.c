@@ -0,0 +1,356 @@
+/*
+ * Copyright 2010-2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file aws_iot_json_stream.c
+ * @brief Incremental JSON tokenizer
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "aws_iot_json_stream.h"
+
+#include <string.h>
+
+#include "aws_iot_log.h"
+
+#define JSON_STREAM_IS_OBJECT(pParser, level) \
+	(0 != ((pParser)->containerIsObject[(level) / 8] & (1u << ((level) % 8))))
+
+static bool _aws_iot_json_stream_is_whitespace(char c) {
+	return (' ' == c) || ('\t' == c) || ('\r' == c) || ('\n' == c);
+}
+
+/* The same delimiters jsmn ends a primitive on */
+static bool _aws_iot_json_stream_is_delimiter(char c) {
+	return _aws_iot_json_stream_is_whitespace(c) || (',' == c) || (']' == c) || ('}' == c);
+}
+
+static bool _aws_iot_json_stream_is_key_token(const JsonStreamParser_t *pParser) {
+	return (JSON_STREAM_STATE_STRING == pParser->state) && pParser->isStringKey;
+}
+
+/* Copies part of the token in progress to the buffer it is being put together in */
+static void _aws_iot_json_stream_spill(JsonStreamParser_t *pParser, const char *pFrom, const char *pTo) {
+	char *pBuffer;
+	size_t capacity, length;
+
+	length = (size_t) (pTo - pFrom);
+	if(pParser->isTokenTruncated || 0 == length) {
+		return;
+	}
+
+	if(_aws_iot_json_stream_is_key_token(pParser)) {
+		pBuffer = pParser->keyBuffer;
+		capacity = JSON_STREAM_MAX_KEY_LENGTH;
+	} else {
+		pBuffer = pParser->valueBuffer;
+		capacity = JSON_STREAM_MAX_VALUE_LENGTH;
+	}
+
+	if(length > capacity - pParser->spilledLength) {
+		pParser->isTokenTruncated = true;
+		return;
+	}
+
+	memcpy(pBuffer + pParser->spilledLength, pFrom, length);
+	pParser->spilledLength += (uint32_t) length;
+}
+
+/* Where the token in progress, ending at pEnd, can be read from. In place if it is all in the
+ * current chunk, NULL if it straddles chunks and is too long for its buffer. */
+static const char *_aws_iot_json_stream_token_text(JsonStreamParser_t *pParser, const char *pEnd,
+													 uint32_t *pLength) {
+	char *pBuffer;
+
+	if(0 == pParser->spilledLength && !pParser->isTokenTruncated) {
+		*pLength = (uint32_t) (pEnd - pParser->pTokenStart);
+		return pParser->pTokenStart;
+	}
+
+	_aws_iot_json_stream_spill(pParser, pParser->pTokenStart, pEnd);
+	if(pParser->isTokenTruncated) {
+		*pLength = 0;
+		return NULL;
+	}
+
+	pBuffer = _aws_iot_json_stream_is_key_token(pParser) ? pParser->keyBuffer : pParser->valueBuffer;
+	pBuffer[pParser->spilledLength] = '\0';
+	*pLength = pParser->spilledLength;
+	return pBuffer;
+}
+
+static void _aws_iot_json_stream_start_token(JsonStreamParser_t *pParser, JsonStreamState_t state,
+											 const char *pStart) {
+	pParser->state = state;
+	pParser->pTokenStart = pStart;
+	pParser->spilledLength = 0;
+	pParser->isTokenTruncated = false;
+	pParser->isEscaped = false;
+}
+
+static void _aws_iot_json_stream_emit(JsonStreamParser_t *pParser, JsonStreamEventType_t type, jsmntype_t valueType,
+									  const char *pValue, uint32_t valueLength) {
+	JsonStreamEvent_t event;
+
+	event.type = type;
+	event.valueType = valueType;
+	event.depth = pParser->depth;
+	event.pKey = pParser->hasKey ? pParser->pKey : NULL;
+	event.keyLength = (NULL != event.pKey) ? pParser->keyLength : 0;
+	event.pValue = pValue;
+	event.valueLength = valueLength;
+
+	pParser->pEventHandler(&event, pParser->pUserData);
+}
+
+static void _aws_iot_json_stream_value_done(JsonStreamParser_t *pParser) {
+	pParser->hasKey = false;
+	pParser->isContainerEmpty = false;
+	pParser->state = (0 == pParser->depth) ? JSON_STREAM_STATE_DONE : JSON_STREAM_STATE_NEXT;
+}
+
+static IoT_Error_t _aws_iot_json_stream_open(JsonStreamParser_t *pParser, const char *p, bool isObject) {
+	if(JSON_STREAM_MAX_DEPTH <= pParser->depth) {
+		IOT_WARN("JSON nested deeper than %d levels", JSON_STREAM_MAX_DEPTH);
+		return JSON_PARSE_ERROR;
+	}
+
+	if(isObject) {
+		pParser->containerIsObject[pParser->depth / 8] |= (uint8_t) (1u << (pParser->depth % 8));
+		_aws_iot_json_stream_emit(pParser, JSON_STREAM_EVENT_OBJECT_START, JSMN_OBJECT, NULL, 0);
+	} else {
+		pParser->containerIsObject[pParser->depth / 8] &= (uint8_t) ~(1u << (pParser->depth % 8));
+		_aws_iot_json_stream_emit(pParser, JSON_STREAM_EVENT_ARRAY_START, JSMN_ARRAY, NULL, 0);
+	}
+	pParser->pContainerStart[pParser->depth] = p;
+	pParser->depth++;
+	pParser->hasKey = false;
+	pParser->isContainerEmpty = true;
+	pParser->state = isObject ? JSON_STREAM_STATE_KEY : JSON_STREAM_STATE_VALUE;
+
+	return SUCCESS;
+}
+
+static IoT_Error_t _aws_iot_json_stream_close(JsonStreamParser_t *pParser, const char *p, bool isObject) {
+	const char *pStart;
+
+	if(0 == pParser->depth || isObject != JSON_STREAM_IS_OBJECT(pParser, pParser->depth - 1)) {
+		return JSON_PARSE_ERROR;
+	}
+
+	pParser->depth--;
+	pStart = pParser->pContainerStart[pParser->depth];
+	_aws_iot_json_stream_emit(pParser, isObject ? JSON_STREAM_EVENT_OBJECT_END : JSON_STREAM_EVENT_ARRAY_END,
+							  isObject ? JSMN_OBJECT : JSMN_ARRAY, pStart,
+							  (NULL != pStart) ? (uint32_t) (p + 1 - pStart) : 0);
+	_aws_iot_json_stream_value_done(pParser);
+
+	return SUCCESS;
+}
+
+static void _aws_iot_json_stream_string_end(JsonStreamParser_t *pParser, const char *pEnd) {
+	const char *pText;
+	uint32_t length;
+
+	pText = _aws_iot_json_stream_token_text(pParser, pEnd, &length);
+	if(pParser->isStringKey) {
+		pParser->pKey = pText;
+		pParser->keyLength = length;
+		pParser->hasKey = true;
+		pParser->state = JSON_STREAM_STATE_COLON;
+	} else {
+		_aws_iot_json_stream_emit(pParser, JSON_STREAM_EVENT_VALUE, JSMN_STRING, pText, length);
+		_aws_iot_json_stream_value_done(pParser);
+	}
+}
+
+static void _aws_iot_json_stream_primitive_end(JsonStreamParser_t *pParser, const char *pEnd) {
+	const char *pText;
+	uint32_t length;
+
+	pText = _aws_iot_json_stream_token_text(pParser, pEnd, &length);
+	_aws_iot_json_stream_emit(pParser, JSON_STREAM_EVENT_VALUE, JSMN_PRIMITIVE, pText, length);
+	_aws_iot_json_stream_value_done(pParser);
+}
+
+/* Handles a character outside of strings and primitives */
+static IoT_Error_t _aws_iot_json_stream_structural(JsonStreamParser_t *pParser, const char *p) {
+	char c = *p;
+
+	switch(pParser->state) {
+		case JSON_STREAM_STATE_VALUE:
+			if('{' == c || '[' == c) {
+				return _aws_iot_json_stream_open(pParser, p, '{' == c);
+			} else if(']' == c && pParser->isContainerEmpty) {
+				return _aws_iot_json_stream_close(pParser, p, false);
+			} else if('"' == c) {
+				pParser->isStringKey = false;
+				_aws_iot_json_stream_start_token(pParser, JSON_STREAM_STATE_STRING, p + 1);
+				return SUCCESS;
+			} else if('-' == c || ('0' <= c && '9' >= c) || 't' == c || 'f' == c || 'n' == c) {
+				_aws_iot_json_stream_start_token(pParser, JSON_STREAM_STATE_PRIMITIVE, p);
+				return SUCCESS;
+			}
+			break;
+		case JSON_STREAM_STATE_KEY:
+			if('"' == c) {
+				pParser->isStringKey = true;
+				_aws_iot_json_stream_start_token(pParser, JSON_STREAM_STATE_STRING, p + 1);
+				return SUCCESS;
+			} else if('}' == c && pParser->isContainerEmpty) {
+				return _aws_iot_json_stream_close(pParser, p, true);
+			}
+			break;
+		case JSON_STREAM_STATE_COLON:
+			if(':' == c) {
+				pParser->state = JSON_STREAM_STATE_VALUE;
+				return SUCCESS;
+			}
+			break;
+		case JSON_STREAM_STATE_NEXT:
+			if(',' == c) {
+				pParser->state = JSON_STREAM_IS_OBJECT(pParser, pParser->depth - 1) ? JSON_STREAM_STATE_KEY
+																					: JSON_STREAM_STATE_VALUE;
+				return SUCCESS;
+			} else if('}' == c || ']' == c) {
+				return _aws_iot_json_stream_close(pParser, p, '}' == c);
+			}
+			break;
+		default:
+			/* Nothing may follow the top-level value */
+			break;
+	}
+
+	return JSON_PARSE_ERROR;
+}
+
+IoT_Error_t aws_iot_json_stream_init(JsonStreamParser_t *pParser, pJsonStreamEventHandler_t pEventHandler,
+									 void *pUserData) {
+	FUNC_ENTRY;
+
+	if(NULL == pParser || NULL == pEventHandler) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	memset(pParser, 0, sizeof(JsonStreamParser_t));
+	pParser->state = JSON_STREAM_STATE_VALUE;
+	pParser->pEventHandler = pEventHandler;
+	pParser->pUserData = pUserData;
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+
+IoT_Error_t aws_iot_json_stream_feed(JsonStreamParser_t *pParser, const char *pChunk, size_t chunkLength) {
+	const char *p, *pEnd;
+	uint16_t level;
+	IoT_Error_t rc = SUCCESS;
+
+	FUNC_ENTRY;
+
+	if(NULL == pParser || (NULL == pChunk && 0 != chunkLength)) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	if(JSON_STREAM_STATE_ERROR == pParser->state) {
+		FUNC_EXIT_RC(JSON_PARSE_ERROR);
+	}
+
+	p = pChunk;
+	pEnd = pChunk + chunkLength;
+
+	/* Text from earlier chunks is gone, only containers opened in this one can be reported whole */
+	for(level = 0; level < pParser->depth; level++) {
+		pParser->pContainerStart[level] = NULL;
+	}
+	if(JSON_STREAM_STATE_STRING == pParser->state || JSON_STREAM_STATE_PRIMITIVE == pParser->state) {
+		pParser->pTokenStart = pChunk;
+	}
+
+	while(p < pEnd && SUCCESS == rc) {
+		if(JSON_STREAM_STATE_STRING == pParser->state) {
+			while(p < pEnd && (pParser->isEscaped || '"' != *p)) {
+				pParser->isEscaped = !pParser->isEscaped && ('\\' == *p);
+				p++;
+			}
+			if(p < pEnd) {
+				_aws_iot_json_stream_string_end(pParser, p);
+				p++;
+			}
+		} else if(JSON_STREAM_STATE_PRIMITIVE == pParser->state) {
+			while(p < pEnd && !_aws_iot_json_stream_is_delimiter(*p)) {
+				p++;
+			}
+			if(p < pEnd) {
+				/* The delimiter itself is handled on the next round */
+				_aws_iot_json_stream_primitive_end(pParser, p);
+			}
+		} else if(_aws_iot_json_stream_is_whitespace(*p)) {
+			p++;
+		} else {
+			rc = _aws_iot_json_stream_structural(pParser, p);
+			p++;
+		}
+	}
+
+	if(SUCCESS != rc) {
+		IOT_WARN("JSON not valid at offset %u", (unsigned int) (pParser->bytesConsumed + (size_t) (p - 1 - pChunk)));
+		pParser->state = JSON_STREAM_STATE_ERROR;
+		FUNC_EXIT_RC(rc);
+	}
+
+	/* Keep what the next chunk still needs */
+	if(JSON_STREAM_STATE_STRING == pParser->state || JSON_STREAM_STATE_PRIMITIVE == pParser->state) {
+		_aws_iot_json_stream_spill(pParser, pParser->pTokenStart, pEnd);
+	}
+	if(pParser->hasKey && NULL != pParser->pKey && pParser->keyBuffer != pParser->pKey) {
+		if(JSON_STREAM_MAX_KEY_LENGTH >= pParser->keyLength) {
+			memcpy(pParser->keyBuffer, pParser->pKey, pParser->keyLength);
+			pParser->keyBuffer[pParser->keyLength] = '\0';
+			pParser->pKey = pParser->keyBuffer;
+		} else {
+			pParser->pKey = NULL;
+		}
+	}
+	pParser->bytesConsumed += chunkLength;
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+
+IoT_Error_t aws_iot_json_stream_finish(JsonStreamParser_t *pParser) {
+	FUNC_ENTRY;
+
+	if(NULL == pParser) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	/* A top-level primitive has no delimiter after it */
+	if(JSON_STREAM_STATE_PRIMITIVE == pParser->state && 0 == pParser->depth) {
+		pParser->pTokenStart = NULL;
+		_aws_iot_json_stream_primitive_end(pParser, NULL);
+	}
+
+	if(JSON_STREAM_STATE_DONE != pParser->state) {
+		FUNC_EXIT_RC(JSON_PARSE_ERROR);
+	}
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+
+#ifdef __cplusplus
+}
+#endif
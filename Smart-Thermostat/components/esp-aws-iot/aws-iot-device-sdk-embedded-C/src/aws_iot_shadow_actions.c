@@ -35,6 +35,7 @@ IoT_Error_t aws_iot_shadow_internal_action(const char *pThingName, ShadowActions
 	IoT_Error_t ret_val = SUCCESS;
 	bool isClientTokenPresent = false;
 	bool isAckWaitListFree = false;
+	bool isAckSubscriptionKept = false;
 	uint8_t indexAckWaitList;
 	char extractedClientToken[MAX_SIZE_CLIENT_ID_WITH_SEQUENCE];
 
@@ -51,7 +52,10 @@ IoT_Error_t aws_iot_shadow_internal_action(const char *pThingName, ShadowActions
 			isAckWaitListFree = true;
 		}
 
-		if(isAckWaitListFree) {
+		if(isAckWaitListFree && canKeepShadowActionAcks(pThingName)) {
+			ret_val = subscribeToShadowActionAcksOnce(pThingName, action);
+			isAckSubscriptionKept = true;
+		} else if(isAckWaitListFree) {
 			if(!isSubscriptionPresent(pThingName, action)) {
 				ret_val = subscribeToShadowActionAcks(pThingName, action, isSticky);
 			} else {
@@ -69,7 +73,7 @@ IoT_Error_t aws_iot_shadow_internal_action(const char *pThingName, ShadowActions
 
 	if(isClientTokenPresent && (NULL != callback) && (SUCCESS == ret_val) && isAckWaitListFree) {
 		addToAckWaitList(indexAckWaitList, pThingName, action, extractedClientToken, callback, pCallbackContext,
-						 timeout_seconds);
+						 timeout_seconds, isAckSubscriptionKept);
 	}
 
 	FUNC_EXIT_RC(ret_val);
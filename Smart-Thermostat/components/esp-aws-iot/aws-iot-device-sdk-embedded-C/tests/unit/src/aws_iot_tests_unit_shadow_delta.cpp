@@ -31,3 +31,8 @@ TEST_GROUP_C_WRAPPER(ShadowDeltaTest, registerDeltaInt)
 TEST_GROUP_C_WRAPPER(ShadowDeltaTest, registerDeltaIntNoCallback)
 TEST_GROUP_C_WRAPPER(ShadowDeltaTest, DeltaNestedObject)
 TEST_GROUP_C_WRAPPER(ShadowDeltaTest, DeltaVersionIgnoreOldVersion)
+TEST_GROUP_C_WRAPPER(ShadowDeltaTest, DeltaMetadataAndRepeatedKeys)
+TEST_GROUP_C_WRAPPER(ShadowDeltaTest, DeltaKeysOutsideState)
+TEST_GROUP_C_WRAPPER(ShadowDeltaTest, DeltaLargerThanRxBuffer)
+TEST_GROUP_C_WRAPPER(ShadowDeltaTest, DeltaLargerThanRxBufferVersionLast)
+TEST_GROUP_C_WRAPPER(ShadowDeltaTest, DeltaDispatchBenchmark)
@@ -29,3 +29,8 @@ TEST_GROUP_C(ShadowJsonBuilderTests){
 TEST_GROUP_C_WRAPPER(ShadowJsonBuilderTests, UpdateTheJSONDocumentBuilder)
 TEST_GROUP_C_WRAPPER(ShadowJsonBuilderTests, PassingNullValue)
 TEST_GROUP_C_WRAPPER(ShadowJsonBuilderTests, SmallBuffer)
+TEST_GROUP_C_WRAPPER(ShadowJsonBuilderTests, BuildReportedDocument)
+TEST_GROUP_C_WRAPPER(ShadowJsonBuilderTests, WriterNumbersMatchSnprintf)
+TEST_GROUP_C_WRAPPER(ShadowJsonBuilderTests, WriterSectionsAndStrings)
+TEST_GROUP_C_WRAPPER(ShadowJsonBuilderTests, WriterSmallBuffer)
+TEST_GROUP_C_WRAPPER(ShadowJsonBuilderTests, BuilderBenchmark)
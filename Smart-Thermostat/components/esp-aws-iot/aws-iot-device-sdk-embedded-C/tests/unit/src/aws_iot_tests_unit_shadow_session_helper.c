@@ -0,0 +1,351 @@
+/*
+* Copyright 2015-2016 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License").
+* You may not use this file except in compliance with the License.
+* A copy of the License is located at
+*
+* http://aws.amazon.com/apache2.0
+*
+* or in the "license" file accompanying this file. This file is distributed
+* on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+* express or implied. See the License for the specific language governing
+* permissions and limitations under the License.
+*/
+
+/**
+ * @file aws_iot_tests_unit_shadow_session_helper.c
+ * @brief IoT Client Unit Testing - Shadow Persistent Ack Subscription Tests Helper
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <CppUTest/TestHarness_c.h>
+
+#include "aws_iot_tests_unit_helper_functions.h"
+#include "aws_iot_tests_unit_mock_tls_params.h"
+
+#include "aws_iot_shadow_interface.h"
+#include "aws_iot_log.h"
+
+#define SHADOW_SESSION_TEST_RTT_MS 20
+#define SHADOW_SESSION_TEST_YIELD_MS 10
+#define SHADOW_SESSION_TEST_MAX_ACKS 8
+#define SHADOW_SESSION_BENCH_UPDATES 3
+#define SHADOW_SESSION_UNCACHED_THING "uncachedThing"
+#define SHADOW_SESSION_OTHER_THING "otherThing"
+
+static AWS_IoT_Client client;
+static ShadowInitParameters_t shadowInitParams;
+static ShadowConnectParameters_t shadowConnectParams;
+static IoT_Client_Connect_Params connectParams;
+
+static uint32_t ackCount;
+static Shadow_Ack_Status_t ackStatus[SHADOW_SESSION_TEST_MAX_ACKS];
+static uintptr_t ackContext[SHADOW_SESSION_TEST_MAX_ACKS];
+static uint64_t lastAckMs;
+static uint32_t clientTokenSeq;
+
+static uint64_t nowMs(void) {
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	return ((uint64_t) now.tv_sec * 1000) + ((uint64_t) now.tv_usec / 1000);
+}
+
+static void actionCallback(const char *pThingName, ShadowActions_t action, Shadow_Ack_Status_t status,
+						   const char *pReceivedJsonDocument, void *pContextData) {
+	IOT_UNUSED(pThingName);
+	IOT_UNUSED(action);
+	IOT_UNUSED(pReceivedJsonDocument);
+
+	if(ackCount < SHADOW_SESSION_TEST_MAX_ACKS) {
+		ackStatus[ackCount] = status;
+		ackContext[ackCount] = (uintptr_t) pContextData;
+	}
+	ackCount++;
+	lastAckMs = nowMs();
+}
+
+static void connectShadow(bool isAckSubscriptionPersistent) {
+	IoT_Error_t rc;
+
+	shadowConnectParams.pMyThingName = AWS_IOT_MY_THING_NAME;
+	shadowConnectParams.pMqttClientId = AWS_IOT_MQTT_CLIENT_ID;
+	shadowConnectParams.mqttClientIdLen = (uint16_t) strlen(AWS_IOT_MQTT_CLIENT_ID);
+	shadowConnectParams.deleteActionHandler = NULL;
+	shadowConnectParams.isAckSubscriptionPersistent = isAckSubscriptionPersistent;
+	ConnectMQTTParamsSetup(&connectParams, AWS_IOT_MQTT_CLIENT_ID, (uint16_t) strlen(AWS_IOT_MQTT_CLIENT_ID));
+	setTLSRxBufferForConnack(&connectParams, 0, 0);
+	rc = aws_iot_shadow_connect(&client, &shadowConnectParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	ResetTLSBuffer();
+	mockBroker.isEnabled = true;
+	mockBroker.isServingShadow = true;
+	mockBroker.roundTripMs = SHADOW_SESSION_TEST_RTT_MS;
+}
+
+static IoT_Error_t update(const char *pThingName, uintptr_t context, uint8_t timeout_seconds) {
+	char document[100];
+
+	snprintf(document, sizeof(document), "{\"state\":{\"reported\":{\"temp\":%u}},\"clientToken\":\"%s-%u\"}",
+			 (unsigned) clientTokenSeq, AWS_IOT_MQTT_CLIENT_ID, (unsigned) clientTokenSeq);
+	clientTokenSeq++;
+	return aws_iot_shadow_update(&client, pThingName, document, actionCallback, (void *) context, timeout_seconds,
+								 false);
+}
+
+/* Yields until expectedAcks callbacks ran or timeout_ms passed */
+static void yieldForAcks(uint32_t expectedAcks, uint32_t timeout_ms) {
+	IoT_Error_t rc;
+	uint64_t deadline = nowMs() + timeout_ms;
+
+	while(ackCount < expectedAcks && nowMs() < deadline) {
+		rc = aws_iot_shadow_yield(&client, SHADOW_SESSION_TEST_YIELD_MS);
+		CHECK_EQUAL_C_INT(SUCCESS, rc);
+	}
+	CHECK_EQUAL_C_INT(expectedAcks, ackCount);
+}
+
+/* Yields for duration_ms, letting late packets of the mock broker arrive */
+static void yieldFor(uint32_t duration_ms) {
+	uint64_t deadline = nowMs() + duration_ms;
+
+	while(nowMs() < deadline) {
+		aws_iot_shadow_yield(&client, SHADOW_SESSION_TEST_YIELD_MS);
+	}
+}
+
+TEST_GROUP_C_SETUP(ShadowSessionTests) {
+	IoT_Error_t rc;
+
+	ResetTLSBuffer();
+	memset(&mockBroker, 0, sizeof(mockBroker));
+	shadowInitParams.pHost = AWS_IOT_MQTT_HOST;
+	shadowInitParams.port = AWS_IOT_MQTT_PORT;
+	shadowInitParams.pClientCRT = AWS_IOT_CERTIFICATE_FILENAME;
+	shadowInitParams.pRootCA = AWS_IOT_ROOT_CA_FILENAME;
+	shadowInitParams.pClientKey = AWS_IOT_PRIVATE_KEY_FILENAME;
+	shadowInitParams.disconnectHandler = NULL;
+	shadowInitParams.enableAutoReconnect = false;
+	rc = aws_iot_shadow_init(&client, &shadowInitParams);
+	CHECK_EQUAL_C_INT(SUCCESS, rc);
+
+	ackCount = 0;
+	clientTokenSeq = 0;
+}
+
+TEST_GROUP_C_TEARDOWN(ShadowSessionTests) {
+	IoT_Error_t rc = aws_iot_shadow_disconnect(&client);
+	IOT_UNUSED(rc);
+	memset(&mockBroker, 0, sizeof(mockBroker));
+}
+
+/* N:1 - Accepted/rejected subscriptions are made once and kept between requests */
+TEST_C(ShadowSessionTests, SessionSubscribesOnce) {
+	uint32_t itr;
+
+	IOT_DEBUG("-->Running Shadow Session Tests - N:1 - Subscriptions made once and kept \n");
+
+	connectShadow(true);
+	for(itr = 0; itr < 3; itr++) {
+		CHECK_EQUAL_C_INT(SUCCESS, update(AWS_IOT_MY_THING_NAME, itr, 2));
+		yieldForAcks(itr + 1, 1000);
+		CHECK_EQUAL_C_INT(SHADOW_ACK_ACCEPTED, ackStatus[itr]);
+	}
+
+	CHECK_EQUAL_C_INT(2, mockBroker.subscribeCount);
+	CHECK_EQUAL_C_INT(0, mockBroker.unsubscribeCount);
+	CHECK_EQUAL_C_INT(3, mockBroker.shadowActionCount);
+
+	IOT_DEBUG("-->Success - N:1 - Subscriptions made once and kept \n");
+}
+
+/* N:2 - Without persistent subscriptions, every request subscribes and unsubscribes */
+TEST_C(ShadowSessionTests, LegacySubscribesPerRequest) {
+	uint32_t itr;
+
+	IOT_DEBUG("-->Running Shadow Session Tests - N:2 - Subscriptions made per request \n");
+
+	connectShadow(false);
+	for(itr = 0; itr < 2; itr++) {
+		CHECK_EQUAL_C_INT(SUCCESS, update(AWS_IOT_MY_THING_NAME, itr, 2));
+		yieldForAcks(itr + 1, 1000);
+		CHECK_EQUAL_C_INT(SHADOW_ACK_ACCEPTED, ackStatus[itr]);
+	}
+	yieldFor(3 * SHADOW_SESSION_TEST_RTT_MS);
+
+	CHECK_EQUAL_C_INT(4, mockBroker.subscribeCount);
+	CHECK_EQUAL_C_INT(4, mockBroker.unsubscribeCount);
+	CHECK_EQUAL_C_INT(2, mockBroker.shadowActionCount);
+
+	IOT_DEBUG("-->Success - N:2 - Subscriptions made per request \n");
+}
+
+/* N:3 - Timed out request keeps the subscriptions */
+TEST_C(ShadowSessionTests, SessionTimeoutKeepsSubscription) {
+	IOT_DEBUG("-->Running Shadow Session Tests - N:3 - Timeout keeps subscriptions \n");
+
+	connectShadow(true);
+	CHECK_EQUAL_C_INT(SUCCESS, update(AWS_IOT_MY_THING_NAME, 0, 2));
+	yieldForAcks(1, 1000);
+
+	/* The response comes after the request timed out and matches nothing */
+	mockBroker.roundTripMs = 1500;
+	CHECK_EQUAL_C_INT(SUCCESS, update(AWS_IOT_MY_THING_NAME, 1, 1));
+	yieldForAcks(2, 2500);
+	CHECK_EQUAL_C_INT(SHADOW_ACK_TIMEOUT, ackStatus[1]);
+	yieldFor(1000);
+	CHECK_EQUAL_C_INT(2, ackCount);
+
+	mockBroker.roundTripMs = SHADOW_SESSION_TEST_RTT_MS;
+	CHECK_EQUAL_C_INT(SUCCESS, update(AWS_IOT_MY_THING_NAME, 2, 2));
+	yieldForAcks(3, 1000);
+	CHECK_EQUAL_C_INT(SHADOW_ACK_ACCEPTED, ackStatus[2]);
+
+	CHECK_EQUAL_C_INT(2, mockBroker.subscribeCount);
+	CHECK_EQUAL_C_INT(0, mockBroker.unsubscribeCount);
+
+	IOT_DEBUG("-->Success - N:3 - Timeout keeps subscriptions \n");
+}
+
+/* N:4 - Several requests in flight are matched by client token */
+TEST_C(ShadowSessionTests, SessionMatchesAcksByToken) {
+	uint32_t itr;
+
+	IOT_DEBUG("-->Running Shadow Session Tests - N:4 - Acks matched by client token \n");
+
+	connectShadow(true);
+	CHECK_EQUAL_C_INT(SUCCESS, update(AWS_IOT_MY_THING_NAME, 100, 2));
+	yieldForAcks(1, 1000);
+
+	for(itr = 1; itr < SHADOW_SESSION_TEST_MAX_ACKS; itr++) {
+		CHECK_EQUAL_C_INT(SUCCESS, update(AWS_IOT_MY_THING_NAME, 100 + itr, 2));
+	}
+	yieldForAcks(SHADOW_SESSION_TEST_MAX_ACKS, 1000);
+
+	for(itr = 0; itr < SHADOW_SESSION_TEST_MAX_ACKS; itr++) {
+		CHECK_EQUAL_C_INT(SHADOW_ACK_ACCEPTED, ackStatus[itr]);
+		CHECK_EQUAL_C_INT(100 + itr, ackContext[itr]);
+	}
+	CHECK_EQUAL_C_INT(2, mockBroker.subscribeCount);
+
+	IOT_DEBUG("-->Success - N:4 - Acks matched by client token \n");
+}
+
+/* N:5 - Things beyond the topic cache subscribe per request */
+TEST_C(ShadowSessionTests, SessionUncachedThingSubscribesPerRequest) {
+	IOT_DEBUG("-->Running Shadow Session Tests - N:5 - Uncached thing subscribes per request \n");
+
+	connectShadow(true);
+
+	/* The own thing and one other fill the cache */
+	CHECK_EQUAL_C_INT(SUCCESS, update(SHADOW_SESSION_OTHER_THING, 0, 2));
+	yieldForAcks(1, 1000);
+	CHECK_EQUAL_C_INT(SUCCESS, update(SHADOW_SESSION_OTHER_THING, 1, 2));
+	yieldForAcks(2, 1000);
+	CHECK_EQUAL_C_INT(2, mockBroker.subscribeCount);
+
+	CHECK_EQUAL_C_INT(SUCCESS, update(SHADOW_SESSION_UNCACHED_THING, 2, 2));
+	yieldForAcks(3, 1000);
+	yieldFor(3 * SHADOW_SESSION_TEST_RTT_MS);
+	CHECK_EQUAL_C_INT(SHADOW_ACK_ACCEPTED, ackStatus[2]);
+	CHECK_EQUAL_C_INT(4, mockBroker.subscribeCount);
+	CHECK_EQUAL_C_INT(2, mockBroker.unsubscribeCount);
+
+	IOT_DEBUG("-->Success - N:5 - Uncached thing subscribes per request \n");
+}
+
+/* Runs the benchmark updates one after the other, returns the latency of the first and the average of the others */
+static void runUpdates(uint64_t *pFirstMs, uint64_t *pSteadyMs) {
+	uint32_t itr;
+	uint64_t start;
+
+	*pSteadyMs = 0;
+	for(itr = 0; itr < SHADOW_SESSION_BENCH_UPDATES; itr++) {
+		start = nowMs();
+		CHECK_EQUAL_C_INT(SUCCESS, update(AWS_IOT_MY_THING_NAME, itr, 5));
+		yieldForAcks(itr + 1, 5000);
+		if(0 == itr) {
+			*pFirstMs = lastAckMs - start;
+		} else {
+			*pSteadyMs += lastAckMs - start;
+		}
+	}
+	*pSteadyMs /= SHADOW_SESSION_BENCH_UPDATES - 1;
+	yieldFor(3 * SHADOW_SESSION_TEST_RTT_MS);
+}
+
+/* N:6 - Round trips and latency of updates, persistent against per request subscriptions */
+TEST_C(ShadowSessionTests, SessionUpdateBenchmark) {
+	uint64_t legacyFirstMs, legacySteadyMs, sessionFirstMs, sessionSteadyMs;
+	uint32_t legacyRoundTrips, sessionRoundTrips;
+
+	IOT_DEBUG("-->Running Shadow Session Tests - N:6 - Update benchmark \n");
+
+	connectShadow(false);
+	runUpdates(&legacyFirstMs, &legacySteadyMs);
+	legacyRoundTrips = mockBroker.subscribeCount + mockBroker.unsubscribeCount + mockBroker.shadowActionCount;
+	aws_iot_shadow_disconnect(&client);
+
+	memset(&mockBroker, 0, sizeof(mockBroker));
+	ackCount = 0;
+	connectShadow(true);
+	runUpdates(&sessionFirstMs, &sessionSteadyMs);
+	sessionRoundTrips = mockBroker.subscribeCount + mockBroker.unsubscribeCount + mockBroker.shadowActionCount;
+
+	printf("\nShadow update, %u updates, %u ms round trip:", SHADOW_SESSION_BENCH_UPDATES,
+		   SHADOW_SESSION_TEST_RTT_MS);
+	printf("\n  per request: %2u round trips, first %5u ms, then %5u ms per update", (unsigned) legacyRoundTrips,
+		   (unsigned) legacyFirstMs, (unsigned) legacySteadyMs);
+	printf("\n  persistent:  %2u round trips, first %5u ms, then %5u ms per update\n", (unsigned) sessionRoundTrips,
+		   (unsigned) sessionFirstMs, (unsigned) sessionSteadyMs);
+
+	CHECK_EQUAL_C_INT(5 * SHADOW_SESSION_BENCH_UPDATES, legacyRoundTrips);
+	CHECK_EQUAL_C_INT(2 + SHADOW_SESSION_BENCH_UPDATES, sessionRoundTrips);
+	CHECK_C(sessionSteadyMs < legacySteadyMs);
+
+	IOT_DEBUG("-->Success - N:6 - Update benchmark \n");
+}
+
+/* Handlers of the client subscribed to pTopic */
+static uint32_t countHandlers(const char *pTopic) {
+	uint32_t itr, count = 0;
+
+	for(itr = 0; itr < AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS; itr++) {
+		if(NULL != client.clientData.messageHandlers[itr].topicName &&
+		   strcmp(pTopic, client.clientData.messageHandlers[itr].topicName) == 0) {
+			count++;
+		}
+	}
+	return count;
+}
+
+/* N:7 - Reconnecting drops the kept subscriptions instead of adding to them */
+TEST_C(ShadowSessionTests, SessionReconnectSubscribesAgain) {
+	char acceptedTopic[MAX_SHADOW_TOPIC_LENGTH_BYTES];
+
+	IOT_DEBUG("-->Running Shadow Session Tests - N:7 - Reconnect subscribes again \n");
+
+	snprintf(acceptedTopic, sizeof(acceptedTopic), "$aws/things/%s/shadow/update/accepted", AWS_IOT_MY_THING_NAME);
+
+	connectShadow(true);
+	CHECK_EQUAL_C_INT(SUCCESS, update(AWS_IOT_MY_THING_NAME, 0, 2));
+	yieldForAcks(1, 1000);
+	CHECK_EQUAL_C_INT(1, countHandlers(acceptedTopic));
+
+	/* The broker answers the unsubscribes made while connecting */
+	CHECK_EQUAL_C_INT(SUCCESS, aws_iot_shadow_disconnect(&client));
+	connectShadow(true);
+	CHECK_EQUAL_C_INT(2, mockBroker.unsubscribeCount);
+	CHECK_EQUAL_C_INT(0, countHandlers(acceptedTopic));
+
+	CHECK_EQUAL_C_INT(SUCCESS, update(AWS_IOT_MY_THING_NAME, 1, 2));
+	yieldForAcks(2, 1000);
+	CHECK_EQUAL_C_INT(SHADOW_ACK_ACCEPTED, ackStatus[1]);
+	CHECK_EQUAL_C_INT(4, mockBroker.subscribeCount);
+	CHECK_EQUAL_C_INT(1, countHandlers(acceptedTopic));
+
+	IOT_DEBUG("-->Success - N:7 - Reconnect subscribes again \n");
+}
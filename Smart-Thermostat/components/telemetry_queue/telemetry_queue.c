@@ -0,0 +1,497 @@
+/*
+ * AWS IoT EduKit - Core2 for AWS IoT EduKit
+ * Smart Thermostat v1.2.1
+ * telemetry_queue.c
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <dirent.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <esp_log.h>
+
+#include "telemetry_queue.h"
+
+static const char *TAG = "TELEMETRY_QUEUE";
+
+#define FRAME_MAGIC         0x5154
+#define FRAME_HEADER_LEN    12
+#define MAX_FRAME_LEN       (FRAME_HEADER_LEN + TELEMETRY_QUEUE_MAX_RECORD_LEN)
+#define SEGMENT_SUFFIX      ".tql"
+/* "/" + 10 digits + suffix + NUL */
+#define SEGMENT_NAME_LEN    (1 + 10 + sizeof(SEGMENT_SUFFIX))
+
+struct telemetry_queue {
+    telemetry_queue_config_t config;
+    char *path;                 /* Path of the segment being worked on */
+    size_t dir_len;
+
+    uint32_t head_seq;          /* Segment being drained */
+    uint32_t tail_seq;          /* Segment being appended to */
+    size_t tail_size;
+    bool is_tail_closed;        /* Nothing more is appended to the tail, it may end in a torn frame */
+
+    uint8_t *write_buf;         /* Frames not written yet */
+    size_t write_len;
+    size_t write_buf_size;
+    uint32_t first_buffered_ms;
+
+    long read_offset;           /* Start of the records of the head segment not sent yet */
+    bool is_batch_built;
+    long batch_end_offset;
+    uint32_t batch_records;
+    bool has_last_batch_ms;
+    uint32_t last_batch_ms;
+
+    telemetry_queue_stats_t stats;
+};
+
+/* CRC-32 (IEEE), 4 bits at a time */
+static uint32_t crc32_update(uint32_t crc, const uint8_t *data, size_t len)
+{
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+    };
+
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc = (crc >> 4) ^ table[(crc ^ data[i]) & 0x0F];
+        crc = (crc >> 4) ^ table[(crc ^ (data[i] >> 4)) & 0x0F];
+    }
+    return ~crc;
+}
+
+static void put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static uint16_t get_u16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* Frame: magic, record length, timestamp, CRC-32 of timestamp and record, record */
+static size_t encode_frame(uint8_t *frame, uint32_t timestamp, const char *record, size_t len)
+{
+    uint32_t crc;
+
+    put_u16(frame, FRAME_MAGIC);
+    put_u16(frame + 2, (uint16_t)len);
+    put_u32(frame + 4, timestamp);
+    crc = crc32_update(0, frame + 4, 4);
+    crc = crc32_update(crc, (const uint8_t *)record, len);
+    put_u32(frame + 8, crc);
+    memcpy(frame + FRAME_HEADER_LEN, record, len);
+    return FRAME_HEADER_LEN + len;
+}
+
+/* Reads the frame at the file position, false at the end of the segment or a torn frame */
+static bool read_frame(FILE *f, uint8_t *frame, uint32_t *timestamp, size_t *len)
+{
+    uint32_t crc;
+
+    if (fread(frame, 1, FRAME_HEADER_LEN, f) != FRAME_HEADER_LEN || get_u16(frame) != FRAME_MAGIC) {
+        return false;
+    }
+    *len = get_u16(frame + 2);
+    if (*len > TELEMETRY_QUEUE_MAX_RECORD_LEN ||
+        fread(frame + FRAME_HEADER_LEN, 1, *len, f) != *len) {
+        return false;
+    }
+    crc = crc32_update(0, frame + 4, 4);
+    crc = crc32_update(crc, frame + FRAME_HEADER_LEN, *len);
+    if (crc != get_u32(frame + 8)) {
+        return false;
+    }
+    *timestamp = get_u32(frame + 4);
+    return true;
+}
+
+static const char *segment_path(telemetry_queue_t *queue, uint32_t seq)
+{
+    snprintf(queue->path + queue->dir_len, SEGMENT_NAME_LEN, "/%010" PRIu32 SEGMENT_SUFFIX, seq);
+    return queue->path;
+}
+
+static bool parse_segment_name(const char *name, uint32_t *seq)
+{
+    char *end;
+    unsigned long value = strtoul(name, &end, 10);
+
+    if (end == name || strcmp(end, SEGMENT_SUFFIX) != 0) {
+        return false;
+    }
+    *seq = (uint32_t)value;
+    return true;
+}
+
+static size_t segment_size(telemetry_queue_t *queue, uint32_t seq)
+{
+    struct stat st;
+
+    if (stat(segment_path(queue, seq), &st) != 0) {
+        return 0;
+    }
+    return (size_t)st.st_size;
+}
+
+static uint32_t count_segment_records(telemetry_queue_t *queue, uint32_t seq)
+{
+    uint8_t frame[MAX_FRAME_LEN];
+    uint32_t timestamp;
+    size_t len;
+    uint32_t count = 0;
+    FILE *f = fopen(segment_path(queue, seq), "rb");
+
+    if (f == NULL) {
+        return 0;
+    }
+    while (read_frame(f, frame, &timestamp, &len)) {
+        count++;
+    }
+    fclose(f);
+    return count;
+}
+
+static void delete_segment(telemetry_queue_t *queue, uint32_t seq)
+{
+    size_t size = segment_size(queue, seq);
+
+    if (unlink(segment_path(queue, seq)) == 0) {
+        queue->stats.size -= size < queue->stats.size ? size : queue->stats.size;
+        queue->stats.segments_deleted++;
+    }
+}
+
+/* Moves the reader past the head segment once everything in it was read */
+static void advance_head(telemetry_queue_t *queue)
+{
+    delete_segment(queue, queue->head_seq);
+    if (queue->head_seq == queue->tail_seq) {
+        queue->tail_seq++;
+        queue->tail_size = 0;
+        queue->is_tail_closed = false;
+    }
+    queue->head_seq++;
+    queue->read_offset = 0;
+    queue->is_batch_built = false;
+}
+
+/* Drops the oldest segments, drained or not, until the queue fits in max_size again */
+static void enforce_max_size(telemetry_queue_t *queue)
+{
+    uint32_t records;
+
+    while (queue->stats.size > queue->config.max_size && queue->head_seq < queue->tail_seq) {
+        records = count_segment_records(queue, queue->head_seq);
+        ESP_LOGW(TAG, "Queue full, dropping %" PRIu32 " records of segment %" PRIu32, records, queue->head_seq);
+        queue->stats.records_dropped += records;
+        advance_head(queue);
+    }
+}
+
+telemetry_queue_t *telemetry_queue_open(const telemetry_queue_config_t *config)
+{
+    telemetry_queue_t *queue;
+    DIR *dir;
+    struct dirent *entry;
+    uint32_t seq;
+    bool found = false;
+
+    if (config == NULL || config->dir == NULL || config->segment_size == 0) {
+        return NULL;
+    }
+
+    queue = calloc(1, sizeof(telemetry_queue_t));
+    if (queue == NULL) {
+        return NULL;
+    }
+    queue->config = *config;
+    queue->dir_len = strlen(config->dir);
+    queue->path = malloc(queue->dir_len + SEGMENT_NAME_LEN);
+    queue->write_buf_size = config->flush_bytes + MAX_FRAME_LEN;
+    queue->write_buf = malloc(queue->write_buf_size);
+    if (queue->path == NULL || queue->write_buf == NULL) {
+        telemetry_queue_close(queue);
+        return NULL;
+    }
+    memcpy(queue->path, config->dir, queue->dir_len + 1);
+
+    /* SPIFFS has no directories, the segment names just share the prefix */
+    mkdir(config->dir, 0755);
+
+    dir = opendir(config->dir);
+    if (dir == NULL) {
+        ESP_LOGE(TAG, "Cannot open %s", config->dir);
+        telemetry_queue_close(queue);
+        return NULL;
+    }
+    while ((entry = readdir(dir)) != NULL) {
+        if (!parse_segment_name(entry->d_name, &seq)) {
+            continue;
+        }
+        if (!found || seq < queue->head_seq) {
+            queue->head_seq = seq;
+        }
+        if (!found || seq > queue->tail_seq) {
+            queue->tail_seq = seq;
+        }
+        found = true;
+    }
+    closedir(dir);
+
+    if (!found) {
+        queue->head_seq = 1;
+        queue->tail_seq = 1;
+        return queue;
+    }
+
+    for (seq = queue->head_seq; seq <= queue->tail_seq; seq++) {
+        queue->stats.size += segment_size(queue, seq);
+        queue->stats.records_recovered += count_segment_records(queue, seq);
+    }
+    queue->stats.max_size_used = queue->stats.size;
+    queue->tail_size = segment_size(queue, queue->tail_seq);
+    /* The last segment may end in a frame torn by the reset, new records go to a new one */
+    queue->is_tail_closed = true;
+
+    ESP_LOGI(TAG, "Recovered %" PRIu32 " records in segments %" PRIu32 " to %" PRIu32,
+             queue->stats.records_recovered, queue->head_seq, queue->tail_seq);
+    return queue;
+}
+
+void telemetry_queue_close(telemetry_queue_t *queue)
+{
+    if (queue == NULL) {
+        return;
+    }
+    if (queue->path != NULL && queue->write_buf != NULL) {
+        telemetry_queue_flush(queue);
+    }
+    free(queue->write_buf);
+    free(queue->path);
+    free(queue);
+}
+
+esp_err_t telemetry_queue_flush(telemetry_queue_t *queue)
+{
+    FILE *f;
+    size_t written;
+
+    if (queue->write_len == 0) {
+        return ESP_OK;
+    }
+
+    if (queue->is_tail_closed || (queue->tail_size > 0 &&
+                                  queue->tail_size + queue->write_len > queue->config.segment_size)) {
+        queue->tail_seq++;
+        queue->tail_size = 0;
+        queue->is_tail_closed = false;
+    }
+
+    f = fopen(segment_path(queue, queue->tail_seq), "ab");
+    if (f == NULL) {
+        ESP_LOGW(TAG, "Cannot open segment %" PRIu32, queue->tail_seq);
+        return ESP_FAIL;
+    }
+    if (queue->tail_size == 0) {
+        queue->stats.segments_created++;
+    }
+    written = fwrite(queue->write_buf, 1, queue->write_len, f);
+    queue->tail_size += written;
+    queue->stats.size += written;
+    queue->stats.flash_writes++;
+    queue->stats.flash_bytes_written += written;
+    if (fclose(f) != 0 || written != queue->write_len) {
+        /* Whatever made it is followed by the same records again in the next segment */
+        ESP_LOGW(TAG, "Writing segment %" PRIu32 " failed", queue->tail_seq);
+        queue->is_tail_closed = true;
+        return ESP_FAIL;
+    }
+    queue->write_len = 0;
+
+    enforce_max_size(queue);
+    if (queue->stats.size > queue->stats.max_size_used) {
+        queue->stats.max_size_used = queue->stats.size;
+    }
+    return ESP_OK;
+}
+
+esp_err_t telemetry_queue_append(telemetry_queue_t *queue, uint32_t timestamp, const char *record, size_t len,
+                                 uint32_t now_ms)
+{
+    if (len > TELEMETRY_QUEUE_MAX_RECORD_LEN) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    if (queue->write_len + FRAME_HEADER_LEN + len > queue->write_buf_size &&
+        telemetry_queue_flush(queue) != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    if (queue->write_len == 0) {
+        queue->first_buffered_ms = now_ms;
+    }
+    queue->write_len += encode_frame(queue->write_buf + queue->write_len, timestamp, record, len);
+    queue->stats.records_appended++;
+
+    if (queue->write_len >= queue->config.flush_bytes ||
+        now_ms - queue->first_buffered_ms >= queue->config.flush_interval_ms) {
+        return telemetry_queue_flush(queue);
+    }
+    return ESP_OK;
+}
+
+size_t telemetry_queue_next_batch(telemetry_queue_t *queue, uint32_t now_ms, char *payload, size_t payload_len)
+{
+    uint8_t frame[MAX_FRAME_LEN];
+    char element[24];
+    uint32_t timestamp, t0 = 0;
+    size_t len, element_len, batch_len;
+    long offset;
+    FILE *f;
+
+    if (queue->has_last_batch_ms && now_ms - queue->last_batch_ms < queue->config.drain_interval_ms) {
+        return 0;
+    }
+
+    /* Records still in RAM are drained from the file system like the others */
+    if (telemetry_queue_flush(queue) != ESP_OK && queue->head_seq == queue->tail_seq &&
+        queue->read_offset >= (long)queue->tail_size) {
+        return 0;
+    }
+
+    for (;;) {
+        if (queue->head_seq == queue->tail_seq && queue->read_offset >= (long)queue->tail_size) {
+            if (queue->tail_size > 0) {
+                advance_head(queue);
+            }
+            return 0;
+        }
+
+        f = fopen(segment_path(queue, queue->head_seq), "rb");
+        if (f == NULL || fseek(f, queue->read_offset, SEEK_SET) != 0) {
+            if (f != NULL) {
+                fclose(f);
+            }
+            if (queue->head_seq == queue->tail_seq) {
+                return 0;
+            }
+            advance_head(queue);
+            continue;
+        }
+
+        batch_len = 0;
+        queue->batch_records = 0;
+        offset = queue->read_offset;
+        while (read_frame(f, frame, &timestamp, &len)) {
+            if (queue->batch_records == 0) {
+                t0 = timestamp;
+                batch_len = (size_t)snprintf(payload, payload_len, "{\"t0\":%" PRIu32 ",\"records\":[", t0);
+            }
+            element_len = (size_t)snprintf(element, sizeof(element), "%s[%" PRId32 ",",
+                                           queue->batch_records > 0 ? "," : "", (int32_t)(timestamp - t0));
+            /* Room for the element and the closing "]}" */
+            if (batch_len >= payload_len || batch_len + element_len + len + 1 + 2 > payload_len) {
+                if (queue->batch_records == 0) {
+                    ESP_LOGW(TAG, "Record of %u bytes does not fit in a batch, skipped", (unsigned)len);
+                    queue->stats.records_skipped++;
+                    offset = ftell(f);
+                    queue->read_offset = offset;
+                    continue;
+                }
+                break;
+            }
+            memcpy(payload + batch_len, element, element_len);
+            batch_len += element_len;
+            memcpy(payload + batch_len, frame + FRAME_HEADER_LEN, len);
+            batch_len += len;
+            payload[batch_len++] = ']';
+            offset = ftell(f);
+            queue->batch_records++;
+            if (queue->batch_records == queue->config.batch_max_records) {
+                break;
+            }
+        }
+        fclose(f);
+
+        if (queue->batch_records > 0) {
+            payload[batch_len++] = ']';
+            payload[batch_len++] = '}';
+            queue->batch_end_offset = offset;
+            queue->is_batch_built = true;
+            queue->has_last_batch_ms = true;
+            queue->last_batch_ms = now_ms;
+            return batch_len;
+        }
+
+        /* Nothing readable past read_offset: the end of the segment or a torn frame */
+        if (queue->head_seq == queue->tail_seq && !queue->is_tail_closed) {
+            if (queue->read_offset >= (long)queue->tail_size) {
+                advance_head(queue);
+            }
+            return 0;
+        }
+        advance_head(queue);
+    }
+}
+
+void telemetry_queue_commit_batch(telemetry_queue_t *queue)
+{
+    if (!queue->is_batch_built) {
+        return;
+    }
+    queue->is_batch_built = false;
+    queue->read_offset = queue->batch_end_offset;
+    queue->stats.records_sent += queue->batch_records;
+    queue->stats.batches_sent++;
+
+    /* A drained tail is deleted right away so an idle queue takes no space */
+    if (queue->head_seq == queue->tail_seq && queue->write_len == 0 &&
+        queue->read_offset >= (long)queue->tail_size) {
+        advance_head(queue);
+    }
+}
+
+bool telemetry_queue_is_empty(const telemetry_queue_t *queue)
+{
+    return queue->write_len == 0 && queue->head_seq == queue->tail_seq &&
+           queue->read_offset >= (long)queue->tail_size;
+}
+
+void telemetry_queue_get_stats(const telemetry_queue_t *queue, telemetry_queue_stats_t *stats)
+{
+    *stats = queue->stats;
+}
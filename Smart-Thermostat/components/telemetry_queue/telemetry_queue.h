@@ -0,0 +1,176 @@
+/*
+ * AWS IoT EduKit - Core2 for AWS IoT EduKit
+ * Smart Thermostat v1.2.1
+ * telemetry_queue.h
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#ifndef _TELEMETRY_QUEUE_H_
+#define _TELEMETRY_QUEUE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <esp_err.h>
+#include <sdkconfig.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Store-and-forward queue for readings taken while the device is offline.
+ *
+ * Records are appended to numbered segment files in a directory of a mounted file system (SPIFFS or
+ * the SD card). Each record is framed with its length, timestamp and CRC-32, so a write torn by a
+ * reset ends the segment instead of corrupting what follows. Records are collected in RAM and
+ * written in blocks of at least flush_bytes, or after flush_interval_ms, and a file is never
+ * rewritten: segments are deleted once drained.
+ *
+ * Drained records are compacted into one JSON payload per batch:
+ * {"t0":<first timestamp>,"records":[[<timestamp - t0>,<record>],...]}
+ * where each record is the JSON value it was appended with. The queue does not publish, the
+ * caller sends the batch and commits it once delivered, at most one batch per drain_interval_ms.
+ *
+ * The drain position is only persisted by deleting segments, so after a reset the oldest segment
+ * is sent again from its start: records can be delivered twice, but none are lost once flushed.
+ */
+
+#ifndef CONFIG_TELEMETRY_QUEUE_SEGMENT_SIZE
+#define CONFIG_TELEMETRY_QUEUE_SEGMENT_SIZE 16384
+#endif
+
+#ifndef CONFIG_TELEMETRY_QUEUE_MAX_SIZE
+#define CONFIG_TELEMETRY_QUEUE_MAX_SIZE 1048576
+#endif
+
+#ifndef CONFIG_TELEMETRY_QUEUE_FLUSH_BYTES
+#define CONFIG_TELEMETRY_QUEUE_FLUSH_BYTES 1024
+#endif
+
+#ifndef CONFIG_TELEMETRY_QUEUE_FLUSH_INTERVAL_MS
+#define CONFIG_TELEMETRY_QUEUE_FLUSH_INTERVAL_MS 30000
+#endif
+
+#ifndef CONFIG_TELEMETRY_QUEUE_DRAIN_INTERVAL_MS
+#define CONFIG_TELEMETRY_QUEUE_DRAIN_INTERVAL_MS 250
+#endif
+
+/* Longest record, in bytes of JSON */
+#define TELEMETRY_QUEUE_MAX_RECORD_LEN 240
+
+typedef struct {
+    const char *dir;                /* Directory of the segment files, created if missing */
+    size_t segment_size;            /* Bytes after which a new segment file is started */
+    size_t max_size;                /* Bytes on the file system, the oldest segments are dropped beyond this */
+    size_t flush_bytes;             /* Bytes collected in RAM before they are written */
+    uint32_t flush_interval_ms;     /* Longest time a record stays in RAM only */
+    uint32_t drain_interval_ms;     /* Shortest time between two batches */
+    uint32_t batch_max_records;     /* Records in a batch at most, 0 for as many as fit */
+} telemetry_queue_config_t;
+
+#define TELEMETRY_QUEUE_DEFAULT_CONFIG(directory) {             \
+    .dir = (directory),                                         \
+    .segment_size = CONFIG_TELEMETRY_QUEUE_SEGMENT_SIZE,        \
+    .max_size = CONFIG_TELEMETRY_QUEUE_MAX_SIZE,                \
+    .flush_bytes = CONFIG_TELEMETRY_QUEUE_FLUSH_BYTES,          \
+    .flush_interval_ms = CONFIG_TELEMETRY_QUEUE_FLUSH_INTERVAL_MS, \
+    .drain_interval_ms = CONFIG_TELEMETRY_QUEUE_DRAIN_INTERVAL_MS, \
+    .batch_max_records = 0,                                     \
+}
+
+typedef struct {
+    uint32_t records_appended;      /* Records passed to telemetry_queue_append */
+    uint32_t records_sent;          /* Records in committed batches */
+    uint32_t records_skipped;       /* Records too large for the batch buffer */
+    uint32_t records_dropped;       /* Records deleted before they were drained, to stay under max_size */
+    uint32_t records_recovered;     /* Records found on the file system when the queue was opened */
+    uint32_t batches_sent;          /* Committed batches */
+    uint32_t flash_writes;          /* Blocks written to the file system */
+    uint32_t flash_bytes_written;   /* Bytes written to the file system */
+    uint32_t segments_created;
+    uint32_t segments_deleted;
+    size_t size;                    /* Bytes of the segments on the file system */
+    size_t max_size_used;           /* Largest size seen */
+} telemetry_queue_stats_t;
+
+typedef struct telemetry_queue telemetry_queue_t;
+
+/**
+ * @brief   Open the queue, picking up the segments left by a previous run
+ *
+ * @param   config  Directory and limits, dir must stay valid while the queue is open
+ *
+ * @return  The queue, or NULL if the directory cannot be used or memory is short
+ */
+telemetry_queue_t *telemetry_queue_open(const telemetry_queue_config_t *config);
+
+/**
+ * @brief   Write what is still in RAM and close the queue
+ */
+void telemetry_queue_close(telemetry_queue_t *queue);
+
+/**
+ * @brief   Append a record
+ *
+ * @param   timestamp   Time of the reading, in seconds
+ * @param   record      JSON value of the reading, for example an object of the sensor values
+ * @param   len         Length of record, at most TELEMETRY_QUEUE_MAX_RECORD_LEN
+ * @param   now_ms      Current time, to write the records collected in RAM after flush_interval_ms
+ *
+ * @return  ESP_OK, ESP_ERR_INVALID_SIZE if the record is too long or ESP_FAIL if writing failed.
+ *          Records that could not be written stay in RAM and are written with the next ones.
+ */
+esp_err_t telemetry_queue_append(telemetry_queue_t *queue, uint32_t timestamp, const char *record, size_t len,
+                                 uint32_t now_ms);
+
+/**
+ * @brief   Write the records collected in RAM
+ */
+esp_err_t telemetry_queue_flush(telemetry_queue_t *queue);
+
+/**
+ * @brief   Build the next batch of the oldest records
+ *
+ * The same batch is built again until it is committed, so a failed publish is retried by calling
+ * this again.
+ *
+ * @param   now_ms      Current time, no batch is built within drain_interval_ms of the previous one
+ * @param   payload     Buffer of the batch, not NUL terminated
+ * @param   payload_len Size of the buffer
+ *
+ * @return  Length of the batch, 0 if the queue is empty or the next batch is not due
+ */
+size_t telemetry_queue_next_batch(telemetry_queue_t *queue, uint32_t now_ms, char *payload, size_t payload_len);
+
+/**
+ * @brief   Drop the records of the batch built last, once it was delivered
+ */
+void telemetry_queue_commit_batch(telemetry_queue_t *queue);
+
+/**
+ * @brief   Whether no records are waiting to be drained
+ */
+bool telemetry_queue_is_empty(const telemetry_queue_t *queue);
+
+/**
+ * @brief   Counters since the queue was opened
+ */
+void telemetry_queue_get_stats(const telemetry_queue_t *queue, telemetry_queue_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TELEMETRY_QUEUE_H_ */
@@ -0,0 +1,9 @@
+/* Host stand-in for the ESP-IDF log, warnings are expected when the tests drop records */
+#pragma once
+
+#include <stdio.h>
+
+#define ESP_LOGE(tag, fmt, ...) printf("E %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) printf("W %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...)
+#define ESP_LOGD(tag, fmt, ...)
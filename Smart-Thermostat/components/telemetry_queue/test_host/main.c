@@ -0,0 +1,350 @@
+/*
+ * AWS IoT EduKit - Core2 for AWS IoT EduKit
+ * Smart Thermostat v1.2.1
+ * test_host/main.c
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/*
+ * A 1 hour outage with the thermostat sampling at 1 Hz, drained through a simulated MQTT client after
+ * the connection is back. Checks that every reading arrives once and in order, how often and how much
+ * the queue writes to flash, and how fast the backlog drains. Time is simulated, the segments go to a
+ * temporary directory.
+ */
+
+#include <dirent.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "telemetry_queue.h"
+
+#define OUTAGE_SECONDS      3600
+#define SAMPLE_PERIOD_MS    1000
+#define DRAIN_STEP_MS       10
+#define BATCH_BUFFER_LEN    2048
+#define START_TIMESTAMP     1700000000u
+/* MQTT PUBLISH header, topic "<18 character client id>/telemetry", packet id and TLS record overhead */
+#define TOPIC_LEN           28
+#define PUBLISH_OVERHEAD    (2 + 2 + TOPIC_LEN + 2 + 29)
+/* Every this many publishes fails and is retried */
+#define PUBLISH_FAIL_EVERY  7
+
+static char dir_template[] = "/tmp/telemetry_queue_XXXXXX";
+static char *dir;
+static int failed;
+
+static void check(bool ok, const char *what)
+{
+    printf("%-60s %s\n", what, ok ? "ok" : "FAILED");
+    failed += !ok;
+}
+
+static void empty_dir(void)
+{
+    char path[300];
+    struct dirent *entry;
+    DIR *d = opendir(dir);
+
+    while ((entry = readdir(d)) != NULL) {
+        if (entry->d_name[0] != '.') {
+            snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+            unlink(path);
+        }
+    }
+    closedir(d);
+}
+
+static int count_files(void)
+{
+    int count = 0;
+    struct dirent *entry;
+    DIR *d = opendir(dir);
+
+    while ((entry = readdir(d)) != NULL) {
+        count += entry->d_name[0] != '.';
+    }
+    closedir(d);
+    return count;
+}
+
+/* A reading as main.c appends it, with its sample number to check the order */
+static size_t make_record(char *record, size_t len, uint32_t seq)
+{
+    return (size_t)snprintf(record, len, "{\"seq\":%u,\"temperature\":%.1f,\"sound\":%u}",
+                            (unsigned)seq, 68.0 + (seq % 50) / 10.0, (unsigned)(seq * 7 % 256));
+}
+
+/* What the cloud side received */
+typedef struct {
+    uint32_t next_seq;      /* Sample expected next */
+    uint32_t received;
+    uint32_t duplicates;
+    uint32_t out_of_order;
+    uint32_t bad_timestamps;
+    uint32_t publishes;
+    uint32_t failed_publishes;
+    uint64_t payload_bytes;
+} receiver_t;
+
+/* Checks a batch: {"t0":<ts>,"records":[[<dt>,{"seq":<n>,...}],...]} */
+static void receive_batch(receiver_t *rx, const char *payload, size_t len)
+{
+    char buf[BATCH_BUFFER_LEN + 1];
+    const char *p;
+    unsigned t0, dt, seq;
+
+    memcpy(buf, payload, len);
+    buf[len] = 0;
+    if (sscanf(buf, "{\"t0\":%u,\"records\":[", &t0) != 1) {
+        rx->bad_timestamps++;
+        return;
+    }
+    /* p points to the "[" of a record */
+    p = strstr(buf, "[[");
+    p = p != NULL ? p + 1 : NULL;
+    while (p != NULL && sscanf(p, "[%u,{\"seq\":%u", &dt, &seq) == 2) {
+        if (t0 + dt != START_TIMESTAMP + seq) {
+            rx->bad_timestamps++;
+        }
+        if (seq < rx->next_seq) {
+            rx->duplicates++;
+        } else {
+            rx->out_of_order += seq != rx->next_seq;
+            rx->received++;
+            rx->next_seq = seq + 1;
+        }
+        p = strstr(p, "],[");
+        p = p != NULL ? p + 2 : NULL;
+    }
+    rx->payload_bytes += len;
+}
+
+/* Drains the queue from now_ms on like the main loop does while connected, returns the time it took */
+static uint32_t drain(telemetry_queue_t *queue, receiver_t *rx, uint32_t now_ms, uint32_t max_batches)
+{
+    char payload[BATCH_BUFFER_LEN];
+    uint32_t start_ms = now_ms;
+    uint32_t batches = 0;
+    size_t len;
+
+    while (!telemetry_queue_is_empty(queue) && batches < max_batches) {
+        len = telemetry_queue_next_batch(queue, now_ms, payload, sizeof(payload));
+        if (len > 0) {
+            rx->publishes++;
+            if (rx->publishes % PUBLISH_FAIL_EVERY == 0) {
+                rx->failed_publishes++;
+            } else {
+                receive_batch(rx, payload, len);
+                telemetry_queue_commit_batch(queue);
+                batches++;
+            }
+        }
+        now_ms += DRAIN_STEP_MS;
+    }
+    return now_ms - start_ms;
+}
+
+static uint32_t append_samples(telemetry_queue_t *queue, uint32_t first_seq, uint32_t count, uint32_t *now_ms,
+                               uint64_t *frame_bytes)
+{
+    char record[TELEMETRY_QUEUE_MAX_RECORD_LEN];
+    size_t len;
+    uint32_t errors = 0;
+
+    for (uint32_t seq = first_seq; seq < first_seq + count; seq++) {
+        len = make_record(record, sizeof(record), seq);
+        errors += telemetry_queue_append(queue, START_TIMESTAMP + seq, record, len, *now_ms) != ESP_OK;
+        if (frame_bytes != NULL) {
+            *frame_bytes += 12 + len;
+        }
+        *now_ms += SAMPLE_PERIOD_MS;
+    }
+    return errors;
+}
+
+static void check_outage(void)
+{
+    telemetry_queue_config_t config = TELEMETRY_QUEUE_DEFAULT_CONFIG(dir);
+    telemetry_queue_stats_t stats;
+    receiver_t rx = { 0 };
+    uint64_t frame_bytes = 0;
+    uint32_t now_ms = 0, drain_ms, errors;
+    uint32_t max_writes;
+    clock_t cpu;
+    telemetry_queue_t *queue = telemetry_queue_open(&config);
+
+    printf("\n1 hour outage at 1 Hz\n");
+    check(queue != NULL, "open");
+    errors = append_samples(queue, 0, OUTAGE_SECONDS, &now_ms, &frame_bytes);
+    check(errors == 0, "3600 samples appended");
+
+    cpu = clock();
+    drain_ms = drain(queue, &rx, now_ms, UINT32_MAX);
+    cpu = clock() - cpu;
+    telemetry_queue_get_stats(queue, &stats);
+
+    check(rx.received == OUTAGE_SECONDS && rx.next_seq == OUTAGE_SECONDS, "every sample received");
+    check(rx.duplicates == 0 && rx.out_of_order == 0, "once and in order, failed publishes retried");
+    check(rx.bad_timestamps == 0, "timestamps kept");
+    check(stats.records_sent == OUTAGE_SECONDS && stats.records_dropped == 0 && stats.records_skipped == 0,
+          "queue counters match");
+
+    /* A write per flush block, plus the partial block closing each segment */
+    max_writes = (uint32_t)((frame_bytes + config.flush_bytes - 1) / config.flush_bytes) + stats.segments_created;
+    check(stats.flash_writes <= max_writes, "flash writes bounded by block size");
+    check(stats.flash_bytes_written == frame_bytes, "every byte written once");
+    check(stats.max_size_used <= config.max_size, "size within max_size");
+    check(stats.size == 0 && count_files() == 0, "drained segments deleted");
+    /* One batch per drain interval, the failed ones sent again */
+    check(drain_ms >= (rx.publishes - 1) * config.drain_interval_ms &&
+          drain_ms <= (rx.publishes + 1) * config.drain_interval_ms, "drain paced by drain_interval_ms");
+
+    printf("flash: %u writes of %.0f bytes average, %u bytes, %u segments (per sample writes: %u)\n",
+           (unsigned)stats.flash_writes, (double)stats.flash_bytes_written / stats.flash_writes,
+           (unsigned)stats.flash_bytes_written, (unsigned)stats.segments_created, OUTAGE_SECONDS);
+    printf("drain: %u batches (%u failed and retried) in %.1f s simulated, %.0f samples/s, %.2f ms CPU per batch\n",
+           (unsigned)rx.publishes, (unsigned)rx.failed_publishes, drain_ms / 1000.0,
+           OUTAGE_SECONDS * 1000.0 / drain_ms, 1000.0 * cpu / CLOCKS_PER_SEC / rx.publishes);
+    printf("sent:  %.0f bytes batched, against %.0f bytes as one publish per sample\n",
+           (double)rx.payload_bytes + (rx.publishes - rx.failed_publishes) * PUBLISH_OVERHEAD,
+           (double)(frame_bytes - 12 * OUTAGE_SECONDS) + (double)OUTAGE_SECONDS * PUBLISH_OVERHEAD);
+
+    telemetry_queue_close(queue);
+}
+
+/* The device resets while offline: flushed records survive, a torn frame is skipped */
+static void check_reset_while_offline(void)
+{
+    telemetry_queue_config_t config = TELEMETRY_QUEUE_DEFAULT_CONFIG(dir);
+    telemetry_queue_stats_t stats;
+    receiver_t rx = { 0 };
+    uint32_t now_ms = 0;
+    char path[300];
+    FILE *f;
+    struct dirent *entry;
+    DIR *d;
+    telemetry_queue_t *queue = telemetry_queue_open(&config);
+
+    printf("\nReset while offline\n");
+    append_samples(queue, 0, 1000, &now_ms, NULL);
+    telemetry_queue_flush(queue);
+    /* Lost with the reset: in RAM only */
+    append_samples(queue, 1000, 5, &now_ms, NULL);
+    /* Abandoned without closing, as by a reset */
+    free(queue);
+
+    /* A frame torn by the reset at the end of the last segment */
+    d = opendir(dir);
+    while ((entry = readdir(d)) != NULL) {
+        if (entry->d_name[0] != '.') {
+            snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+        }
+    }
+    closedir(d);
+    f = fopen(path, "ab");
+    fwrite("\x54\x51\x20\x00\x01\x02", 1, 6, f);
+    fclose(f);
+
+    queue = telemetry_queue_open(&config);
+    telemetry_queue_get_stats(queue, &stats);
+    check(stats.records_recovered == 1000, "flushed records recovered");
+
+    /* Sampling goes on after the reset, from the samples lost in RAM on */
+    now_ms = 0;
+    append_samples(queue, 1005, 100, &now_ms, NULL);
+    rx.next_seq = 0;
+    drain(queue, &rx, now_ms, UINT32_MAX);
+    check(rx.received == 1100 && rx.next_seq == 1105, "recovered and new records drained");
+    check(rx.out_of_order == 1 && rx.duplicates == 0, "only the records in RAM lost");
+    check(count_files() == 0, "segments deleted");
+    telemetry_queue_close(queue);
+}
+
+/* The device resets while draining: the segment being drained is sent again */
+static void check_reset_while_draining(void)
+{
+    telemetry_queue_config_t config = TELEMETRY_QUEUE_DEFAULT_CONFIG(dir);
+    receiver_t rx = { 0 };
+    uint32_t now_ms = 0;
+    uint32_t received_before;
+    char line[80];
+    telemetry_queue_t *queue = telemetry_queue_open(&config);
+
+    printf("\nReset while draining\n");
+    append_samples(queue, 0, OUTAGE_SECONDS, &now_ms, NULL);
+    telemetry_queue_flush(queue);
+    drain(queue, &rx, now_ms, 20);
+    received_before = rx.received;
+    /* Abandoned without closing, as by a reset */
+    free(queue);
+
+    queue = telemetry_queue_open(&config);
+    drain(queue, &rx, now_ms, UINT32_MAX);
+    check(rx.received == OUTAGE_SECONDS && rx.out_of_order == 0, "every sample received");
+    snprintf(line, sizeof(line), "%u sent again after %u", (unsigned)rx.duplicates, (unsigned)received_before);
+    check(rx.duplicates < received_before && rx.duplicates < config.segment_size / 50, line);
+    telemetry_queue_close(queue);
+}
+
+/* A longer outage than max_size holds drops the oldest records, and counts them */
+static void check_max_size(void)
+{
+    telemetry_queue_config_t config = TELEMETRY_QUEUE_DEFAULT_CONFIG(dir);
+    telemetry_queue_stats_t stats;
+    receiver_t rx = { 0 };
+    uint32_t now_ms = 0;
+    telemetry_queue_t *queue;
+
+    printf("\nOutage beyond max_size\n");
+    config.max_size = 64 * 1024;
+    queue = telemetry_queue_open(&config);
+    append_samples(queue, 0, OUTAGE_SECONDS, &now_ms, NULL);
+    telemetry_queue_get_stats(queue, &stats);
+    check(stats.max_size_used <= config.max_size + config.flush_bytes + 12 + TELEMETRY_QUEUE_MAX_RECORD_LEN,
+          "size held at max_size");
+    check(stats.records_dropped > 0, "oldest records dropped");
+
+    rx.next_seq = stats.records_dropped;
+    drain(queue, &rx, now_ms, UINT32_MAX);
+    telemetry_queue_get_stats(queue, &stats);
+    check(rx.received == OUTAGE_SECONDS - stats.records_dropped && rx.out_of_order == 0,
+          "the newest records received");
+    check(stats.records_sent + stats.records_dropped == stats.records_appended, "every record accounted for");
+    telemetry_queue_close(queue);
+}
+
+int main(void)
+{
+    dir = mkdtemp(dir_template);
+    if (dir == NULL) {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    check_outage();
+    empty_dir();
+    check_reset_while_offline();
+    empty_dir();
+    check_reset_while_draining();
+    empty_dir();
+    check_max_size();
+    empty_dir();
+    rmdir(dir);
+
+    printf(failed ? "%d checks failed\n" : "All checks passed\n", failed);
+    return failed ? 1 : 0;
+}
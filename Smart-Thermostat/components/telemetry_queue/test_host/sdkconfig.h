@@ -0,0 +1 @@
+/* Host build: the queue uses its default configuration */
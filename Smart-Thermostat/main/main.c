@@ -33,20 +33,24 @@
 #include <limits.h>
 #include <string.h>
 #include <math.h>
+#include <time.h>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
 #include "freertos/event_groups.h"
 #include "esp_log.h"
+#include "esp_spiffs.h"
 
 #include "aws_iot_config.h"
 #include "aws_iot_log.h"
 #include "aws_iot_version.h"
 #include "aws_iot_mqtt_client_interface.h"
 #include "aws_iot_shadow_interface.h"
+#include "aws_iot_shadow_reporter.h"
 
 #include "core2forAWS.h"
+#include "telemetry_queue.h"
 
 #include "wifi.h"
 #include "fft.h"
@@ -68,6 +72,18 @@ static const char *TAG = "MAIN";
 
 #define MAX_LENGTH_OF_UPDATE_JSON_BUFFER 200
 
+// Readings taken while disconnected are queued here and sent in batches once reconnected
+#if CONFIG_TELEMETRY_STORAGE_SDCARD
+#define TELEMETRY_MOUNT_POINT "/sdcard"
+#else
+#define TELEMETRY_MOUNT_POINT "/spiffs"
+#endif
+#define TELEMETRY_DIR TELEMETRY_MOUNT_POINT "/telemetry"
+#define TELEMETRY_TOPIC_SUFFIX "/telemetry"
+#define MAX_LENGTH_OF_TELEMETRY_BATCH 2048
+// Batches sent per pass of the loop at most, so draining a backlog doesn't hold off the shadow
+#define TELEMETRY_BATCHES_PER_LOOP 4
+
 /* CA Root certificate */
 extern const uint8_t aws_root_ca_pem_start[] asm("_binary_aws_root_ca_pem_start");
 extern const uint8_t aws_root_ca_pem_end[] asm("_binary_aws_root_ca_pem_end");
@@ -112,26 +128,6 @@ void disconnect_callback_handler(AWS_IoT_Client *pClient, void *data) {
     }
 }
 
-static bool shadowUpdateInProgress;
-
-void ShadowUpdateStatusCallback(const char *pThingName, ShadowActions_t action, Shadow_Ack_Status_t status,
-                                const char *pReceivedJsonDocument, void *pContextData) {
-    IOT_UNUSED(pThingName);
-    IOT_UNUSED(action);
-    IOT_UNUSED(pReceivedJsonDocument);
-    IOT_UNUSED(pContextData);
-
-    shadowUpdateInProgress = false;
-
-    if(SHADOW_ACK_TIMEOUT == status) {
-        ESP_LOGE(TAG, "Update timed out");
-    } else if(SHADOW_ACK_REJECTED == status) {
-        ESP_LOGE(TAG, "Update rejected");
-    } else if(SHADOW_ACK_ACCEPTED == status) {
-        ESP_LOGI(TAG, "Update accepted");
-    }
-}
-
 void hvac_Callback(const char *pJsonString, uint32_t JsonStringDataLen, jsonStruct_t *pContext) {
     IOT_UNUSED(pJsonString);
     IOT_UNUSED(JsonStringDataLen);
@@ -193,24 +189,27 @@ void microphone_task(void *arg) {
     uint8_t maxSound = 0x00;
     uint8_t currentSound = 0x00;
 
+    // Plan, twiddle factors and buffers are built once; per-frame processing is allocation free
+    spectrum_config_t *spectrum = spectrum_init(512, SPECTRUM_BACKEND_FLOAT, SPECTRUM_WINDOW_NONE, 2000.0f / 65535.0f, NULL, NULL, NULL);
+    if (spectrum == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate the spectrum engine");
+        vTaskDelete(NULL);
+        return;
+    }
+
     for (;;) {
         maxSound = 0x00;
-        fft_config_t *real_fft_plan = fft_init(512, FFT_REAL, FFT_FORWARD, NULL, NULL);
         i2s_read(I2S_NUM_0, (char *)i2s_readraw_buff, 1024, &bytesread, pdMS_TO_TICKS(100));
         buffptr = (int16_t *)i2s_readraw_buff;
-        for (uint16_t count_n = 0; count_n < real_fft_plan->size; count_n++) {
-            real_fft_plan->input[count_n] = (float)map(buffptr[count_n], INT16_MIN, INT16_MAX, -1000, 1000);
-        }
-        fft_execute(real_fft_plan);
+        spectrum_process(spectrum, buffptr);
 
         for (uint16_t count_n = 1; count_n < AUDIO_TIME_SLICES; count_n++) {
-            data = sqrt(real_fft_plan->output[2 * count_n] * real_fft_plan->output[2 * count_n] + real_fft_plan->output[2 * count_n + 1] * real_fft_plan->output[2 * count_n + 1]);
+            data = spectrum->magnitude[count_n];
             currentSound = map(data, 0, 2000, 0, 256);
             if(currentSound > maxSound) {
                 maxSound = currentSound;
             }
         }
-        fft_destroy(real_fft_plan);
 
         // store max of sample in semaphore
         xSemaphoreTake(xMaxNoiseSemaphore, portMAX_DELAY);
@@ -219,6 +218,147 @@ void microphone_task(void *arg) {
     }
 }
 
+static telemetry_queue_t *telemetryQueue;
+
+// The SD card shares the SPI bus with the display, file access has to hold the bus
+static void telemetry_storage_lock() {
+#if CONFIG_TELEMETRY_STORAGE_SDCARD
+    xSemaphoreTake(spi_mutex, portMAX_DELAY);
+    spi_poll();
+#endif
+}
+
+static void telemetry_storage_unlock() {
+#if CONFIG_TELEMETRY_STORAGE_SDCARD
+    xSemaphoreGive(spi_mutex);
+#endif
+}
+
+static esp_err_t telemetry_storage_mount() {
+#if CONFIG_TELEMETRY_STORAGE_SDCARD
+    sdmmc_card_t *card;
+
+    telemetry_storage_lock();
+    esp_err_t err = Core2ForAWS_SDcard_Mount(TELEMETRY_MOUNT_POINT, &card);
+    telemetry_storage_unlock();
+    return err;
+#else
+    esp_vfs_spiffs_conf_t conf = {
+        .base_path = TELEMETRY_MOUNT_POINT,
+        .partition_label = NULL,
+        .max_files = 4,
+        .format_if_mount_failed = true
+    };
+
+    return esp_vfs_spiffs_register(&conf);
+#endif
+}
+
+static void telemetry_init() {
+    telemetry_queue_config_t config = TELEMETRY_QUEUE_DEFAULT_CONFIG(TELEMETRY_DIR);
+
+    esp_err_t err = telemetry_storage_mount();
+    if(ESP_OK != err) {
+        ESP_LOGE(TAG, "Failed to mount %s (%s), readings taken offline will be lost", TELEMETRY_MOUNT_POINT, esp_err_to_name(err));
+        return;
+    }
+
+    telemetry_storage_lock();
+    telemetryQueue = telemetry_queue_open(&config);
+    telemetry_storage_unlock();
+    if(NULL == telemetryQueue) {
+        ESP_LOGE(TAG, "Failed to open the telemetry queue, readings taken offline will be lost");
+    }
+}
+
+static uint32_t telemetry_timestamp() {
+#if CONFIG_SOFTWARE_RTC_SUPPORT
+    rtc_date_t date;
+    struct tm tm = { 0 };
+
+    BM8563_GetTime(&date);
+    tm.tm_year = date.year - 1900;
+    tm.tm_mon = date.month - 1;
+    tm.tm_mday = date.day;
+    tm.tm_hour = date.hour;
+    tm.tm_min = date.minute;
+    tm.tm_sec = date.second;
+    return (uint32_t) mktime(&tm);
+#else
+    return (uint32_t) time(NULL);
+#endif
+}
+
+static void read_sensors() {
+    // sample temperature, convert to fahrenheit
+    MPU6886_GetTempData(&temperature);
+    temperature = (temperature * 1.8)  + 32 - 50;
+
+    // sample from soundBuffer (latest reading from microphone)
+    xSemaphoreTake(xMaxNoiseSemaphore, portMAX_DELAY);
+    reportedSound = soundBuffer;
+    xSemaphoreGive(xMaxNoiseSemaphore);
+}
+
+// Take a reading while disconnected and queue it until the connection is back
+static void telemetry_store_reading() {
+    char record[TELEMETRY_QUEUE_MAX_RECORD_LEN];
+
+    if(NULL == telemetryQueue) {
+        return;
+    }
+
+    read_sensors();
+    int len = snprintf(record, sizeof(record), "{\"temperature\":%.2f,\"sound\":%d}", temperature, reportedSound);
+
+    telemetry_storage_lock();
+    esp_err_t err = telemetry_queue_append(telemetryQueue, telemetry_timestamp(), record, len,
+                                           xTaskGetTickCount() * portTICK_PERIOD_MS);
+    telemetry_storage_unlock();
+    if(ESP_OK != err) {
+        ESP_LOGW(TAG, "Failed to queue reading (%s)", esp_err_to_name(err));
+    }
+}
+
+// Send the queued readings, a batch is dropped from the queue only once it was acknowledged
+static void telemetry_drain(AWS_IoT_Client *pClient, const char *topic, uint16_t topicLen) {
+    static char payload[MAX_LENGTH_OF_TELEMETRY_BATCH];
+    IoT_Publish_Message_Params params;
+
+    if(NULL == telemetryQueue) {
+        return;
+    }
+
+    params.qos = QOS1;
+    params.isRetained = 0;
+    params.payload = (void *) payload;
+
+    for(int i = 0; i < TELEMETRY_BATCHES_PER_LOOP; i++) {
+        telemetry_storage_lock();
+        size_t len = telemetry_queue_next_batch(telemetryQueue, xTaskGetTickCount() * portTICK_PERIOD_MS,
+                                                payload, sizeof(payload));
+        telemetry_storage_unlock();
+        if(0 == len) {
+            return;
+        }
+
+        params.payloadLen = len;
+        IoT_Error_t rc = aws_iot_mqtt_publish(pClient, topic, topicLen, &params);
+        if(SUCCESS != rc) {
+            ESP_LOGW(TAG, "Telemetry batch publish error %d, will retry", rc);
+            return;
+        }
+
+        telemetry_storage_lock();
+        telemetry_queue_commit_batch(telemetryQueue);
+        telemetry_storage_unlock();
+        ESP_LOGI(TAG, "Sent %d bytes of queued telemetry", (int) len);
+
+        // let the client read acknowledgements before the next batch is due
+        aws_iot_shadow_yield(pClient, CONFIG_TELEMETRY_QUEUE_DRAIN_INTERVAL_MS);
+    }
+}
+
 void aws_iot_task(void *param) {
     IoT_Error_t rc = FAILURE;
 
@@ -253,6 +393,15 @@ void aws_iot_task(void *param) {
     roomOccupancyActuator.type = SHADOW_JSON_BOOL;
     roomOccupancyActuator.dataLength = sizeof(bool);
 
+    // only the fields that changed are reported, temperature once it moves more than the sensor noise
+    ShadowReportedField_t reportedFields[4] = {
+        { .pStruct = &temperatureHandler, .deadband = 0.2 },
+        { .pStruct = &soundHandler, .deadband = 5 },
+        { .pStruct = &roomOccupancyActuator },
+        { .pStruct = &hvacStatusActuator },
+    };
+    ShadowReporter_t reporter;
+
     ESP_LOGI(TAG, "AWS IoT SDK Version %d.%d.%d-%s", VERSION_MAJOR, VERSION_MINOR, VERSION_PATCH, VERSION_TAG);
 
     // initialize the mqtt client
@@ -278,6 +427,9 @@ void aws_iot_task(void *param) {
 
     ui_textarea_add("\nDevice client Id:\n>> %s <<\n", client_id, CLIENT_ID_LEN);
 
+    char telemetryTopic[CLIENT_ID_LEN + sizeof(TELEMETRY_TOPIC_SUFFIX)];
+    uint16_t telemetryTopicLen = snprintf(telemetryTopic, sizeof(telemetryTopic), "%s" TELEMETRY_TOPIC_SUFFIX, client_id);
+
     /* Wait for WiFI to show as connected */
     xEventGroupWaitBits(wifi_event_group, CONNECTED_BIT,
                         false, true, portMAX_DELAY);
@@ -294,6 +446,7 @@ void aws_iot_task(void *param) {
     scp.pMyThingName = client_id;
     scp.pMqttClientId = client_id;
     scp.mqttClientIdLen = CLIENT_ID_LEN;
+    scp.isAckSubscriptionPersistent = true;
 
     ESP_LOGI(TAG, "Shadow Connect");
     rc = aws_iot_shadow_connect(&iotCoreClient, &scp);
@@ -328,27 +481,30 @@ void aws_iot_task(void *param) {
         ESP_LOGE(TAG, "Shadow Register Delta Error");
     }
 
+    rc = aws_iot_shadow_reporter_init(&reporter, client_id, reportedFields, 4, 1000, 4);
+    if(SUCCESS != rc) {
+        ESP_LOGE(TAG, "Shadow Reporter Init Error");
+    }
+
     // loop and publish changes
     while(NETWORK_ATTEMPTING_RECONNECT == rc || NETWORK_RECONNECTED == rc || SUCCESS == rc) {
         rc = aws_iot_shadow_yield(&iotCoreClient, 200);
-        if(NETWORK_ATTEMPTING_RECONNECT == rc || shadowUpdateInProgress) {
+        if(NETWORK_ATTEMPTING_RECONNECT == rc) {
+            // Keep sampling while the client is reconnecting, the readings are sent once it is back
+            telemetry_store_reading();
             rc = aws_iot_shadow_yield(&iotCoreClient, 1000);
-            // If the client is attempting to reconnect, or already waiting on a shadow update,
-            // we will skip the rest of the loop.
             continue;
         }
 
-        // START get sensor readings
-        // sample temperature, convert to fahrenheit
-        MPU6886_GetTempData(&temperature);
-        temperature = (temperature * 1.8)  + 32 - 50;
+        telemetry_drain(&iotCoreClient, telemetryTopic, telemetryTopicLen);
 
-        // sample from soundBuffer (latest reading from microphone)
-        xSemaphoreTake(xMaxNoiseSemaphore, portMAX_DELAY);
-        reportedSound = soundBuffer;
-        xSemaphoreGive(xMaxNoiseSemaphore);
+        if(reporter.isUpdateInProgress) {
+            rc = aws_iot_shadow_yield(&iotCoreClient, 1000);
+            // If already waiting on a shadow update, we will skip the rest of the loop.
+            continue;
+        }
 
-        // END get sensor readings
+        read_sensors();
 
         ESP_LOGI(TAG, "*****************************************************************************************");
         ESP_LOGI(TAG, "On Device: roomOccupancy %s", roomOccupancy ? "true" : "false");
@@ -356,19 +512,10 @@ void aws_iot_task(void *param) {
         ESP_LOGI(TAG, "On Device: temperature %f", temperature);
         ESP_LOGI(TAG, "On Device: sound %d", reportedSound);
 
-        rc = aws_iot_shadow_init_json_document(JsonDocumentBuffer, sizeOfJsonDocumentBuffer);
-        if(SUCCESS == rc) {
-            rc = aws_iot_shadow_add_reported(JsonDocumentBuffer, sizeOfJsonDocumentBuffer, 4, &temperatureHandler,
-                                             &soundHandler, &roomOccupancyActuator, &hvacStatusActuator);
-            if(SUCCESS == rc) {
-                rc = aws_iot_finalize_json_document(JsonDocumentBuffer, sizeOfJsonDocumentBuffer);
-                if(SUCCESS == rc) {
-                    ESP_LOGI(TAG, "Update Shadow: %s", JsonDocumentBuffer);
-                    rc = aws_iot_shadow_update(&iotCoreClient, client_id, JsonDocumentBuffer,
-                                               ShadowUpdateStatusCallback, NULL, 4, true);
-                    shadowUpdateInProgress = true;
-                }
-            }
+        rc = aws_iot_shadow_reporter_update(&iotCoreClient, &reporter, xTaskGetTickCount() * portTICK_PERIOD_MS,
+                                            JsonDocumentBuffer, sizeOfJsonDocumentBuffer);
+        if(reporter.isUpdateInProgress) {
+            ESP_LOGI(TAG, "Update Shadow: %s", JsonDocumentBuffer);
         }
         ESP_LOGI(TAG, "*****************************************************************************************");
         ESP_LOGI(TAG, "Stack remaining for task '%s' is %d bytes", pcTaskGetTaskName(NULL), uxTaskGetStackHighWaterMark(NULL));
@@ -398,6 +545,8 @@ void app_main()
 
     xMaxNoiseSemaphore = xSemaphoreCreateMutex();
 
+    telemetry_init();
+
     ui_init();
     initialise_wifi();
 